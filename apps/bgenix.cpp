@@ -12,6 +12,8 @@
 #include <filesystem>
 #include <fmt/format.h>
 #include <optional>
+#include <iterator>
+#include <limits>
 #include "appcontext/CmdLineOptionProcessor.hpp"
 #include "appcontext/ApplicationContext.hpp"
 #include "appcontext/get_current_time_as_string.hpp"
@@ -20,7 +22,17 @@
 #include "db/Connection.hpp"
 #include "db/SQLStatement.hpp"
 #include "genfile/IndexQuery.hpp"
+#include "genfile/query_spec.hpp"
+#include "genfile/variant_list.hpp"
+#include "genfile/IndexWriter.hpp"
+#include "genfile/hash.hpp"
+#include "genfile/Writer.hpp"
 #include "genfile/View.hpp"
+#include "genfile/ForwardOnlyStreamBuf.hpp"
+#include "genfile/VariantBatch.hpp"
+#include "genfile/variant_filter.hpp"
+#include "genfile/vcf.hpp"
+#include "genfile/ThreadPool.hpp"
 #include "config.h"
 
 namespace bfs = std::filesystem ;
@@ -46,6 +58,8 @@ public:
 		options[ "-g" ]
 			.set_description(
 				"Path of bgen file to operate on.  (An optional form where \"-g\" is omitted and the filename is specified as the first argument, i.e. bgenix <filename>, can also be used)."
+				"  A path of \"-\" means standard input.  This, and pipes, are read as a stream, which can be"
+				" converted as a whole with -list, -vcf or -v11, but cannot be indexed or have variants selected."
 			)
 			.set_takes_single_value()
 			.set_is_required()
@@ -75,12 +89,19 @@ public:
 		;
 		options[ "-clobber" ]
 			.set_description(
-				"Specify that bgenix should overwrite existing index file if it exists."
+				"Specify that bgenix should overwrite the existing index file (with -index), or the existing"
+				" output file and its index (with -og), if they exist."
 			)
 		;
 		options[ "-with-rowid" ]
 			.set_description( "Create an index file that does not use the 'WITHOUT ROWID' feature."
 				" These are suitable for use with sqlite versions < 3.8.2, but may be less efficient." ) ;
+		options[ "-with-hashes" ]
+			.set_description( "Record a 64-bit content hash (XXH64) of each variant's genotype data block in a content_hash"
+				" column of the index.  Variants in different files whose blocks have the same hash have identical"
+				" genotype data blocks, so they can be found without decompressing the data."
+				" This applies to the index created by -index, or to the index of the output file written by -og."
+				" This requires reading all of the BGEN file, so indexing is slower." ) ;
 		
 
 		options.declare_group( "Variant selection options" ) ;
@@ -118,6 +139,18 @@ public:
 			.set_takes_values_until_next_option()
 		;
 
+		options[ "-incl-positions" ]
+			.set_description(
+				"Include variants at the specified position(s) in the output. "
+				"Each position must be of the form <chr>:<pos>, or <chr>:<pos>:<allele1>:<allele2> to include"
+				" only variants with the given first two alleles. "
+				"If the argument is the name of a valid readable file, the file will "
+				"be opened and whitespace-separated positions read from it instead."
+				"If this is specified multiple times, variants at any of the specified positions will be included."
+			)
+			.set_takes_values_until_next_option()
+		;
+
 		options[ "-excl-rsids" ]
 			.set_description(
 				"Exclude variants with the specified rsid(s) from the output. "
@@ -130,6 +163,38 @@ public:
 		options.declare_group( "Output options" ) ;
 		options[ "-list" ]
 			.set_description( "Suppress BGEN output; instead output a list of variants." ) ;
+		options[ "-list-fields" ]
+			.set_description(
+				"Comma-separated list of fields to output with -list.  Available fields are alternate_ids, rsid,"
+				" chromosome, position, number_of_alleles, first_allele, alternative_alleles, file_start_position"
+				" and size_in_bytes (or the short forms snpid, chrom, pos, offset and size)."
+				" By default the first seven of these are output, or all fields available in the index for -list-from-index."
+			)
+			.set_takes_single_value() ;
+		options[ "-list-format" ]
+			.set_description(
+				"Format of -list output.  This can be \"text\" (tab-delimited text) or \"columnar\"."
+				" The columnar format is binary, with all integers little-endian: an 8-byte magic number \"BGXLIST1\","
+				" a 4-byte column count, and for each column a 1-byte type (1 = uint16, 2 = uint32, 3 = int64, 4 = string),"
+				" a 4-byte name length and the name.  Blocks of variants follow, each consisting of a 4-byte variant count N"
+				" and then, for each column, N values; string columns hold N 4-byte lengths followed by the string data."
+				" A block with N = 0 ends the file."
+			)
+			.set_takes_single_value()
+			.set_default_value( "text" ) ;
+		options[ "-list-from-index" ]
+			.set_description(
+				"List variants using data recorded in the index file, without reading the BGEN file."
+				" The index does not record alternate ids, and records only the first two alleles of each variant,"
+				" so the alternate_ids and alternative_alleles fields are not available."
+			) ;
+		options[ "-threads" ]
+			.set_description(
+				"Number of threads to use for formatting -list output or for computing statistics for -og filters."
+				"  Zero means use all available cores."
+			)
+			.set_takes_single_value()
+			.set_default_value( 0 ) ;
 		options[ "-v11" ]
 			.set_description(
 				"Transcode to BGEN v1.1 format.  (Currently, this is only supported if the input"
@@ -146,15 +211,64 @@ public:
 			.set_description(
 				"Transcode to VCF format.  VCFs will have GP field (or 'HP' field for phased data), and a GT field inferred from the probabilities by threshholding."
 			) ;
+		options[ "-vcf-fields" ]
+			.set_description(
+				"FORMAT fields to output with -vcf.  This can be \"GT:GP\" (genotype calls and probabilities)"
+				" or \"GT\" (genotype calls only)."
+			)
+			.set_takes_single_value()
+			.set_default_value( "GT:GP" ) ;
+		options[ "-vcf-call-threshold" ]
+			.set_description(
+				"Threshhold used to call genotypes for the GT field in -vcf output.  A genotype (or, for phased data,"
+				" an allele of each haplotype) is called if its probability exceeds this value."
+			)
+			.set_takes_single_value()
+			.set_default_value( 0.9 ) ;
+		options[ "-og" ]
+			.set_description(
+				"Write the selected variants to the given bgen file, rather than to stdout, and write a bgenix index"
+				" for it (with \".bgi\" appended to the filename).  Variant data is copied without being re-encoded."
+			)
+			.set_takes_single_value() ;
+
+		options.declare_group( "Variant filter options" ) ;
+		options[ "-min-maf" ]
+			.set_description(
+				"Only output variants whose minor allele frequency, computed from expected allele counts, is at least this value."
+				" Statistics are computed for biallelic variants only, so multiallelic variants are excluded by all filters."
+			)
+			.set_takes_single_value() ;
+		options[ "-min-info" ]
+			.set_description(
+				"Only output variants whose IMPUTE info measure is at least this value."
+			)
+			.set_takes_single_value() ;
+		options[ "-max-missing-rate" ]
+			.set_description(
+				"Only output variants whose proportion of samples with missing data is at most this value."
+			)
+			.set_takes_single_value() ;
 
 		// Option interdependencies
 		options.option_excludes_group( "-index", "Variant selection options" ) ;
 		options.option_excludes_group( "-index", "Output options" ) ;
+		options.option_excludes_group( "-index", "Variant filter options" ) ;
 		options.option_excludes_option( "-list", "-v11" ) ;
 		options.option_excludes_option( "-vcf", "-list" ) ;
 		options.option_excludes_option( "-vcf", "-v11" ) ;
-		options.option_implies_option( "-clobber", "-index" ) ;
+		options.option_excludes_option( "-og", "-list" ) ;
+		options.option_excludes_option( "-og", "-vcf" ) ;
+		options.option_excludes_option( "-og", "-v11" ) ;
 		options.option_implies_option( "-compression-level", "-v11" ) ;
+		options.option_implies_option( "-vcf-fields", "-vcf" ) ;
+		options.option_implies_option( "-vcf-call-threshold", "-vcf" ) ;
+		options.option_implies_option( "-list-fields", "-list" ) ;
+		options.option_implies_option( "-list-format", "-list" ) ;
+		options.option_implies_option( "-list-from-index", "-list" ) ;
+		options.option_implies_option( "-min-maf", "-og" ) ;
+		options.option_implies_option( "-min-info", "-og" ) ;
+		options.option_implies_option( "-max-missing-rate", "-og" ) ;
 	}
 } ;
 
@@ -211,11 +325,19 @@ private:
 private:
 	void setup() {
 		m_bgen_filename = options().get< std::string >( "-g" ) ;
+		if( genfile::is_stream_input( m_bgen_filename )) {
+			process_stream( m_bgen_filename ) ;
+			return ;
+		}
 		m_index_filename = options().check( "-i" ) ? options().get< std::string > ( "-i" ) : (m_bgen_filename + ".bgi") ;
 		if( !bfs::exists( m_bgen_filename )) {
 			ui().logger() << "!! Error, the BGEN file \"" << m_bgen_filename << "\" does not exist!\n" ;
 			throw std::invalid_argument( m_bgen_filename ) ;
 		}
+		if( options().check( "-with-hashes" ) && !options().check( "-index" ) && !options().check( "-og" )) {
+			ui().logger() << "!! Error, -with-hashes can only be used with -index or -og.\n" ;
+			throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+		}
 		if( options().check( "-index" )) {
 			if( bfs::exists( m_index_filename ) && !options().check( "-clobber" )) {
 				ui().logger() << "!! Error, the index file \"" + m_index_filename + "\" already exists, use -clobber if you want to overwrite it.\n" ;
@@ -239,61 +361,33 @@ private:
 	}
 
 	void create_bgen_index_unsafe( std::string const& bgen_filename, std::string const& index_filename ) {
-		db::Connection::UniquePtr result ;
 		ui().logger()
                   << fmt::format( "{}: creating index for \"{}\" in \"{}\"...\n" , globals::program_name , bgen_filename , index_filename) ;
 
-		if( bfs::exists( index_filename + ".tmp" ) && !options().check( "-clobber" ) ) {
-			throw std::invalid_argument( "Error: an incomplete index file \"" + (index_filename + ".tmp") + "\" already exists.\n"
-				"This probably reflects a previous bgenix run that was terminated.\n"
-				"Please delete the file (or use -clobber to overwrite it automatically).\n"
-			) ;
+		if( bfs::exists( index_filename + ".tmp" )) {
+			if( options().check( "-clobber" )) {
+				bfs::remove( index_filename + ".tmp" ) ;
+			} else {
+				throw std::invalid_argument( "Error: an incomplete index file \"" + (index_filename + ".tmp") + "\" already exists.\n"
+					"This probably reflects a previous bgenix run that was terminated.\n"
+					"Please delete the file (or use -clobber to overwrite it automatically).\n"
+				) ;
+			}
 		}
 
 		try {
-			result = create_bgen_index_direct( bgen_filename, index_filename + ".tmp" ) ;
-			bfs::rename( index_filename + ".tmp", index_filename ) ;
+			create_bgen_index_direct( bgen_filename, index_filename ) ;
 		} catch( db::StatementStepError const& e ) {
 			ui().logger() << "!! Error in \"" << e.spec() << "\": " << e.description() << ".\n" ;
-			bfs::remove( index_filename + ".tmp" ) ;
 			throw appcontext::HaltProgramWithReturnCode( -1 ) ;
-		} catch( ... ) {
-			// Remove the incomplete attempt at an index file.
-			bfs::remove( index_filename + ".tmp" ) ;
-			throw ;
 		}
 	}
 	
-	db::Connection::UniquePtr create_bgen_index_direct( std::string const& bgen_filename, std::string const& index_filename ) {
-		db::Connection::UniquePtr connection = db::Connection::create( "file:" + index_filename + "?nolock=1", "rw" ) ;
-
-		connection->run_statement( "PRAGMA locking_mode = EXCLUSIVE ;" ) ;
-		connection->run_statement( "PRAGMA journal_mode = MEMORY ;" ) ;
-		connection->run_statement( "PRAGMA synchronous = OFF;" ) ;
-		
-		db::Connection::ScopedTransactionPtr transaction = connection->open_transaction( 240 ) ;
-		setup_index_file( *connection ) ;
-		// Close and open the transaction
-		transaction.reset() ;
-
-		db::Connection::StatementPtr insert_metadata_stmt = connection->get_statement(
-			"INSERT INTO Metadata( filename, file_size, last_write_time, first_1000_bytes, index_creation_time ) VALUES( ?, ?, ?, ?, ? )"
-		) ;
-
-		db::Connection::StatementPtr insert_variant_stmt = connection->get_statement(
-			"INSERT INTO Variant( chromosome, position, rsid, number_of_alleles, allele1, allele2, file_start_position, size_in_bytes ) "
-			"VALUES( ?, ?, ?, ?, ?, ?, ?, ? )"
-		) ;
-
+	void create_bgen_index_direct( std::string const& bgen_filename, std::string const& index_filename ) {
+		// The index writer removes its incomplete temporary file if we do not reach finalise().
+		bool const with_hashes = options().check( "-with-hashes" ) ;
+		genfile::bgen::IndexWriter indexWriter( index_filename, options().check( "-with-rowid" ), with_hashes ) ;
 		genfile::bgen::View bgenView( bgen_filename ) ;
-		
-		insert_metadata_stmt
-			->bind( 1, bgen_filename )
-			.bind( 2, bgenView.file_metadata().size )
-			.bind( 3, uint64_t( bgenView.file_metadata().last_write_time ) )
-			.bind( 4, &bgenView.file_metadata().first_bytes[0], &bgenView.file_metadata().first_bytes[0] + bgenView.file_metadata().first_bytes.size() )
-			.bind( 5, appcontext::get_current_time_as_string() )
-			.step() ;
 
 		ui().logger()
                   << fmt::format( "{}: Opened \"{}\" with {} variants...\n"  , globals::program_name , bgen_filename ,bgenView.number_of_variants());
@@ -302,9 +396,8 @@ private:
 		uint32_t position ;
 		std::vector< std::string > alleles ;
 		alleles.reserve(100) ;
-		std::size_t const chunk_size = 10 ;
-		
-		transaction = connection->open_transaction( 240 ) ;
+		std::vector< byte_t > buffer ;
+		std::optional< uint64_t > content_hash ;
 		
 		{
 			auto progress_context = ui().get_progress_context( "Building BGEN index" ) ;
@@ -316,38 +409,25 @@ private:
 					std::cerr << "read variant:" << chromosome << " " << position << " " << rsid << " " << file_pos << " " << alleles.size() << ".\n" << std::flush ;
 					std::cerr << "alleles: " << alleles[0] << ", "  << alleles[1] << ".\n" << std::flush ;
 #endif
-					bgenView.ignore_genotype_data_block() ;
+					if( with_hashes ) {
+						bgenView.read_raw_genotype_data_block( &buffer ) ;
+						content_hash = genfile::bgen::content_hash( buffer.data(), buffer.data() + buffer.size() ) ;
+					} else {
+						bgenView.ignore_genotype_data_block() ;
+					}
 					int64_t file_end_pos = int64_t( bgenView.current_file_position() ) ;
-					assert( alleles.size() > 1 ) ;
 					assert( (file_end_pos - file_pos) > 0 ) ;
-					insert_variant_stmt
-						->bind( 1, chromosome )
-						.bind( 2, position )
-						.bind( 3, rsid )
-						.bind( 4, int64_t( alleles.size() ) )
-						.bind( 5, alleles[0] )
-						.bind( 6, alleles[1] )
-						.bind( 7, file_pos )
-						.bind( 8, file_end_pos - file_pos )
-						.step()
-					;
-					insert_variant_stmt->reset() ;
-				
+					indexWriter.add_variant(
+						chromosome, position, rsid, alleles,
+						genfile::bgen::IndexQuery::FileRange( file_pos, file_end_pos - file_pos ),
+						content_hash
+					) ;
 					progress_context( ++variant_count, bgenView.number_of_variants() ) ;
-			
-				// Make sure and commit every 10000 SNPs.
-					if( variant_count % chunk_size == 0 ) {
-		//				ui().logger()
-		//					<< boost::format( "%s: Writing variants %d-%d...\n" ) % bgenView.number_of_variants() % (variant_count-chunk_size) % (variant_count-1) ;
-					
-						transaction.reset() ;
-						transaction = connection->open_transaction( 240 ) ;
-					}
 					file_pos = file_end_pos ;
 #if DEBUG
 					std::cerr << "Record inserted.\n" << std::flush ;
 #endif
-								}
+				}
 			}
 			catch( genfile::bgen::BGenError const& e ) {
 				ui().logger() << "!! (" << e.what() << "): an error occurred reading from the input file.\n" ;
@@ -365,37 +445,44 @@ private:
 				throw ;
 			}
 		}
-		return connection ;
+		genfile::bgen::IndexWriter::FileMetadata metadata = bgenView.file_metadata() ;
+		metadata.filename = bgen_filename ;
+		indexWriter.finalise( metadata ) ;
 	}
 	
-	void setup_index_file( db::Connection& connection ) {
-		std::string const tag = options().check( "-with-rowid" ) ? "" : " WITHOUT ROWID" ;
-
-		connection.run_statement(
-			"CREATE TABLE Metadata ("
-			" filename TEXT NOT NULL,"
-			" file_size INT NOT NULL,"
-			" last_write_time INT NOT NULL,"
-			" first_1000_bytes BLOB NOT NULL,"
-			" index_creation_time INT NOT NULL"
-			")"
-		) ;
-
-		connection.run_statement(
-			"CREATE TABLE Variant ("
-			"  chromosome TEXT NOT NULL,"
-			"  position INT NOT NULL,"
-			"  rsid TEXT NOT NULL,"
-			"  number_of_alleles INT NOT NULL,"
-			"  allele1 TEXT NOT NULL,"
-			"  allele2 TEXT NULL,"
-			"  file_start_position INT NOT NULL," // 
-			"  size_in_bytes INT NOT NULL,"       // We put these first to minimise cost of retrieval
-			"  PRIMARY KEY (chromosome, position, rsid, allele1, allele2, file_start_position )"
-			")" + tag
-		) ;
+	// Convert a whole bgen file read from standard input or a pipe, which has no index.
+	void process_stream( std::string const& bgen_filename ) const {
+		for( char const* option: {
+			"-index", "-i", "-og", "-list-from-index",
+			"-incl-range", "-excl-range", "-incl-rsids", "-incl-positions", "-excl-rsids"
+		}) {
+			if( options().check( option )) {
+				ui().logger() << "!! Error: \"" << bgen_filename << "\" is read as a stream, which cannot be used with " << option << ".\n" ;
+				throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+			}
+		}
+		if( !options().check( "-list" ) && !options().check( "-vcf" ) && !options().check( "-v11" )) {
+			ui().logger() << "!! Error: \"" << bgen_filename << "\" is read as a stream, so one of -list, -vcf or -v11 must be given.\n" ;
+			throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+		}
+		try {
+			genfile::bgen::View::UniquePtr bgenView = genfile::bgen::View::create_from_path( bgen_filename ) ;
+			if( options().check( "-list" ) ) {
+				process_selection_list( *bgenView, nullptr ) ;
+			} else if( options().check( "-vcf" )) {
+				process_selection_transcode( *bgenView, "vcf" ) ;
+			} else {
+				process_selection_transcode( *bgenView, "bgen_v1.1" ) ;
+			}
+		} catch( std::invalid_argument const& e ) {
+			std::cerr << e.what() << "\n" ;
+			throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+		} catch( genfile::bgen::BGenError const& e ) {
+			std::cerr << "!! Error: \"" << bgen_filename << "\" could not be read: it is truncated or not a bgen file.\n" ;
+			throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+		}
 	}
-	
+
 	void process_selection( std::string const& bgen_filename, std::string const& index_filename ) const {
 		try {
 			process_selection_unsafe( bgen_filename, index_filename ) ;
@@ -419,10 +506,17 @@ private:
 			|| options().check( "-vcf" )
 			|| options().check( "-v11" ) ;
 
-		if( transcode ) {
+		if( options().check( "-list-from-index" )) {
+			check_metadata( bgenView.file_metadata(), query->file_metadata() ) ;
+			process_selection_list( bgenView, query.get() ) ;
+		} else if( options().check( "-og" )) {
+			check_metadata( bgenView.file_metadata(), query->file_metadata() ) ;
+			bgenView.set_query( std::move( query )) ;
+			process_selection_write( bgenView, options().get< std::string >( "-og" )) ;
+		} else if( transcode ) {
                   bgenView.set_query( std::move(query) ) ;
 			if( options().check( "-list" ) ) {
-				process_selection_list( bgenView ) ;
+				process_selection_list( bgenView, nullptr ) ;
 			} else if( options().check( "-vcf" )) {
 				process_selection_transcode( bgenView, "vcf" ) ;
 			} else if( options().check( "-v11" )) {
@@ -447,24 +541,34 @@ private:
 		}
 	
 		if( options().check( "-incl-range" )) {
-			auto const elts = collect_unique_ids( options().get_values< std::string >( "-incl-range" ));
+			auto const elts = genfile::bgen::collect_unique_ids( options().get_values< std::string >( "-incl-range" ));
 			for( std::string const& elt: elts ) {
-				query->include_range( parse_range( elt )) ;
+				query->include_range( genfile::bgen::parse_range( elt )) ;
 			}
 		}
 		if( options().check( "-excl-range" )) {
-			auto const elts = collect_unique_ids( options().get_values< std::string >( "-excl-range" ));
+			auto const elts = genfile::bgen::collect_unique_ids( options().get_values< std::string >( "-excl-range" ));
 			for( std::string const& elt: elts ) {
-				query->exclude_range( parse_range( elt )) ;
+				query->exclude_range( genfile::bgen::parse_range( elt )) ;
 			}
 		}
 		if( options().check( "-incl-rsids" )) {
-			auto const ids = collect_unique_ids( options().get_values< std::string >( "-incl-rsids" ));
+			auto const ids = genfile::bgen::collect_unique_ids( options().get_values< std::string >( "-incl-rsids" ));
 			query->include_rsids( ids ) ;
 		}
 
+		if( options().check( "-incl-positions" )) {
+			auto const elts = genfile::bgen::collect_unique_ids( options().get_values< std::string >( "-incl-positions" ));
+			std::vector< genfile::bgen::IndexQuery::VariantPosition > positions ;
+			positions.reserve( elts.size() ) ;
+			for( std::string const& elt: elts ) {
+				positions.push_back( genfile::bgen::parse_position( elt )) ;
+			}
+			query->include_positions( positions ) ;
+		}
+
 		if( options().check( "-excl-rsids" )) {
-			auto const ids = collect_unique_ids( options().get_values< std::string >( "-excl-rsids" ));
+			auto const ids = genfile::bgen::collect_unique_ids( options().get_values< std::string >( "-excl-rsids" ));
 			query->exclude_rsids( ids ) ;
 		}
 
@@ -474,34 +578,6 @@ private:
 		}
 		return( genfile::bgen::IndexQuery::UniquePtr( query.release() )) ; // Using std::unique_ptr so we need these gymnastics
 	}
-	
-	std::vector< std::string > collect_unique_ids( std::vector< std::string > const& ids_or_filenames ) const {
-		std::vector< std::string > result ;
-                std::string str;
-                //TODO: test this change
-		for( auto elt: ids_or_filenames ) {
-			if( bfs::exists( elt )) {
-				std::ifstream f( elt ) ;
-                                str.reserve(f.tellg());
-                                f.seekg(0, std::ios::beg);
-                                str.assign((std::istreambuf_iterator<char>(f)),
-                                           std::istreambuf_iterator<char>());
-                                result.push_back(str);
-				// std::copy(
-				// 	std::istream_iterator< std::string >( f ),
-				// 	std::istream_iterator< std::string >(),
-				// 	std::back_inserter< std::vector< std::string > >( result )
-				//) ;
-			} else {
-				result.push_back( elt ) ;
-			}
-		}
-		// now sort and uniqueify them...
-		std::sort( result.begin(), result.end() ) ;
-		std::vector< std::string >::const_iterator newBack = std::unique( result.begin(), result.end() ) ;
-		result.resize( newBack - result.begin() ) ;
-		return result ;
-	}
 
 	void process_selection_notranscode( std::string const& bgen_filename, genfile::bgen::IndexQuery::UniquePtr index ) const {
 		std::ifstream bgen_file( bgen_filename, std::ios::binary ) ;
@@ -537,267 +613,189 @@ private:
 		std::cerr << fmt::format( "{}: wrote data for {} variants to stdout.\n"  , globals::program_name , index->number_of_variants()) ;
 	}
 	
-	void process_selection_list( genfile::bgen::View& bgenView ) const {
-          std::cout << fmt::format( "# {}: started {}\n" ,  globals::program_name  ,appcontext::get_current_time_as_string()) ;
-		std::cout << "alternate_ids\trsid\tchromosome\tposition\tnumber_of_alleles\tfirst_allele\talternative_alleles\n" ;
-		
-		std::string SNPID, rsid, chromosome ;
-		uint32_t position ;
-		std::vector< std::string > alleles ;
-
-		for( std::size_t i = 0; i < bgenView.number_of_variants(); ++i ) {
-			bool success = bgenView.read_variant(
-				&SNPID, &rsid, &chromosome, &position, &alleles
-			) ;
-			if( SNPID.empty() ) {
-				SNPID = "." ;
-			}
-			if( rsid.empty() ) {
-				rsid = "." ;
-			}
-			std::cout << SNPID << "\t" << rsid << "\t" << chromosome << "\t" << position << "\t" << alleles.size() << "\t" << alleles[0] << "\t" ;
-			for( std::size_t allele_i = 1; allele_i < alleles.size(); ++allele_i ) {
-				std::cout << (( allele_i > 1 ) ? "," : "" ) << alleles[allele_i] ;
-			}
-			std::cout << "\n" ;
-			if( !success ) {
-				throw std::invalid_argument( "positions" ) ;
+	// Write the selected variants that pass the -og filters to a new bgen file, along with its index.
+	// Batches are read on this thread, filtered on the pool, and the raw bytes of included variants
+	// are copied from the input file in order.
+	void process_selection_write(
+		genfile::bgen::View& bgenView,
+		std::string const& output_filename
+	) const {
+		std::string const output_index_filename = output_filename + ".bgi" ;
+		if( bfs::exists( output_filename ) || bfs::exists( output_index_filename )) {
+			if( !options().check( "-clobber" )) {
+				throw std::invalid_argument(
+					"!! Error, the output file \"" + output_filename + "\" or its index already exists, use -clobber if you want to overwrite it."
+				) ;
 			}
-			bgenView.ignore_genotype_data_block() ;
 		}
-		std::cout << fmt::format( "# {}: success, total {} variants.\n" ,  globals::program_name , bgenView.number_of_variants());
-	}
-
-	void process_selection_transcode(
-		genfile::bgen::View& view,
-		std::string const& format
-	) const {
-		if( format == "vcf" ) {
-			process_selection_transcode_bgen_vcf( view ) ;
-		} else if( format == "bgen_v1.1" ) {
-			process_selection_transcode_bgen_v11( view ) ;
-		} else {
-			throw std::invalid_argument( "format=\"" + format + "\"" ) ;
+		if( options().check( "-clobber" )) {
+			bfs::remove( output_index_filename + ".tmp" ) ;
 		}
-	}
 
-	struct VCFProbWriter {
-		VCFProbWriter( std::ostream& out ):
-			m_out( out )
-		{}
-		
-		// Called once allowing us to set storage.
-		void initialise( std::size_t number_of_samples, std::size_t number_of_alleles ) {
-			// Nothing to do.
-			m_number_of_alleles = number_of_alleles ;
-		}
-	
-		// If present with this signature, called once after initialise()
-		// to set the minimum and maximum ploidy and numbers of probabilities among samples in the data.
-		// This enables us to set up storage for the data ahead of time.
-		void set_min_max_ploidy( uint32_t min_ploidy, uint32_t max_ploidy, uint32_t min_entries, uint32_t max_entries ) {
-			// Make sure we've enough space.
-			m_data.reserve( max_entries ) ;
-		}
-	
-		// Called once per sample to determine whether we want data for this sample
-		bool set_sample( std::size_t i ) {
-			// Yes, here we want info for all samples.
-			return true ;
+		genfile::bgen::VariantFilter filter ;
+		if( options().check( "-min-maf" )) {
+			filter.min_maf = options().get< double >( "-min-maf" ) ;
 		}
-	
-		// Called once per sample to set the number of probabilities that are present.
-		void set_number_of_entries(
-			std::size_t ploidy,
-			std::size_t number_of_entries,
-			genfile::OrderType order_type,
-			genfile::ValueType value_type
-		) {
-			assert( value_type == genfile::eProbability ) ;
-			m_data.resize( number_of_entries ) ;
-			m_out << "\t" ;
-			m_ploidy = ploidy ;
-			m_order_type = order_type ;
-			m_missing = false ;
+		if( options().check( "-min-info" )) {
+			filter.min_info = options().get< double >( "-min-info" ) ;
 		}
-
-		void set_value( uint32_t entry_i, double value ) {
-			m_data[ entry_i ] = value ;
-			if( entry_i == m_data.size() - 1 ) {
-				write_sample_entry() ;
-			}
-		}
-
-		void set_value( uint32_t entry_i, genfile::MissingValue value ) {
-			m_data[ entry_i ] = -1 ;
-			m_missing = true ;
-			if( entry_i == m_data.size() - 1 ) {
-				write_sample_entry() ;
-			}
+		if( options().check( "-max-missing-rate" )) {
+			filter.max_missing_rate = options().get< double >( "-max-missing-rate" ) ;
 		}
 
-		void finalise() {
-			m_out << "\n" ;
+		genfile::bgen::Context const context = bgenView.context() ;
+		// As for read_genotype_data_block(), blocks are prefixed by their size unless uncompressed in layout 1.
+		bool const has_size_field = ( context.flags & genfile::bgen::e_Layout ) == genfile::bgen::e_Layout2
+			|| ( context.flags & genfile::bgen::e_CompressedSNPBlocks ) != genfile::bgen::e_NoCompression ;
+		std::vector< std::string > sample_ids ;
+		if( context.flags & genfile::bgen::e_SampleIdentifiers ) {
+			bgenView.get_sample_ids( [&sample_ids]( std::string const& id ) { sample_ids.push_back( id ) ; } ) ;
 		}
 
-	private:
-		std::ostream& m_out ;
-		std::vector< double > m_data ;
-		std::size_t m_number_of_alleles ;
-
-		// Used to keep track of what we're doing.
-		std::size_t m_ploidy ;
-		genfile::OrderType m_order_type ;
-		bool m_missing ;
-		
-		// These fields are used to enumerate genotypes for the GT field.
-		std::vector< uint16_t > m_genotype_allele_limits ;
-		std::vector< uint16_t > m_genotype ;
-		
-		// space to assemble GT field.
-		std::string m_GT_buffer ;
-		void write_sample_entry() {
-			if( m_missing ) {
-				std::string const GT_separator = (m_order_type == genfile::ePerPhasedHaplotypePerAllele) ? "|" : "/" ;
-				for( uint32_t i = 0 ; i < m_ploidy; ++i ) {
-					m_out << ((i>0) ? GT_separator : "" )
-						<< "." ;
-				}
-				m_out << ":" ;
-			} else {
-				std::string const& GT = construct_GT( m_data, 0.9 ) ;
-				m_out << GT
-					<< ":" ;
-			}
-			for( std::size_t i = 0; i < m_data.size(); ++i ) {
-				m_out << ((i>0) ? "," : "") ;
-				if( m_data[i] == -1 ) {
-					m_out << "." ;
-				} else {
-					m_out << m_data[i] ;
+		try {
+			genfile::bgen::Writer writer( output_filename, context, sample_ids ) ;
+			bool const with_hashes = options().check( "-with-hashes" ) ;
+			genfile::bgen::IndexWriter index_writer( output_index_filename, options().check( "-with-rowid" ), with_hashes ) ;
+			std::vector< byte_t > block ;
+			std::vector< std::string > alleles ;
+			std::size_t count = 0 ;
+
+			auto progress_context = ui().get_progress_context( "Filtering variants" ) ;
+			genfile::ThreadPool pool( options().get< std::size_t >( "-threads" )) ;
+			genfile::OrderedTaskQueue< genfile::bgen::FilteredVariantBatch > queue(
+				pool, 2 * pool.number_of_threads(),
+				[&]( genfile::bgen::FilteredVariantBatch const& result ) {
+					genfile::bgen::VariantBatch const& batch = result.batch ;
+					for( std::size_t i = 0; i < batch.size(); ++i ) {
+						if( result.included[i] ) {
+							// Variants are written from the batch, so the input is not read twice.
+							// The stored block excludes the leading size field, which is restored here.
+							std::pair< byte_t const*, byte_t const* > const data = batch.genotype_data_block( i ) ;
+							std::size_t const size_field_size = has_size_field ? 4 : 0 ;
+							block.resize( size_field_size + ( data.second - data.first )) ;
+							if( has_size_field ) {
+								genfile::bgen::write_little_endian_integer( block.data(), block.data() + 4, uint32_t( data.second - data.first )) ;
+							}
+							std::copy( data.first, data.second, block.data() + size_field_size ) ;
+							alleles.clear() ;
+							for( std::size_t j = 0; j < batch.number_of_alleles[i]; ++j ) {
+								alleles.push_back( std::string( batch.allele( i, j ))) ;
+							}
+							genfile::bgen::IndexQuery::FileRange const range = writer.write_variant(
+								std::string( batch.SNPID( i )), std::string( batch.rsid( i )), batch.chromosome( i ), batch.position[i],
+								alleles, block.data(), block.data() + block.size()
+							) ;
+							std::optional< uint64_t > content_hash ;
+							if( with_hashes ) {
+								content_hash = genfile::bgen::content_hash( data.first, data.second ) ;
+							}
+							index_writer.add_variant( batch.chromosome( i ), batch.position[i], std::string( batch.rsid( i )), alleles, range, content_hash ) ;
+						}
+					}
+					count += batch.size() ;
+					progress_context( count, bgenView.number_of_variants() ) ;
 				}
+			) ;
+
+			std::size_t const batch_size = 1000 ;
+			genfile::bgen::VariantBatch batch ;
+			while( bgenView.read_variant_batch( batch_size, &batch, true ) > 0 ) {
+				queue.submit(
+					[batch = std::move( batch ), &context, &filter]() mutable {
+						return genfile::bgen::filter_variant_batch( std::move( batch ), context, filter ) ;
+					}
+				) ;
 			}
+			queue.finish() ;
+			progress_context.finish() ;
+
+			genfile::bgen::Writer::FileMetadata const metadata = writer.finalise() ;
+			index_writer.finalise( metadata ) ;
+			std::cerr << fmt::format(
+				"{}: wrote {} of {} selected variants to \"{}\".\n",
+				globals::program_name, writer.number_of_variants(), count, output_filename
+			) ;
+		} catch( ... ) {
+			bfs::remove( output_filename ) ;
+			throw ;
 		}
+	}
 
-		std::string const& construct_GT( std::vector< double > const& probs, double const threshhold ) {
-			if( m_order_type == genfile::ePerPhasedHaplotypePerAllele ) {
-				return construct_phased_GT( probs, threshhold ) ;
-			} else {
-				return construct_unphased_GT( probs, threshhold ) ;
-			}
+	void process_selection_list( genfile::bgen::View& bgenView, genfile::bgen::IndexQuery const* index ) const {
+		bool const from_index = ( index != 0 ) ;
+		std::vector< genfile::bgen::ListFieldSpec > const fields = options().check( "-list-fields" )
+			? genfile::bgen::parse_list_fields( options().get< std::string >( "-list-fields" ), from_index )
+			: genfile::bgen::default_list_fields( from_index ) ;
+		genfile::bgen::ListFormat const format = genfile::bgen::parse_list_format( options().get< std::string >( "-list-format" )) ;
+
+		if( format == genfile::bgen::eColumnarList ) {
+			std::string const header = genfile::bgen::format_list_columnar_header( fields ) ;
+			std::cout.write( header.data(), header.size() ) ;
+		} else {
+			std::cout << fmt::format( "# {}: started {}\n" ,  globals::program_name  ,appcontext::get_current_time_as_string()) ;
+			std::cout << genfile::bgen::format_list_text_header( fields ) ;
 		}
 
-		std::string const& construct_phased_GT( std::vector< double > const& probs, double const threshhold ) {
-			m_GT_buffer.clear() ;
-			// for phased data it is simple:
-			for( uint32_t i = 0; i < m_ploidy; ++i ) {
-				uint32_t j = 0 ;
-				for( ; j < m_number_of_alleles; ++j ) {
-					if( probs[i*m_number_of_alleles+j] > threshhold ) {
-						break ;
-					}
-				}
-				if( j < m_number_of_alleles ) {
-					m_GT_buffer += std::to_string( j ) + "|" ;
+		// Batches are read on this thread and formatted on the pool, then written in order.
+		genfile::ThreadPool pool( options().get< std::size_t >( "-threads" )) ;
+		std::size_t const batch_size = 10000 ;
+		std::size_t const count = genfile::bgen::write_variant_list(
+			[&]( genfile::bgen::IndexQuery::BatchCallback callback ) {
+				if( index ) {
+					index->read_variant_batches( batch_size, callback ) ;
 				} else {
-					m_GT_buffer += ".|" ;
+					genfile::bgen::VariantBatch batch ;
+					while( bgenView.read_variant_batch( batch_size, &batch ) > 0 ) {
+						callback( batch ) ;
+					}
 				}
-			}
-			// remove trailing separator
-			m_GT_buffer.resize( m_GT_buffer.size() - 1 ) ;
-			return m_GT_buffer ;
+			},
+			fields, format, pool, std::cout
+		) ;
+
+		if( format == genfile::bgen::eColumnarList ) {
+			std::string const end = genfile::bgen::format_list_columnar_end() ;
+			std::cout.write( end.data(), end.size() ) ;
+		} else {
+			std::cout << fmt::format( "# {}: success, total {} variants.\n" ,  globals::program_name , count ) ;
 		}
+	}
 
-		std::string const& construct_unphased_GT( std::vector< double > const& probs, double const threshhold ) {
-			// To construct the GT field for unphased data, we must enumerate
-			// all of the possible genotypes.
-			// These come in colex order of the the allele count representation.
-			// Specifically, we have m_ploidy = n chromosomes in total.
-			// Genotypes are all ways to put n_alleles = k alleles into those chromosomes.
-			// We represent these as k-vectors that sum to n (i.e. v=(v_i) where v_i is the count of allele i),
-			// or equivalently, (k-1)-vectors that sum to at most n.
-			// Colex order is lexicographical order of these vectors, reading them right-to-left.
-			// E.g. for ploidy = 3 and 3 alleles, the order is
-			// 3,0,0 = AAA
-			// 2,1,0 = AAB
-			// 1,2,0 = ABB
-			// 0,3,0 = BBB
-			// 2,0,1 = AAC
-			// 1,1,1 = ABC
-			// 0,2,1 = BBC
-			// 1,0,2 = ACC
-			// 0,1,2 = BCC
-			// 0,0,3 = CCC
-			// Here we enumerate these and bail out when we hit a probability over the threshhold.
-			m_genotype_allele_limits.assign( (m_number_of_alleles-1), m_ploidy ) ;
-			m_genotype.assign( m_number_of_alleles, 0 ) ;
-			// Set up first genotype - all ref allele
-			m_genotype[0] = m_ploidy ;
-
-			// Iterate through genotypes.
-			bool metThreshhold = false ;
-			for( std::size_t index = 0; true; ++index ) {
-				if( probs[index] > threshhold ) {
-					metThreshhold = true ;
-					break ;
-				}
-				
-				// Move to next possible genotype
-				std::size_t j = 0 ;
-				for( ; j < (m_number_of_alleles-1); ++j ) {
-					uint16_t value = m_genotype[j+1] ;
-					if( value < m_genotype_allele_limits[ j ] ) {
-						++m_genotype[j+1] ;
-						--m_genotype[0] ;
-						for( std::size_t k = 0; k < j; ++k ) {
-							--m_genotype_allele_limits[k] ;
-						}
-						break ;
-					} else {
-						// allele count has reached its limit.
-						// Reset it to zero.
-						// Note that to get here all lower-order counts must be zero.
-						m_genotype[j+1] = 0 ;
-						m_genotype[0] += value ;
-						for( std::size_t k = 0; k < j; ++k ) {
-							m_genotype_allele_limits[k] += value ;
-						}
-					}
-				}
-				if( j == (m_number_of_alleles-1) ) {
-					break ;
-				}
-			}
-			
-			m_GT_buffer.clear() ;
-			if( metThreshhold ) {
-				for( std::size_t allele = 0; allele < m_number_of_alleles; ++allele ) {
-					std::string const elt = std::to_string( allele ) + "/" ;
-					for( uint16_t count = 0; count < m_genotype[allele]; ++count ) {
-						m_GT_buffer += elt ;
-					}
-				}
-			} else {
-				for( std::size_t i = 0; i < m_ploidy; ++i ) {
-					m_GT_buffer += "./" ;
-				}
-			}
-			// remove trailing slash.
-			m_GT_buffer.resize( m_GT_buffer.size() - 1 ) ;
-			return m_GT_buffer ;
+	void process_selection_transcode(
+		genfile::bgen::View& view,
+		std::string const& format
+	) const {
+		if( format == "vcf" ) {
+			process_selection_transcode_bgen_vcf( view ) ;
+		} else if( format == "bgen_v1.1" ) {
+			process_selection_transcode_bgen_v11( view ) ;
+		} else {
+			throw std::invalid_argument( "format=\"" + format + "\"" ) ;
 		}
-	} ;
+	}
 
 	void process_selection_transcode_bgen_vcf(
 		genfile::bgen::View& bgenView
 	) const {
 		uint32_t const inputLayout = bgenView.context().flags & genfile::bgen::e_Layout ;
+		std::string const fields = options().get< std::string >( "-vcf-fields" ) ;
+		if( fields != "GT:GP" && fields != "GT" ) {
+			throw std::invalid_argument( "Unrecognised -vcf-fields \"" + fields + "\", expected \"GT:GP\" or \"GT\"." ) ;
+		}
+		bool const write_probabilities = ( fields == "GT:GP" ) ;
+		double const threshhold = options().get< double >( "-vcf-call-threshold" ) ;
+		if( !( threshhold >= 0.0 && threshhold <= 1.0 )) {
+			throw std::invalid_argument( "-vcf-call-threshold must be between 0 and 1." ) ;
+		}
 
 		std::cout << "##fileformat=VCFv4.2\n"
-			<< "##FORMAT=<ID=GT,Type=String,Number=1,Description=\"Threshholded genotype call\">\n"
-			<< "##FORMAT=<ID=GP,Type=Float,Number=G,Description=\"Genotype call probabilities\">\n"
-			<< "##FORMAT=<ID=HP,Type=Float,Number=.,Description=\"Haplotype call probabilities\">\n"
-			<< "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT" ;
+			<< "##FORMAT=<ID=GT,Type=String,Number=1,Description=\"Threshholded genotype call\">\n" ;
+		if( write_probabilities ) {
+			std::cout
+				<< "##FORMAT=<ID=GP,Type=Float,Number=G,Description=\"Genotype call probabilities\">\n"
+				<< "##FORMAT=<ID=HP,Type=Float,Number=.,Description=\"Haplotype call probabilities\">\n" ;
+		}
+		std::cout << "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT" ;
 		
 		bgenView.get_sample_ids(
 			[]( std::string const& name ) { std::cout << "\t" << name ; }
@@ -811,15 +809,20 @@ private:
 		// Map from bit sizes to vcf encoding tables
 		typedef std::map< std::size_t, std::pair< std::size_t, std::string > > EncodingTables ;
 		EncodingTables encoding_tables ;
+		GTTables gt_tables ;
 		std::vector< char > buffer ;
+		genfile::bgen::VCFProbWriter writer( threshhold, write_probabilities ) ;
 	
 		{
-			auto progress_context = ui().get_progress_context( "Processing " + std::to_string( bgenView.number_of_variants() ) + " variants" ) ;
+			auto progress_context = ui().get_progress_context( "Processing " + describe_number_of_variants( bgenView ) + " variants" ) ;
 			for( std::size_t i = 0; i < bgenView.number_of_variants(); ++i ) {
 				bool success = bgenView.read_variant(
 					&SNPID, &rsid, &chromosome, &position, &alleles
 				) ;
-				assert( success ) ;
+				if( !success ) {
+					check_end_of_variants( bgenView, i ) ;
+					break ;
+				}
 				assert( alleles.size() > 1 ) ;
 				std::cout << chromosome
 					<< "\t" << position
@@ -834,19 +837,29 @@ private:
 					<< ".\t" // QUAL
 					<< ".\t" // FILTER
 					<< ".\t" // INFO
-					<< "GT:GP" // FORMAT
+					<< fields // FORMAT
 				;
 
-				if( inputLayout == genfile::bgen::e_Layout2 ) {
+				if( inputLayout == genfile::bgen::e_Layout2 && !write_probabilities ) {
+					genfile::bgen::v12::GenotypeDataBlock pack ;
+					bgenView.read_and_unpack_v12_genotype_data_block( &pack ) ;
+					if( pack.numberOfAlleles == 2 && pack.ploidyExtent[0] == 2 && pack.ploidyExtent[1] == 2 ) {
+						genfile::bgen::write_vcf_gt_fields( pack, get_vcf_gt_table( gt_tables, pack.bits, pack.phased, threshhold ), &buffer ) ;
+						std::cout.write( &buffer[0], buffer.size() ) ;
+					} else {
+						genfile::bgen::v12::parse_probability_data( pack, writer ) ;
+						writer.write( std::cout ) ;
+					}
+				} else if( inputLayout == genfile::bgen::e_Layout2 ) {
 					// Inspect data and use faster method if available
 					// Currently this works for 1, 2, 4 or 8-bit encoded data.
 					genfile::bgen::v12::GenotypeDataBlock pack ;
 					bgenView.read_and_unpack_v12_genotype_data_block( &pack ) ;
-					if( (pack.bits == 1 || pack.bits == 2 || pack.bits == 4 || pack.bits == 8 ) && pack.ploidyExtent[0] == 2 && pack.ploidyExtent[1] == 2 && pack.phased == false ) {
+					if( (pack.bits == 1 || pack.bits == 2 || pack.bits == 4 || pack.bits == 8 ) && pack.numberOfAlleles == 2 && pack.ploidyExtent[0] == 2 && pack.ploidyExtent[1] == 2 && pack.phased == false ) {
 						typedef std::pair< std::string::const_iterator, std::string::const_iterator > EncodedRange ;
 						// First is the size of each entry, second is the data itself.
 						typedef std::pair< std::size_t, std::string > VcfEncodingTable ;
-						VcfEncodingTable const& vcf_encoding_table = get_vcf_encoding_table( encoding_tables, pack.bits ) ;
+						VcfEncodingTable const& vcf_encoding_table = get_vcf_encoding_table( encoding_tables, pack.bits, threshhold ) ;
 						buffer.resize( pack.numberOfSamples * (1+vcf_encoding_table.first) + 1 ) ;
 						char* buffer_p = &buffer[0] ;
 						for( std::size_t i = 0; i < pack.numberOfSamples; ++i ) {
@@ -867,13 +880,13 @@ private:
 						
 						std::cout.write( &buffer[0], (buffer_p - &buffer[0]) ) ;
 					} else {
-						VCFProbWriter writer( std::cout ) ;
 						genfile::bgen::v12::parse_probability_data( pack, writer ) ;
+						writer.write( std::cout ) ;
 					}
 				} else {
 					// Use generic, possibly slow method
-					VCFProbWriter writer( std::cout ) ;
 					bgenView.read_genotype_data_block( writer ) ;
+					writer.write( std::cout ) ;
 				}
 				progress_context( i+1, bgenView.number_of_variants() ) ;
 			}
@@ -881,10 +894,10 @@ private:
 	}
 
 	typedef std::map< std::size_t, std::pair< std::size_t, std::string > > EncodingTables ;
-	std::pair< std::size_t, std::string > const& get_vcf_encoding_table( EncodingTables& encoding_tables, int bits ) const {
+	std::pair< std::size_t, std::string > const& get_vcf_encoding_table( EncodingTables& encoding_tables, int bits, double const threshhold ) const {
 		EncodingTables::const_iterator table_i = encoding_tables.find( bits ) ;
 		if( table_i == encoding_tables.end() ) {
-			std::pair< EncodingTables::const_iterator, bool > inserted = encoding_tables.insert( std::make_pair( bits, compute_vcf_encoding_table( bits )) ) ;
+			std::pair< EncodingTables::const_iterator, bool > inserted = encoding_tables.insert( std::make_pair( bits, compute_vcf_encoding_table( bits, threshhold )) ) ;
 			assert( inserted.second ) ;
 			table_i = inserted.first ;
 		}
@@ -917,7 +930,7 @@ private:
 		return ((*encoding_p) >> encodingShift ) & encodingMask ;
 	}
 	
-	std::pair< std::size_t, std::string > compute_vcf_encoding_table( int const bits ) const {
+	std::pair< std::size_t, std::string > compute_vcf_encoding_table( int const bits, double const threshhold ) const {
 		assert( bits == 1 || bits == 2 || bits == 4 || bits == 8 ) ;
 		int dps = 0 ;
 		switch( bits ) {
@@ -944,11 +957,11 @@ private:
 				double const p0 = x/double(maxProb) ;
 				double const p1 = y/double(maxProb) ;
 				double const p2 = z/double(maxProb) ;
-				if( p0 > 0.9 ) {
+				if( p0 > threshhold ) {
 					gt = "0/0" ;
-				} else if( p1 > 0.9 ) {
+				} else if( p1 > threshhold ) {
 					gt = "0/1" ;
-				} else if( p2 > 0.9 ) {
+				} else if( p2 > threshhold ) {
 					gt = "1/1" ;
 				} else {
 					gt = "./." ;
@@ -963,6 +976,17 @@ private:
 		return std::make_pair( valueSize, storage ) ;
 	}
 	
+	// GT-only tables for diploid biallelic data, by number of bits and phasing.
+	typedef std::map< std::pair< int, bool >, genfile::bgen::VcfGTTable > GTTables ;
+
+	genfile::bgen::VcfGTTable const& get_vcf_gt_table( GTTables& gt_tables, int bits, bool phased, double const threshhold ) const {
+		GTTables::const_iterator table_i = gt_tables.find( std::make_pair( bits, phased )) ;
+		if( table_i == gt_tables.end() ) {
+			table_i = gt_tables.insert( std::make_pair( std::make_pair( bits, phased ), genfile::bgen::compute_vcf_gt_table( bits, phased, threshhold ))).first ;
+		}
+		return table_i->second ;
+	}
+
 	// This function implements an efficient transcode from a specific type of BGEN file
 	// To BGEN v1.1 files.
 	// Specifically we support BGEN 'layout=2' files (BGEN v1.2 and above) with 8 bits per
@@ -985,6 +1009,9 @@ private:
 		// This means layout 1, no sample identifiers, zlib compression.
 		genfile::bgen::Context outputContext = bgenView.context() ;
 		outputContext.flags = genfile::bgen::e_Layout1 | genfile::bgen::e_ZlibCompression ;
+		// Output goes to stdout and cannot be rewritten, so declare the number of selected variants up front.
+		// This is unknown if the input is a stream that does not record it.
+		outputContext.number_of_variants = bgenView.number_of_variants() ;
 		
 		// Write offset and header
 		genfile::bgen::write_offset( std::cout, outputContext.header_size() ) ;
@@ -1004,13 +1031,17 @@ private:
 
 		int const compressionLevel = options().get< int >( "-compression-level" ) ;
 
+		std::size_t count = 0 ;
 		{
-			auto progress_context = ui().get_progress_context( "Processing " + std::to_string( bgenView.number_of_variants() ) + " variants" ) ;
+			auto progress_context = ui().get_progress_context( "Processing " + describe_number_of_variants( bgenView ) + " variants" ) ;
 			for( std::size_t i = 0; i < bgenView.number_of_variants(); ++i ) {
 				bool success = bgenView.read_variant(
 					&SNPID, &rsid, &chromosome, &position, &alleles
 				) ;
-				assert( success ) ;
+				if( !success ) {
+					check_end_of_variants( bgenView, i ) ;
+					break ;
+				}
 				if( alleles.size() != 2 ) {
 					std::cerr
 						<< "In -transcode, found variant with " << alleles.size() << " allele, only 2 alleles are supported by BGEN v1.1.\n" ;
@@ -1036,7 +1067,12 @@ private:
 					std::cerr << "For -v11, expected unphased data.\n" ;
 					throw std::invalid_argument( "bgen_filename=\"" + bgenView.file_metadata().filename + "\"" ) ;
 				}
-				if( pack.end < pack.buffer + bgenView.context().number_of_samples ) {
+				if( pack.ploidyExtent[0] != 2 || pack.ploidyExtent[1] != 2 ) {
+					std::cerr << "For -v11, expected diploid data.\n" ;
+					throw std::invalid_argument( "bgen_filename=\"" + bgenView.file_metadata().filename + "\"" ) ;
+				}
+				// Two bytes are read for each sample below.
+				if( pack.end < pack.buffer + 2 * bgenView.context().number_of_samples ) {
 					throw std::invalid_argument( "bgen_filename=\"" + bgenView.file_metadata().filename + "\"" ) ;
 				}
 				byte_t* out_p = &serialisationBuffer[0] ;
@@ -1084,11 +1120,29 @@ private:
 					uint32_t( compressionBuffer.size() )
 				) ;
 				std::copy( &compressionBuffer[0], &compressionBuffer[0]+compressionBuffer.size(), outIt ) ;
+				count = i + 1 ;
 				progress_context( i+1, bgenView.number_of_variants() ) ;
 			}
 		}
 		
-		std::cerr << fmt::format( "# {}: success, total {} variants.\n" ,  globals::program_name , bgenView.number_of_variants()) ;
+		std::cerr << fmt::format( "# {}: success, total {} variants.\n" ,  globals::program_name , count ) ;
+	}
+
+	std::string describe_number_of_variants( genfile::bgen::View const& bgenView ) const {
+		return ( bgenView.number_of_variants() == genfile::bgen::e_UnknownNumberOfVariants )
+			? "an unknown number of"
+			: std::to_string( bgenView.number_of_variants() ) ;
+	}
+
+	// Called when no more variants can be read after reading the given number.  Streamed files that do not
+	// record the number of variants are read to the end; otherwise the file has fewer variants than expected.
+	void check_end_of_variants( genfile::bgen::View const& bgenView, std::size_t count ) const {
+		if( bgenView.number_of_variants() != genfile::bgen::e_UnknownNumberOfVariants ) {
+			throw std::invalid_argument(
+				"bgen_filename=\"" + bgenView.file_metadata().filename + "\": only " + std::to_string( count )
+				+ " of " + std::to_string( bgenView.number_of_variants() ) + " variants could be read."
+			) ;
+		}
 	}
 	
 	std::vector< uint64_t > compute_bgen_v11_probability_encoding_table() const {
@@ -1114,34 +1168,6 @@ private:
 		}
 		return result ;
 	}
-	
-	genfile::bgen::IndexQuery::GenomicRange parse_range( std::string const& spec ) const {
-		std::size_t colon_pos = spec.find( ':' ) ;
-		if ( colon_pos == std::string::npos ) {
-			throw std::invalid_argument( "spec=\"" + spec + "\"" ) ;
-		}
-
-		std::vector< std::string > pieces ;
-		pieces.push_back( spec.substr( 0, colon_pos )) ;
-		pieces.push_back( spec.substr( colon_pos+1, spec.size() )) ;
-
-		if( pieces.size() != 2 ) {
-			throw std::invalid_argument( "spec=\"" + spec + "\"" ) ;
-		}
-
-		std::size_t separator_pos = pieces[1].find( '-' ) ;
-		if ( separator_pos == std::string::npos ) {
-			throw std::invalid_argument( "spec=\"" + spec + "\"" ) ;
-		}
-
-		std::string chromosome( pieces[0] ) ;
-		int pos1 = (separator_pos == 0) ? 0 : std::stoi( pieces[1].substr( 0, separator_pos ) ) ;
-		int pos2 = (separator_pos == (pieces[1].size()-1)) ? std::numeric_limits< int >::max() : std::stoi( pieces[1].substr( separator_pos + 1, pieces[1].size() ) ) ;
-		assert( pos1 >= 0 ) ;
-		assert( pos2 >= pos1 ) ;
-
-		return genfile::bgen::IndexQuery::GenomicRange( chromosome, pos1, pos2 ) ;
-	}	
 } ;
 
 int main( int argc, char** argv ) {
@@ -0,0 +1,172 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <sstream>
+#include <filesystem>
+#include <fmt/format.h>
+#include "genfile/bgen.hpp"
+#include "genfile/View.hpp"
+#include "genfile/dosage.hpp"
+#include "genfile/DosageSidecar.hpp"
+#include "appcontext/CmdLineOptionProcessor.hpp"
+#include "appcontext/ApplicationContext.hpp"
+#include "config.h"
+
+namespace globals {
+	std::string const program_name = "cache-bgen" ;
+	std::string const program_version = bgen_revision ;
+}
+
+struct CacheBgenOptionProcessor: public appcontext::CmdLineOptionProcessor
+{
+public:
+	std::string get_program_name() const { return globals::program_name ; }
+
+	void declare_options( appcontext::OptionProcessor& options ) {
+		// Meta-options
+		options.set_help_option( "-help" ) ;
+
+		options.declare_group( "Input / output file options" ) ;
+		options[ "-g" ]
+			.set_description(
+				"Path of bgen file to compute dosages for."
+			)
+			.set_takes_single_value()
+			.set_is_required()
+		;
+
+		options[ "-o" ]
+			.set_description(
+				"Path of dosage sidecar file to write.  If not specified, this defaults to"
+				" the bgen filename with \".dosage\" appended, which is where the bgen View"
+				" will look for it."
+			)
+			.set_takes_single_value()
+		;
+
+		options[ "-type" ]
+			.set_description(
+				"Type of values to store.  This must be \"uint8\" (dosages scaled by 127 and rounded,"
+				" with 255 representing missing data) or \"float16\" (IEEE half-precision)."
+			)
+			.set_takes_single_value()
+			.set_default_value( "uint8" )
+		;
+
+		options[ "-clobber" ]
+			.set_description(
+				"Specify that cache-bgen should overwrite an existing sidecar file if it exists."
+			)
+		;
+	}
+} ;
+
+struct CacheBgenApplication: public appcontext::ApplicationContext
+{
+public:
+	CacheBgenApplication( int argc, char** argv ):
+		appcontext::ApplicationContext(
+			globals::program_name,
+			globals::program_version,
+			std::make_unique<CacheBgenOptionProcessor>(),
+			argc,
+			argv,
+			"-log"
+		)
+	{
+		std::string const bgen_filename = options().get< std::string >( "-g" ) ;
+		std::string const sidecar_filename = options().check( "-o" )
+			? options().get< std::string >( "-o" )
+			: genfile::bgen::DosageSidecar::default_filename( bgen_filename ) ;
+
+		if( !options().check( "-clobber" ) && std::filesystem::exists( sidecar_filename ) ) {
+			ui().logger() << "Output file \"" << sidecar_filename << "\" exists.  Use -clobber if you want me to overwrite it.\n" ;
+			throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+		}
+
+		std::string const type = options().get< std::string >( "-type" ) ;
+		if( type != "uint8" && type != "float16" ) {
+			ui().logger() << "!! Error: -type must be \"uint8\" or \"float16\".\n" ;
+			throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+		}
+
+		genfile::bgen::View::UniquePtr view = genfile::bgen::View::create( bgen_filename ) ;
+		// Always compute values from the bgen data itself.
+		view->clear_dosage_sidecar() ;
+		{
+			std::ostringstream summary ;
+			view->summarise( summary ) ;
+			ui().logger() << summary.str() ;
+		}
+
+		if( ( view->context().flags & genfile::bgen::e_Layout ) != genfile::bgen::e_Layout2 ) {
+			ui().logger() << "!! Warning: \"" << bgen_filename << "\" is not a layout 2 file; computing dosages will be slow.\n" ;
+		}
+
+		std::size_t number_of_rows = 0 ;
+		if( type == "uint8" ) {
+			number_of_rows = write_sidecar< uint8_t >( *view, sidecar_filename, genfile::bgen::DosageSidecar::eUInt8 ) ;
+		} else {
+			number_of_rows = write_sidecar< genfile::float16_t >( *view, sidecar_filename, genfile::bgen::DosageSidecar::eFloat16 ) ;
+		}
+
+		ui().logger() << fmt::format(
+			"Finished writing \"{}\" ({} samples, {} of {} variants).\n",
+			sidecar_filename,
+			view->number_of_samples(),
+			number_of_rows,
+			view->number_of_variants()
+		) ;
+		if( number_of_rows < view->number_of_variants() ) {
+			ui().logger() << "Note: variants with other than two alleles are not stored in the sidecar.\n" ;
+		}
+	}
+
+private:
+	template< typename T >
+	std::size_t write_sidecar(
+		genfile::bgen::View& view,
+		std::string const& filename,
+		genfile::bgen::DosageSidecar::ValueType type
+	) {
+		genfile::bgen::DosageSidecarWriter writer( filename, view.file_metadata(), view.number_of_samples(), type ) ;
+
+		std::string SNPID, rsid, chromosome ;
+		uint32_t position ;
+		std::vector< std::string > alleles ;
+		std::vector< T > dosages ;
+
+		auto progress_context = ui().get_progress_context( "Computing dosages" ) ;
+		std::size_t variant_count = 0 ;
+		std::streampos file_pos = view.current_file_position() ;
+		while( view.read_variant( &SNPID, &rsid, &chromosome, &position, &alleles )) {
+			if( alleles.size() == 2 ) {
+				view.read_dosage_data_block( &dosages ) ;
+				writer.write_row( file_pos, dosages.data() ) ;
+			} else {
+				view.ignore_genotype_data_block() ;
+			}
+			file_pos = view.current_file_position() ;
+			progress_context( ++variant_count, view.number_of_variants() ) ;
+		}
+		writer.finalise() ;
+		return writer.number_of_rows() ;
+	}
+} ;
+
+int main( int argc, char** argv ) {
+	std::ios_base::sync_with_stdio( false ) ;
+	try {
+		CacheBgenApplication app( argc, argv ) ;
+	}
+	catch( appcontext::HaltProgramWithReturnCode const& e ) {
+		return e.return_code() ;
+	}
+	return 0 ;
+}
@@ -41,7 +41,8 @@ public:
 
 	    options[ "-og" ]
 	        .set_description(
-				"Path of bgen file to output."
+				"Path of bgen file to output, or \"-\" to write to stdout (e.g. to a pipe).  The output is written"
+				" strictly sequentially."
 			)
 			.set_takes_single_value()
 		.set_is_required()
@@ -82,7 +83,10 @@ public:
 			"-log"
 		)
 	{
-		if( !options().check( "-clobber" ) && std::filesystem::exists( options().get< std::string >( "-og" ) ) ) {
+		if(
+			!options().check( "-clobber" ) && options().get< std::string >( "-og" ) != "-"
+			&& std::filesystem::exists( options().get< std::string >( "-og" ) )
+		) {
 			ui().logger() << "Output file \"" <<  options().get< std::string >( "-og" ) << "\" exists.  Use -clobber if you want me to overwrite it.\n" ;
 			throw appcontext::HaltProgramWithReturnCode( -1 ) ;
 		}
@@ -103,12 +107,24 @@ public:
                 //   inputStreams.emplace_back(std::make_unique<std::istream>(inputFilenames[i], std::ios::binary ));
 		// }
 		
-		std::ofstream outputStream( options().get< std::string > ( "-og" ).c_str(), std::ios::binary ) ;
+		std::string const outputFilename = options().get< std::string > ( "-og" ) ;
+		std::unique_ptr< std::ofstream > outputFile ;
+		if( outputFilename != "-" ) {
+			outputFile.reset( new std::ofstream( outputFilename.c_str(), std::ios::binary )) ;
+		}
+		std::ostream& outputStream = outputFile.get() ? *outputFile : std::cout ;
 		genfile::bgen::Context result = concatenate( inputFilenames, inputStreams, outputStream ) ;
+		outputStream.flush() ;
+		if( !outputStream ) {
+			ui().logger() << "!! Error: an error occurred writing to \"" << outputFilename << "\".\n" ;
+			throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+		}
 		ui().logger() << fmt::format( "Finished writing \"{}\" ({} samples, {} variants).\n",
-                                              options().get< std::string > ( "-og" ) ,
+                                              outputFilename ,
                                               result.number_of_samples ,
-                                              result.number_of_variants) ;
+                                              ( result.number_of_variants == genfile::bgen::e_UnknownNumberOfVariants )
+                                              ? std::string( "unknown number of" )
+                                              : std::to_string( result.number_of_variants )) ;
 	}
 
 private:
@@ -116,7 +132,7 @@ private:
 	genfile::bgen::Context concatenate(
 		std::vector< std::string > const& inputFilenames,
 		std::vector<std::unique_ptr< std::ifstream >>& inputFiles,
-		std::ofstream& outputFile
+		std::ostream& outputFile
 	) const {
 		using namespace genfile ;
 		assert( inputFiles.size() > 0 ) ;
@@ -129,6 +145,7 @@ private:
 			uint32_t offset = 0 ;
 			bgen::read_offset( *inputFiles[0], &offset ) ;
 			bgen::read_header_block( *inputFiles[0], &resultContext ) ;
+			std::vector< uint32_t > numbersOfVariants( 1, resultContext.number_of_variants ) ;
 
 			ui().logger() << fmt::format( "Adding file \"{}\" ({} of {}, {} variants)...\n",
                                                       inputFilenames[0],
@@ -148,6 +165,41 @@ private:
 				resultContext.free_data = newFreeData ;
 			}
 			
+			// Read the remaining headers before writing anything, so that the header can be written with
+			// the total number of variants and the output need not be seekable.
+			std::vector< uint32_t > offsets( inputFiles.size(), 0 ) ;
+			for( std::size_t i = 1; i < inputFiles.size(); ++i ) {
+				bgen::Context context ;
+				bgen::read_offset( *inputFiles[i], &offsets[i] ) ;
+				bgen::read_header_block( *inputFiles[i], &context ) ;
+
+				if( context.number_of_samples != resultContext.number_of_samples ) {
+					ui().logger()
+						<< fmt::format( "Error: input file #{} ( \"{}\" ) has the wrong number of samples ({}, expected {}).  Quitting.\n"
+	                                                        , (i+1) , inputFilenames[i] , context.number_of_samples , resultContext.number_of_samples);
+					throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+				}
+				
+				if( context.flags != resultContext.flags ) {
+					ui().logger()
+	                                  << fmt::format( "Error: input file #{} ( \"{}\" ) has the wrong flags ({}, expected {}).  Quitting.\n",(i+1) , inputFilenames[i] , context.flags , resultContext.flags);
+					throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+				}
+
+				numbersOfVariants.push_back( context.number_of_variants ) ;
+				if(
+					context.number_of_variants == bgen::e_UnknownNumberOfVariants
+					|| resultContext.number_of_variants == bgen::e_UnknownNumberOfVariants
+				) {
+					resultContext.number_of_variants = bgen::e_UnknownNumberOfVariants ;
+				} else if( uint64_t( resultContext.number_of_variants ) + context.number_of_variants >= bgen::e_UnknownNumberOfVariants ) {
+					ui().logger() << "Error: the input files contain too many variants to store in one bgen file.  Quitting.\n" ;
+					throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+				} else {
+					resultContext.number_of_variants += context.number_of_variants ;
+				}
+			}
+
 			// Copy the header 
 			bgen::write_offset( outputFile, offset ) ;
 			bgen::write_header_block( outputFile, resultContext ) ;
@@ -157,47 +209,24 @@ private:
 
 			// Copy everything else
 			std::copy( inIt, endInIt, outIt ) ;
-		}
-		
-		for( std::size_t i = 1; i < inputFiles.size(); ++i ) {
-			bgen::Context context ;
-			uint32_t offset = 0 ;
-			bgen::read_offset( *inputFiles[i], &offset ) ;
-			bgen::read_header_block( *inputFiles[i], &context ) ;
 
-			ui().logger() << fmt::format( "Adding file \"{}\" ({} of {}, {} variants)...\n",
-                                                      inputFilenames[i],
-                                                      (i+1),
-                                                      inputFiles.size(),
-                                                      context.number_of_variants);
+			for( std::size_t i = 1; i < inputFiles.size(); ++i ) {
+				ui().logger() << fmt::format( "Adding file \"{}\" ({} of {}, {} variants)...\n",
+	                                                      inputFilenames[i],
+	                                                      (i+1),
+	                                                      inputFiles.size(),
+	                                                      numbersOfVariants[i]);
 
-			if( context.number_of_samples != resultContext.number_of_samples ) {
-				ui().logger()
-					<< fmt::format( "Error: input file #{} ( \"{}\" ) has the wrong number of samples ({}, expected {}).  Quitting.\n"
-                                                        , (i+1) , inputFilenames[i] , context.number_of_samples , resultContext.number_of_samples);
-				throw appcontext::HaltProgramWithReturnCode( -1 ) ;
-			}
-			
-			if( context.flags != resultContext.flags ) {
-				ui().logger()
-                                  << fmt::format( "Error: input file #{} ( \"{}\" ) has the wrong flags ({}, expected {}).  Quitting.\n",(i+1) , inputFilenames[i] , context.flags , resultContext.flags);
-				throw appcontext::HaltProgramWithReturnCode( -1 ) ;
-			}
-			
-			// Seek forwards to data
-			inputFiles[i]->seekg( offset + 4 ) ;
+				// Seek forwards to data
+				inputFiles[i]->seekg( offsets[i] + 4 ) ;
 
-			// Copy all the data
-			std::istreambuf_iterator< char > inIt( *inputFiles[i] ) ;
-			std::istreambuf_iterator< char > endInIt ;
-			std::copy( inIt, endInIt, outIt ) ;
-			
-			resultContext.number_of_variants += context.number_of_variants ;
+				// Copy all the data
+				std::istreambuf_iterator< char > inIt( *inputFiles[i] ) ;
+				std::istreambuf_iterator< char > endInIt ;
+				std::copy( inIt, endInIt, outIt ) ;
+			}
 		}
 		
-		// Finally fix the number of variants in the header.  This starts at byte 8...
-		outputFile.seekp( 4 ) ;
-		bgen::write_header_block( outputFile, resultContext ) ;
 		return resultContext ;
 	}
 
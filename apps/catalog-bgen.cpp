@@ -0,0 +1,310 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <fmt/format.h>
+#include "genfile/bgen.hpp"
+#include "genfile/View.hpp"
+#include "genfile/Writer.hpp"
+#include "genfile/IndexQuery.hpp"
+#include "genfile/query_spec.hpp"
+#include "genfile/IndexWriter.hpp"
+#include "appcontext/CmdLineOptionProcessor.hpp"
+#include "appcontext/ApplicationContext.hpp"
+#include "config.h"
+
+namespace globals {
+	std::string const program_name = "catalog-bgen" ;
+	std::string const program_version = bgen_revision ;
+}
+
+struct CatalogBgenOptionProcessor: public appcontext::CmdLineOptionProcessor
+{
+public:
+	std::string get_program_name() const { return globals::program_name ; }
+
+	void declare_options( appcontext::OptionProcessor& options ) {
+		// Meta-options
+		options.set_help_option( "-help" ) ;
+
+		options.declare_group( "Input / output file options" ) ;
+		options[ "-catalog" ]
+			.set_description(
+				"Path of catalog file to create or query."
+			)
+			.set_takes_single_value()
+			.set_is_required()
+		;
+		options[ "-g" ]
+			.set_description(
+				"Create a catalog covering the given bgen files.  Each file must have a bgenix index,"
+				" with \".bgi\" appended to the filename."
+			)
+			.set_takes_values_until_next_option()
+		;
+		options[ "-og" ]
+			.set_description(
+				"Write the selected variants to the given bgen file, rather than listing them."
+				" All files in the selection must have the same samples and flags."
+			)
+			.set_takes_single_value()
+		;
+		options[ "-clobber" ]
+			.set_description(
+				"Specify that catalog-bgen should overwrite existing output files if they exist."
+			)
+		;
+
+		options.declare_group( "Variant selection options" ) ;
+		options[ "-incl-range" ]
+			.set_description(
+				"Include variants in the specified genomic interval(s) in the output."
+				" Each interval must be of the form <chr>:<pos1>-<pos2> where <chr> is a chromosome identifier"
+				" and pos1 and pos2 are positions with pos2 >= pos1."
+				" One of pos1 and pos2 can also be omitted, in which case the range extends to the start or"
+				" end of the chromosome as appropriate."
+				" Position ranges are treated as closed (i.e. <pos1> and <pos2> are included in the range)."
+				"If this is specified multiple times, variants in any of the specified ranges will be included."
+			)
+			.set_takes_values_until_next_option()
+		;
+		options[ "-incl-rsids" ]
+			.set_description(
+				"Include variants with the specified rsid(s) in the output."
+				" Each value can be an rsid or the name of a file containing whitespace-separated rsids."
+			)
+			.set_takes_values_until_next_option()
+		;
+		options[ "-incl-positions" ]
+			.set_description(
+				"Include variants at the specified position(s) in the output."
+				" Each value can be of the form <chr>:<pos> or <chr>:<pos>:<allele1>:<allele2>,"
+				" or the name of a file containing such values separated by whitespace."
+			)
+			.set_takes_values_until_next_option()
+		;
+
+		options.option_excludes_option( "-g", "-og" ) ;
+		options.option_excludes_option( "-g", "-incl-range" ) ;
+		options.option_excludes_option( "-g", "-incl-rsids" ) ;
+		options.option_excludes_option( "-g", "-incl-positions" ) ;
+	}
+} ;
+
+struct CatalogBgenApplication: public appcontext::ApplicationContext
+{
+public:
+	CatalogBgenApplication( int argc, char** argv ):
+		appcontext::ApplicationContext(
+			globals::program_name,
+			globals::program_version,
+			std::make_unique<CatalogBgenOptionProcessor>(),
+			argc,
+			argv,
+			"-log"
+		)
+	{
+		try {
+			if( options().check( "-g" )) {
+				create_catalog(
+					options().get< std::string >( "-catalog" ),
+					options().get_values< std::string >( "-g" )
+				) ;
+			} else {
+				genfile::bgen::CatalogIndexQuery::UniquePtr query = create_query( options().get< std::string >( "-catalog" )) ;
+				if( options().check( "-og" )) {
+					write_selection( *query, options().get< std::string >( "-og" )) ;
+				} else {
+					list_selection( *query ) ;
+				}
+			}
+		} catch( std::invalid_argument const& e ) {
+			ui().logger() << "!! Error: " << e.what() << "\n" ;
+			throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+		}
+	}
+
+private:
+	void check_output_file( std::string const& filename ) const {
+		if( !options().check( "-clobber" ) && std::filesystem::exists( filename )) {
+			ui().logger() << "!! Error: output file \"" << filename << "\" exists.  Use -clobber if you want me to overwrite it.\n" ;
+			throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+		}
+	}
+
+	void create_catalog( std::string const& catalog_filename, std::vector< std::string > const& bgen_filenames ) {
+		check_output_file( catalog_filename ) ;
+		if( options().check( "-clobber" )) {
+			std::filesystem::remove( catalog_filename + ".tmp" ) ;
+		}
+		genfile::bgen::CatalogWriter writer( catalog_filename ) ;
+		std::size_t total = 0 ;
+		auto progress_context = ui().get_progress_context( "Adding files" ) ;
+		for( std::size_t i = 0; i < bgen_filenames.size(); ++i ) {
+			std::string const& bgen_filename = bgen_filenames[i] ;
+			genfile::bgen::View::UniquePtr view = genfile::bgen::View::create( bgen_filename ) ;
+			total += writer.add_file( bgen_filename, bgen_filename + ".bgi", view->file_metadata() ) ;
+			progress_context( i + 1, bgen_filenames.size() ) ;
+		}
+		writer.finalise() ;
+		ui().logger() << fmt::format(
+			"Finished writing \"{}\" ({} files, {} variants).\n",
+			catalog_filename, writer.number_of_files(), total
+		) ;
+	}
+
+	genfile::bgen::CatalogIndexQuery::UniquePtr create_query( std::string const& filename ) const {
+		genfile::bgen::CatalogIndexQuery::UniquePtr query( new genfile::bgen::CatalogIndexQuery( filename )) ;
+		if( options().check( "-incl-range" )) {
+			auto const elts = genfile::bgen::collect_unique_ids( options().get_values< std::string >( "-incl-range" ));
+			for( std::string const& elt: elts ) {
+				query->include_range( genfile::bgen::parse_range( elt )) ;
+			}
+		}
+		if( options().check( "-incl-rsids" )) {
+			query->include_rsids( genfile::bgen::collect_unique_ids( options().get_values< std::string >( "-incl-rsids" ))) ;
+		}
+		if( options().check( "-incl-positions" )) {
+			auto const elts = genfile::bgen::collect_unique_ids( options().get_values< std::string >( "-incl-positions" ));
+			std::vector< genfile::bgen::IndexQuery::VariantPosition > positions ;
+			positions.reserve( elts.size() ) ;
+			for( std::string const& elt: elts ) {
+				positions.push_back( genfile::bgen::parse_position( elt )) ;
+			}
+			query->include_positions( positions ) ;
+		}
+		{
+			auto progress_context = ui().get_progress_context( "Building query" ) ;
+			query->initialise( progress_context ) ;
+		}
+		return query ;
+	}
+
+	void list_selection( genfile::bgen::CatalogIndexQuery const& query ) const {
+		std::cout << "filename\tfile_start_position\tsize_in_bytes\n" ;
+		for( std::size_t i = 0; i < query.number_of_variants(); ++i ) {
+			genfile::bgen::IndexQuery::FileRange const range = query.locate_variant( i ) ;
+			std::cout << query.filename( query.locate_file( i )) << "\t" << range.first << "\t" << range.second << "\n" ;
+		}
+		std::cout << "# " << query.number_of_variants() << " variants in " << query.number_of_files() << " files.\n" ;
+	}
+
+	// Copy the selected variants to a new bgen file.  Variants are grouped by file and sorted by
+	// position in each file, so each source file is read sequentially, and variant data is copied
+	// without decompression.
+	void write_selection( genfile::bgen::CatalogIndexQuery const& query, std::string const& bgen_filename ) const {
+		check_output_file( bgen_filename ) ;
+		if( query.number_of_variants() == 0 ) {
+			throw std::invalid_argument( "No variants were selected." ) ;
+		}
+
+		genfile::bgen::Writer::UniquePtr writer ;
+		genfile::bgen::Context context ;
+		std::vector< std::string > sample_ids ;
+		auto progress_context = ui().get_progress_context( "Writing variants" ) ;
+		try {
+			copy_variants( query, bgen_filename, &writer, &context, &sample_ids, progress_context ) ;
+		} catch( std::invalid_argument const& ) {
+			if( writer.get() ) {
+				writer.reset() ;
+				std::filesystem::remove( bgen_filename ) ;
+			}
+			throw ;
+		}
+		writer->finalise() ;
+		ui().logger() << fmt::format(
+			"Finished writing \"{}\" ({} samples, {} variants).\n",
+			bgen_filename, context.number_of_samples, writer->number_of_variants()
+		) ;
+	}
+
+	void copy_variants(
+		genfile::bgen::CatalogIndexQuery const& query,
+		std::string const& bgen_filename,
+		genfile::bgen::Writer::UniquePtr* writer_ptr,
+		genfile::bgen::Context* context_ptr,
+		std::vector< std::string >* sample_ids_ptr,
+		appcontext::UIContext::ProgressContext const& progress_context
+	) const {
+		genfile::bgen::Writer::UniquePtr& writer = *writer_ptr ;
+		genfile::bgen::Context& context = *context_ptr ;
+		std::vector< std::string >& sample_ids = *sample_ids_ptr ;
+		std::vector< genfile::byte_t > buffer ;
+		for( std::size_t i = 0; i < query.number_of_variants(); ) {
+			std::size_t const file_i = query.locate_file( i ) ;
+			std::string const& filename = query.filename( file_i ) ;
+			genfile::bgen::View::UniquePtr view = genfile::bgen::View::create( filename ) ;
+			check_file_metadata( view->file_metadata(), query.file_metadata( file_i )) ;
+			std::vector< std::string > const these_sample_ids = get_sample_ids( *view ) ;
+			if( !writer.get() ) {
+				context = view->context() ;
+				sample_ids = these_sample_ids ;
+				writer = genfile::bgen::Writer::create( bgen_filename, context, sample_ids ) ;
+			} else if(
+				view->context().flags != context.flags
+				|| view->context().number_of_samples != context.number_of_samples
+				|| these_sample_ids != sample_ids
+			) {
+				throw std::invalid_argument(
+					"\"" + filename + "\" does not have the same samples and flags as \"" + query.filename( query.locate_file( 0 )) + "\"."
+				) ;
+			}
+			view.reset() ;
+
+			std::ifstream stream( filename, std::ios::binary ) ;
+			for( ; i < query.number_of_variants() && query.locate_file( i ) == file_i; ++i ) {
+				genfile::bgen::IndexQuery::FileRange const range = query.locate_variant( i ) ;
+				buffer.resize( range.second ) ;
+				stream.seekg( range.first ) ;
+				stream.read( reinterpret_cast< char* >( buffer.data() ), range.second ) ;
+				if( !stream ) {
+					throw std::invalid_argument( "An error occurred reading from \"" + filename + "\"." ) ;
+				}
+				writer->write_encoded_variant( buffer.data(), buffer.data() + buffer.size() ) ;
+				progress_context( i + 1, query.number_of_variants() ) ;
+			}
+		}
+	}
+
+	// Check that a file has not changed since it was added to the catalog.
+	void check_file_metadata(
+		genfile::bgen::IndexQuery::FileMetadata const& file,
+		genfile::bgen::IndexQuery::FileMetadata const& catalog
+	) const {
+		if( file.size != catalog.size || file.first_bytes != catalog.first_bytes ) {
+			throw std::invalid_argument(
+				"\"" + file.filename + "\" has changed since it was added to the catalog."
+			) ;
+		}
+	}
+
+	// Return the sample identifiers stored in the file, or an empty vector if there are none.
+	std::vector< std::string > get_sample_ids( genfile::bgen::View const& view ) const {
+		std::vector< std::string > result ;
+		if( view.context().flags & genfile::bgen::e_SampleIdentifiers ) {
+			view.get_sample_ids( [&result]( std::string const& id ) { result.push_back( id ) ; } ) ;
+		}
+		return result ;
+	}
+} ;
+
+int main( int argc, char** argv ) {
+	std::ios_base::sync_with_stdio( false ) ;
+	try {
+		CatalogBgenApplication app( argc, argv ) ;
+	}
+	catch( appcontext::HaltProgramWithReturnCode const& e ) {
+		return e.return_code() ;
+	}
+	return 0 ;
+}
@@ -0,0 +1,511 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <limits>
+#include <fmt/format.h>
+#include "genfile/bgen.hpp"
+#include "genfile/Buffer.hpp"
+#include "genfile/check.hpp"
+#include "genfile/ForwardOnlyStreamBuf.hpp"
+#include "genfile/IndexQuery.hpp"
+#include "genfile/ThreadPool.hpp"
+#include "appcontext/CmdLineOptionProcessor.hpp"
+#include "appcontext/ApplicationContext.hpp"
+#include "config.h"
+
+namespace globals {
+	std::string const program_name = "check-bgen" ;
+	std::string const program_version = bgen_revision ;
+}
+
+struct CheckBgenOptionProcessor: public appcontext::CmdLineOptionProcessor
+{
+public:
+	std::string get_program_name() const { return globals::program_name ; }
+
+	void declare_options( appcontext::OptionProcessor& options ) {
+		// Meta-options
+		options.set_help_option( "-help" ) ;
+
+		options.declare_group( "Input file options" ) ;
+		options[ "-g" ]
+			.set_description(
+				"Paths of bgen files to check.  Each file's bgenix index, with \".bgi\" appended to the filename,"
+				" is also checked if it exists.  A path of \"-\" means standard input; this, and pipes, are read"
+				" as a stream, and their indexes are not checked."
+			)
+			.set_takes_values_until_next_option()
+			.set_is_required()
+		;
+		options[ "-no-index" ]
+			.set_description(
+				"Do not check bgenix index files."
+			)
+		;
+
+		options.declare_group( "Check options" ) ;
+		options[ "-tolerance" ]
+			.set_description(
+				"Tolerance allowed when checking that probabilities lie between 0 and 1 and sum to one."
+			)
+			.set_takes_single_value()
+			.set_default_value( 0.0001 )
+		;
+		options[ "-max-problems" ]
+			.set_description(
+				"Maximum number of problems to report for each file."
+			)
+			.set_takes_single_value()
+			.set_default_value( 20 )
+		;
+
+		options.declare_group( "Miscellaneous options" ) ;
+		options[ "-threads" ]
+			.set_description(
+				"Number of threads to use for checking genotype data.  Zero means use all available cores."
+			)
+			.set_takes_single_value()
+			.set_default_value( 0 )
+		;
+		options[ "-chunk-size" ]
+			.set_description(
+				"Number of variants handed to each worker thread at a time."
+			)
+			.set_takes_single_value()
+			.set_default_value( 256 )
+		;
+	}
+} ;
+
+namespace {
+	using genfile::byte_t ;
+
+	// A variant as read by the scan of a file.
+	typedef genfile::bgen::CheckedVariant Variant ;
+	typedef genfile::bgen::FileProblem Problem ;
+	using genfile::bgen::describe ;
+
+	// An entry in the index, identified by its identifying data.
+	struct IndexEntry {
+		int64_t offset ;
+		int64_t size ;
+		uint32_t position ;
+		std::size_t key ;
+		bool operator<( IndexEntry const& other ) const { return offset < other.offset ; }
+	} ;
+
+	// Hash the identifying data stored for a variant in the index.
+	std::size_t index_key( std::string_view chromosome, std::string_view rsid, std::string_view allele1, std::string_view allele2 ) {
+		std::string key ;
+		key.append( chromosome ).append( 1, '\0' ).append( rsid ).append( 1, '\0' ).append( allele1 ).append( 1, '\0' ).append( allele2 ) ;
+		return std::hash< std::string >()( key ) ;
+	}
+
+	// Setter checking that probabilities are in range and sum to one.
+	// (In layout 1, probabilities may sum to less than one.)
+	struct ProbabilityChecker {
+		ProbabilityChecker( double tolerance, bool allow_sum_less_than_one ):
+			m_tolerance( tolerance ),
+			m_allow_sum_less_than_one( allow_sum_less_than_one )
+		{}
+		void initialise( std::size_t, std::size_t number_of_alleles ) {
+			m_number_of_alleles = number_of_alleles ;
+			m_problem.clear() ;
+		}
+		bool set_sample( std::size_t i ) {
+			m_sample_i = i ;
+			return m_problem.empty() ;
+		}
+		void set_number_of_entries( std::size_t, std::size_t number_of_entries, genfile::OrderType order_type, genfile::ValueType ) {
+			m_group_size = ( order_type == genfile::ePerPhasedHaplotypePerAllele ) ? m_number_of_alleles : number_of_entries ;
+			m_sum = 0 ;
+		}
+		void set_value( uint32_t entry_i, double value ) {
+			if( !( value >= -m_tolerance && value <= 1 + m_tolerance )) {
+				report( fmt::format( "probability {} is out of range", value )) ;
+			}
+			m_sum += value ;
+			if(( entry_i + 1 ) % m_group_size == 0 ) {
+				if( m_sum > 1 + m_tolerance || ( !m_allow_sum_less_than_one && m_sum < 1 - m_tolerance )) {
+					report( fmt::format( "probabilities sum to {}", m_sum )) ;
+				}
+				m_sum = 0 ;
+			}
+		}
+		void set_value( uint32_t, genfile::MissingValue ) {}
+		void finalise() {}
+
+		// Return a description of the first problem found, or an empty string.
+		std::string const& problem() const { return m_problem ; }
+
+	private:
+		double const m_tolerance ;
+		bool const m_allow_sum_less_than_one ;
+		std::size_t m_number_of_alleles ;
+		std::size_t m_sample_i ;
+		std::size_t m_group_size ;
+		double m_sum ;
+		std::string m_problem ;
+
+		void report( std::string const& message ) {
+			if( m_problem.empty() ) {
+				m_problem = fmt::format( "sample {}: {}", m_sample_i + 1, message ) ;
+			}
+		}
+	} ;
+
+	// Checks the genotype data and index entries of variants.
+	// check() is const and may be called concurrently from several threads.
+	struct Checker {
+	public:
+		Checker(
+			genfile::bgen::Context const& context,
+			double tolerance,
+			std::vector< IndexEntry > const* index,
+			std::vector< char >* index_matched
+		):
+			m_context( context ),
+			m_tolerance( tolerance ),
+			m_index( index ),
+			m_index_matched( index_matched )
+		{}
+
+		std::vector< Problem > check( std::vector< Variant > const& variants ) const {
+			std::vector< Problem > result ;
+			genfile::Buffer buffer ;
+			ProbabilityChecker checker(
+				m_tolerance,
+				( m_context.flags & genfile::bgen::e_Layout ) == genfile::bgen::e_Layout1
+			) ;
+			for( Variant const& variant: variants ) {
+				std::string const problem = check( variant, &checker, &buffer ) ;
+				if( problem != "" ) {
+					result.push_back( Problem{ describe( variant ), problem } ) ;
+				}
+				if( m_index ) {
+					std::string const index_problem = check_index( variant ) ;
+					if( index_problem != "" ) {
+						result.push_back( Problem{ describe( variant ), index_problem } ) ;
+					}
+				}
+			}
+			return result ;
+		}
+
+	private:
+		genfile::bgen::Context const m_context ;
+		double const m_tolerance ;
+		std::vector< IndexEntry > const* m_index ;
+		// Each variant is checked by one thread only, so threads set distinct elements of this.
+		std::vector< char >* m_index_matched ;
+
+	private:
+		std::string check( Variant const& variant, ProbabilityChecker* checker, genfile::Buffer* buffer ) const {
+			bool const layout2 = ( m_context.flags & genfile::bgen::e_Layout ) == genfile::bgen::e_Layout2 ;
+			try {
+				genfile::bgen::uncompress_probability_data( m_context, variant.data, buffer ) ;
+			} catch( std::exception const& ) {
+				return "genotype data block could not be uncompressed" ;
+			}
+			if( layout2 ) {
+				std::string const problem = genfile::bgen::check_layout2_block( *buffer, m_context, variant.alleles.size() ) ;
+				if( problem != "" ) {
+					return problem ;
+				}
+			} else if( buffer->size() != 6 * m_context.number_of_samples ) {
+				return fmt::format( "genotype data block is {} bytes, but {} bytes were expected", buffer->size(), 6 * m_context.number_of_samples ) ;
+			}
+			try {
+				genfile::bgen::parse_probability_data( &(*buffer)[0], &(*buffer)[0] + buffer->size(), m_context, *checker ) ;
+			} catch( genfile::bgen::BGenError const& ) {
+				return "genotype data could not be parsed" ;
+			}
+			return checker->problem() ;
+		}
+
+		std::string check_index( Variant const& variant ) const {
+			IndexEntry entry ;
+			entry.offset = variant.offset ;
+			std::vector< IndexEntry >::const_iterator where = std::lower_bound( m_index->begin(), m_index->end(), entry ) ;
+			if( where == m_index->end() || where->offset != variant.offset ) {
+				return "variant is not in the index" ;
+			}
+			(*m_index_matched)[ where - m_index->begin() ] = 1 ;
+			if( where->size != variant.size ) {
+				return fmt::format( "index gives size {} bytes, but the variant occupies {}", where->size, variant.size ) ;
+			}
+			std::size_t const key = index_key(
+				variant.chromosome, variant.rsid,
+				variant.alleles.size() > 0 ? variant.alleles[0] : "",
+				variant.alleles.size() > 1 ? variant.alleles[1] : ""
+			) ;
+			if( where->position != variant.position || where->key != key ) {
+				return "index gives different identifying data for this variant" ;
+			}
+			return "" ;
+		}
+	} ;
+}
+
+struct CheckBgenApplication: public appcontext::ApplicationContext
+{
+public:
+	CheckBgenApplication( int argc, char** argv ):
+		appcontext::ApplicationContext(
+			globals::program_name,
+			globals::program_version,
+			std::make_unique<CheckBgenOptionProcessor>(),
+			argc,
+			argv,
+			"-log"
+		)
+	{
+		std::vector< std::string > const filenames = options().get_values< std::string >( "-g" ) ;
+		genfile::ThreadPool pool( options().get< std::size_t >( "-threads" )) ;
+		std::size_t number_of_bad_files = 0 ;
+		for( std::string const& filename: filenames ) {
+			std::size_t const number_of_problems = check( filename, pool ) ;
+			if( number_of_problems == 0 ) {
+				ui().logger() << "\"" << filename << "\": OK.\n" ;
+			} else {
+				ui().logger() << "\"" << filename << "\": " << number_of_problems << " problem(s) found.\n" ;
+				++number_of_bad_files ;
+			}
+		}
+		if( number_of_bad_files > 0 ) {
+			throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+		}
+	}
+
+private:
+	std::size_t m_number_of_problems ;
+	std::size_t m_max_problems ;
+
+private:
+	void report( std::string const& where, std::string const& message ) {
+		if( m_number_of_problems < m_max_problems ) {
+			std::cout << where << ": " << message << "\n" ;
+		} else if( m_number_of_problems == m_max_problems ) {
+			std::cout << "(further problems are not reported)\n" ;
+		}
+		++m_number_of_problems ;
+	}
+
+	// Check the given file and its index, returning the number of problems found.
+	std::size_t check( std::string const& filename, genfile::ThreadPool& pool ) {
+		m_number_of_problems = 0 ;
+		m_max_problems = options().get< std::size_t >( "-max-problems" ) ;
+		// Standard input ("-") and pipes are read forwards through a buffer that counts the bytes read,
+		// so that offsets can still be reported.  Their size is not known, and any index is not checked.
+		bool const streaming = genfile::is_stream_input( filename ) ;
+		std::ifstream file ;
+		if( filename != "-" ) {
+			file.open( filename, std::ios::binary ) ;
+			if( !file ) {
+				report( filename, "file could not be opened" ) ;
+				return m_number_of_problems ;
+			}
+		}
+		std::unique_ptr< std::streambuf > streambuf ;
+		if( streaming ) {
+			std::size_t const buffer_size = 4 * 1024 * 1024 ;
+			streambuf = ( filename == "-" )
+				? genfile::ForwardOnlyStreamBuf::create( 0, filename, buffer_size )
+				: genfile::ForwardOnlyStreamBuf::create( file, buffer_size ) ;
+		}
+		std::istream stream( streaming ? streambuf.get() : file.rdbuf() ) ;
+		int64_t file_size = genfile::bgen::unknown_file_size ;
+		if( !streaming ) {
+			stream.seekg( 0, std::ios::end ) ;
+			file_size = stream.tellg() ;
+			stream.seekg( 0 ) ;
+		}
+
+		genfile::bgen::Context context ;
+		uint32_t offset = 0 ;
+		if( !check_header( stream, file_size, &context, &offset )) {
+			return m_number_of_problems ;
+		}
+
+		std::unique_ptr< std::vector< IndexEntry > > index ;
+		std::string const index_filename = filename + ".bgi" ;
+		if( !streaming && !options().check( "-no-index" ) && std::filesystem::exists( index_filename )) {
+			index = load_index( index_filename, stream, file_size ) ;
+		}
+		std::vector< char > index_matched( index.get() ? index->size() : 0, 0 ) ;
+
+		// Files streamed without knowing their length record an unknown number of variants,
+		// in which case variants are read up to the end of the file.
+		bool const count_unknown = ( context.number_of_variants == genfile::bgen::e_UnknownNumberOfVariants ) ;
+		ui().logger() << fmt::format(
+			"Checking \"{}\" ({} samples, {} variants{}) using {} threads...\n",
+			filename, context.number_of_samples,
+			count_unknown ? std::string( "an unknown number of" ) : std::to_string( context.number_of_variants ),
+			index.get() ? ", with index" : "", pool.number_of_threads()
+		) ;
+
+		// Variants are read sequentially here, and their genotype data checked by the pool.
+		Checker const checker( context, options().get< double >( "-tolerance" ), index.get(), &index_matched ) ;
+		std::size_t const chunk_size = std::max( options().get< std::size_t >( "-chunk-size" ), std::size_t( 1 )) ;
+		// Genotype data is passed to the checking threads in buffers recycled through this pool,
+		// which is large enough to hold the buffers of all chunks in flight.
+		genfile::BufferPool buffers( ( 2 * pool.number_of_threads() + 1 ) * chunk_size ) ;
+		auto check_chunk = [&checker,&buffers]( std::vector< Variant >& chunk ) {
+			std::vector< Problem > result = checker.check( chunk ) ;
+			for( Variant& variant: chunk ) {
+				buffers.release( std::move( variant.data )) ;
+			}
+			return result ;
+		} ;
+		auto progress_context = ui().get_progress_context( "Checking" ) ;
+		std::size_t number_checked = 0 ;
+		genfile::OrderedTaskQueue< std::vector< Problem > > chunks(
+			pool, 2 * pool.number_of_threads(),
+			[&]( std::vector< Problem > const& problems ) {
+				for( Problem const& problem: problems ) {
+					report( problem.where, problem.message ) ;
+				}
+			}
+		) ;
+		std::vector< Variant > chunk ;
+		std::optional< Problem > read_problem ;
+		if( streaming ) {
+			stream.ignore( int64_t( offset ) + 4 - int64_t( stream.tellg() )) ;
+		} else {
+			stream.seekg( offset + 4 ) ;
+		}
+		for( ; count_unknown || number_checked < context.number_of_variants; ++number_checked ) {
+			if( count_unknown && ( streaming ? ( stream.peek() == std::char_traits< char >::eof() ) : ( int64_t( stream.tellg() ) == file_size ))) {
+				break ;
+			}
+			Variant variant ;
+			variant.index = number_checked ;
+			variant.data = buffers.acquire() ;
+			read_problem = genfile::bgen::read_checked_variant( stream, context, file_size, &variant ) ;
+			if( read_problem ) {
+				break ;
+			}
+			chunk.push_back( std::move( variant )) ;
+			if( chunk.size() == chunk_size ) {
+				chunks.submit( [&check_chunk,chunk = std::move( chunk )]() mutable { return check_chunk( chunk ) ; } ) ;
+				chunk.clear() ;
+				if( count_unknown ) {
+					if( !streaming ) {
+						progress_context( int64_t( stream.tellg() ), file_size ) ;
+					}
+				} else {
+					progress_context( number_checked + 1, context.number_of_variants ) ;
+				}
+			}
+		}
+		if( !chunk.empty() ) {
+			chunks.submit( [&check_chunk,chunk = std::move( chunk )]() mutable { return check_chunk( chunk ) ; } ) ;
+		}
+		chunks.finish() ;
+		if( count_unknown ) {
+			progress_context( streaming ? number_checked : file_size, streaming ? number_checked : file_size ) ;
+		} else {
+			progress_context( number_checked, context.number_of_variants ) ;
+		}
+		progress_context.finish() ;
+		// Report any problem reading the file after the problems found in earlier variants.
+		if( read_problem ) {
+			report( read_problem->where, read_problem->message ) ;
+		}
+
+		if( !read_problem && ( count_unknown || number_checked == context.number_of_variants )) {
+			int64_t trailing = 0 ;
+			if( streaming ) {
+				stream.ignore( std::numeric_limits< std::streamsize >::max() ) ;
+				trailing = stream.gcount() ;
+			} else {
+				trailing = file_size - int64_t( stream.tellg() ) ;
+			}
+			if( trailing != 0 ) {
+				report( "end of file", fmt::format( "{} bytes follow the last variant", trailing )) ;
+			}
+		}
+		if( index.get() ) {
+			std::size_t const unmatched = std::count( index_matched.begin(), index_matched.end(), 0 ) ;
+			if( unmatched > 0 ) {
+				report( "index", fmt::format( "{} index entries do not correspond to variants in the file", unmatched )) ;
+			}
+		}
+		return m_number_of_problems ;
+	}
+
+	// Check the offset, header block and sample identifier block, returning false if the file cannot be read further.
+	bool check_header( std::istream& stream, int64_t const file_size, genfile::bgen::Context* context, uint32_t* offset ) {
+		std::optional< Problem > const problem = genfile::bgen::check_header( stream, file_size, context, offset ) ;
+		if( problem ) {
+			report( problem->where, problem->message ) ;
+		}
+		return !problem ;
+	}
+
+	// Load the index entries, sorted by file offset, after checking the index refers to this file.
+	std::unique_ptr< std::vector< IndexEntry > > load_index( std::string const& index_filename, std::istream& stream, int64_t const file_size ) {
+		std::unique_ptr< std::vector< IndexEntry > > result ;
+		genfile::bgen::IndexQuery::UniquePtr query ;
+		try {
+			query = genfile::bgen::IndexQuery::create( index_filename ) ;
+		} catch( std::exception const& e ) {
+			report( "index", fmt::format( "\"{}\" could not be opened: {}", index_filename, e.what() )) ;
+			return result ;
+		}
+		if( query->file_metadata() ) {
+			genfile::bgen::IndexQuery::FileMetadata const& metadata = *( query->file_metadata() ) ;
+			std::vector< byte_t > first_bytes( std::min< int64_t >( metadata.first_bytes.size(), file_size )) ;
+			stream.seekg( 0 ) ;
+			stream.read( reinterpret_cast< char* >( first_bytes.data() ), first_bytes.size() ) ;
+			if( metadata.size != file_size || first_bytes != metadata.first_bytes ) {
+				report( "index", fmt::format( "\"{}\" was made for a different file, or the file has changed", index_filename )) ;
+			}
+		}
+		result.reset( new std::vector< IndexEntry >() ) ;
+		query->read_variant_batches(
+			1024,
+			[&result]( genfile::bgen::VariantBatch& batch ) {
+				for( std::size_t i = 0; i < batch.size(); ++i ) {
+					IndexEntry entry ;
+					entry.offset = batch.file_offset[i] ;
+					entry.size = batch.file_size[i] ;
+					entry.position = batch.position[i] ;
+					entry.key = index_key(
+						batch.chromosome(i), batch.rsid(i),
+						batch.number_of_stored_alleles(i) > 0 ? batch.allele( i, 0 ) : "",
+						batch.number_of_stored_alleles(i) > 1 ? batch.allele( i, 1 ) : ""
+					) ;
+					result->push_back( entry ) ;
+				}
+			}
+		) ;
+		std::sort( result->begin(), result->end() ) ;
+		return result ;
+	}
+} ;
+
+int main( int argc, char** argv ) {
+	std::ios_base::sync_with_stdio( false ) ;
+	try {
+		CheckBgenApplication app( argc, argv ) ;
+	}
+	catch( appcontext::HaltProgramWithReturnCode const& e ) {
+		return e.return_code() ;
+	}
+	return 0 ;
+}
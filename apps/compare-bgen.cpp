@@ -0,0 +1,285 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <memory>
+#include <filesystem>
+#include <fmt/format.h>
+#include "genfile/bgen.hpp"
+#include "genfile/View.hpp"
+#include "genfile/ViewMerger.hpp"
+#include "genfile/IndexQuery.hpp"
+#include "genfile/ThreadPool.hpp"
+#include "genfile/compare.hpp"
+#include "appcontext/CmdLineOptionProcessor.hpp"
+#include "appcontext/ApplicationContext.hpp"
+#include "config.h"
+
+namespace globals {
+	std::string const program_name = "compare-bgen" ;
+	std::string const program_version = bgen_revision ;
+}
+
+struct CompareBgenOptionProcessor: public appcontext::CmdLineOptionProcessor
+{
+public:
+	std::string get_program_name() const { return globals::program_name ; }
+
+	void declare_options( appcontext::OptionProcessor& options ) {
+		// Meta-options
+		options.set_help_option( "-help" ) ;
+
+		options.declare_group( "Input / output file options" ) ;
+		options[ "-g" ]
+			.set_description(
+				"Paths of the two bgen files to compare.  These must contain the same samples."
+				" Variants are matched on chromosome, position and alleles, using the bgenix index of each"
+				" file if present (with \".bgi\" appended to the filename); otherwise each file must be sorted"
+				" by chromosome and position."
+			)
+			.set_takes_values( 2 )
+			.set_is_required()
+		;
+		options[ "-o" ]
+			.set_description(
+				"Path of file to write per-variant comparisons to.  By default these are written to standard output."
+			)
+			.set_takes_single_value()
+		;
+		options[ "-os" ]
+			.set_description(
+				"Path of file to write per-sample comparisons to."
+			)
+			.set_takes_single_value()
+		;
+
+		options.declare_group( "Miscellaneous options" ) ;
+		options[ "-threads" ]
+			.set_description(
+				"Number of threads to use for decoding and comparison.  Zero means use all available cores."
+			)
+			.set_takes_single_value()
+			.set_default_value( 0 )
+		;
+		options[ "-chunk-size" ]
+			.set_description(
+				"Number of variants handed to each worker thread at a time."
+			)
+			.set_takes_single_value()
+			.set_default_value( 64 )
+		;
+	}
+} ;
+
+namespace {
+	using genfile::bgen::VariantPair ;
+	using genfile::bgen::VariantResult ;
+	using genfile::bgen::SampleAccumulator ;
+
+	// One SampleAccumulator per worker thread, so that workers never contend for per-sample totals.
+	struct ThreadSampleAccumulators {
+	public:
+		ThreadSampleAccumulators( std::size_t number_of_samples ):
+			m_number_of_samples( number_of_samples )
+		{}
+		SampleAccumulator& get() {
+			std::lock_guard< std::mutex > lock( m_mutex ) ;
+			std::unique_ptr< SampleAccumulator >& result = m_accumulators[ std::this_thread::get_id() ] ;
+			if( !result.get() ) {
+				result.reset( new SampleAccumulator( m_number_of_samples )) ;
+			}
+			return *result ;
+		}
+		// Return the totals over all threads.  This must not be called while workers are running.
+		SampleAccumulator total() const {
+			SampleAccumulator result( m_number_of_samples ) ;
+			for( auto const& kv: m_accumulators ) {
+				result.add( *kv.second ) ;
+			}
+			return result ;
+		}
+	private:
+		std::size_t const m_number_of_samples ;
+		std::mutex m_mutex ;
+		std::map< std::thread::id, std::unique_ptr< SampleAccumulator > > m_accumulators ;
+	} ;
+
+	std::string format_value( double value ) {
+		return std::isnan( value ) ? "NA" : fmt::format( "{:.6g}", value ) ;
+	}
+
+	std::string format_ratio( uint64_t numerator, uint64_t denominator ) {
+		return ( denominator == 0 ) ? "NA" : fmt::format( "{:.6g}", double( numerator ) / double( denominator )) ;
+	}
+
+	std::string join( std::vector< std::string > const& values, std::string const& separator ) {
+		std::string result ;
+		for( std::size_t i = 0; i < values.size(); ++i ) {
+			result += ( i > 0 ? separator : "" ) + values[i] ;
+		}
+		return result ;
+	}
+}
+
+struct CompareBgenApplication: public appcontext::ApplicationContext
+{
+public:
+	CompareBgenApplication( int argc, char** argv ):
+		appcontext::ApplicationContext(
+			globals::program_name,
+			globals::program_version,
+			std::make_unique<CompareBgenOptionProcessor>(),
+			argc,
+			argv,
+			"-log"
+		)
+	{
+		try {
+			compare( options().get_values< std::string >( "-g" )) ;
+		} catch( std::invalid_argument const& e ) {
+			ui().logger() << "!! Error: " << e.what() << "\n" ;
+			throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+		} catch( genfile::bgen::BGenError const& e ) {
+			ui().logger() << "!! Error: an error occurred reading genotype data.\n" ;
+			throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+		}
+	}
+
+private:
+	void compare( std::vector< std::string > const& filenames ) {
+		genfile::ThreadPool pool( options().get< std::size_t >( "-threads" )) ;
+		genfile::bgen::ViewMerger merger( &pool ) ;
+		for( std::string const& filename: filenames ) {
+			genfile::bgen::View::UniquePtr view = genfile::bgen::View::create( filename ) ;
+			if( std::filesystem::exists( filename + ".bgi" )) {
+				genfile::bgen::IndexQuery::UniquePtr query = genfile::bgen::IndexQuery::create( filename + ".bgi" ) ;
+				query->initialise() ;
+				view->set_query( std::move( query )) ;
+			} else {
+				ui().logger() << "No index found for \"" << filename << "\"; reading variants in file order.\n" ;
+			}
+			merger.add_source( std::move( view )) ;
+		}
+		std::size_t const number_of_samples = merger.number_of_samples() ;
+
+		std::unique_ptr< std::ostream > output_file ;
+		if( options().check( "-o" )) {
+			output_file = open_output_file( options().get< std::string >( "-o" )) ;
+		}
+		std::ostream& output = output_file.get() ? *output_file : std::cout ;
+		output << "chromosome\tposition\trsid\talleles\tidentical\tcompared\tmissing_in_one\tconcordance\tdosage_r2\tmax_difference\n" ;
+
+		bool const per_sample = options().check( "-os" ) ;
+		ThreadSampleAccumulators sample_accumulators( per_sample ? number_of_samples : 0 ) ;
+		genfile::bgen::Comparer const comparer( merger.source(0).context(), merger.source(1).context() ) ;
+
+		ui().logger() << fmt::format(
+			"Comparing \"{}\" and \"{}\" ({} samples) using {} threads...\n",
+			filenames[0], filenames[1], number_of_samples, pool.number_of_threads()
+		) ;
+
+		// Variant pairs are gathered here in chunks, compared by the pool, and reported in order.
+		std::size_t number_compared = 0 ;
+		std::size_t number_identical = 0 ;
+		uint64_t total_compared = 0 ;
+		uint64_t total_concordant = 0 ;
+		auto progress_context = ui().get_progress_context( "Comparing" ) ;
+		genfile::OrderedTaskQueue< std::vector< VariantResult > > chunks(
+			pool, 2 * pool.number_of_threads(),
+			[&]( std::vector< VariantResult > const& results ) {
+				for( VariantResult const& result: results ) {
+					output << result.chromosome << "\t" << result.position << "\t" << result.rsid << "\t" << join( result.alleles, "," ) ;
+					if( result.identical ) {
+						output << "\t1\tNA\tNA\t1\t1\t0\n" ;
+						++number_identical ;
+					} else {
+						output << "\t0\t" << result.compared << "\t" << result.missing_in_one
+							<< "\t" << format_ratio( result.concordant, result.compared )
+							<< "\t" << format_value( result.r2 )
+							<< "\t" << format_value( result.max_difference )
+							<< "\n" ;
+						total_compared += result.compared ;
+						total_concordant += result.concordant ;
+					}
+				}
+				number_compared += results.size() ;
+				progress_context( number_compared, std::optional< std::size_t >() ) ;
+			}
+		) ;
+		std::size_t const chunk_size = std::max( options().get< std::size_t >( "-chunk-size" ), std::size_t( 1 )) ;
+		auto submit = [&]( std::vector< VariantPair >&& chunk ) {
+			chunks.submit(
+				[&comparer,&sample_accumulators,per_sample,chunk = std::move( chunk )]() {
+					return comparer.compare( chunk, per_sample ? &sample_accumulators.get() : 0 ) ;
+				}
+			) ;
+		} ;
+
+		genfile::bgen::PairingSummary const pairing = genfile::bgen::pair_variants( merger, chunk_size, submit ) ;
+		chunks.finish() ;
+		progress_context.finish() ;
+
+		if( per_sample ) {
+			write_sample_summary( merger.source(0), sample_accumulators.total(), options().get< std::string >( "-os" )) ;
+		}
+
+		ui().logger() << fmt::format(
+			"Compared {} variants found in both files ({} only in \"{}\", {} only in \"{}\").\n"
+			"{} variants have identical genotype data.  Among the remaining variants, genotype concordance is {}"
+			" over {} genotypes.\n",
+			number_compared, pairing.only_in[0], filenames[0], pairing.only_in[1], filenames[1],
+			number_identical, format_ratio( total_concordant, total_compared ), total_compared
+		) ;
+	}
+
+	void write_sample_summary(
+		genfile::bgen::View const& view,
+		SampleAccumulator const& samples,
+		std::string const& filename
+	) const {
+		std::unique_ptr< std::ostream > output = open_output_file( filename ) ;
+		(*output) << "sample\tcompared\tmissing_in_one\tconcordance\tdosage_r2\tmax_difference\n" ;
+		std::size_t i = 0 ;
+		view.get_sample_ids(
+			[&]( std::string const& id ) {
+				(*output) << id << "\t" << samples.compared[i] << "\t" << samples.missing_in_one[i]
+					<< "\t" << format_ratio( samples.concordant[i], samples.compared[i] )
+					<< "\t" << format_value( samples.dosage[i].r2() )
+					<< "\t" << format_value( samples.max_difference[i] )
+					<< "\n" ;
+				++i ;
+			}
+		) ;
+		ui().logger() << "Wrote per-sample comparisons to \"" << filename << "\".\n" ;
+	}
+
+	std::unique_ptr< std::ostream > open_output_file( std::string const& filename ) const {
+		std::unique_ptr< std::ofstream > result( new std::ofstream( filename )) ;
+		if( !*result ) {
+			throw std::invalid_argument( "Could not open \"" + filename + "\" for writing." ) ;
+		}
+		return result ;
+	}
+} ;
+
+int main( int argc, char** argv ) {
+	std::ios_base::sync_with_stdio( false ) ;
+	try {
+		CompareBgenApplication app( argc, argv ) ;
+	}
+	catch( appcontext::HaltProgramWithReturnCode const& e ) {
+		return e.return_code() ;
+	}
+	return 0 ;
+}
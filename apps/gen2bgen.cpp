@@ -0,0 +1,400 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <charconv>
+#include <filesystem>
+#include <fmt/format.h>
+#include "genfile/bgen.hpp"
+#include "genfile/Writer.hpp"
+#include "genfile/IndexWriter.hpp"
+#include "genfile/gen.hpp"
+#include "genfile/LineReader.hpp"
+#include "genfile/ThreadPool.hpp"
+#include "appcontext/CmdLineOptionProcessor.hpp"
+#include "appcontext/ApplicationContext.hpp"
+#include "config.h"
+
+namespace globals {
+	std::string const program_name = "gen2bgen" ;
+	std::string const program_version = bgen_revision ;
+}
+
+struct Gen2BgenOptionProcessor: public appcontext::CmdLineOptionProcessor
+{
+public:
+	std::string get_program_name() const { return globals::program_name ; }
+
+	void declare_options( appcontext::OptionProcessor& options ) {
+		// Meta-options
+		options.set_help_option( "-help" ) ;
+
+		options.declare_group( "Input / output file options" ) ;
+		options[ "-gen" ]
+			.set_description(
+				"Path of GEN file to convert.  This may be uncompressed or gzipped.  Lines may either"
+				" start with the SNPID, or with the chromosome followed by the SNPID."
+			)
+			.set_takes_single_value()
+			.set_is_required()
+		;
+		options[ "-s" ]
+			.set_description(
+				"Path of sample file listing the samples in the GEN file.  If given, sample identifiers"
+				" (from the first column) are stored in the output file."
+			)
+			.set_takes_single_value()
+		;
+		options[ "-og" ]
+			.set_description(
+				"Path of bgen file to write."
+			)
+			.set_takes_single_value()
+			.set_is_required()
+		;
+		options[ "-clobber" ]
+			.set_description(
+				"Specify that gen2bgen should overwrite existing output files if they exist."
+			)
+		;
+		options[ "-no-index" ]
+			.set_description(
+				"Do not write a bgenix index for the output file.  By default the index is written"
+				" alongside the bgen file, with \".bgi\" appended to the filename."
+			)
+		;
+
+		options.declare_group( "Conversion options" ) ;
+		options[ "-chromosome" ]
+			.set_description(
+				"Chromosome to use for lines of the GEN file that do not have a chromosome column."
+			)
+			.set_takes_single_value()
+			.set_default_value( "NA" )
+		;
+		options[ "-bits" ]
+			.set_description(
+				"Number of bits used to store each probability in the output file."
+			)
+			.set_takes_single_value()
+			.set_default_value( 8 )
+		;
+		options[ "-compression" ]
+			.set_description(
+				"Compression to apply to genotype data blocks.  This can be \"zlib\", \"zstd\" or \"none\"."
+			)
+			.set_takes_single_value()
+			.set_default_value( "zstd" )
+		;
+		options[ "-threads" ]
+			.set_description(
+				"Number of threads to use for parsing and encoding.  Zero means use all available cores."
+			)
+			.set_takes_single_value()
+			.set_default_value( 0 )
+		;
+		options[ "-chunk-size" ]
+			.set_description(
+				"Number of GEN lines handed to each worker thread at a time."
+			)
+			.set_takes_single_value()
+			.set_default_value( 256 )
+		;
+	}
+} ;
+
+namespace {
+	using genfile::byte_t ;
+	using genfile::gen::Slice ;
+	using genfile::gen::split_whitespace ;
+	using genfile::gen::to_string ;
+	using genfile::gen::parse_probability ;
+
+	// A variant ready to be written to the output file.
+	struct EncodedVariant {
+		std::string chromosome ;
+		uint32_t position ;
+		std::string SNPID ;
+		std::string rsid ;
+		std::vector< std::string > alleles ;
+		std::vector< byte_t > data ;
+	} ;
+
+	// Parses and encodes chunks of GEN lines.
+	// encode() is const and may be called concurrently from several threads.
+	struct GenEncoder {
+	public:
+		GenEncoder( genfile::bgen::Context const& context, std::string const& default_chromosome, int number_of_bits ):
+			m_context( context ),
+			m_default_chromosome( default_chromosome ),
+			m_number_of_bits( number_of_bits )
+		{}
+
+		// Encode the lines in the given text, which starts at the given (1-based) line number of the file.
+		std::vector< EncodedVariant > encode( std::string const& text, std::size_t first_line_number ) const {
+			std::vector< EncodedVariant > result ;
+			std::vector< Slice > fields ;
+			std::vector< byte_t > buffer1, buffer2 ;
+			char const* p = text.data() ;
+			char const* const end = text.data() + text.size() ;
+			for( std::size_t line_number = first_line_number; p < end; ++line_number ) {
+				char const* line_end = std::find( p, end, '\n' ) ;
+				char const* next = line_end + ( line_end < end ? 1 : 0 ) ;
+				split_whitespace( Slice( p, line_end ), &fields ) ;
+				if( !fields.empty() ) {
+					try {
+						result.push_back( EncodedVariant() ) ;
+						encode_line( fields, &buffer1, &buffer2, &result.back() ) ;
+					} catch( std::invalid_argument const& e ) {
+						throw std::invalid_argument( fmt::format( "line {}: {}", line_number, e.what() )) ;
+					} catch( genfile::bgen::BGenError const& e ) {
+						throw std::invalid_argument( fmt::format( "line {}: invalid genotype data", line_number )) ;
+					}
+				}
+				p = next ;
+			}
+			return result ;
+		}
+
+	private:
+		genfile::bgen::Context const& m_context ;
+		std::string const m_default_chromosome ;
+		int const m_number_of_bits ;
+
+	private:
+		void encode_line(
+			std::vector< Slice > const& fields,
+			std::vector< byte_t >* buffer1,
+			std::vector< byte_t >* buffer2,
+			EncodedVariant* result
+		) const {
+			std::size_t const N = m_context.number_of_samples ;
+			std::size_t first_field = 0 ;
+			if( fields.size() == 6 + 3*N ) {
+				result->chromosome = to_string( fields[0] ) ;
+				first_field = 1 ;
+			} else if( fields.size() == 5 + 3*N ) {
+				result->chromosome = m_default_chromosome ;
+			} else {
+				throw std::invalid_argument(
+					fmt::format( "expected {} or {} columns, found {}", 5 + 3*N, 6 + 3*N, fields.size() )
+				) ;
+			}
+			result->SNPID = to_string( fields[ first_field ] ) ;
+			result->rsid = to_string( fields[ first_field + 1 ] ) ;
+			{
+				Slice const& position = fields[ first_field + 2 ] ;
+				std::from_chars_result r = std::from_chars( position.first, position.second, result->position ) ;
+				if( r.ec != std::errc() || r.ptr != position.second ) {
+					throw std::invalid_argument( "could not parse position \"" + to_string( position ) + "\"" ) ;
+				}
+			}
+			result->alleles.clear() ;
+			result->alleles.push_back( to_string( fields[ first_field + 3 ] )) ;
+			result->alleles.push_back( to_string( fields[ first_field + 4 ] )) ;
+
+			genfile::bgen::GenotypeDataBlockWriter writer( buffer1, buffer2, m_context, m_number_of_bits ) ;
+			writer.initialise( N, 2, 2 ) ;
+			std::vector< Slice >::const_iterator values = fields.begin() + first_field + 5 ;
+			double probs[3] ;
+			for( std::size_t i = 0; i < N; ++i, values += 3 ) {
+				writer.set_sample( i ) ;
+				writer.set_number_of_entries( 2, 3, genfile::ePerUnorderedGenotype, genfile::eProbability ) ;
+				probs[0] = parse_probability( values[0] ) ;
+				probs[1] = parse_probability( values[1] ) ;
+				probs[2] = parse_probability( values[2] ) ;
+				double const sum = probs[0] + probs[1] + probs[2] ;
+				if( sum == 0.0 ) {
+					// All-zero probabilities denote missing data in GEN files.
+					for( std::size_t g = 0; g < 3; ++g ) {
+						writer.set_value( g, genfile::MissingValue() ) ;
+					}
+				} else {
+					// GEN probabilities are rounded and need not sum exactly to one, so we renormalise them here.
+					for( std::size_t g = 0; g < 3; ++g ) {
+						writer.set_value( g, probs[g] / sum ) ;
+					}
+				}
+			}
+			writer.finalise() ;
+			result->data.assign( writer.repr().first, writer.repr().second ) ;
+		}
+	} ;
+}
+
+struct Gen2BgenApplication: public appcontext::ApplicationContext
+{
+public:
+	Gen2BgenApplication( int argc, char** argv ):
+		appcontext::ApplicationContext(
+			globals::program_name,
+			globals::program_version,
+			std::make_unique<Gen2BgenOptionProcessor>(),
+			argc,
+			argv,
+			"-log"
+		)
+	{
+		std::string const gen_filename = options().get< std::string >( "-gen" ) ;
+		std::string const bgen_filename = options().get< std::string >( "-og" ) ;
+		std::string const index_filename = bgen_filename + ".bgi" ;
+		bool const write_index = !options().check( "-no-index" ) ;
+		if( !options().check( "-clobber" ) ) {
+			if( std::filesystem::exists( bgen_filename ) || ( write_index && std::filesystem::exists( index_filename ))) {
+				ui().logger() << "!! Error: output file \"" << bgen_filename << "\" or its index exists.  Use -clobber if you want me to overwrite it.\n" ;
+				throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+			}
+		} else if( write_index ) {
+			std::filesystem::remove( index_filename + ".tmp" ) ;
+		}
+
+		try {
+			convert( gen_filename, bgen_filename, write_index ? index_filename : "" ) ;
+		} catch( std::invalid_argument const& e ) {
+			ui().logger() << "!! Error: " << e.what() << "\n" ;
+			std::filesystem::remove( bgen_filename ) ;
+			throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+		}
+	}
+
+private:
+	void convert( std::string const& gen_filename, std::string const& bgen_filename, std::string const& index_filename ) {
+		std::vector< std::string > sample_ids ;
+		if( options().check( "-s" )) {
+			sample_ids = read_sample_file( options().get< std::string >( "-s" )) ;
+		}
+
+		genfile::LineReader reader( gen_filename ) ;
+		std::size_t const chunk_size = std::max( options().get< std::size_t >( "-chunk-size" ), std::size_t( 1 )) ;
+		// Read the first chunk now, so that we can work out the number of samples if there is no sample file.
+		std::string first_chunk ;
+		reader.read_lines( chunk_size, &first_chunk ) ;
+		std::size_t const number_of_samples = options().check( "-s" )
+			? sample_ids.size()
+			: infer_number_of_samples( first_chunk ) ;
+
+		genfile::bgen::Context context ;
+		context.number_of_samples = number_of_samples ;
+		context.flags = genfile::bgen::e_Layout2 | get_compression_flags( options().get< std::string >( "-compression" )) ;
+		int const number_of_bits = options().get< int >( "-bits" ) ;
+		if( number_of_bits < 1 || number_of_bits > 32 ) {
+			throw std::invalid_argument( "-bits must be between 1 and 32" ) ;
+		}
+
+		genfile::bgen::Writer writer( bgen_filename, context, sample_ids ) ;
+		genfile::bgen::IndexWriter::UniquePtr index_writer ;
+		if( index_filename != "" ) {
+			index_writer = genfile::bgen::IndexWriter::create( index_filename ) ;
+		}
+		GenEncoder const encoder( writer.context(), options().get< std::string >( "-chromosome" ), number_of_bits ) ;
+
+		genfile::ThreadPool pool( options().get< std::size_t >( "-threads" )) ;
+		ui().logger() << fmt::format(
+			"Converting \"{}\" ({} samples) to \"{}\" using {} threads...\n",
+			gen_filename, number_of_samples, bgen_filename, pool.number_of_threads()
+		) ;
+
+		// Chunks of lines are parsed, quantised and compressed by the pool, and written here
+		// in the order they were read.
+		auto progress_context = ui().get_progress_context( "Converting" ) ;
+		genfile::OrderedTaskQueue< std::vector< EncodedVariant > > chunks(
+			pool, 2 * pool.number_of_threads(),
+			[&]( std::vector< EncodedVariant > const& variants ) {
+				for( std::size_t i = 0; i < variants.size(); ++i ) {
+					EncodedVariant const& variant = variants[i] ;
+					genfile::bgen::IndexQuery::FileRange const range = writer.write_variant(
+						variant.SNPID, variant.rsid, variant.chromosome, variant.position, variant.alleles,
+						&variant.data[0], &variant.data[0] + variant.data.size()
+					) ;
+					if( index_writer.get() ) {
+						index_writer->add_variant( variant.chromosome, variant.position, variant.rsid, variant.alleles, range ) ;
+					}
+				}
+				progress_context( writer.number_of_variants(), std::optional< std::size_t >() ) ;
+			}
+		) ;
+
+		std::size_t first_line_number = 1 ;
+		std::string text = std::move( first_chunk ) ;
+		while( !text.empty() ) {
+			chunks.submit(
+				[&encoder,text = std::move( text ),first_line_number]() {
+					return encoder.encode( text, first_line_number ) ;
+				}
+			) ;
+			first_line_number = reader.number_of_lines() + 1 ;
+			text.clear() ;
+			reader.read_lines( chunk_size, &text ) ;
+		}
+		chunks.finish() ;
+
+		genfile::bgen::Writer::FileMetadata const metadata = writer.finalise() ;
+		if( index_writer.get() ) {
+			index_writer->finalise( metadata ) ;
+		}
+		ui().logger() << fmt::format(
+			"Finished writing \"{}\" ({} samples, {} variants).\n",
+			bgen_filename, number_of_samples, writer.number_of_variants()
+		) ;
+	}
+
+	// Read sample identifiers from the first column of a sample file, skipping the two header lines.
+	std::vector< std::string > read_sample_file( std::string const& filename ) const {
+		genfile::LineReader reader( filename ) ;
+		std::vector< std::string > result ;
+		std::vector< Slice > fields ;
+		std::string line ;
+		while( line.clear(), reader.read_lines( 1, &line ) > 0 ) {
+			split_whitespace( Slice( line.data(), line.data() + line.size() - 1 ), &fields ) ;
+			if( reader.number_of_lines() > 2 && !fields.empty() ) {
+				result.push_back( to_string( fields[0] )) ;
+			}
+		}
+		if( reader.number_of_lines() < 2 ) {
+			throw std::invalid_argument( "\"" + filename + "\" does not look like a sample file." ) ;
+		}
+		return result ;
+	}
+
+	// Infer the number of samples from the number of columns on the first line.
+	// Lines have either 5 or 6 identifying columns, followed by three per sample.
+	std::size_t infer_number_of_samples( std::string const& text ) const {
+		std::vector< Slice > fields ;
+		char const* const end = std::find( text.data(), text.data() + text.size(), '\n' ) ;
+		split_whitespace( Slice( text.data(), end ), &fields ) ;
+		if( fields.size() >= 6 && ( fields.size() - 6 ) % 3 == 0 ) {
+			return ( fields.size() - 6 ) / 3 ;
+		} else if( fields.size() >= 5 && ( fields.size() - 5 ) % 3 == 0 ) {
+			return ( fields.size() - 5 ) / 3 ;
+		}
+		throw std::invalid_argument( fmt::format( "line 1: {} columns is not valid for a GEN file", fields.size() )) ;
+	}
+
+	uint32_t get_compression_flags( std::string const& compression ) const {
+		if( compression == "zlib" ) {
+			return genfile::bgen::e_ZlibCompression ;
+		} else if( compression == "zstd" ) {
+			return genfile::bgen::e_ZstdCompression ;
+		} else if( compression == "none" ) {
+			return genfile::bgen::e_NoCompression ;
+		}
+		throw std::invalid_argument( "-compression must be one of \"zlib\", \"zstd\" or \"none\"." ) ;
+	}
+} ;
+
+int main( int argc, char** argv ) {
+	std::ios_base::sync_with_stdio( false ) ;
+	try {
+		Gen2BgenApplication app( argc, argv ) ;
+	}
+	catch( appcontext::HaltProgramWithReturnCode const& e ) {
+		return e.return_code() ;
+	}
+	return 0 ;
+}
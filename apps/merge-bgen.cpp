@@ -0,0 +1,382 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <filesystem>
+#include <fmt/format.h>
+#include "genfile/bgen.hpp"
+#include "genfile/View.hpp"
+#include "genfile/Writer.hpp"
+#include "genfile/IndexWriter.hpp"
+#include "genfile/ThreadPool.hpp"
+#include "genfile/merge.hpp"
+#include "appcontext/CmdLineOptionProcessor.hpp"
+#include "appcontext/ApplicationContext.hpp"
+#include "config.h"
+
+namespace globals {
+	std::string const program_name = "merge-bgen" ;
+	std::string const program_version = bgen_revision ;
+}
+
+struct MergeBgenOptionProcessor: public appcontext::CmdLineOptionProcessor
+{
+public:
+	std::string get_program_name() const { return globals::program_name ; }
+
+	void declare_options( appcontext::OptionProcessor& options ) {
+		// Meta-options
+		options.set_help_option( "-help" ) ;
+
+		options.declare_group( "Input / output file options" ) ;
+		options[ "-g" ]
+			.set_description(
+				"Paths of bgen files to merge.  These must contain the same variants, in the same order,"
+				" for different samples.  Samples in the output appear in the order of these files."
+			)
+			.set_takes_values_until_next_option()
+			.set_is_required()
+		;
+		options[ "-og" ]
+			.set_description(
+				"Path of bgen file to write."
+			)
+			.set_takes_single_value()
+			.set_is_required()
+		;
+		options[ "-clobber" ]
+			.set_description(
+				"Specify that merge-bgen should overwrite existing output files if they exist."
+			)
+		;
+		options[ "-no-index" ]
+			.set_description(
+				"Do not write a bgenix index for the output file.  By default the index is written"
+				" alongside the bgen file, with \".bgi\" appended to the filename."
+			)
+		;
+
+		options.declare_group( "Merge options" ) ;
+		options[ "-bits" ]
+			.set_description(
+				"Number of bits used to store each probability in the output file.  By default each variant"
+				" is stored with the largest number of bits used for it in the input files.  Data is copied"
+				" without decoding where the number of bits is unchanged, and re-encoded otherwise."
+			)
+			.set_takes_single_value()
+		;
+		options[ "-compression" ]
+			.set_description(
+				"Compression to apply to genotype data blocks.  This can be \"zlib\", \"zstd\" or \"none\"."
+			)
+			.set_takes_single_value()
+			.set_default_value( "zstd" )
+		;
+		options[ "-threads" ]
+			.set_description(
+				"Number of threads to use for merging and compression.  Zero means use all available cores."
+			)
+			.set_takes_single_value()
+			.set_default_value( 0 )
+		;
+		options[ "-chunk-size" ]
+			.set_description(
+				"Number of variants handed to each worker thread at a time."
+			)
+			.set_takes_single_value()
+			.set_default_value( 64 )
+		;
+	}
+} ;
+
+namespace {
+	using genfile::byte_t ;
+
+	// A variant read from each input file, or merged ready for writing.
+	struct Variant {
+		std::string SNPID ;
+		std::string rsid ;
+		std::string chromosome ;
+		uint32_t position ;
+		std::vector< std::string > alleles ;
+		// For input variants, the (compressed) genotype data block from each file, as returned by
+		// read_genotype_data_block(); for merged variants, the block as it should appear in the output.
+		std::vector< std::vector< byte_t > > data ;
+	} ;
+
+	// Merges the genotype data of each variant.
+	// merge() is const and may be called concurrently from several threads.
+	struct Merger {
+	public:
+		Merger(
+			std::vector< genfile::bgen::Context > const& input_contexts,
+			genfile::bgen::Context const& output_context,
+			int number_of_bits
+		):
+			m_input_contexts( input_contexts ),
+			m_output_context( output_context ),
+			m_number_of_bits( number_of_bits )
+		{}
+
+		void merge( std::vector< Variant >* variants ) const {
+			std::size_t const K = m_input_contexts.size() ;
+			std::vector< std::vector< byte_t > > buffers( K ) ;
+			std::vector< genfile::bgen::v12::GenotypeDataBlock > packs( K ) ;
+			std::vector< genfile::bgen::v12::GenotypeDataBlock const* > blocks( K ) ;
+			std::vector< byte_t > merged ;
+			for( Variant& variant: *variants ) {
+				int number_of_bits = m_number_of_bits ;
+				for( std::size_t k = 0; k < K; ++k ) {
+					genfile::bgen::uncompress_probability_data( m_input_contexts[k], variant.data[k], &buffers[k] ) ;
+					packs[k].initialise( m_input_contexts[k], buffers[k].data(), buffers[k].data() + buffers[k].size() ) ;
+					blocks[k] = &packs[k] ;
+					if( m_number_of_bits == 0 ) {
+						number_of_bits = std::max( number_of_bits, int( packs[k].bits )) ;
+					}
+				}
+				try {
+					genfile::bgen::v12::merge_samples( blocks, number_of_bits, &merged ) ;
+				} catch( std::invalid_argument const& e ) {
+					throw std::invalid_argument( fmt::format( "variant \"{}\" at {}:{}: {}", variant.rsid, variant.chromosome, variant.position, e.what() )) ;
+				}
+				std::pair< byte_t const*, byte_t const* > const result = genfile::bgen::compress_probability_data(
+					m_output_context, merged.data(), merged.data() + merged.size(), &buffers[0]
+				) ;
+				variant.data.resize( 1 ) ;
+				variant.data[0].assign( result.first, result.second ) ;
+			}
+		}
+
+	private:
+		std::vector< genfile::bgen::Context > const m_input_contexts ;
+		genfile::bgen::Context const m_output_context ;
+		int const m_number_of_bits ;
+	} ;
+}
+
+struct MergeBgenApplication: public appcontext::ApplicationContext
+{
+public:
+	MergeBgenApplication( int argc, char** argv ):
+		appcontext::ApplicationContext(
+			globals::program_name,
+			globals::program_version,
+			std::make_unique<MergeBgenOptionProcessor>(),
+			argc,
+			argv,
+			"-log"
+		)
+	{
+		std::vector< std::string > const input_filenames = options().get_values< std::string >( "-g" ) ;
+		std::string const bgen_filename = options().get< std::string >( "-og" ) ;
+		std::string const index_filename = bgen_filename + ".bgi" ;
+		bool const write_index = !options().check( "-no-index" ) ;
+		if( !options().check( "-clobber" ) ) {
+			if( std::filesystem::exists( bgen_filename ) || ( write_index && std::filesystem::exists( index_filename ))) {
+				ui().logger() << "!! Error: output file \"" << bgen_filename << "\" or its index exists.  Use -clobber if you want me to overwrite it.\n" ;
+				throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+			}
+		} else if( write_index ) {
+			std::filesystem::remove( index_filename + ".tmp" ) ;
+		}
+
+		try {
+			merge( input_filenames, bgen_filename, write_index ? index_filename : "" ) ;
+		} catch( std::invalid_argument const& e ) {
+			ui().logger() << "!! Error: " << e.what() << "\n" ;
+			std::filesystem::remove( bgen_filename ) ;
+			throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+		} catch( genfile::bgen::BGenError const& e ) {
+			ui().logger() << "!! Error: an error occurred reading genotype data.\n" ;
+			std::filesystem::remove( bgen_filename ) ;
+			throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+		}
+	}
+
+private:
+	void merge( std::vector< std::string > const& input_filenames, std::string const& bgen_filename, std::string const& index_filename ) {
+		std::vector< genfile::bgen::View::UniquePtr > views ;
+		std::vector< genfile::bgen::Context > input_contexts ;
+		std::vector< std::string > sample_ids ;
+		bool have_sample_ids = false ;
+		std::size_t number_of_samples = 0 ;
+		for( std::string const& filename: input_filenames ) {
+			views.push_back( genfile::bgen::View::create( filename )) ;
+			genfile::bgen::Context const& context = views.back()->context() ;
+			if(( context.flags & genfile::bgen::e_Layout ) != genfile::bgen::e_Layout2 ) {
+				throw std::invalid_argument( "\"" + filename + "\" is not a BGEN v1.2 file; only v1.2 files can be merged." ) ;
+			}
+			if( context.number_of_variants != views.front()->context().number_of_variants ) {
+				throw std::invalid_argument( fmt::format(
+					"\"{}\" has {} variants, but \"{}\" has {}.",
+					filename, context.number_of_variants, input_filenames[0], views.front()->context().number_of_variants
+				)) ;
+			}
+			input_contexts.push_back( context ) ;
+			have_sample_ids = have_sample_ids || ( context.flags & genfile::bgen::e_SampleIdentifiers ) ;
+			number_of_samples += context.number_of_samples ;
+		}
+		if( have_sample_ids ) {
+			// Files without sample identifiers contribute anonymous ones.
+			for( std::size_t k = 0; k < views.size(); ++k ) {
+				views[k]->get_sample_ids( [&sample_ids]( std::string const& id ) { sample_ids.push_back( id ) ; } ) ;
+			}
+			std::vector< std::string > sorted_ids = sample_ids ;
+			std::sort( sorted_ids.begin(), sorted_ids.end() ) ;
+			std::vector< std::string >::const_iterator duplicate = std::adjacent_find( sorted_ids.begin(), sorted_ids.end() ) ;
+			if( duplicate != sorted_ids.end() ) {
+				throw std::invalid_argument( "Sample \"" + *duplicate + "\" appears in more than one input file." ) ;
+			}
+		}
+
+		genfile::bgen::Context context ;
+		context.number_of_samples = number_of_samples ;
+		context.flags = genfile::bgen::e_Layout2 | get_compression_flags( options().get< std::string >( "-compression" )) ;
+		int const number_of_bits = options().check( "-bits" ) ? options().get< int >( "-bits" ) : 0 ;
+		if( options().check( "-bits" ) && ( number_of_bits < 1 || number_of_bits > 32 )) {
+			throw std::invalid_argument( "-bits must be between 1 and 32" ) ;
+		}
+
+		genfile::bgen::Writer writer( bgen_filename, context, sample_ids ) ;
+		genfile::bgen::IndexWriter::UniquePtr index_writer ;
+		if( index_filename != "" ) {
+			index_writer = genfile::bgen::IndexWriter::create( index_filename ) ;
+		}
+		Merger const merger( input_contexts, writer.context(), number_of_bits ) ;
+
+		genfile::ThreadPool pool( options().get< std::size_t >( "-threads" )) ;
+		ui().logger() << fmt::format(
+			"Merging {} files ({} samples) into \"{}\" using {} threads...\n",
+			views.size(), number_of_samples, bgen_filename, pool.number_of_threads()
+		) ;
+
+		// Chunks of variants are read here, merged and compressed by the pool, and written
+		// in the order they were read.
+		auto progress_context = ui().get_progress_context( "Merging" ) ;
+		genfile::OrderedTaskQueue< std::vector< Variant > > chunks(
+			pool, 2 * pool.number_of_threads(),
+			[&]( std::vector< Variant > const& variants ) {
+				for( Variant const& variant: variants ) {
+					std::vector< byte_t > const& data = variant.data[0] ;
+					genfile::bgen::IndexQuery::FileRange const range = writer.write_variant(
+						variant.SNPID, variant.rsid, variant.chromosome, variant.position, variant.alleles,
+						data.data(), data.data() + data.size()
+					) ;
+					if( index_writer.get() ) {
+						index_writer->add_variant( variant.chromosome, variant.position, variant.rsid, variant.alleles, range ) ;
+					}
+				}
+				progress_context( writer.number_of_variants(), views.front()->number_of_variants() ) ;
+			}
+		) ;
+
+		std::size_t const chunk_size = std::max( options().get< std::size_t >( "-chunk-size" ), std::size_t( 1 )) ;
+		std::vector< Variant > chunk ;
+		std::size_t variant_i = 0 ;
+		while( read_variant( views, input_filenames, variant_i, &chunk )) {
+			++variant_i ;
+			if( chunk.size() == chunk_size ) {
+				chunks.submit(
+					[&merger,chunk = std::move( chunk )]() mutable {
+						merger.merge( &chunk ) ;
+						return std::move( chunk ) ;
+					}
+				) ;
+				chunk.clear() ;
+			}
+		}
+		if( !chunk.empty() ) {
+			chunks.submit(
+				[&merger,chunk = std::move( chunk )]() mutable {
+					merger.merge( &chunk ) ;
+					return std::move( chunk ) ;
+				}
+			) ;
+		}
+		chunks.finish() ;
+		progress_context.finish() ;
+
+		genfile::bgen::Writer::FileMetadata const metadata = writer.finalise() ;
+		if( index_writer.get() ) {
+			index_writer->finalise( metadata ) ;
+		}
+		ui().logger() << fmt::format(
+			"Finished writing \"{}\" ({} samples, {} variants).\n",
+			bgen_filename, number_of_samples, writer.number_of_variants()
+		) ;
+	}
+
+	// Read the next variant from each file, checking that its identifying data matches in all files,
+	// and append it to the given chunk.  Return false at the end of the files.
+	bool read_variant(
+		std::vector< genfile::bgen::View::UniquePtr > const& views,
+		std::vector< std::string > const& filenames,
+		std::size_t const variant_i,
+		std::vector< Variant >* chunk
+	) const {
+		Variant variant ;
+		Variant other ;
+		variant.data.resize( views.size() ) ;
+		for( std::size_t k = 0; k < views.size(); ++k ) {
+			Variant& target = ( k == 0 ) ? variant : other ;
+			bool const success = views[k]->read_variant(
+				&target.SNPID, &target.rsid, &target.chromosome, &target.position, &target.alleles
+			) ;
+			if( k == 0 && !success ) {
+				// Check that the other files have also ended.
+				for( std::size_t k2 = 1; k2 < views.size(); ++k2 ) {
+					if( views[k2]->read_variant( &other.SNPID, &other.rsid, &other.chromosome, &other.position, &other.alleles )) {
+						throw std::invalid_argument( fmt::format( "\"{}\" has more variants than \"{}\".", filenames[k2], filenames[0] )) ;
+					}
+				}
+				return false ;
+			} else if( !success ) {
+				throw std::invalid_argument( fmt::format( "\"{}\" has fewer variants than \"{}\".", filenames[k], filenames[0] )) ;
+			}
+			if(
+				k > 0 && (
+					other.SNPID != variant.SNPID || other.rsid != variant.rsid || other.chromosome != variant.chromosome
+					|| other.position != variant.position || other.alleles != variant.alleles
+				)
+			) {
+				throw std::invalid_argument( fmt::format(
+					"variant {} differs between \"{}\" ({}:{} {}) and \"{}\" ({}:{} {}).",
+					variant_i + 1,
+					filenames[0], variant.chromosome, variant.position, variant.rsid,
+					filenames[k], other.chromosome, other.position, other.rsid
+				)) ;
+			}
+			views[k]->read_raw_genotype_data_block( &variant.data[k] ) ;
+		}
+		chunk->push_back( std::move( variant )) ;
+		return true ;
+	}
+
+	uint32_t get_compression_flags( std::string const& compression ) const {
+		if( compression == "zlib" ) {
+			return genfile::bgen::e_ZlibCompression ;
+		} else if( compression == "zstd" ) {
+			return genfile::bgen::e_ZstdCompression ;
+		} else if( compression == "none" ) {
+			return genfile::bgen::e_NoCompression ;
+		}
+		throw std::invalid_argument( "-compression must be one of \"zlib\", \"zstd\" or \"none\"." ) ;
+	}
+} ;
+
+int main( int argc, char** argv ) {
+	std::ios_base::sync_with_stdio( false ) ;
+	try {
+		MergeBgenApplication app( argc, argv ) ;
+	}
+	catch( appcontext::HaltProgramWithReturnCode const& e ) {
+		return e.return_code() ;
+	}
+	return 0 ;
+}
@@ -0,0 +1,325 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <optional>
+#include <filesystem>
+#include <fmt/format.h>
+#include "genfile/bgen.hpp"
+#include "genfile/Buffer.hpp"
+#include "genfile/SampleOrder.hpp"
+#include "genfile/View.hpp"
+#include "genfile/Writer.hpp"
+#include "genfile/IndexWriter.hpp"
+#include "genfile/LineReader.hpp"
+#include "genfile/ThreadPool.hpp"
+#include "appcontext/CmdLineOptionProcessor.hpp"
+#include "appcontext/ApplicationContext.hpp"
+#include "config.h"
+
+namespace globals {
+	std::string const program_name = "reorder-bgen" ;
+	std::string const program_version = bgen_revision ;
+}
+
+struct ReorderBgenOptionProcessor: public appcontext::CmdLineOptionProcessor
+{
+public:
+	std::string get_program_name() const { return globals::program_name ; }
+
+	void declare_options( appcontext::OptionProcessor& options ) {
+		// Meta-options
+		options.set_help_option( "-help" ) ;
+
+		options.declare_group( "Input / output file options" ) ;
+		options[ "-g" ]
+			.set_description(
+				"Path of bgen file to reorder."
+			)
+			.set_takes_single_value()
+			.set_is_required()
+		;
+		options[ "-samples" ]
+			.set_description(
+				"Path of a file listing sample identifiers, one per line, in the order they should appear in the"
+				" output.  Only the first whitespace-separated column is used.  File samples that are not listed are"
+				" dropped, and listed samples that are not in the file are written with missing data."
+			)
+			.set_takes_single_value()
+			.set_is_required()
+		;
+		options[ "-og" ]
+			.set_description(
+				"Path of bgen file to write."
+			)
+			.set_takes_single_value()
+			.set_is_required()
+		;
+		options[ "-clobber" ]
+			.set_description(
+				"Specify that reorder-bgen should overwrite existing output files if they exist."
+			)
+		;
+		options[ "-no-index" ]
+			.set_description(
+				"Do not write a bgenix index for the output file.  By default the index is written"
+				" alongside the bgen file, with \".bgi\" appended to the filename."
+			)
+		;
+
+		options.declare_group( "Processing options" ) ;
+		options[ "-threads" ]
+			.set_description(
+				"Number of threads to use for reordering.  Zero means use all available cores."
+			)
+			.set_takes_single_value()
+			.set_default_value( 0 )
+		;
+		options[ "-chunk-size" ]
+			.set_description(
+				"Number of variants handed to each worker thread at a time."
+			)
+			.set_takes_single_value()
+			.set_default_value( 64 )
+		;
+	}
+} ;
+
+namespace {
+	using genfile::byte_t ;
+
+	bool is_space( char c ) {
+		return c == ' ' || c == '\t' || c == '\n' || c == '\r' ;
+	}
+
+	struct Variant {
+		std::string SNPID ;
+		std::string rsid ;
+		std::string chromosome ;
+		uint32_t position ;
+		std::vector< std::string > alleles ;
+		// The genotype data block, as read from the input file or encoded for the output file.
+		std::vector< byte_t > data ;
+	} ;
+
+	// Rearranges the samples of genotype data blocks.  Sample data is copied exactly, so this does
+	// not change any values.  reorder() is const and may be called concurrently from several threads.
+	struct SampleReorderer {
+	public:
+		SampleReorderer(
+			genfile::bgen::Context const& input_context,
+			genfile::bgen::Context const& output_context,
+			genfile::bgen::SampleOrder const& order
+		):
+			m_input_context( input_context ),
+			m_output_context( output_context ),
+			m_order( order )
+		{}
+
+		std::vector< Variant > reorder( std::vector< Variant > const& variants ) const {
+			std::vector< Variant > result( variants ) ;
+			genfile::Buffer uncompressed, reordered, buffer1, buffer2 ;
+			// The number of bits is not used, since data is encoded by reorder_samples().
+			genfile::bgen::BasicGenotypeDataBlockWriter< genfile::Buffer > writer( &buffer1, &buffer2, m_output_context, 16 ) ;
+			for( std::size_t i = 0; i < result.size(); ++i ) {
+				Variant& variant = result[i] ;
+				try {
+					genfile::bgen::uncompress_probability_data( m_input_context, variant.data, &uncompressed ) ;
+					genfile::bgen::reorder_samples(
+						m_input_context, &uncompressed[0], &uncompressed[0] + uncompressed.size(),
+						m_order, &reordered
+					) ;
+				} catch( genfile::bgen::BGenError const& ) {
+					throw std::invalid_argument(
+						fmt::format( "variant {}:{} ({}) has invalid genotype data", variant.chromosome, variant.position, variant.rsid )
+					) ;
+				}
+				writer.set_uncompressed_data( &reordered[0], &reordered[0] + reordered.size() ) ;
+				variant.data.assign( writer.repr().first, writer.repr().second ) ;
+			}
+			return result ;
+		}
+
+	private:
+		genfile::bgen::Context const& m_input_context ;
+		genfile::bgen::Context const& m_output_context ;
+		genfile::bgen::SampleOrder const& m_order ;
+	} ;
+}
+
+struct ReorderBgenApplication: public appcontext::ApplicationContext
+{
+public:
+	ReorderBgenApplication( int argc, char** argv ):
+		appcontext::ApplicationContext(
+			globals::program_name,
+			globals::program_version,
+			std::make_unique<ReorderBgenOptionProcessor>(),
+			argc,
+			argv,
+			"-log"
+		)
+	{
+		std::string const input_filename = options().get< std::string >( "-g" ) ;
+		std::string const bgen_filename = options().get< std::string >( "-og" ) ;
+		std::string const index_filename = bgen_filename + ".bgi" ;
+		bool const write_index = !options().check( "-no-index" ) ;
+		{
+			// Writing the output would truncate the input before it is read.
+			std::error_code ec ;
+			if( std::filesystem::equivalent( input_filename, bgen_filename, ec )) {
+				ui().logger() << "!! Error: output file \"" << bgen_filename << "\" is the same file as the input.\n" ;
+				throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+			}
+		}
+		if( !options().check( "-clobber" ) ) {
+			if( std::filesystem::exists( bgen_filename ) || ( write_index && std::filesystem::exists( index_filename ))) {
+				ui().logger() << "!! Error: output file \"" << bgen_filename << "\" or its index exists.  Use -clobber if you want me to overwrite it.\n" ;
+				throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+			}
+		} else if( write_index ) {
+			std::filesystem::remove( index_filename + ".tmp" ) ;
+		}
+
+		// Remove partially written output, including the temporary index, on error.
+		auto const remove_output = [&]() {
+			std::error_code ec ;
+			std::filesystem::remove( bgen_filename, ec ) ;
+			if( write_index ) {
+				std::filesystem::remove( index_filename + ".tmp", ec ) ;
+			}
+		} ;
+		try {
+			reorder( input_filename, bgen_filename, write_index ? index_filename : "" ) ;
+		} catch( std::invalid_argument const& e ) {
+			ui().logger() << "!! Error: " << e.what() << "\n" ;
+			remove_output() ;
+			throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+		} catch( genfile::bgen::BGenError const& e ) {
+			ui().logger() << "!! Error: \"" << input_filename << "\" is not a valid bgen file.\n" ;
+			remove_output() ;
+			throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+		} catch( ... ) {
+			remove_output() ;
+			throw ;
+		}
+	}
+
+private:
+	void reorder( std::string const& input_filename, std::string const& bgen_filename, std::string const& index_filename ) {
+		genfile::bgen::View::UniquePtr view = genfile::bgen::View::create( input_filename ) ;
+		std::vector< std::string > file_sample_ids ;
+		view->get_sample_ids( [&file_sample_ids]( std::string const& id ) { file_sample_ids.push_back( id ) ; } ) ;
+		std::vector< std::string > const ids = read_sample_ids( options().get< std::string >( "-samples" )) ;
+		genfile::bgen::SampleOrder const order = genfile::bgen::SampleOrder::match( file_sample_ids, ids ) ;
+		std::size_t const number_found = order.size() - order.number_of_absent_samples() ;
+		if( number_found == 0 ) {
+			throw std::invalid_argument( "none of the listed samples are in \"" + input_filename + "\"." ) ;
+		}
+		ui().logger() << fmt::format(
+			"Writing {} samples: {} from \"{}\" and {} not in the file, which will have missing data.  {} samples in the file are not listed and will be dropped.\n",
+			order.size(), number_found, input_filename, order.number_of_absent_samples(), file_sample_ids.size() - number_found
+		) ;
+
+		genfile::bgen::Context context = view->context() ;
+		context.number_of_samples = order.size() ;
+		genfile::bgen::Writer writer( bgen_filename, context, ids ) ;
+		genfile::bgen::IndexWriter::UniquePtr index_writer ;
+		if( index_filename != "" ) {
+			index_writer = genfile::bgen::IndexWriter::create( index_filename ) ;
+		}
+		SampleReorderer const reorderer( view->context(), writer.context(), order ) ;
+
+		genfile::ThreadPool pool( options().get< std::size_t >( "-threads" )) ;
+		ui().logger() << fmt::format(
+			"Reordering \"{}\" to \"{}\" using {} threads...\n",
+			input_filename, bgen_filename, pool.number_of_threads()
+		) ;
+
+		// Chunks of variants are read here, reordered and compressed by the pool, and written here
+		// in the order they were read.
+		std::optional< std::size_t > const total = ( view->number_of_variants() == genfile::bgen::e_UnknownNumberOfVariants )
+			? std::optional< std::size_t >()
+			: std::optional< std::size_t >( view->number_of_variants() ) ;
+		auto progress_context = ui().get_progress_context( "Reordering" ) ;
+		genfile::OrderedTaskQueue< std::vector< Variant > > chunks(
+			pool, 2 * pool.number_of_threads(),
+			[&]( std::vector< Variant > const& variants ) {
+				for( std::size_t i = 0; i < variants.size(); ++i ) {
+					Variant const& variant = variants[i] ;
+					genfile::bgen::IndexQuery::FileRange const range = writer.write_variant(
+						variant.SNPID, variant.rsid, variant.chromosome, variant.position, variant.alleles,
+						&variant.data[0], &variant.data[0] + variant.data.size()
+					) ;
+					if( index_writer.get() ) {
+						index_writer->add_variant( variant.chromosome, variant.position, variant.rsid, variant.alleles, range ) ;
+					}
+				}
+				progress_context( writer.number_of_variants(), total ) ;
+			}
+		) ;
+
+		std::size_t const chunk_size = std::max( options().get< std::size_t >( "-chunk-size" ), std::size_t( 1 )) ;
+		while( true ) {
+			std::vector< Variant > variants ;
+			variants.reserve( chunk_size ) ;
+			while( variants.size() < chunk_size ) {
+				Variant variant ;
+				if( !view->read_variant( &variant.SNPID, &variant.rsid, &variant.chromosome, &variant.position, &variant.alleles )) {
+					break ;
+				}
+				view->read_raw_genotype_data_block( &variant.data ) ;
+				variants.push_back( std::move( variant )) ;
+			}
+			if( variants.empty() ) {
+				break ;
+			}
+			chunks.submit(
+				[&reorderer,variants = std::move( variants )]() {
+					return reorderer.reorder( variants ) ;
+				}
+			) ;
+		}
+		chunks.finish() ;
+
+		genfile::bgen::Writer::FileMetadata const metadata = writer.finalise() ;
+		if( index_writer.get() ) {
+			index_writer->finalise( metadata ) ;
+		}
+		ui().logger() << fmt::format(
+			"Finished writing \"{}\" ({} samples, {} variants).\n",
+			bgen_filename, order.size(), writer.number_of_variants()
+		) ;
+	}
+
+	// Read sample identifiers from the first column of each nonempty line of the given file.
+	std::vector< std::string > read_sample_ids( std::string const& filename ) const {
+		genfile::LineReader reader( filename ) ;
+		std::vector< std::string > result ;
+		std::string line ;
+		while( line.clear(), reader.read_lines( 1, &line ) > 0 ) {
+			std::string::const_iterator begin = std::find_if( line.cbegin(), line.cend(), []( char c ) { return !is_space( c ) ; } ) ;
+			std::string::const_iterator end = std::find_if( begin, line.cend(), is_space ) ;
+			if( begin != end ) {
+				result.push_back( std::string( begin, end )) ;
+			}
+		}
+		return result ;
+	}
+} ;
+
+int main( int argc, char** argv ) {
+	std::ios_base::sync_with_stdio( false ) ;
+	try {
+		ReorderBgenApplication app( argc, argv ) ;
+	}
+	catch( appcontext::HaltProgramWithReturnCode const& e ) {
+		return e.return_code() ;
+	}
+	return 0 ;
+}
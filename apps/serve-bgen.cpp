@@ -0,0 +1,848 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <numeric>
+#include <memory>
+#include <optional>
+#include <tuple>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <csignal>
+#include <cerrno>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <filesystem>
+#include <fmt/format.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include "genfile/bgen.hpp"
+#include "genfile/dosage.hpp"
+#include "genfile/parallel_decode.hpp"
+#include "genfile/vcf.hpp"
+#include "genfile/View.hpp"
+#include "genfile/IndexQuery.hpp"
+#include "genfile/query_spec.hpp"
+#include "genfile/ThreadPool.hpp"
+#include "serve/http.hpp"
+#include "serve/VariantCache.hpp"
+#include "appcontext/CmdLineOptionProcessor.hpp"
+#include "appcontext/ApplicationContext.hpp"
+#include "config.h"
+
+namespace globals {
+	std::string const program_name = "serve-bgen" ;
+	std::string const program_version = bgen_revision ;
+}
+
+struct ServeBgenOptionProcessor: public appcontext::CmdLineOptionProcessor
+{
+public:
+	std::string get_program_name() const { return globals::program_name ; }
+
+	void declare_options( appcontext::OptionProcessor& options ) {
+		// Meta-options
+		options.set_help_option( "-help" ) ;
+
+		options.declare_group( "Input file options" ) ;
+		options[ "-g" ]
+			.set_description(
+				"Paths of bgen files to serve.  Each file's bgenix index (with \".bgi\" appended to the filename)"
+				" is loaded into memory if it exists; otherwise the file is scanned at startup."
+			)
+			.set_takes_values_until_next_option()
+			.set_is_required()
+		;
+
+		options.declare_group( "Server options" ) ;
+		options[ "-socket" ]
+			.set_description(
+				"Path of a Unix domain socket to listen for HTTP requests on."
+			)
+			.set_takes_single_value()
+		;
+		options[ "-port" ]
+			.set_description(
+				"Port to listen for HTTP requests on.  Only connections to the loopback address (127.0.0.1) are accepted."
+			)
+			.set_takes_single_value()
+		;
+		options[ "-threads" ]
+			.set_description(
+				"Number of threads used to serve requests.  Zero means use all available cores."
+			)
+			.set_takes_single_value()
+			.set_default_value( 0 )
+		;
+		options[ "-decode-threads" ]
+			.set_description(
+				"Number of additional threads used to decode the dosages of each variant, which lowers the latency of"
+				" requests for files with very many samples.  These are shared between requests.  Zero means use all"
+				" available cores.  By default each variant is decoded on the thread serving the request."
+			)
+			.set_takes_single_value()
+		;
+		options[ "-cache-size" ]
+			.set_description(
+				"Size, in megabytes, of the cache of uncompressed genotype data blocks shared between requests."
+			)
+			.set_takes_single_value()
+			.set_default_value( 256 )
+		;
+		options[ "-max-variants" ]
+			.set_description(
+				"Maximum number of variants returned by a single request."
+			)
+			.set_takes_single_value()
+			.set_default_value( 10000 )
+		;
+		options[ "-vcf-call-threshold" ]
+			.set_description(
+				"Threshhold used to call genotypes for the GT field in VCF responses.  A genotype (or, for phased data,"
+				" an allele of each haplotype) is called if its probability exceeds this value."
+			)
+			.set_takes_single_value()
+			.set_default_value( 0.9 )
+		;
+
+		options.option_excludes_option( "-socket", "-port" ) ;
+	}
+} ;
+
+namespace {
+	using genfile::byte_t ;
+	using serve::HttpError ;
+	using serve::HttpRequest ;
+	using serve::HttpResponse ;
+	using serve::CachedVariant ;
+	using serve::VariantCache ;
+	using serve::split ;
+	using serve::json_string ;
+	using serve::read_request ;
+	using serve::send_response ;
+	typedef std::chrono::steady_clock Clock ;
+
+	volatile std::sig_atomic_t stop_requested = 0 ;
+
+	extern "C" void request_stop( int ) {
+		stop_requested = 1 ;
+	}
+
+	// The location of a variant in a served file.
+	struct VariantLocation {
+		uint32_t chromosome ;
+		uint32_t position ;
+		int64_t offset ;
+	} ;
+
+	// A bgen file being served, with its header, sample identifiers and variant locations held in memory.
+	// Streams on the file are kept open and reused between requests.
+	struct ServedFile {
+	public:
+		ServedFile( std::string const& filename_, appcontext::UIContext& ui ):
+			filename( filename_ ),
+			indexed( false )
+		{
+			genfile::bgen::View::UniquePtr view = genfile::bgen::View::create( filename ) ;
+			context = view->context() ;
+			view->get_sample_ids( [this]( std::string const& id ) { sample_ids.push_back( id ) ; } ) ;
+			for( std::size_t i = 0; i < sample_ids.size(); ++i ) {
+				sample_index.insert( std::make_pair( sample_ids[i], i )) ;
+			}
+
+			std::vector< std::string > chromosome_names ;
+			std::map< std::string, uint32_t > chromosome_ids ;
+			std::vector< std::string > rsids ;
+			auto add_batch = [&]( genfile::bgen::VariantBatch& batch ) {
+				for( std::size_t i = 0; i < batch.size(); ++i ) {
+					std::string const chromosome( batch.chromosome(i) ) ;
+					std::map< std::string, uint32_t >::const_iterator where = chromosome_ids.find( chromosome ) ;
+					if( where == chromosome_ids.end() ) {
+						where = chromosome_ids.insert( std::make_pair( chromosome, uint32_t( chromosome_names.size() ))).first ;
+						chromosome_names.push_back( chromosome ) ;
+					}
+					locations.push_back( VariantLocation{ where->second, batch.position[i], batch.file_offset[i] } ) ;
+					rsids.emplace_back( batch.rsid(i) ) ;
+				}
+			} ;
+
+			auto progress_context = ui.get_progress_context( "Loading \"" + filename + "\"" ) ;
+			if( std::filesystem::exists( filename + ".bgi" )) {
+				genfile::bgen::IndexQuery::UniquePtr query = genfile::bgen::IndexQuery::create( filename + ".bgi" ) ;
+				if( query->file_metadata() ) {
+					genfile::bgen::IndexQuery::FileMetadata const& metadata = *( query->file_metadata() ) ;
+					if( metadata.size != view->file_metadata().size || metadata.first_bytes != view->file_metadata().first_bytes ) {
+						throw std::invalid_argument( "The index \"" + filename + ".bgi\" was not made from this file.  Do you need to recreate the index?" ) ;
+					}
+				}
+				query->initialise() ;
+				query->read_variant_batches(
+					4096,
+					[&]( genfile::bgen::VariantBatch& batch ) {
+						add_batch( batch ) ;
+						progress_context( locations.size(), query->number_of_variants() ) ;
+					}
+				) ;
+				indexed = true ;
+			} else {
+				genfile::bgen::VariantBatch batch ;
+				while( view->read_variant_batch( 4096, &batch ) > 0 ) {
+					add_batch( batch ) ;
+					progress_context( locations.size(), context.number_of_variants ) ;
+				}
+			}
+			progress_context.finish() ;
+
+			// Sort variants by chromosome and position, keeping file order for variants at the same position.
+			std::vector< std::size_t > order( locations.size() ) ;
+			std::iota( order.begin(), order.end(), 0 ) ;
+			std::stable_sort(
+				order.begin(), order.end(),
+				[&]( std::size_t a, std::size_t b ) {
+					VariantLocation const& la = locations[a] ;
+					VariantLocation const& lb = locations[b] ;
+					if( la.chromosome != lb.chromosome ) {
+						return chromosome_names[ la.chromosome ] < chromosome_names[ lb.chromosome ] ;
+					}
+					return std::tie( la.position, la.offset ) < std::tie( lb.position, lb.offset ) ;
+				}
+			) ;
+			std::vector< VariantLocation > sorted( locations.size() ) ;
+			for( std::size_t i = 0; i < order.size(); ++i ) {
+				sorted[i] = locations[ order[i] ] ;
+				rsid_index.insert( std::make_pair( std::move( rsids[ order[i] ] ), i )) ;
+			}
+			locations.swap( sorted ) ;
+			chromosomes.swap( chromosome_names ) ;
+		}
+
+		// Return the range of variants (as indices into locations) on the given chromosome between start and end inclusive.
+		std::pair< std::size_t, std::size_t > find_range( std::string const& chromosome, uint32_t start, uint32_t end ) const {
+			auto compare = [this]( VariantLocation const& location, std::pair< std::string const*, uint32_t > const& value ) {
+				int const c = chromosomes[ location.chromosome ].compare( *value.first ) ;
+				return c < 0 || ( c == 0 && location.position < value.second ) ;
+			} ;
+			std::vector< VariantLocation >::const_iterator const begin = std::lower_bound(
+				locations.begin(), locations.end(), std::make_pair( &chromosome, start ), compare
+			) ;
+			std::vector< VariantLocation >::const_iterator const finish = std::lower_bound(
+				begin, locations.end(), std::make_pair( &chromosome, end + 1 ), compare
+			) ;
+			return std::make_pair( begin - locations.begin(), finish - locations.begin() ) ;
+		}
+
+		// Return a stream on the file, opening a new one if all are in use.
+		std::unique_ptr< std::istream > acquire_stream() {
+			{
+				std::lock_guard< std::mutex > lock( m_streams_mutex ) ;
+				if( !m_streams.empty() ) {
+					std::unique_ptr< std::istream > result = std::move( m_streams.back() ) ;
+					m_streams.pop_back() ;
+					return result ;
+				}
+			}
+			std::unique_ptr< std::istream > result( new std::ifstream( filename, std::ifstream::binary )) ;
+			if( !*result ) {
+				throw std::invalid_argument( "Could not open \"" + filename + "\"." ) ;
+			}
+			return result ;
+		}
+
+		void release_stream( std::unique_ptr< std::istream > stream ) {
+			stream->clear() ;
+			std::lock_guard< std::mutex > lock( m_streams_mutex ) ;
+			m_streams.push_back( std::move( stream )) ;
+		}
+
+	public:
+		std::string const filename ;
+		genfile::bgen::Context context ;
+		bool indexed ;
+		std::vector< std::string > sample_ids ;
+		std::unordered_map< std::string, std::size_t > sample_index ;
+		std::vector< std::string > chromosomes ;
+		// Variants, sorted by chromosome and position.
+		std::vector< VariantLocation > locations ;
+		std::unordered_multimap< std::string, std::size_t > rsid_index ;
+
+	private:
+		std::mutex m_streams_mutex ;
+		std::vector< std::unique_ptr< std::istream > > m_streams ;
+	} ;
+
+	// Request counts, volumes and latencies, for reporting by the /metrics endpoint.
+	struct Metrics {
+	public:
+		Metrics():
+			m_start( Clock::now() ),
+			m_errors( 0 ),
+			m_variants( 0 ),
+			m_bytes( 0 ),
+			m_total_latency( 0 ),
+			m_max_latency( 0 ),
+			m_recent_latencies( 1000, 0.0 ),
+			m_requests( 0 )
+		{}
+
+		void record( std::string const& endpoint, int status, double latency, std::size_t variants, std::size_t bytes ) {
+			std::lock_guard< std::mutex > lock( m_mutex ) ;
+			++m_requests_by_endpoint[ endpoint ] ;
+			m_errors += ( status != 200 ) ? 1 : 0 ;
+			m_variants += variants ;
+			m_bytes += bytes ;
+			m_total_latency += latency ;
+			m_max_latency = std::max( m_max_latency, latency ) ;
+			m_recent_latencies[ m_requests % m_recent_latencies.size() ] = latency ;
+			++m_requests ;
+		}
+
+		std::string summarise_as_json( std::size_t active_connections, VariantCache const& cache ) const {
+			std::lock_guard< std::mutex > lock( m_mutex ) ;
+			double const uptime = std::chrono::duration< double >( Clock::now() - m_start ).count() ;
+			std::vector< double > recent(
+				m_recent_latencies.begin(),
+				m_recent_latencies.begin() + std::min< std::size_t >( m_requests, m_recent_latencies.size() )
+			) ;
+			std::sort( recent.begin(), recent.end() ) ;
+			auto quantile = [&recent]( double q ) {
+				return recent.empty() ? 0.0 : recent[ std::min( recent.size() - 1, std::size_t( q * recent.size() )) ] ;
+			} ;
+			std::string by_endpoint ;
+			for( std::map< std::string, uint64_t >::const_iterator i = m_requests_by_endpoint.begin(); i != m_requests_by_endpoint.end(); ++i ) {
+				by_endpoint += fmt::format( "{}{}: {}", by_endpoint.empty() ? "" : ", ", json_string( i->first ), i->second ) ;
+			}
+			return fmt::format(
+				"{{\n"
+				"\"uptime_seconds\": {:.3f},\n"
+				"\"active_connections\": {},\n"
+				"\"requests\": {{\"total\": {}, \"errors\": {}, \"by_endpoint\": {{{}}}}},\n"
+				"\"variants_served\": {},\n"
+				"\"bytes_sent\": {},\n"
+				"\"throughput\": {{\"requests_per_second\": {:.3f}, \"variants_per_second\": {:.3f}, \"bytes_per_second\": {:.1f}}},\n"
+				"\"latency_seconds\": {{\"mean\": {:.6f}, \"max\": {:.6f}, \"recent_requests\": {}, \"p50\": {:.6f}, \"p90\": {:.6f}, \"p99\": {:.6f}}},\n"
+				"\"cache\": {}\n"
+				"}}\n",
+				uptime,
+				active_connections,
+				m_requests, m_errors, by_endpoint,
+				m_variants,
+				m_bytes,
+				m_requests / uptime, m_variants / uptime, m_bytes / uptime,
+				( m_requests > 0 ) ? ( m_total_latency / m_requests ) : 0.0, m_max_latency, recent.size(),
+				quantile( 0.5 ), quantile( 0.9 ), quantile( 0.99 ),
+				cache.summarise_as_json()
+			) ;
+		}
+
+	private:
+		mutable std::mutex m_mutex ;
+		Clock::time_point const m_start ;
+		std::map< std::string, uint64_t > m_requests_by_endpoint ;
+		uint64_t m_errors ;
+		uint64_t m_variants ;
+		uint64_t m_bytes ;
+		double m_total_latency ;
+		double m_max_latency ;
+		// Latencies of the most recent requests, stored cyclically, from which quantiles are reported.
+		std::vector< double > m_recent_latencies ;
+		uint64_t m_requests ;
+	} ;
+
+	void append_little_endian_float( float value, std::string* out ) {
+		uint32_t bits ;
+		std::memcpy( &bits, &value, sizeof( bits )) ;
+		for( int i = 0; i < 4; ++i ) {
+			*out += char(( bits >> ( 8*i )) & 0xFF ) ;
+		}
+	}
+}
+
+struct ServeBgenApplication: public appcontext::ApplicationContext
+{
+public:
+	ServeBgenApplication( int argc, char** argv ):
+		appcontext::ApplicationContext(
+			globals::program_name,
+			globals::program_version,
+			std::make_unique<ServeBgenOptionProcessor>(),
+			argc,
+			argv,
+			"-log"
+		),
+		m_active_connections( 0 )
+	{
+		try {
+			if( !options().check( "-socket" ) && !options().check( "-port" )) {
+				throw std::invalid_argument( "One of -socket or -port must be given." ) ;
+			}
+			load( options().get_values< std::string >( "-g" )) ;
+			serve() ;
+		} catch( std::invalid_argument const& e ) {
+			ui().logger() << "!! Error: " << e.what() << "\n" ;
+			throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+		} catch( genfile::bgen::BGenError const& e ) {
+			ui().logger() << "!! Error: an error occurred reading genotype data.\n" ;
+			throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+		}
+	}
+
+private:
+	std::vector< std::unique_ptr< ServedFile > > m_files ;
+	std::unique_ptr< VariantCache > m_cache ;
+	// Threads that decode ranges of samples of a variant; these are separate from the threads serving
+	// requests, which wait for them.
+	genfile::ThreadPool::UniquePtr m_decode_pool ;
+	Metrics m_metrics ;
+	std::atomic< std::size_t > m_active_connections ;
+
+private:
+	void load( std::vector< std::string > const& filenames ) {
+		for( std::string const& filename: filenames ) {
+			m_files.emplace_back( new ServedFile( filename, ui() )) ;
+			ServedFile const& file = *m_files.back() ;
+			ui().logger() << fmt::format(
+				"Loaded \"{}\": {} samples, {} variants ({}).\n",
+				filename, file.sample_ids.size(), file.locations.size(),
+				file.indexed ? "from index" : "by scanning the file"
+			) ;
+		}
+		m_cache.reset( new VariantCache( options().get< std::size_t >( "-cache-size" ) * 1024 * 1024 )) ;
+		if( options().check( "-decode-threads" )) {
+			m_decode_pool.reset( new genfile::ThreadPool( options().get< std::size_t >( "-decode-threads" ))) ;
+		}
+	}
+
+	void serve() {
+		int const listener = options().check( "-socket" )
+			? open_unix_socket( options().get< std::string >( "-socket" ))
+			: open_tcp_socket( options().get< int >( "-port" )) ;
+
+		std::signal( SIGINT, request_stop ) ;
+		std::signal( SIGTERM, request_stop ) ;
+		// Clients that disconnect early must not terminate the server.
+		std::signal( SIGPIPE, SIG_IGN ) ;
+
+		{
+			genfile::ThreadPool pool( options().get< std::size_t >( "-threads" )) ;
+			ui().logger() << fmt::format(
+				"Serving {} files on {} using {} threads.  Send SIGINT or SIGTERM to stop.\n",
+				m_files.size(),
+				options().check( "-socket" )
+					? "\"" + options().get< std::string >( "-socket" ) + "\""
+					: "127.0.0.1:" + options().get< std::string >( "-port" ),
+				pool.number_of_threads()
+			) ;
+			while( !stop_requested ) {
+				pollfd poll_fd = { listener, POLLIN, 0 } ;
+				if( ::poll( &poll_fd, 1, 250 ) <= 0 ) {
+					continue ;
+				}
+				int const connection = ::accept( listener, 0, 0 ) ;
+				if( connection < 0 ) {
+					continue ;
+				}
+				// Don't let a stalled client hold a thread indefinitely.
+				timeval timeout = { 60, 0 } ;
+				::setsockopt( connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout )) ;
+				::setsockopt( connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof( timeout )) ;
+				++m_active_connections ;
+				pool.submit( [this,connection]() { handle( connection ) ; } ) ;
+			}
+			ui().logger() << "Stopping; waiting for requests in progress to complete...\n" ;
+		}
+		::close( listener ) ;
+		if( options().check( "-socket" )) {
+			::unlink( options().get< std::string >( "-socket" ).c_str() ) ;
+		}
+		ui().logger() << fmt::format( "Final metrics:\n{}", m_metrics.summarise_as_json( m_active_connections, *m_cache )) ;
+	}
+
+	int open_unix_socket( std::string const& path ) const {
+		sockaddr_un address ;
+		std::memset( &address, 0, sizeof( address )) ;
+		address.sun_family = AF_UNIX ;
+		if( path.size() >= sizeof( address.sun_path )) {
+			throw std::invalid_argument( "Socket path \"" + path + "\" is too long." ) ;
+		}
+		std::strcpy( address.sun_path, path.c_str() ) ;
+		// Remove a socket left behind by a previous server, but nothing else.
+		struct stat info ;
+		if( ::stat( path.c_str(), &info ) == 0 ) {
+			if( !S_ISSOCK( info.st_mode )) {
+				throw std::invalid_argument( "\"" + path + "\" exists and is not a socket." ) ;
+			}
+			::unlink( path.c_str() ) ;
+		}
+		int const result = ::socket( AF_UNIX, SOCK_STREAM, 0 ) ;
+		if( result < 0 || ::bind( result, reinterpret_cast< sockaddr* >( &address ), sizeof( address )) != 0 || ::listen( result, 128 ) != 0 ) {
+			throw std::invalid_argument( "Could not listen on socket \"" + path + "\": " + std::strerror( errno ) + "." ) ;
+		}
+		return result ;
+	}
+
+	int open_tcp_socket( int port ) const {
+		sockaddr_in address ;
+		std::memset( &address, 0, sizeof( address )) ;
+		address.sin_family = AF_INET ;
+		address.sin_port = htons( port ) ;
+		address.sin_addr.s_addr = htonl( INADDR_LOOPBACK ) ;
+		int const result = ::socket( AF_INET, SOCK_STREAM, 0 ) ;
+		int const reuse = 1 ;
+		if(
+			result < 0
+			|| ::setsockopt( result, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof( reuse )) != 0
+			|| ::bind( result, reinterpret_cast< sockaddr* >( &address ), sizeof( address )) != 0
+			|| ::listen( result, 128 ) != 0
+		) {
+			throw std::invalid_argument( "Could not listen on port " + std::to_string( port ) + ": " + std::strerror( errno ) + "." ) ;
+		}
+		return result ;
+	}
+
+	// Read a request from the connection, respond to it, and close the connection.
+	// This runs on the thread pool.
+	void handle( int connection ) {
+		Clock::time_point const start = Clock::now() ;
+		HttpRequest request ;
+		HttpResponse response ;
+		std::size_t number_of_variants = 0 ;
+		bool have_request = false ;
+		try {
+			have_request = read_request( connection, &request ) ;
+			if( have_request ) {
+				response = respond( request, &number_of_variants ) ;
+			}
+		} catch( HttpError const& e ) {
+			response = HttpResponse( e.status() ) ;
+			response.body = std::string( e.what() ) + "\n" ;
+		} catch( std::invalid_argument const& e ) {
+			response = HttpResponse( 400 ) ;
+			response.body = std::string( e.what() ) + "\n" ;
+		} catch( genfile::bgen::BGenError const& e ) {
+			response = HttpResponse( 500 ) ;
+			response.body = "An error occurred reading genotype data.\n" ;
+		} catch( std::exception const& e ) {
+			response = HttpResponse( 500 ) ;
+			response.body = std::string( e.what() ) + "\n" ;
+		}
+		std::size_t bytes = 0 ;
+		if( have_request || response.status != 200 ) {
+			bytes = send_response( connection, response ) ;
+		}
+		::close( connection ) ;
+		--m_active_connections ;
+		if( have_request ) {
+			std::string const endpoint = ( request.path == "/variants" || request.path == "/samples" || request.path == "/files" || request.path == "/metrics" )
+				? request.path : "other" ;
+			m_metrics.record(
+				endpoint, response.status,
+				std::chrono::duration< double >( Clock::now() - start ).count(),
+				number_of_variants, bytes
+			) ;
+		}
+	}
+
+	HttpResponse respond( HttpRequest const& request, std::size_t* number_of_variants ) {
+		if( request.method != "GET" && request.method != "POST" ) {
+			throw HttpError( 405, "Only GET and POST requests are supported." ) ;
+		}
+		if( request.path == "/variants" ) {
+			return respond_variants( request, number_of_variants ) ;
+		} else if( request.path == "/samples" ) {
+			ServedFile const& file = *m_files[ find_file( request ) ] ;
+			HttpResponse response ;
+			for( std::string const& id: file.sample_ids ) {
+				response.body += id + "\n" ;
+			}
+			return response ;
+		} else if( request.path == "/files" ) {
+			HttpResponse response( 200, "application/json" ) ;
+			response.body = "[\n" ;
+			for( std::size_t i = 0; i < m_files.size(); ++i ) {
+				ServedFile const& file = *m_files[i] ;
+				response.body += fmt::format(
+					"{{\"name\": {}, \"samples\": {}, \"variants\": {}, \"layout\": {}, \"indexed\": {}}}{}\n",
+					json_string( file.filename ), file.sample_ids.size(), file.locations.size(),
+					( file.context.flags & genfile::bgen::e_Layout ) >> 2,
+					file.indexed ? "true" : "false",
+					( i + 1 < m_files.size() ) ? "," : ""
+				) ;
+			}
+			response.body += "]\n" ;
+			return response ;
+		} else if( request.path == "/metrics" ) {
+			HttpResponse response( 200, "application/json" ) ;
+			response.body = m_metrics.summarise_as_json( m_active_connections, *m_cache ) ;
+			return response ;
+		}
+		throw HttpError( 404, "Unknown endpoint \"" + request.path + "\"; expected /variants, /samples, /files or /metrics." ) ;
+	}
+
+	// Return the index of the file named by the request's "file" parameter, which may be omitted
+	// if only one file is served.  Files can be named by their path or by its last component.
+	std::size_t find_file( HttpRequest const& request ) const {
+		std::optional< std::string > const name = request.get( "file" ) ;
+		if( !name ) {
+			if( m_files.size() == 1 ) {
+				return 0 ;
+			}
+			throw HttpError( 400, "A file must be specified using the \"file\" parameter." ) ;
+		}
+		for( std::size_t i = 0; i < m_files.size(); ++i ) {
+			std::string const& filename = m_files[i]->filename ;
+			if( *name == filename || *name == std::filesystem::path( filename ).filename().string() ) {
+				return i ;
+			}
+		}
+		throw HttpError( 404, "File \"" + *name + "\" is not being served." ) ;
+	}
+
+	// Return the variants (as indices into the file's locations) selected by the request's "range"
+	// and "rsids" parameters, in position order.
+	std::vector< std::size_t > select_variants( ServedFile const& file, HttpRequest const& request ) const {
+		std::optional< std::string > const ranges = request.get( "range" ) ;
+		std::optional< std::string > const rsids = request.get( "rsids" ) ;
+		if( !ranges && !rsids ) {
+			throw HttpError( 400, "Variants must be specified using the \"range\" or \"rsids\" parameters." ) ;
+		}
+		std::size_t const max_variants = options().get< std::size_t >( "-max-variants" ) ;
+		std::vector< std::size_t > result ;
+		for( std::string const& range: split( ranges.value_or( "" ), ',' )) {
+			// Ranges are written chromosome:start-end, or chromosome:position.
+			genfile::bgen::IndexQuery::GenomicRange parsed ;
+			try {
+				if( range.find( '-', range.find( ':' )) != std::string::npos ) {
+					parsed = genfile::bgen::parse_range( range ) ;
+				} else {
+					genfile::bgen::IndexQuery::VariantPosition const position = genfile::bgen::parse_position( range ) ;
+					if( position.has_alleles() ) {
+						throw std::invalid_argument( range ) ;
+					}
+					parsed = genfile::bgen::IndexQuery::GenomicRange( position.chromosome(), position.position(), position.position() ) ;
+				}
+			} catch( std::invalid_argument const& ) {
+				throw HttpError( 400, "Malformed range \"" + range + "\"; expected chromosome:start-end." ) ;
+			}
+			std::pair< std::size_t, std::size_t > const found = file.find_range( parsed.chromosome(), parsed.start(), parsed.end() ) ;
+			if( result.size() + ( found.second - found.first ) > max_variants ) {
+				throw HttpError( 413, fmt::format( "Request selects more than the maximum of {} variants.", max_variants )) ;
+			}
+			for( std::size_t i = found.first; i < found.second; ++i ) {
+				result.push_back( i ) ;
+			}
+		}
+		for( std::string const& rsid: split( rsids.value_or( "" ), ',' )) {
+			auto const found = file.rsid_index.equal_range( rsid ) ;
+			for( auto i = found.first; i != found.second; ++i ) {
+				result.push_back( i->second ) ;
+			}
+			if( result.size() > max_variants ) {
+				throw HttpError( 413, fmt::format( "Request selects more than the maximum of {} variants.", max_variants )) ;
+			}
+		}
+		std::sort( result.begin(), result.end() ) ;
+		result.erase( std::unique( result.begin(), result.end() ), result.end() ) ;
+		return result ;
+	}
+
+	// Return the samples selected by the request's "samples" parameter, in the order given, or all samples if
+	// the parameter is absent.
+	std::vector< std::size_t > select_samples( ServedFile const& file, HttpRequest const& request ) const {
+		std::vector< std::size_t > result ;
+		std::optional< std::string > const samples = request.get( "samples" ) ;
+		if( !samples ) {
+			result.resize( file.sample_ids.size() ) ;
+			std::iota( result.begin(), result.end(), 0 ) ;
+			return result ;
+		}
+		for( std::string const& id: split( *samples, ',' )) {
+			std::unordered_map< std::string, std::size_t >::const_iterator where = file.sample_index.find( id ) ;
+			if( where == file.sample_index.end() ) {
+				throw HttpError( 400, "Sample \"" + id + "\" is not in the file." ) ;
+			}
+			result.push_back( where->second ) ;
+		}
+		return result ;
+	}
+
+	// Return the given variant, reading it from the file if it is not in the cache.
+	VariantCache::Value get_variant( std::size_t file_i, std::size_t variant_i ) {
+		ServedFile& file = *m_files[ file_i ] ;
+		VariantCache::Key const key( file_i, file.locations[ variant_i ].offset ) ;
+		VariantCache::Value result = m_cache->find( key ) ;
+		if( result ) {
+			return result ;
+		}
+		std::shared_ptr< CachedVariant > variant( new CachedVariant() ) ;
+		std::vector< byte_t > buffer ;
+		std::unique_ptr< std::istream > stream = file.acquire_stream() ;
+		stream->seekg( key.second ) ;
+		bool const success = genfile::bgen::read_snp_identifying_data(
+			*stream, file.context,
+			&variant->SNPID, &variant->rsid, &variant->chromosome, &variant->position,
+			[&variant]( std::size_t n ) { variant->alleles.resize( n ) ; },
+			[&variant]( std::size_t i, std::string const& allele ) { variant->alleles.at( i ) = allele ; }
+		) ;
+		if( !success ) {
+			throw genfile::bgen::BGenError() ;
+		}
+		genfile::bgen::read_genotype_data_block( *stream, file.context, &buffer ) ;
+		file.release_stream( std::move( stream )) ;
+		genfile::bgen::uncompress_probability_data( file.context, buffer, &variant->data ) ;
+		m_cache->insert( key, variant ) ;
+		return variant ;
+	}
+
+	HttpResponse respond_variants( HttpRequest const& request, std::size_t* number_of_variants ) {
+		std::size_t const file_i = find_file( request ) ;
+		ServedFile const& file = *m_files[ file_i ] ;
+		std::string const format = request.get( "format" ).value_or( "vcf" ) ;
+		if( format != "vcf" && format != "dosage" && format != "json" ) {
+			throw HttpError( 400, "Unrecognised format \"" + format + "\"; expected vcf, dosage or json." ) ;
+		}
+		std::vector< std::size_t > const variant_indices = select_variants( file, request ) ;
+		std::vector< std::size_t > const samples = select_samples( file, request ) ;
+		std::vector< VariantCache::Value > variants ;
+		variants.reserve( variant_indices.size() ) ;
+		for( std::size_t i: variant_indices ) {
+			variants.push_back( get_variant( file_i, i )) ;
+		}
+		*number_of_variants = variants.size() ;
+
+		if( format == "vcf" ) {
+			return format_vcf( file, variants, samples ) ;
+		}
+		HttpResponse response( 200, ( format == "json" ) ? "application/json" : "application/octet-stream" ) ;
+		std::vector< float > dosages( file.sample_ids.size() ) ;
+		if( format == "dosage" ) {
+			// A matrix of 32-bit little-endian floats, one row per variant and one column per sample,
+			// with NaN for missing values.  Variant and sample order is as for the other formats.
+			response.headers.emplace_back( "X-Number-Of-Variants", std::to_string( variants.size() )) ;
+			response.headers.emplace_back( "X-Number-Of-Samples", std::to_string( samples.size() )) ;
+			response.body.reserve( 4 * variants.size() * samples.size() ) ;
+			for( VariantCache::Value const& variant: variants ) {
+				compute_dosages( file, *variant, &dosages ) ;
+				for( std::size_t i: samples ) {
+					append_little_endian_float( dosages[i], &response.body ) ;
+				}
+			}
+		} else {
+			response.body = "{\n\"samples\": [" ;
+			for( std::size_t i = 0; i < samples.size(); ++i ) {
+				response.body += ( i > 0 ? ", " : "" ) + json_string( file.sample_ids[ samples[i] ] ) ;
+			}
+			response.body += "],\n\"variants\": [" ;
+			for( std::size_t v = 0; v < variants.size(); ++v ) {
+				CachedVariant const& variant = *variants[v] ;
+				compute_dosages( file, variant, &dosages ) ;
+				response.body += fmt::format(
+					"{}\n{{\"chromosome\": {}, \"position\": {}, \"rsid\": {}, \"SNPID\": {}, \"alleles\": [",
+					( v > 0 ? "," : "" ), json_string( variant.chromosome ), variant.position,
+					json_string( variant.rsid ), json_string( variant.SNPID )
+				) ;
+				for( std::size_t k = 0; k < variant.alleles.size(); ++k ) {
+					response.body += ( k > 0 ? ", " : "" ) + json_string( variant.alleles[k] ) ;
+				}
+				response.body += "], \"dosage\": [" ;
+				for( std::size_t i = 0; i < samples.size(); ++i ) {
+					response.body += ( i > 0 ) ? ", " : "" ;
+					float const dosage = dosages[ samples[i] ] ;
+					if( std::isnan( dosage )) {
+						response.body += "null" ;
+					} else {
+						fmt::format_to( std::back_inserter( response.body ), "{:.6g}", dosage ) ;
+					}
+				}
+				response.body += "]}" ;
+			}
+			response.body += "\n]\n}\n" ;
+		}
+		return response ;
+	}
+
+	// Compute dosages of the second allele, which are missing for variants that are not biallelic.
+	void compute_dosages( ServedFile const& file, CachedVariant const& variant, std::vector< float >* dosages ) const {
+		if( variant.alleles.size() != 2 ) {
+			std::fill( dosages->begin(), dosages->end(), genfile::bgen::DosageTraits< float >::missing() ) ;
+			return ;
+		}
+		byte_t const* const data = &variant.data[0] ;
+		if( m_decode_pool.get() && ( file.context.flags & genfile::bgen::e_Layout ) == genfile::bgen::e_Layout2 ) {
+			genfile::bgen::v12::compute_dosages(
+				genfile::bgen::v12::GenotypeDataBlock( file.context, data, data + variant.data.size() ),
+				&(*dosages)[0], genfile::bgen::DosageOptions(), *m_decode_pool
+			) ;
+		} else {
+			genfile::bgen::parse_dosage_data( data, data + variant.data.size(), file.context, &(*dosages)[0] ) ;
+		}
+	}
+
+	HttpResponse format_vcf(
+		ServedFile const& file,
+		std::vector< VariantCache::Value > const& variants,
+		std::vector< std::size_t > const& samples
+	) const {
+		HttpResponse response( 200, "text/plain" ) ;
+		std::string& body = response.body ;
+		body = "##fileformat=VCFv4.2\n"
+			"##FORMAT=<ID=GT,Type=String,Number=1,Description=\"Threshholded genotype call\">\n"
+			"##FORMAT=<ID=GP,Type=Float,Number=G,Description=\"Genotype call probabilities\">\n"
+			"##FORMAT=<ID=HP,Type=Float,Number=.,Description=\"Haplotype call probabilities\">\n"
+			"#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT" ;
+		for( std::size_t i: samples ) {
+			body += "\t" + file.sample_ids[i] ;
+		}
+		body += "\n" ;
+		std::vector< bool > selected( file.sample_ids.size(), false ) ;
+		for( std::size_t i: samples ) {
+			selected[i] = true ;
+		}
+		genfile::bgen::VCFProbWriter writer( options().get< double >( "-vcf-call-threshold" )) ;
+		writer.set_selected_samples( &selected ) ;
+		for( VariantCache::Value const& variant: variants ) {
+			genfile::bgen::parse_probability_data( &variant->data[0], &variant->data[0] + variant->data.size(), file.context, writer ) ;
+			body += variant->chromosome + "\t" + std::to_string( variant->position ) + "\t"
+				+ ( variant->rsid.empty() ? "." : variant->rsid ) + "\t" + ( variant->alleles.empty() ? "." : variant->alleles[0] ) + "\t" ;
+			for( std::size_t k = 1; k < variant->alleles.size(); ++k ) {
+				body += ( k > 1 ? "," : "" ) + variant->alleles[k] ;
+			}
+			body += ( variant->alleles.size() < 2 ) ? ".\t.\t.\t.\t" : "\t.\t.\t.\t" ;
+			body += writer.phased() ? "GT:HP" : "GT:GP" ;
+			for( std::size_t i: samples ) {
+				body += '\t' ;
+				body += writer.entry( i ) ;
+			}
+			body += '\n' ;
+		}
+		return response ;
+	}
+} ;
+
+int main( int argc, char** argv ) {
+	std::ios_base::sync_with_stdio( false ) ;
+	try {
+		ServeBgenApplication app( argc, argv ) ;
+	}
+	catch( appcontext::HaltProgramWithReturnCode const& e ) {
+		return e.return_code() ;
+	}
+	return 0 ;
+}
@@ -0,0 +1,253 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <limits>
+#include <filesystem>
+#include <stdexcept>
+#include <fmt/format.h>
+#include "genfile/bgen.hpp"
+#include "genfile/View.hpp"
+#include "genfile/ThreadPool.hpp"
+#include "genfile/TransposedSidecar.hpp"
+#include "genfile/query_spec.hpp"
+#include "appcontext/CmdLineOptionProcessor.hpp"
+#include "appcontext/ApplicationContext.hpp"
+#include "config.h"
+
+namespace globals {
+	std::string const program_name = "transpose-bgen" ;
+	std::string const program_version = bgen_revision ;
+}
+
+struct TransposeBgenOptionProcessor: public appcontext::CmdLineOptionProcessor
+{
+public:
+	std::string get_program_name() const { return globals::program_name ; }
+
+	void declare_options( appcontext::OptionProcessor& options ) {
+		// Meta-options
+		options.set_help_option( "-help" ) ;
+
+		options.declare_group( "Input / output file options" ) ;
+		options[ "-g" ]
+			.set_description(
+				"Path of bgen file to operate on."
+			)
+			.set_takes_single_value()
+			.set_is_required()
+		;
+
+		options[ "-o" ]
+			.set_description(
+				"Path of transposed sidecar file.  If not specified, this defaults to"
+				" the bgen filename with \".transposed\" appended."
+			)
+			.set_takes_single_value()
+		;
+
+		options[ "-clobber" ]
+			.set_description(
+				"Specify that transpose-bgen should overwrite an existing sidecar file if it exists."
+			)
+		;
+
+		options.declare_group( "Build options" ) ;
+		options[ "-threads" ]
+			.set_description(
+				"Number of threads to use for decoding and compression.  Zero means use all available cores."
+			)
+			.set_takes_single_value()
+			.set_default_value( 0 )
+		;
+		options[ "-sample-chunk-size" ]
+			.set_description(
+				"Number of samples stored in each compressed tile.  Smaller values make single-sample"
+				" queries faster at the cost of compression."
+			)
+			.set_takes_single_value()
+			.set_default_value( 64 )
+		;
+		options[ "-variant-block-size" ]
+			.set_description(
+				"Maximum number of variants stored in each compressed tile."
+			)
+			.set_takes_single_value()
+			.set_default_value( 4096 )
+		;
+		options[ "-memory-limit" ]
+			.set_description(
+				"Approximate limit, in megabytes, on memory used to hold data while transposing."
+				" The variant block size is reduced if necessary to meet this limit."
+			)
+			.set_takes_single_value()
+			.set_default_value( 1024 )
+		;
+
+		options.declare_group( "Query options" ) ;
+		options[ "-sample" ]
+			.set_description(
+				"Instead of building the sidecar, output genotypes for the sample with this identifier"
+				" using an existing sidecar."
+			)
+			.set_takes_single_value()
+		;
+		options[ "-range" ]
+			.set_description(
+				"Genomic range to output genotypes for, in the form <chr>:<pos1>-<pos2>"
+				" (as for bgenix -incl-range).  Multiple ranges may be given."
+			)
+			.set_takes_values_until_next_option()
+		;
+
+		options.option_implies_option( "-range", "-sample" ) ;
+		options.option_implies_option( "-sample", "-range" ) ;
+		options.option_excludes_option( "-sample", "-clobber" ) ;
+	}
+} ;
+
+struct TransposeBgenApplication: public appcontext::ApplicationContext
+{
+public:
+	TransposeBgenApplication( int argc, char** argv ):
+		appcontext::ApplicationContext(
+			globals::program_name,
+			globals::program_version,
+			std::make_unique<TransposeBgenOptionProcessor>(),
+			argc,
+			argv,
+			"-log"
+		)
+	{
+		std::string const bgen_filename = options().get< std::string >( "-g" ) ;
+		std::string const sidecar_filename = options().check( "-o" )
+			? options().get< std::string >( "-o" )
+			: genfile::bgen::TransposedSidecar::default_filename( bgen_filename ) ;
+
+		try {
+			if( options().check( "-sample" )) {
+				query( bgen_filename, sidecar_filename ) ;
+			} else {
+				build( bgen_filename, sidecar_filename ) ;
+			}
+		} catch( std::invalid_argument const& e ) {
+			ui().logger() << "!! Error: " << e.what() << "\n" ;
+			throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+		}
+	}
+
+private:
+	void build( std::string const& bgen_filename, std::string const& sidecar_filename ) {
+		if( !options().check( "-clobber" ) && std::filesystem::exists( sidecar_filename ) ) {
+			ui().logger() << "Output file \"" << sidecar_filename << "\" exists.  Use -clobber if you want me to overwrite it.\n" ;
+			throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+		}
+
+		genfile::bgen::TransposedSidecar::BuildOptions build_options ;
+		build_options.sample_chunk_size = options().get< std::size_t >( "-sample-chunk-size" ) ;
+		build_options.variant_block_size = options().get< std::size_t >( "-variant-block-size" ) ;
+		build_options.memory_limit = options().get< std::size_t >( "-memory-limit" ) * 1024 * 1024 ;
+
+		genfile::bgen::View::UniquePtr view = genfile::bgen::View::create( bgen_filename ) ;
+		if( ( view->context().flags & genfile::bgen::e_Layout ) != genfile::bgen::e_Layout2 ) {
+			ui().logger() << "!! Error: transpose-bgen only supports bgen files with layout 2 (v1.2 and above).\n" ;
+			throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+		}
+
+		genfile::ThreadPool pool( options().get< std::size_t >( "-threads" )) ;
+		ui().logger() << fmt::format(
+			"Transposing \"{}\" ({} samples, {} variants) using {} threads...\n",
+			bgen_filename, view->number_of_samples(), view->number_of_variants(), pool.number_of_threads()
+		) ;
+		{
+			auto progress_context = ui().get_progress_context( "Transposing" ) ;
+			genfile::bgen::TransposedSidecar::build( *view, sidecar_filename, pool, build_options, progress_context ) ;
+		}
+		genfile::bgen::TransposedSidecar::UniquePtr sidecar = genfile::bgen::TransposedSidecar::open( sidecar_filename ) ;
+		ui().logger() << fmt::format(
+			"Finished writing \"{}\" ({} samples, {} variants).\n",
+			sidecar_filename, sidecar->number_of_samples(), sidecar->number_of_variants()
+		) ;
+	}
+
+	void query( std::string const& bgen_filename, std::string const& sidecar_filename ) {
+		genfile::bgen::View::UniquePtr view = genfile::bgen::View::create( bgen_filename ) ;
+		genfile::bgen::TransposedSidecar::UniquePtr sidecar = genfile::bgen::TransposedSidecar::open( sidecar_filename ) ;
+		if( !sidecar->matches( view->file_metadata() )) {
+			ui().logger() << "!! Error: sidecar \"" << sidecar_filename << "\" does not match \"" << bgen_filename << "\".  Do you need to recreate it?\n" ;
+			throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+		}
+
+		std::string const sample = options().get< std::string >( "-sample" ) ;
+		std::size_t sample_index = std::numeric_limits< std::size_t >::max() ;
+		{
+			std::size_t i = 0 ;
+			view->get_sample_ids(
+				[&]( std::string const& id ) {
+					if( id == sample && sample_index == std::numeric_limits< std::size_t >::max() ) {
+						sample_index = i ;
+					}
+					++i ;
+				}
+			) ;
+		}
+		if( sample_index == std::numeric_limits< std::size_t >::max() ) {
+			ui().logger() << "!! Error: sample \"" << sample << "\" was not found in \"" << bgen_filename << "\".\n" ;
+			throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+		}
+
+		// Variant identifying data is read directly from the bgen file at the offsets given by the sidecar.
+		std::ifstream bgen( bgen_filename.c_str(), std::ios::binary ) ;
+		std::string SNPID, rsid, chromosome ;
+		uint32_t position ;
+		std::vector< std::string > alleles ;
+
+		std::ostream& out = std::cout ;
+		out << "chromosome\tposition\trsid\tSNPID\tallele1\tallele2\tploidy\tphased\tprob1\tprob2\tdosage\n" ;
+		genfile::bgen::TransposedSidecar::SampleGenotypes genotypes ;
+		std::vector< std::string > const ranges = options().get_values< std::string >( "-range" ) ;
+		for( std::size_t r = 0; r < ranges.size(); ++r ) {
+			sidecar->get_sample_genotypes( sample_index, genfile::bgen::parse_range( ranges[r] ), &genotypes ) ;
+			for( std::size_t i = 0; i < genotypes.size(); ++i ) {
+				bgen.seekg( genotypes.file_positions[i] ) ;
+				genfile::bgen::read_snp_identifying_data(
+					bgen, view->context(),
+					&SNPID, &rsid, &chromosome, &position,
+					[&alleles]( std::size_t n ) { alleles.resize( n ) ; },
+					[&alleles]( std::size_t i, std::string const& allele ) { alleles.at(i) = allele ; }
+				) ;
+				out << chromosome << "\t" << position << "\t" << rsid << "\t" << SNPID
+					<< "\t" << alleles[0] << "\t" << alleles[1] ;
+				if( genotypes.is_missing( i )) {
+					out << "\t" << int( genotypes.ploidy[i] & 0x3F ) << "\t" << int( genotypes.phased[i] ) << "\tNA\tNA\tNA\n" ;
+				} else {
+					out << fmt::format(
+						"\t{}\t{}\t{:.4f}\t{:.4f}\t{:.4f}\n",
+						int( genotypes.ploidy[i] & 0x3F ),
+						int( genotypes.phased[i] ),
+						genotypes.probabilities[2*i] / 255.0,
+						genotypes.probabilities[2*i+1] / 255.0,
+						genotypes.dosage( i )
+					) ;
+				}
+			}
+		}
+	}
+} ;
+
+int main( int argc, char** argv ) {
+	std::ios_base::sync_with_stdio( false ) ;
+	try {
+		TransposeBgenApplication app( argc, argv ) ;
+	}
+	catch( appcontext::HaltProgramWithReturnCode const& e ) {
+		return e.return_code() ;
+	}
+	return 0 ;
+}
@@ -0,0 +1,278 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <fmt/format.h>
+#include "genfile/bgen.hpp"
+#include "genfile/Writer.hpp"
+#include "genfile/IndexWriter.hpp"
+#include "genfile/LineReader.hpp"
+#include "genfile/ThreadPool.hpp"
+#include "genfile/vcf_encoder.hpp"
+#include "appcontext/CmdLineOptionProcessor.hpp"
+#include "appcontext/ApplicationContext.hpp"
+#include "config.h"
+
+namespace globals {
+	std::string const program_name = "vcf2bgen" ;
+	std::string const program_version = bgen_revision ;
+}
+
+struct Vcf2BgenOptionProcessor: public appcontext::CmdLineOptionProcessor
+{
+public:
+	std::string get_program_name() const { return globals::program_name ; }
+
+	void declare_options( appcontext::OptionProcessor& options ) {
+		// Meta-options
+		options.set_help_option( "-help" ) ;
+
+		options.declare_group( "Input / output file options" ) ;
+		options[ "-vcf" ]
+			.set_description(
+				"Path of VCF file to convert.  This may be uncompressed, gzipped, or bgzipped."
+			)
+			.set_takes_single_value()
+			.set_is_required()
+		;
+		options[ "-og" ]
+			.set_description(
+				"Path of bgen file to write."
+			)
+			.set_takes_single_value()
+			.set_is_required()
+		;
+		options[ "-clobber" ]
+			.set_description(
+				"Specify that vcf2bgen should overwrite existing output files if they exist."
+			)
+		;
+		options[ "-no-index" ]
+			.set_description(
+				"Do not write a bgenix index for the output file.  By default the index is written"
+				" alongside the bgen file, with \".bgi\" appended to the filename."
+			)
+		;
+
+		options.declare_group( "Conversion options" ) ;
+		options[ "-field" ]
+			.set_description(
+				"FORMAT field to take genotypes from.  This can be \"GP\" (genotype probabilities, which must sum to one up to rounding error),"
+				" \"DS\" (expected dosage; multiallelic variants are skipped), or \"GT\" (genotype calls)."
+			)
+			.set_takes_single_value()
+			.set_default_value( "GP" )
+		;
+		options[ "-bits" ]
+			.set_description(
+				"Number of bits used to store each probability in the output file."
+			)
+			.set_takes_single_value()
+			.set_default_value( 8 )
+		;
+		options[ "-compression" ]
+			.set_description(
+				"Compression to apply to genotype data blocks.  This can be \"zlib\", \"zstd\" or \"none\"."
+			)
+			.set_takes_single_value()
+			.set_default_value( "zstd" )
+		;
+		options[ "-threads" ]
+			.set_description(
+				"Number of threads to use for parsing and encoding.  Zero means use all available cores."
+			)
+			.set_takes_single_value()
+			.set_default_value( 0 )
+		;
+		options[ "-chunk-size" ]
+			.set_description(
+				"Number of VCF records handed to each worker thread at a time."
+			)
+			.set_takes_single_value()
+			.set_default_value( 256 )
+		;
+	}
+} ;
+
+struct Vcf2BgenApplication: public appcontext::ApplicationContext
+{
+public:
+	Vcf2BgenApplication( int argc, char** argv ):
+		appcontext::ApplicationContext(
+			globals::program_name,
+			globals::program_version,
+			std::make_unique<Vcf2BgenOptionProcessor>(),
+			argc,
+			argv,
+			"-log"
+		)
+	{
+		std::string const vcf_filename = options().get< std::string >( "-vcf" ) ;
+		std::string const bgen_filename = options().get< std::string >( "-og" ) ;
+		std::string const index_filename = bgen_filename + ".bgi" ;
+		bool const write_index = !options().check( "-no-index" ) ;
+		if( !options().check( "-clobber" ) ) {
+			if( std::filesystem::exists( bgen_filename ) || ( write_index && std::filesystem::exists( index_filename ))) {
+				ui().logger() << "!! Error: output file \"" << bgen_filename << "\" or its index exists.  Use -clobber if you want me to overwrite it.\n" ;
+				throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+			}
+		} else if( write_index ) {
+			std::filesystem::remove( index_filename + ".tmp" ) ;
+		}
+
+		auto const remove_output = [&]() {
+			std::error_code ec ;
+			std::filesystem::remove( bgen_filename, ec ) ;
+			if( write_index ) {
+				std::filesystem::remove( index_filename + ".tmp", ec ) ;
+			}
+		} ;
+		try {
+			convert( vcf_filename, bgen_filename, write_index ? index_filename : "" ) ;
+		} catch( appcontext::HaltProgramWithReturnCode const& ) {
+			remove_output() ;
+			throw ;
+		} catch( std::exception const& e ) {
+			// Errors in the input are std::invalid_argument; others include failure to write the output or index.
+			ui().logger() << "!! Error: " << e.what() << "\n" ;
+			remove_output() ;
+			throw appcontext::HaltProgramWithReturnCode( -1 ) ;
+		}
+	}
+
+private:
+	void convert( std::string const& vcf_filename, std::string const& bgen_filename, std::string const& index_filename ) {
+		genfile::LineReader reader( vcf_filename ) ;
+		std::vector< std::string > const sample_ids = read_header( reader ) ;
+
+		genfile::bgen::Context context ;
+		context.number_of_samples = sample_ids.size() ;
+		context.flags = genfile::bgen::e_Layout2 | get_compression_flags( options().get< std::string >( "-compression" )) ;
+		int const number_of_bits = options().get< int >( "-bits" ) ;
+		if( number_of_bits < 1 || number_of_bits > 32 ) {
+			throw std::invalid_argument( "-bits must be between 1 and 32" ) ;
+		}
+
+		genfile::bgen::Writer writer( bgen_filename, context, sample_ids ) ;
+		genfile::bgen::IndexWriter::UniquePtr index_writer ;
+		if( index_filename != "" ) {
+			index_writer = genfile::bgen::IndexWriter::create( index_filename ) ;
+		}
+		genfile::vcf::VcfEncoder const encoder( writer.context(), options().get< std::string >( "-field" ), number_of_bits ) ;
+
+		genfile::ThreadPool pool( options().get< std::size_t >( "-threads" )) ;
+		ui().logger() << fmt::format(
+			"Converting \"{}\" ({} samples) to \"{}\" using {} threads...\n",
+			vcf_filename, sample_ids.size(), bgen_filename, pool.number_of_threads()
+		) ;
+
+		// Chunks of records are encoded by the pool, and written here in the order they were read.
+		// We bound the number of chunks in flight to bound memory use.
+		std::size_t const chunk_size = std::max( options().get< std::size_t >( "-chunk-size" ), std::size_t( 1 )) ;
+		std::size_t number_skipped = 0 ;
+		auto progress_context = ui().get_progress_context( "Converting" ) ;
+		genfile::OrderedTaskQueue< genfile::vcf::EncodedChunk > chunks(
+			pool, 2 * pool.number_of_threads(),
+			[&]( genfile::vcf::EncodedChunk const& chunk ) {
+				for( std::size_t i = 0; i < chunk.variants.size(); ++i ) {
+					genfile::vcf::EncodedVariant const& variant = chunk.variants[i] ;
+					genfile::bgen::IndexQuery::FileRange const range = writer.write_variant(
+						variant.id, variant.id, variant.chromosome, variant.position, variant.alleles,
+						&variant.data[0], &variant.data[0] + variant.data.size()
+					) ;
+					if( index_writer.get() ) {
+						index_writer->add_variant( variant.chromosome, variant.position, variant.id, variant.alleles, range ) ;
+					}
+				}
+				number_skipped += chunk.number_skipped ;
+				progress_context( writer.number_of_variants(), std::optional< std::size_t >() ) ;
+			}
+		) ;
+
+		while( true ) {
+			std::size_t const first_line_number = reader.number_of_lines() + 1 ;
+			std::string text ;
+			if( reader.read_lines( chunk_size, &text ) == 0 ) {
+				break ;
+			}
+			chunks.submit(
+				[&encoder,text = std::move( text ),first_line_number]() {
+					return encoder.encode( text, first_line_number ) ;
+				}
+			) ;
+		}
+		chunks.finish() ;
+
+		genfile::bgen::Writer::FileMetadata const metadata = writer.finalise() ;
+		if( index_writer.get() ) {
+			index_writer->finalise( metadata ) ;
+		}
+		ui().logger() << fmt::format(
+			"Finished writing \"{}\" ({} samples, {} variants).\n",
+			bgen_filename, sample_ids.size(), writer.number_of_variants()
+		) ;
+		if( number_skipped > 0 ) {
+			ui().logger() << fmt::format( "Skipped {} records that could not be converted (no alternate allele, or multiallelic with -field DS).\n", number_skipped ) ;
+		}
+	}
+
+	// Read the VCF meta-information and header lines, returning the sample identifiers.
+	std::vector< std::string > read_header( genfile::LineReader& reader ) const {
+		std::string line ;
+		while( true ) {
+			line.clear() ;
+			if( reader.read_lines( 1, &line ) == 0 ) {
+				throw std::invalid_argument( "\"" + reader.filename() + "\" has no #CHROM header line." ) ;
+			}
+			while( !line.empty() && ( line.back() == '\n' || line.back() == '\r' )) {
+				line.pop_back() ;
+			}
+			if( line.compare( 0, 6, "#CHROM" ) == 0 ) {
+				break ;
+			} else if( line.compare( 0, 2, "##" ) != 0 ) {
+				throw std::invalid_argument( "\"" + reader.filename() + "\" does not look like a VCF file." ) ;
+			}
+		}
+		std::vector< std::string > result ;
+		std::size_t column = 0 ;
+		for( std::size_t pos = 0; pos <= line.size(); ++column ) {
+			std::size_t tab = line.find( '\t', pos ) ;
+			if( tab == std::string::npos ) {
+				tab = line.size() ;
+			}
+			if( column >= 9 ) {
+				result.push_back( line.substr( pos, tab - pos )) ;
+			}
+			pos = tab + 1 ;
+		}
+		return result ;
+	}
+
+	uint32_t get_compression_flags( std::string const& compression ) const {
+		if( compression == "zlib" ) {
+			return genfile::bgen::e_ZlibCompression ;
+		} else if( compression == "zstd" ) {
+			return genfile::bgen::e_ZstdCompression ;
+		} else if( compression == "none" ) {
+			return genfile::bgen::e_NoCompression ;
+		}
+		throw std::invalid_argument( "-compression must be one of \"zlib\", \"zstd\" or \"none\"." ) ;
+	}
+} ;
+
+int main( int argc, char** argv ) {
+	std::ios_base::sync_with_stdio( false ) ;
+	try {
+		Vcf2BgenApplication app( argc, argv ) ;
+	}
+	catch( appcontext::HaltProgramWithReturnCode const& e ) {
+		return e.return_code() ;
+	}
+	return 0 ;
+}
@@ -12,6 +12,7 @@
 #include <memory>
 #include "genfile/bgen.hpp"
 #include "genfile/View.hpp"
+#include "genfile/dosage.hpp"
 
 // DosageSetter is a callback object appropriate for passing to bgen::read_genotype_data_block() or
 // the synonymous method of genfile::bgen::View.
@@ -85,7 +86,6 @@ private:
 
 void process_data_using_dosage_setter( genfile::bgen::View& view ) ;
 void process_data_using_lookup_table( genfile::bgen::View& view ) ;
-std::vector< double > compute_lookup_table() ;
 
 // This example program reads data from a bgen file specified as the first argument
 // and outputs it as a VCF file.
@@ -100,7 +100,7 @@ int main( int argc, char** argv ) {
 	if( argc > 3 ) {
 		std::cerr << "Usage: compute_expected_dosage <bgen filename> [<method>]\n" ;
 		std::cerr << "Where <method> can be \"default\" or \"lookup-table\".\n" ;
-		std::cerr << "The lookup-table method is only implemented for 8-bit BGEN files.\n" ;
+		std::cerr << "The lookup-table method is only implemented for layout 2 BGEN files.\n" ;
 		exit(-1) ;
 	}
 	std::string const filename = argv[1] ;
@@ -149,14 +149,15 @@ void process_data_using_dosage_setter( genfile::bgen::View& view ) {
 }
 
 
+// This uses the bulk dosage decoder genfile::bgen::v12::compute_dosages(), which
+// computes dosages using lookup tables (for diploid samples) and avoids a per-value callback.
 void process_data_using_lookup_table( genfile::bgen::View& view ) {
-	std::vector< double > const lookup_table = compute_lookup_table() ;
-
 	std::string SNPID, rsid, chromosome ;
 	uint32_t position ;
 	std::vector< std::string > alleles ;
 
 	genfile::bgen::v12::GenotypeDataBlock pack ;
+	std::vector< double > dosages( view.number_of_samples() ) ;
 	for( std::size_t i = 0; i < view.number_of_variants(); ++i ) {
 		bool success = view.read_variant(
 			&SNPID, &rsid, &chromosome, &position, &alleles
@@ -164,35 +165,13 @@ void process_data_using_lookup_table( genfile::bgen::View& view ) {
 		assert( success ) ;
 		
 		view.read_and_unpack_v12_genotype_data_block( &pack ) ;
-		assert( pack.numberOfAlleles == 2 ) ;
-		assert( pack.ploidyExtent[0] == 2 ) ;
-		assert( pack.ploidyExtent[1] == 2 ) ;
-		assert( pack.phased == false ) ;
-		assert( pack.bits == 8 ) ;
-	
-		std::size_t n = 0 ;
+		std::size_t const n = genfile::bgen::v12::compute_dosages( pack, &dosages[0] ) ;
 		double totalDosage = 0.0 ;
-		genfile::byte_t const* buffer = pack.buffer ;
-		genfile::byte_t const* ploidy = pack.ploidy ;
-		for( int sample = 0; buffer < pack.end; buffer += 2, ++ploidy, ++sample ) {
-			if( !(*ploidy & 0x80 )) {
-				totalDosage += lookup_table[ *reinterpret_cast< uint16_t const* >( buffer ) ] ;
-				++n ;
+		for( std::size_t sample = 0; sample < dosages.size(); ++sample ) {
+			if( !( pack.ploidy[sample] & 0x80 )) {
+				totalDosage += dosages[sample] ;
 			}
 		}
 		std::cout << rsid << ": " << (totalDosage / n) << "\n" ;
 	}
 }
-
-std::vector< double > compute_lookup_table() {
-	std::vector< double > result( 256*256 ) ;
-	uint32_t p0, p1 ;
-	for( p0 = 0; p0 < 256; ++p0 ) {
-		for( p1 = 0; p1 < (256-p0); ++p1 ) {
-			uint32_t p2 = 255 - p0 - p1 ;
-			double dosage = (2 * double(p2) + double(p1)) / 255.0 ;
-			result[ (p1 << 8) | p0 ] = dosage ;
-		}
-	}
-	return result ;
-}
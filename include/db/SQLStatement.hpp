@@ -66,6 +66,7 @@ namespace db {
 		// Named placeholders with the same name have the same index.
 		// The data will not be copied and so the caller must preserve the data until
 		// such time as no further steps() are performed, or the parameter is re-bound.
+		// An empty range (which may be given as a pair of null pointers) binds an empty BLOB, not NULL.
 		virtual SQLStatement& bind( std::size_t i, char const* buffer, char const* const end ) = 0 ;
 		virtual SQLStatement& bind( std::size_t i, uint8_t const* buffer, uint8_t const* const end ) = 0 ;
 
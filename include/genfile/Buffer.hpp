@@ -0,0 +1,97 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef GENFILE_BUFFER_HPP
+#define GENFILE_BUFFER_HPP
+
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include "types.hpp"
+
+namespace genfile {
+	namespace impl {
+		// Allocate and free memory aligned to the given number of bytes.  If huge_pages is true,
+		// allocations of at least huge_page_size bytes are also aligned and padded to huge pages,
+		// and the kernel is advised to back them with huge pages where this is supported.
+		void* allocate_aligned( std::size_t bytes, std::size_t alignment, bool huge_pages ) ;
+		void deallocate_aligned( void* p, std::size_t bytes, std::size_t alignment, bool huge_pages ) ;
+		std::size_t const huge_page_size = 2 * 1024 * 1024 ;
+	}
+
+	// An allocator for buffers of plain data that returns memory aligned to Alignment bytes
+	// (by default a cache line, also suitable for aligned SIMD loads).
+	// Unlike std::allocator, elements are default-initialised, so resizing a vector of bytes
+	// does not zero-fill the new elements.  This avoids writing memory that is about to be
+	// overwritten, e.g. by decompression.
+	template< typename T, std::size_t Alignment = 64, bool HugePages = false >
+	struct AlignedAllocator {
+	public:
+		typedef T value_type ;
+		template< typename U > struct rebind { typedef AlignedAllocator< U, Alignment, HugePages > other ; } ;
+
+		AlignedAllocator() {}
+		template< typename U >
+		AlignedAllocator( AlignedAllocator< U, Alignment, HugePages > const& ) {}
+
+		T* allocate( std::size_t n ) {
+			return static_cast< T* >( impl::allocate_aligned( n * sizeof( T ), Alignment, HugePages )) ;
+		}
+
+		void deallocate( T* p, std::size_t n ) {
+			impl::deallocate_aligned( p, n * sizeof( T ), Alignment, HugePages ) ;
+		}
+
+		template< typename U >
+		void construct( U* p ) noexcept( std::is_nothrow_default_constructible< U >::value ) {
+			::new( static_cast< void* >( p )) U ;
+		}
+
+		template< typename U, typename... Args >
+		void construct( U* p, Args&&... args ) {
+			::new( static_cast< void* >( p )) U( std::forward< Args >( args )... ) ;
+		}
+
+		template< typename U >
+		bool operator==( AlignedAllocator< U, Alignment, HugePages > const& ) const { return true ; }
+		template< typename U >
+		bool operator!=( AlignedAllocator< U, Alignment, HugePages > const& ) const { return false ; }
+	} ;
+
+	// A byte buffer suitable for genotype data blocks and decoded data.
+	typedef std::vector< byte_t, AlignedAllocator< byte_t > > Buffer ;
+	// A byte buffer for large, long-lived data, which is backed by huge pages where possible.
+	typedef std::vector< byte_t, AlignedAllocator< byte_t, 64, true > > HugePageBuffer ;
+
+	// A thread-safe pool of buffers.  Code that uses a buffer briefly, e.g. to hold one variant
+	// passed between threads, can acquire() a buffer and release() it when done, so that storage
+	// is reused rather than allocated and freed each time.
+	struct BufferPool {
+	public:
+		typedef std::unique_ptr< BufferPool > UniquePtr ;
+
+		// Construct a pool that holds at most max_buffers unused buffers.
+		BufferPool( std::size_t max_buffers = 1024 ) ;
+
+		// Return an empty buffer, reusing the storage of a released buffer if one is available.
+		Buffer acquire() ;
+		// Return a buffer's storage to the pool.  It is freed instead if the pool is full.
+		void release( Buffer buffer ) ;
+
+		// Return the number of unused buffers held.
+		std::size_t size() const ;
+
+	private:
+		std::size_t const m_max_buffers ;
+		mutable std::mutex m_mutex ;
+		std::vector< Buffer > m_buffers ;
+	} ;
+}
+
+#endif
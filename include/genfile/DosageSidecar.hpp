@@ -0,0 +1,169 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef GENFILE_BGEN_DOSAGE_SIDECAR_HPP
+#define GENFILE_BGEN_DOSAGE_SIDECAR_HPP
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstring>
+#include <cassert>
+#include <type_traits>
+#include <stdint.h>
+#include "types.hpp"
+#include "dosage.hpp"
+#include "IndexQuery.hpp"
+
+/*
+* A dosage sidecar is a file of precomputed expected dosages for the biallelic variants of a bgen file,
+* conventionally stored alongside it as <bgen filename>.dosage.  Dosages are stored variant-major
+* as one fixed-width row per variant, with rows aligned to 64 bytes so the file can be memory-mapped
+* and rows read directly.  Values are either uint8_t (as described by DosageTraits< uint8_t >)
+* or float16_t, and are identical to those computed by parse_dosage_data().
+*
+* The sidecar records the size, modification time and first bytes of the bgen file it was made from,
+* in the same way as the bgenix index, so that a stale sidecar can be detected.
+*
+* File layout (all integers little-endian):
+*   offset 0:   8-byte magic "bgendsc\0"
+*   offset 8:   uint32 format version (currently 1)
+*   offset 12:  uint32 value type (1 = uint8_t, 2 = float16_t)
+*   offset 16:  uint64 number of samples
+*   offset 24:  uint64 number of variants (rows)
+*   offset 32:  uint64 row stride in bytes
+*   offset 40:  uint64 position of first row
+*   offset 48:  uint64 position of variant offset table
+*   offset 56:  int64 bgen file size
+*   offset 64:  int64 bgen file last write time
+*   offset 72:  uint32 length L of stored first bytes of bgen file
+*   offset 76:  L bytes of bgen file data
+* followed by rows starting at a 4096-byte aligned position, and then a table giving, for each row,
+* the uint64 offset of the corresponding variant in the bgen file.  Rows appear in file order.
+*/
+
+namespace genfile {
+	namespace bgen {
+		struct DosageSidecar {
+		public:
+			typedef std::unique_ptr< DosageSidecar > UniquePtr ;
+			typedef IndexQuery::FileMetadata FileMetadata ;
+			enum ValueType { eUInt8 = 1, eFloat16 = 2 } ;
+			static std::size_t const npos = std::size_t(-1) ;
+
+			// Return the conventional sidecar filename for the given bgen file.
+			static std::string default_filename( std::string const& bgen_filename ) ;
+
+			// Open and memory-map an existing sidecar file.
+			// Throws std::invalid_argument if the file cannot be opened or is not a valid sidecar file.
+			static UniquePtr open( std::string const& filename ) ;
+
+			// Return the size in bytes of values of the given type.
+			static std::size_t value_size( ValueType type ) ;
+
+		public:
+			~DosageSidecar() ;
+
+			std::string const& filename() const { return m_filename ; }
+			ValueType value_type() const { return m_value_type ; }
+			std::size_t number_of_samples() const { return m_number_of_samples ; }
+			std::size_t number_of_variants() const { return m_number_of_variants ; }
+			FileMetadata const& bgen_metadata() const { return m_bgen_metadata ; }
+
+			// Return true if the sidecar was made from a bgen file with the given metadata.
+			bool matches( FileMetadata const& metadata ) const ;
+
+			// Return true if the sidecar stores values of type T.
+			template< typename T >
+			bool stores() const {
+				return ( m_value_type == eUInt8 && std::is_same< T, uint8_t >::value )
+					|| ( m_value_type == eFloat16 && std::is_same< T, float16_t >::value ) ;
+			}
+
+			// Return the row for the variant starting at the given offset in the bgen file,
+			// or npos if there is no such row (e.g. because the variant is not biallelic).
+			std::size_t find_variant( int64_t file_position ) const ;
+
+			// Return a pointer to the given row.  T must be the stored type.
+			template< typename T >
+			T const* row( std::size_t i ) const {
+				assert( stores< T >() ) ;
+				assert( i < m_number_of_variants ) ;
+				return reinterpret_cast< T const* >( m_data + m_data_position + i * m_row_stride ) ;
+			}
+
+		private:
+			DosageSidecar( std::string const& filename ) ;
+			uint64_t variant_file_position( std::size_t i ) const ;
+
+		private:
+			std::string const m_filename ;
+			byte_t const* m_data ;
+			std::size_t m_size ;
+			ValueType m_value_type ;
+			std::size_t m_number_of_samples ;
+			std::size_t m_number_of_variants ;
+			std::size_t m_row_stride ;
+			std::size_t m_data_position ;
+			std::size_t m_offset_table_position ;
+			FileMetadata m_bgen_metadata ;
+		} ;
+
+		// Class for writing dosage sidecar files.
+		// Rows must be written in increasing order of bgen file position.
+		// Data is written to a temporary file which is renamed to the final filename by finalise(),
+		// so an incomplete sidecar is never seen by readers.
+		struct DosageSidecarWriter {
+		public:
+			typedef DosageSidecar::FileMetadata FileMetadata ;
+			typedef DosageSidecar::ValueType ValueType ;
+
+			DosageSidecarWriter(
+				std::string const& filename,
+				FileMetadata const& bgen_metadata,
+				std::size_t number_of_samples,
+				ValueType value_type
+			) ;
+			~DosageSidecarWriter() ;
+
+			// Write a row for the variant at the given position in the bgen file.
+			// T must match the value type of this writer.
+			template< typename T >
+			void write_row( int64_t file_position, T const* values ) {
+				assert(
+					( m_value_type == DosageSidecar::eUInt8 && std::is_same< T, uint8_t >::value )
+					|| ( m_value_type == DosageSidecar::eFloat16 && std::is_same< T, float16_t >::value )
+				) ;
+				write_row_bytes( file_position, reinterpret_cast< byte_t const* >( values ) ) ;
+			}
+
+			std::size_t number_of_rows() const { return m_file_positions.size() ; }
+
+			// Write the variant offset table and header, and move the file into place.
+			void finalise() ;
+
+		private:
+			void write_row_bytes( int64_t file_position, byte_t const* values ) ;
+			void write_header() ;
+
+		private:
+			std::string const m_filename ;
+			std::string const m_temporary_filename ;
+			FileMetadata const m_bgen_metadata ;
+			std::size_t const m_number_of_samples ;
+			ValueType const m_value_type ;
+			std::size_t const m_row_stride ;
+			std::size_t const m_data_position ;
+			std::ofstream m_stream ;
+			std::vector< uint64_t > m_file_positions ;
+			std::vector< byte_t > m_padding ;
+			bool m_finalised ;
+		} ;
+	}
+}
+
+#endif
@@ -0,0 +1,51 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef GENFILE_FORWARD_ONLY_STREAMBUF_HPP
+#define GENFILE_FORWARD_ONLY_STREAMBUF_HPP
+
+#include <iosfwd>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+
+namespace genfile {
+	// A read-only streambuf that pulls data strictly forwards from a source function,
+	// which fills the given buffer and returns the number of bytes read (zero at end of input).
+	// The only seek supported is reporting the current position (as used by tellg()), which is
+	// computed by counting the bytes consumed.  This allows bgen data to be read from pipes.
+	struct ForwardOnlyStreamBuf: public std::streambuf {
+	public:
+		typedef std::unique_ptr< ForwardOnlyStreamBuf > UniquePtr ;
+		typedef std::function< std::size_t( char*, std::size_t ) > Source ;
+
+		// Read from the given file descriptor, which is not closed when the buffer is destroyed.
+		// Read errors are thrown as std::runtime_error, with name used in the message.
+		static UniquePtr create( int fd, std::string const& name, std::size_t buffer_size ) ;
+		// Read from the given stream, which must outlive the buffer.
+		static UniquePtr create( std::istream& stream, std::size_t buffer_size ) ;
+
+	public:
+		ForwardOnlyStreamBuf( Source source, std::size_t buffer_size ) ;
+
+	protected:
+		int_type underflow() override ;
+		pos_type seekoff( off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which ) override ;
+
+	private:
+		Source m_source ;
+		std::vector< char > m_buffer ;
+		off_type m_buffer_start ;
+	} ;
+
+	// Return true if filename is "-", meaning standard input, or names an existing file that is not a
+	// regular file (such as a named pipe, or /dev/stdin when this is a pipe) and so must be read forwards.
+	bool is_stream_input( std::string const& filename ) ;
+}
+
+#endif
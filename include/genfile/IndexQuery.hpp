@@ -12,8 +12,12 @@
 #include <string>
 #include <ctime>
 #include <optional>
+#include <tuple>
+#include <functional>
+#include <stdexcept>
 #include <sys/stat.h>
 #include "db/sqlite3.hpp"
+#include "genfile/VariantBatch.hpp"
 #include <filesystem>
 
 namespace genfile {
@@ -65,9 +69,57 @@ namespace genfile {
 				uint32_t m_start ;
 				uint32_t m_end ;
 			} ;
+			// A variant identified by chromosome and position, and optionally by its first two alleles
+			// (as recorded in the allele1 and allele2 columns of the index).
+			struct VariantPosition {
+				VariantPosition(): m_position(0) {}
+				VariantPosition( std::string const& chromosome, uint32_t position ):
+					m_chromosome( chromosome ),
+					m_position( position )
+				{}
+				VariantPosition(
+					std::string const& chromosome,
+					uint32_t position,
+					std::string const& allele1,
+					std::string const& allele2
+				):
+					m_chromosome( chromosome ),
+					m_position( position ),
+					m_allele1( allele1 ),
+					m_allele2( allele2 )
+				{
+					if( allele1.empty() || allele2.empty() ) {
+						throw std::invalid_argument( "allele" ) ;
+					}
+				}
+
+				std::string const& chromosome() const { return m_chromosome ; }
+				uint32_t position() const { return m_position ; }
+				// Return true if this position specifies alleles.
+				bool has_alleles() const { return !m_allele1.empty() ; }
+				std::string const& allele1() const { return m_allele1 ; }
+				std::string const& allele2() const { return m_allele2 ; }
+
+				bool operator<( VariantPosition const& other ) const {
+					return std::tie( m_chromosome, m_position, m_allele1, m_allele2 )
+						< std::tie( other.m_chromosome, other.m_position, other.m_allele1, other.m_allele2 ) ;
+				}
+				bool operator==( VariantPosition const& other ) const {
+					return std::tie( m_chromosome, m_position, m_allele1, m_allele2 )
+						== std::tie( other.m_chromosome, other.m_position, other.m_allele1, other.m_allele2 ) ;
+				}
+
+			private:
+				std::string m_chromosome ;
+				uint32_t m_position ;
+				std::string m_allele1 ;
+				std::string m_allele2 ;
+			} ;
+
 			//typedef boost::tuple< std::string, uint32_t, uint32_t > GenomicRange ;
 			typedef std::pair< int64_t, int64_t> FileRange ;
 			typedef std::function< void ( std::size_t n, std::optional< std::size_t > total ) > ProgressCallback ;
+			typedef std::function< void ( VariantBatch& batch ) > BatchCallback ;
 
 		public:
 			virtual ~IndexQuery() {} ;
@@ -79,6 +131,9 @@ namespace genfile {
 			virtual IndexQuery& exclude_range( GenomicRange const& range ) = 0 ;
 			virtual IndexQuery& include_rsids( std::vector< std::string > const& ids ) = 0 ;
 			virtual IndexQuery& exclude_rsids( std::vector< std::string > const& ids ) = 0 ;
+			// Include variants at the given positions.  Positions that specify alleles match
+			// only variants with those first two alleles; other positions match any variant at that position.
+			virtual IndexQuery& include_positions( std::vector< VariantPosition > const& positions ) = 0 ;
 
 			// Initialise must be called before calling number_of_variants() or locate_variant().
 			virtual void initialise( ProgressCallback callback = ProgressCallback() ) = 0 ;
@@ -87,6 +142,13 @@ namespace genfile {
 			// Report the number of variants in this query.
 			virtual FileRange locate_variant( std::size_t index ) const = 0 ;
 
+			// Pass identifying data for the variants in this query, as recorded in the index, to the callback
+			// in batches of at most batch_size variants, in the same order as locate_variant().
+			// The index does not record SNPIDs and records only the first two alleles of each variant,
+			// so batches have empty SNPIDs and store at most two alleles per variant.
+			// The callback may move from the batch, which is cleared before being refilled.
+			virtual void read_variant_batches( std::size_t batch_size, BatchCallback callback ) const = 0 ;
+
 			struct FileMetadata {
 				FileMetadata():
 					size(-1)
@@ -135,6 +197,8 @@ namespace genfile {
 			SqliteIndexQuery& include_rsids( std::vector< std::string > const& ids ) ;
 			// Exclude variants with one of the given rsids.  The list provided must be unique.
 			SqliteIndexQuery& exclude_rsids( std::vector< std::string > const& ids ) ;
+			// Include variants at the given positions.  The list need not be unique.
+			SqliteIndexQuery& include_positions( std::vector< VariantPosition > const& positions ) ;
 
 		public:
 			// IndexQuery methods
@@ -142,14 +206,23 @@ namespace genfile {
 			OptionalFileMetadata const& file_metadata() const ;
 			std::size_t number_of_variants() const ;
 			FileRange locate_variant( std::size_t index ) const ;
+			void read_variant_batches( std::size_t batch_size, BatchCallback callback ) const ;
 
 		private:
 			db::Connection::UniquePtr open_connection( std::string const& filename ) const ;
 			OptionalFileMetadata load_metadata( db::Connection& connection ) const ;
-			db::Connection::StatementPtr build_query() const ;
-	
-		private:
+
+		protected:
+			db::Connection::StatementPtr build_query( std::string const& columns = "file_start_position, size_in_bytes" ) const ;
+
+		protected:
 			db::Connection::UniquePtr m_connection ;
+			// Order in which variants are reported.
+			std::string m_order_by ;
+			bool m_initialised ;
+			std::vector< std::pair< int64_t, int64_t> > m_positions ;
+
+		private:
 			OptionalFileMetadata const m_metadata ;
 			std::string const m_index_table_name ;
 			struct QueryParts {
@@ -158,8 +231,38 @@ namespace genfile {
 				std::string exclusion ;
 			} ;
 			QueryParts m_query_parts ;
-			bool m_initialised ;
-			std::vector< std::pair< int64_t, int64_t> > m_positions ;
+		} ;
+
+		// Class for queries against a catalog index, which indexes variants in several bgen files
+		// (as written by CatalogWriter).
+		// Variants are reported grouped by file, and in file order within each file, so that each file
+		// can be read sequentially.  locate_variant() reports the range of each variant within its file,
+		// and locate_file() reports which file this is.
+		// The catalog records metadata for each file, which can be used to check files have not changed.
+		struct CatalogIndexQuery: public SqliteIndexQuery {
+		public:
+			typedef std::unique_ptr< CatalogIndexQuery > UniquePtr ;
+
+		public:
+			// Construct given a catalog file.
+			// Throws std::invalid_argument if the file is not a catalog.
+			CatalogIndexQuery( std::string const& filename ) ;
+
+			std::size_t number_of_files() const { return m_files.size() ; }
+			// Return the path of the given file.  Relative paths in the catalog are resolved
+			// relative to the directory containing the catalog.
+			std::string const& filename( std::size_t file_i ) const { return m_files[ file_i ].filename ; }
+			// Return the metadata recorded for the given file when it was added to the catalog.
+			FileMetadata const& file_metadata( std::size_t file_i ) const { return m_files[ file_i ] ; }
+			using SqliteIndexQuery::file_metadata ;
+
+			void initialise( ProgressCallback callback = ProgressCallback() ) ;
+			// Return the index of the file containing the given variant.
+			std::size_t locate_file( std::size_t index ) const ;
+
+		private:
+			std::vector< FileMetadata > m_files ;
+			std::vector< uint32_t > m_file_indices ;
 		} ;
 		
 	}
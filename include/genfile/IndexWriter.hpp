@@ -0,0 +1,115 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef GENFILE_BGEN_INDEX_WRITER_HPP
+#define GENFILE_BGEN_INDEX_WRITER_HPP
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <optional>
+#include <stdint.h>
+#include "db/Connection.hpp"
+#include "IndexQuery.hpp"
+
+namespace genfile {
+	namespace bgen {
+		// IndexWriter creates a bgenix-style index file (as read by SqliteIndexQuery).
+		// Variants can be added as they are written, so that an index can be built at
+		// the same time as the bgen file.
+		// The index is written to a temporary file (the filename with ".tmp" appended)
+		// which is moved into place by finalise(), or removed if the writer is destroyed first.
+		struct IndexWriter {
+		public:
+			typedef std::unique_ptr< IndexWriter > UniquePtr ;
+			typedef IndexQuery::FileMetadata FileMetadata ;
+			typedef IndexQuery::FileRange FileRange ;
+
+			// Create an index file.  If with_rowid is false, the Variant table is created WITHOUT ROWID.
+			// If with_hashes is true, the Variant table has a content_hash column holding the content_hash()
+			// of each variant's genotype data block (stored as a signed 64-bit integer with the same bits).
+			// Throws std::invalid_argument if the temporary file already exists.
+			static UniquePtr create( std::string const& filename, bool with_rowid = false, bool with_hashes = false ) ;
+
+		public:
+			IndexWriter( std::string const& filename, bool with_rowid = false, bool with_hashes = false ) ;
+			~IndexWriter() ;
+
+			std::string const& filename() const { return m_filename ; }
+			std::size_t number_of_variants() const { return m_number_of_variants ; }
+			bool with_hashes() const { return m_with_hashes ; }
+
+			// Add a variant to the index.  range gives the start and size in bytes of the variant in the file.
+			// content_hash must be given if, and only if, the index was created with hashes;
+			// std::invalid_argument is thrown otherwise.
+			void add_variant(
+				std::string const& chromosome,
+				uint32_t position,
+				std::string const& rsid,
+				std::vector< std::string > const& alleles,
+				FileRange const& range,
+				std::optional< uint64_t > const& content_hash = std::optional< uint64_t >()
+			) ;
+
+			// Record the metadata of the indexed bgen file, commit and move the index into place.
+			void finalise( FileMetadata const& metadata ) ;
+
+		private:
+			void setup_index_file( bool with_rowid ) ;
+
+		private:
+			std::string const m_filename ;
+			std::string const m_tmp_filename ;
+			db::Connection::UniquePtr m_connection ;
+			db::Connection::ScopedTransactionPtr m_transaction ;
+			db::Connection::StatementPtr m_insert_variant_stmt ;
+			bool const m_with_hashes ;
+			std::size_t m_number_of_variants ;
+			bool m_finalised ;
+		} ;
+
+		// CatalogWriter creates a catalog index (as read by CatalogIndexQuery) covering several bgen files,
+		// by copying the contents of each file's bgenix index.
+		// As for IndexWriter, the catalog is written to a temporary file which is moved into place by finalise(),
+		// or removed if the writer is destroyed first.
+		struct CatalogWriter {
+		public:
+			typedef std::unique_ptr< CatalogWriter > UniquePtr ;
+			typedef IndexQuery::FileMetadata FileMetadata ;
+
+			// Throws std::invalid_argument if the temporary file already exists.
+			CatalogWriter( std::string const& filename ) ;
+			~CatalogWriter() ;
+
+			std::string const& filename() const { return m_filename ; }
+			std::size_t number_of_files() const { return m_number_of_files ; }
+
+			// Add the variants in a bgen file, as recorded in its index, to the catalog.
+			// metadata must describe the bgen file as it is now (e.g. as returned by View::file_metadata());
+			// it is recorded in the catalog, and must match the metadata recorded in the index, if any.
+			// Relative paths are recorded relative to the directory containing the catalog.
+			// Throws std::invalid_argument if the index does not match the file.
+			// Returns the number of variants added.
+			std::size_t add_file(
+				std::string const& bgen_filename,
+				std::string const& index_filename,
+				FileMetadata const& metadata
+			) ;
+
+			// Move the catalog into place.
+			void finalise() ;
+
+		private:
+			std::string const m_filename ;
+			std::string const m_tmp_filename ;
+			db::Connection::UniquePtr m_connection ;
+			std::size_t m_number_of_files ;
+			bool m_finalised ;
+		} ;
+	}
+}
+
+#endif
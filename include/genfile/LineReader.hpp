@@ -0,0 +1,52 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef GENFILE_LINE_READER_HPP
+#define GENFILE_LINE_READER_HPP
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <zlib.h>
+
+namespace genfile {
+	// LineReader reads lines of text from a plain, gzip- or BGZF-compressed file
+	// (compression is detected automatically by zlib).
+	// Lines are read in batches into a caller-supplied string, so that batches can be
+	// handed to other threads for parsing.
+	struct LineReader {
+	public:
+		typedef std::unique_ptr< LineReader > UniquePtr ;
+
+		// Open the given file.  Throws std::invalid_argument if it cannot be opened.
+		LineReader( std::string const& filename, std::size_t buffer_size = 4 * 1024 * 1024 ) ;
+		~LineReader() ;
+
+		std::string const& filename() const { return m_filename ; }
+		// Return the number of lines read so far.
+		std::size_t number_of_lines() const { return m_number_of_lines ; }
+
+		// Append up to max_lines complete lines to result, each terminated by a newline
+		// (a newline is added to an unterminated last line).
+		// Return the number of lines appended, which is zero at end of file.
+		// Throws std::invalid_argument if a read error occurs.
+		std::size_t read_lines( std::size_t max_lines, std::string* result ) ;
+
+	private:
+		bool fill() ;
+
+	private:
+		std::string const m_filename ;
+		gzFile m_file ;
+		std::vector< char > m_buffer ;
+		std::size_t m_begin ;
+		std::size_t m_end ;
+		bool m_eof ;
+		std::size_t m_number_of_lines ;
+	} ;
+}
+
+#endif
@@ -0,0 +1,130 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef GENFILE_BGEN_SAMPLE_ORDER_HPP
+#define GENFILE_BGEN_SAMPLE_ORDER_HPP
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include "types.hpp"
+#include "bgen.hpp"
+#include "Buffer.hpp"
+
+namespace genfile {
+	namespace bgen {
+		// A SampleOrder maps the samples of a bgen file to a new order chosen by the caller, e.g. that of
+		// the rows of a phenotype table.  Samples in the new order that are not in the file are 'absent',
+		// and samples in the file that are not in the new order are dropped.
+		struct SampleOrder {
+		public:
+			static constexpr std::size_t absent = std::size_t( -1 ) ;
+
+			// Construct an order in which the jth sample is the file's sample order[j], or is absent if
+			// order[j] equals absent.  Throws std::invalid_argument if a file sample is out of range
+			// or appears more than once.
+			SampleOrder( std::size_t number_of_samples, std::vector< std::size_t > const& order ) ;
+
+			// Return the order of the given sample identifiers, in which each identifier is matched to the
+			// file sample with that identifier, or is absent if there is none.  Throws std::invalid_argument
+			// if an identifier is repeated in ids, or matches more than one file sample.
+			static SampleOrder match(
+				std::vector< std::string > const& file_sample_ids,
+				std::vector< std::string > const& ids
+			) ;
+
+		public:
+			// The number of samples in the file.
+			std::size_t number_of_samples() const { return m_output_index.size() ; }
+			// The number of samples in the new order, including absent samples.
+			std::size_t size() const { return m_order.size() ; }
+			std::size_t number_of_absent_samples() const { return m_number_of_absent_samples ; }
+
+			// Return the file sample that is jth in the new order, or absent.
+			std::size_t operator[]( std::size_t j ) const { return m_order[j] ; }
+			// Return the position in the new order of file sample i, or absent if it is dropped.
+			std::size_t output_index( std::size_t i ) const { return m_output_index[i] ; }
+
+			// Copy values, one per file sample, into result (which has size() entries) in the new order,
+			// using absent_value for absent samples.
+			template< typename T >
+			void apply( T const* values, T* result, T const& absent_value ) const {
+				for( std::size_t j = 0; j < m_order.size(); ++j ) {
+					result[j] = ( m_order[j] == absent ) ? absent_value : values[ m_order[j] ] ;
+				}
+			}
+
+		private:
+			std::vector< std::size_t > m_order ;
+			std::vector< std::size_t > m_output_index ;
+			std::size_t m_number_of_absent_samples ;
+		} ;
+
+		// A setter, for use with parse_probability_data(), that passes data to another setter with
+		// samples in the given order.  The target setter is initialised with order.size() samples and
+		// receives data for the samples in the file, in file order, identified by their position in the
+		// new order.  It receives no data for absent samples.
+		template< typename Setter >
+		struct SampleOrderSetter {
+		public:
+			SampleOrderSetter( Setter& setter, SampleOrder const& order ):
+				m_setter( setter ),
+				m_order( order )
+			{}
+
+			void initialise( std::size_t number_of_samples, std::size_t number_of_alleles ) {
+				assert( number_of_samples == m_order.number_of_samples() ) ;
+				m_setter.initialise( m_order.size(), number_of_alleles ) ;
+			}
+
+			void set_min_max_ploidy( uint32_t min_ploidy, uint32_t max_ploidy, uint32_t min_entries, uint32_t max_entries ) {
+				if constexpr( has_set_min_max_ploidy< Setter >::Yes ) {
+					m_setter.set_min_max_ploidy( min_ploidy, max_ploidy, min_entries, max_entries ) ;
+				}
+			}
+
+			bool set_sample( std::size_t i ) {
+				std::size_t const j = m_order.output_index( i ) ;
+				return ( j != SampleOrder::absent ) && m_setter.set_sample( j ) ;
+			}
+
+			void set_number_of_entries( uint32_t ploidy, uint32_t number_of_entries, OrderType order_type, ValueType value_type ) {
+				m_setter.set_number_of_entries( ploidy, number_of_entries, order_type, value_type ) ;
+			}
+
+			void set_value( uint32_t entry_i, double value ) {
+				m_setter.set_value( entry_i, value ) ;
+			}
+
+			void set_value( uint32_t entry_i, genfile::MissingValue value ) {
+				m_setter.set_value( entry_i, value ) ;
+			}
+
+			void finalise() {
+				call_finalise( m_setter ) ;
+			}
+
+		private:
+			Setter& m_setter ;
+			SampleOrder const& m_order ;
+		} ;
+
+		// Rearrange the samples of the uncompressed genotype data block in [buffer, end), as returned by
+		// uncompress_probability_data() for a file with the given context, into the given order.  The result
+		// is an uncompressed block for order.size() samples.  Sample data is copied exactly; absent samples
+		// are written as missing, in layout 2 with the variant's maximum ploidy.
+		// Throws BGenError if the data is malformed.
+		void reorder_samples(
+			Context const& context,
+			byte_t const* buffer,
+			byte_t const* const end,
+			SampleOrder const& order,
+			Buffer* result
+		) ;
+	}
+}
+
+#endif
@@ -0,0 +1,112 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef GENFILE_THREAD_POOL_HPP
+#define GENFILE_THREAD_POOL_HPP
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+#include <algorithm>
+
+namespace genfile {
+	// A fixed-size pool of worker threads that run submitted tasks in submission order.
+	// Tasks should not themselves block waiting on other tasks submitted to the same pool,
+	// as this can deadlock once all workers are waiting.
+	struct ThreadPool {
+	public:
+		typedef std::unique_ptr< ThreadPool > UniquePtr ;
+
+		// Construct a pool with the given number of threads.
+		// If number_of_threads is zero, std::thread::hardware_concurrency() threads are used.
+		ThreadPool( std::size_t number_of_threads = 0 ) ;
+		// Waits for queued tasks to complete, then joins all threads.
+		~ThreadPool() ;
+
+		std::size_t number_of_threads() const { return m_threads.size() ; }
+
+		// Submit a task, returning a future for its result.
+		// Exceptions thrown by the task are rethrown by future::get().
+		template< typename F >
+		std::future< typename std::invoke_result< F >::type > submit( F&& f ) {
+			typedef typename std::invoke_result< F >::type Result ;
+			std::shared_ptr< std::packaged_task< Result() > > task(
+				new std::packaged_task< Result() >( std::forward< F >( f ) )
+			) ;
+			std::future< Result > result = task->get_future() ;
+			enqueue( [task]() { (*task)() ; } ) ;
+			return result ;
+		}
+
+		// Call f(i) for each i in [begin, end), dividing the work between threads,
+		// and return when all calls have completed.
+		// If any call throws, the first exception (in index order) is rethrown after all work completes.
+		void parallel_for( std::size_t begin, std::size_t end, std::function< void( std::size_t ) > const& f ) ;
+
+	private:
+		void enqueue( std::function< void() > task ) ;
+		void run() ;
+
+	private:
+		std::vector< std::thread > m_threads ;
+		std::deque< std::function< void() > > m_queue ;
+		std::mutex m_mutex ;
+		std::condition_variable m_condition ;
+		bool m_stopping ;
+	} ;
+
+	// Runs tasks on a ThreadPool and passes their results to a consumer in the order the
+	// tasks were submitted, e.g. so that data encoded in parallel can be written in input order.
+	// At most max_in_flight results are held at once; submit() blocks on the oldest task beyond this.
+	// The consumer is called on the submitting thread.  Exceptions thrown by tasks are rethrown
+	// from submit() or finish().
+	template< typename Result >
+	struct OrderedTaskQueue {
+	public:
+		typedef std::function< void( Result const& ) > Consumer ;
+
+		OrderedTaskQueue( ThreadPool& pool, std::size_t max_in_flight, Consumer consumer ):
+			m_pool( pool ),
+			m_max_in_flight( std::max( max_in_flight, std::size_t( 1 ) )),
+			m_consumer( consumer )
+		{}
+
+		template< typename F >
+		void submit( F&& f ) {
+			m_results.push_back( m_pool.submit( std::forward< F >( f ) )) ;
+			while( m_results.size() > m_max_in_flight ) {
+				consume_one() ;
+			}
+		}
+
+		// Wait for all tasks, passing remaining results to the consumer.
+		void finish() {
+			while( !m_results.empty() ) {
+				consume_one() ;
+			}
+		}
+
+	private:
+		ThreadPool& m_pool ;
+		std::size_t const m_max_in_flight ;
+		Consumer m_consumer ;
+		std::deque< std::future< Result > > m_results ;
+
+		void consume_one() {
+			std::future< Result > result = std::move( m_results.front() ) ;
+			m_results.pop_front() ;
+			m_consumer( result.get() ) ;
+		}
+	} ;
+}
+
+#endif
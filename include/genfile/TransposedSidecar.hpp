@@ -0,0 +1,163 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef GENFILE_BGEN_TRANSPOSED_SIDECAR_HPP
+#define GENFILE_BGEN_TRANSPOSED_SIDECAR_HPP
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include "types.hpp"
+#include "IndexQuery.hpp"
+#include "ThreadPool.hpp"
+
+/*
+* A transposed sidecar is a sample-major copy of the genotype data in a bgen file, designed
+* to make it fast to retrieve all the genotypes of a single sample across a genomic region.
+* It is conventionally stored alongside the bgen file as <bgen filename>.transposed.
+*
+* Biallelic variants with ploidy at most two are stored (other variants are omitted).
+* For each sample and variant three bytes are stored:
+* - the ploidy byte, as in the bgen file (i.e. ploidy in the low six bits, and 0x80 set if data is missing)
+* - two probabilities, in units of 1/255, which are:
+*   for unphased data, the probabilities of the genotypes with zero and one copies of the second allele
+*   (so a haploid sample has values P(A), P(B) and a diploid sample has P(AA), P(AB));
+*   for phased data, the probability of the first allele on the first and second haplotype (or zero if haploid).
+* These are exact copies of the data for bgen files stored with 8 bits per probability.
+* Other bit depths are rounded to the nearest 1/255.  Missing samples have zero probabilities.
+*
+* Data is divided into tiles of (sample chunk) x (variant block).  Each tile is stored sample-major
+* (for each sample, the ploidy bytes for the variants in the block, then the first probabilities, then the second)
+* and compressed with zstd.  Tiles are stored ordered by sample chunk and then variant block,
+* so the data for one sample is contiguous in the file.
+*
+* Like the bgenix index, the sidecar records the size, modification time and first bytes of the
+* bgen file it was made from so that a stale sidecar can be detected.
+*/
+
+namespace genfile {
+	namespace bgen {
+		struct View ;
+
+		struct TransposedSidecar {
+		public:
+			typedef std::unique_ptr< TransposedSidecar > UniquePtr ;
+			typedef IndexQuery::FileMetadata FileMetadata ;
+			typedef IndexQuery::GenomicRange GenomicRange ;
+			typedef IndexQuery::ProgressCallback ProgressCallback ;
+
+			// Parameters controlling construction of the sidecar.
+			struct BuildOptions {
+				BuildOptions():
+					sample_chunk_size( 64 ),
+					variant_block_size( 4096 ),
+					memory_limit( std::size_t(1) << 30 ),
+					compression_level( 3 )
+				{}
+				// Number of samples in each tile.
+				std::size_t sample_chunk_size ;
+				// Maximum number of variants in each tile.
+				// This is reduced if needed so that a block of variants fits within the memory limit.
+				std::size_t variant_block_size ;
+				// Approximate limit, in bytes, on memory used for data during construction.
+				std::size_t memory_limit ;
+				// zstd compression level for tiles.
+				int compression_level ;
+			} ;
+
+			// The genotypes of one sample across a set of variants, as returned by get_sample_genotypes().
+			// See the file comment above for the interpretation of ploidy and probabilities.
+			struct SampleGenotypes {
+				// Index of variant within the sidecar.
+				std::vector< uint64_t > variant_indices ;
+				// Offset of variant in the bgen file.
+				std::vector< uint64_t > file_positions ;
+				std::vector< uint32_t > positions ;
+				std::vector< uint8_t > ploidy ;
+				std::vector< uint8_t > phased ;
+				// Two values per variant.
+				std::vector< uint8_t > probabilities ;
+
+				std::size_t size() const { return variant_indices.size() ; }
+				bool is_missing( std::size_t i ) const { return ploidy[i] & 0x80 ; }
+				// Return the expected dosage of the second allele for the ith variant, or NaN if missing.
+				double dosage( std::size_t i ) const ;
+				void clear() ;
+			} ;
+
+			// Return the conventional sidecar filename for the given bgen file.
+			static std::string default_filename( std::string const& bgen_filename ) ;
+
+			// Build a transposed sidecar for all variants in the given view.
+			// The view must be positioned at the first variant and must be a layout 2 file.
+			// Decoding and compression are spread across the threads of the given pool.
+			// Tiles are first written to a temporary file in variant order, and then rearranged
+			// into sample order; the final file is moved into place when complete.
+			static void build(
+				View& view,
+				std::string const& filename,
+				ThreadPool& pool,
+				BuildOptions const& options = BuildOptions(),
+				ProgressCallback callback = ProgressCallback()
+			) ;
+
+			// Open and memory-map an existing sidecar file.
+			// Throws std::invalid_argument if the file cannot be opened or is not a valid sidecar file.
+			static UniquePtr open( std::string const& filename ) ;
+
+		public:
+			~TransposedSidecar() ;
+
+			std::string const& filename() const { return m_filename ; }
+			std::size_t number_of_samples() const { return m_number_of_samples ; }
+			std::size_t number_of_variants() const { return m_number_of_variants ; }
+			FileMetadata const& bgen_metadata() const { return m_bgen_metadata ; }
+
+			// Return true if the sidecar was made from a bgen file with the given metadata.
+			bool matches( FileMetadata const& metadata ) const ;
+
+			// Fill result with the genotypes of the given sample at all stored variants in the given range.
+			// Variants are reported in file order.
+			void get_sample_genotypes(
+				std::size_t sample_index,
+				GenomicRange const& range,
+				SampleGenotypes* result
+			) const ;
+
+		private:
+			struct Run {
+				uint32_t chromosome ;
+				bool sorted ;
+				uint64_t begin ;
+				uint64_t end ;
+			} ;
+
+			TransposedSidecar( std::string const& filename ) ;
+			uint64_t variant_file_position( std::size_t i ) const ;
+			uint32_t variant_position( std::size_t i ) const ;
+			bool variant_phased( std::size_t i ) const ;
+			void find_variants( GenomicRange const& range, std::vector< uint64_t >* result ) const ;
+
+		private:
+			std::string const m_filename ;
+			byte_t const* m_data ;
+			std::size_t m_size ;
+			std::size_t m_number_of_samples ;
+			std::size_t m_number_of_variants ;
+			std::size_t m_sample_chunk_size ;
+			std::size_t m_variant_block_size ;
+			std::size_t m_variant_table_position ;
+			std::size_t m_tile_index_position ;
+			std::vector< std::string > m_chromosomes ;
+			std::vector< Run > m_runs ;
+			std::vector< uint64_t > m_block_starts ;
+			FileMetadata m_bgen_metadata ;
+		} ;
+	}
+}
+
+#endif
@@ -0,0 +1,140 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef GENFILE_BGEN_VARIANT_BATCH_HPP
+#define GENFILE_BGEN_VARIANT_BATCH_HPP
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <cassert>
+#include <stdint.h>
+#include "types.hpp"
+
+namespace genfile {
+	namespace bgen {
+		// Identifying data for a batch of variants, as filled by View::read_variant_batch().
+		// Data is stored column-wise, with one entry per variant in each of the public vectors.
+		// Identifiers and alleles are stored consecutively in a single string arena and can be
+		// accessed using the methods below; chromosome names are stored once, in order of first
+		// appearance, and referenced by index.
+		// Clearing and refilling a batch reuses its storage, so repeated reads do not allocate.
+		struct VariantBatch {
+		public:
+			std::size_t size() const { return position.size() ; }
+
+			void clear() {
+				chromosome_id.clear() ;
+				position.clear() ;
+				number_of_alleles.clear() ;
+				file_offset.clear() ;
+				file_size.clear() ;
+				m_first_string.clear() ;
+				m_string_end.clear() ;
+				m_strings.clear() ;
+				m_genotype_data_end.clear() ;
+				m_genotype_data.clear() ;
+			}
+
+			std::string_view SNPID( std::size_t i ) const { return get_string( m_first_string[i] ) ; }
+			std::string_view rsid( std::size_t i ) const { return get_string( m_first_string[i] + 1 ) ; }
+			// The number of alleles stored for the ith variant.  This is number_of_alleles[i]
+			// unless the batch was filled from an index; see IndexQuery::read_variant_batches().
+			std::size_t number_of_stored_alleles( std::size_t i ) const {
+				std::size_t const end = ( i + 1 < size() ) ? m_first_string[i+1] : m_string_end.size() ;
+				return end - m_first_string[i] - 2 ;
+			}
+			std::string const& chromosome( std::size_t i ) const { return chromosomes[ chromosome_id[i] ] ; }
+			std::string_view allele( std::size_t i, std::size_t j ) const {
+				assert( j < number_of_stored_alleles(i) ) ;
+				return get_string( m_first_string[i] + 2 + j ) ;
+			}
+
+			// Return the genotype data block of the ith variant, if read_variant_batch() was asked to store it.
+			// This is the data returned by genfile::bgen::read_genotype_data_block(); it can be uncompressed using
+			// genfile::bgen::uncompress_probability_data().
+			std::pair< byte_t const*, byte_t const* > genotype_data_block( std::size_t i ) const {
+				assert( i < m_genotype_data_end.size() ) ;
+				std::size_t const begin = ( i == 0 ) ? 0 : m_genotype_data_end[i-1] ;
+				return std::make_pair( m_genotype_data.data() + begin, m_genotype_data.data() + m_genotype_data_end[i] ) ;
+			}
+
+		public:
+			// Add data for a variant.  Alleles must then be added using add_allele(),
+			// and optionally the genotype data block using add_genotype_data_block().
+			void add_variant(
+				std::string const& SNPID,
+				std::string const& rsid,
+				std::string const& chromosome,
+				uint32_t position,
+				uint16_t number_of_alleles
+			) {
+				m_first_string.push_back( m_string_end.size() ) ;
+				add_string( SNPID ) ;
+				add_string( rsid ) ;
+				this->chromosome_id.push_back( find_or_add_chromosome( chromosome )) ;
+				this->position.push_back( position ) ;
+				this->number_of_alleles.push_back( number_of_alleles ) ;
+			}
+
+			void add_allele( std::string const& allele ) {
+				add_string( allele ) ;
+			}
+
+			void add_genotype_data_block( byte_t const* begin, byte_t const* end ) {
+				m_genotype_data.insert( m_genotype_data.end(), begin, end ) ;
+				m_genotype_data_end.push_back( m_genotype_data.size() ) ;
+			}
+
+		public:
+			// Distinct chromosome names seen; these are retained by clear() so that ids are stable across batches.
+			std::vector< std::string > chromosomes ;
+			// Index of each variant's chromosome in chromosomes.
+			std::vector< uint32_t > chromosome_id ;
+			std::vector< uint32_t > position ;
+			std::vector< uint16_t > number_of_alleles ;
+			// Position of each variant in the file, and the number of bytes it occupies
+			// (including its genotype data block).
+			std::vector< int64_t > file_offset ;
+			std::vector< int64_t > file_size ;
+
+		private:
+			std::vector< std::size_t > m_first_string ;
+			std::vector< std::size_t > m_string_end ;
+			std::string m_strings ;
+			std::vector< std::size_t > m_genotype_data_end ;
+			std::vector< byte_t > m_genotype_data ;
+
+		private:
+			void add_string( std::string const& value ) {
+				m_strings.append( value ) ;
+				m_string_end.push_back( m_strings.size() ) ;
+			}
+
+			std::string_view get_string( std::size_t k ) const {
+				std::size_t const begin = ( k == 0 ) ? 0 : m_string_end[k-1] ;
+				return std::string_view( m_strings.data() + begin, m_string_end[k] - begin ) ;
+			}
+
+			uint32_t find_or_add_chromosome( std::string const& chromosome ) {
+				// Variants are usually sorted by chromosome, so check the most recent one first.
+				if( !chromosome_id.empty() && chromosomes[ chromosome_id.back() ] == chromosome ) {
+					return chromosome_id.back() ;
+				}
+				for( std::size_t i = 0; i < chromosomes.size(); ++i ) {
+					if( chromosomes[i] == chromosome ) {
+						return uint32_t( i ) ;
+					}
+				}
+				chromosomes.push_back( chromosome ) ;
+				return uint32_t( chromosomes.size() - 1 ) ;
+			}
+		} ;
+	}
+}
+
+#endif
@@ -13,7 +13,12 @@
 #include <iostream>
 #include <sstream>
 #include "bgen.hpp"
+#include "Buffer.hpp"
+#include "dosage.hpp"
+#include "DosageSidecar.hpp"
 #include "IndexQuery.hpp"
+#include "SampleOrder.hpp"
+#include "VariantBatch.hpp"
 
 // namespace {
 // 	std::string to_string( std::size_t i ) {
@@ -33,18 +38,45 @@ namespace genfile {
 
 			static UniquePtr create( std::string const& filename ) ;
 
+			static constexpr std::size_t default_streaming_buffer_size = 4 * 1024 * 1024 ;
+
+			// Create a view that reads the given stream, or file descriptor, strictly forwards.
+			// This works for pipes and other inputs that cannot seek.  Input is read through a buffer of
+			// the given size, and name is used as the filename in error messages and file_metadata().
+			// File size and first bytes are not recorded in file_metadata(), so a streaming view cannot
+			// be checked against an index; set_query() throws std::invalid_argument, and dosage sidecars
+			// are not used.  File offsets reported by read_variant_batch() and current_file_position()
+			// are still correct.  The file descriptor is not closed when the view is destroyed.
+			static UniquePtr create_streaming(
+				std::unique_ptr< std::istream > stream,
+				std::string const& name = "(stream)",
+				std::size_t buffer_size = default_streaming_buffer_size
+			) ;
+			static UniquePtr create_streaming(
+				int fd,
+				std::string const& name = "(stream)",
+				std::size_t buffer_size = default_streaming_buffer_size
+			) ;
+
+			// Create a view of the given file, read as a stream (as by create_streaming()) if it is "-",
+			// meaning standard input, or is a pipe or other file that is not a regular file.
+			static UniquePtr create_from_path( std::string const& filename ) ;
+
 		public:
 			View( std::string const& filename ) ;
 
 			// Restrict this reader to a set of variants specified by the given query
+			// Throws std::invalid_argument if this is a streaming view.
 			void set_query( IndexQuery::UniquePtr query ) ;
 
 			// Report high-level information about the file
+			// number_of_variants() returns e_UnknownNumberOfVariants if no query is set and the header does not
+			// record the number of variants; read_variant() then reports variants until the end of the file.
 			uint32_t number_of_variants() const ;
 			std::size_t number_of_samples() const ;
 			std::ostream& summarise( std::ostream& o ) const ;
 
-			// Report the smaple IDs in the file using the given setter object
+			// Report the smaple IDs in the file, in file order, using the given setter object
 			// (If there are no sample IDs in the file, report a dummy identifier).
 			// Setter object must be callable as setter( index of sample, sample identifier ).
 			template< typename Setter >
@@ -78,19 +110,43 @@ namespace genfile {
 				std::vector< std::string >* alleles
 			) ;
 
+			// Read identifying data for up to max_variants variants into the given batch, which is cleared first,
+			// and return the number of variants read.  Fewer than max_variants are read only at the end of the file
+			// (or of the query, if one is set).  This must be called when read_variant() could be called,
+			// and leaves the view ready for a further call to read_variant() or read_variant_batch().
+			// Genotype data blocks are skipped unless include_genotype_data is true, in which case they are stored
+			// (still compressed) in the batch.
+			std::size_t read_variant_batch(
+				std::size_t max_variants,
+				VariantBatch* batch,
+				bool include_genotype_data = false
+			) ;
+
 			// Read, uncompress, and parse genotype probability data for the variant just read by read_variant().
 			// Data is returned via a setter object, using the parse_genotype_data API documented on the wiki.
 			// An example using this API is found in the bgen_to_vcf.cpp example program.
+			// If a sample order is set, the setter receives data as described for SampleOrderSetter.
 			template< typename ProbSetter >
 			void read_genotype_data_block( ProbSetter& setter ) {
 				assert( m_state == e_ReadyForProbs ) ;
-				genfile::bgen::read_and_parse_genotype_data_block< ProbSetter >(
-					*m_stream,
-					m_context,
-					setter,
-					&m_buffer1,
-					&m_buffer2
-				) ;
+				if( m_sample_order.get() ) {
+					SampleOrderSetter< ProbSetter > ordered_setter( setter, *m_sample_order ) ;
+					genfile::bgen::read_and_parse_genotype_data_block(
+						*m_stream,
+						m_context,
+						ordered_setter,
+						&m_buffer1,
+						&m_buffer2
+					) ;
+				} else {
+					genfile::bgen::read_and_parse_genotype_data_block< ProbSetter >(
+						*m_stream,
+						m_context,
+						setter,
+						&m_buffer1,
+						&m_buffer2
+					) ;
+				}
 				m_file_position = m_stream->tellg() ;
 				m_state = e_ReadyForVariant ;
 				++m_variant_i ;
@@ -103,24 +159,100 @@ namespace genfile {
 			// Currently this function works for 'layout=2' files, e.g. v1.2 and above only.
 			// The function will assert() if the data is not in this format.
 			// Data is returned in the fields of the supplied 'pack' object.  See bgen.hpp for the
-			// declaration of this object.
+			// declaration of this object.  Samples are in file order, regardless of any sample order.
 			void read_and_unpack_v12_genotype_data_block(
 				genfile::bgen::v12::GenotypeDataBlock* pack
 			) ;
 
+			// Read, uncompress, and compute expected dosages of the second allele for the variant just read
+			// by read_variant(), using the bulk decoders in dosage.hpp.  The result has one value per sample
+			// (in the sample order, if one is set), with missing and absent samples set to DosageTraits< T >::missing().
+			// T can be double, float, genfile::float16_t, genfile::bfloat16_t or uint8_t.
+			// If a dosage sidecar storing values of type T is in use, values are copied from it instead.
+			template< typename T >
+			void read_dosage_data_block( std::vector< T >* dosages ) {
+				if( m_sample_order.get() ) {
+					// Decode in file order, then rearrange.
+					m_dosages.resize( m_context.number_of_samples * sizeof( T )) ;
+					T* values = reinterpret_cast< T* >( &m_dosages[0] ) ;
+					read_dosages_in_file_order( values ) ;
+					dosages->resize( m_sample_order->size() ) ;
+					m_sample_order->apply( values, &(*dosages)[0], DosageTraits< T >::missing() ) ;
+				} else {
+					dosages->resize( m_context.number_of_samples ) ;
+					read_dosages_in_file_order( &(*dosages)[0] ) ;
+				}
+			}
+
+			// Use the given dosage sidecar file for read_dosage_data_block().
+			// Throws std::invalid_argument if the sidecar was not made from this bgen file.
+			// By default, View uses the sidecar at DosageSidecar::default_filename() if it exists and is current.
+			void use_dosage_sidecar( std::string const& filename ) ;
+			// Stop using any dosage sidecar.
+			void clear_dosage_sidecar() ;
+
+			// Report data from read_genotype_data_block() and read_dosage_data_block() with samples in
+			// the given order, e.g. to match the rows of a phenotype table.
+			// Throws std::invalid_argument if the order is not for this file's number of samples.
+			void set_sample_order( SampleOrder const& order ) ;
+			// Report data with samples in file order.
+			void clear_sample_order() ;
+			// Return the sample order in use, or 0 if there is none.
+			SampleOrder const* sample_order() const { return m_sample_order.get() ; }
+			// Return the dosage sidecar in use, or 0 if there is none.
+			DosageSidecar const* dosage_sidecar() const { return m_dosage_sidecar.get() ; }
+
+			// Read the genotype data block for the variant just read by read_variant() without
+			// uncompressing it.  The buffer receives the data as described for genfile::bgen::read_genotype_data_block(),
+			// and can be uncompressed later (e.g. in another thread) using genfile::bgen::uncompress_probability_data().
+			void read_raw_genotype_data_block( std::vector< byte_t >* buffer ) ;
+
 			// Skip over (i.e. ignore) genotype probability data for the current variant.
 			void ignore_genotype_data_block() ;
 
+			// Return true if this view was created by create_streaming().
+			bool is_streaming() const { return m_streambuf.get() != 0 ; }
+
 		private:
+			// Construct a streaming view reading from the given buffer, which takes its data from source.
+			View(
+				std::string const& name,
+				std::unique_ptr< std::streambuf > streambuf,
+				std::unique_ptr< std::istream > source
+			) ;
+
 			// Open the bgen file, read header data and gather metadata.
 			void setup( std::string const& filename ) ;
+			// Read the offset, header block and sample identifiers, leaving the stream at the first variant.
+			void read_header( std::string const& filename ) ;
 
 			// Utility function to read and uncompress variant genotype probability data
 			// without further processing.
-			std::vector< byte_t > const& read_and_uncompress_genotype_data_block() ;
+			Buffer const& read_and_uncompress_genotype_data_block() ;
+
+			// Read dosages for all samples, in file order, into the given array.
+			template< typename T >
+			void read_dosages_in_file_order( T* dosages ) {
+				if( m_dosage_sidecar.get() && m_dosage_sidecar->stores< T >() ) {
+					std::size_t const row = m_dosage_sidecar->find_variant( m_variant_position ) ;
+					if( row != DosageSidecar::npos ) {
+						T const* values = m_dosage_sidecar->row< T >( row ) ;
+						std::copy( values, values + m_context.number_of_samples, dosages ) ;
+						ignore_genotype_data_block() ;
+						return ;
+					}
+				}
+				Buffer const& buffer = read_and_uncompress_genotype_data_block() ;
+				genfile::bgen::parse_dosage_data( &buffer[0], &buffer[0] + buffer.size(), m_context, dosages ) ;
+				++m_variant_i ;
+			}
 
 		private:
 			std::string const m_filename ;
+			// For streaming views, the underlying stream (if any) and the buffer m_stream reads through.
+			// These are declared first so they outlive m_stream.
+			std::unique_ptr< std::istream > m_source ;
+			std::unique_ptr< std::streambuf > m_streambuf ;
 			std::unique_ptr< std::istream > m_stream ;
 			std::size_t m_variant_i ;
 			IndexQuery::UniquePtr m_index_query ;
@@ -150,10 +282,20 @@ namespace genfile {
 	
 			// To avoid issues with tellg() and failbit, we store the stream position at suitable points
 			std::streampos m_file_position ;
+			// Position of the variant last read by read_variant()
+			std::streampos m_variant_position ;
+
+			// Precomputed dosages, if available.
+			DosageSidecar::UniquePtr m_dosage_sidecar ;
+
+			// The order in which samples are reported, if not file order, and storage for dosages
+			// in file order.
+			std::unique_ptr< SampleOrder > m_sample_order ;
+			Buffer m_dosages ;
 	
 			// Two buffers for processing
-			std::vector< byte_t > m_buffer1 ;
-			std::vector< byte_t > m_buffer2 ;
+			Buffer m_buffer1 ;
+			Buffer m_buffer2 ;
 		} ;
 	}
 }
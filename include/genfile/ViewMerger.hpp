@@ -0,0 +1,149 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef GENFILE_BGEN_VIEW_MERGER_HPP
+#define GENFILE_BGEN_VIEW_MERGER_HPP
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <future>
+#include "bgen.hpp"
+#include "Buffer.hpp"
+#include "dosage.hpp"
+#include "ThreadPool.hpp"
+#include "VariantBatch.hpp"
+#include "View.hpp"
+
+namespace genfile {
+	namespace bgen {
+		// Read variants from several BGEN files with the same samples as a single stream,
+		// ordered by chromosome, position and alleles.
+		//
+		// Each source View must report its variants in order of chromosome and position (compared as
+		// strings and integers respectively), as it does when an index query is set; an exception is thrown
+		// if a source is found to be out of order.  Variants at the same position are reported in order of
+		// their alleles, and then in order of source.
+		//
+		// By default, a variant present in several sources is reported once for each source.  If prefer_source()
+		// is called, variants with the same chromosome, position and alleles are instead reported only once:
+		// from the preferred source if it contains the variant, otherwise from the first source that does.
+		//
+		// Variants are read from each source in batches, including their (compressed) genotype data.  If a
+		// ThreadPool is given, the next batch from each source is read on the pool while the current one is used.
+		struct ViewMerger {
+		public:
+			typedef std::unique_ptr< ViewMerger > UniquePtr ;
+			static std::size_t const npos = std::size_t( -1 ) ;
+
+		public:
+			// Construct a merger reading batch_size variants at a time from each source.
+			// The pool, if given, must outlive this object.
+			ViewMerger( ThreadPool* pool = 0, std::size_t batch_size = 256 ) ;
+			~ViewMerger() ;
+
+			// Add a source, which must have the same number of samples (and the same sample IDs, if both
+			// files store them) as any sources already added.  Otherwise std::invalid_argument is thrown.
+			// Sources must be added, and prefer_source() called, before the first call to read_variant().
+			void add_source( View::UniquePtr view ) ;
+			// Report duplicate variants only once, preferring the given source.
+			void prefer_source( std::size_t source ) ;
+
+			std::size_t number_of_sources() const { return m_sources.size() ; }
+			std::size_t number_of_samples() const ;
+			// Return the given source.  Its context and metadata may be inspected, but it must not be read from.
+			View const& source( std::size_t i ) const { return *(m_sources[i]->view) ; }
+
+			// Read identifying data for the next variant, returning false if there are no more variants.
+			// After this returns true, current_source() and the genotype data methods below refer to this variant.
+			// Unlike View, it is not necessary to read or ignore the genotype data before the next call.
+			bool read_variant(
+				std::string* SNPID,
+				std::string* rsid,
+				std::string* chromosome,
+				uint32_t* position,
+				std::vector< std::string >* alleles
+			) ;
+
+			// Return the index of the source of the variant last read by read_variant().
+			std::size_t current_source() const ;
+
+			// Return the genotype data block of the variant last read by read_variant(), without uncompressing it.
+			// This is the data returned by genfile::bgen::read_genotype_data_block(); it must be interpreted using
+			// the context of the current source.
+			std::pair< byte_t const*, byte_t const* > raw_genotype_data_block() const ;
+
+			// Uncompress and parse genotype probability data for the variant last read by read_variant(),
+			// as for View::read_genotype_data_block().
+			template< typename ProbSetter >
+			void read_genotype_data_block( ProbSetter& setter ) {
+				Buffer const& buffer = uncompress_genotype_data_block() ;
+				genfile::bgen::parse_probability_data(
+					&buffer[0], &buffer[0] + buffer.size(),
+					source( current_source() ).context(),
+					setter
+				) ;
+			}
+
+			// Uncompress genotype data for the variant last read by read_variant() and compute expected
+			// dosages of the second allele, as for View::read_dosage_data_block().
+			template< typename T >
+			void read_dosage_data_block( std::vector< T >* dosages ) {
+				Buffer const& buffer = uncompress_genotype_data_block() ;
+				dosages->resize( number_of_samples() ) ;
+				genfile::bgen::parse_dosage_data(
+					&buffer[0], &buffer[0] + buffer.size(),
+					source( current_source() ).context(),
+					&(*dosages)[0]
+				) ;
+			}
+
+		private:
+			struct Source {
+				std::size_t index ;
+				View::UniquePtr view ;
+				// The batch being consumed, and the index of the next variant in it.
+				VariantBatch batch ;
+				std::size_t next_variant ;
+				// The next batch, which may be being read on the pool.
+				VariantBatch next_batch ;
+				std::future< std::size_t > pending ;
+				bool exhausted ;
+			} ;
+
+		private:
+			ThreadPool* m_pool ;
+			std::size_t const m_batch_size ;
+			std::vector< std::unique_ptr< Source > > m_sources ;
+			std::size_t m_preferred_source ;
+			bool m_started ;
+			// Sources with variants remaining, arranged as a heap on their next variant.
+			std::vector< Source* > m_heap ;
+
+			// Variants at the current position, their sources, and the order in which they are reported.
+			VariantBatch m_group ;
+			std::vector< std::size_t > m_group_source ;
+			std::vector< std::size_t > m_group_order ;
+			std::size_t m_group_i ;
+
+			Buffer m_buffer1 ;
+			Buffer m_buffer2 ;
+
+		private:
+			void start() ;
+			void request_batch( Source* source ) ;
+			// Make the next variant of the given source available, returning false if there are no more.
+			bool advance( Source* source ) ;
+			// Read the next group of variants at the same position, returning false if there are no more.
+			bool read_group() ;
+			void take_variants_at( Source* source, std::string const& chromosome, uint32_t position ) ;
+			void order_group() ;
+			Buffer const& uncompress_genotype_data_block() ;
+		} ;
+	}
+}
+
+#endif
@@ -0,0 +1,115 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef GENFILE_BGEN_WRITER_HPP
+#define GENFILE_BGEN_WRITER_HPP
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <stdint.h>
+#include "types.hpp"
+#include "bgen.hpp"
+#include "IndexQuery.hpp"
+
+namespace genfile {
+	namespace bgen {
+		// Writer writes a bgen file one variant at a time.
+		// Genotype data must already be encoded, e.g. by GenotypeDataBlockWriter, so that
+		// encoding can be done elsewhere (e.g. in worker threads) and blocks written in order here.
+		// When writing to a file, the number of variants in the header is filled in by finalise().
+		// When writing to a stream, which need not be seekable (e.g. a pipe), the number of variants must
+		// instead be declared up front, or given as e_UnknownNumberOfVariants.
+		struct Writer {
+		public:
+			typedef std::unique_ptr< Writer > UniquePtr ;
+			typedef IndexQuery::FileMetadata FileMetadata ;
+			typedef IndexQuery::FileRange FileRange ;
+
+			// Open the given file and write the offset, header and (if sample_ids is nonempty)
+			// sample identifier block.  context.number_of_samples must be set, and must match
+			// the number of sample identifiers if these are given.  The e_SampleIdentifiers flag
+			// is set or cleared according to whether sample identifiers are given.
+			// Throws std::invalid_argument if the file cannot be opened.
+			static UniquePtr create(
+				std::string const& filename,
+				Context const& context,
+				std::vector< std::string > const& sample_ids = std::vector< std::string >()
+			) ;
+
+			// Write to the given stream, which must outlive the writer, without seeking.  The header records
+			// context.number_of_variants, which is either the number of variants that will be written
+			// (checked by finalise()) or e_UnknownNumberOfVariants.  name is used in error messages.
+			static UniquePtr create(
+				std::ostream& stream,
+				std::string const& name,
+				Context const& context,
+				std::vector< std::string > const& sample_ids = std::vector< std::string >()
+			) ;
+
+		public:
+			Writer(
+				std::string const& filename,
+				Context const& context,
+				std::vector< std::string > const& sample_ids = std::vector< std::string >()
+			) ;
+			Writer(
+				std::ostream& stream,
+				std::string const& name,
+				Context const& context,
+				std::vector< std::string > const& sample_ids = std::vector< std::string >()
+			) ;
+
+			std::string const& filename() const { return m_filename ; }
+			Context const& context() const { return m_context ; }
+			// Return the number of variants written so far.
+			std::size_t number_of_variants() const { return m_context.number_of_variants ; }
+
+			// Write a variant.  The genotype data block in [genotype_data, end_genotype_data) must be
+			// complete as it should appear in the file, i.e. as returned by GenotypeDataBlockWriter::repr().
+			// Return the start position and size in bytes of the variant, suitable for indexing.
+			FileRange write_variant(
+				std::string const& SNPID,
+				std::string const& rsid,
+				std::string const& chromosome,
+				uint32_t position,
+				std::vector< std::string > const& alleles,
+				byte_t const* genotype_data,
+				byte_t const* const end_genotype_data
+			) ;
+
+			// Write a variant that is already encoded, i.e. its identifying data followed by its genotype data
+			// block exactly as they appear in a bgen file with the same flags and number of samples.
+			// Return the start position and size in bytes of the variant, suitable for indexing.
+			FileRange write_encoded_variant( byte_t const* begin, byte_t const* const end ) ;
+
+			// Fill in the number of variants in the header and close the file.
+			// Return metadata for the finished file, suitable for recording in an index.
+			// When writing to a stream, instead flush the stream and check that the declared number of variants
+			// were written (throwing std::invalid_argument if not); the metadata then records the size and the
+			// first bytes written, but not a modification time.
+			FileMetadata finalise() ;
+
+		private:
+			void write_header( Context const& context, std::vector< std::string > const& sample_ids ) ;
+			void write( char const* data, std::size_t size ) ;
+
+		private:
+			std::string const m_filename ;
+			std::unique_ptr< std::ofstream > m_file ;
+			std::ostream& m_stream ;
+			uint32_t m_declared_number_of_variants ;
+			Context m_context ;
+			int64_t m_file_position ;
+			std::vector< byte_t > m_buffer ;
+			std::vector< byte_t > m_first_bytes ;
+			bool m_finalised ;
+		} ;
+	}
+}
+
+#endif
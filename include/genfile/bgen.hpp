@@ -60,10 +60,8 @@ namespace genfile {
 
 		namespace impl {
 			// n choose k implementation
-			// a faster implementation is of course possible, (e.g. table lookup)
-			// but this is not a bottleneck.
 			template< typename Integer >
-			Integer n_choose_k( Integer n, Integer k ) {
+			constexpr Integer n_choose_k( Integer n, Integer k ) {
 				if( k == 0 )  {
 					return 1 ;
 				} else if( k == 1 ) {
@@ -71,6 +69,32 @@ namespace genfile {
 				}
 				return ( n * n_choose_k(n - 1, k - 1) ) / k ;
 			}
+
+			// Table of the number of unphased genotypes, C( ploidy + K - 1, K - 1 ), for small ploidy and number of alleles K.
+			// All entries fit in 32 bits.
+			struct GenotypeCountTable {
+				enum { eMaxPloidy = 15, eMaxAlleles = 15 } ;
+				constexpr GenotypeCountTable():
+					counts()
+				{
+					for( uint32_t ploidy = 0; ploidy <= eMaxPloidy; ++ploidy ) {
+						for( uint32_t K = 1; K <= eMaxAlleles; ++K ) {
+							counts[ploidy][K] = n_choose_k< uint64_t >( ploidy + K - 1, K - 1 ) ;
+						}
+					}
+				}
+				uint32_t counts[ eMaxPloidy + 1 ][ eMaxAlleles + 1 ] ;
+			} ;
+
+			inline constexpr GenotypeCountTable genotype_count_table ;
+
+			// Return the number of unphased genotypes (i.e. of probabilities stored per sample)
+			// for the given ploidy and number of alleles.
+			inline uint32_t number_of_unphased_genotypes( uint32_t ploidy, uint32_t numberOfAlleles ) {
+				return ( ploidy <= GenotypeCountTable::eMaxPloidy && numberOfAlleles <= GenotypeCountTable::eMaxAlleles )
+					? genotype_count_table.counts[ ploidy ][ numberOfAlleles ]
+					: n_choose_k( ploidy + numberOfAlleles - 1, numberOfAlleles - 1 ) ;
+			}
 		}
 		
 		// class thrown when errors are detected
@@ -88,6 +112,9 @@ namespace genfile {
 		enum Layout { e_Layout0 = 0x0, e_Layout1 = 0x4, e_Layout2 = 0x8 } ;
 		enum Structure { e_SampleIdentifiers = 0x80000000 } ;
 		enum Compression { e_NoCompression = 0, e_ZlibCompression = 1, e_ZstdCompression = 2 } ;
+		// Value of the number of variants in the header of a file written without knowing the number
+		// of variants in advance (e.g. streamed to a pipe).  Readers of such files read variants until the end of the file.
+		enum NumberOfVariants { e_UnknownNumberOfVariants = 0xFFFFFFFF } ;
 		
 		// Structure containing information from the header block.
 		struct Context {
@@ -212,10 +239,12 @@ namespace genfile {
 		// for reading or computing the compressed data size.  Where applicable this function first
 		// reads the four bytes indicating the compressed data size; these are discarded
 		// and do not appear in the buffer).
+		// The buffer may be a std::vector< byte_t > or a genfile::Buffer, which is not zero-filled when resized.
+		template< typename Allocator >
 		void read_genotype_data_block(
 			std::istream& aStream,
 			Context const& context,
-			std::vector< byte_t >* buffer1
+			std::vector< byte_t, Allocator >* buffer1
 		) ;
 
 		// Low-level function which uncompresses probability data stored in the genotype data block
@@ -228,10 +257,11 @@ namespace genfile {
 		// the rest.)
 		// Usually bgen files are stored compressed.  If the data is not compressed, this function
 		// simply copies the source buffer to the target buffer.
+		template< typename Allocator1, typename Allocator2 >
 		void uncompress_probability_data(
 			Context const& context,
-			std::vector< byte_t > const& buffer1,
-			std::vector< byte_t >* buffer2
+			std::vector< byte_t, Allocator1 > const& buffer1,
+			std::vector< byte_t, Allocator2 >* buffer2
 		) ;
 
 		// template< typename Setter >
@@ -298,13 +328,13 @@ namespace genfile {
 		// 2: calls uncompress_probability_data() to uncompress the data where necessary.
 		// 3: calls parse_probability_data to parse it, returning values using the setter object provided.
 		// The buffers are used as intermediate storage and will be resized to fit data as needed.
-		template< typename Setter >
+		template< typename Setter, typename Allocator >
 		void read_and_parse_genotype_data_block(
 			std::istream& aStream,
 			Context const& context,
 			Setter& setter,
-			std::vector< byte_t >* buffer1,
-			std::vector< byte_t >* buffer2
+			std::vector< byte_t, Allocator >* buffer1,
+			std::vector< byte_t, Allocator >* buffer2
 		) ;
 	}
 }	
@@ -444,7 +474,9 @@ namespace genfile {
 			read_little_endian_integer( aStream, &block_size ) ;
 			read_little_endian_integer( aStream, &number_of_samples ) ;
 			bytes_read += 8 ;
-			assert( number_of_samples == context.number_of_samples ) ;
+			if( number_of_samples != context.number_of_samples ) {
+				throw BGenError() ;
+			}
 
 			for( uint32_t i = 0; i < number_of_samples; ++i ) {
 				read_length_followed_by_data( aStream, &identifier_size, &identifier ) ;
@@ -455,7 +487,9 @@ namespace genfile {
 					throw BGenError() ;
 				}
 			}
-			assert( bytes_read == block_size ) ;
+			if( bytes_read != block_size ) {
+				throw BGenError() ;
+			}
 			return bytes_read ;
 		}
 
@@ -501,7 +535,7 @@ namespace genfile {
 					return false ;
 				}
 			} else {
-				assert(0) ;
+				throw BGenError() ;
 			}
 
 			read_length_followed_by_data( aStream, &RSID_size, RSID ) ;
@@ -551,10 +585,10 @@ namespace genfile {
 			) {
 				uint32_t min_count = phased
 					? (min_ploidy * numberOfAlleles)
-					: impl::n_choose_k( min_ploidy + numberOfAlleles - 1, numberOfAlleles - 1 ) ;
+					: impl::number_of_unphased_genotypes( min_ploidy, numberOfAlleles ) ;
 				uint32_t max_count = phased
 					? (max_ploidy * numberOfAlleles)
-					: impl::n_choose_k( max_ploidy + numberOfAlleles - 1, numberOfAlleles - 1 ) ;
+					: impl::number_of_unphased_genotypes( max_ploidy, numberOfAlleles ) ;
 				setter.set_min_max_ploidy(
 					min_ploidy, max_ploidy,
 					min_count, max_count
@@ -858,6 +892,19 @@ namespace genfile {
 						return value ;
 					}
 
+					// consume n values without interpreting them
+					void skip( std::size_t n ) {
+#if BGEN_LITTLE_ENDIAN
+						std::size_t const shift = m_shift + n * m_bits ;
+						m_buffer += 4 * ( shift / 32 ) ;
+						m_shift = int( shift % 32 ) ;
+#else
+						for( std::size_t i = 0; i < n; ++i ) {
+							next() ;
+						}
+#endif
+					}
+
 				private:
 					byte_t const* m_buffer ;
 					byte_t const* const m_end ;
@@ -896,6 +943,10 @@ namespace genfile {
 						) / 255.0;
 					}
 
+					void skip( std::size_t n ) {
+						m_buffer += n ;
+					}
+
 				private:
 					byte_t const* m_buffer ;
 					byte_t const* const m_end ;
@@ -931,6 +982,10 @@ namespace genfile {
 						return value ;
 					}
 
+					void skip( std::size_t n ) {
+						m_buffer += 2*n ;
+					}
+
 				private:
 					byte_t const* m_buffer ;
 					byte_t const* const m_end ;
@@ -956,6 +1011,34 @@ namespace genfile {
 				) ;
 			}
 
+			// A range of samples in a genotype data block, whose data starts on a byte boundary
+			// byte_offset bytes into the block's probability data.
+			struct SampleRange {
+				uint32_t begin ;
+				uint32_t end ;
+				std::size_t byte_offset ;
+			} ;
+
+			struct GenotypeDataBlock ;
+
+			// Return the number of probability values stored for each sample with the given ploidy.
+			inline uint32_t number_of_stored_values( uint32_t ploidy, uint32_t numberOfAlleles, bool phased ) {
+				if( numberOfAlleles == 0 ) {
+					return 0 ;
+				}
+				// One value of each haplotype (phased) or of the whole sample (unphased) is implied.
+				return phased
+					? ( ploidy * ( numberOfAlleles - 1 ))
+					: ( genfile::bgen::impl::number_of_unphased_genotypes( ploidy, numberOfAlleles ) - 1 ) ;
+			}
+
+			// Divide the samples of pack into at most number_of_ranges contiguous ranges of similar size,
+			// in sample order, so that each range can be parsed independently (e.g. on its own thread).
+			// Ranges start at samples whose data is byte-aligned.  For data of fixed ploidy these are found
+			// directly; otherwise bit offsets are found by summing over the samples' ploidies, and fewer
+			// ranges are returned if few samples are aligned.
+			std::vector< SampleRange > split_by_samples( GenotypeDataBlock const& pack, std::size_t number_of_ranges ) ;
+
 			struct GenotypeDataBlock {
 			public:
 				GenotypeDataBlock() ;
@@ -972,6 +1055,13 @@ namespace genfile {
 					byte_t const* const end
 				) ;
 
+				// Set this block to refer to the samples of pack in the given range, which must be one
+				// returned by split_by_samples( pack ).  Samples in the range are numbered from zero.
+				void initialise(
+					GenotypeDataBlock const& pack,
+					SampleRange const& range
+				) ;
+
 			public:
 				Context const* context ;
 				uint32_t numberOfSamples ;
@@ -1041,6 +1131,27 @@ namespace genfile {
 				this->buffer = buffer ;
 				this->end = end ;
 			}
+
+			inline void GenotypeDataBlock::initialise(
+				GenotypeDataBlock const& pack,
+				SampleRange const& range
+			) {
+				assert( range.begin <= range.end && range.end <= pack.numberOfSamples ) ;
+				if( pack.end < pack.buffer + range.byte_offset ) {
+					throw BGenError() ;
+				}
+				this->context = pack.context ;
+				this->numberOfSamples = range.end - range.begin ;
+				this->numberOfAlleles = pack.numberOfAlleles ;
+				// The ploidy extent is that of the whole block, which bounds the ploidy of the range.
+				this->ploidyExtent[0] = pack.ploidyExtent[0] ;
+				this->ploidyExtent[1] = pack.ploidyExtent[1] ;
+				this->ploidy = pack.ploidy + range.begin ;
+				this->phased = pack.phased ;
+				this->bits = pack.bits ;
+				this->buffer = pack.buffer + range.byte_offset ;
+				this->end = pack.end ;
+			}
 			
 
 			template< typename Setter >
@@ -1063,63 +1174,55 @@ namespace genfile {
 			) {
 				Context const& context = *(pack.context) ;
 				// We optimise the most common and simplest-to- parse cases.
-				// These are the case where all samples are diploid, and/or where
-				// the number of bits is a multiple of 8.
-				// This if statement chooses an appropriate implementation.
-				if( pack.ploidyExtent[0] == 2 && pack.ploidyExtent[1] == 2 && pack.numberOfAlleles == 2 ) {
-					switch( pack.bits ) {
-						case 8:
-							parse_probability_data_diploid_biallelic(
-								pack,
-								impl::SpecialisedBitParser<8>( pack.buffer, pack.end ),
-								context,
-								setter
-							) ;
-							break ;
-						case 16:
-							parse_probability_data_diploid_biallelic(
-								pack,
-								impl::SpecialisedBitParser<16>( pack.buffer, pack.end ),
-								context,
-								setter
-							) ;
-							break ;
-						default:
-							parse_probability_data_diploid_biallelic(
-								pack,
-								impl::BitParser( pack.buffer, pack.end, pack.bits ),
-								context,
-								setter
-							) ;
-							break ;
+				// These are the case where the number of bits is a multiple of 8,
+				// and/or where variants are biallelic.
+				// This switch statement chooses an appropriate bit parser.
+				switch( pack.bits ) {
+					case 8:
+						parse_probability_data_by_shape(
+							pack,
+							impl::SpecialisedBitParser<8>( pack.buffer, pack.end ),
+							context,
+							setter
+						) ;
+						break ;
+					case 16:
+						parse_probability_data_by_shape(
+							pack,
+							impl::SpecialisedBitParser<16>( pack.buffer, pack.end ),
+							context,
+							setter
+						) ;
+						break ;
+					default:
+						parse_probability_data_by_shape(
+							pack,
+							impl::BitParser( pack.buffer, pack.end, pack.bits ),
+							context,
+							setter
+						) ;
+						break ;
+				}
+			}
+
+			// Choose an implementation based on the number of alleles and range of ploidy.
+			// Diploid biallelic data, and biallelic data of mixed ploidy (e.g. haploid males
+			// mixed with diploid females on chrX) have specialised implementations.
+			template< typename Setter, typename BitParser >
+			void parse_probability_data_by_shape(
+				GenotypeDataBlock const& pack,
+				BitParser const& valueConsumer,
+				Context const& context,
+				Setter& setter
+			) {
+				if( pack.numberOfAlleles == 2 ) {
+					if( pack.ploidyExtent[0] == 2 && pack.ploidyExtent[1] == 2 ) {
+						parse_probability_data_diploid_biallelic( pack, valueConsumer, context, setter ) ;
+					} else {
+						parse_probability_data_biallelic( pack, valueConsumer, context, setter ) ;
 					}
 				} else {
-					switch( pack.bits ) {
-						case 8:
-							parse_probability_data_general(
-								pack,
-								impl::SpecialisedBitParser<8>( pack.buffer, pack.end ),
-								context,
-								setter
-							) ;
-							break ;
-						case 16:
-							parse_probability_data_general(
-								pack,
-								impl::SpecialisedBitParser<16>( pack.buffer, pack.end ),
-								context,
-								setter
-							) ;
-							break ;
-						default:
-							parse_probability_data_general(
-								pack,
-								impl::BitParser( pack.buffer, pack.end, pack.bits ),
-								context,
-								setter
-							) ;
-							break ;
-					}
+					parse_probability_data_general( pack, valueConsumer, context, setter ) ;
 				}
 			}
 
@@ -1210,17 +1313,70 @@ namespace genfile {
 			}
 
 			template< typename Setter, typename BitParser >
-			void parse_probability_data_general(
+			void parse_probability_data_biallelic(
 				GenotypeDataBlock const& pack,
 				BitParser valueConsumer,
 				Context const& context,
 				Setter& setter
 			) {
-				// These values are specific bit combinations and should not be changed.
-				enum SampleStatus { eIgnore = 0, eSetThisSample = 1, eSetAsMissing = 3 } ;
-				
+				assert( pack.numberOfAlleles == 2 ) ;
 				byte_t const* ploidy_p = pack.ploidy ;
-				
+
+				setter.initialise( pack.numberOfSamples, uint32_t( 2 ) ) ;
+				call_set_min_max_ploidy(
+					setter,
+					uint32_t( pack.ploidyExtent[0] ),
+					uint32_t( pack.ploidyExtent[1] ),
+					2,
+					pack.phased
+				) ;
+
+				// For biallelic data, each sample stores one value per chromosome.
+				// For phased data this is the probability of the first allele on each haplotype;
+				// for unphased data the probability of each genotype save the last.
+				OrderType const order_type = pack.phased ? ePerPhasedHaplotypePerAllele : ePerUnorderedGenotype ;
+				for( uint32_t i = 0; i < pack.numberOfSamples; ++i, ++ploidy_p ) {
+					uint32_t const ploidy = uint32_t(*ploidy_p & 0x3F) ;
+					if( !valueConsumer.check( ploidy )) {
+						throw BGenError() ;
+					}
+					if( !setter.set_sample( i ) ) {
+						valueConsumer.skip( ploidy ) ;
+						continue ;
+					}
+					uint32_t const valueCount = pack.phased ? ( 2 * ploidy ) : ( ploidy + 1 ) ;
+					setter.set_number_of_entries( ploidy, valueCount, order_type, eProbability ) ;
+					if( *ploidy_p & 0x80 ) {
+						valueConsumer.skip( ploidy ) ;
+						for( uint32_t k = 0; k < valueCount; ++k ) {
+							setter.set_value( k, genfile::MissingValue() ) ;
+						}
+					} else if( pack.phased ) {
+						for( uint32_t hap = 0; hap < ploidy; ++hap ) {
+							double const value = valueConsumer.next() ;
+							setter.set_value( 2*hap + 0, value ) ;
+							setter.set_value( 2*hap + 1, 1.0 - value ) ;
+						}
+					} else {
+						double sum = 0.0 ;
+						for( uint32_t k = 0; k < ploidy; ++k ) {
+							double const value = valueConsumer.next() ;
+							setter.set_value( k, value ) ;
+							sum += value ;
+						}
+						setter.set_value( ploidy, 1.0 - sum ) ;
+					}
+				}
+				call_finalise( setter ) ;
+			}
+
+			template< typename Setter, typename BitParser >
+			void parse_probability_data_general(
+				GenotypeDataBlock const& pack,
+				BitParser valueConsumer,
+				Context const& context,
+				Setter& setter
+			) {
 	#if DEBUG_BGEN_FORMAT
 				std::cerr << "parse_probability_data_v12(): numberOfSamples = " << numberOfSamples
 					<< ", phased = " << phased << ".\n" ;
@@ -1236,110 +1392,50 @@ namespace genfile {
 					pack.numberOfAlleles,
 					pack.phased
 				) ;
-				
-				{
-					if( pack.phased ) {
-						for( uint32_t i = 0; i < pack.numberOfSamples; ++i, ++ploidy_p ) {
-							uint32_t const ploidy = uint32_t(*ploidy_p & 0x3F) ;
-							bool const missing = (*ploidy_p & 0x80) ;
-							int const sample_status = (setter.set_sample( i ) * 0x1) + (missing * 0x2);
 
-							uint32_t const valueCount = (ploidy * pack.numberOfAlleles) ;
+				uint32_t const numberOfAlleles = pack.numberOfAlleles ;
+				if( numberOfAlleles == 0 ) {
+					throw BGenError() ;
+				}
+				OrderType const order_type = pack.phased ? ePerPhasedHaplotypePerAllele : ePerUnorderedGenotype ;
+				byte_t const* const ploidy_end = pack.ploidy + pack.numberOfSamples ;
+				// Samples are processed in runs of equal ploidy, which share the number of values.
+				for( byte_t const* ploidy_p = pack.ploidy; ploidy_p < ploidy_end; ) {
+					uint32_t const ploidy = uint32_t(*ploidy_p & 0x3F) ;
+					byte_t const* run_end = ploidy_p + 1 ;
+					for( ; run_end < ploidy_end && uint32_t(*run_end & 0x3F) == ploidy; ++run_end ) {}
+
+					// Values are stored in groups - one per haplotype for phased data, or a single group
+					// for unphased data - with the last value of each group implied.
+					uint32_t const valueCount = pack.phased
+						? ( ploidy * numberOfAlleles )
+						: genfile::bgen::impl::number_of_unphased_genotypes( ploidy, numberOfAlleles ) ;
+					uint32_t const groupSize = pack.phased ? numberOfAlleles : valueCount ;
+					uint32_t const storedValueCount = valueCount - ( valueCount / groupSize ) ;
+					if( !valueConsumer.check( storedValueCount * std::size_t( run_end - ploidy_p ))) {
+						throw BGenError() ;
+					}
 
-							if( sample_status & 0x1 ) {
-								setter.set_number_of_entries(
-									ploidy,
-									valueCount,
-									ePerPhasedHaplotypePerAllele,
-									eProbability
-								) ;
-							}
-							
-							// Consume values and interpret them.
-							double sum = 0.0 ;
-							uint32_t reportedValueCount = 0 ;
-							if( !valueConsumer.check( ploidy * (pack.numberOfAlleles-1) )) {
-								throw BGenError() ;
+					for( ; ploidy_p < run_end; ++ploidy_p ) {
+						if( !setter.set_sample( uint32_t( ploidy_p - pack.ploidy ) )) {
+							valueConsumer.skip( storedValueCount ) ;
+							continue ;
+						}
+						setter.set_number_of_entries( ploidy, valueCount, order_type, eProbability ) ;
+						if( *ploidy_p & 0x80 ) {
+							valueConsumer.skip( storedValueCount ) ;
+							for( uint32_t k = 0; k < valueCount; ++k ) {
+								setter.set_value( k, genfile::MissingValue() ) ;
 							}
-							for( uint32_t hap = 0; hap < ploidy; ++hap ) {
-								for( uint32_t allele = 0; allele < (pack.numberOfAlleles-1); ++allele ) {
+						} else {
+							for( uint32_t k = 0; k < valueCount; k += groupSize ) {
+								double sum = 0.0 ;
+								for( uint32_t j = 1; j < groupSize; ++j ) {
 									double const value = valueConsumer.next() ;
-									switch( sample_status ) {
-										case eIgnore: break ;
-										case eSetAsMissing:
-											setter.set_value( reportedValueCount++, genfile::MissingValue() ) ;
-											break ;
-										case eSetThisSample:
-											setter.set_value( reportedValueCount++, value ) ;
-											sum += value ;
-											break ;
-									}
-								}
-								
-								// set value for kth allele
-								switch( sample_status ) {
-									case eIgnore: break ;
-									case eSetAsMissing:
-										setter.set_value( reportedValueCount++, genfile::MissingValue() ) ;
-										break ;
-									case eSetThisSample:
-										setter.set_value( reportedValueCount++, 1 - sum ) ;
-										sum = 0.0 ;
-										break ;
+									setter.set_value( k + j - 1, value ) ;
+									sum += value ;
 								}
-							}
-						}
-					} else {
-						for( uint32_t i = 0; i < pack.numberOfSamples; ++i, ++ploidy_p ) {
-							uint32_t const ploidy = uint32_t(*ploidy_p & 0x3F) ;
-							bool const missing = (*ploidy_p & 0x80) ;
-							int const sample_status = (setter.set_sample( i ) * 0x1) + (missing * 0x2);
-							
-							uint32_t const valueCount
-								= genfile::bgen::impl::n_choose_k(
-									uint32_t( ploidy + pack.numberOfAlleles - 1 ), 
-									uint32_t( pack.numberOfAlleles - 1 )
-								) ;
-							uint32_t const storedValueCount = valueCount - 1 ;
-							
-							if( sample_status & 0x1 ) {
-								setter.set_number_of_entries(
-									ploidy,
-									valueCount,
-									ePerUnorderedGenotype,
-									eProbability
-								) ;
-							}
-							
-							if( !valueConsumer.check( storedValueCount )) {
-								throw BGenError() ;
-							}
-							
-							double sum = 0.0 ;
-							uint32_t reportedValueCount = 0 ;
-							for( uint32_t h = 0; h < storedValueCount; ++h ) {
-								double const value = valueConsumer.next() ;
-								switch( sample_status ) {
-									case eIgnore: break ;
-									case eSetAsMissing:
-										setter.set_value( reportedValueCount++, genfile::MissingValue() ) ;
-										break ;
-									case eSetThisSample:
-										setter.set_value( reportedValueCount++, value ) ;
-										sum += value ;
-										break ;
-								}
-							}
-							
-							// set final value
-							switch( sample_status ) {
-								case eIgnore: break ;
-								case eSetAsMissing:
-									setter.set_value( reportedValueCount++, genfile::MissingValue() ) ;
-									break ;
-								case eSetThisSample:
-									setter.set_value( reportedValueCount++, 1.0 - sum ) ;
-									break ;
+								setter.set_value( k + groupSize - 1, 1.0 - sum ) ;
 							}
 						}
 					}
@@ -1629,13 +1725,65 @@ namespace genfile {
 			}
 		}
 
-		template< typename Setter >
+		template< typename Allocator >
+		void read_genotype_data_block(
+			std::istream& aStream,
+			Context const& context,
+			std::vector< byte_t, Allocator >* buffer
+		) {
+			uint32_t payload_size = 0 ;
+			if( (context.flags & e_Layout) == e_Layout2 || ((context.flags & e_CompressedSNPBlocks) != e_NoCompression ) ) {
+				read_little_endian_integer( aStream, &payload_size ) ;
+			} else {
+				payload_size = 6 * context.number_of_samples ;
+			}
+			buffer->resize( payload_size ) ;
+			aStream.read( reinterpret_cast< char* >( &(*buffer)[0] ), payload_size ) ;
+			if( !aStream ) {
+				throw BGenError() ;
+			}
+		}
+
+		template< typename Allocator1, typename Allocator2 >
+		void uncompress_probability_data(
+			Context const& context,
+			std::vector< byte_t, Allocator1 > const& compressed_data,
+			std::vector< byte_t, Allocator2 >* buffer
+		) {
+			// compressed_data contains the (compressed or uncompressed) probability data.
+			uint32_t const compressionType = (context.flags & bgen::e_CompressedSNPBlocks) ;
+			if( compressionType != e_NoCompression ) {
+				byte_t const* begin = &compressed_data[0] ;
+				byte_t const* const end = &compressed_data[0] + compressed_data.size() ;
+				uint32_t uncompressed_data_size = 0 ;
+				if( (context.flags & e_Layout) == e_Layout1 ) {
+					uncompressed_data_size = 6 * context.number_of_samples ;
+				} else {
+					begin = read_little_endian_integer( begin, end, &uncompressed_data_size ) ;
+				}
+				buffer->resize( uncompressed_data_size ) ;
+				if( compressionType == e_ZlibCompression ) {
+					zlib_uncompress( begin, end, buffer ) ;
+				} else if( compressionType == e_ZstdCompression ) {
+					zstd_uncompress( begin, end, buffer ) ;
+				}
+				if( buffer->size() != uncompressed_data_size ) {
+					throw BGenError() ;
+				}
+			}
+			else {
+				// copy the data between buffers.
+				buffer->assign( compressed_data.begin(), compressed_data.end() ) ;
+			}
+		}
+
+		template< typename Setter, typename Allocator >
 		void read_and_parse_genotype_data_block(
 			std::istream& aStream,
 			Context const& context,
 			Setter& setter,
-			std::vector< byte_t >* buffer1,
-			std::vector< byte_t >* buffer2
+			std::vector< byte_t, Allocator >* buffer1,
+			std::vector< byte_t, Allocator >* buffer2
 		) {
 			read_genotype_data_block( aStream, context, buffer1 ) ;
 			uncompress_probability_data( context, *buffer1, buffer2 ) ;
@@ -1705,11 +1853,14 @@ namespace genfile {
 			return p ;
 		}
 
-		struct GenotypeDataBlockWriter
+		// Encodes genotype data for one variant into a genotype data block, using two buffers of type
+		// BufferType (std::vector< byte_t > for GenotypeDataBlockWriter, or e.g. genfile::Buffer).
+		template< typename BufferType >
+		struct BasicGenotypeDataBlockWriter
 		{
-			GenotypeDataBlockWriter(
-				std::vector< byte_t >* buffer1,
-				std::vector< byte_t >* buffer2,
+			BasicGenotypeDataBlockWriter(
+				BufferType* buffer1,
+				BufferType* buffer2,
 				Context const& context,
 				int const number_of_bits,
 				double permitted_rounding_error = 0.0005
@@ -1734,9 +1885,10 @@ namespace genfile {
 				}
 			}
 
-			void initialise( uint32_t nSamples, uint16_t nAlleles ) {
+			// The buffer is sized for samples of ploidy up to max_ploidy.  Callers that know the
+			// ploidy in advance can pass it to avoid a large allocation for multiallelic variants.
+			void initialise( uint32_t nSamples, uint16_t nAlleles, std::size_t const max_ploidy = 15 ) {
 				assert( nSamples == m_context.number_of_samples ) ;
-				std::size_t const max_ploidy = 15 ;
 				std::size_t const buffer_size =
 					( m_layout == e_Layout1 )
 						? (6 * nSamples)
@@ -1772,10 +1924,24 @@ namespace genfile {
 				// Sanity check: did we get the size right?
 				assert( m_writer->repr().first == &(*m_buffer1)[0] ) ;
 				assert( (m_writer->repr().second >= m_writer->repr().first) && std::size_t(m_writer->repr().second - m_writer->repr().first) <= m_buffer1->size() ) ;
-				uLongf const uncompressed_data_size = (m_writer->repr().second - m_writer->repr().first) ;
+				compress( m_writer->repr().first, m_writer->repr().second ) ;
+			}
+
+			// Compress (as specified by the context) uncompressed genotype data that was encoded elsewhere,
+			// e.g. by rearranging an existing block, so that repr() returns the block as it should appear
+			// in the file.  The data must not lie in buffer2.
+			void set_uncompressed_data( byte_t const* begin, byte_t const* const end ) {
+				compress( begin, end ) ;
+			}
+
+			std::pair< byte_t const*, byte_t const* > repr() const { return m_result ; }
+
+		private:
+			void compress( byte_t const* begin, byte_t const* const end ) {
+				uLongf const uncompressed_data_size = ( end - begin ) ;
 
 #if DEBUG_BGEN_FORMAT
-				std::cerr << ( m_writer->repr().first ) << "  :" << m_writer->repr().second << ", diff = " << (m_writer->repr().second - m_writer->repr().first) << "\n" ;
+				std::cerr << begin << "  :" << end << ", diff = " << ( end - begin ) << "\n" ;
 				std::cerr << "expected " << uncompressed_data_size << "\n" ;
 #endif
 				uint32_t const compressionType = ( m_context.flags & e_CompressedSNPBlocks ) ;
@@ -1784,14 +1950,14 @@ namespace genfile {
 					std::size_t offset = (m_layout == e_Layout2) ? 8 : 4 ;
 					if( compressionType == e_ZlibCompression ) {
 						zlib_compress(
-							&(*m_buffer1)[0], &(*m_buffer1)[0] + uncompressed_data_size,
+							begin, end,
 							m_buffer2,
 							offset,
 							9 // highest compression setting.
 						) ;
 					} else if( compressionType == e_ZstdCompression ) {
 						zstd_compress(
-							&(*m_buffer1)[0], &(*m_buffer1)[0] + uncompressed_data_size,
+							begin, end,
 							m_buffer2,
 							offset,
 							17 // reasonable balance between speed and compression.
@@ -1818,20 +1984,18 @@ namespace genfile {
 					// Copy uncompressed data to compression buffer
 					// This is inefficient but is not expected to be used much, so not important.
 					std::size_t offset = (m_layout == e_Layout2) ? 4 : 0 ;
-					m_buffer2->resize( m_buffer1->size() + offset ) ;
+					m_buffer2->resize( uncompressed_data_size + offset ) ;
 					if( m_layout == e_Layout2 ) {
 						write_little_endian_integer( &(*m_buffer2)[0], &(*m_buffer2)[0]+4, uint32_t( uncompressed_data_size )) ;
 					}
-					std::copy( &(*m_buffer1)[0], &(*m_buffer1)[0] + uncompressed_data_size, &(*m_buffer2)[0] + offset ) ;
+					std::copy( begin, end, &(*m_buffer2)[0] + offset ) ;
 					m_result = std::make_pair( &(*m_buffer2)[0], &(*m_buffer2)[0] + uncompressed_data_size + offset ) ;
 				}
 			}
-			
-			std::pair< byte_t const*, byte_t const* > repr() const { return m_result ; }
-			
+
 		private:
-			std::vector< byte_t >* m_buffer1 ;
-			std::vector< byte_t >* m_buffer2 ;
+			BufferType* m_buffer1 ;
+			BufferType* m_buffer2 ;
 			Context const& m_context ;
 			uint32_t const m_layout ;
 			std::size_t m_number_of_bits ;
@@ -1840,6 +2004,8 @@ namespace genfile {
 			impl::ProbabilityDataWriterBase* m_writer ;
 			std::pair< byte_t const*, byte_t const* > m_result ;
 		} ;
+
+		typedef BasicGenotypeDataBlockWriter< std::vector< byte_t > > GenotypeDataBlockWriter ;
 	}
 }
 
@@ -0,0 +1,170 @@
+
+/*          Copyright Gavin Band 2008 - 2012.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#ifndef GENFILE_BGEN_C_H
+#define GENFILE_BGEN_C_H
+
+/*
+ * A C interface to reading bgen files, intended for language bindings.
+ *
+ * A bgen_file holds an open file and a selection of its variants, made using one of the
+ * bgen_select_*() functions.  Identifying data for the selected variants is held in memory
+ * and can be accessed without copying.  Genotype data for any run of selected variants is
+ * decoded by bgen_read_dosages() or bgen_read_probabilities() directly into buffers supplied
+ * by the caller, using several threads if bgen_set_threads() has been called.
+ *
+ * Functions that can fail return a bgen_status; a description of the most recent error on the
+ * calling thread is returned by bgen_error_message().  A bgen_file may be used from any thread,
+ * but not from several threads at once.
+ *
+ * Functions are only ever added to this interface, so that the library remains compatible with
+ * code built against earlier versions; BGEN_C_API_VERSION is increased when functions are added.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined( _WIN32 )
+	#define BGEN_C_EXPORT __declspec( dllexport )
+#else
+	#define BGEN_C_EXPORT __attribute__(( visibility( "default" )))
+#endif
+
+#define BGEN_C_API_VERSION 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+	BGEN_OK = 0,
+	/* An argument was invalid, e.g. an index out of range or a null pointer. */
+	BGEN_ERROR_INVALID_ARGUMENT = 1,
+	/* A file could not be opened or read. */
+	BGEN_ERROR_IO = 2,
+	/* The file is not a valid bgen file, or its data is corrupt. */
+	BGEN_ERROR_FORMAT = 3,
+	/* The operation needs an index, and none is available or it does not match the file. */
+	BGEN_ERROR_INDEX = 4,
+	/* A buffer supplied by the caller is too small for the data. */
+	BGEN_ERROR_BUFFER_TOO_SMALL = 5,
+	BGEN_ERROR_OUT_OF_MEMORY = 6,
+	BGEN_ERROR_UNKNOWN = 7
+} bgen_status ;
+
+typedef struct bgen_file bgen_file ;
+
+/* Return BGEN_C_API_VERSION as it was when the library was built. */
+BGEN_C_EXPORT int bgen_api_version( void ) ;
+
+/* Return a description of the last error reported on this thread.  The string is valid until the
+ * next call to this library on this thread. */
+BGEN_C_EXPORT char const* bgen_error_message( void ) ;
+
+/*
+ * Opening and closing files.
+ */
+
+/* Open a bgen file, and the given bgenix index if index_filename is not NULL.  On success, *result
+ * must be passed to bgen_close() when no longer needed.  Initially no variants are selected. */
+BGEN_C_EXPORT bgen_status bgen_open( char const* filename, char const* index_filename, bgen_file** result ) ;
+BGEN_C_EXPORT void bgen_close( bgen_file* file ) ;
+
+/* Decode genotype data using the given number of threads (zero meaning one per core).  By default one
+ * thread is used. */
+BGEN_C_EXPORT bgen_status bgen_set_threads( bgen_file* file, size_t number_of_threads ) ;
+
+BGEN_C_EXPORT size_t bgen_number_of_samples( bgen_file const* file ) ;
+/* The number of variants in the file, according to its header. */
+BGEN_C_EXPORT size_t bgen_number_of_variants( bgen_file const* file ) ;
+/* The layout (1 or 2) of genotype data in the file. */
+BGEN_C_EXPORT int bgen_layout( bgen_file const* file ) ;
+
+/* Return the identifier of the ith sample (or a generated identifier, if the file stores none)
+ * as a NUL-terminated string valid until the file is closed, or NULL if i is out of range. */
+BGEN_C_EXPORT char const* bgen_sample_id( bgen_file const* file, size_t i ) ;
+
+/*
+ * Selecting variants.  Each call replaces the current selection.  Variants are selected in the order of
+ * the index (by chromosome and position), or by bgen_select_all() in file order if no index was opened.
+ * Selecting by range or rsid requires an index.
+ */
+
+BGEN_C_EXPORT bgen_status bgen_select_all( bgen_file* file ) ;
+/* Select variants on the given chromosome with positions between start and end inclusive. */
+BGEN_C_EXPORT bgen_status bgen_select_range( bgen_file* file, char const* chromosome, uint32_t start, uint32_t end ) ;
+/* Select variants with the given rsids, which must be distinct. */
+BGEN_C_EXPORT bgen_status bgen_select_rsids( bgen_file* file, char const* const* rsids, size_t number_of_rsids ) ;
+
+/* Restrict decoded data to the given samples, in the given order.  Passing NULL restores all samples. */
+BGEN_C_EXPORT bgen_status bgen_select_samples( bgen_file* file, size_t const* samples, size_t number_of_samples ) ;
+/* The number of samples for which data is decoded, i.e. the number of columns of decoded output. */
+BGEN_C_EXPORT size_t bgen_number_of_selected_samples( bgen_file const* file ) ;
+
+/*
+ * Identifying data for selected variants.  Pointers returned are valid until the selection changes
+ * or the file is closed.  Strings are not NUL-terminated; their length is returned separately.
+ */
+
+BGEN_C_EXPORT size_t bgen_number_of_selected_variants( bgen_file const* file ) ;
+/* Arrays with one entry per selected variant. */
+BGEN_C_EXPORT uint32_t const* bgen_selected_positions( bgen_file const* file ) ;
+BGEN_C_EXPORT uint16_t const* bgen_selected_numbers_of_alleles( bgen_file const* file ) ;
+BGEN_C_EXPORT int64_t const* bgen_selected_file_offsets( bgen_file const* file ) ;
+
+typedef enum {
+	BGEN_FIELD_SNPID = 0,
+	BGEN_FIELD_RSID = 1,
+	BGEN_FIELD_CHROMOSOME = 2
+} bgen_field ;
+
+BGEN_C_EXPORT bgen_status bgen_selected_string(
+	bgen_file const* file, size_t variant, bgen_field field,
+	char const** data, size_t* size
+) ;
+/* Return the kth allele of the given selected variant.  Variants selected using an index record only
+ * their first two alleles; later alleles are available from bgen_read_alleles(). */
+BGEN_C_EXPORT bgen_status bgen_selected_allele(
+	bgen_file const* file, size_t variant, size_t k,
+	char const** data, size_t* size
+) ;
+
+/*
+ * Decoding genotype data.  These functions decode count selected variants starting at first.
+ */
+
+/* Write expected dosages of the second allele into out, which must have room for count rows of
+ * bgen_number_of_selected_samples() values.  Missing values and variants that are not biallelic
+ * are written as NaN. */
+BGEN_C_EXPORT bgen_status bgen_read_dosages( bgen_file* file, size_t first, size_t count, double* out ) ;
+BGEN_C_EXPORT bgen_status bgen_read_dosages_float( bgen_file* file, size_t first, size_t count, float* out ) ;
+
+/* Write genotype probabilities into out, which must have room for count rows of
+ * bgen_number_of_selected_samples() * stride values.  Each sample's probabilities are written at
+ * the start of its stride values, in the order given by the bgen specification, and the remainder
+ * are set to NaN; missing values are also NaN.  If ploidy is not NULL it receives each sample's
+ * ploidy, with the same layout as dosages, and if phased is not NULL it receives, for each variant,
+ * 1 if the data is phased and 0 otherwise.  Returns BGEN_ERROR_BUFFER_TOO_SMALL if any sample has more
+ * than stride probabilities, e.g. stride 3 suffices for unphased diploid biallelic data. */
+BGEN_C_EXPORT bgen_status bgen_read_probabilities(
+	bgen_file* file, size_t first, size_t count,
+	size_t stride, double* out, uint8_t* ploidy, uint8_t* phased
+) ;
+
+/* Read the alleles of a selected variant from the file.  alleles receives at most max_alleles pointers
+ * to strings, and sizes their lengths; *number_of_alleles is set to the number of alleles of the variant.
+ * The strings are valid until the next call to this function for the same file. */
+BGEN_C_EXPORT bgen_status bgen_read_alleles(
+	bgen_file* file, size_t variant,
+	char const** alleles, size_t* sizes, size_t max_alleles, size_t* number_of_alleles
+) ;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,75 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef GENFILE_BGEN_CHECK_HPP
+#define GENFILE_BGEN_CHECK_HPP
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include <optional>
+#include <limits>
+#include "stdint.h"
+#include "genfile/bgen.hpp"
+#include "genfile/Buffer.hpp"
+
+// Functions used by check-bgen to check the structure of a bgen file.
+// Problems are returned rather than thrown, so that a damaged file can be described rather than rejected.
+namespace genfile {
+	namespace bgen {
+		// A problem found in a file, and a description of where in the file it was found.
+		struct FileProblem {
+			std::string where ;
+			std::string message ;
+		} ;
+
+		// The file size to give for streams whose size is not known.
+		int64_t const unknown_file_size = std::numeric_limits< int64_t >::max() ;
+
+		// A variant as read by read_checked_variant().
+		struct CheckedVariant {
+			std::size_t index ;
+			int64_t offset ;
+			int64_t size ;
+			std::string rsid ;
+			std::string chromosome ;
+			uint32_t position ;
+			std::vector< std::string > alleles ;
+			// The genotype data block, as returned by read_genotype_data_block().
+			Buffer data ;
+		} ;
+
+		// Return a description of the variant's location for use in a FileProblem.
+		std::string describe( CheckedVariant const& variant ) ;
+
+		// Read and check the offset, header block and sample identifier block of a file of the given size,
+		// leaving the context and offset filled in.  Return the problem if the file cannot be read further.
+		std::optional< FileProblem > check_header(
+			std::istream& stream,
+			int64_t const file_size,
+			Context* context,
+			uint32_t* offset
+		) ;
+
+		// Read the next variant, with its genotype data block, from a file of the given size.  The variant's
+		// index should be set by the caller.  Return the problem if the file cannot be read further; in particular,
+		// a file truncated at any point is reported as a problem rather than by throwing an exception.
+		// The stream is only read forwards, so may be a pipe; its size is then given as unknown_file_size.
+		std::optional< FileProblem > read_checked_variant(
+			std::istream& stream,
+			Context const& context,
+			int64_t const file_size,
+			CheckedVariant* variant
+		) ;
+
+		// Check the fields of an uncompressed layout 2 genotype data block that GenotypeDataBlock::initialise()
+		// reads, and that the block is the size they imply.  Return a description of the first problem found,
+		// or an empty string.
+		std::string check_layout2_block( Buffer const& buffer, Context const& context, std::size_t number_of_alleles ) ;
+	}
+}
+
+#endif
@@ -0,0 +1,164 @@
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef GENFILE_BGEN_COMPARE_HPP
+#define GENFILE_BGEN_COMPARE_HPP
+
+#include <vector>
+#include <string>
+#include <limits>
+#include <functional>
+#include <stdint.h>
+#include "types.hpp"
+#include "bgen.hpp"
+#include "ViewMerger.hpp"
+
+// Comparison of the genotype data of variants in two bgen files, as used by compare-bgen.
+
+namespace genfile {
+	namespace bgen {
+		// A variant found in both files, with its (compressed) genotype data block from each.
+		struct VariantPair {
+			std::string rsid ;
+			std::string chromosome ;
+			uint32_t position ;
+			std::vector< std::string > alleles ;
+			std::vector< byte_t > data[2] ;
+		} ;
+
+		// The comparison of one variant.
+		struct VariantResult {
+			VariantResult():
+				identical( false ),
+				compared( 0 ),
+				missing_in_one( 0 ),
+				concordant( 0 ),
+				r2( std::numeric_limits< double >::quiet_NaN() ),
+				max_difference( 0 )
+			{}
+
+			std::string rsid ;
+			std::string chromosome ;
+			uint32_t position ;
+			std::vector< std::string > alleles ;
+			// True if the genotype data blocks are byte-for-byte identical; the other fields are then not computed.
+			bool identical ;
+			// Number of samples non-missing in both files, and missing in exactly one.
+			std::size_t compared ;
+			std::size_t missing_in_one ;
+			// Number of compared samples with the same most likely genotype (or haplotypes, for phased data).
+			std::size_t concordant ;
+			// Squared correlation of dosages of the second allele, for biallelic variants.
+			double r2 ;
+			// Largest absolute difference between corresponding probabilities.
+			double max_difference ;
+		} ;
+
+		// Accumulates sums from which a squared correlation is computed.
+		struct CorrelationSums {
+			CorrelationSums(): n(0), x(0), y(0), xx(0), yy(0), xy(0) {}
+			void add( double a, double b ) {
+				++n ; x += a ; y += b ; xx += a*a ; yy += b*b ; xy += a*b ;
+			}
+			void add( CorrelationSums const& other ) {
+				n += other.n ; x += other.x ; y += other.y ; xx += other.xx ; yy += other.yy ; xy += other.xy ;
+			}
+			// Return the squared correlation, or NaN if either variable has zero variance.
+			double r2() const {
+				double const covariance = n*xy - x*y ;
+				double const denominator = ( n*xx - x*x ) * ( n*yy - y*y ) ;
+				return ( denominator > 0 ) ? ( covariance * covariance / denominator ) : std::numeric_limits< double >::quiet_NaN() ;
+			}
+			double n, x, y, xx, yy, xy ;
+		} ;
+
+		// Per-sample totals over variants.
+		struct SampleAccumulator {
+			SampleAccumulator( std::size_t number_of_samples ) ;
+			void add( SampleAccumulator const& other ) ;
+
+			std::vector< uint64_t > compared ;
+			std::vector< uint64_t > missing_in_one ;
+			std::vector< uint64_t > concordant ;
+			std::vector< CorrelationSums > dosage ;
+			std::vector< double > max_difference ;
+		} ;
+
+		// Setter storing the probabilities for each sample of a variant, using the parse_probability_data() API.
+		struct ProbabilityCollector {
+			void initialise( std::size_t number_of_samples, std::size_t number_of_alleles ) ;
+			bool set_sample( std::size_t i ) {
+				m_sample_i = i ;
+				return true ;
+			}
+			void set_number_of_entries( std::size_t, std::size_t, OrderType order_type, ValueType ) ;
+			void set_value( uint32_t, double value ) ;
+			void set_value( uint32_t, MissingValue ) ;
+			void finalise() {}
+
+			std::size_t number_of_alleles() const { return m_number_of_alleles ; }
+			bool missing( std::size_t i ) const { return m_missing[i] || m_begin[i+1] == m_begin[i] ; }
+			bool phased( std::size_t i ) const { return m_phased[i] ; }
+			std::size_t number_of_values( std::size_t i ) const { return m_begin[i+1] - m_begin[i] ; }
+			double const* values( std::size_t i ) const { return &m_values[0] + m_begin[i] ; }
+
+			// Return the expected count of the second allele for a biallelic variant.
+			double dosage( std::size_t i ) const ;
+
+		private:
+			std::size_t m_number_of_alleles ;
+			std::vector< double > m_values ;
+			std::vector< std::size_t > m_begin ;
+			std::vector< char > m_missing ;
+			std::vector< char > m_phased ;
+			std::size_t m_sample_i ;
+		} ;
+
+		// Return true if the most likely genotype (or, for phased data, each haplotype's most likely allele)
+		// is the same in the two sets of n values, which are in groups of group_size (one per haplotype for phased data).
+		bool have_same_calls( double const* x, double const* y, std::size_t n, std::size_t group_size ) ;
+
+		// Compares the genotype data for variant pairs from files with the given contexts.
+		// compare() is const and may be called concurrently from several threads.
+		struct Comparer {
+		public:
+			Comparer( Context const& context1, Context const& context2 ) ;
+
+			// Compare the given variants, adding per-sample results to the given accumulator if it is not null.
+			// Blocks are reported identical only if the files store genotype data in the same layout and compression.
+			std::vector< VariantResult > compare( std::vector< VariantPair > const& variants, SampleAccumulator* samples ) const ;
+
+		private:
+			Context const m_contexts[2] ;
+			bool const m_compare_blocks ;
+
+		private:
+			void compare(
+				ProbabilityCollector const& x,
+				ProbabilityCollector const& y,
+				VariantResult* result,
+				SampleAccumulator* samples
+			) const ;
+		} ;
+
+		struct PairingSummary {
+			PairingSummary(): number_of_pairs( 0 ), only_in{ 0, 0 } {}
+			std::size_t number_of_pairs ;
+			// Number of variants found only in each source.
+			std::size_t only_in[2] ;
+		} ;
+
+		// Read variants from a merger of two sources, pairing those with the same chromosome, position and alleles,
+		// and pass the pairs to the callback in chunks of at most chunk_size, in the order read.
+		// Duplicate variants in a source are paired in file order; any not paired count as found in only one source.
+		PairingSummary pair_variants(
+			ViewMerger& merger,
+			std::size_t chunk_size,
+			std::function< void( std::vector< VariantPair >&& chunk ) > callback
+		) ;
+	}
+}
+
+#endif
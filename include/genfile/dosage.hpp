@@ -0,0 +1,554 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef GENFILE_BGEN_DOSAGE_HPP
+#define GENFILE_BGEN_DOSAGE_HPP
+
+#include <vector>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <stdint.h>
+#include "types.hpp"
+#include "bgen.hpp"
+
+/*
+* This file contains bulk decoders that compute expected allele dosages directly
+* from BGEN genotype data blocks, writing one value per sample into a caller-supplied array.
+* Unlike the setter-based parse_probability_data() API these avoid a per-value callback,
+* and they are templated on the output value type so that compact representations
+* (float, 16-bit floats, or scaled 8-bit integers) can be produced directly.
+*/
+
+namespace genfile {
+	// 16-bit IEEE 754 half-precision floating point value.
+	// This is a storage type only; convert to float to do arithmetic.
+	struct float16_t {
+		static float16_t from_float( float value ) ;
+		static float16_t from_bits( uint16_t bits ) { float16_t result ; result.bits = bits ; return result ; }
+		float to_float() const ;
+		operator float() const { return to_float() ; }
+		uint16_t bits ;
+	} ;
+
+	// 16-bit 'brain' floating point value (the top 16 bits of an IEEE 754 float).
+	// This is a storage type only; convert to float to do arithmetic.
+	struct bfloat16_t {
+		static bfloat16_t from_float( float value ) ;
+		static bfloat16_t from_bits( uint16_t bits ) { bfloat16_t result ; result.bits = bits ; return result ; }
+		float to_float() const ;
+		operator float() const { return to_float() ; }
+		uint16_t bits ;
+	} ;
+
+	namespace bgen {
+		// DosageTraits< T > describes how an expected allele dosage is represented as a value of type T.
+		// Each specialisation provides:
+		// - T missing(): the value used for samples with missing data.
+		// - T from_double( double dosage ): conversion of a dosage value.
+		// - T from_ratio( uint64_t numerator, uint64_t denominator ): conversion of the dosage
+		// numerator/denominator.  This is used by decoders to produce values directly from the
+		// integers stored in the file; for integer T the conversion is exact (i.e. uses no floating point).
+		// - double to_double( T value ): conversion of a (non-missing) value back to a dosage.
+		template< typename T > struct DosageTraits ;
+
+		template<> struct DosageTraits< double > {
+			static double missing() { return std::numeric_limits< double >::quiet_NaN() ; }
+			static double from_double( double dosage ) { return dosage ; }
+			static double from_ratio( uint64_t numerator, uint64_t denominator ) { return double( numerator ) / double( denominator ) ; }
+			static double to_double( double value ) { return value ; }
+		} ;
+
+		template<> struct DosageTraits< float > {
+			static float missing() { return std::numeric_limits< float >::quiet_NaN() ; }
+			static float from_double( double dosage ) { return float( dosage ) ; }
+			static float from_ratio( uint64_t numerator, uint64_t denominator ) { return float( double( numerator ) / double( denominator )) ; }
+			static double to_double( float value ) { return value ; }
+		} ;
+
+		template<> struct DosageTraits< float16_t > {
+			static float16_t missing() { return float16_t::from_bits( 0x7E00 ) ; }
+			static float16_t from_double( double dosage ) { return float16_t::from_float( float( dosage )) ; }
+			static float16_t from_ratio( uint64_t numerator, uint64_t denominator ) { return from_double( double( numerator ) / double( denominator )) ; }
+			static double to_double( float16_t value ) { return value.to_float() ; }
+		} ;
+
+		template<> struct DosageTraits< bfloat16_t > {
+			static bfloat16_t missing() { return bfloat16_t::from_bits( 0x7FC0 ) ; }
+			static bfloat16_t from_double( double dosage ) { return bfloat16_t::from_float( float( dosage )) ; }
+			static bfloat16_t from_ratio( uint64_t numerator, uint64_t denominator ) { return from_double( double( numerator ) / double( denominator )) ; }
+			static double to_double( bfloat16_t value ) { return value.to_float() ; }
+		} ;
+
+		// 8-bit dosages are stored scaled so that 0 represents a dosage of 0 and 254 a dosage of 2,
+		// i.e. in steps of 1/127.  Larger dosages (only possible for ploidy > 2) are clamped to 254.
+		// 255 represents missing data.
+		template<> struct DosageTraits< uint8_t > {
+			enum { eScale = 127, eMaximum = 254, eMissing = 255 } ;
+			static uint8_t missing() { return eMissing ; }
+			static uint8_t from_double( double dosage ) {
+				double const scaled = dosage * eScale + 0.5 ;
+				return ( scaled >= eMaximum ) ? uint8_t( eMaximum ) : ( scaled <= 0.0 ) ? uint8_t( 0 ) : uint8_t( scaled ) ;
+			}
+			static uint8_t from_ratio( uint64_t numerator, uint64_t denominator ) {
+				// round( eScale * numerator / denominator ), computed in integers.
+				uint64_t const scaled = ( 2 * eScale * numerator + denominator ) / ( 2 * denominator ) ;
+				return uint8_t( std::min( scaled, uint64_t( eMaximum ) )) ;
+			}
+			static double to_double( uint8_t value ) { return double( value ) / eScale ; }
+		} ;
+
+		// Options controlling v12::compute_dosages().
+		struct DosageOptions {
+			DosageOptions():
+				allele( 1 ),
+				mean_impute( false ),
+				vectorise( true )
+			{}
+
+			// The (zero-based) index of the allele whose dosage is computed, e.g. 1 for the second allele.
+			uint32_t allele ;
+			// If true, samples with missing data are set to the mean dosage of the non-missing samples
+			// instead of DosageTraits< T >::missing().
+			bool mean_impute ;
+			// If true, vectorised table lookups are used where the CPU supports them.
+			// Results are identical either way; this exists mainly for testing and benchmarking.
+			bool vectorise ;
+		} ;
+
+		namespace v12 {
+			// Compute the expected dosage of an allele for each sample from the (uncompressed, unpacked)
+			// genotype data block given, writing pack.numberOfSamples values to the array pointed to by out.
+			// Samples with missing data are set to DosageTraits< T >::missing() unless options.mean_impute is set.
+			// Return the number of samples with non-missing data.
+			//
+			// For unphased data the dosage is the expected count of the allele over genotypes;
+			// for phased data it is the sum over haplotypes of the probability of the allele.
+			//
+			// Diploid data stored with 1, 2, 4 or 8 bits per probability is decoded by table lookup,
+			// using tables that are computed on first use and shared between threads.  Other data is
+			// decoded directly from the packed bits.  Multiallelic data is decoded through
+			// parse_probability_data(), computing the expected count of options.allele.
+			//
+			// std::invalid_argument is thrown if options.allele is not less than the number of alleles.
+			template< typename T >
+			std::size_t compute_dosages( GenotypeDataBlock const& pack, T* out, DosageOptions const& options = DosageOptions() ) ;
+
+			// Compute the expected dosage of the second allele, as for compute_dosages() with default options.
+			template< typename T >
+			void parse_dosage_data( GenotypeDataBlock const& pack, T* out ) ;
+		}
+
+		// Compute dosages from an uncompressed genotype data block of any layout, as for v12::parse_dosage_data().
+		// out must point to at least context.number_of_samples values.
+		template< typename T >
+		void parse_dosage_data(
+			byte_t const* buffer,
+			byte_t const* const end,
+			Context const& context,
+			T* out
+		) ;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// IMPLEMENTATION
+///////////////////////////////////////////////////////////////////////////////////////////
+
+namespace genfile {
+	namespace bgen {
+		namespace impl {
+			// Return the number of copies of the given allele in each unphased genotype of the given ploidy,
+			// in the order genotypes are stored.  This is colex order of the nondecreasing sequences
+			// a_0 <= a_1 <= ... of alleles, in which the genotype a has index sum_i C( a_i + i, i + 1 ).
+			inline std::vector< uint32_t > compute_genotype_allele_counts( uint32_t ploidy, uint32_t number_of_alleles, uint32_t allele ) {
+				std::vector< uint32_t > result( bgen::impl::number_of_unphased_genotypes( ploidy, number_of_alleles ), 0 ) ;
+				std::vector< uint32_t > calls( ploidy, 0 ) ;
+				while( true ) {
+					uint64_t index = 0 ;
+					for( uint32_t i = 0; i < ploidy; ++i ) {
+						index += bgen::impl::n_choose_k< uint64_t >( calls[i] + i, i + 1 ) ;
+					}
+					result[ index ] = uint32_t( std::count( calls.begin(), calls.end(), allele )) ;
+					// Move to the next genotype by incrementing the first call that can be,
+					// resetting the calls before it.
+					uint32_t i = 0 ;
+					for( ; i < ploidy && calls[i] == (( i + 1 < ploidy ) ? calls[i+1] : ( number_of_alleles - 1 )); ++i ) {}
+					if( i == ploidy ) {
+						break ;
+					}
+					++calls[i] ;
+					std::fill( calls.begin(), calls.begin() + i, 0 ) ;
+				}
+				return result ;
+			}
+
+			// Setter object that computes dosages via the generic parse_probability_data() API.
+			// This handles data of any layout, ploidy and number of alleles, and is used where no faster path is available.
+			template< typename T >
+			struct DosageSetter {
+				DosageSetter( T* out, uint32_t allele = 1 ):
+					m_out( out ),
+					m_allele( allele ),
+					m_number_of_alleles(0),
+					m_sample_i(0),
+					m_number_of_entries(0),
+					m_phased( false ),
+					m_allele_counts(0),
+					m_dosage(0.0)
+				{}
+
+				void initialise( std::size_t number_of_samples, std::size_t number_of_alleles ) {
+					if( m_allele >= number_of_alleles ) {
+						throw std::invalid_argument( "allele=" + std::to_string( m_allele ) + " (expected less than number_of_alleles=" + std::to_string( number_of_alleles ) + ")" ) ;
+					}
+					m_number_of_alleles = uint32_t( number_of_alleles ) ;
+					m_genotype_allele_counts.clear() ;
+				}
+
+				bool set_sample( std::size_t i ) {
+					m_sample_i = i ;
+					return true ;
+				}
+
+				void set_number_of_entries(
+					std::size_t ploidy,
+					std::size_t number_of_entries,
+					OrderType order_type,
+					ValueType value_type
+				) {
+					m_number_of_entries = number_of_entries ;
+					m_phased = ( order_type == ePerPhasedHaplotypePerAllele ) ;
+					m_dosage = 0.0 ;
+					if( !m_phased ) {
+						// Allele counts are computed once for each ploidy seen.
+						if( ploidy >= m_genotype_allele_counts.size() ) {
+							m_genotype_allele_counts.resize( ploidy + 1 ) ;
+						}
+						std::vector< uint32_t >& counts = m_genotype_allele_counts[ ploidy ] ;
+						if( counts.empty() ) {
+							counts = compute_genotype_allele_counts( uint32_t( ploidy ), m_number_of_alleles, m_allele ) ;
+						}
+						m_allele_counts = &counts[0] ;
+					}
+					if( number_of_entries == 0 ) {
+						m_out[ m_sample_i ] = DosageTraits< T >::from_double( 0.0 ) ;
+					}
+				}
+
+				void set_value( uint32_t entry_i, double value ) {
+					// Phased entries hold the probability of each allele on each haplotype in turn.
+					if( m_phased ) {
+						m_dosage += ( entry_i % m_number_of_alleles == m_allele ) ? value : 0.0 ;
+					} else {
+						m_dosage += m_allele_counts[ entry_i ] * value ;
+					}
+					if( entry_i + 1 == m_number_of_entries ) {
+						m_out[ m_sample_i ] = DosageTraits< T >::from_double( m_dosage ) ;
+					}
+				}
+
+				void set_value( uint32_t entry_i, genfile::MissingValue ) {
+					if( entry_i + 1 == m_number_of_entries ) {
+						m_out[ m_sample_i ] = DosageTraits< T >::missing() ;
+					}
+				}
+
+			private:
+				T* m_out ;
+				uint32_t const m_allele ;
+				uint32_t m_number_of_alleles ;
+				std::size_t m_sample_i ;
+				std::size_t m_number_of_entries ;
+				bool m_phased ;
+				std::vector< std::vector< uint32_t > > m_genotype_allele_counts ;
+				uint32_t const* m_allele_counts ;
+				double m_dosage ;
+			} ;
+		}
+
+		namespace v12 {
+			namespace impl {
+				// Bit parser returning the stored integer values rather than probabilities.
+				struct IntegerBitParser {
+					IntegerBitParser(
+						byte_t const* buffer,
+						byte_t const* const end,
+						int const bits
+					):
+						m_buffer( buffer ),
+						m_end( end ),
+						m_bits( bits ),
+						m_bitMask( uint64_t(0xFFFFFFFFFFFFFFFF) >> ( 64 - bits )),
+						m_shift(0)
+					{
+						assert( bits > 0 && bits <= 32 ) ;
+					}
+
+					// check we can consume n more values
+					bool check( std::size_t n ) const {
+						std::size_t const bitsNeeded = n * m_bits + m_shift ;
+						return ( m_buffer + (bitsNeeded + 7)/8 ) <= m_end ;
+					}
+
+					uint32_t next() {
+						// Read up to 8 bytes without reading past the end of the buffer.
+						uint64_t data = 0 ;
+						std::ptrdiff_t const available = std::min( std::ptrdiff_t( 8 ), m_end - m_buffer ) ;
+						if( available > 0 ) {
+							std::memcpy( &data, m_buffer, available ) ;
+						}
+						uint32_t const value = uint32_t(( data >> m_shift ) & m_bitMask ) ;
+						m_shift += m_bits ;
+						if( m_shift > 31 ) {
+							m_buffer += 4 ;
+							m_shift -= 32 ;
+						}
+						return value ;
+					}
+
+					uint64_t maximum() const { return m_bitMask ; }
+
+				private:
+					byte_t const* m_buffer ;
+					byte_t const* const m_end ;
+					int const m_bits ;
+					uint64_t const m_bitMask ;
+					int m_shift ;
+				} ;
+
+				// Vectorised table lookups, defined in dosage.cpp.
+				// These look up dosages for a prefix of the n samples whose keys (of key_bytes = 1 or 2
+				// bytes each) are stored consecutively from keys, and return the number of samples processed.
+				// This is zero if no vectorised implementation is available for T on this CPU.
+				std::size_t gather_dosages( float const* table, byte_t const* keys, std::size_t key_bytes, std::size_t n, float* out ) ;
+				std::size_t gather_dosages( double const* table, byte_t const* keys, std::size_t key_bytes, std::size_t n, double* out ) ;
+				template< typename T >
+				std::size_t gather_dosages( T const*, byte_t const*, std::size_t, std::size_t, T* ) { return 0 ; }
+
+				// Compute the dosage of a diploid biallelic sample with the given stored values.
+				template< typename T >
+				T compute_diploid_dosage( uint64_t v0, uint64_t v1, uint64_t max, bool phased, uint32_t allele ) {
+					// Unphased: v0 = P(AA), v1 = P(AB), so the first allele count is (2*v0 + v1)/max.
+					// Phased: v0 and v1 are P(A) on each haplotype, so the first allele count is (v0 + v1)/max.
+					// Values that overflow the simplex do not occur in valid data; they map to missing.
+					if( !phased && v0 + v1 > max ) {
+						return DosageTraits< T >::missing() ;
+					}
+					uint64_t const first = phased ? ( v0 + v1 ) : ( 2*v0 + v1 ) ;
+					return DosageTraits< T >::from_ratio( ( allele == 0 ) ? first : ( 2*max - first ), max ) ;
+				}
+
+				// Tables of dosages for diploid biallelic samples stored with 1, 2, 4 or 8 bits per probability.
+				// For 4 and 8 bits the table is indexed by the one or two bytes encoding a sample, read as a
+				// little-endian integer.  For 1 and 2 bits several samples share each byte, and the table
+				// holds 4/bits consecutive values (one per sample) for each possible byte.
+				template< typename T >
+				std::vector< T > compute_diploid_dosage_table( int bits, bool phased, uint32_t allele ) {
+					assert( bits == 1 || bits == 2 || bits == 4 || bits == 8 ) ;
+					uint32_t const max = ( 1u << bits ) - 1 ;
+					uint32_t const sample_mask = ( 1u << ( 2 * bits )) - 1 ;
+					std::size_t const samples_per_key = ( bits < 4 ) ? ( 4 / bits ) : 1 ;
+					std::size_t const number_of_keys = ( bits < 4 ) ? 256 : ( 1u << ( 2 * bits )) ;
+					std::vector< T > result( number_of_keys * samples_per_key ) ;
+					for( uint32_t key = 0; key < number_of_keys; ++key ) {
+						for( std::size_t k = 0; k < samples_per_key; ++k ) {
+							uint32_t const sample_key = ( key >> ( 2 * bits * k )) & sample_mask ;
+							result[ key * samples_per_key + k ] = compute_diploid_dosage< T >(
+								sample_key & max, sample_key >> bits, max, phased, allele
+							) ;
+						}
+					}
+					return result ;
+				}
+
+				template< typename T, int bits, bool phased, uint32_t allele >
+				T const* get_diploid_dosage_table() {
+					// Function-local statics are initialised once, in a thread-safe way.
+					static std::vector< T > const table = compute_diploid_dosage_table< T >( bits, phased, allele ) ;
+					return &table[0] ;
+				}
+
+				template< typename T, int bits >
+				T const* get_diploid_dosage_table( bool phased, uint32_t allele ) {
+					if( phased ) {
+						return ( allele == 0 ) ? get_diploid_dosage_table< T, bits, true, 0 >() : get_diploid_dosage_table< T, bits, true, 1 >() ;
+					} else {
+						return ( allele == 0 ) ? get_diploid_dosage_table< T, bits, false, 0 >() : get_diploid_dosage_table< T, bits, false, 1 >() ;
+					}
+				}
+
+				template< typename T >
+				T const* get_diploid_dosage_table( int bits, bool phased, uint32_t allele ) {
+					switch( bits ) {
+						case 1: return get_diploid_dosage_table< T, 1 >( phased, allele ) ;
+						case 2: return get_diploid_dosage_table< T, 2 >( phased, allele ) ;
+						case 4: return get_diploid_dosage_table< T, 4 >( phased, allele ) ;
+						case 8: return get_diploid_dosage_table< T, 8 >( phased, allele ) ;
+						default: assert(0) ; return 0 ;
+					}
+				}
+
+				inline bool has_diploid_dosage_table( int bits ) {
+					return bits == 1 || bits == 2 || bits == 4 || bits == 8 ;
+				}
+
+				// Decode diploid biallelic data by table lookup.  Missing samples are not handled here.
+				template< typename T >
+				void parse_dosage_data_diploid_biallelic_table( GenotypeDataBlock const& pack, T* out, DosageOptions const& options ) {
+					std::size_t const N = pack.numberOfSamples ;
+					if( pack.end < pack.buffer + ( 2 * pack.bits * N + 7 ) / 8 ) {
+						throw BGenError() ;
+					}
+					T const* table = get_diploid_dosage_table< T >( pack.bits, pack.phased, options.allele ) ;
+					if( pack.bits == 8 ) {
+						std::size_t i = options.vectorise ? gather_dosages( table, pack.buffer, 2, N, out ) : 0 ;
+						for( byte_t const* buffer = pack.buffer + 2*i; i < N; ++i, buffer += 2 ) {
+							uint16_t key ;
+							std::memcpy( &key, buffer, 2 ) ;
+							out[i] = table[ key ] ;
+						}
+					} else if( pack.bits == 4 ) {
+						std::size_t i = options.vectorise ? gather_dosages( table, pack.buffer, 1, N, out ) : 0 ;
+						for( ; i < N; ++i ) {
+							out[i] = table[ pack.buffer[i] ] ;
+						}
+					} else {
+						std::size_t const samples_per_byte = 4 / pack.bits ;
+						std::size_t i = 0 ;
+						byte_t const* buffer = pack.buffer ;
+						for( ; i + samples_per_byte <= N; i += samples_per_byte, ++buffer ) {
+							T const* values = table + std::size_t( *buffer ) * samples_per_byte ;
+							std::copy( values, values + samples_per_byte, out + i ) ;
+						}
+						if( i < N ) {
+							T const* values = table + std::size_t( *buffer ) * samples_per_byte ;
+							std::copy( values, values + ( N - i ), out + i ) ;
+						}
+					}
+				}
+
+				template< typename T >
+				void parse_dosage_data_diploid_biallelic( GenotypeDataBlock const& pack, T* out, uint32_t allele ) {
+					IntegerBitParser parser( pack.buffer, pack.end, pack.bits ) ;
+					uint64_t const max = parser.maximum() ;
+					if( !parser.check( 2 * std::size_t( pack.numberOfSamples ))) {
+						throw BGenError() ;
+					}
+					for( uint32_t i = 0; i < pack.numberOfSamples; ++i ) {
+						uint64_t const v0 = parser.next() ;
+						uint64_t const v1 = parser.next() ;
+						// Overflowing values (which do not occur in valid data) are clamped.
+						uint64_t const first = std::min( pack.phased ? ( v0 + v1 ) : ( 2*v0 + v1 ), 2*max ) ;
+						out[i] = DosageTraits< T >::from_ratio( ( allele == 0 ) ? first : ( 2*max - first ), max ) ;
+					}
+				}
+
+				template< typename T >
+				void parse_dosage_data_biallelic( GenotypeDataBlock const& pack, T* out, uint32_t allele ) {
+					IntegerBitParser parser( pack.buffer, pack.end, pack.bits ) ;
+					uint64_t const max = parser.maximum() ;
+					for( uint32_t i = 0; i < pack.numberOfSamples; ++i ) {
+						uint32_t const ploidy = uint32_t( pack.ploidy[i] & 0x3F ) ;
+						// For biallelic data, both phased and unphased samples store one value per chromosome.
+						if( !parser.check( ploidy )) {
+							throw BGenError() ;
+						}
+						uint64_t numerator = 0 ;
+						if( pack.phased ) {
+							for( uint32_t h = 0; h < ploidy; ++h ) {
+								numerator += max - std::min( uint64_t( parser.next() ), max ) ;
+							}
+						} else {
+							// Stored values are probabilities of genotypes with 0, 1, ..., ploidy-1 copies
+							// of the second allele; the last genotype's probability is implied.
+							uint64_t sum = 0 ;
+							for( uint32_t k = 0; k < ploidy; ++k ) {
+								uint64_t const value = parser.next() ;
+								numerator += k * value ;
+								sum += value ;
+							}
+							numerator += ploidy * ( max - std::min( sum, max ) ) ;
+						}
+						if( allele == 0 ) {
+							numerator = ploidy * max - std::min( numerator, ploidy * max ) ;
+						}
+						out[i] = DosageTraits< T >::from_ratio( numerator, max ) ;
+					}
+				}
+			}
+
+			template< typename T >
+			std::size_t compute_dosages( GenotypeDataBlock const& pack, T* out, DosageOptions const& options ) {
+				if( options.allele >= pack.numberOfAlleles ) {
+					throw std::invalid_argument( "options.allele=" + std::to_string( options.allele ) + " (expected less than numberOfAlleles=" + std::to_string( pack.numberOfAlleles ) + ")" ) ;
+				}
+				if( pack.bits == 0 || pack.bits > 32 ) {
+					throw BGenError() ;
+				}
+				if( pack.numberOfAlleles != 2 ) {
+					bgen::impl::DosageSetter< T > setter( out, options.allele ) ;
+					parse_probability_data( pack, setter ) ;
+				} else if( pack.ploidyExtent[0] == 2 && pack.ploidyExtent[1] == 2 ) {
+					if( impl::has_diploid_dosage_table( pack.bits ) ) {
+						impl::parse_dosage_data_diploid_biallelic_table( pack, out, options ) ;
+					} else {
+						impl::parse_dosage_data_diploid_biallelic( pack, out, options.allele ) ;
+					}
+				} else {
+					impl::parse_dosage_data_biallelic( pack, out, options.allele ) ;
+				}
+
+				// Decoders above ignore missingness, which we deal with here.
+				T const missing = DosageTraits< T >::missing() ;
+				std::size_t number_missing = 0 ;
+				double sum = 0.0 ;
+				for( uint32_t i = 0; i < pack.numberOfSamples; ++i ) {
+					if( pack.ploidy[i] & 0x80 ) {
+						out[i] = missing ;
+						++number_missing ;
+					} else if( options.mean_impute ) {
+						sum += DosageTraits< T >::to_double( out[i] ) ;
+					}
+				}
+				std::size_t const number_non_missing = pack.numberOfSamples - number_missing ;
+				if( options.mean_impute && number_missing > 0 && number_non_missing > 0 ) {
+					T const mean = DosageTraits< T >::from_double( sum / number_non_missing ) ;
+					for( uint32_t i = 0; i < pack.numberOfSamples; ++i ) {
+						if( pack.ploidy[i] & 0x80 ) {
+							out[i] = mean ;
+						}
+					}
+				}
+				return number_non_missing ;
+			}
+
+			template< typename T >
+			void parse_dosage_data( GenotypeDataBlock const& pack, T* out ) {
+				compute_dosages( pack, out ) ;
+			}
+		}
+
+		template< typename T >
+		void parse_dosage_data(
+			byte_t const* buffer,
+			byte_t const* const end,
+			Context const& context,
+			T* out
+		) {
+			if( (context.flags & e_Layout) == e_Layout2 ) {
+				v12::parse_dosage_data( v12::GenotypeDataBlock( context, buffer, end ), out ) ;
+			} else {
+				impl::DosageSetter< T > setter( out ) ;
+				parse_probability_data( buffer, end, context, setter ) ;
+			}
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,38 @@
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef GENFILE_GEN_HPP
+#define GENFILE_GEN_HPP
+
+#include <string>
+#include <vector>
+#include <utility>
+
+// Parsing of the fields of Oxford GEN and SAMPLE files, as used by gen2bgen.
+namespace genfile {
+	namespace gen {
+		// A range of characters [first, second) within a line.
+		typedef std::pair< char const*, char const* > Slice ;
+
+		// Return true if c separates fields.  This includes '\r', so that files with
+		// Windows (CRLF) line endings are read correctly.
+		inline bool is_space( char c ) {
+			return c == ' ' || c == '\t' || c == '\r' ;
+		}
+
+		// Split the given line on runs of whitespace.
+		void split_whitespace( Slice const& line, std::vector< Slice >* result ) ;
+
+		inline std::string to_string( Slice const& slice ) {
+			return std::string( slice.first, slice.second ) ;
+		}
+
+		// Parse a probability, which must be a finite non-negative number.
+		// Throws std::invalid_argument, with a message describing the value, if it is not.
+		double parse_probability( Slice const& slice ) ;
+	}
+}
+
+#endif
@@ -0,0 +1,29 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef GENFILE_HASH_HPP
+#define GENFILE_HASH_HPP
+
+#include <stdint.h>
+#include "types.hpp"
+
+namespace genfile {
+	// Return the 64-bit xxHash (XXH64) of the data in [begin, end) with the given seed.
+	// This is fast and well-distributed, but is not a cryptographic hash.
+	uint64_t xxh64( byte_t const* begin, byte_t const* const end, uint64_t seed = 0 ) ;
+
+	namespace bgen {
+		// Return the content hash of a genotype data block, as returned by read_genotype_data_block()
+		// (i.e. without its leading length field, if any).  Blocks with the same content hash can be
+		// assumed to be identical, so for files with the same layout, compression and samples, they
+		// hold the same data.
+		inline uint64_t content_hash( byte_t const* begin, byte_t const* const end ) {
+			return xxh64( begin, end ) ;
+		}
+	}
+}
+
+#endif
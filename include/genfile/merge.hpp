@@ -0,0 +1,48 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef GENFILE_BGEN_MERGE_HPP
+#define GENFILE_BGEN_MERGE_HPP
+
+#include <vector>
+#include <utility>
+#include "types.hpp"
+#include "bgen.hpp"
+
+namespace genfile {
+	namespace bgen {
+		// Compress an uncompressed layout 2 genotype data block according to the given context, and return the
+		// result exactly as it should appear in the file (i.e. as returned by GenotypeDataBlockWriter::repr()).
+		// This is the inverse of read_genotype_data_block() followed by uncompress_probability_data().
+		// The result is stored in the given buffer.
+		std::pair< byte_t const*, byte_t const* > compress_probability_data(
+			Context const& context,
+			byte_t const* buffer,
+			byte_t const* const end,
+			std::vector< byte_t >* result
+		) ;
+
+		namespace v12 {
+			// Combine the uncompressed genotype data blocks for one variant in several files with different samples,
+			// into a single uncompressed block in which samples of the first block are followed by those of the second,
+			// and so on.  The result is written to the given buffer, which is resized to fit.
+			//
+			// Probabilities are stored with the given number of bits.  If every block already has this number
+			// of bits, packed data is copied across bitwise without decoding; otherwise probabilities are decoded
+			// and re-encoded with the usual rounding.
+			//
+			// Throws std::invalid_argument if the blocks do not have the same number of alleles, or if some blocks
+			// are phased and some are not.
+			void merge_samples(
+				std::vector< GenotypeDataBlock const* > const& blocks,
+				int const number_of_bits,
+				std::vector< byte_t >* result
+			) ;
+		}
+	}
+}
+
+#endif
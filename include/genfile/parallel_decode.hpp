@@ -0,0 +1,134 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef GENFILE_BGEN_PARALLEL_DECODE_HPP
+#define GENFILE_BGEN_PARALLEL_DECODE_HPP
+
+#include <vector>
+#include <algorithm>
+#include "types.hpp"
+#include "bgen.hpp"
+#include "dosage.hpp"
+#include "ThreadPool.hpp"
+
+/*
+* This file contains versions of the layout 2 decoders that split a single genotype data block
+* into ranges of samples (see v12::split_by_samples()) and decode the ranges on a ThreadPool.
+* This reduces the time taken to decode one variant in files with very many samples.
+* The pool must not be one whose threads call these functions, since they wait for the tasks
+* they submit.
+*/
+
+namespace genfile {
+	namespace bgen {
+		namespace v12 {
+			// Decoding a range of samples has some fixed cost, so ranges are at least this large by default.
+			std::size_t const default_min_samples_per_range = 16384 ;
+
+			// Split pack into ranges for decoding on the given pool: at most one per thread, and each
+			// (if possible) of at least min_samples_per_range samples.
+			inline std::vector< SampleRange > split_by_samples(
+				GenotypeDataBlock const& pack,
+				ThreadPool const& pool,
+				std::size_t min_samples_per_range = default_min_samples_per_range
+			) {
+				std::size_t const number_of_ranges = std::min(
+					pool.number_of_threads(),
+					pack.numberOfSamples / std::max( min_samples_per_range, std::size_t( 1 ))
+				) ;
+				return split_by_samples( pack, number_of_ranges ) ;
+			}
+
+			// Parse the probability data of pack on the given pool.  make_setter( range ) is called once
+			// for each range of samples, on the calling thread, and must return a setter for those samples;
+			// these receive sample indices counted from range.begin, and are then used on different threads
+			// at once, so must write to disjoint data.
+			template< typename SetterFactory >
+			void parse_probability_data(
+				GenotypeDataBlock const& pack,
+				SetterFactory make_setter,
+				ThreadPool& pool,
+				std::size_t min_samples_per_range = default_min_samples_per_range
+			) {
+				std::vector< SampleRange > const ranges = split_by_samples( pack, pool, min_samples_per_range ) ;
+				typedef decltype( make_setter( ranges[0] )) Setter ;
+				std::vector< Setter > setters ;
+				setters.reserve( ranges.size() ) ;
+				for( std::size_t i = 0; i < ranges.size(); ++i ) {
+					setters.push_back( make_setter( ranges[i] )) ;
+				}
+				if( ranges.size() == 1 ) {
+					parse_probability_data( pack, setters[0] ) ;
+					return ;
+				}
+				pool.parallel_for(
+					0, ranges.size(),
+					[&pack,&ranges,&setters]( std::size_t i ) {
+						GenotypeDataBlock range ;
+						range.initialise( pack, ranges[i] ) ;
+						parse_probability_data( range, setters[i] ) ;
+					}
+				) ;
+			}
+
+			// Compute dosages as compute_dosages( pack, out, options ) does, on the given pool.
+			// With options.mean_impute the mean is summed in a different order, so it may differ
+			// from that of the single-threaded version by rounding.
+			template< typename T >
+			std::size_t compute_dosages(
+				GenotypeDataBlock const& pack,
+				T* out,
+				DosageOptions const& options,
+				ThreadPool& pool,
+				std::size_t min_samples_per_range = default_min_samples_per_range
+			) {
+				std::vector< SampleRange > const ranges = split_by_samples( pack, pool, min_samples_per_range ) ;
+				if( ranges.size() == 1 ) {
+					return compute_dosages( pack, out, options ) ;
+				}
+				// Ranges are decoded without imputation, which needs the mean over all ranges.
+				DosageOptions range_options = options ;
+				range_options.mean_impute = false ;
+				std::vector< std::size_t > number_non_missing( ranges.size(), 0 ) ;
+				std::vector< double > sums( ranges.size(), 0.0 ) ;
+				pool.parallel_for(
+					0, ranges.size(),
+					[&]( std::size_t i ) {
+						GenotypeDataBlock range ;
+						range.initialise( pack, ranges[i] ) ;
+						T* range_out = out + ranges[i].begin ;
+						number_non_missing[i] = compute_dosages( range, range_out, range_options ) ;
+						if( options.mean_impute ) {
+							for( uint32_t j = 0; j < range.numberOfSamples; ++j ) {
+								if( !( range.ploidy[j] & 0x80 )) {
+									sums[i] += DosageTraits< T >::to_double( range_out[j] ) ;
+								}
+							}
+						}
+					}
+				) ;
+
+				std::size_t total_non_missing = 0 ;
+				double sum = 0.0 ;
+				for( std::size_t i = 0; i < ranges.size(); ++i ) {
+					total_non_missing += number_non_missing[i] ;
+					sum += sums[i] ;
+				}
+				if( options.mean_impute && total_non_missing < pack.numberOfSamples && total_non_missing > 0 ) {
+					T const mean = DosageTraits< T >::from_double( sum / total_non_missing ) ;
+					for( uint32_t i = 0; i < pack.numberOfSamples; ++i ) {
+						if( pack.ploidy[i] & 0x80 ) {
+							out[i] = mean ;
+						}
+					}
+				}
+				return total_non_missing ;
+			}
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,34 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef GENFILE_BGEN_QUERY_SPEC_HPP
+#define GENFILE_BGEN_QUERY_SPEC_HPP
+
+#include <vector>
+#include <string>
+#include "IndexQuery.hpp"
+
+// Parsing of variant selections given on the command line or in requests, as used by
+// bgenix, catalog-bgen, transpose-bgen and serve-bgen.
+// All functions throw std::invalid_argument, with a message suitable for users, if a
+// specification is malformed.
+
+namespace genfile {
+	namespace bgen {
+		// Return the given identifiers, with any that name an existing file replaced by the
+		// whitespace-separated identifiers in that file.  The result is sorted, without duplicates.
+		std::vector< std::string > collect_unique_ids( std::vector< std::string > const& ids_or_filenames ) ;
+
+		// Parse a range of the form <chr>:<pos1>-<pos2>, including both endpoints.
+		// Either position may be omitted to mean the start or end of the chromosome.
+		IndexQuery::GenomicRange parse_range( std::string const& spec ) ;
+
+		// Parse a position of the form <chr>:<pos> or <chr>:<pos>:<allele1>:<allele2>.
+		IndexQuery::VariantPosition parse_position( std::string const& spec ) ;
+	}
+}
+
+#endif
@@ -0,0 +1,104 @@
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef GENFILE_BGEN_VARIANT_FILTER_HPP
+#define GENFILE_BGEN_VARIANT_FILTER_HPP
+
+#include <vector>
+#include <optional>
+#include <limits>
+#include <stdint.h>
+#include "types.hpp"
+#include "bgen.hpp"
+#include "VariantBatch.hpp"
+
+// Per-variant summary statistics and the filter applied to them by bgenix -og.
+
+namespace genfile {
+	namespace bgen {
+		// Summary statistics for a biallelic variant, computed from expected allele counts.
+		// Statistics that cannot be computed (e.g. for multiallelic variants, or if all samples are missing) are NaN.
+		struct VariantStats {
+			VariantStats():
+				allele_frequency( std::numeric_limits< double >::quiet_NaN() ),
+				info( std::numeric_limits< double >::quiet_NaN() ),
+				missing_rate( std::numeric_limits< double >::quiet_NaN() )
+			{}
+
+			// Frequency of the second allele.
+			double allele_frequency ;
+			// IMPUTE info measure, i.e. one minus the ratio of the expected variance of allele counts given the data
+			// to the variance expected under Hardy-Weinberg equilibrium.  Monomorphic variants have info 1.
+			double info ;
+			// Proportion of samples with missing data.
+			double missing_rate ;
+		} ;
+
+		// Setter object that computes VariantStats using the parse_probability_data() API.
+		// This handles data of any ploidy, phased or unphased.
+		struct VariantStatsSetter {
+			VariantStatsSetter( VariantStats* result ):
+				m_result( result )
+			{}
+
+			void initialise( std::size_t number_of_samples, std::size_t number_of_alleles ) ;
+			bool set_sample( std::size_t ) { return m_biallelic ; }
+			void set_number_of_entries(
+				std::size_t ploidy,
+				std::size_t number_of_entries,
+				genfile::OrderType order_type,
+				genfile::ValueType
+			) ;
+			void set_value( uint32_t entry_i, double value ) ;
+			void set_value( uint32_t entry_i, genfile::MissingValue ) ;
+			void finalise() ;
+
+		private:
+			VariantStats* m_result ;
+			std::size_t m_number_of_samples ;
+			bool m_biallelic ;
+			std::size_t m_number_of_missing_samples ;
+			std::size_t m_total_ploidy ;
+			double m_total_dosage ;
+			double m_total_variance ;
+			std::size_t m_ploidy ;
+			std::size_t m_number_of_entries ;
+			bool m_phased ;
+			double m_dosage ;
+			double m_second_moment ;
+		} ;
+
+		// Thresholds applied by the bgenix -og variant filter options.
+		struct VariantFilter {
+			std::optional< double > min_maf ;
+			std::optional< double > min_info ;
+			std::optional< double > max_missing_rate ;
+
+			bool needs_stats() const {
+				return min_maf || min_info || max_missing_rate ;
+			}
+
+			// Return true if a variant with the given statistics passes all thresholds.
+			// NaN statistics fail any threshold that uses them.
+			bool passes( VariantStats const& stats ) const ;
+		} ;
+
+		// A batch of variants together with a flag for each indicating whether it passes the filter.
+		struct FilteredVariantBatch {
+			VariantBatch batch ;
+			std::vector< char > included ;
+		} ;
+
+		// Apply the filter to each variant in a batch.  If the filter needs statistics,
+		// the batch must have been read with genotype data blocks.
+		FilteredVariantBatch filter_variant_batch(
+			VariantBatch&& batch,
+			Context const& context,
+			VariantFilter const& filter
+		) ;
+	}
+}
+
+#endif
@@ -0,0 +1,82 @@
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef GENFILE_BGEN_VARIANT_LIST_HPP
+#define GENFILE_BGEN_VARIANT_LIST_HPP
+
+#include <iosfwd>
+#include <vector>
+#include <string>
+#include <functional>
+#include <stdint.h>
+#include "VariantBatch.hpp"
+#include "IndexQuery.hpp"
+#include "ThreadPool.hpp"
+
+// Formatting of lists of variants, as output by bgenix -list.
+// Lists are output as tab-delimited text or in a binary columnar format.  The columnar format has all
+// integers little-endian: an 8-byte magic number "BGXLIST1", a 4-byte column count, and for each column
+// a 1-byte type (1 = uint16, 2 = uint32, 3 = int64, 4 = string), a 4-byte name length and the name.
+// Blocks of variants follow, each consisting of a 4-byte variant count N and then, for each column,
+// N values; string columns hold N 4-byte lengths followed by the string data.  A block with N = 0 ends the file.
+
+namespace genfile {
+	namespace bgen {
+		// Fields that can be listed.
+		enum ListField {
+			eAlternateIds, eRsid, eChromosome, ePosition, eNumberOfAlleles,
+			eFirstAllele, eAlternativeAlleles, eFileStartPosition, eSizeInBytes
+		} ;
+
+		enum ListFormat { eTextList, eColumnarList } ;
+
+		struct ListFieldSpec {
+			char const* name ;
+			char const* short_name ;
+			ListField field ;
+			// Column type code in columnar output.
+			uint8_t type ;
+		} ;
+
+		// Parse a comma-separated list of field names, each given in full or in short form.
+		// If from_index is true, fields that are not recorded in the index (alternate_ids and
+		// alternative_alleles) are rejected.
+		// Throws std::invalid_argument, with a message suitable for users, if a field is not recognised or available.
+		std::vector< ListFieldSpec > parse_list_fields( std::string const& spec, bool from_index = false ) ;
+
+		// Return the fields listed by default, which are all fields available in the index if from_index is true.
+		std::vector< ListFieldSpec > default_list_fields( bool from_index = false ) ;
+
+		// Parse the name of a list format, "text" or "columnar".
+		// Throws std::invalid_argument if the name is not recognised.
+		ListFormat parse_list_format( std::string const& name ) ;
+
+		// Format the header line of text output, giving the field names.
+		std::string format_list_text_header( std::vector< ListFieldSpec > const& fields ) ;
+		// Format a batch of variants as tab-delimited lines.  Empty alternate_ids and rsid fields are output as ".".
+		std::string format_list_text( VariantBatch const& batch, std::vector< ListFieldSpec > const& fields ) ;
+
+		// Format the header of columnar output.
+		std::string format_list_columnar_header( std::vector< ListFieldSpec > const& fields ) ;
+		// Format a batch of variants as a block of columnar output.
+		std::string format_list_columnar( VariantBatch const& batch, std::vector< ListFieldSpec > const& fields ) ;
+		// Format the empty block that ends columnar output.
+		std::string format_list_columnar_end() ;
+
+		// Call read_batches(), which should pass batches of variants to the callback it is given,
+		// and write each batch to out in the given format, excluding the header and end.
+		// Batches are formatted on the pool and written in the order they were read.
+		// Returns the number of variants written.
+		std::size_t write_variant_list(
+			std::function< void( IndexQuery::BatchCallback ) > const& read_batches,
+			std::vector< ListFieldSpec > const& fields,
+			ListFormat format,
+			ThreadPool& pool,
+			std::ostream& out
+		) ;
+	}
+}
+
+#endif
@@ -0,0 +1,102 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef GENFILE_BGEN_VCF_HPP
+#define GENFILE_BGEN_VCF_HPP
+
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include "stdint.h"
+#include "genfile/types.hpp"
+#include "genfile/MissingValue.hpp"
+#include "genfile/bgen.hpp"
+
+// Formatting of bgen genotype data as the sample columns of VCF, as used by bgenix and serve-bgen.
+namespace genfile {
+	namespace bgen {
+		// Setter that formats the GT field, and optionally the GP field (HP for phased data), of each sample.
+		// GT is called from the probabilities exceeding the threshhold, and is missing if none does.
+		// Entries are stored for the whole variant, so that they can be written in any order afterwards.
+		struct VCFProbWriter {
+		public:
+			VCFProbWriter( double threshhold, bool write_probabilities = true ) ;
+
+			// Format entries only for samples i with (*selected)[i] true; other samples get empty entries.
+			// The vector must outlive this object.  By default, entries are formatted for all samples.
+			void set_selected_samples( std::vector< bool > const* selected ) ;
+
+			void initialise( std::size_t number_of_samples, std::size_t number_of_alleles ) ;
+			bool set_sample( std::size_t i ) ;
+			void set_number_of_entries(
+				std::size_t ploidy,
+				std::size_t number_of_entries,
+				OrderType order_type,
+				ValueType value_type
+			) ;
+			void set_value( uint32_t entry_i, double value ) ;
+			void set_value( uint32_t entry_i, MissingValue value ) ;
+			void finalise() {}
+
+			// Return true if the last variant parsed held phased data.
+			bool phased() const { return m_phased ; }
+			std::size_t number_of_samples() const { return m_entries.size() ; }
+			// Return the entry of the i-th sample of the last variant parsed.
+			std::string_view entry( std::size_t i ) const ;
+			// Write the entries of all samples, each preceded by a tab, and a newline.
+			void write( std::ostream& out ) const ;
+
+		private:
+			double const m_threshhold ;
+			bool const m_write_probabilities ;
+			std::vector< bool > const* m_selected ;
+			std::size_t m_number_of_alleles ;
+			std::string m_buffer ;
+			// Beginning and end of each sample's entry in m_buffer.
+			std::vector< std::pair< std::size_t, std::size_t > > m_entries ;
+			std::size_t m_sample ;
+			std::size_t m_ploidy ;
+			std::vector< double > m_values ;
+			bool m_missing ;
+			bool m_phased ;
+			// Allele counts of the genotype being considered for an unphased GT call.
+			std::vector< uint32_t > m_counts ;
+
+		private:
+			void write_entry() ;
+			void write_unphased_call() ;
+		} ;
+
+		// GT-only VCF output for diploid biallelic data.
+		// Each sample's GT field is three characters, determined by the two stored probability values for
+		// the sample - P(0/0) and P(0/1) for unphased data, or P(allele 0) on each haplotype for phased data.
+		// For up to 8 bits per probability, fields are looked up in a table indexed by the pair of values (y<<bits)|x;
+		// for higher bit depths they are determined by comparing the values to an integer threshhold.
+		// Calls are the same as those made by VCFProbWriter.
+		struct VcfGTTable {
+			int bits ;
+			bool phased ;
+			// Values greater than or equal to this are called.
+			uint64_t min_called_value ;
+			std::string table ;
+		} ;
+
+		VcfGTTable compute_vcf_gt_table( int const bits, bool const phased, double const threshhold ) ;
+
+		// Format tab-separated GT fields for all samples of pack, followed by a newline, into the buffer.
+		// pack must hold diploid, biallelic data with the table's number of bits and phasing.
+		// Throws BGenError if the block is too short to hold the data.
+		void write_vcf_gt_fields(
+			v12::GenotypeDataBlock const& pack,
+			VcfGTTable const& table,
+			std::vector< char >* buffer
+		) ;
+	}
+}
+
+#endif
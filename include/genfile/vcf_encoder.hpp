@@ -0,0 +1,113 @@
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef GENFILE_VCF_ENCODER_HPP
+#define GENFILE_VCF_ENCODER_HPP
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <stdint.h>
+#include "genfile/types.hpp"
+#include "genfile/bgen.hpp"
+#include "genfile/Buffer.hpp"
+
+// Parsing of VCF records and their encoding as bgen genotype data blocks, as used by vcf2bgen.
+namespace genfile {
+	namespace vcf {
+		// A range of characters [first, second) within a line.
+		typedef std::pair< char const*, char const* > Slice ;
+
+		inline std::string to_string( Slice const& slice ) {
+			return std::string( slice.first, slice.second ) ;
+		}
+
+		// Parse a number, which must be finite.
+		// Throws std::invalid_argument, with a message describing the value, if it is not.
+		double parse_double( Slice const& slice ) ;
+
+		// Parse a GT subfield into allele indices (with 0 for missing alleles), returning false if any allele is missing.
+		// phased is set to true unless any separator is '/'.
+		// Throws std::invalid_argument if an allele is not a number or '.'.
+		bool parse_GT( Slice const& slice, std::vector< uint32_t >* calls, bool* phased ) ;
+
+		// Return the index of the given unphased genotype (a sorted list of alleles)
+		// in the colex order used by bgen (see the bgen spec).
+		std::size_t genotype_index( std::vector< uint32_t > const& sorted_calls ) ;
+
+		// Return the ploidy implied by the given number of genotype probabilities, or zero if there is none.
+		uint32_t ploidy_from_number_of_genotypes( std::size_t n, std::size_t number_of_alleles ) ;
+
+		// A variant ready to be written to the output file.
+		struct EncodedVariant {
+			std::string chromosome ;
+			uint32_t position ;
+			std::string id ;
+			std::vector< std::string > alleles ;
+			// Genotype data block, in the form returned by GenotypeDataBlockWriter::repr().
+			std::vector< byte_t > data ;
+		} ;
+
+		struct EncodedChunk {
+			EncodedChunk(): number_skipped( 0 ) {}
+			std::vector< EncodedVariant > variants ;
+			// Number of records skipped because they cannot be represented
+			// (no alternate allele, or multiallelic with the DS field).
+			std::size_t number_skipped ;
+		} ;
+
+		// Parses and encodes chunks of VCF records, taking genotypes from the GP, DS or GT field.
+		// Ploidy is taken from the number of GP values for the GP field, and otherwise from GT if present;
+		// if neither is available it is assumed to be two.
+		// Data is written phased only if the field is GT and all called samples of ploidy > 1 are phased.
+		//
+		// GP values are usually rounded, so the values of each sample are rescaled to sum to one.  They must
+		// sum to one to within max_rounding_error_per_probability times the number of values, which allows
+		// for rounding to two or more decimal places.  Samples whose GP values are all zero are written as missing.
+		//
+		// encode() is const and may be called concurrently from several threads.
+		struct VcfEncoder {
+		public:
+			enum Field { eGP = 0, eDS = 1, eGT = 2 } ;
+			static double const max_rounding_error_per_probability ;
+
+			VcfEncoder( bgen::Context const& context, std::string const& field, int number_of_bits ) ;
+
+			// Encode the records in the given text, which starts at the given (1-based) line number of the file.
+			// Throws std::invalid_argument, with a message giving the line number, if a record is invalid.
+			EncodedChunk encode( std::string const& text, std::size_t first_line_number ) const ;
+
+		private:
+			bgen::Context const& m_context ;
+			std::string const m_field ;
+			Field const m_field_type ;
+			int const m_number_of_bits ;
+
+			// Per-sample information found in a first pass over each record.
+			struct SampleData {
+				Slice value ;
+				uint32_t ploidy ;
+				bool missing ;
+			} ;
+
+			// Storage reused between records.
+			struct Workspace {
+				std::vector< Slice > columns ;
+				std::vector< SampleData > samples ;
+				std::vector< uint32_t > calls ;
+				std::vector< double > values ;
+				// Encoding buffers, which are not zero-filled as they grow.
+				Buffer buffer1 ;
+				Buffer buffer2 ;
+			} ;
+
+		private:
+			// Encode one record.  Return false if the record is skipped.
+			bool encode_record( Slice const& line, Workspace* workspace, EncodedVariant* result ) const ;
+		} ;
+	}
+}
+
+#endif
@@ -10,9 +10,11 @@
 #include <vector>
 #include <stdint.h>
 #include <cassert>
+#include <stdexcept>
 #include <zlib.h>
 #include "zstd.h"
 #include "types.hpp"
+#include "Buffer.hpp"
 
 namespace genfile {
 
@@ -23,18 +25,22 @@ namespace genfile {
 	//
 	// If offset is nonzero, compressed data will be written starting at position [offset].
 	// The first [offset] bytes will be untouched.
+	//
+	// These functions are instantiated for std::vector< byte_t >, Buffer and HugePageBuffer.
+	template< typename Allocator >
 	void zlib_compress(
 		byte_t const* buffer,
 		byte_t const* const end,
-		std::vector< byte_t >* dest,
+		std::vector< byte_t, Allocator >* dest,
 		std::size_t const offset = 0,
 		int const compressionLevel = Z_BEST_COMPRESSION
 	) ;
 
+	template< typename Allocator >
 	void zstd_compress(
 		byte_t const* buffer,
 		byte_t const* const end,
-		std::vector< byte_t >* dest,
+		std::vector< byte_t, Allocator >* dest,
 		std::size_t const offset = 0,
 		int const compressionLevel = 22
 	) ;
@@ -43,10 +49,10 @@ namespace genfile {
 	// to fit the compressed data.  (Since the capacity of dest may be larger than its size,
 	// to save memory you may need to copy the contents of dest elsewhere after calling
 	// this function).
-	template< typename T >
+	template< typename T, typename SourceAllocator, typename Allocator >
 	void zlib_compress(
-		std::vector< T > const& source,
-		std::vector< byte_t >* dest,
+		std::vector< T, SourceAllocator > const& source,
+		std::vector< byte_t, Allocator >* dest,
 		int const compressionLevel = Z_BEST_COMPRESSION
 	 ) {
 		byte_t const* begin = reinterpret_cast< byte_t const* >( &source[0] ) ;
@@ -54,11 +60,11 @@ namespace genfile {
 		return zlib_compress( begin, end, dest, 0, compressionLevel ) ;
 	}
 
-	template< typename T >
+	template< typename T, typename Allocator >
 	void zlib_uncompress(
 		byte_t const* begin,
 		byte_t const* const end,
-		std::vector< T >* dest
+		std::vector< T, Allocator >* dest
 	) {
 		uLongf const source_size = ( end - begin ) ;
 		uLongf dest_size = dest->size() * sizeof( T ) ;
@@ -68,13 +74,15 @@ namespace genfile {
 			reinterpret_cast< Bytef const* >( begin ),
 			source_size
 		) ;
-		assert( result == Z_OK ) ;
+		if( result != Z_OK ) {
+			throw std::invalid_argument( "zlib_uncompress(): data could not be uncompressed." ) ;
+		}
 		assert( dest_size % sizeof( T ) == 0 ) ;
 		dest->resize( dest_size / sizeof( T )) ;
 	}
 
-	template< typename T >
-	void zstd_uncompress( byte_t const* begin, byte_t const* const end, std::vector< T >* dest ) {
+	template< typename T, typename Allocator >
+	void zstd_uncompress( byte_t const* begin, byte_t const* const end, std::vector< T, Allocator >* dest ) {
 		std::size_t const source_size = ( end - begin ) ;
 		std::size_t const dest_size = dest->size() * sizeof( T ) ;
 	    std::size_t const uncompressed_size = ZSTD_getDecompressedSize( reinterpret_cast< void const* >( begin ), source_size ) ;
@@ -84,15 +92,17 @@ namespace genfile {
 			reinterpret_cast< void const* >( begin ),
 			source_size
 		) ;
-		assert( result == uncompressed_size ) ;
-		dest->resize( dest_size / sizeof( T )) ;
+		if( ZSTD_isError( result ) || result != uncompressed_size ) {
+			throw std::invalid_argument( "zstd_uncompress(): data could not be uncompressed." ) ;
+		}
+		dest->resize( result / sizeof( T )) ;
 	}
 
 	// Uncompress the given data, symmetric with zlib_compress.
 	// The destination must be large enough to fit the uncompressed data,
 	// and it will be resized to exactly fit the uncompressed data.
-	template< typename T >
-	void zlib_uncompress( std::vector< byte_t > const& source, std::vector< T >* dest ) {
+	template< typename SourceAllocator, typename T, typename Allocator >
+	void zlib_uncompress( std::vector< byte_t, SourceAllocator > const& source, std::vector< T, Allocator >* dest ) {
 		byte_t const* begin = &source[0] ;
 		byte_t const* const end = &source[0] + source.size() ;
 		zlib_uncompress( begin, end, dest ) ;
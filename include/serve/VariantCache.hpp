@@ -0,0 +1,68 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef SERVE_VARIANT_CACHE_HPP
+#define SERVE_VARIANT_CACHE_HPP
+
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include "stdint.h"
+#include "genfile/types.hpp"
+
+namespace serve {
+	// A variant read from a served file, with its genotype data uncompressed.
+	struct CachedVariant {
+		std::string SNPID ;
+		std::string rsid ;
+		std::string chromosome ;
+		uint32_t position ;
+		std::vector< std::string > alleles ;
+		std::vector< genfile::byte_t > data ;
+
+		std::size_t memory_used() const ;
+	} ;
+
+	// A least-recently-used cache of variants, shared between requests, using at most the given number of bytes.
+	struct VariantCache {
+	public:
+		typedef std::shared_ptr< CachedVariant const > Value ;
+		// Variants are identified by the index of their file and their offset in it.
+		typedef std::pair< std::size_t, int64_t > Key ;
+
+		VariantCache( std::size_t capacity ) ;
+
+		// Return the cached variant, or a null pointer if it is not in the cache.
+		Value find( Key const& key ) ;
+		// Insert the variant, evicting the least recently used entries to make room for it.
+		// Variants larger than the capacity, or already in the cache, are not inserted.
+		void insert( Key const& key, Value const& value ) ;
+
+		std::size_t number_of_entries() const ;
+		// Return the total memory_used() of the cached variants.
+		std::size_t size() const ;
+		std::size_t capacity() const { return m_capacity ; }
+		std::string summarise_as_json() const ;
+
+	private:
+		typedef std::list< std::pair< Key, Value > > Entries ;
+		typedef std::map< Key, Entries::iterator > Lookup ;
+		mutable std::mutex m_mutex ;
+		std::size_t const m_capacity ;
+		std::size_t m_size ;
+		// Most recently used entries first.
+		Entries m_entries ;
+		Lookup m_lookup ;
+		uint64_t m_hits ;
+		uint64_t m_misses ;
+	} ;
+}
+
+#endif
@@ -0,0 +1,87 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef SERVE_HTTP_HPP
+#define SERVE_HTTP_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+// The minimal HTTP/1.1 support used by serve-bgen: one request per connection, parameters
+// given in the query string or a form-encoded POST body.
+namespace serve {
+	// An error to be reported to the client with the given HTTP status.
+	struct HttpError: public std::runtime_error {
+		HttpError( int status, std::string const& message ):
+			std::runtime_error( message ),
+			m_status( status )
+		{}
+		int status() const { return m_status ; }
+	private:
+		int m_status ;
+	} ;
+
+	struct HttpRequest {
+		std::string method ;
+		std::string path ;
+		// Parameters from the query string and, for POST requests, the form-encoded body.
+		std::map< std::string, std::string > parameters ;
+
+		std::optional< std::string > get( std::string const& name ) const {
+			std::map< std::string, std::string >::const_iterator where = parameters.find( name ) ;
+			return ( where == parameters.end() ) ? std::optional< std::string >() : where->second ;
+		}
+	} ;
+
+	struct HttpResponse {
+		HttpResponse( int status_ = 200, std::string const& content_type_ = "text/plain" ):
+			status( status_ ),
+			content_type( content_type_ )
+		{}
+		int status ;
+		std::string content_type ;
+		std::vector< std::pair< std::string, std::string > > headers ;
+		std::string body ;
+	} ;
+
+	char const* status_text( int status ) ;
+
+	// Split s at each occurrence of the separator.  An empty string has no fields.
+	std::vector< std::string > split( std::string_view const& s, char separator ) ;
+
+	// Decode '+' and %-escapes in a URL component.  Malformed escapes are left as they are.
+	std::string url_decode( std::string_view const& s ) ;
+
+	// Parse form-encoded name=value pairs, separated by '&', into the map.
+	// Later values replace earlier ones with the same name.
+	void parse_parameters( std::string_view const& encoded, std::map< std::string, std::string >* result ) ;
+
+	// Read an HTTP request from the given socket.
+	// Return false if the client closed the connection without sending one.
+	// Throws HttpError with status 400 if the header exceeds max_header_size bytes or the request is malformed
+	// or incomplete, and with status 413 if the Content-Length exceeds max_body_size.
+	bool read_request(
+		int socket,
+		HttpRequest* request,
+		std::size_t max_header_size = 64 * 1024,
+		// Sample lists in POST requests may be long, but are not unbounded.
+		std::size_t max_body_size = 256 * 1024 * 1024
+	) ;
+
+	// Send the response, closing the connection afterwards, and return the number of bytes sent.
+	// Return zero if the client could not be written to.
+	std::size_t send_response( int socket, HttpResponse const& response ) ;
+
+	// Return s as a quoted JSON string.
+	std::string json_string( std::string_view const& s ) ;
+}
+
+#endif
@@ -0,0 +1,81 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <new>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#if defined( __linux__ )
+#include <sys/mman.h>
+#endif
+#include "genfile/Buffer.hpp"
+
+namespace genfile {
+	namespace impl {
+		namespace {
+			// Huge page allocations are aligned and padded to whole huge pages, so that
+			// madvise() can apply to all of the allocation.
+			bool use_huge_pages( std::size_t bytes, bool huge_pages ) {
+				return huge_pages && bytes >= huge_page_size ;
+			}
+
+			std::size_t round_to_huge_pages( std::size_t bytes ) {
+				return ( ( bytes + huge_page_size - 1 ) / huge_page_size ) * huge_page_size ;
+			}
+		}
+
+		void* allocate_aligned( std::size_t bytes, std::size_t alignment, bool huge_pages ) {
+			if( use_huge_pages( bytes, huge_pages )) {
+				std::size_t const size = round_to_huge_pages( bytes ) ;
+				void* result = ::operator new( size, std::align_val_t( std::max( alignment, huge_page_size ))) ;
+#if defined( __linux__ ) && defined( MADV_HUGEPAGE )
+				// This is only advice; failure (e.g. if transparent huge pages are disabled) is harmless.
+				madvise( result, size, MADV_HUGEPAGE ) ;
+#endif
+				return result ;
+			}
+			return ::operator new( bytes, std::align_val_t( alignment )) ;
+		}
+
+		void deallocate_aligned( void* p, std::size_t bytes, std::size_t alignment, bool huge_pages ) {
+			if( use_huge_pages( bytes, huge_pages )) {
+				::operator delete( p, std::align_val_t( std::max( alignment, huge_page_size ))) ;
+			} else {
+				::operator delete( p, std::align_val_t( alignment )) ;
+			}
+		}
+	}
+
+	BufferPool::BufferPool( std::size_t max_buffers ):
+		m_max_buffers( max_buffers )
+	{}
+
+	Buffer BufferPool::acquire() {
+		std::unique_lock< std::mutex > lock( m_mutex ) ;
+		if( m_buffers.empty() ) {
+			return Buffer() ;
+		}
+		Buffer result = std::move( m_buffers.back() ) ;
+		m_buffers.pop_back() ;
+		return result ;
+	}
+
+	void BufferPool::release( Buffer buffer ) {
+		buffer.clear() ;
+		if( buffer.capacity() == 0 ) {
+			return ;
+		}
+		std::unique_lock< std::mutex > lock( m_mutex ) ;
+		if( m_buffers.size() < m_max_buffers ) {
+			m_buffers.push_back( std::move( buffer )) ;
+		}
+	}
+
+	std::size_t BufferPool::size() const {
+		std::unique_lock< std::mutex > lock( m_mutex ) ;
+		return m_buffers.size() ;
+	}
+}
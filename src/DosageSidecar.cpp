@@ -0,0 +1,243 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "genfile/bgen.hpp"
+#include "genfile/DosageSidecar.hpp"
+
+namespace genfile {
+	namespace bgen {
+		namespace {
+			char const magic[8] = { 'b', 'g', 'e', 'n', 'd', 's', 'c', '\0' } ;
+			uint32_t const format_version = 1 ;
+			std::size_t const fixed_header_size = 76 ;
+			std::size_t const row_alignment = 64 ;
+			std::size_t const data_alignment = 4096 ;
+
+			std::size_t round_up( std::size_t value, std::size_t alignment ) {
+				return (( value + alignment - 1 ) / alignment ) * alignment ;
+			}
+
+			bool host_is_little_endian() {
+				uint16_t const value = 1 ;
+				byte_t first ;
+				std::memcpy( &first, &value, 1 ) ;
+				return first == 1 ;
+			}
+		}
+
+		std::size_t const DosageSidecar::npos ;
+
+		std::string DosageSidecar::default_filename( std::string const& bgen_filename ) {
+			return bgen_filename + ".dosage" ;
+		}
+
+		std::size_t DosageSidecar::value_size( ValueType type ) {
+			return ( type == eUInt8 ) ? 1 : 2 ;
+		}
+
+		DosageSidecar::UniquePtr DosageSidecar::open( std::string const& filename ) {
+			return UniquePtr( new DosageSidecar( filename )) ;
+		}
+
+		DosageSidecar::DosageSidecar( std::string const& filename ):
+			m_filename( filename ),
+			m_data( 0 ),
+			m_size( 0 )
+		{
+			if( !host_is_little_endian() ) {
+				throw std::invalid_argument( "DosageSidecar: dosage sidecar files are only supported on little-endian hosts." ) ;
+			}
+			int fd = ::open( filename.c_str(), O_RDONLY ) ;
+			if( fd < 0 ) {
+				throw std::invalid_argument( filename ) ;
+			}
+			struct stat st ;
+			if( fstat( fd, &st ) != 0 || std::size_t( st.st_size ) < fixed_header_size ) {
+				::close( fd ) ;
+				throw std::invalid_argument( "DosageSidecar: file \"" + filename + "\" is not a dosage sidecar file." ) ;
+			}
+			m_size = st.st_size ;
+			void* data = mmap( 0, m_size, PROT_READ, MAP_SHARED, fd, 0 ) ;
+			::close( fd ) ;
+			if( data == MAP_FAILED ) {
+				throw std::invalid_argument( "DosageSidecar: could not map file \"" + filename + "\"." ) ;
+			}
+			m_data = reinterpret_cast< byte_t const* >( data ) ;
+
+			byte_t const* const end = m_data + m_size ;
+			byte_t const* p = m_data ;
+			uint32_t version = 0, value_type = 0, first_bytes_size = 0 ;
+			uint64_t number_of_samples = 0, number_of_variants = 0, row_stride = 0, data_position = 0, offset_table_position = 0 ;
+			int64_t bgen_size = 0, bgen_last_write_time = 0 ;
+			bool valid = ( std::memcmp( p, magic, 8 ) == 0 ) ;
+			p += 8 ;
+			p = read_little_endian_integer( p, end, &version ) ;
+			p = read_little_endian_integer( p, end, &value_type ) ;
+			p = read_little_endian_integer( p, end, &number_of_samples ) ;
+			p = read_little_endian_integer( p, end, &number_of_variants ) ;
+			p = read_little_endian_integer( p, end, &row_stride ) ;
+			p = read_little_endian_integer( p, end, &data_position ) ;
+			p = read_little_endian_integer( p, end, &offset_table_position ) ;
+			p = read_little_endian_integer( p, end, &bgen_size ) ;
+			p = read_little_endian_integer( p, end, &bgen_last_write_time ) ;
+			p = read_little_endian_integer( p, end, &first_bytes_size ) ;
+
+			valid = valid
+				&& version == format_version
+				&& ( value_type == eUInt8 || value_type == eFloat16 )
+				&& std::ptrdiff_t( first_bytes_size ) <= ( end - p )
+				&& row_stride >= number_of_samples * value_size( ValueType( value_type ))
+				&& data_position + number_of_variants * row_stride <= offset_table_position
+				&& offset_table_position + number_of_variants * 8 <= m_size ;
+			if( !valid ) {
+				munmap( const_cast< byte_t* >( m_data ), m_size ) ;
+				throw std::invalid_argument( "DosageSidecar: file \"" + filename + "\" is not a valid dosage sidecar file." ) ;
+			}
+
+			m_value_type = ValueType( value_type ) ;
+			m_number_of_samples = number_of_samples ;
+			m_number_of_variants = number_of_variants ;
+			m_row_stride = row_stride ;
+			m_data_position = data_position ;
+			m_offset_table_position = offset_table_position ;
+			m_bgen_metadata.size = bgen_size ;
+			m_bgen_metadata.last_write_time = bgen_last_write_time ;
+			m_bgen_metadata.first_bytes.assign( p, p + first_bytes_size ) ;
+		}
+
+		DosageSidecar::~DosageSidecar() {
+			munmap( const_cast< byte_t* >( m_data ), m_size ) ;
+		}
+
+		bool DosageSidecar::matches( FileMetadata const& metadata ) const {
+			return metadata.size == m_bgen_metadata.size
+				&& metadata.last_write_time == m_bgen_metadata.last_write_time
+				&& metadata.first_bytes == m_bgen_metadata.first_bytes ;
+		}
+
+		uint64_t DosageSidecar::variant_file_position( std::size_t i ) const {
+			uint64_t result ;
+			byte_t const* p = m_data + m_offset_table_position + 8 * i ;
+			read_little_endian_integer( p, p + 8, &result ) ;
+			return result ;
+		}
+
+		std::size_t DosageSidecar::find_variant( int64_t file_position ) const {
+			// Binary search in the (sorted) variant offset table.
+			std::size_t lower = 0, upper = m_number_of_variants ;
+			while( lower < upper ) {
+				std::size_t const mid = lower + ( upper - lower ) / 2 ;
+				if( variant_file_position( mid ) < uint64_t( file_position )) {
+					lower = mid + 1 ;
+				} else {
+					upper = mid ;
+				}
+			}
+			if( lower < m_number_of_variants && variant_file_position( lower ) == uint64_t( file_position )) {
+				return lower ;
+			}
+			return npos ;
+		}
+
+		/* DosageSidecarWriter */
+		DosageSidecarWriter::DosageSidecarWriter(
+			std::string const& filename,
+			FileMetadata const& bgen_metadata,
+			std::size_t number_of_samples,
+			ValueType value_type
+		):
+			m_filename( filename ),
+			m_temporary_filename( filename + ".tmp" ),
+			m_bgen_metadata( bgen_metadata ),
+			m_number_of_samples( number_of_samples ),
+			m_value_type( value_type ),
+			m_row_stride( round_up( number_of_samples * DosageSidecar::value_size( value_type ), row_alignment )),
+			m_data_position( round_up( fixed_header_size + bgen_metadata.first_bytes.size(), data_alignment )),
+			m_stream( m_temporary_filename.c_str(), std::ios::binary | std::ios::trunc ),
+			m_padding( std::max( m_row_stride, m_data_position ), 0 ),
+			m_finalised( false )
+		{
+			if( !host_is_little_endian() ) {
+				throw std::invalid_argument( "DosageSidecarWriter: dosage sidecar files are only supported on little-endian hosts." ) ;
+			}
+			if( !m_stream ) {
+				throw std::invalid_argument( m_temporary_filename ) ;
+			}
+			// Reserve space for the header; this is written properly by finalise().
+			m_stream.write( reinterpret_cast< char const* >( &m_padding[0] ), m_data_position ) ;
+		}
+
+		DosageSidecarWriter::~DosageSidecarWriter() {
+			if( !m_finalised ) {
+				m_stream.close() ;
+				std::remove( m_temporary_filename.c_str() ) ;
+			}
+		}
+
+		void DosageSidecarWriter::write_row_bytes( int64_t file_position, byte_t const* values ) {
+			assert( !m_finalised ) ;
+			assert( m_file_positions.empty() || uint64_t( file_position ) > m_file_positions.back() ) ;
+			std::size_t const row_size = m_number_of_samples * DosageSidecar::value_size( m_value_type ) ;
+			m_stream.write( reinterpret_cast< char const* >( values ), row_size ) ;
+			m_stream.write( reinterpret_cast< char const* >( &m_padding[0] ), m_row_stride - row_size ) ;
+			m_file_positions.push_back( file_position ) ;
+		}
+
+		void DosageSidecarWriter::finalise() {
+			assert( !m_finalised ) ;
+			// Write the variant offset table after the rows...
+			{
+				std::vector< byte_t > buffer( 8 * m_file_positions.size() ) ;
+				byte_t* p = buffer.empty() ? 0 : &buffer[0] ;
+				for( std::size_t i = 0; i < m_file_positions.size(); ++i ) {
+					p = write_little_endian_integer( p, p + 8, m_file_positions[i] ) ;
+				}
+				m_stream.write( reinterpret_cast< char const* >( buffer.data() ), buffer.size() ) ;
+			}
+			// ...then go back and fill in the header.
+			write_header() ;
+			m_stream.close() ;
+			if( !m_stream ) {
+				throw std::invalid_argument( "DosageSidecarWriter: failed to write \"" + m_temporary_filename + "\"." ) ;
+			}
+			if( std::rename( m_temporary_filename.c_str(), m_filename.c_str() ) != 0 ) {
+				throw std::invalid_argument( "DosageSidecarWriter: could not rename \"" + m_temporary_filename + "\" to \"" + m_filename + "\"." ) ;
+			}
+			m_finalised = true ;
+		}
+
+		void DosageSidecarWriter::write_header() {
+			std::vector< byte_t > buffer( fixed_header_size + m_bgen_metadata.first_bytes.size() ) ;
+			byte_t* const end = &buffer[0] + buffer.size() ;
+			byte_t* p = &buffer[0] ;
+			std::memcpy( p, magic, 8 ) ;
+			p += 8 ;
+			p = write_little_endian_integer( p, end, format_version ) ;
+			p = write_little_endian_integer( p, end, uint32_t( m_value_type )) ;
+			p = write_little_endian_integer( p, end, uint64_t( m_number_of_samples )) ;
+			p = write_little_endian_integer( p, end, uint64_t( m_file_positions.size() )) ;
+			p = write_little_endian_integer( p, end, uint64_t( m_row_stride )) ;
+			p = write_little_endian_integer( p, end, uint64_t( m_data_position )) ;
+			p = write_little_endian_integer( p, end, uint64_t( m_data_position + m_file_positions.size() * m_row_stride )) ;
+			p = write_little_endian_integer( p, end, int64_t( m_bgen_metadata.size )) ;
+			p = write_little_endian_integer( p, end, int64_t( m_bgen_metadata.last_write_time )) ;
+			p = write_little_endian_integer( p, end, uint32_t( m_bgen_metadata.first_bytes.size() )) ;
+			std::copy( m_bgen_metadata.first_bytes.begin(), m_bgen_metadata.first_bytes.end(), p ) ;
+			m_stream.seekp( 0 ) ;
+			m_stream.write( reinterpret_cast< char const* >( &buffer[0] ), buffer.size() ) ;
+		}
+	}
+}
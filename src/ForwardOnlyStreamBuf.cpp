@@ -0,0 +1,83 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include "genfile/ForwardOnlyStreamBuf.hpp"
+
+namespace genfile {
+	ForwardOnlyStreamBuf::UniquePtr ForwardOnlyStreamBuf::create( int fd, std::string const& name, std::size_t buffer_size ) {
+		return UniquePtr(
+			new ForwardOnlyStreamBuf(
+				[fd,name]( char* buffer, std::size_t size ) {
+					ssize_t n ;
+					do {
+						n = ::read( fd, buffer, size ) ;
+					} while( n < 0 && errno == EINTR ) ;
+					if( n < 0 ) {
+						throw std::runtime_error( "Error reading from \"" + name + "\": " + std::strerror( errno )) ;
+					}
+					return std::size_t( n ) ;
+				},
+				buffer_size
+			)
+		) ;
+	}
+
+	ForwardOnlyStreamBuf::UniquePtr ForwardOnlyStreamBuf::create( std::istream& stream, std::size_t buffer_size ) {
+		std::istream* source = &stream ;
+		return UniquePtr(
+			new ForwardOnlyStreamBuf(
+				[source]( char* buffer, std::size_t size ) {
+					source->read( buffer, size ) ;
+					return std::size_t( source->gcount() ) ;
+				},
+				buffer_size
+			)
+		) ;
+	}
+
+	ForwardOnlyStreamBuf::ForwardOnlyStreamBuf( Source source, std::size_t buffer_size ):
+		m_source( source ),
+		m_buffer( std::max< std::size_t >( buffer_size, 1 )),
+		m_buffer_start( 0 )
+	{
+		setg( &m_buffer[0], &m_buffer[0], &m_buffer[0] ) ;
+	}
+
+	ForwardOnlyStreamBuf::int_type ForwardOnlyStreamBuf::underflow() {
+		if( gptr() < egptr() ) {
+			return traits_type::to_int_type( *gptr() ) ;
+		}
+		m_buffer_start += ( egptr() - eback() ) ;
+		std::size_t const n = m_source( &m_buffer[0], m_buffer.size() ) ;
+		setg( &m_buffer[0], &m_buffer[0], &m_buffer[0] + n ) ;
+		return ( n == 0 ) ? traits_type::eof() : traits_type::to_int_type( *gptr() ) ;
+	}
+
+	ForwardOnlyStreamBuf::pos_type ForwardOnlyStreamBuf::seekoff( off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which ) {
+		if( off == 0 && dir == std::ios_base::cur && ( which & std::ios_base::in )) {
+			return pos_type( m_buffer_start + off_type( gptr() - eback() )) ;
+		}
+		return pos_type( off_type( -1 )) ;
+	}
+
+	bool is_stream_input( std::string const& filename ) {
+		if( filename == "-" ) {
+			return true ;
+		}
+		std::error_code error ;
+		std::filesystem::file_status const status = std::filesystem::status( filename, error ) ;
+		return !error && std::filesystem::exists( status ) && !std::filesystem::is_regular_file( status ) ;
+	}
+}
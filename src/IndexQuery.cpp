@@ -5,6 +5,8 @@
 //          http://www.boost.org/LICENSE_1_0.txt)
 
 #include <memory>
+#include <algorithm>
+#include <filesystem>
 #include <fmt/format.h>
 #include <optional>
 #include "db/sqlite3.hpp"
@@ -20,9 +22,10 @@ namespace genfile {
 
 		SqliteIndexQuery::SqliteIndexQuery( std::string const& filename, std::string const& table_name ):
 			m_connection( open_connection( filename ) ),
+			m_order_by( "chromosome, position, rsid, allele1, allele2" ),
+			m_initialised( false ),
 			m_metadata( load_metadata( *m_connection ) ),
-			m_index_table_name( table_name ),
-			m_initialised( false )
+			m_index_table_name( table_name )
 		{
 		}
 	
@@ -69,6 +72,37 @@ namespace genfile {
 			return m_positions[index] ;
 		}
 
+		void SqliteIndexQuery::read_variant_batches( std::size_t batch_size, BatchCallback callback ) const {
+			assert( batch_size > 0 ) ;
+			db::Connection::StatementPtr stmt = build_query(
+				"chromosome, position, rsid, number_of_alleles, allele1, allele2, file_start_position, size_in_bytes"
+			) ;
+			VariantBatch batch ;
+			std::string const SNPID ;
+			for( stmt->step() ; !stmt->empty(); stmt->step() ) {
+				batch.add_variant(
+					SNPID,
+					stmt->get< std::string >( 2 ),
+					stmt->get< std::string >( 0 ),
+					uint32_t( stmt->get< int64_t >( 1 )),
+					uint16_t( stmt->get< int64_t >( 3 ))
+				) ;
+				batch.add_allele( stmt->get< std::string >( 4 )) ;
+				if( !stmt->is_null( 5 )) {
+					batch.add_allele( stmt->get< std::string >( 5 )) ;
+				}
+				batch.file_offset.push_back( stmt->get< int64_t >( 6 )) ;
+				batch.file_size.push_back( stmt->get< int64_t >( 7 )) ;
+				if( batch.size() == batch_size ) {
+					callback( batch ) ;
+					batch.clear() ;
+				}
+			}
+			if( batch.size() > 0 ) {
+				callback( batch ) ;
+			}
+		}
+
 		SqliteIndexQuery& SqliteIndexQuery::include_range( GenomicRange const& range ) {
 			m_query_parts.inclusion += ((m_query_parts.inclusion.size() > 0) ? " OR " : "" ) + (
                                                                                                             "( chromosome == '"+range.chromosome()+"' AND position BETWEEN "+std::to_string(range.start())+" AND "+std::to_string(range.end())+")" ) ;
@@ -113,6 +147,46 @@ namespace genfile {
 			return *this ;
 		}
 
+		SqliteIndexQuery& SqliteIndexQuery::include_positions( std::vector< VariantPosition > const& positions ) {
+			// Positions without alleles are stored with empty alleles.
+			// Keys are sorted before loading, which makes inserting large numbers of keys much faster.
+			std::vector< VariantPosition > sorted_positions( positions ) ;
+			std::sort( sorted_positions.begin(), sorted_positions.end() ) ;
+			sorted_positions.erase( std::unique( sorted_positions.begin(), sorted_positions.end() ), sorted_positions.end() ) ;
+			m_connection->run_statement(
+				"CREATE TEMP TABLE IF NOT EXISTS tmpIncludedPosition( "
+				"chromosome TEXT NOT NULL, position INT NOT NULL, allele1 TEXT NOT NULL, allele2 TEXT NOT NULL, "
+				"PRIMARY KEY( chromosome, position, allele1, allele2 )"
+				") WITHOUT ROWID"
+			) ;
+			{
+				db::Connection::ScopedTransactionPtr transaction = m_connection->open_transaction( 240 ) ;
+				db::Connection::StatementPtr insert_stmt = m_connection->get_statement(
+					"INSERT OR IGNORE INTO tmpIncludedPosition( chromosome, position, allele1, allele2 ) VALUES( ?, ?, ?, ? )"
+				) ;
+				for( std::size_t i = 0; i < sorted_positions.size(); ++i ) {
+					VariantPosition const& position = sorted_positions[i] ;
+					insert_stmt
+						->bind( 1, position.chromosome() )
+						.bind( 2, position.position() )
+						.bind( 3, position.allele1() )
+						.bind( 4, position.allele2() )
+						.step() ;
+					insert_stmt->reset() ;
+				}
+			}
+			if( m_query_parts.inclusion.find( "tmpIncludedPosition" ) == std::string::npos ) {
+				// This is a correlated subquery rather than a join, so that variants matching
+				// several positions (with and without alleles) are reported once.
+				m_query_parts.inclusion += ( m_query_parts.inclusion.size() > 0 ? " OR" : "" ) + std::string(
+					" EXISTS( SELECT 1 FROM tmpIncludedPosition TP WHERE TP.chromosome == V.chromosome AND TP.position == V.position"
+					" AND ( TP.allele1 == '' OR ( TP.allele1 == V.allele1 AND TP.allele2 == V.allele2 )))"
+				) ;
+			}
+			m_initialised = false ;
+			return *this ;
+		}
+
 		db::Connection::UniquePtr SqliteIndexQuery::open_connection( std::string const& filename ) const {
 			db::Connection::UniquePtr result ;
 			try {
@@ -148,14 +222,14 @@ namespace genfile {
 			return result ;
 		}
 
-		db::Connection::StatementPtr SqliteIndexQuery::build_query() const {
-			std::string const select = "SELECT file_start_position, size_in_bytes FROM `"
+		db::Connection::StatementPtr SqliteIndexQuery::build_query( std::string const& columns ) const {
+			std::string const select = "SELECT " + columns + " FROM `"
 				+ m_index_table_name + "` V" ;
 			std::string const inclusion = ( m_query_parts.inclusion.size() > 0 ) ? ("(" + m_query_parts.inclusion + ")") : "" ;
 			std::string const exclusion = ((m_query_parts.inclusion.size() > 0 && m_query_parts.exclusion.size() > 0 ) ? "AND " : "" )
 				+ (( m_query_parts.exclusion.size() > 0 ) ? ("(" + m_query_parts.exclusion + ")") : "" ) ;
 			std::string const where = (inclusion.size() > 0 || exclusion.size() > 0) ? ("WHERE " + inclusion + exclusion) : "" ;
-			std::string const orderBy = "ORDER BY chromosome, position, rsid, allele1, allele2" ;
+			std::string const orderBy = "ORDER BY " + m_order_by ;
 			std::string const select_sql = select + " " + m_query_parts.join + " " + where + " " + orderBy ;
 	#if DEBUG
 			std::cerr << "BgenIndex::build_query(): SQL is: \"" << select_sql << "\"...\n" ;
@@ -163,6 +237,59 @@ namespace genfile {
 	
 			return m_connection->get_statement( select_sql ) ;
 		}
+	
+		CatalogIndexQuery::CatalogIndexQuery( std::string const& filename ):
+			SqliteIndexQuery( filename, "Variant" )
+		{
+			db::Connection::StatementPtr stmt = m_connection->get_statement(
+				"SELECT * FROM sqlite_master WHERE name == 'File' AND type == 'table'"
+			) ;
+			stmt->step() ;
+			if( stmt->empty() ) {
+				throw std::invalid_argument( "\"" + filename + "\" is not a catalog index (no \"File\" table)." ) ;
+			}
+			std::filesystem::path const directory = std::filesystem::absolute( filename ).parent_path() ;
+			stmt = m_connection->get_statement(
+				"SELECT file_id, filename, file_size, last_write_time, first_1000_bytes FROM File ORDER BY file_id"
+			) ;
+			for( stmt->step(); !stmt->empty(); stmt->step() ) {
+				if( stmt->get< int64_t >( 0 ) != int64_t( m_files.size() )) {
+					throw std::invalid_argument( "Catalog index \"" + filename + "\" appears malformed (file ids are not consecutive)." ) ;
+				}
+				FileMetadata metadata ;
+				std::filesystem::path const path( stmt->get< std::string >( 1 )) ;
+				metadata.filename = path.is_absolute() ? path.string() : ( directory / path ).lexically_normal().string() ;
+				metadata.size = stmt->get< int64_t >( 2 ) ;
+				metadata.last_write_time = stmt->get< int64_t >( 3 ) ;
+				metadata.first_bytes = stmt->get< std::vector< uint8_t > >( 4 ) ;
+				m_files.push_back( metadata ) ;
+			}
+			m_order_by = "file_id, file_start_position" ;
+		}
+
+		void CatalogIndexQuery::initialise( ProgressCallback callback ) {
+			db::Connection::StatementPtr stmt = build_query( "file_start_position, size_in_bytes, file_id" ) ;
+			if( callback ) {
+				callback( 0, std::optional< std::size_t >() ) ;
+			}
+			m_positions.clear() ;
+			m_file_indices.clear() ;
+			for( stmt->step() ; !stmt->empty(); stmt->step() ) {
+				int64_t const file_i = stmt->get< int64_t >( 2 ) ;
+				assert( file_i >= 0 && file_i < int64_t( m_files.size() )) ;
+				m_positions.push_back( std::make_pair( stmt->get< int64_t >( 0 ), stmt->get< int64_t >( 1 ))) ;
+				m_file_indices.push_back( uint32_t( file_i )) ;
+				if( callback ) {
+					callback( m_positions.size(), std::optional< std::size_t >() ) ;
+				}
+			}
+			m_initialised = true ;
+		}
+
+		std::size_t CatalogIndexQuery::locate_file( std::size_t index ) const {
+			assert( m_initialised ) ;
+			assert( index < m_file_indices.size() ) ;
+			return m_file_indices[ index ] ;
+		}
 	}
 }
-
@@ -0,0 +1,285 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <string>
+#include <vector>
+#include <ctime>
+#include <cassert>
+#include <stdexcept>
+#include <filesystem>
+#include "db/Connection.hpp"
+#include "db/SQLStatement.hpp"
+#include "genfile/IndexWriter.hpp"
+
+namespace genfile {
+	namespace bgen {
+		namespace {
+			// Commit after this many variants.
+			std::size_t const commit_interval = 10000 ;
+
+			std::string get_current_time_as_string() {
+				time_t rawtime ;
+				char buffer[30] ;
+				std::time( &rawtime ) ;
+				std::strftime( buffer, 30, "%Y-%m-%d %H:%M:%S", std::localtime( &rawtime ) ) ;
+				return std::string( buffer ) ;
+			}
+		}
+
+		IndexWriter::UniquePtr IndexWriter::create( std::string const& filename, bool with_rowid, bool with_hashes ) {
+			return IndexWriter::UniquePtr( new IndexWriter( filename, with_rowid, with_hashes )) ;
+		}
+
+		IndexWriter::IndexWriter( std::string const& filename, bool with_rowid, bool with_hashes ):
+			m_filename( filename ),
+			m_tmp_filename( filename + ".tmp" ),
+			m_with_hashes( with_hashes ),
+			m_number_of_variants( 0 ),
+			m_finalised( false )
+		{
+			if( std::filesystem::exists( m_tmp_filename )) {
+				throw std::invalid_argument(
+					"Error: an incomplete index file \"" + m_tmp_filename + "\" already exists.\n"
+					"This probably reflects a previous run that was terminated.\n"
+					"Please delete the file and try again.\n"
+				) ;
+			}
+			m_connection = db::Connection::create( "file:" + m_tmp_filename + "?nolock=1", "rw" ) ;
+			m_connection->run_statement( "PRAGMA locking_mode = EXCLUSIVE ;" ) ;
+			m_connection->run_statement( "PRAGMA journal_mode = MEMORY ;" ) ;
+			m_connection->run_statement( "PRAGMA synchronous = OFF;" ) ;
+
+			m_transaction = m_connection->open_transaction( 240 ) ;
+			setup_index_file( with_rowid ) ;
+			// Close and open the transaction
+			m_transaction.reset() ;
+
+			m_insert_variant_stmt = m_connection->get_statement(
+				m_with_hashes
+				? "INSERT INTO Variant( chromosome, position, rsid, number_of_alleles, allele1, allele2, file_start_position, size_in_bytes, content_hash ) "
+					"VALUES( ?, ?, ?, ?, ?, ?, ?, ?, ? )"
+				: "INSERT INTO Variant( chromosome, position, rsid, number_of_alleles, allele1, allele2, file_start_position, size_in_bytes ) "
+					"VALUES( ?, ?, ?, ?, ?, ?, ?, ? )"
+			) ;
+			m_transaction = m_connection->open_transaction( 240 ) ;
+		}
+
+		IndexWriter::~IndexWriter() {
+			if( !m_finalised ) {
+				// Remove the incomplete index file.
+				m_insert_variant_stmt.reset() ;
+				m_transaction.reset() ;
+				m_connection.reset() ;
+				std::error_code ec ;
+				std::filesystem::remove( m_tmp_filename, ec ) ;
+			}
+		}
+
+		void IndexWriter::setup_index_file( bool with_rowid ) {
+			std::string const tag = with_rowid ? "" : " WITHOUT ROWID" ;
+
+			m_connection->run_statement(
+				"CREATE TABLE Metadata ("
+				" filename TEXT NOT NULL,"
+				" file_size INT NOT NULL,"
+				" last_write_time INT NOT NULL,"
+				" first_1000_bytes BLOB NOT NULL,"
+				" index_creation_time INT NOT NULL"
+				")"
+			) ;
+
+			m_connection->run_statement(
+				"CREATE TABLE Variant ("
+				"  chromosome TEXT NOT NULL,"
+				"  position INT NOT NULL,"
+				"  rsid TEXT NOT NULL,"
+				"  number_of_alleles INT NOT NULL,"
+				"  allele1 TEXT NOT NULL,"
+				"  allele2 TEXT NULL,"
+				"  file_start_position INT NOT NULL," //
+				"  size_in_bytes INT NOT NULL,"       // We put these first to minimise cost of retrieval
+				+ std::string( m_with_hashes ? "  content_hash INT NOT NULL," : "" ) +
+				"  PRIMARY KEY (chromosome, position, rsid, allele1, allele2, file_start_position )"
+				")" + tag
+			) ;
+		}
+
+		void IndexWriter::add_variant(
+			std::string const& chromosome,
+			uint32_t position,
+			std::string const& rsid,
+			std::vector< std::string > const& alleles,
+			FileRange const& range,
+			std::optional< uint64_t > const& content_hash
+		) {
+			assert( !m_finalised ) ;
+			assert( alleles.size() > 1 ) ;
+			assert( range.second > 0 ) ;
+			if( bool( content_hash ) != m_with_hashes ) {
+				throw std::invalid_argument(
+					m_with_hashes
+						? "IndexWriter::add_variant(): a content hash is required because the index records hashes."
+						: "IndexWriter::add_variant(): a content hash was given but the index does not record hashes."
+				) ;
+			}
+			m_insert_variant_stmt
+				->bind( 1, chromosome )
+				.bind( 2, position )
+				.bind( 3, rsid )
+				.bind( 4, int64_t( alleles.size() ) )
+				.bind( 5, alleles[0] )
+				.bind( 6, alleles[1] )
+				.bind( 7, range.first )
+				.bind( 8, range.second )
+			;
+			if( m_with_hashes ) {
+				m_insert_variant_stmt->bind( 9, *content_hash ) ;
+			}
+			m_insert_variant_stmt->step() ;
+			m_insert_variant_stmt->reset() ;
+
+			if( ++m_number_of_variants % commit_interval == 0 ) {
+				m_transaction.reset() ;
+				m_transaction = m_connection->open_transaction( 240 ) ;
+			}
+		}
+
+		void IndexWriter::finalise( FileMetadata const& metadata ) {
+			assert( !m_finalised ) ;
+			db::Connection::StatementPtr insert_metadata_stmt = m_connection->get_statement(
+				"INSERT INTO Metadata( filename, file_size, last_write_time, first_1000_bytes, index_creation_time ) VALUES( ?, ?, ?, ?, ? )"
+			) ;
+			insert_metadata_stmt
+				->bind( 1, metadata.filename )
+				.bind( 2, metadata.size )
+				.bind( 3, uint64_t( metadata.last_write_time ) )
+				.bind( 4, metadata.first_bytes.data(), metadata.first_bytes.data() + metadata.first_bytes.size() )
+				.bind( 5, get_current_time_as_string() )
+				.step() ;
+			insert_metadata_stmt.reset() ;
+			m_insert_variant_stmt.reset() ;
+			m_transaction.reset() ;
+			m_connection.reset() ;
+			std::filesystem::rename( m_tmp_filename, m_filename ) ;
+			m_finalised = true ;
+		}
+
+		CatalogWriter::CatalogWriter( std::string const& filename ):
+			m_filename( filename ),
+			m_tmp_filename( filename + ".tmp" ),
+			m_number_of_files( 0 ),
+			m_finalised( false )
+		{
+			if( std::filesystem::exists( m_tmp_filename )) {
+				throw std::invalid_argument(
+					"Error: an incomplete catalog file \"" + m_tmp_filename + "\" already exists.\n"
+					"This probably reflects a previous run that was terminated.\n"
+					"Please delete the file and try again.\n"
+				) ;
+			}
+			m_connection = db::Connection::create( "file:" + m_tmp_filename + "?nolock=1", "rw" ) ;
+			m_connection->run_statement( "PRAGMA locking_mode = EXCLUSIVE ;" ) ;
+			m_connection->run_statement( "PRAGMA journal_mode = MEMORY ;" ) ;
+			m_connection->run_statement( "PRAGMA synchronous = OFF;" ) ;
+			m_connection->run_statement(
+				"CREATE TABLE File ("
+				" file_id INT NOT NULL PRIMARY KEY,"
+				" filename TEXT NOT NULL,"
+				" file_size INT NOT NULL,"
+				" last_write_time INT NOT NULL,"
+				" first_1000_bytes BLOB NOT NULL,"
+				" index_creation_time INT NOT NULL"
+				")"
+			) ;
+			// As for the bgenix Variant table, with a file_id column.
+			m_connection->run_statement(
+				"CREATE TABLE Variant ("
+				"  chromosome TEXT NOT NULL,"
+				"  position INT NOT NULL,"
+				"  rsid TEXT NOT NULL,"
+				"  number_of_alleles INT NOT NULL,"
+				"  allele1 TEXT NOT NULL,"
+				"  allele2 TEXT NULL,"
+				"  file_id INT NOT NULL REFERENCES File( file_id ),"
+				"  file_start_position INT NOT NULL,"
+				"  size_in_bytes INT NOT NULL,"
+				"  PRIMARY KEY (chromosome, position, rsid, allele1, allele2, file_id, file_start_position )"
+				") WITHOUT ROWID"
+			) ;
+		}
+
+		CatalogWriter::~CatalogWriter() {
+			if( !m_finalised ) {
+				m_connection.reset() ;
+				std::error_code ec ;
+				std::filesystem::remove( m_tmp_filename, ec ) ;
+			}
+		}
+
+		std::size_t CatalogWriter::add_file(
+			std::string const& bgen_filename,
+			std::string const& index_filename,
+			FileMetadata const& metadata
+		) {
+			assert( !m_finalised ) ;
+			// Check the index matches the file.
+			{
+				SqliteIndexQuery const index( index_filename ) ;
+				IndexQuery::OptionalFileMetadata const& index_metadata = index.file_metadata() ;
+				if( index_metadata && (
+					index_metadata->size != metadata.size || index_metadata->first_bytes != metadata.first_bytes
+				)) {
+					throw std::invalid_argument(
+						"The index file \"" + index_filename + "\" does not match \"" + bgen_filename + "\".\n"
+						"Do you need to recreate the index?"
+					) ;
+				}
+			}
+
+			std::filesystem::path const directory = std::filesystem::absolute( m_filename ).parent_path() ;
+			std::filesystem::path const path = std::filesystem::absolute( bgen_filename ).lexically_normal() ;
+			std::filesystem::path const relative_path = path.lexically_relative( directory ) ;
+			std::string const recorded_filename = relative_path.empty() ? path.string() : relative_path.string() ;
+
+			int64_t const file_id = int64_t( m_number_of_files ) ;
+			m_connection->get_statement( "ATTACH DATABASE ? AS idx" )->bind( 1, index_filename ).step() ;
+			std::size_t number_of_variants = 0 ;
+			{
+				db::Connection::ScopedTransactionPtr transaction = m_connection->open_transaction( 240 ) ;
+				m_connection->get_statement(
+					"INSERT INTO File( file_id, filename, file_size, last_write_time, first_1000_bytes, index_creation_time )"
+					" VALUES( ?, ?, ?, ?, ?, ? )"
+				)
+					->bind( 1, file_id )
+					.bind( 2, recorded_filename )
+					.bind( 3, metadata.size )
+					.bind( 4, uint64_t( metadata.last_write_time ))
+					.bind( 5, metadata.first_bytes.data(), metadata.first_bytes.data() + metadata.first_bytes.size() )
+					.bind( 6, get_current_time_as_string() )
+					.step() ;
+				db::Connection::StatementPtr insert_stmt = m_connection->get_statement(
+					"INSERT INTO Variant( chromosome, position, rsid, number_of_alleles, allele1, allele2, file_id, file_start_position, size_in_bytes )"
+					" SELECT chromosome, position, rsid, number_of_alleles, allele1, allele2, ?, file_start_position, size_in_bytes"
+					" FROM idx.Variant"
+				) ;
+				insert_stmt->bind( 1, file_id ).step() ;
+				db::Connection::StatementPtr count_stmt = m_connection->get_statement( "SELECT COUNT(*) FROM idx.Variant" ) ;
+				count_stmt->step() ;
+				number_of_variants = std::size_t( count_stmt->get< int64_t >( 0 )) ;
+			}
+			m_connection->run_statement( "DETACH DATABASE idx" ) ;
+			++m_number_of_files ;
+			return number_of_variants ;
+		}
+
+		void CatalogWriter::finalise() {
+			assert( !m_finalised ) ;
+			m_connection.reset() ;
+			std::filesystem::rename( m_tmp_filename, m_filename ) ;
+			m_finalised = true ;
+		}
+	}
+}
@@ -0,0 +1,93 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <zlib.h>
+#include "genfile/LineReader.hpp"
+
+namespace genfile {
+	LineReader::LineReader( std::string const& filename, std::size_t buffer_size ):
+		m_filename( filename ),
+		m_file( gzopen( filename.c_str(), "rb" ) ),
+		m_buffer( std::max( buffer_size, std::size_t( 1024 ) )),
+		m_begin( 0 ),
+		m_end( 0 ),
+		m_eof( false ),
+		m_number_of_lines( 0 )
+	{
+		if( m_file == 0 ) {
+			throw std::invalid_argument( filename ) ;
+		}
+		gzbuffer( m_file, 1024 * 1024 ) ;
+	}
+
+	LineReader::~LineReader() {
+		gzclose( m_file ) ;
+	}
+
+	std::size_t LineReader::read_lines( std::size_t max_lines, std::string* result ) {
+		std::size_t count = 0 ;
+		while( count < max_lines ) {
+			// Take as many complete lines as we can from the buffer in one go.
+			char const* const begin = &m_buffer[0] + m_begin ;
+			char const* const end = &m_buffer[0] + m_end ;
+			char const* p = begin ;
+			for( ; count < max_lines && p < end; ++count ) {
+				char const* newline = reinterpret_cast< char const* >( std::memchr( p, '\n', end - p )) ;
+				if( newline == 0 ) {
+					break ;
+				}
+				p = newline + 1 ;
+			}
+			result->append( begin, p ) ;
+			m_begin += ( p - begin ) ;
+			if( count < max_lines && !fill() ) {
+				// End of file.  Return any unterminated last line.
+				if( m_end > m_begin ) {
+					result->append( &m_buffer[0] + m_begin, &m_buffer[0] + m_end ) ;
+					result->push_back( '\n' ) ;
+					m_begin = m_end ;
+					++count ;
+				}
+				break ;
+			}
+		}
+		m_number_of_lines += count ;
+		return count ;
+	}
+
+	bool LineReader::fill() {
+		if( m_eof ) {
+			return false ;
+		}
+		// Move any partial line to the start of the buffer, growing it if a single line fills it.
+		std::copy( m_buffer.begin() + m_begin, m_buffer.begin() + m_end, m_buffer.begin() ) ;
+		m_end -= m_begin ;
+		m_begin = 0 ;
+		if( m_end == m_buffer.size() ) {
+			m_buffer.resize( 2 * m_buffer.size() ) ;
+		}
+		std::size_t const space = std::min(
+			m_buffer.size() - m_end,
+			std::size_t( std::numeric_limits< int >::max() )
+		) ;
+		int const n = gzread( m_file, &m_buffer[0] + m_end, unsigned( space )) ;
+		if( n < 0 ) {
+			int error = 0 ;
+			throw std::invalid_argument( "Error reading from \"" + m_filename + "\": " + gzerror( m_file, &error )) ;
+		} else if( n == 0 ) {
+			m_eof = true ;
+			return false ;
+		}
+		m_end += n ;
+		return true ;
+	}
+}
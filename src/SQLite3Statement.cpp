@@ -104,7 +104,10 @@ namespace db {
 
 	SQLite3Statement& SQLite3Statement::bind( std::size_t i, char const* buffer, char const* const end ) {
 		assert( m_statement != 0 ) ;
-		int error = sqlite3_bind_blob( m_statement, i, reinterpret_cast< void const* >( buffer ), int( end - buffer ), SQLITE_TRANSIENT ) ;
+		// sqlite3_bind_blob() binds NULL if given a null pointer.
+		int error = ( buffer == end )
+			? sqlite3_bind_zeroblob( m_statement, i, 0 )
+			: sqlite3_bind_blob( m_statement, i, reinterpret_cast< void const* >( buffer ), int( end - buffer ), SQLITE_TRANSIENT ) ;
 		if( error != SQLITE_OK ) {
 			throw ValueBindError( "SQLite3Statement::bind()", m_connection->get_spec(), error, std::to_string( i ) ) ;
 		}
@@ -113,7 +116,10 @@ namespace db {
 
 	SQLite3Statement& SQLite3Statement::bind( std::size_t i, uint8_t const* buffer, uint8_t const* const end ) {
 		assert( m_statement != 0 ) ;
-		int error = sqlite3_bind_blob( m_statement, i, reinterpret_cast< void const* >( buffer ), int( end - buffer ), SQLITE_TRANSIENT ) ;
+		// sqlite3_bind_blob() binds NULL if given a null pointer.
+		int error = ( buffer == end )
+			? sqlite3_bind_zeroblob( m_statement, i, 0 )
+			: sqlite3_bind_blob( m_statement, i, reinterpret_cast< void const* >( buffer ), int( end - buffer ), SQLITE_TRANSIENT ) ;
 		if( error != SQLITE_OK ) {
 			throw ValueBindError( "SQLite3Statement::bind()", m_connection->get_spec(), error, std::to_string( i ) ) ;
 		}
@@ -0,0 +1,245 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "genfile/bgen.hpp"
+#include "genfile/SampleOrder.hpp"
+
+namespace genfile {
+	namespace bgen {
+		SampleOrder::SampleOrder( std::size_t number_of_samples, std::vector< std::size_t > const& order ):
+			m_order( order ),
+			m_output_index( number_of_samples, absent ),
+			m_number_of_absent_samples( 0 )
+		{
+			for( std::size_t j = 0; j < m_order.size(); ++j ) {
+				std::size_t const i = m_order[j] ;
+				if( i == absent ) {
+					++m_number_of_absent_samples ;
+				} else if( i >= number_of_samples ) {
+					throw std::invalid_argument(
+						"sample " + std::to_string( i ) + " is out of range (the file has " + std::to_string( number_of_samples ) + " samples)"
+					) ;
+				} else if( m_output_index[i] != absent ) {
+					throw std::invalid_argument( "sample " + std::to_string( i ) + " appears more than once in the sample order" ) ;
+				} else {
+					m_output_index[i] = j ;
+				}
+			}
+		}
+
+		SampleOrder SampleOrder::match(
+			std::vector< std::string > const& file_sample_ids,
+			std::vector< std::string > const& ids
+		) {
+			std::unordered_map< std::string, std::size_t > positions ;
+			positions.reserve( ids.size() ) ;
+			for( std::size_t j = 0; j < ids.size(); ++j ) {
+				if( !positions.emplace( ids[j], j ).second ) {
+					throw std::invalid_argument( "sample \"" + ids[j] + "\" appears more than once in the sample order" ) ;
+				}
+			}
+			std::vector< std::size_t > order( ids.size(), absent ) ;
+			for( std::size_t i = 0; i < file_sample_ids.size(); ++i ) {
+				std::unordered_map< std::string, std::size_t >::const_iterator where = positions.find( file_sample_ids[i] ) ;
+				if( where != positions.end() ) {
+					if( order[ where->second ] != absent ) {
+						throw std::invalid_argument( "sample \"" + file_sample_ids[i] + "\" appears more than once in the file" ) ;
+					}
+					order[ where->second ] = i ;
+				}
+			}
+			return SampleOrder( file_sample_ids.size(), order ) ;
+		}
+
+		namespace {
+			// Writes a sequence of values of up to 32 bits each to a buffer, packed as in layout 2.
+			struct BitWriter {
+				BitWriter( byte_t* buffer ):
+					m_buffer( buffer ),
+					m_data( 0 ),
+					m_bits( 0 )
+				{}
+
+				void write( uint64_t value, int bits ) {
+					assert( bits <= 32 && m_bits < 8 ) ;
+					m_data |= value << m_bits ;
+					m_bits += bits ;
+					for( ; m_bits >= 8; m_bits -= 8, m_data >>= 8 ) {
+						*m_buffer++ = byte_t( m_data & 0xFF ) ;
+					}
+				}
+
+				// Copy n bits starting bit_offset bits into source, which ends at end.
+				void copy( byte_t const* source, byte_t const* const end, std::size_t bit_offset, std::size_t n ) {
+					source += bit_offset / 8 ;
+					bit_offset %= 8 ;
+					if( m_bits == 0 && bit_offset == 0 ) {
+						// Whole bytes can be copied directly.
+						m_buffer = std::copy( source, source + n/8, m_buffer ) ;
+						source += n/8 ;
+						n %= 8 ;
+					}
+					for( ; n > 0; ) {
+						int const bits = int( std::min( n, std::size_t( 32 ))) ;
+						uint64_t data = 0 ;
+						std::size_t const available = std::min( std::size_t( 8 ), std::size_t( end - source )) ;
+						for( std::size_t b = 0; b < available; ++b ) {
+							data |= uint64_t( source[b] ) << ( 8*b ) ;
+						}
+						write( ( data >> bit_offset ) & ( uint64_t(0xFFFFFFFFFFFFFFFF) >> ( 64 - bits )), bits ) ;
+						bit_offset += bits ;
+						source += bit_offset / 8 ;
+						bit_offset %= 8 ;
+						n -= bits ;
+					}
+				}
+
+				void skip( std::size_t n ) {
+					for( ; n > 0; ) {
+						int const bits = int( std::min( n, std::size_t( 32 ))) ;
+						write( 0, bits ) ;
+						n -= bits ;
+					}
+				}
+
+				// Write any remaining bits, padded with zeroes, and return the end of the data.
+				byte_t* finalise() {
+					if( m_bits > 0 ) {
+						*m_buffer++ = byte_t( m_data & 0xFF ) ;
+						m_data = 0 ;
+						m_bits = 0 ;
+					}
+					return m_buffer ;
+				}
+
+			private:
+				byte_t* m_buffer ;
+				uint64_t m_data ;
+				int m_bits ;
+			} ;
+
+			void reorder_samples_v11(
+				Context const& context,
+				byte_t const* buffer,
+				byte_t const* const end,
+				SampleOrder const& order,
+				Buffer* result
+			) {
+				// Each sample takes six bytes, and all-zero probabilities denote missing data.
+				if( std::size_t( end - buffer ) != 6 * std::size_t( context.number_of_samples )) {
+					throw BGenError() ;
+				}
+				result->resize( 6 * order.size() ) ;
+				byte_t* out = &(*result)[0] ;
+				for( std::size_t j = 0; j < order.size(); ++j, out += 6 ) {
+					if( order[j] == SampleOrder::absent ) {
+						std::fill( out, out + 6, byte_t( 0 )) ;
+					} else {
+						std::copy( buffer + 6 * order[j], buffer + 6 * ( order[j] + 1 ), out ) ;
+					}
+				}
+			}
+
+			void reorder_samples_v12(
+				Context const& context,
+				byte_t const* buffer,
+				byte_t const* const end,
+				SampleOrder const& order,
+				Buffer* result
+			) {
+				v12::GenotypeDataBlock const pack( context, buffer, end ) ;
+				std::size_t const N = pack.numberOfSamples ;
+
+				// Work out where each sample's data starts.
+				std::size_t stored_bits[64] ;
+				for( uint32_t ploidy = 0; ploidy < 64; ++ploidy ) {
+					stored_bits[ ploidy ] = ( ploidy >= pack.ploidyExtent[0] && ploidy <= pack.ploidyExtent[1] )
+						? ( std::size_t( pack.bits ) * v12::number_of_stored_values( ploidy, pack.numberOfAlleles, pack.phased ))
+						: 0 ;
+				}
+				std::vector< std::size_t > bit_offsets( N + 1, 0 ) ;
+				for( std::size_t i = 0; i < N; ++i ) {
+					uint32_t const ploidy = pack.ploidy[i] & 0x3F ;
+					if( ploidy < pack.ploidyExtent[0] || ploidy > pack.ploidyExtent[1] ) {
+						throw BGenError() ;
+					}
+					bit_offsets[i+1] = bit_offsets[i] + stored_bits[ ploidy ] ;
+				}
+				if( pack.buffer + ( bit_offsets[N] + 7 ) / 8 > pack.end ) {
+					throw BGenError() ;
+				}
+
+				// Absent samples are missing, with the maximum ploidy; the ploidy extent is recomputed
+				// as dropped samples may have had the extreme ploidies.
+				byte_t const absent_ploidy = pack.ploidyExtent[1] ;
+				std::size_t total_bits = 0 ;
+				byte_t min_ploidy = 63, max_ploidy = 0 ;
+				for( std::size_t j = 0; j < order.size(); ++j ) {
+					byte_t const ploidy = ( order[j] == SampleOrder::absent ) ? absent_ploidy : byte_t( pack.ploidy[ order[j] ] & 0x3F ) ;
+					min_ploidy = std::min( min_ploidy, ploidy ) ;
+					max_ploidy = std::max( max_ploidy, ploidy ) ;
+					total_bits += stored_bits[ ploidy ] ;
+				}
+				if( order.size() == 0 ) {
+					min_ploidy = pack.ploidyExtent[0] ;
+					max_ploidy = pack.ploidyExtent[1] ;
+				}
+
+				std::size_t const header_size = 4 + 2 + 2 + order.size() + 2 ;
+				result->resize( header_size + ( total_bits + 7 ) / 8 ) ;
+				byte_t* out = &(*result)[0] ;
+				byte_t* const out_end = out + result->size() ;
+				out = write_little_endian_integer( out, out_end, uint32_t( order.size() )) ;
+				out = write_little_endian_integer( out, out_end, pack.numberOfAlleles ) ;
+				*out++ = min_ploidy ;
+				*out++ = max_ploidy ;
+				for( std::size_t j = 0; j < order.size(); ++j ) {
+					*out++ = ( order[j] == SampleOrder::absent ) ? byte_t( absent_ploidy | 0x80 ) : pack.ploidy[ order[j] ] ;
+				}
+				*out++ = pack.phased ? 1 : 0 ;
+				*out++ = pack.bits ;
+
+				BitWriter writer( out ) ;
+				for( std::size_t j = 0; j < order.size(); ++j ) {
+					std::size_t const i = order[j] ;
+					if( i == SampleOrder::absent ) {
+						writer.skip( stored_bits[ absent_ploidy ] ) ;
+					} else {
+						writer.copy( pack.buffer, pack.end, bit_offsets[i], bit_offsets[i+1] - bit_offsets[i] ) ;
+					}
+				}
+				byte_t* const data_end = writer.finalise() ;
+				assert( data_end == out_end ) ;
+			}
+		}
+
+		void reorder_samples(
+			Context const& context,
+			byte_t const* buffer,
+			byte_t const* const end,
+			SampleOrder const& order,
+			Buffer* result
+		) {
+			if( order.number_of_samples() != context.number_of_samples ) {
+				throw std::invalid_argument(
+					"sample order is for " + std::to_string( order.number_of_samples() ) + " samples (expected "
+					+ std::to_string( context.number_of_samples ) + ")"
+				) ;
+			}
+			if( ( context.flags & e_Layout ) == e_Layout2 ) {
+				reorder_samples_v12( context, buffer, end, order, result ) ;
+			} else {
+				reorder_samples_v11( context, buffer, end, order, result ) ;
+			}
+		}
+	}
+}
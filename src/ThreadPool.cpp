@@ -0,0 +1,87 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <future>
+#include <algorithm>
+#include "genfile/ThreadPool.hpp"
+
+namespace genfile {
+	ThreadPool::ThreadPool( std::size_t number_of_threads ):
+		m_stopping( false )
+	{
+		if( number_of_threads == 0 ) {
+			number_of_threads = std::max( 1u, std::thread::hardware_concurrency() ) ;
+		}
+		for( std::size_t i = 0; i < number_of_threads; ++i ) {
+			m_threads.push_back( std::thread( [this]() { run() ; } )) ;
+		}
+	}
+
+	ThreadPool::~ThreadPool() {
+		{
+			std::unique_lock< std::mutex > lock( m_mutex ) ;
+			m_stopping = true ;
+		}
+		m_condition.notify_all() ;
+		for( std::size_t i = 0; i < m_threads.size(); ++i ) {
+			m_threads[i].join() ;
+		}
+	}
+
+	void ThreadPool::enqueue( std::function< void() > task ) {
+		{
+			std::unique_lock< std::mutex > lock( m_mutex ) ;
+			m_queue.push_back( std::move( task )) ;
+		}
+		m_condition.notify_one() ;
+	}
+
+	void ThreadPool::run() {
+		while( true ) {
+			std::function< void() > task ;
+			{
+				std::unique_lock< std::mutex > lock( m_mutex ) ;
+				m_condition.wait( lock, [this]() { return m_stopping || !m_queue.empty() ; } ) ;
+				if( m_queue.empty() ) {
+					// stopping, and no work left.
+					return ;
+				}
+				task = std::move( m_queue.front() ) ;
+				m_queue.pop_front() ;
+			}
+			task() ;
+		}
+	}
+
+	void ThreadPool::parallel_for( std::size_t begin, std::size_t end, std::function< void( std::size_t ) > const& f ) {
+		if( end <= begin ) {
+			return ;
+		}
+		// Use a few chunks per thread to even out load.
+		std::size_t const number_of_chunks = std::min( end - begin, 4 * m_threads.size() ) ;
+		std::size_t const chunk_size = ( end - begin + number_of_chunks - 1 ) / number_of_chunks ;
+		std::vector< std::future< void > > results ;
+		for( std::size_t chunk_begin = begin; chunk_begin < end; chunk_begin += chunk_size ) {
+			std::size_t const chunk_end = std::min( chunk_begin + chunk_size, end ) ;
+			results.push_back(
+				submit( [&f,chunk_begin,chunk_end]() {
+					for( std::size_t i = chunk_begin; i < chunk_end; ++i ) {
+						f( i ) ;
+					}
+				})
+			) ;
+		}
+		for( std::size_t i = 0; i < results.size(); ++i ) {
+			results[i].wait() ;
+		}
+		for( std::size_t i = 0; i < results.size(); ++i ) {
+			results[i].get() ;
+		}
+	}
+}
@@ -0,0 +1,711 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "zstd.h"
+#include "genfile/bgen.hpp"
+#include "genfile/Buffer.hpp"
+#include "genfile/zlib.hpp"
+#include "genfile/dosage.hpp"
+#include "genfile/View.hpp"
+#include "genfile/TransposedSidecar.hpp"
+
+/*
+* File layout (all integers little-endian):
+*   offset 0:   8-byte magic "bgentsp\0"
+*   offset 8:   uint32 format version (currently 1)
+*   offset 12:  uint32 reserved (zero)
+*   offset 16:  uint64 number of samples N
+*   offset 24:  uint64 number of variants M
+*   offset 32:  uint32 sample chunk size S
+*   offset 36:  uint32 maximum variant block size
+*   offset 40:  uint64 number of variant blocks
+*   offset 48:  uint64 position of chromosome table
+*   offset 56:  uint64 position of run table
+*   offset 64:  uint64 position of variant table
+*   offset 72:  uint64 position of block table
+*   offset 80:  uint64 position of tile index
+*   offset 88:  int64 bgen file size
+*   offset 96:  int64 bgen file last write time
+*   offset 104: uint32 length L of stored first bytes of bgen file
+*   offset 108: L bytes of bgen file data
+* The compressed tiles follow, starting at a 4096-byte aligned position, and then:
+* - the chromosome table: uint32 count, then each name as a uint16 length followed by the name.
+* - the run table, describing maximal runs of variants on the same chromosome:
+*   uint32 count, then for each run uint32 chromosome index, uint32 flag (1 if positions are sorted),
+*   uint64 first variant, uint64 one past the last variant.
+* - the variant table, with a 16-byte record for each variant: uint64 bgen file offset,
+*   uint32 position, uint16 chromosome index, uint8 phased flag, uint8 reserved.
+* - the block table, giving the uint64 index of the first variant in each block.
+* - the tile index, giving uint64 file offset and uint64 compressed size of each tile,
+*   ordered by sample chunk and then variant block.
+*/
+
+namespace genfile {
+	namespace bgen {
+		namespace {
+			char const magic[8] = { 'b', 'g', 'e', 'n', 't', 's', 'p', '\0' } ;
+			uint32_t const format_version = 1 ;
+			std::size_t const fixed_header_size = 108 ;
+			std::size_t const variant_record_size = 16 ;
+			std::size_t const data_alignment = 4096 ;
+
+			std::size_t round_up( std::size_t value, std::size_t alignment ) {
+				return (( value + alignment - 1 ) / alignment ) * alignment ;
+			}
+
+			struct VariantRecord {
+				uint64_t file_position ;
+				uint32_t position ;
+				uint16_t chromosome ;
+				uint8_t phased ;
+			} ;
+
+			struct TileLocation {
+				uint64_t offset ;
+				uint64_t size ;
+			} ;
+
+			// Removes the given files, if they exist, when it goes out of scope,
+			// so that temporary files are not left behind if build() throws.
+			struct TemporaryFiles {
+				TemporaryFiles( std::vector< std::string > const& filenames ): m_filenames( filenames ) {}
+				~TemporaryFiles() {
+					for( std::string const& filename: m_filenames ) {
+						std::remove( filename.c_str() ) ;
+					}
+				}
+			private:
+				std::vector< std::string > const m_filenames ;
+			} ;
+
+			// Quantise a value stored with the given maximum to units of 1/255.
+			uint8_t rescale( uint64_t value, uint64_t max ) {
+				return uint8_t(( std::min( value, max ) * 255 + max / 2 ) / max ) ;
+			}
+
+			// Uncompress the given genotype data block and store its ploidy bytes and probabilities
+			// in the given planes, as described in TransposedSidecar.hpp.
+			// Return false if the variant cannot be represented (i.e. it is not biallelic or has ploidy > 2).
+			bool decode_variant(
+				Context const& context,
+				std::vector< byte_t > const& raw,
+				Buffer* buffer,
+				byte_t* ploidy,
+				byte_t* first,
+				byte_t* second,
+				bool* phased
+			) {
+				uncompress_probability_data( context, raw, buffer ) ;
+				v12::GenotypeDataBlock pack( context, buffer->data(), buffer->data() + buffer->size() ) ;
+				if( pack.numberOfAlleles != 2 || pack.ploidyExtent[1] > 2 ) {
+					return false ;
+				}
+				*phased = pack.phased ;
+				uint32_t const N = pack.numberOfSamples ;
+				std::memcpy( ploidy, pack.ploidy, N ) ;
+				if( pack.bits == 8 && pack.ploidyExtent[0] == 2 ) {
+					// Common case: diploid 8-bit data is stored as two bytes per sample already.
+					if( pack.end < pack.buffer + 2 * std::size_t( N )) {
+						throw BGenError() ;
+					}
+					byte_t const* p = pack.buffer ;
+					for( uint32_t i = 0; i < N; ++i, p += 2 ) {
+						bool const missing = ( ploidy[i] & 0x80 ) ;
+						first[i] = missing ? 0 : p[0] ;
+						second[i] = missing ? 0 : p[1] ;
+					}
+					return true ;
+				}
+				v12::impl::IntegerBitParser parser( pack.buffer, pack.end, pack.bits ) ;
+				uint64_t const max = parser.maximum() ;
+				for( uint32_t i = 0; i < N; ++i ) {
+					// Biallelic samples store one value per chromosome whether phased or not.
+					uint32_t const sample_ploidy = ploidy[i] & 0x3F ;
+					if( !parser.check( sample_ploidy )) {
+						throw BGenError() ;
+					}
+					uint64_t const v0 = ( sample_ploidy > 0 ) ? parser.next() : 0 ;
+					uint64_t const v1 = ( sample_ploidy > 1 ) ? parser.next() : 0 ;
+					uint8_t a = 0, b = 0 ;
+					if( ( ploidy[i] & 0x80 ) || sample_ploidy == 0 ) {
+						// leave as zero.
+					} else if( pack.phased ) {
+						a = rescale( v0, max ) ;
+						b = ( sample_ploidy == 2 ) ? rescale( v1, max ) : 0 ;
+					} else if( sample_ploidy == 1 ) {
+						a = rescale( v0, max ) ;
+						b = 255 - a ;
+					} else {
+						a = rescale( v0, max ) ;
+						b = rescale( v1, max ) ;
+						if( uint32_t( a ) + b > 255 ) {
+							b = 255 - a ;
+						}
+					}
+					first[i] = a ;
+					second[i] = b ;
+				}
+				return true ;
+			}
+
+			void write_tile( std::ostream& stream, std::vector< byte_t > const& tile ) {
+				stream.write( reinterpret_cast< char const* >( tile.data() ), tile.size() ) ;
+			}
+		}
+
+		std::string TransposedSidecar::default_filename( std::string const& bgen_filename ) {
+			return bgen_filename + ".transposed" ;
+		}
+
+		void TransposedSidecar::build(
+			View& view,
+			std::string const& filename,
+			ThreadPool& pool,
+			BuildOptions const& options,
+			ProgressCallback callback
+		) {
+			Context const& context = view.context() ;
+			if( ( context.flags & e_Layout ) != e_Layout2 ) {
+				throw std::invalid_argument( "TransposedSidecar::build(): only layout 2 bgen files are supported." ) ;
+			}
+			std::size_t const N = context.number_of_samples ;
+			std::size_t const S = std::max( std::size_t( 1 ), options.sample_chunk_size ) ;
+			std::size_t const number_of_chunks = ( N + S - 1 ) / S ;
+			// Budget for the decoded block, the compressed tiles, and the raw input data.
+			std::size_t const B = std::max(
+				std::size_t( 1 ),
+				std::min(
+					std::min( options.variant_block_size, std::size_t( std::numeric_limits< uint32_t >::max() )),
+					options.memory_limit / ( 8 * std::max( N, std::size_t( 1 )))
+				)
+			) ;
+
+			std::string const temporary_filename = filename + ".tmp" ;
+			std::string const tiles_filename = filename + ".tmp.tiles" ;
+			TemporaryFiles const temporary_files( { tiles_filename, temporary_filename } ) ;
+
+			std::vector< VariantRecord > variants ;
+			std::vector< std::string > chromosomes ;
+			std::map< std::string, uint16_t > chromosome_ids ;
+			std::vector< Run > runs ;
+			std::vector< uint64_t > block_starts ;
+			// tile_locations[b][c] is the location in the tiles file of the tile for block b and chunk c.
+			std::vector< std::vector< TileLocation > > tile_locations ;
+
+			// Pass 1: decode blocks of variants, transpose into tiles, and write tiles in variant order.
+			{
+				std::ofstream tiles_stream( tiles_filename.c_str(), std::ios::binary | std::ios::trunc ) ;
+				if( !tiles_stream ) {
+					throw std::invalid_argument( tiles_filename ) ;
+				}
+				std::vector< std::vector< byte_t > > raw( B ) ;
+				std::vector< VariantRecord > block_variants( B ) ;
+				std::vector< char > keep( B ) ;
+				std::vector< byte_t > block( 3 * B * N ) ;
+				std::vector< std::vector< byte_t > > tiles( number_of_chunks ) ;
+				uint64_t tiles_position = 0 ;
+
+				std::string SNPID, rsid, chromosome ;
+				uint32_t position ;
+				std::vector< std::string > alleles ;
+				std::size_t variant_count = 0 ;
+				bool more = true ;
+				while( more ) {
+					// Read raw data for the next block of biallelic variants.
+					std::size_t count = 0 ;
+					while( count < B ) {
+						std::streampos const file_position = view.current_file_position() ;
+						if( !view.read_variant( &SNPID, &rsid, &chromosome, &position, &alleles )) {
+							more = false ;
+							break ;
+						}
+						if( alleles.size() == 2 ) {
+							std::map< std::string, uint16_t >::const_iterator where = chromosome_ids.find( chromosome ) ;
+							if( where == chromosome_ids.end() ) {
+								if( chromosomes.size() == std::numeric_limits< uint16_t >::max() ) {
+									throw std::invalid_argument( "TransposedSidecar::build(): too many chromosomes." ) ;
+								}
+								where = chromosome_ids.insert( std::make_pair( chromosome, uint16_t( chromosomes.size() ))).first ;
+								chromosomes.push_back( chromosome ) ;
+							}
+							VariantRecord& record = block_variants[count] ;
+							record.file_position = file_position ;
+							record.position = position ;
+							record.chromosome = where->second ;
+							view.read_raw_genotype_data_block( &raw[count] ) ;
+							++count ;
+						} else {
+							view.ignore_genotype_data_block() ;
+						}
+						if( callback ) {
+							callback( ++variant_count, view.number_of_variants() ) ;
+						}
+					}
+					if( count == 0 ) {
+						break ;
+					}
+
+					// Decode in parallel.  Variants are stored in three planes of B rows of N bytes.
+					pool.parallel_for(
+						0, count,
+						[&]( std::size_t i ) {
+							thread_local Buffer buffer ;
+							bool phased = false ;
+							keep[i] = decode_variant(
+								context, raw[i], &buffer,
+								&block[ i * N ], &block[ ( B + i ) * N ], &block[ ( 2 * B + i ) * N ],
+								&phased
+							) ;
+							block_variants[i].phased = phased ;
+						}
+					) ;
+
+					// Drop variants that could not be represented, and record the remainder.
+					std::size_t K = 0 ;
+					for( std::size_t i = 0; i < count; ++i ) {
+						if( !keep[i] ) {
+							continue ;
+						}
+						if( K != i ) {
+							for( std::size_t plane = 0; plane < 3; ++plane ) {
+								std::memmove( &block[ ( plane * B + K ) * N ], &block[ ( plane * B + i ) * N ], N ) ;
+							}
+						}
+						VariantRecord const& record = block_variants[i] ;
+						uint64_t const index = variants.size() ;
+						if( runs.empty() || runs.back().chromosome != record.chromosome ) {
+							Run run ;
+							run.chromosome = record.chromosome ;
+							run.sorted = true ;
+							run.begin = index ;
+							run.end = index ;
+							runs.push_back( run ) ;
+						} else if( record.position < variants.back().position ) {
+							runs.back().sorted = false ;
+						}
+						++runs.back().end ;
+						variants.push_back( record ) ;
+						++K ;
+					}
+					if( K == 0 ) {
+						continue ;
+					}
+					block_starts.push_back( variants.size() - K ) ;
+
+					// Transpose and compress tiles in parallel.
+					pool.parallel_for(
+						0, number_of_chunks,
+						[&]( std::size_t c ) {
+							thread_local std::vector< byte_t > tile ;
+							std::size_t const first_sample = c * S ;
+							std::size_t const chunk_size = std::min( S, N - first_sample ) ;
+							tile.resize( chunk_size * 3 * K ) ;
+							for( std::size_t plane = 0; plane < 3; ++plane ) {
+								for( std::size_t v = 0; v < K; ++v ) {
+									byte_t const* row = &block[ ( plane * B + v ) * N + first_sample ] ;
+									byte_t* out = &tile[ plane * K + v ] ;
+									for( std::size_t s = 0; s < chunk_size; ++s, out += 3 * K ) {
+										*out = row[s] ;
+									}
+								}
+							}
+							zstd_compress( tile.data(), tile.data() + tile.size(), &tiles[c], 0, options.compression_level ) ;
+						}
+					) ;
+
+					tile_locations.push_back( std::vector< TileLocation >( number_of_chunks )) ;
+					for( std::size_t c = 0; c < number_of_chunks; ++c ) {
+						tile_locations.back()[c].offset = tiles_position ;
+						tile_locations.back()[c].size = tiles[c].size() ;
+						write_tile( tiles_stream, tiles[c] ) ;
+						tiles_position += tiles[c].size() ;
+					}
+				}
+				tiles_stream.close() ;
+				if( !tiles_stream ) {
+					throw std::invalid_argument( "TransposedSidecar::build(): failed to write \"" + tiles_filename + "\"." ) ;
+				}
+			}
+
+			// Pass 2: rearrange tiles into sample chunk order and write the final file.
+			{
+				FileMetadata const& metadata = view.file_metadata() ;
+				std::size_t const number_of_blocks = block_starts.size() ;
+				std::size_t const data_position = round_up( fixed_header_size + metadata.first_bytes.size(), data_alignment ) ;
+				std::ifstream tiles_stream( tiles_filename.c_str(), std::ios::binary ) ;
+				std::ofstream out( temporary_filename.c_str(), std::ios::binary | std::ios::trunc ) ;
+				if( !tiles_stream || !out ) {
+					throw std::invalid_argument( temporary_filename ) ;
+				}
+				std::vector< byte_t > buffer( data_position, 0 ) ;
+				out.write( reinterpret_cast< char const* >( buffer.data() ), data_position ) ;
+
+				std::vector< TileLocation > final_locations ;
+				final_locations.reserve( number_of_chunks * number_of_blocks ) ;
+				uint64_t position = data_position ;
+				for( std::size_t c = 0; c < number_of_chunks; ++c ) {
+					for( std::size_t b = 0; b < number_of_blocks; ++b ) {
+						TileLocation const& location = tile_locations[b][c] ;
+						buffer.resize( location.size ) ;
+						tiles_stream.seekg( location.offset ) ;
+						tiles_stream.read( reinterpret_cast< char* >( buffer.data() ), location.size ) ;
+						out.write( reinterpret_cast< char const* >( buffer.data() ), location.size ) ;
+						TileLocation final_location ;
+						final_location.offset = position ;
+						final_location.size = location.size ;
+						final_locations.push_back( final_location ) ;
+						position += location.size ;
+					}
+				}
+				tiles_stream.close() ;
+				std::remove( tiles_filename.c_str() ) ;
+
+				// Chromosome table
+				uint64_t const chromosome_table_position = position ;
+				write_little_endian_integer( out, uint32_t( chromosomes.size() )) ;
+				position += 4 ;
+				for( std::size_t i = 0; i < chromosomes.size(); ++i ) {
+					write_length_followed_by_data( out, uint16_t( chromosomes[i].size() ), chromosomes[i] ) ;
+					position += 2 + chromosomes[i].size() ;
+				}
+				// Run table
+				uint64_t const run_table_position = position ;
+				write_little_endian_integer( out, uint32_t( runs.size() )) ;
+				for( std::size_t i = 0; i < runs.size(); ++i ) {
+					write_little_endian_integer( out, uint32_t( runs[i].chromosome )) ;
+					write_little_endian_integer( out, uint32_t( runs[i].sorted ? 1 : 0 )) ;
+					write_little_endian_integer( out, runs[i].begin ) ;
+					write_little_endian_integer( out, runs[i].end ) ;
+				}
+				position += 4 + 24 * runs.size() ;
+				// Variant table
+				uint64_t const variant_table_position = position ;
+				for( std::size_t i = 0; i < variants.size(); ++i ) {
+					write_little_endian_integer( out, variants[i].file_position ) ;
+					write_little_endian_integer( out, variants[i].position ) ;
+					write_little_endian_integer( out, variants[i].chromosome ) ;
+					write_little_endian_integer( out, variants[i].phased ) ;
+					write_little_endian_integer( out, uint8_t( 0 )) ;
+				}
+				position += variant_record_size * variants.size() ;
+				// Block table
+				uint64_t const block_table_position = position ;
+				for( std::size_t b = 0; b < number_of_blocks; ++b ) {
+					write_little_endian_integer( out, block_starts[b] ) ;
+				}
+				position += 8 * number_of_blocks ;
+				// Tile index
+				uint64_t const tile_index_position = position ;
+				for( std::size_t i = 0; i < final_locations.size(); ++i ) {
+					write_little_endian_integer( out, final_locations[i].offset ) ;
+					write_little_endian_integer( out, final_locations[i].size ) ;
+				}
+
+				// Header
+				out.seekp( 0 ) ;
+				out.write( magic, 8 ) ;
+				write_little_endian_integer( out, format_version ) ;
+				write_little_endian_integer( out, uint32_t( 0 )) ;
+				write_little_endian_integer( out, uint64_t( N )) ;
+				write_little_endian_integer( out, uint64_t( variants.size() )) ;
+				write_little_endian_integer( out, uint32_t( S )) ;
+				write_little_endian_integer( out, uint32_t( B )) ;
+				write_little_endian_integer( out, uint64_t( number_of_blocks )) ;
+				write_little_endian_integer( out, chromosome_table_position ) ;
+				write_little_endian_integer( out, run_table_position ) ;
+				write_little_endian_integer( out, variant_table_position ) ;
+				write_little_endian_integer( out, block_table_position ) ;
+				write_little_endian_integer( out, tile_index_position ) ;
+				write_little_endian_integer( out, int64_t( metadata.size )) ;
+				write_little_endian_integer( out, int64_t( metadata.last_write_time )) ;
+				write_little_endian_integer( out, uint32_t( metadata.first_bytes.size() )) ;
+				out.write( reinterpret_cast< char const* >( metadata.first_bytes.data() ), metadata.first_bytes.size() ) ;
+				out.close() ;
+				if( !out ) {
+					throw std::invalid_argument( "TransposedSidecar::build(): failed to write \"" + temporary_filename + "\"." ) ;
+				}
+			}
+			if( std::rename( temporary_filename.c_str(), filename.c_str() ) != 0 ) {
+				throw std::invalid_argument( "TransposedSidecar::build(): could not rename \"" + temporary_filename + "\" to \"" + filename + "\"." ) ;
+			}
+		}
+
+		TransposedSidecar::UniquePtr TransposedSidecar::open( std::string const& filename ) {
+			return UniquePtr( new TransposedSidecar( filename )) ;
+		}
+
+		TransposedSidecar::TransposedSidecar( std::string const& filename ):
+			m_filename( filename ),
+			m_data( 0 ),
+			m_size( 0 )
+		{
+			int fd = ::open( filename.c_str(), O_RDONLY ) ;
+			if( fd < 0 ) {
+				throw std::invalid_argument( filename ) ;
+			}
+			struct stat st ;
+			if( fstat( fd, &st ) != 0 || std::size_t( st.st_size ) < fixed_header_size ) {
+				::close( fd ) ;
+				throw std::invalid_argument( "TransposedSidecar: file \"" + filename + "\" is not a transposed sidecar file." ) ;
+			}
+			m_size = st.st_size ;
+			void* data = mmap( 0, m_size, PROT_READ, MAP_SHARED, fd, 0 ) ;
+			::close( fd ) ;
+			if( data == MAP_FAILED ) {
+				throw std::invalid_argument( "TransposedSidecar: could not map file \"" + filename + "\"." ) ;
+			}
+			m_data = reinterpret_cast< byte_t const* >( data ) ;
+
+			byte_t const* const end = m_data + m_size ;
+			byte_t const* p = m_data ;
+			uint32_t version = 0, reserved = 0, sample_chunk_size = 0, variant_block_size = 0, first_bytes_size = 0 ;
+			uint64_t number_of_samples = 0, number_of_variants = 0, number_of_blocks = 0 ;
+			uint64_t chromosome_table_position = 0, run_table_position = 0, variant_table_position = 0, block_table_position = 0, tile_index_position = 0 ;
+			int64_t bgen_size = 0, bgen_last_write_time = 0 ;
+			bool valid = ( std::memcmp( p, magic, 8 ) == 0 ) ;
+			p += 8 ;
+			p = read_little_endian_integer( p, end, &version ) ;
+			p = read_little_endian_integer( p, end, &reserved ) ;
+			p = read_little_endian_integer( p, end, &number_of_samples ) ;
+			p = read_little_endian_integer( p, end, &number_of_variants ) ;
+			p = read_little_endian_integer( p, end, &sample_chunk_size ) ;
+			p = read_little_endian_integer( p, end, &variant_block_size ) ;
+			p = read_little_endian_integer( p, end, &number_of_blocks ) ;
+			p = read_little_endian_integer( p, end, &chromosome_table_position ) ;
+			p = read_little_endian_integer( p, end, &run_table_position ) ;
+			p = read_little_endian_integer( p, end, &variant_table_position ) ;
+			p = read_little_endian_integer( p, end, &block_table_position ) ;
+			p = read_little_endian_integer( p, end, &tile_index_position ) ;
+			p = read_little_endian_integer( p, end, &bgen_size ) ;
+			p = read_little_endian_integer( p, end, &bgen_last_write_time ) ;
+			p = read_little_endian_integer( p, end, &first_bytes_size ) ;
+			std::size_t const number_of_chunks = sample_chunk_size == 0 ? 0 : ( number_of_samples + sample_chunk_size - 1 ) / sample_chunk_size ;
+			valid = valid
+				&& version == format_version
+				&& sample_chunk_size > 0
+				&& std::ptrdiff_t( first_bytes_size ) <= ( end - p )
+				&& chromosome_table_position <= run_table_position
+				&& run_table_position <= variant_table_position
+				&& variant_table_position + variant_record_size * number_of_variants == block_table_position
+				&& block_table_position + 8 * number_of_blocks == tile_index_position
+				&& tile_index_position + 16 * number_of_chunks * number_of_blocks <= m_size ;
+			if( !valid ) {
+				munmap( const_cast< byte_t* >( m_data ), m_size ) ;
+				throw std::invalid_argument( "TransposedSidecar: file \"" + filename + "\" is not a valid transposed sidecar file." ) ;
+			}
+			m_bgen_metadata.size = bgen_size ;
+			m_bgen_metadata.last_write_time = bgen_last_write_time ;
+			m_bgen_metadata.first_bytes.assign( p, p + first_bytes_size ) ;
+			m_number_of_samples = number_of_samples ;
+			m_number_of_variants = number_of_variants ;
+			m_sample_chunk_size = sample_chunk_size ;
+			m_variant_block_size = variant_block_size ;
+			m_variant_table_position = variant_table_position ;
+			m_tile_index_position = tile_index_position ;
+
+			try {
+				// Load the (small) chromosome, run and block tables.
+				p = m_data + chromosome_table_position ;
+				uint32_t count = 0 ;
+				p = read_little_endian_integer( p, end, &count ) ;
+				for( uint32_t i = 0; i < count; ++i ) {
+					uint16_t length ;
+					p = read_little_endian_integer( p, end, &length ) ;
+					if( end - p < length ) {
+						throw BGenError() ;
+					}
+					m_chromosomes.push_back( std::string( p, p + length )) ;
+					p += length ;
+				}
+				p = m_data + run_table_position ;
+				p = read_little_endian_integer( p, end, &count ) ;
+				for( uint32_t i = 0; i < count; ++i ) {
+					uint32_t chromosome, sorted ;
+					Run run ;
+					p = read_little_endian_integer( p, end, &chromosome ) ;
+					p = read_little_endian_integer( p, end, &sorted ) ;
+					p = read_little_endian_integer( p, end, &run.begin ) ;
+					p = read_little_endian_integer( p, end, &run.end ) ;
+					run.chromosome = chromosome ;
+					run.sorted = sorted ;
+					if( run.begin > run.end || run.end > m_number_of_variants ) {
+						throw BGenError() ;
+					}
+					m_runs.push_back( run ) ;
+				}
+				p = m_data + block_table_position ;
+				m_block_starts.resize( number_of_blocks ) ;
+				for( uint64_t b = 0; b < number_of_blocks; ++b ) {
+					p = read_little_endian_integer( p, end, &m_block_starts[b] ) ;
+				}
+			} catch( BGenError const& ) {
+				munmap( const_cast< byte_t* >( m_data ), m_size ) ;
+				throw std::invalid_argument( "TransposedSidecar: file \"" + filename + "\" is not a valid transposed sidecar file." ) ;
+			}
+		}
+
+		TransposedSidecar::~TransposedSidecar() {
+			munmap( const_cast< byte_t* >( m_data ), m_size ) ;
+		}
+
+		bool TransposedSidecar::matches( FileMetadata const& metadata ) const {
+			return metadata.size == m_bgen_metadata.size
+				&& metadata.last_write_time == m_bgen_metadata.last_write_time
+				&& metadata.first_bytes == m_bgen_metadata.first_bytes ;
+		}
+
+		uint64_t TransposedSidecar::variant_file_position( std::size_t i ) const {
+			uint64_t result ;
+			byte_t const* p = m_data + m_variant_table_position + variant_record_size * i ;
+			read_little_endian_integer( p, p + 8, &result ) ;
+			return result ;
+		}
+
+		uint32_t TransposedSidecar::variant_position( std::size_t i ) const {
+			uint32_t result ;
+			byte_t const* p = m_data + m_variant_table_position + variant_record_size * i + 8 ;
+			read_little_endian_integer( p, p + 4, &result ) ;
+			return result ;
+		}
+
+		bool TransposedSidecar::variant_phased( std::size_t i ) const {
+			return m_data[ m_variant_table_position + variant_record_size * i + 14 ] ;
+		}
+
+		void TransposedSidecar::find_variants( GenomicRange const& range, std::vector< uint64_t >* result ) const {
+			result->clear() ;
+			std::vector< std::string >::const_iterator where = std::find( m_chromosomes.begin(), m_chromosomes.end(), range.chromosome() ) ;
+			if( where == m_chromosomes.end() ) {
+				return ;
+			}
+			uint32_t const chromosome = uint32_t( where - m_chromosomes.begin() ) ;
+			for( std::size_t r = 0; r < m_runs.size(); ++r ) {
+				Run const& run = m_runs[r] ;
+				if( run.chromosome != chromosome ) {
+					continue ;
+				}
+				uint64_t begin = run.begin, end = run.end ;
+				if( run.sorted ) {
+					// Binary search for the first variant at or after the start of the range.
+					uint64_t lower = run.begin, upper = run.end ;
+					while( lower < upper ) {
+						uint64_t const mid = lower + ( upper - lower ) / 2 ;
+						if( variant_position( mid ) < range.start() ) {
+							lower = mid + 1 ;
+						} else {
+							upper = mid ;
+						}
+					}
+					begin = lower ;
+				}
+				for( uint64_t i = begin; i < end; ++i ) {
+					uint32_t const position = variant_position( i ) ;
+					if( position >= range.start() && position <= range.end() ) {
+						result->push_back( i ) ;
+					} else if( run.sorted && position > range.end() ) {
+						break ;
+					}
+				}
+			}
+		}
+
+		void TransposedSidecar::get_sample_genotypes(
+			std::size_t sample_index,
+			GenomicRange const& range,
+			SampleGenotypes* result
+		) const {
+			if( sample_index >= m_number_of_samples ) {
+				throw std::invalid_argument( "sample_index=" + std::to_string( sample_index )) ;
+			}
+			result->clear() ;
+			find_variants( range, &result->variant_indices ) ;
+			std::size_t const count = result->variant_indices.size() ;
+			result->file_positions.resize( count ) ;
+			result->positions.resize( count ) ;
+			result->ploidy.resize( count ) ;
+			result->phased.resize( count ) ;
+			result->probabilities.resize( 2 * count ) ;
+
+			std::size_t const chunk = sample_index / m_sample_chunk_size ;
+			std::size_t const sample_in_chunk = sample_index % m_sample_chunk_size ;
+			std::size_t const chunk_size = std::min( m_sample_chunk_size, m_number_of_samples - chunk * m_sample_chunk_size ) ;
+			std::size_t const number_of_blocks = m_block_starts.size() ;
+
+			std::vector< byte_t > tile ;
+			std::size_t current_block = std::numeric_limits< std::size_t >::max() ;
+			std::size_t block_size = 0 ;
+			for( std::size_t i = 0; i < count; ++i ) {
+				uint64_t const variant = result->variant_indices[i] ;
+				std::size_t const block = std::upper_bound( m_block_starts.begin(), m_block_starts.end(), variant ) - m_block_starts.begin() - 1 ;
+				if( block != current_block ) {
+					uint64_t const block_end = ( block + 1 < number_of_blocks ) ? m_block_starts[ block + 1 ] : m_number_of_variants ;
+					block_size = block_end - m_block_starts[ block ] ;
+					byte_t const* p = m_data + m_tile_index_position + 16 * ( chunk * number_of_blocks + block ) ;
+					uint64_t offset, size ;
+					p = read_little_endian_integer( p, p + 8, &offset ) ;
+					p = read_little_endian_integer( p, p + 8, &size ) ;
+					if( offset + size > m_size ) {
+						throw std::invalid_argument( "TransposedSidecar: file \"" + m_filename + "\" is truncated." ) ;
+					}
+					tile.resize( chunk_size * 3 * block_size ) ;
+					std::size_t const decompressed = ZSTD_decompress( tile.data(), tile.size(), m_data + offset, size ) ;
+					if( ZSTD_isError( decompressed ) || decompressed != tile.size() ) {
+						throw std::invalid_argument( "TransposedSidecar: file \"" + m_filename + "\" is corrupt." ) ;
+					}
+					current_block = block ;
+				}
+				std::size_t const v = variant - m_block_starts[ block ] ;
+				byte_t const* row = &tile[ sample_in_chunk * 3 * block_size ] ;
+				result->file_positions[i] = variant_file_position( variant ) ;
+				result->positions[i] = variant_position( variant ) ;
+				result->phased[i] = variant_phased( variant ) ;
+				result->ploidy[i] = row[ v ] ;
+				result->probabilities[ 2*i ] = row[ block_size + v ] ;
+				result->probabilities[ 2*i + 1 ] = row[ 2 * block_size + v ] ;
+			}
+		}
+
+		double TransposedSidecar::SampleGenotypes::dosage( std::size_t i ) const {
+			if( is_missing( i )) {
+				return std::numeric_limits< double >::quiet_NaN() ;
+			}
+			uint32_t const ploidy_i = ploidy[i] & 0x3F ;
+			uint32_t const a = probabilities[ 2*i ] ;
+			uint32_t const b = probabilities[ 2*i + 1 ] ;
+			if( ploidy_i == 0 ) {
+				return 0.0 ;
+			} else if( phased[i] ) {
+				return ( ( 255 - a ) + ( ploidy_i == 2 ? ( 255 - b ) : 0 )) / 255.0 ;
+			} else if( ploidy_i == 1 ) {
+				return b / 255.0 ;
+			} else {
+				return ( b + 2 * ( 255 - std::min( a + b, 255u ))) / 255.0 ;
+			}
+		}
+
+		void TransposedSidecar::SampleGenotypes::clear() {
+			variant_indices.clear() ;
+			file_positions.clear() ;
+			positions.clear() ;
+			ploidy.clear() ;
+			phased.clear() ;
+			probabilities.clear() ;
+		}
+	}
+}
@@ -0,0 +1,73 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <string>
+#include <mutex>
+#include <fmt/format.h>
+#include "serve/VariantCache.hpp"
+
+namespace serve {
+	std::size_t CachedVariant::memory_used() const {
+		std::size_t result = sizeof( CachedVariant ) + SNPID.size() + rsid.size() + chromosome.size() + data.capacity() ;
+		for( std::string const& allele: alleles ) {
+			result += sizeof( std::string ) + allele.size() ;
+		}
+		return result ;
+	}
+
+	VariantCache::VariantCache( std::size_t capacity ):
+		m_capacity( capacity ),
+		m_size( 0 ),
+		m_hits( 0 ),
+		m_misses( 0 )
+	{}
+
+	VariantCache::Value VariantCache::find( Key const& key ) {
+		std::lock_guard< std::mutex > lock( m_mutex ) ;
+		Lookup::iterator where = m_lookup.find( key ) ;
+		if( where == m_lookup.end() ) {
+			++m_misses ;
+			return Value() ;
+		}
+		++m_hits ;
+		m_entries.splice( m_entries.begin(), m_entries, where->second ) ;
+		return where->second->second ;
+	}
+
+	void VariantCache::insert( Key const& key, Value const& value ) {
+		std::size_t const size = value->memory_used() ;
+		std::lock_guard< std::mutex > lock( m_mutex ) ;
+		if( size > m_capacity || m_lookup.find( key ) != m_lookup.end() ) {
+			return ;
+		}
+		m_entries.emplace_front( key, value ) ;
+		m_lookup[ key ] = m_entries.begin() ;
+		m_size += size ;
+		while( m_size > m_capacity ) {
+			m_size -= m_entries.back().second->memory_used() ;
+			m_lookup.erase( m_entries.back().first ) ;
+			m_entries.pop_back() ;
+		}
+	}
+
+	std::size_t VariantCache::number_of_entries() const {
+		std::lock_guard< std::mutex > lock( m_mutex ) ;
+		return m_entries.size() ;
+	}
+
+	std::size_t VariantCache::size() const {
+		std::lock_guard< std::mutex > lock( m_mutex ) ;
+		return m_size ;
+	}
+
+	std::string VariantCache::summarise_as_json() const {
+		std::lock_guard< std::mutex > lock( m_mutex ) ;
+		return fmt::format(
+			"{{\"entries\": {}, \"bytes\": {}, \"capacity_bytes\": {}, \"hits\": {}, \"misses\": {}}}",
+			m_entries.size(), m_size, m_capacity, m_hits, m_misses
+		) ;
+	}
+}
@@ -10,6 +10,7 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 
 #include <fmt/format.h>
 #include <filesystem>
@@ -17,6 +18,8 @@
 #include "genfile/bgen.hpp"
 #include "genfile/IndexQuery.hpp"
 #include "genfile/View.hpp"
+#include "genfile/ForwardOnlyStreamBuf.hpp"
+#include "genfile/DosageSidecar.hpp"
 
 namespace genfile {
 	namespace bgen {
@@ -24,6 +27,40 @@ namespace genfile {
 			return View::UniquePtr( new View( filename )) ;
 		}
 
+		View::UniquePtr View::create_streaming(
+			std::unique_ptr< std::istream > stream,
+			std::string const& name,
+			std::size_t buffer_size
+		) {
+			if( !stream.get() || !*stream ) {
+				throw std::invalid_argument( name ) ;
+			}
+			std::unique_ptr< std::streambuf > streambuf = ForwardOnlyStreamBuf::create( *stream, buffer_size ) ;
+			return View::UniquePtr( new View( name, std::move( streambuf ), std::move( stream ))) ;
+		}
+
+		View::UniquePtr View::create_streaming(
+			int fd,
+			std::string const& name,
+			std::size_t buffer_size
+		) {
+			if( fd < 0 ) {
+				throw std::invalid_argument( name ) ;
+			}
+			std::unique_ptr< std::streambuf > streambuf = ForwardOnlyStreamBuf::create( fd, name, buffer_size ) ;
+			return View::UniquePtr( new View( name, std::move( streambuf ), std::unique_ptr< std::istream >() )) ;
+		}
+
+		View::UniquePtr View::create_from_path( std::string const& filename ) {
+			if( filename == "-" ) {
+				return create_streaming( 0, "(stdin)" ) ;
+			} else if( is_stream_input( filename )) {
+				return create_streaming( std::unique_ptr< std::istream >( new std::ifstream( filename, std::ios::binary )), filename ) ;
+			} else {
+				return create( filename ) ;
+			}
+		}
+
 		/* View implementation */
 		View::View( std::string const& filename ):
 			m_filename( filename ),
@@ -35,11 +72,34 @@ namespace genfile {
 			m_file_position = m_stream->tellg() ;
 		}
 
+		View::View(
+			std::string const& name,
+			std::unique_ptr< std::streambuf > streambuf,
+			std::unique_ptr< std::istream > source
+		):
+			m_filename( name ),
+			m_source( std::move( source )),
+			m_streambuf( std::move( streambuf )),
+			m_variant_i(0),
+			m_have_sample_ids( false ),
+			m_state( e_NotOpen )
+		{
+			m_stream.reset( new std::istream( m_streambuf.get() )) ;
+			// Size and first bytes cannot be known without reading the whole stream, so are left unset.
+			m_file_metadata.filename = name ;
+			m_state = e_Open ;
+			read_header( name ) ;
+			m_file_position = m_stream->tellg() ;
+		}
+
 		std::size_t View::number_of_samples() const {
 			return m_context.number_of_samples ;
 		}
 
 		void View::set_query( IndexQuery::UniquePtr query ) {
+			if( is_streaming() ) {
+				throw std::invalid_argument( "View::set_query(): \"" + m_filename + "\" is being read as a stream and cannot be queried." ) ;
+			}
                   m_index_query = std::move(query) ;
 			if( m_index_query->number_of_variants() > 0 ) {
 				m_stream->seekg( m_index_query->locate_variant(0).first ) ;
@@ -79,8 +139,12 @@ namespace genfile {
 			}
 			o << compression << " compression)" ;
 			o << " with " 
-				<< m_context.number_of_samples << " " << ( m_have_sample_ids ? "named" : "anonymous" ) << " samples and "
-				<< m_context.number_of_variants << " variants.\n" ;
+				<< m_context.number_of_samples << " " << ( m_have_sample_ids ? "named" : "anonymous" ) << " samples and " ;
+			if( m_context.number_of_variants == e_UnknownNumberOfVariants ) {
+				o << "an unknown number of variants.\n" ;
+			} else {
+				o << m_context.number_of_variants << " variants.\n" ;
+			}
 			if( m_index_query.get() ) {
 				o << "IndexQuery: query will return " << m_index_query->number_of_variants() << " variants.\n" ;
 			}
@@ -117,6 +181,9 @@ namespace genfile {
 				}
 				IndexQuery::FileRange const range = m_index_query->locate_variant( m_variant_i ) ;
 				m_stream->seekg( range.first ) ;
+				m_variant_position = range.first ;
+			} else {
+				m_variant_position = m_file_position ;
 			}
 
 			if(
@@ -134,6 +201,50 @@ namespace genfile {
 			}
 		}
 
+		std::size_t View::read_variant_batch(
+			std::size_t max_variants,
+			VariantBatch* batch,
+			bool include_genotype_data
+		) {
+			assert( m_state == e_ReadyForVariant ) ;
+			batch->clear() ;
+			std::string SNPID, rsid, chromosome ;
+			uint32_t position ;
+			std::size_t count = 0 ;
+			for( ; count < max_variants; ++count ) {
+				if( m_index_query.get() ) {
+					if( m_variant_i == m_index_query->number_of_variants() ) {
+						break ;
+					}
+					IndexQuery::FileRange const range = m_index_query->locate_variant( m_variant_i ) ;
+					m_stream->seekg( range.first ) ;
+					m_variant_position = range.first ;
+				} else {
+					m_variant_position = m_file_position ;
+				}
+				bool const success = genfile::bgen::read_snp_identifying_data(
+					*m_stream, m_context,
+					&SNPID, &rsid, &chromosome, &position,
+					[&]( std::size_t n ) { batch->add_variant( SNPID, rsid, chromosome, position, uint16_t( n )) ; },
+					[&]( std::size_t, std::string const& allele ) { batch->add_allele( allele ) ; }
+				) ;
+				if( !success ) {
+					break ;
+				}
+				if( include_genotype_data ) {
+					genfile::bgen::read_genotype_data_block( *m_stream, m_context, &m_buffer1 ) ;
+					batch->add_genotype_data_block( m_buffer1.data(), m_buffer1.data() + m_buffer1.size() ) ;
+				} else {
+					genfile::bgen::ignore_genotype_data_block( *m_stream, m_context ) ;
+				}
+				m_file_position = m_stream->tellg() ;
+				batch->file_offset.push_back( m_variant_position ) ;
+				batch->file_size.push_back( m_file_position - m_variant_position ) ;
+				++m_variant_i ;
+			}
+			return count ;
+		}
+
 		// Read and uncompress genotype probability data, and unpack
 		// it into constituent parts, but don't do a full parse.
 		// This can lead to more efficient code paths than a full parse for some operations.
@@ -145,11 +256,48 @@ namespace genfile {
 			genfile::bgen::v12::GenotypeDataBlock* pack
 		) {
 			assert( (m_context.flags & genfile::bgen::e_Layout) == genfile::bgen::e_Layout2 ) ;
-			std::vector< byte_t > const& buffer = read_and_uncompress_genotype_data_block() ;
+			Buffer const& buffer = read_and_uncompress_genotype_data_block() ;
 			pack->initialise( m_context, &buffer[0], &buffer[0] + buffer.size() ) ;
 			++m_variant_i ;
 		}
 
+		void View::read_raw_genotype_data_block( std::vector< byte_t >* buffer ) {
+			assert( m_state == e_ReadyForProbs ) ;
+			genfile::bgen::read_genotype_data_block( *m_stream, m_context, buffer ) ;
+			m_file_position = m_stream->tellg() ;
+			m_state = e_ReadyForVariant ;
+			++m_variant_i ;
+		}
+
+		void View::use_dosage_sidecar( std::string const& filename ) {
+			DosageSidecar::UniquePtr sidecar = DosageSidecar::open( filename ) ;
+			if( !sidecar->matches( m_file_metadata ) || sidecar->number_of_samples() != m_context.number_of_samples ) {
+				throw std::invalid_argument(
+					"Dosage sidecar \"" + filename + "\" does not match bgen file \"" + m_filename + "\". "
+					"Do you need to recreate it?"
+				) ;
+			}
+			m_dosage_sidecar = std::move( sidecar ) ;
+		}
+
+		void View::clear_dosage_sidecar() {
+			m_dosage_sidecar.reset() ;
+		}
+
+		void View::set_sample_order( SampleOrder const& order ) {
+			if( order.number_of_samples() != m_context.number_of_samples ) {
+				throw std::invalid_argument(
+					"View::set_sample_order(): order is for " + std::to_string( order.number_of_samples() )
+					+ " samples, but \"" + m_filename + "\" has " + std::to_string( m_context.number_of_samples ) + "."
+				) ;
+			}
+			m_sample_order.reset( new SampleOrder( order )) ;
+		}
+
+		void View::clear_sample_order() {
+			m_sample_order.reset() ;
+		}
+
 		// Ignore genotype probability data for the SNP just read using read_variant()
 		// After calling this method it should be safe to call read_variant()
 		// to fetch the next variant from the file.
@@ -194,8 +342,22 @@ namespace genfile {
 
 			m_state = e_Open ;
 
-			// Read the offset, header, and sample IDs if present.
 			m_stream->seekg( 0, std::ios::beg ) ;
+			read_header( filename ) ;
+
+			// Pick up a dosage sidecar if there is a current one.  Stale or unreadable sidecars are ignored.
+			std::string const sidecar_filename = DosageSidecar::default_filename( filename ) ;
+			if( std::filesystem::exists( sidecar_filename )) {
+				try {
+					use_dosage_sidecar( sidecar_filename ) ;
+				} catch( std::invalid_argument const& ) {
+					m_dosage_sidecar.reset() ;
+				}
+			}
+		}
+
+		void View::read_header( std::string const& filename ) {
+			// Read the offset, header, and sample IDs if present.
 			genfile::bgen::read_offset( *m_stream, &m_offset ) ;
 			genfile::bgen::read_header_block( *m_stream, &m_context ) ;
 
@@ -226,7 +388,7 @@ namespace genfile {
 
 		// Utility function to read and uncompress variant genotype probability data
 		// without further processing.
-		std::vector< byte_t > const& View::read_and_uncompress_genotype_data_block() {
+		Buffer const& View::read_and_uncompress_genotype_data_block() {
 			assert( m_state == e_ReadyForProbs ) ;
 			genfile::bgen::read_genotype_data_block( *m_stream, m_context, &m_buffer1 ) ;
 			m_file_position = m_stream->tellg() ;
@@ -0,0 +1,313 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <cassert>
+#include "genfile/bgen.hpp"
+#include "genfile/View.hpp"
+#include "genfile/ViewMerger.hpp"
+
+namespace genfile {
+	namespace bgen {
+		namespace {
+			std::vector< std::string > get_sample_ids( View const& view ) {
+				std::vector< std::string > result ;
+				result.reserve( view.number_of_samples() ) ;
+				view.get_sample_ids( [&result]( std::string const& id ) { result.push_back( id ) ; } ) ;
+				return result ;
+			}
+
+			bool have_same_alleles( VariantBatch const& batch, std::size_t i, std::size_t j ) {
+				if( batch.number_of_stored_alleles(i) != batch.number_of_stored_alleles(j) ) {
+					return false ;
+				}
+				for( std::size_t k = 0; k < batch.number_of_stored_alleles(i); ++k ) {
+					if( batch.allele( i, k ) != batch.allele( j, k ) ) {
+						return false ;
+					}
+				}
+				return true ;
+			}
+
+			bool alleles_less( VariantBatch const& batch, std::size_t i, std::size_t j ) {
+				std::size_t const n = std::min( batch.number_of_stored_alleles(i), batch.number_of_stored_alleles(j) ) ;
+				for( std::size_t k = 0; k < n; ++k ) {
+					int const c = batch.allele( i, k ).compare( batch.allele( j, k )) ;
+					if( c != 0 ) {
+						return c < 0 ;
+					}
+				}
+				return batch.number_of_stored_alleles(i) < batch.number_of_stored_alleles(j) ;
+			}
+		}
+
+		ViewMerger::ViewMerger( ThreadPool* pool, std::size_t batch_size ):
+			m_pool( pool ),
+			m_batch_size( std::max( batch_size, std::size_t( 1 ))),
+			m_preferred_source( npos ),
+			m_started( false ),
+			m_group_i( 0 )
+		{}
+
+		ViewMerger::~ViewMerger() {
+			// Reads in progress on the pool refer to our sources, so must complete first.
+			for( std::size_t i = 0; i < m_sources.size(); ++i ) {
+				if( m_sources[i]->pending.valid() ) {
+					m_sources[i]->pending.wait() ;
+				}
+			}
+		}
+
+		void ViewMerger::add_source( View::UniquePtr view ) {
+			assert( !m_started ) ;
+			assert( view.get() ) ;
+			if( !m_sources.empty() ) {
+				View const& first = *(m_sources[0]->view) ;
+				if( view->number_of_samples() != first.number_of_samples() ) {
+					throw std::invalid_argument(
+						"ViewMerger: source has " + std::to_string( view->number_of_samples() )
+						+ " samples, but " + std::to_string( first.number_of_samples() ) + " were expected."
+					) ;
+				}
+				if(
+					( view->context().flags & e_SampleIdentifiers )
+					&& ( first.context().flags & e_SampleIdentifiers )
+					&& get_sample_ids( *view ) != get_sample_ids( first )
+				) {
+					throw std::invalid_argument( "ViewMerger: source has different sample identifiers to the first source." ) ;
+				}
+			}
+			std::unique_ptr< Source > source( new Source() ) ;
+			source->index = m_sources.size() ;
+			source->view = std::move( view ) ;
+			source->next_variant = 0 ;
+			source->exhausted = false ;
+			m_sources.push_back( std::move( source )) ;
+		}
+
+		void ViewMerger::prefer_source( std::size_t source ) {
+			assert( !m_started ) ;
+			if( source >= m_sources.size() ) {
+				throw std::invalid_argument( "ViewMerger: there is no source " + std::to_string( source ) + "." ) ;
+			}
+			m_preferred_source = source ;
+		}
+
+		std::size_t ViewMerger::number_of_samples() const {
+			return m_sources.empty() ? 0 : m_sources[0]->view->number_of_samples() ;
+		}
+
+		bool ViewMerger::read_variant(
+			std::string* SNPID,
+			std::string* rsid,
+			std::string* chromosome,
+			uint32_t* position,
+			std::vector< std::string >* alleles
+		) {
+			if( !m_started ) {
+				start() ;
+			}
+			while( m_group_i == m_group_order.size() ) {
+				if( !read_group() ) {
+					return false ;
+				}
+			}
+			std::size_t const i = m_group_order[ m_group_i++ ] ;
+			SNPID->assign( m_group.SNPID(i) ) ;
+			rsid->assign( m_group.rsid(i) ) ;
+			chromosome->assign( m_group.chromosome(i) ) ;
+			*position = m_group.position[i] ;
+			alleles->resize( m_group.number_of_stored_alleles(i) ) ;
+			for( std::size_t k = 0; k < alleles->size(); ++k ) {
+				(*alleles)[k].assign( m_group.allele( i, k )) ;
+			}
+			return true ;
+		}
+
+		std::size_t ViewMerger::current_source() const {
+			assert( m_group_i > 0 ) ;
+			return m_group_source[ m_group_order[ m_group_i - 1 ] ] ;
+		}
+
+		std::pair< byte_t const*, byte_t const* > ViewMerger::raw_genotype_data_block() const {
+			assert( m_group_i > 0 ) ;
+			return m_group.genotype_data_block( m_group_order[ m_group_i - 1 ] ) ;
+		}
+
+		Buffer const& ViewMerger::uncompress_genotype_data_block() {
+			std::pair< byte_t const*, byte_t const* > const block = raw_genotype_data_block() ;
+			m_buffer1.assign( block.first, block.second ) ;
+			genfile::bgen::uncompress_probability_data( source( current_source() ).context(), m_buffer1, &m_buffer2 ) ;
+			return m_buffer2 ;
+		}
+
+		namespace {
+			// Order sources as a min-heap on their next variant, breaking ties by source index.
+			struct SourceGreater {
+				template< typename Source >
+				bool operator()( Source const* a, Source const* b ) const {
+					VariantBatch const& ab = a->batch ;
+					VariantBatch const& bb = b->batch ;
+					int const c = ab.chromosome( a->next_variant ).compare( bb.chromosome( b->next_variant )) ;
+					if( c != 0 ) {
+						return c > 0 ;
+					}
+					uint32_t const ap = ab.position[ a->next_variant ] ;
+					uint32_t const bp = bb.position[ b->next_variant ] ;
+					if( ap != bp ) {
+						return ap > bp ;
+					}
+					return a->index > b->index ;
+				}
+			} ;
+		}
+
+		void ViewMerger::start() {
+			m_started = true ;
+			// Start reading from all sources at once before waiting on any of them.
+			for( std::size_t i = 0; i < m_sources.size(); ++i ) {
+				request_batch( m_sources[i].get() ) ;
+			}
+			for( std::size_t i = 0; i < m_sources.size(); ++i ) {
+				if( advance( m_sources[i].get() )) {
+					m_heap.push_back( m_sources[i].get() ) ;
+				}
+			}
+			std::make_heap( m_heap.begin(), m_heap.end(), SourceGreater() ) ;
+		}
+
+		void ViewMerger::request_batch( Source* source ) {
+			if( m_pool ) {
+				source->pending = m_pool->submit(
+					[source,this]() { return source->view->read_variant_batch( m_batch_size, &source->next_batch, true ) ; }
+				) ;
+			}
+		}
+
+		bool ViewMerger::advance( Source* source ) {
+			if( source->next_variant < source->batch.size() ) {
+				return true ;
+			}
+			if( source->exhausted ) {
+				return false ;
+			}
+			std::size_t const count = source->pending.valid()
+				? source->pending.get()
+				: source->view->read_variant_batch( m_batch_size, &source->next_batch, true ) ;
+			std::swap( source->batch, source->next_batch ) ;
+			source->next_variant = 0 ;
+			if( count < m_batch_size ) {
+				source->exhausted = true ;
+			} else {
+				request_batch( source ) ;
+			}
+			return count > 0 ;
+		}
+
+		bool ViewMerger::read_group() {
+			m_group.clear() ;
+			m_group_source.clear() ;
+			m_group_order.clear() ;
+			m_group_i = 0 ;
+			if( m_heap.empty() ) {
+				return false ;
+			}
+			std::pop_heap( m_heap.begin(), m_heap.end(), SourceGreater() ) ;
+			std::vector< Source* > sources( 1, m_heap.back() ) ;
+			m_heap.pop_back() ;
+			std::string const chromosome = sources[0]->batch.chromosome( sources[0]->next_variant ) ;
+			uint32_t const position = sources[0]->batch.position[ sources[0]->next_variant ] ;
+			while(
+				!m_heap.empty()
+				&& m_heap.front()->batch.position[ m_heap.front()->next_variant ] == position
+				&& m_heap.front()->batch.chromosome( m_heap.front()->next_variant ) == chromosome
+			) {
+				std::pop_heap( m_heap.begin(), m_heap.end(), SourceGreater() ) ;
+				sources.push_back( m_heap.back() ) ;
+				m_heap.pop_back() ;
+			}
+			// sources are now in index order.
+			for( std::size_t i = 0; i < sources.size(); ++i ) {
+				take_variants_at( sources[i], chromosome, position ) ;
+				if( advance( sources[i] )) {
+					m_heap.push_back( sources[i] ) ;
+					std::push_heap( m_heap.begin(), m_heap.end(), SourceGreater() ) ;
+				}
+			}
+			order_group() ;
+			return true ;
+		}
+
+		void ViewMerger::take_variants_at( Source* source, std::string const& chromosome, uint32_t const position ) {
+			while( advance( source )) {
+				VariantBatch const& batch = source->batch ;
+				std::size_t const i = source->next_variant ;
+				int const c = batch.chromosome(i).compare( chromosome ) ;
+				if( c != 0 || batch.position[i] != position ) {
+					if( c < 0 || ( c == 0 && batch.position[i] < position )) {
+						throw std::invalid_argument(
+							"ViewMerger: variants in source " + std::to_string( source->index )
+							+ " are not sorted by chromosome and position (" + batch.chromosome(i) + ":" + std::to_string( batch.position[i] )
+							+ " follows " + chromosome + ":" + std::to_string( position ) + ")."
+						) ;
+					}
+					return ;
+				}
+				m_group.add_variant(
+					std::string( batch.SNPID(i) ), std::string( batch.rsid(i) ),
+					chromosome, position, batch.number_of_alleles[i]
+				) ;
+				for( std::size_t k = 0; k < batch.number_of_stored_alleles(i); ++k ) {
+					m_group.add_allele( std::string( batch.allele( i, k ))) ;
+				}
+				std::pair< byte_t const*, byte_t const* > const block = batch.genotype_data_block(i) ;
+				m_group.add_genotype_data_block( block.first, block.second ) ;
+				m_group_source.push_back( source->index ) ;
+				++source->next_variant ;
+			}
+		}
+
+		void ViewMerger::order_group() {
+			VariantBatch const& group = m_group ;
+			m_group_order.resize( group.size() ) ;
+			std::iota( m_group_order.begin(), m_group_order.end(), 0 ) ;
+			// Variants were added in source order, which the stable sort preserves for equal alleles.
+			std::stable_sort(
+				m_group_order.begin(), m_group_order.end(),
+				[&group]( std::size_t i, std::size_t j ) { return alleles_less( group, i, j ) ; }
+			) ;
+			if( m_preferred_source == npos ) {
+				return ;
+			}
+			// Keep each set of variants with the same alleles from a single source.
+			std::vector< std::size_t > kept ;
+			kept.reserve( m_group_order.size() ) ;
+			for( std::size_t begin = 0, end = 0; begin < m_group_order.size(); begin = end ) {
+				std::size_t chosen = m_group_source[ m_group_order[begin] ] ;
+				for(
+					end = begin + 1 ;
+					end < m_group_order.size() && have_same_alleles( group, m_group_order[begin], m_group_order[end] ) ;
+					++end
+				) {
+					if( m_group_source[ m_group_order[end] ] == m_preferred_source ) {
+						chosen = m_preferred_source ;
+					}
+				}
+				for( std::size_t k = begin; k < end; ++k ) {
+					if( m_group_source[ m_group_order[k] ] == chosen ) {
+						kept.push_back( m_group_order[k] ) ;
+					}
+				}
+			}
+			m_group_order.swap( kept ) ;
+		}
+	}
+}
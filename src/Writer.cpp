@@ -0,0 +1,211 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <sys/stat.h>
+#include "genfile/bgen.hpp"
+#include "genfile/Writer.hpp"
+
+namespace genfile {
+	namespace bgen {
+		namespace {
+			// The number of bytes at the start of the file recorded in its metadata, as View does.
+			std::size_t const first_bytes_size = 1000 ;
+		}
+
+		Writer::UniquePtr Writer::create(
+			std::string const& filename,
+			Context const& context,
+			std::vector< std::string > const& sample_ids
+		) {
+			return Writer::UniquePtr( new Writer( filename, context, sample_ids )) ;
+		}
+
+		Writer::UniquePtr Writer::create(
+			std::ostream& stream,
+			std::string const& name,
+			Context const& context,
+			std::vector< std::string > const& sample_ids
+		) {
+			return Writer::UniquePtr( new Writer( stream, name, context, sample_ids )) ;
+		}
+
+		Writer::Writer(
+			std::string const& filename,
+			Context const& context,
+			std::vector< std::string > const& sample_ids
+		):
+			m_filename( filename ),
+			m_file( new std::ofstream( filename.c_str(), std::ios::binary )),
+			m_stream( *m_file ),
+			m_declared_number_of_variants( 0 ),
+			m_context( context ),
+			m_file_position( 0 ),
+			m_finalised( false )
+		{
+			if( !m_stream ) {
+				throw std::invalid_argument( filename ) ;
+			}
+			// The header is rewritten with the actual number of variants by finalise().
+			Context header_context = context ;
+			header_context.number_of_variants = 0 ;
+			write_header( header_context, sample_ids ) ;
+		}
+
+		Writer::Writer(
+			std::ostream& stream,
+			std::string const& name,
+			Context const& context,
+			std::vector< std::string > const& sample_ids
+		):
+			m_filename( name ),
+			m_stream( stream ),
+			m_declared_number_of_variants( context.number_of_variants ),
+			m_context( context ),
+			m_file_position( 0 ),
+			m_finalised( false )
+		{
+			if( !m_stream ) {
+				throw std::invalid_argument( name ) ;
+			}
+			write_header( context, sample_ids ) ;
+		}
+
+		void Writer::write_header( Context const& context, std::vector< std::string > const& sample_ids ) {
+			if( !sample_ids.empty() && sample_ids.size() != context.number_of_samples ) {
+				throw std::invalid_argument( "sample_ids" ) ;
+			}
+			m_context = context ;
+			if( sample_ids.empty() ) {
+				m_context.flags &= ~e_SampleIdentifiers ;
+			} else {
+				m_context.flags |= e_SampleIdentifiers ;
+			}
+
+			uint32_t offset = m_context.header_size() ;
+			if( !sample_ids.empty() ) {
+				offset += 8 ;
+				for( std::size_t i = 0; i < sample_ids.size(); ++i ) {
+					offset += 2 + sample_ids[i].size() ;
+				}
+			}
+			std::ostringstream header ;
+			write_offset( header, offset ) ;
+			write_header_block( header, m_context ) ;
+			if( !sample_ids.empty() ) {
+				write_sample_identifier_block( header, m_context, sample_ids ) ;
+			}
+			write( header.str().data(), header.str().size() ) ;
+			if( !m_stream ) {
+				throw std::invalid_argument( "An error occurred writing to \"" + m_filename + "\"." ) ;
+			}
+			m_file_position = int64_t( offset ) + 4 ;
+			// From here on this counts the variants written.
+			m_context.number_of_variants = 0 ;
+		}
+
+		Writer::FileRange Writer::write_variant(
+			std::string const& SNPID,
+			std::string const& rsid,
+			std::string const& chromosome,
+			uint32_t position,
+			std::vector< std::string > const& alleles,
+			byte_t const* genotype_data,
+			byte_t const* const end_genotype_data
+		) {
+			assert( !m_finalised ) ;
+			assert( end_genotype_data >= genotype_data ) ;
+			byte_t const* const end_identifying_data = write_snp_identifying_data(
+				&m_buffer, m_context,
+				SNPID, rsid, chromosome, position,
+				uint16_t( alleles.size() ),
+				[&alleles]( std::size_t i ) -> std::string const& { return alleles[i] ; }
+			) ;
+			write( reinterpret_cast< char const* >( &m_buffer[0] ), end_identifying_data - &m_buffer[0] ) ;
+			write( reinterpret_cast< char const* >( genotype_data ), end_genotype_data - genotype_data ) ;
+			if( !m_stream ) {
+				throw std::invalid_argument( "An error occurred writing to \"" + m_filename + "\"." ) ;
+			}
+			int64_t const size = ( end_identifying_data - &m_buffer[0] ) + ( end_genotype_data - genotype_data ) ;
+			FileRange const result( m_file_position, size ) ;
+			m_file_position += size ;
+			++m_context.number_of_variants ;
+			return result ;
+		}
+
+		Writer::FileRange Writer::write_encoded_variant( byte_t const* begin, byte_t const* const end ) {
+			assert( !m_finalised ) ;
+			assert( end >= begin ) ;
+			write( reinterpret_cast< char const* >( begin ), end - begin ) ;
+			if( !m_stream ) {
+				throw std::invalid_argument( "An error occurred writing to \"" + m_filename + "\"." ) ;
+			}
+			FileRange const result( m_file_position, int64_t( end - begin )) ;
+			m_file_position += result.second ;
+			++m_context.number_of_variants ;
+			return result ;
+		}
+
+		void Writer::write( char const* data, std::size_t size ) {
+			m_stream.write( data, size ) ;
+			// Keep the first bytes, which identify the file in an index, as the stream cannot be read back.
+			if( m_first_bytes.size() < first_bytes_size ) {
+				std::size_t const count = std::min( size, first_bytes_size - m_first_bytes.size() ) ;
+				m_first_bytes.insert( m_first_bytes.end(), data, data + count ) ;
+			}
+		}
+
+		Writer::FileMetadata Writer::finalise() {
+			assert( !m_finalised ) ;
+			m_finalised = true ;
+			FileMetadata result ;
+			result.filename = m_filename ;
+			result.size = m_file_position ;
+
+			if( !m_file.get() ) {
+				m_stream.flush() ;
+				if( !m_stream ) {
+					throw std::invalid_argument( "An error occurred writing to \"" + m_filename + "\"." ) ;
+				}
+				result.first_bytes = m_first_bytes ;
+				if(
+					m_declared_number_of_variants != e_UnknownNumberOfVariants
+					&& m_declared_number_of_variants != m_context.number_of_variants
+				) {
+					throw std::invalid_argument(
+						"Wrote " + std::to_string( m_context.number_of_variants ) + " variants to \"" + m_filename
+						+ "\", but its header declares " + std::to_string( m_declared_number_of_variants ) + "."
+					) ;
+				}
+				return result ;
+			}
+
+			// The number of variants starts at byte 8, so rewrite the header.
+			m_stream.seekp( 4 ) ;
+			write_header_block( m_stream, m_context ) ;
+			m_file->close() ;
+			if( !*m_file ) {
+				throw std::invalid_argument( "An error occurred writing to \"" + m_filename + "\"." ) ;
+			}
+
+			// Gather metadata as View does.
+			struct stat mtstat{} ;
+			stat( m_filename.c_str(), &mtstat ) ;
+			result.last_write_time = mtstat.st_mtim.tv_sec ;
+			std::ifstream stream( m_filename.c_str(), std::ios::binary ) ;
+			result.first_bytes.resize( first_bytes_size, 0 ) ;
+			stream.read( reinterpret_cast< char* >( &result.first_bytes[0] ), first_bytes_size ) ;
+			result.first_bytes.resize( stream.gcount() ) ;
+			return result ;
+		}
+	}
+}
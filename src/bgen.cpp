@@ -86,7 +86,9 @@ namespace genfile {
 			std::vector<char> free_data ;
 
 			read_little_endian_integer( aStream, &header_size ) ;
-			assert( header_size >= fixed_data_size ) ;
+			if( header_size < fixed_data_size ) {
+				throw BGenError() ;
+			}
 			read_little_endian_integer( aStream, &number_of_snp_blocks ) ;
 			read_little_endian_integer( aStream, &number_of_samples ) ;
 			aStream.read( &magic[0], 4 ) ;
@@ -320,7 +322,8 @@ namespace genfile {
 			std::istream& aStream,
 			Context const& context
 		) {
-			if( (context.flags & bgen::e_CompressedSNPBlocks) != e_NoCompression ) {
+			// As for read_genotype_data_block(), layout 2 blocks are always prefixed by their size.
+			if( (context.flags & e_Layout) == e_Layout2 || ((context.flags & bgen::e_CompressedSNPBlocks) != e_NoCompression ) ) {
 				uint32_t compressed_data_size = 0 ;
 				read_little_endian_integer( aStream, &compressed_data_size ) ;
 				if( compressed_data_size > 0 ) {
@@ -338,51 +341,6 @@ namespace genfile {
 			}
 		}
 
-		void read_genotype_data_block(
-			std::istream& aStream,
-			Context const& context,
-			std::vector< byte_t >* buffer
-		) {
-			uint32_t payload_size = 0 ;
-			if( (context.flags & e_Layout) == e_Layout2 || ((context.flags & e_CompressedSNPBlocks) != e_NoCompression ) ) {
-				read_little_endian_integer( aStream, &payload_size ) ;
-			} else {
-				payload_size = 6 * context.number_of_samples ;
-			}
-			buffer->resize( payload_size ) ;
-			aStream.read( reinterpret_cast< char* >( &(*buffer)[0] ), payload_size ) ;
-		}
-
-		void uncompress_probability_data(
-			Context const& context,
-			std::vector< byte_t > const& compressed_data,
-			std::vector< byte_t >* buffer
-		) {
-			// compressed_data contains the (compressed or uncompressed) probability data.
-			uint32_t const compressionType = (context.flags & bgen::e_CompressedSNPBlocks) ;
-			if( compressionType != e_NoCompression ) {
-				byte_t const* begin = &compressed_data[0] ;
-				byte_t const* const end = &compressed_data[0] + compressed_data.size() ;
-				uint32_t uncompressed_data_size = 0 ;
-				if( (context.flags & e_Layout) == e_Layout1 ) {
-					uncompressed_data_size = 6 * context.number_of_samples ;
-				} else {
-					begin = read_little_endian_integer( begin, end, &uncompressed_data_size ) ;
-				}
-				buffer->resize( uncompressed_data_size ) ;
-				if( compressionType == e_ZlibCompression ) {
-					zlib_uncompress( begin, end, buffer ) ;
-				} else if( compressionType == e_ZstdCompression ) {
-					zstd_uncompress( begin, end, buffer ) ;
-				}
-				assert( buffer->size() == uncompressed_data_size ) ;
-			}
-			else {
-				// copy the data between buffers.
-				buffer->assign( compressed_data.begin(), compressed_data.end() ) ;
-			}
-		}
-
 		namespace v12 {
 			namespace impl {
 				namespace {
@@ -481,6 +439,66 @@ namespace genfile {
 					}
 					return destination ;
 				}
+
+				std::size_t greatest_common_divisor( std::size_t a, std::size_t b ) {
+					while( b != 0 ) {
+						std::size_t const r = a % b ;
+						a = b ;
+						b = r ;
+					}
+					return a ;
+				}
+			}
+
+			std::vector< SampleRange > split_by_samples( GenotypeDataBlock const& pack, std::size_t number_of_ranges ) {
+				std::size_t const N = pack.numberOfSamples ;
+				number_of_ranges = std::max( std::min( number_of_ranges, N ), std::size_t( 1 )) ;
+				std::size_t const target_size = ( N + number_of_ranges - 1 ) / number_of_ranges ;
+				std::vector< SampleRange > result ;
+				result.reserve( number_of_ranges ) ;
+
+				if( pack.ploidyExtent[0] == pack.ploidyExtent[1] ) {
+					// Every sample has the same ploidy, so sample i starts i * bits_per_sample bits
+					// into the data, and every alignment'th sample is byte-aligned.
+					std::size_t const bits_per_sample = std::size_t( pack.bits )
+						* number_of_stored_values( pack.ploidyExtent[0], pack.numberOfAlleles, pack.phased ) ;
+					std::size_t const alignment = 8 / impl::greatest_common_divisor( bits_per_sample, 8 ) ;
+					std::size_t const size = std::max(
+						( ( target_size + alignment - 1 ) / alignment ) * alignment,
+						alignment
+					) ;
+					for( std::size_t begin = 0; begin < N || result.empty(); begin += size ) {
+						SampleRange range = {
+							uint32_t( begin ),
+							uint32_t( std::min( begin + size, N )),
+							( begin * bits_per_sample ) / 8
+						} ;
+						result.push_back( range ) ;
+					}
+				} else {
+					// Sum stored bits over samples, starting a new range at the first aligned sample
+					// at or after each target boundary.
+					uint32_t bits_per_sample[64] ;
+					for( uint32_t ploidy = 0; ploidy < 64; ++ploidy ) {
+						bits_per_sample[ ploidy ] = ( ploidy >= pack.ploidyExtent[0] && ploidy <= pack.ploidyExtent[1] )
+							? ( pack.bits * number_of_stored_values( ploidy, pack.numberOfAlleles, pack.phased ))
+							: 0 ;
+					}
+					SampleRange range = { 0, 0, 0 } ;
+					std::size_t bit_offset = 0 ;
+					for( std::size_t i = 0; i < N; ++i ) {
+						if( i >= range.begin + target_size && ( bit_offset % 8 ) == 0 ) {
+							range.end = uint32_t( i ) ;
+							result.push_back( range ) ;
+							range.begin = uint32_t( i ) ;
+							range.byte_offset = bit_offset / 8 ;
+						}
+						bit_offset += bits_per_sample[ pack.ploidy[i] & 0x3F ] ;
+					}
+					range.end = uint32_t( N ) ;
+					result.push_back( range ) ;
+				}
+				return result ;
 			}
 		}
 	}
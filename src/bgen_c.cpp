@@ -0,0 +1,464 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include <new>
+#include "genfile/bgen_c.h"
+#include "genfile/bgen.hpp"
+#include "genfile/Buffer.hpp"
+#include "genfile/dosage.hpp"
+#include "genfile/View.hpp"
+#include "genfile/IndexQuery.hpp"
+#include "genfile/VariantBatch.hpp"
+#include "genfile/ThreadPool.hpp"
+
+struct bgen_file {
+	std::string filename ;
+	std::string index_filename ;
+	genfile::bgen::Context context ;
+	genfile::bgen::View::FileMetadata metadata ;
+	std::vector< std::string > sample_ids ;
+	// Stream used to read genotype data for selected variants.
+	std::ifstream stream ;
+	genfile::bgen::VariantBatch selection ;
+	// The selected samples, in output order, or empty if all samples are selected;
+	// and the output column of each sample in the file, or -1 if it is not selected.
+	std::vector< std::size_t > samples ;
+	std::vector< int64_t > sample_columns ;
+	genfile::ThreadPool::UniquePtr pool ;
+	// Genotype data blocks read by the most recent decoding call.
+	std::vector< std::vector< genfile::byte_t > > blocks ;
+	std::vector< std::string > alleles ;
+} ;
+
+namespace {
+	using genfile::byte_t ;
+	using genfile::Buffer ;
+
+	// An error reported to the caller with the given status.
+	struct ApiError: public std::runtime_error {
+		ApiError( bgen_status status, std::string const& message ):
+			std::runtime_error( message ),
+			m_status( status )
+		{}
+		bgen_status status() const { return m_status ; }
+	private:
+		bgen_status m_status ;
+	} ;
+
+	thread_local std::string last_error ;
+
+	// Call f(), converting any exception it throws to a status code.
+	template< typename F >
+	bgen_status guard( F f ) {
+		try {
+			f() ;
+			return BGEN_OK ;
+		} catch( ApiError const& e ) {
+			last_error = e.what() ;
+			return e.status() ;
+		} catch( genfile::bgen::BGenError const& e ) {
+			last_error = "The bgen file is invalid or its data is corrupt." ;
+			return BGEN_ERROR_FORMAT ;
+		} catch( std::bad_alloc const& e ) {
+			last_error = "Out of memory." ;
+			return BGEN_ERROR_OUT_OF_MEMORY ;
+		} catch( std::invalid_argument const& e ) {
+			last_error = e.what() ;
+			return BGEN_ERROR_INVALID_ARGUMENT ;
+		} catch( std::exception const& e ) {
+			last_error = e.what() ;
+			return BGEN_ERROR_UNKNOWN ;
+		}
+	}
+
+	void check( bool condition, std::string const& message ) {
+		if( !condition ) {
+			throw ApiError( BGEN_ERROR_INVALID_ARGUMENT, message ) ;
+		}
+	}
+
+	genfile::bgen::IndexQuery::UniquePtr create_query( bgen_file const* file ) {
+		if( file->index_filename.empty() ) {
+			throw ApiError( BGEN_ERROR_INDEX, "Selecting variants by range or rsid needs an index, but none was opened." ) ;
+		}
+		return genfile::bgen::IndexQuery::create( file->index_filename ) ;
+	}
+
+	// Replace the selection with the variants found by the given query.
+	void run_query( bgen_file* file, genfile::bgen::IndexQuery& query ) {
+		query.initialise() ;
+		file->selection.clear() ;
+		// Reading everything in one batch lets us take the batch as the selection.
+		query.read_variant_batches(
+			std::max< std::size_t >( query.number_of_variants(), 1 ),
+			[file]( genfile::bgen::VariantBatch& batch ) { file->selection = std::move( batch ) ; }
+		) ;
+	}
+
+	// Read the genotype data blocks of selected variants [first, first+count) into file->blocks.
+	void read_blocks( bgen_file* file, std::size_t first, std::size_t count ) {
+		check(
+			first <= file->selection.size() && count <= file->selection.size() - first,
+			"Variants " + std::to_string( first ) + "-" + std::to_string( first + count ) + " are not all selected."
+		) ;
+		file->blocks.resize( std::max( file->blocks.size(), count )) ;
+		std::string SNPID, rsid, chromosome ;
+		uint32_t position ;
+		for( std::size_t i = 0; i < count; ++i ) {
+			file->stream.clear() ;
+			file->stream.seekg( file->selection.file_offset[ first + i ] ) ;
+			bool const success = genfile::bgen::read_snp_identifying_data(
+				file->stream, file->context, &SNPID, &rsid, &chromosome, &position,
+				[]( std::size_t ) {}, []( std::size_t, std::string const& ) {}
+			) ;
+			if( !success ) {
+				throw ApiError( BGEN_ERROR_IO, "Could not read variant at offset " + std::to_string( file->selection.file_offset[ first + i ] ) + "." ) ;
+			}
+			genfile::bgen::read_genotype_data_block( file->stream, file->context, &file->blocks[i] ) ;
+		}
+	}
+
+	// Call f( i, uncompressed data ) for each of the first count blocks, using the file's thread pool if it has one.
+	template< typename F >
+	void for_each_block( bgen_file* file, std::size_t count, F f ) {
+		auto process = [file,&f]( std::size_t i ) {
+			thread_local Buffer buffer ;
+			try {
+				genfile::bgen::uncompress_probability_data( file->context, file->blocks[i], &buffer ) ;
+			} catch( std::invalid_argument const& e ) {
+				throw ApiError( BGEN_ERROR_FORMAT, e.what() ) ;
+			}
+			f( i, buffer ) ;
+		} ;
+		if( file->pool.get() ) {
+			file->pool->parallel_for( 0, count, process ) ;
+		} else {
+			for( std::size_t i = 0; i < count; ++i ) {
+				process( i ) ;
+			}
+		}
+	}
+
+	template< typename T >
+	bgen_status read_dosages( bgen_file* file, std::size_t first, std::size_t count, T* out ) {
+		return guard( [&]() {
+			check( out != 0 || count == 0, "Output buffer must not be NULL." ) ;
+			read_blocks( file, first, count ) ;
+			std::size_t const N = file->context.number_of_samples ;
+			std::size_t const columns = bgen_number_of_selected_samples( file ) ;
+			for_each_block(
+				file, count,
+				[&]( std::size_t i, Buffer const& data ) {
+					T* row = out + i * columns ;
+					if( file->selection.number_of_alleles[ first + i ] != 2 ) {
+						std::fill( row, row + columns, genfile::bgen::DosageTraits< T >::missing() ) ;
+					} else if( file->sample_columns.empty() ) {
+						genfile::bgen::parse_dosage_data( data.data(), data.data() + data.size(), file->context, row ) ;
+					} else {
+						thread_local std::vector< T > dosages ;
+						dosages.resize( N ) ;
+						genfile::bgen::parse_dosage_data( data.data(), data.data() + data.size(), file->context, dosages.data() ) ;
+						for( std::size_t j = 0; j < columns; ++j ) {
+							row[j] = dosages[ file->samples[j] ] ;
+						}
+					}
+				}
+			) ;
+		}) ;
+	}
+
+	// Writes probabilities for one variant into a row of the output.
+	struct ProbabilityWriter {
+		ProbabilityWriter( std::vector< int64_t > const& columns, std::size_t stride, double* row, uint8_t* ploidy ):
+			phased( 0 ),
+			m_columns( columns ),
+			m_stride( stride ),
+			m_row( row ),
+			m_ploidy( ploidy ),
+			m_column( -1 )
+		{}
+
+		void initialise( std::size_t number_of_samples, std::size_t number_of_alleles ) {}
+
+		bool set_sample( std::size_t i ) {
+			m_column = m_columns.empty() ? int64_t( i ) : m_columns[i] ;
+			return m_column >= 0 ;
+		}
+
+		void set_number_of_entries(
+			std::size_t ploidy,
+			std::size_t number_of_entries,
+			genfile::OrderType order_type,
+			genfile::ValueType value_type
+		) {
+			phased = ( order_type == genfile::ePerPhasedHaplotypePerAllele ) ? 1 : 0 ;
+			if( m_column < 0 ) {
+				return ;
+			}
+			if( number_of_entries > m_stride ) {
+				throw ApiError(
+					BGEN_ERROR_BUFFER_TOO_SMALL,
+					"A sample has " + std::to_string( number_of_entries ) + " probabilities, but the stride is " + std::to_string( m_stride ) + "."
+				) ;
+			}
+			if( m_ploidy ) {
+				m_ploidy[ m_column ] = uint8_t( ploidy ) ;
+			}
+		}
+
+		void set_value( uint32_t entry_i, double value ) {
+			if( m_column >= 0 ) {
+				m_row[ m_column * m_stride + entry_i ] = value ;
+			}
+		}
+
+		void set_value( uint32_t entry_i, genfile::MissingValue value ) {}
+
+		uint8_t phased ;
+
+	private:
+		std::vector< int64_t > const& m_columns ;
+		std::size_t const m_stride ;
+		double* const m_row ;
+		uint8_t* const m_ploidy ;
+		int64_t m_column ;
+	} ;
+}
+
+extern "C" {
+	int bgen_api_version( void ) {
+		return BGEN_C_API_VERSION ;
+	}
+
+	char const* bgen_error_message( void ) {
+		return last_error.c_str() ;
+	}
+
+	bgen_status bgen_open( char const* filename, char const* index_filename, bgen_file** result ) {
+		return guard( [&]() {
+			check( filename != 0 && result != 0, "Filename and result must not be NULL." ) ;
+			std::unique_ptr< bgen_file > file( new bgen_file() ) ;
+			file->filename = filename ;
+			genfile::bgen::View::UniquePtr view ;
+			try {
+				view = genfile::bgen::View::create( filename ) ;
+			} catch( genfile::bgen::BGenError const& ) {
+				throw ;
+			} catch( std::exception const& e ) {
+				throw ApiError( BGEN_ERROR_IO, std::string( "Could not open \"" ) + filename + "\": " + e.what() ) ;
+			}
+			file->context = view->context() ;
+			file->metadata = view->file_metadata() ;
+			view->get_sample_ids( [&file]( std::string const& id ) { file->sample_ids.push_back( id ) ; } ) ;
+			file->stream.open( filename, std::ifstream::binary ) ;
+			if( !file->stream ) {
+				throw ApiError( BGEN_ERROR_IO, std::string( "Could not open \"" ) + filename + "\"." ) ;
+			}
+			if( index_filename ) {
+				file->index_filename = index_filename ;
+				genfile::bgen::IndexQuery::UniquePtr query ;
+				try {
+					query = genfile::bgen::IndexQuery::create( index_filename ) ;
+				} catch( std::exception const& e ) {
+					throw ApiError( BGEN_ERROR_INDEX, std::string( "Could not open index \"" ) + index_filename + "\"." ) ;
+				}
+				genfile::bgen::IndexQuery::OptionalFileMetadata const& metadata = query->file_metadata() ;
+				if( metadata && ( metadata->size != file->metadata.size || metadata->first_bytes != file->metadata.first_bytes )) {
+					throw ApiError( BGEN_ERROR_INDEX, std::string( "The index \"" ) + index_filename + "\" was not made from this file." ) ;
+				}
+			}
+			*result = file.release() ;
+		}) ;
+	}
+
+	void bgen_close( bgen_file* file ) {
+		delete file ;
+	}
+
+	bgen_status bgen_set_threads( bgen_file* file, size_t number_of_threads ) {
+		return guard( [&]() {
+			if( number_of_threads == 1 ) {
+				file->pool.reset() ;
+			} else {
+				file->pool.reset( new genfile::ThreadPool( number_of_threads )) ;
+			}
+		}) ;
+	}
+
+	size_t bgen_number_of_samples( bgen_file const* file ) {
+		return file->context.number_of_samples ;
+	}
+
+	size_t bgen_number_of_variants( bgen_file const* file ) {
+		return file->context.number_of_variants ;
+	}
+
+	int bgen_layout( bgen_file const* file ) {
+		return (( file->context.flags & genfile::bgen::e_Layout ) == genfile::bgen::e_Layout2 ) ? 2 : 1 ;
+	}
+
+	char const* bgen_sample_id( bgen_file const* file, size_t i ) {
+		return ( i < file->sample_ids.size() ) ? file->sample_ids[i].c_str() : 0 ;
+	}
+
+	bgen_status bgen_select_all( bgen_file* file ) {
+		return guard( [&]() {
+			if( file->index_filename.empty() ) {
+				genfile::bgen::View::UniquePtr view = genfile::bgen::View::create( file->filename ) ;
+				view->read_variant_batch( std::max< std::size_t >( file->context.number_of_variants, 1 ), &file->selection ) ;
+			} else {
+				run_query( file, *create_query( file )) ;
+			}
+		}) ;
+	}
+
+	bgen_status bgen_select_range( bgen_file* file, char const* chromosome, uint32_t start, uint32_t end ) {
+		return guard( [&]() {
+			check( chromosome != 0 && start <= end, "Invalid range." ) ;
+			genfile::bgen::IndexQuery::UniquePtr query = create_query( file ) ;
+			query->include_range( genfile::bgen::IndexQuery::GenomicRange( chromosome, start, end )) ;
+			run_query( file, *query ) ;
+		}) ;
+	}
+
+	bgen_status bgen_select_rsids( bgen_file* file, char const* const* rsids, size_t number_of_rsids ) {
+		return guard( [&]() {
+			check( rsids != 0 || number_of_rsids == 0, "rsids must not be NULL." ) ;
+			genfile::bgen::IndexQuery::UniquePtr query = create_query( file ) ;
+			query->include_rsids( std::vector< std::string >( rsids, rsids + number_of_rsids )) ;
+			run_query( file, *query ) ;
+		}) ;
+	}
+
+	bgen_status bgen_select_samples( bgen_file* file, size_t const* samples, size_t number_of_samples ) {
+		return guard( [&]() {
+			std::vector< int64_t > columns ;
+			if( samples ) {
+				columns.assign( file->context.number_of_samples, -1 ) ;
+				for( std::size_t j = 0; j < number_of_samples; ++j ) {
+					check( samples[j] < columns.size(), "Sample " + std::to_string( samples[j] ) + " is out of range." ) ;
+					check( columns[ samples[j] ] < 0, "Sample " + std::to_string( samples[j] ) + " is selected more than once." ) ;
+					columns[ samples[j] ] = j ;
+				}
+				file->samples.assign( samples, samples + number_of_samples ) ;
+			} else {
+				file->samples.clear() ;
+			}
+			file->sample_columns.swap( columns ) ;
+		}) ;
+	}
+
+	size_t bgen_number_of_selected_samples( bgen_file const* file ) {
+		return file->sample_columns.empty() ? file->context.number_of_samples : file->samples.size() ;
+	}
+
+	size_t bgen_number_of_selected_variants( bgen_file const* file ) {
+		return file->selection.size() ;
+	}
+
+	uint32_t const* bgen_selected_positions( bgen_file const* file ) {
+		return file->selection.position.data() ;
+	}
+
+	uint16_t const* bgen_selected_numbers_of_alleles( bgen_file const* file ) {
+		return file->selection.number_of_alleles.data() ;
+	}
+
+	int64_t const* bgen_selected_file_offsets( bgen_file const* file ) {
+		return file->selection.file_offset.data() ;
+	}
+
+	bgen_status bgen_selected_string( bgen_file const* file, size_t variant, bgen_field field, char const** data, size_t* size ) {
+		return guard( [&]() {
+			check( variant < file->selection.size(), "Variant " + std::to_string( variant ) + " is not selected." ) ;
+			std::string_view value ;
+			switch( field ) {
+				case BGEN_FIELD_SNPID: value = file->selection.SNPID( variant ) ; break ;
+				case BGEN_FIELD_RSID: value = file->selection.rsid( variant ) ; break ;
+				case BGEN_FIELD_CHROMOSOME: value = file->selection.chromosome( variant ) ; break ;
+				default: check( false, "Unknown field." ) ;
+			}
+			*data = value.data() ;
+			*size = value.size() ;
+		}) ;
+	}
+
+	bgen_status bgen_selected_allele( bgen_file const* file, size_t variant, size_t k, char const** data, size_t* size ) {
+		return guard( [&]() {
+			check( variant < file->selection.size(), "Variant " + std::to_string( variant ) + " is not selected." ) ;
+			check( k < file->selection.number_of_stored_alleles( variant ), "Allele " + std::to_string( k ) + " is not stored in the selection." ) ;
+			std::string_view const value = file->selection.allele( variant, k ) ;
+			*data = value.data() ;
+			*size = value.size() ;
+		}) ;
+	}
+
+	bgen_status bgen_read_dosages( bgen_file* file, size_t first, size_t count, double* out ) {
+		return read_dosages( file, first, count, out ) ;
+	}
+
+	bgen_status bgen_read_dosages_float( bgen_file* file, size_t first, size_t count, float* out ) {
+		return read_dosages( file, first, count, out ) ;
+	}
+
+	bgen_status bgen_read_probabilities(
+		bgen_file* file, size_t first, size_t count,
+		size_t stride, double* out, uint8_t* ploidy, uint8_t* phased
+	) {
+		return guard( [&]() {
+			check( out != 0 || count == 0, "Output buffer must not be NULL." ) ;
+			read_blocks( file, first, count ) ;
+			std::size_t const columns = bgen_number_of_selected_samples( file ) ;
+			std::fill( out, out + count * columns * stride, std::numeric_limits< double >::quiet_NaN() ) ;
+			if( ploidy ) {
+				std::fill( ploidy, ploidy + count * columns, 0 ) ;
+			}
+			for_each_block(
+				file, count,
+				[&]( std::size_t i, Buffer const& data ) {
+					ProbabilityWriter writer( file->sample_columns, stride, out + i * columns * stride, ploidy ? ( ploidy + i * columns ) : 0 ) ;
+					genfile::bgen::parse_probability_data( data.data(), data.data() + data.size(), file->context, writer ) ;
+					if( phased ) {
+						phased[i] = writer.phased ;
+					}
+				}
+			) ;
+		}) ;
+	}
+
+	bgen_status bgen_read_alleles(
+		bgen_file* file, size_t variant,
+		char const** alleles, size_t* sizes, size_t max_alleles, size_t* number_of_alleles
+	) {
+		return guard( [&]() {
+			check( variant < file->selection.size(), "Variant " + std::to_string( variant ) + " is not selected." ) ;
+			std::string SNPID, rsid, chromosome ;
+			uint32_t position ;
+			file->stream.clear() ;
+			file->stream.seekg( file->selection.file_offset[ variant ] ) ;
+			bool const success = genfile::bgen::read_snp_identifying_data(
+				file->stream, file->context, &SNPID, &rsid, &chromosome, &position,
+				[file]( std::size_t n ) { file->alleles.resize( n ) ; },
+				[file]( std::size_t i, std::string const& allele ) { file->alleles.at( i ) = allele ; }
+			) ;
+			if( !success ) {
+				throw ApiError( BGEN_ERROR_IO, "Could not read variant at offset " + std::to_string( file->selection.file_offset[ variant ] ) + "." ) ;
+			}
+			*number_of_alleles = file->alleles.size() ;
+			for( std::size_t k = 0; k < std::min( max_alleles, file->alleles.size() ); ++k ) {
+				alleles[k] = file->alleles[k].data() ;
+				sizes[k] = file->alleles[k].size() ;
+			}
+		}) ;
+	}
+}
@@ -0,0 +1,192 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <optional>
+#include <fmt/format.h>
+#include "genfile/bgen.hpp"
+#include "genfile/Buffer.hpp"
+#include "genfile/check.hpp"
+
+namespace genfile {
+	namespace bgen {
+		std::string describe( CheckedVariant const& variant ) {
+			return fmt::format(
+				"variant {} ({} at {}:{}, offset {})",
+				variant.index + 1, variant.rsid, variant.chromosome, variant.position, variant.offset
+			) ;
+		}
+
+		std::optional< FileProblem > check_header( std::istream& stream, int64_t const file_size, Context* context, uint32_t* offset ) {
+			std::size_t header_size = 0 ;
+			try {
+				read_offset( stream, offset ) ;
+				header_size = read_header_block( stream, context ) ;
+			} catch( BGenError const& ) {
+				return FileProblem{ "header", "header block could not be read" } ;
+			}
+			if( int64_t( *offset ) + 4 > file_size ) {
+				return FileProblem{ "header", fmt::format( "offset ({}) lies beyond the end of the file ({} bytes)", *offset, file_size ) } ;
+			}
+			if( header_size > *offset ) {
+				return FileProblem{ "header", fmt::format( "header block ({} bytes) is longer than the offset ({})", header_size, *offset ) } ;
+			}
+			uint32_t const layout = context->flags & e_Layout ;
+			uint32_t const compression = context->flags & e_CompressedSNPBlocks ;
+			if( layout != e_Layout1 && layout != e_Layout2 ) {
+				return FileProblem{ "header", fmt::format( "layout {} is not supported", layout >> 2 ) } ;
+			}
+			if( compression == 3 || ( layout == e_Layout1 && compression == e_ZstdCompression )) {
+				return FileProblem{ "header", fmt::format( "compression type {} is not valid for layout {}", compression, layout >> 2 ) } ;
+			}
+			if( context->flags & e_SampleIdentifiers ) {
+				std::size_t sample_block_size = 0 ;
+				try {
+					sample_block_size = read_sample_identifier_block( stream, *context, []( std::string const& ) {} ) ;
+				} catch( BGenError const& ) {
+					return FileProblem{ "sample identifier block", "block could not be read, or has the wrong number of samples or size" } ;
+				}
+				if( header_size + sample_block_size > *offset ) {
+					return FileProblem{
+						"sample identifier block",
+						fmt::format( "header and sample blocks ({} bytes) are longer than the offset ({})", header_size + sample_block_size, *offset )
+					} ;
+				}
+			}
+			return std::optional< FileProblem >() ;
+		}
+
+		std::optional< FileProblem > read_checked_variant(
+			std::istream& stream,
+			Context const& context,
+			int64_t const file_size,
+			CheckedVariant* variant
+		) {
+			variant->offset = stream.tellg() ;
+			bool const at_end = ( variant->offset == file_size ) || ( stream.peek() == std::char_traits< char >::eof() ) ;
+			std::string SNPID ;
+			bool success = false ;
+			try {
+				success = read_snp_identifying_data(
+					stream, context,
+					&SNPID, &variant->rsid, &variant->chromosome, &variant->position,
+					[variant]( std::size_t n ) { variant->alleles.resize( n ) ; },
+					[variant]( std::size_t i, std::string const& allele ) { variant->alleles.at( i ) = allele ; }
+				) ;
+			} catch( std::exception const& ) {
+				success = false ;
+			}
+			if( !success ) {
+				return FileProblem{
+					fmt::format( "variant {} (offset {})", variant->index + 1, variant->offset ),
+					at_end
+						? fmt::format( "file ends after {} variants, but the header specifies {}", variant->index, context.number_of_variants )
+						: "identifying data could not be read"
+				} ;
+			}
+			// Check the block size before reading the block, to avoid allocating space for a corrupt size.
+			// The size field itself may be cut off, in which case it cannot be read at all.
+			FileProblem const truncated{ describe( *variant ), "genotype data block extends beyond the end of the file" } ;
+			if(( context.flags & e_Layout ) == e_Layout2 || ( context.flags & e_CompressedSNPBlocks )) {
+				int64_t const block_start = stream.tellg() ;
+				if( file_size - block_start < 4 ) {
+					return truncated ;
+				}
+				// If the file size is unknown, the size field may still be cut off here.
+				uint32_t block_size = 0 ;
+				try {
+					read_little_endian_integer( stream, &block_size ) ;
+				} catch( BGenError const& ) {
+					return truncated ;
+				}
+				if( block_start + 4 + int64_t( block_size ) > file_size ) {
+					return truncated ;
+				}
+				// The block is read here, as by read_genotype_data_block(), so that the stream need not seek back.
+				// It is read in chunks so that, if the file size is unknown, a corrupt size only allocates space
+				// for the data actually present.
+				std::size_t const chunk_size = 16 * 1024 * 1024 ;
+				variant->data.clear() ;
+				while( variant->data.size() < block_size ) {
+					std::size_t const size = variant->data.size() ;
+					variant->data.resize( size + std::min< std::size_t >( block_size - size, chunk_size )) ;
+					stream.read( reinterpret_cast< char* >( variant->data.data() + size ), variant->data.size() - size ) ;
+					if( !stream ) {
+						return truncated ;
+					}
+				}
+			} else {
+				try {
+					read_genotype_data_block( stream, context, &variant->data ) ;
+				} catch( BGenError const& ) {
+					return truncated ;
+				}
+			}
+			variant->size = int64_t( stream.tellg() ) - variant->offset ;
+			return std::optional< FileProblem >() ;
+		}
+
+		std::string check_layout2_block( Buffer const& buffer, Context const& context, std::size_t number_of_alleles ) {
+			if( buffer.size() < 10 ) {
+				return fmt::format( "genotype data block is too short ({} bytes)", buffer.size() ) ;
+			}
+			byte_t const* p = &buffer[0] ;
+			byte_t const* const end = p + buffer.size() ;
+			uint32_t N = 0 ;
+			uint16_t K = 0 ;
+			p = read_little_endian_integer( p, end, &N ) ;
+			p = read_little_endian_integer( p, end, &K ) ;
+			if( N != context.number_of_samples ) {
+				return fmt::format( "genotype data block has {} samples, but the header specifies {}", N, context.number_of_samples ) ;
+			}
+			if( K != number_of_alleles ) {
+				return fmt::format( "genotype data block has {} alleles, but the variant has {}", K, number_of_alleles ) ;
+			}
+			if( buffer.size() < 10 + std::size_t( N )) {
+				return fmt::format( "genotype data block is too short ({} bytes) for {} samples", buffer.size(), N ) ;
+			}
+			uint32_t const declared_min = *p++ ;
+			uint32_t const declared_max = *p++ ;
+			uint32_t min_ploidy = 63, max_ploidy = 0 ;
+			byte_t const* const ploidy = p ;
+			p += N ;
+			uint32_t const phased = *p++ ;
+			uint32_t const bits = *p++ ;
+			if( phased > 1 ) {
+				return fmt::format( "phased flag has invalid value {}", phased ) ;
+			}
+			if( bits < 1 || bits > 32 ) {
+				return fmt::format( "number of bits ({}) is not between 1 and 32", bits ) ;
+			}
+			uint64_t number_of_values = 0 ;
+			for( uint32_t i = 0; i < N; ++i ) {
+				if( ploidy[i] & 0x40 ) {
+					return fmt::format( "sample {} has a reserved ploidy bit set", i + 1 ) ;
+				}
+				uint32_t const P = ploidy[i] & 0x3F ;
+				min_ploidy = std::min( min_ploidy, P ) ;
+				max_ploidy = std::max( max_ploidy, P ) ;
+				number_of_values += phased
+					? ( P * ( K - 1 ))
+					: ( impl::number_of_unphased_genotypes( P, K ) - 1 ) ;
+			}
+			if( N > 0 && ( declared_min != min_ploidy || declared_max != max_ploidy )) {
+				return fmt::format(
+					"ploidy range is given as {}-{}, but sample ploidies range from {}-{}",
+					declared_min, declared_max, min_ploidy, max_ploidy
+				) ;
+			}
+			uint64_t const expected_size = ( number_of_values * bits + 7 ) / 8 ;
+			if( uint64_t( end - p ) != expected_size ) {
+				return fmt::format( "probability data is {} bytes, but {} bytes were expected", end - p, expected_size ) ;
+			}
+			return "" ;
+		}
+	}
+}
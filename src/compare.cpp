@@ -0,0 +1,223 @@
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <vector>
+#include <string>
+#include <deque>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include "genfile/bgen.hpp"
+#include "genfile/ViewMerger.hpp"
+#include "genfile/compare.hpp"
+
+namespace genfile {
+	namespace bgen {
+		namespace {
+			bool have_same_key( VariantPair const& a, VariantPair const& b ) {
+				return a.position == b.position && a.chromosome == b.chromosome && a.alleles == b.alleles ;
+			}
+		}
+
+		SampleAccumulator::SampleAccumulator( std::size_t number_of_samples ):
+			compared( number_of_samples, 0 ),
+			missing_in_one( number_of_samples, 0 ),
+			concordant( number_of_samples, 0 ),
+			dosage( number_of_samples ),
+			max_difference( number_of_samples, 0 )
+		{}
+
+		void SampleAccumulator::add( SampleAccumulator const& other ) {
+			for( std::size_t i = 0; i < compared.size(); ++i ) {
+				compared[i] += other.compared[i] ;
+				missing_in_one[i] += other.missing_in_one[i] ;
+				concordant[i] += other.concordant[i] ;
+				dosage[i].add( other.dosage[i] ) ;
+				max_difference[i] = std::max( max_difference[i], other.max_difference[i] ) ;
+			}
+		}
+
+		void ProbabilityCollector::initialise( std::size_t number_of_samples, std::size_t number_of_alleles ) {
+			m_number_of_alleles = number_of_alleles ;
+			m_values.clear() ;
+			m_begin.assign( number_of_samples + 1, 0 ) ;
+			m_missing.assign( number_of_samples, 0 ) ;
+			m_phased.assign( number_of_samples, 0 ) ;
+		}
+
+		void ProbabilityCollector::set_number_of_entries( std::size_t, std::size_t, OrderType order_type, ValueType ) {
+			m_begin[ m_sample_i ] = m_begin[ m_sample_i + 1 ] = m_values.size() ;
+			m_phased[ m_sample_i ] = ( order_type == ePerPhasedHaplotypePerAllele ) ;
+		}
+
+		void ProbabilityCollector::set_value( uint32_t, double value ) {
+			m_values.push_back( value ) ;
+			m_begin[ m_sample_i + 1 ] = m_values.size() ;
+		}
+
+		void ProbabilityCollector::set_value( uint32_t, MissingValue ) {
+			m_values.push_back( 0 ) ;
+			m_begin[ m_sample_i + 1 ] = m_values.size() ;
+			m_missing[ m_sample_i ] = 1 ;
+		}
+
+		double ProbabilityCollector::dosage( std::size_t i ) const {
+			double result = 0 ;
+			double const* v = values(i) ;
+			for( std::size_t j = 0; j < number_of_values(i); ++j ) {
+				// Phased data has (P(first), P(second)) for each haplotype; unphased data
+				// has the genotype with g copies of the second allele at index g.
+				result += ( m_phased[i] ? ( j % 2 ) : j ) * v[j] ;
+			}
+			return result ;
+		}
+
+		bool have_same_calls( double const* x, double const* y, std::size_t n, std::size_t group_size ) {
+			for( std::size_t begin = 0; begin < n; begin += group_size ) {
+				std::size_t const end = std::min( begin + group_size, n ) ;
+				if( std::max_element( x + begin, x + end ) - x != std::max_element( y + begin, y + end ) - y ) {
+					return false ;
+				}
+			}
+			return true ;
+		}
+
+		Comparer::Comparer( Context const& context1, Context const& context2 ):
+			m_contexts{ context1, context2 },
+			// Blocks can be compared without decoding only if they are encoded the same way.
+			m_compare_blocks(
+				( context1.flags & ( e_Layout | e_CompressedSNPBlocks ))
+				== ( context2.flags & ( e_Layout | e_CompressedSNPBlocks ))
+			)
+		{}
+
+		std::vector< VariantResult > Comparer::compare( std::vector< VariantPair > const& variants, SampleAccumulator* samples ) const {
+			std::vector< VariantResult > results( variants.size() ) ;
+			std::vector< byte_t > buffer ;
+			ProbabilityCollector collectors[2] ;
+			for( std::size_t v = 0; v < variants.size(); ++v ) {
+				VariantPair const& variant = variants[v] ;
+				VariantResult& result = results[v] ;
+				result.rsid = variant.rsid ;
+				result.chromosome = variant.chromosome ;
+				result.position = variant.position ;
+				result.alleles = variant.alleles ;
+				result.identical = m_compare_blocks && variant.data[0] == variant.data[1] ;
+				// Identical blocks are decoded only for per-sample totals, and only once.
+				std::size_t const number_to_decode = result.identical ? ( samples ? 1 : 0 ) : 2 ;
+				for( std::size_t k = 0; k < number_to_decode; ++k ) {
+					uncompress_probability_data( m_contexts[k], variant.data[k], &buffer ) ;
+					parse_probability_data( &buffer[0], &buffer[0] + buffer.size(), m_contexts[k], collectors[k] ) ;
+				}
+				if( result.identical && samples ) {
+					VariantResult unused ;
+					compare( collectors[0], collectors[0], &unused, samples ) ;
+				} else if( !result.identical ) {
+					compare( collectors[0], collectors[1], &result, samples ) ;
+				}
+			}
+			return results ;
+		}
+
+		void Comparer::compare(
+			ProbabilityCollector const& x,
+			ProbabilityCollector const& y,
+			VariantResult* result,
+			SampleAccumulator* samples
+		) const {
+			bool const biallelic = ( x.number_of_alleles() == 2 && y.number_of_alleles() == 2 ) ;
+			CorrelationSums dosage ;
+			std::size_t const N = m_contexts[0].number_of_samples ;
+			for( std::size_t i = 0; i < N; ++i ) {
+				if( x.missing(i) || y.missing(i) ) {
+					if( x.missing(i) != y.missing(i) ) {
+						++result->missing_in_one ;
+						if( samples ) {
+							++samples->missing_in_one[i] ;
+						}
+					}
+					continue ;
+				}
+				++result->compared ;
+				if( samples ) {
+					++samples->compared[i] ;
+				}
+				// Samples with different ploidy or phasing in the two files are counted as discordant.
+				std::size_t const n = x.number_of_values(i) ;
+				if( n != y.number_of_values(i) || x.phased(i) != y.phased(i) ) {
+					continue ;
+				}
+				double const* xv = x.values(i) ;
+				double const* yv = y.values(i) ;
+				if( have_same_calls( xv, yv, n, x.phased(i) ? x.number_of_alleles() : n )) {
+					++result->concordant ;
+					if( samples ) {
+						++samples->concordant[i] ;
+					}
+				}
+				double difference = 0 ;
+				for( std::size_t j = 0; j < n; ++j ) {
+					difference = std::max( difference, std::abs( xv[j] - yv[j] )) ;
+				}
+				result->max_difference = std::max( result->max_difference, difference ) ;
+				if( samples ) {
+					samples->max_difference[i] = std::max( samples->max_difference[i], difference ) ;
+				}
+				if( biallelic ) {
+					double const a = x.dosage(i) ;
+					double const b = y.dosage(i) ;
+					dosage.add( a, b ) ;
+					if( samples ) {
+						samples->dosage[i].add( a, b ) ;
+					}
+				}
+			}
+			if( biallelic ) {
+				result->r2 = dosage.r2() ;
+			}
+		}
+
+		PairingSummary pair_variants(
+			ViewMerger& merger,
+			std::size_t chunk_size,
+			std::function< void( std::vector< VariantPair >&& chunk ) > callback
+		) {
+			// The merger reports variants with the same chromosome, position and alleles
+			// consecutively, with those from the first source first.
+			PairingSummary result ;
+			std::deque< VariantPair > unpaired ;
+			std::vector< VariantPair > chunk ;
+			VariantPair variant ;
+			std::string SNPID ;
+			while( merger.read_variant( &SNPID, &variant.rsid, &variant.chromosome, &variant.position, &variant.alleles )) {
+				if( !unpaired.empty() && !have_same_key( unpaired.front(), variant )) {
+					result.only_in[0] += unpaired.size() ;
+					unpaired.clear() ;
+				}
+				std::pair< byte_t const*, byte_t const* > const block = merger.raw_genotype_data_block() ;
+				if( merger.current_source() == 0 ) {
+					variant.data[0].assign( block.first, block.second ) ;
+					unpaired.push_back( variant ) ;
+				} else if( unpaired.empty() ) {
+					++result.only_in[1] ;
+				} else {
+					chunk.push_back( std::move( unpaired.front() )) ;
+					unpaired.pop_front() ;
+					chunk.back().data[1].assign( block.first, block.second ) ;
+					++result.number_of_pairs ;
+					if( chunk.size() == chunk_size ) {
+						callback( std::move( chunk )) ;
+						chunk.clear() ;
+					}
+				}
+			}
+			result.only_in[0] += unpaired.size() ;
+			if( !chunk.empty() ) {
+				callback( std::move( chunk )) ;
+			}
+			return result ;
+		}
+	}
+}
@@ -0,0 +1,170 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <cstring>
+#include <stdint.h>
+#include "genfile/dosage.hpp"
+
+// On x86 with GCC or clang we compile AVX2 versions of the dosage table lookups
+// and select them at runtime if the CPU supports them.
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ))
+#define GENFILE_DOSAGE_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace genfile {
+	namespace {
+		uint32_t float_to_bits( float value ) {
+			uint32_t result ;
+			std::memcpy( &result, &value, 4 ) ;
+			return result ;
+		}
+
+		float bits_to_float( uint32_t bits ) {
+			float result ;
+			std::memcpy( &result, &bits, 4 ) ;
+			return result ;
+		}
+	}
+
+	// Conversion rounds to nearest, ties to even, as IEEE 754 requires.
+	float16_t float16_t::from_float( float value ) {
+		uint32_t const f = float_to_bits( value ) ;
+		uint16_t const sign = uint16_t(( f >> 16 ) & 0x8000 ) ;
+		uint32_t const magnitude = f & 0x7FFFFFFF ;
+		uint16_t result ;
+		if( magnitude >= 0x7F800000 ) {
+			// Inf or NaN (keeping NaNs quiet).
+			result = ( magnitude > 0x7F800000 ) ? 0x7E00 : 0x7C00 ;
+		} else if( magnitude >= 0x477FF000 ) {
+			// Rounds to a value too large for a half; overflow to infinity.
+			result = 0x7C00 ;
+		} else if( magnitude < 0x38800000 ) {
+			// Result is subnormal (or zero).  Shift the mantissa (with implicit leading 1) into place.
+			int const shift = 126 - int( magnitude >> 23 ) ;
+			if( shift > 24 ) {
+				result = 0 ;
+			} else {
+				uint32_t const mantissa = ( magnitude & 0x7FFFFF ) | 0x800000 ;
+				uint32_t const halfway = 1u << ( shift - 1 ) ;
+				uint32_t const remainder = mantissa & (( 1u << shift ) - 1 ) ;
+				result = uint16_t( mantissa >> shift ) ;
+				if( remainder > halfway || ( remainder == halfway && ( result & 1 ))) {
+					++result ;
+				}
+			}
+		} else {
+			// Normal number: rebias the exponent and round the mantissa from 23 to 10 bits.
+			uint32_t const rebiased = magnitude - 0x38000000 ;
+			result = uint16_t( rebiased >> 13 ) ;
+			uint32_t const remainder = rebiased & 0x1FFF ;
+			if( remainder > 0x1000 || ( remainder == 0x1000 && ( result & 1 ))) {
+				++result ;
+			}
+		}
+		return from_bits( sign | result ) ;
+	}
+
+	float float16_t::to_float() const {
+		uint32_t const sign = uint32_t( bits & 0x8000 ) << 16 ;
+		uint32_t const exponent = ( bits >> 10 ) & 0x1F ;
+		uint32_t mantissa = bits & 0x3FF ;
+		if( exponent == 0x1F ) {
+			return bits_to_float( sign | 0x7F800000 | ( mantissa << 13 )) ;
+		} else if( exponent == 0 ) {
+			if( mantissa == 0 ) {
+				return bits_to_float( sign ) ;
+			}
+			// Subnormal: normalise the mantissa.
+			int e = -1 ;
+			do {
+				++e ;
+				mantissa <<= 1 ;
+			} while(( mantissa & 0x400 ) == 0 ) ;
+			return bits_to_float( sign | uint32_t( 112 - e ) << 23 | ( mantissa & 0x3FF ) << 13 ) ;
+		}
+		return bits_to_float( sign | ( exponent + 112 ) << 23 | mantissa << 13 ) ;
+	}
+
+	bfloat16_t bfloat16_t::from_float( float value ) {
+		uint32_t const f = float_to_bits( value ) ;
+		if(( f & 0x7FFFFFFF ) > 0x7F800000 ) {
+			return from_bits( uint16_t(( f >> 16 ) | 0x0040 )) ;
+		}
+		// Round to nearest, ties to even.
+		return from_bits( uint16_t(( f + 0x7FFF + (( f >> 16 ) & 1 )) >> 16 )) ;
+	}
+
+	float bfloat16_t::to_float() const {
+		return bits_to_float( uint32_t( bits ) << 16 ) ;
+	}
+}
+
+#if GENFILE_DOSAGE_HAVE_AVX2
+namespace {
+	bool cpu_supports_avx2() {
+		static bool const result = __builtin_cpu_supports( "avx2" ) ;
+		return result ;
+	}
+
+	// Load eight consecutive 1- or 2-byte keys, zero-extended to 32-bit lanes.
+	__attribute__(( target( "avx2" )))
+	__m256i load_keys( genfile::byte_t const* keys, std::size_t key_bytes ) {
+		if( key_bytes == 2 ) {
+			return _mm256_cvtepu16_epi32( _mm_loadu_si128( reinterpret_cast< __m128i const* >( keys ))) ;
+		} else {
+			return _mm256_cvtepu8_epi32( _mm_loadl_epi64( reinterpret_cast< __m128i const* >( keys ))) ;
+		}
+	}
+
+	__attribute__(( target( "avx2" )))
+	std::size_t gather_dosages_avx2( float const* table, genfile::byte_t const* keys, std::size_t key_bytes, std::size_t n, float* out ) {
+		std::size_t i = 0 ;
+		for( ; i + 8 <= n; i += 8, keys += 8 * key_bytes ) {
+			__m256i const indices = load_keys( keys, key_bytes ) ;
+			_mm256_storeu_ps( out + i, _mm256_i32gather_ps( table, indices, 4 )) ;
+		}
+		return i ;
+	}
+
+	__attribute__(( target( "avx2" )))
+	std::size_t gather_dosages_avx2( double const* table, genfile::byte_t const* keys, std::size_t key_bytes, std::size_t n, double* out ) {
+		std::size_t i = 0 ;
+		for( ; i + 8 <= n; i += 8, keys += 8 * key_bytes ) {
+			__m256i const indices = load_keys( keys, key_bytes ) ;
+			_mm256_storeu_pd( out + i, _mm256_i32gather_pd( table, _mm256_castsi256_si128( indices ), 8 )) ;
+			_mm256_storeu_pd( out + i + 4, _mm256_i32gather_pd( table, _mm256_extracti128_si256( indices, 1 ), 8 )) ;
+		}
+		return i ;
+	}
+}
+#endif
+
+namespace genfile {
+	namespace bgen {
+		namespace v12 {
+			namespace impl {
+				std::size_t gather_dosages( float const* table, byte_t const* keys, std::size_t key_bytes, std::size_t n, float* out ) {
+#if GENFILE_DOSAGE_HAVE_AVX2
+					if( cpu_supports_avx2() ) {
+						return gather_dosages_avx2( table, keys, key_bytes, n, out ) ;
+					}
+#endif
+					return 0 ;
+				}
+
+				std::size_t gather_dosages( double const* table, byte_t const* keys, std::size_t key_bytes, std::size_t n, double* out ) {
+#if GENFILE_DOSAGE_HAVE_AVX2
+					if( cpu_supports_avx2() ) {
+						return gather_dosages_avx2( table, keys, key_bytes, n, out ) ;
+					}
+#endif
+					return 0 ;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,70 @@
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <string>
+#include <vector>
+#include <cmath>
+#include <charconv>
+#include <stdexcept>
+#include <stdint.h>
+#include "genfile/gen.hpp"
+
+namespace genfile {
+	namespace gen {
+		void split_whitespace( Slice const& line, std::vector< Slice >* result ) {
+			result->clear() ;
+			char const* p = line.first ;
+			while( true ) {
+				while( p < line.second && is_space( *p )) {
+					++p ;
+				}
+				if( p == line.second ) {
+					break ;
+				}
+				char const* q = p ;
+				while( q < line.second && !is_space( *q )) {
+					++q ;
+				}
+				result->push_back( Slice( p, q )) ;
+				p = q ;
+			}
+		}
+
+		// GEN probabilities are almost always plain decimals like "0.8745", which we parse directly;
+		// anything else goes to std::from_chars.
+		double parse_probability( Slice const& slice ) {
+			static double const powers_of_ten[] = {
+				1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+				1e10, 1e11, 1e12, 1e13, 1e14, 1e15
+			} ;
+			char const* p = slice.first ;
+			uint64_t integer_part = 0 ;
+			uint64_t fractional_part = 0 ;
+			std::size_t fractional_digits = 0 ;
+			for( ; p < slice.second && *p >= '0' && *p <= '9' && ( p - slice.first ) < 9; ++p ) {
+				integer_part = integer_part * 10 + ( *p - '0' ) ;
+			}
+			if( p > slice.first && p < slice.second && *p == '.' ) {
+				++p ;
+				for( ; p < slice.second && *p >= '0' && *p <= '9' && fractional_digits < 15; ++p, ++fractional_digits ) {
+					fractional_part = fractional_part * 10 + ( *p - '0' ) ;
+				}
+			}
+			if( p == slice.second && p > slice.first ) {
+				return double( integer_part ) + double( fractional_part ) / powers_of_ten[ fractional_digits ] ;
+			}
+			double result = 0 ;
+			std::from_chars_result r = std::from_chars( slice.first, slice.second, result ) ;
+			if( r.ec != std::errc() || r.ptr != slice.second ) {
+				throw std::invalid_argument( "could not parse \"" + to_string( slice ) + "\" as a probability" ) ;
+			}
+			// from_chars() accepts "nan" and "inf", which would otherwise pass through renormalisation unnoticed.
+			if( !std::isfinite( result ) || result < 0.0 ) {
+				throw std::invalid_argument( "probability \"" + to_string( slice ) + "\" is not a finite non-negative number" ) ;
+			}
+			return result ;
+		}
+	}
+}
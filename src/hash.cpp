@@ -0,0 +1,96 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <cstddef>
+#include <stdint.h>
+#include "genfile/hash.hpp"
+
+namespace genfile {
+	namespace {
+		// Constants and steps of XXH64, as in the reference implementation at https://github.com/Cyan4973/xxHash.
+		uint64_t const prime1 = 0x9E3779B185EBCA87ULL ;
+		uint64_t const prime2 = 0xC2B2AE3D27D4EB4FULL ;
+		uint64_t const prime3 = 0x165667B19E3779F9ULL ;
+		uint64_t const prime4 = 0x85EBCA77C2B2AE63ULL ;
+		uint64_t const prime5 = 0x27D4EB2F165667C5ULL ;
+
+		inline uint64_t rotate_left( uint64_t x, int r ) {
+			return ( x << r ) | ( x >> ( 64 - r )) ;
+		}
+
+		// Read little-endian integers from unaligned data.
+		inline uint64_t read64( byte_t const* p ) {
+			uint64_t result = 0 ;
+			for( int i = 7; i >= 0; --i ) {
+				result = ( result << 8 ) | p[i] ;
+			}
+			return result ;
+		}
+
+		inline uint32_t read32( byte_t const* p ) {
+			return uint32_t( p[0] ) | ( uint32_t( p[1] ) << 8 ) | ( uint32_t( p[2] ) << 16 ) | ( uint32_t( p[3] ) << 24 ) ;
+		}
+
+		inline uint64_t round( uint64_t accumulator, uint64_t input ) {
+			accumulator += input * prime2 ;
+			accumulator = rotate_left( accumulator, 31 ) ;
+			return accumulator * prime1 ;
+		}
+
+		inline uint64_t merge_round( uint64_t accumulator, uint64_t value ) {
+			accumulator ^= round( 0, value ) ;
+			return accumulator * prime1 + prime4 ;
+		}
+	}
+
+	uint64_t xxh64( byte_t const* begin, byte_t const* const end, uint64_t seed ) {
+		std::size_t const length = end - begin ;
+		uint64_t h ;
+		if( length >= 32 ) {
+			// Four lanes of 8 bytes are accumulated independently, so the loop is not limited by latency.
+			uint64_t v1 = seed + prime1 + prime2 ;
+			uint64_t v2 = seed + prime2 ;
+			uint64_t v3 = seed ;
+			uint64_t v4 = seed - prime1 ;
+			for( ; end - begin >= 32; begin += 32 ) {
+				v1 = round( v1, read64( begin )) ;
+				v2 = round( v2, read64( begin + 8 )) ;
+				v3 = round( v3, read64( begin + 16 )) ;
+				v4 = round( v4, read64( begin + 24 )) ;
+			}
+			h = rotate_left( v1, 1 ) + rotate_left( v2, 7 ) + rotate_left( v3, 12 ) + rotate_left( v4, 18 ) ;
+			h = merge_round( h, v1 ) ;
+			h = merge_round( h, v2 ) ;
+			h = merge_round( h, v3 ) ;
+			h = merge_round( h, v4 ) ;
+		} else {
+			h = seed + prime5 ;
+		}
+		h += uint64_t( length ) ;
+
+		for( ; end - begin >= 8; begin += 8 ) {
+			h ^= round( 0, read64( begin )) ;
+			h = rotate_left( h, 27 ) * prime1 + prime4 ;
+		}
+		if( end - begin >= 4 ) {
+			h ^= uint64_t( read32( begin )) * prime1 ;
+			h = rotate_left( h, 23 ) * prime2 + prime3 ;
+			begin += 4 ;
+		}
+		for( ; begin < end; ++begin ) {
+			h ^= uint64_t( *begin ) * prime5 ;
+			h = rotate_left( h, 11 ) * prime1 ;
+		}
+
+		// Final mixing.
+		h ^= h >> 33 ;
+		h *= prime2 ;
+		h ^= h >> 29 ;
+		h *= prime3 ;
+		h ^= h >> 32 ;
+		return h ;
+	}
+}
@@ -0,0 +1,194 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <fmt/format.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include "serve/http.hpp"
+
+namespace serve {
+	namespace {
+		bool write_all( int socket, char const* data, std::size_t size ) {
+			while( size > 0 ) {
+				ssize_t const count = ::send( socket, data, size, 0 ) ;
+				if( count < 0 && errno == EINTR ) {
+					continue ;
+				}
+				if( count <= 0 ) {
+					return false ;
+				}
+				data += count ;
+				size -= count ;
+			}
+			return true ;
+		}
+	}
+
+	char const* status_text( int status ) {
+		switch( status ) {
+			case 200: return "OK" ;
+			case 400: return "Bad Request" ;
+			case 404: return "Not Found" ;
+			case 405: return "Method Not Allowed" ;
+			case 413: return "Payload Too Large" ;
+			default: return "Internal Server Error" ;
+		}
+	}
+
+	std::vector< std::string > split( std::string_view const& s, char separator ) {
+		std::vector< std::string > result ;
+		if( s.empty() ) {
+			return result ;
+		}
+		for( std::size_t begin = 0, end = 0; end != std::string_view::npos; begin = end + 1 ) {
+			end = s.find( separator, begin ) ;
+			result.emplace_back( s.substr( begin, end - begin )) ;
+		}
+		return result ;
+	}
+
+	std::string url_decode( std::string_view const& s ) {
+		std::string result ;
+		result.reserve( s.size() ) ;
+		for( std::size_t i = 0; i < s.size(); ++i ) {
+			if( s[i] == '+' ) {
+				result += ' ' ;
+			} else if( s[i] == '%' && i + 2 < s.size() && std::isxdigit( s[i+1] ) && std::isxdigit( s[i+2] )) {
+				result += char( std::stoi( std::string( s.substr( i+1, 2 )), 0, 16 )) ;
+				i += 2 ;
+			} else {
+				result += s[i] ;
+			}
+		}
+		return result ;
+	}
+
+	void parse_parameters( std::string_view const& encoded, std::map< std::string, std::string >* result ) {
+		for( std::string const& pair: split( encoded, '&' )) {
+			std::size_t const equals = pair.find( '=' ) ;
+			if( equals == std::string::npos ) {
+				(*result)[ url_decode( pair ) ] = "" ;
+			} else {
+				(*result)[ url_decode( std::string_view( pair ).substr( 0, equals )) ] = url_decode( std::string_view( pair ).substr( equals + 1 )) ;
+			}
+		}
+	}
+
+	bool read_request( int socket, HttpRequest* request, std::size_t const max_header_size, std::size_t const max_body_size ) {
+		std::string buffer ;
+		std::size_t header_end = std::string::npos ;
+		char data[ 4096 ] ;
+		while( header_end == std::string::npos ) {
+			if( buffer.size() > max_header_size ) {
+				throw HttpError( 400, "Request header is too large." ) ;
+			}
+			ssize_t const count = ::recv( socket, data, sizeof( data ), 0 ) ;
+			if( count <= 0 ) {
+				if( buffer.empty() ) {
+					return false ;
+				}
+				throw HttpError( 400, "Incomplete request." ) ;
+			}
+			buffer.append( data, count ) ;
+			header_end = buffer.find( "\r\n\r\n" ) ;
+		}
+		if( header_end > max_header_size ) {
+			throw HttpError( 400, "Request header is too large." ) ;
+		}
+
+		std::vector< std::string > const lines = split( std::string_view( buffer ).substr( 0, header_end ), '\n' ) ;
+		std::vector< std::string > const request_line = split( lines.empty() ? std::string_view() : std::string_view( lines[0] ), ' ' ) ;
+		if( request_line.size() != 3 ) {
+			throw HttpError( 400, "Malformed request line." ) ;
+		}
+		request->method = request_line[0] ;
+		std::size_t const query_start = request_line[1].find( '?' ) ;
+		request->path = url_decode( std::string_view( request_line[1] ).substr( 0, query_start )) ;
+		if( query_start != std::string::npos ) {
+			parse_parameters( std::string_view( request_line[1] ).substr( query_start + 1 ), &request->parameters ) ;
+		}
+
+		std::size_t content_length = 0 ;
+		for( std::size_t i = 1; i < lines.size(); ++i ) {
+			std::size_t const colon = lines[i].find( ':' ) ;
+			if( colon == std::string::npos ) {
+				continue ;
+			}
+			std::string name = lines[i].substr( 0, colon ) ;
+			std::transform( name.begin(), name.end(), name.begin(), []( unsigned char c ) { return std::tolower( c ) ; } ) ;
+			if( name == "content-length" ) {
+				std::string const value = lines[i].substr( colon + 1 ) ;
+				std::size_t const begin = value.find_first_not_of( " \t" ) ;
+				std::size_t const end = value.find_last_not_of( " \t\r" ) ;
+				if( begin == std::string::npos || value.find_first_not_of( "0123456789", begin ) <= end ) {
+					throw HttpError( 400, "Malformed Content-Length header." ) ;
+				}
+				try {
+					content_length = std::stoull( value.substr( begin, end + 1 - begin )) ;
+				} catch( std::exception const& ) {
+					// The value is too large to represent.
+					throw HttpError( 413, "Request body is too large." ) ;
+				}
+			}
+		}
+		if( content_length > max_body_size ) {
+			throw HttpError( 413, "Request body is too large." ) ;
+		}
+		std::string body = buffer.substr( header_end + 4 ) ;
+		while( body.size() < content_length ) {
+			ssize_t const count = ::recv( socket, data, sizeof( data ), 0 ) ;
+			if( count <= 0 ) {
+				throw HttpError( 400, "Incomplete request." ) ;
+			}
+			body.append( data, count ) ;
+		}
+		if( request->method == "POST" ) {
+			parse_parameters( std::string_view( body ).substr( 0, content_length ), &request->parameters ) ;
+		}
+		return true ;
+	}
+
+	std::size_t send_response( int socket, HttpResponse const& response ) {
+		std::string header = fmt::format(
+			"HTTP/1.1 {} {}\r\nContent-Type: {}\r\nContent-Length: {}\r\nConnection: close\r\n",
+			response.status, status_text( response.status ), response.content_type, response.body.size()
+		) ;
+		for( std::pair< std::string, std::string > const& h: response.headers ) {
+			header += h.first + ": " + h.second + "\r\n" ;
+		}
+		header += "\r\n" ;
+		if( !write_all( socket, header.data(), header.size() ) || !write_all( socket, response.body.data(), response.body.size() )) {
+			return 0 ;
+		}
+		return header.size() + response.body.size() ;
+	}
+
+	std::string json_string( std::string_view const& s ) {
+		std::string result = "\"" ;
+		for( char c: s ) {
+			switch( c ) {
+				case '"': result += "\\\"" ; break ;
+				case '\\': result += "\\\\" ; break ;
+				case '\n': result += "\\n" ; break ;
+				case '\t': result += "\\t" ; break ;
+				default:
+					if( (unsigned char)( c ) < 0x20 ) {
+						result += fmt::format( "\\u{:04x}", int( c )) ;
+					} else {
+						result += c ;
+					}
+			}
+		}
+		return result + "\"" ;
+	}
+}
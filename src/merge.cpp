@@ -0,0 +1,191 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+#include <cassert>
+#include <cstring>
+#include "genfile/bgen.hpp"
+#include "genfile/zlib.hpp"
+#include "genfile/merge.hpp"
+
+namespace genfile {
+	namespace bgen {
+		std::pair< byte_t const*, byte_t const* > compress_probability_data(
+			Context const& context,
+			byte_t const* buffer,
+			byte_t const* const end,
+			std::vector< byte_t >* result
+		) {
+			assert(( context.flags & e_Layout ) == e_Layout2 ) ;
+			uint32_t const uncompressed_data_size = uint32_t( end - buffer ) ;
+			uint32_t const compressionType = ( context.flags & e_CompressedSNPBlocks ) ;
+			if( compressionType == e_ZlibCompression ) {
+				zlib_compress( buffer, end, result, 8, 9 ) ;
+			} else if( compressionType == e_ZstdCompression ) {
+				zstd_compress( buffer, end, result, 8, 17 ) ;
+			} else {
+				result->resize( uncompressed_data_size + 4 ) ;
+				std::copy( buffer, end, result->data() + 4 ) ;
+			}
+			// Write the total size of the following data, and (if compressed) the uncompressed size,
+			// using the same settings as GenotypeDataBlockWriter.
+			write_little_endian_integer( result->data(), result->data() + 4, uint32_t( result->size() - 4 )) ;
+			if( compressionType != e_NoCompression ) {
+				write_little_endian_integer( result->data() + 4, result->data() + 8, uncompressed_data_size ) ;
+			}
+			return std::make_pair( result->data(), result->data() + result->size() ) ;
+		}
+
+		namespace v12 {
+			namespace {
+				// Return the number of bits of probability data stored in the given block.
+				std::size_t number_of_data_bits( GenotypeDataBlock const& block ) {
+					std::size_t result = 0 ;
+					for( std::size_t i = 0; i < block.numberOfSamples; ++i ) {
+						uint32_t const ploidy = block.ploidy[i] & 0x3F ;
+						result += block.phased
+							? ( ploidy * ( block.numberOfAlleles - 1 ))
+							: ( genfile::bgen::impl::number_of_unphased_genotypes( ploidy, block.numberOfAlleles ) - 1 ) ;
+					}
+					return result * block.bits ;
+				}
+
+				// Append the first number_of_bits bits of source to the bit-packed data in [result, end),
+				// which currently holds *bit_offset bits and is large enough to hold the appended data.
+				void append_bits(
+					byte_t const* source,
+					std::size_t number_of_bits,
+					byte_t* result,
+					byte_t* const end,
+					std::size_t* bit_offset
+				) {
+					byte_t* p = result + ( *bit_offset / 8 ) ;
+					unsigned int const shift = *bit_offset % 8 ;
+					std::size_t const number_of_bytes = ( number_of_bits + 7 ) / 8 ;
+					if( shift == 0 ) {
+						std::memcpy( p, source, number_of_bytes ) ;
+					} else {
+						for( std::size_t i = 0; i < number_of_bytes; ++i ) {
+							p[i] |= byte_t( source[i] << shift ) ;
+							if( p + i + 1 < end ) {
+								p[i+1] = byte_t( source[i] >> ( 8 - shift )) ;
+							}
+						}
+					}
+					*bit_offset += number_of_bits ;
+					// Clear any trailing bits of the last byte beyond the data, which may be set in the source.
+					if( *bit_offset % 8 ) {
+						result[ *bit_offset / 8 ] &= byte_t(( 1u << ( *bit_offset % 8 )) - 1 ) ;
+					}
+				}
+
+				// Setter forwarding parsed probabilities to a writer, offsetting sample indices.
+				struct OffsetSetter {
+					OffsetSetter( ProbabilityDataWriter& writer, std::size_t offset ):
+						m_writer( writer ),
+						m_offset( offset )
+					{}
+					void initialise( std::size_t, std::size_t ) {}
+					bool set_sample( std::size_t i ) { return m_writer.set_sample( m_offset + i ) ; }
+					void set_number_of_entries( std::size_t ploidy, std::size_t number_of_entries, OrderType order_type, ValueType value_type ) {
+						m_writer.set_number_of_entries( uint32_t( ploidy ), uint32_t( number_of_entries ), order_type, value_type ) ;
+					}
+					void set_value( uint32_t entry_i, genfile::MissingValue const value ) { m_writer.set_value( entry_i, value ) ; }
+					void set_value( uint32_t entry_i, double const value ) { m_writer.set_value( entry_i, value ) ; }
+				private:
+					ProbabilityDataWriter& m_writer ;
+					std::size_t const m_offset ;
+				} ;
+			}
+
+			void merge_samples(
+				std::vector< GenotypeDataBlock const* > const& blocks,
+				int const number_of_bits,
+				std::vector< byte_t >* result
+			) {
+				assert( !blocks.empty() ) ;
+				uint16_t const numberOfAlleles = blocks[0]->numberOfAlleles ;
+				uint32_t numberOfSamples = 0 ;
+				byte_t ploidyExtent[2] = { 63, 0 } ;
+				bool copy_bits = true ;
+				std::size_t total_bits = 0 ;
+				// Phasing matters only if some sample has ploidy > 1.
+				int phased = -1 ;
+				for( std::size_t k = 0; k < blocks.size(); ++k ) {
+					GenotypeDataBlock const& block = *blocks[k] ;
+					if( block.numberOfAlleles != numberOfAlleles ) {
+						throw std::invalid_argument(
+							"Blocks have different numbers of alleles ("
+							+ std::to_string( numberOfAlleles ) + " and " + std::to_string( block.numberOfAlleles ) + ")."
+						) ;
+					}
+					if( block.numberOfSamples > 0 && ( block.ploidyExtent[1] & 0x3F ) > 1 ) {
+						if( phased != -1 && phased != int( block.phased )) {
+							throw std::invalid_argument( "Some blocks contain phased data and some unphased data." ) ;
+						}
+						phased = block.phased ;
+					}
+					if( block.numberOfSamples > 0 ) {
+						ploidyExtent[0] = std::min( ploidyExtent[0], block.ploidyExtent[0] ) ;
+						ploidyExtent[1] = std::max( ploidyExtent[1], block.ploidyExtent[1] ) ;
+					}
+					numberOfSamples += block.numberOfSamples ;
+					copy_bits = copy_bits && ( block.bits == number_of_bits ) && ( block.phased == blocks[0]->phased ) ;
+					if( copy_bits ) {
+						std::size_t const bits = number_of_data_bits( block ) ;
+						if( block.buffer + ( bits + 7 ) / 8 > block.end ) {
+							throw BGenError() ;
+						}
+						total_bits += bits ;
+					}
+				}
+				if( numberOfSamples == 0 ) {
+					ploidyExtent[0] = 0 ;
+				}
+
+				if( copy_bits ) {
+					result->assign( 10 + numberOfSamples + ( total_bits + 7 ) / 8, 0 ) ;
+					byte_t* p = result->data() ;
+					byte_t* const end = p + result->size() ;
+					p = write_little_endian_integer( p, end, numberOfSamples ) ;
+					p = write_little_endian_integer( p, end, numberOfAlleles ) ;
+					*p++ = ploidyExtent[0] ;
+					*p++ = ploidyExtent[1] ;
+					for( std::size_t k = 0; k < blocks.size(); ++k ) {
+						p = std::copy( blocks[k]->ploidy, blocks[k]->ploidy + blocks[k]->numberOfSamples, p ) ;
+					}
+					*p++ = blocks[0]->phased ? 1 : 0 ;
+					*p++ = byte_t( number_of_bits ) ;
+					std::size_t bit_offset = 0 ;
+					for( std::size_t k = 0; k < blocks.size(); ++k ) {
+						append_bits( blocks[k]->buffer, number_of_data_bits( *blocks[k] ), p, end, &bit_offset ) ;
+					}
+				} else {
+					uint32_t const max_ploidy = ploidyExtent[1] & 0x3F ;
+					std::size_t const max_entries = std::max< std::size_t >(
+						genfile::bgen::impl::number_of_unphased_genotypes( max_ploidy, numberOfAlleles ),
+						max_ploidy * numberOfAlleles
+					) ;
+					std::size_t const buffer_size = 10 + numberOfSamples + (( numberOfSamples * max_entries * number_of_bits ) + 7 ) / 8 ;
+					result->resize( buffer_size ) ;
+					ProbabilityDataWriter writer( static_cast< uint8_t >( number_of_bits )) ;
+					writer.initialise( numberOfSamples, numberOfAlleles, result->data(), result->data() + buffer_size ) ;
+					std::size_t offset = 0 ;
+					for( std::size_t k = 0; k < blocks.size(); ++k ) {
+						OffsetSetter setter( writer, offset ) ;
+						parse_probability_data( *blocks[k], setter ) ;
+						offset += blocks[k]->numberOfSamples ;
+					}
+					writer.finalise() ;
+					result->resize( writer.repr().second - writer.repr().first ) ;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,97 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+#include <stdexcept>
+#include <stdint.h>
+#include "genfile/IndexQuery.hpp"
+#include "genfile/query_spec.hpp"
+
+namespace genfile {
+	namespace bgen {
+		namespace {
+			// Return true if value is a position, i.e. a non-empty string of digits representing a 32-bit value.
+			bool is_position( std::string const& value ) {
+				return !value.empty()
+					&& value.size() <= 10
+					&& value.find_first_not_of( "0123456789" ) == std::string::npos
+					&& std::stoull( value ) <= std::numeric_limits< uint32_t >::max() ;
+			}
+		}
+
+		std::vector< std::string > collect_unique_ids( std::vector< std::string > const& ids_or_filenames ) {
+			std::vector< std::string > result ;
+			for( std::string const& elt: ids_or_filenames ) {
+				if( std::filesystem::exists( elt )) {
+					std::ifstream f( elt ) ;
+					if( !f ) {
+						throw std::invalid_argument( "File \"" + elt + "\" could not be opened." ) ;
+					}
+					std::copy(
+						std::istream_iterator< std::string >( f ),
+						std::istream_iterator< std::string >(),
+						std::back_inserter< std::vector< std::string > >( result )
+					) ;
+				} else {
+					result.push_back( elt ) ;
+				}
+			}
+			std::sort( result.begin(), result.end() ) ;
+			result.erase( std::unique( result.begin(), result.end() ), result.end() ) ;
+			return result ;
+		}
+
+		IndexQuery::GenomicRange parse_range( std::string const& spec ) {
+			std::size_t const colon_pos = spec.find( ':' ) ;
+			std::size_t const separator_pos = ( colon_pos == std::string::npos ) ? std::string::npos : spec.find( '-', colon_pos ) ;
+			std::string const pos1 = ( separator_pos == std::string::npos ) ? "" : spec.substr( colon_pos + 1, separator_pos - colon_pos - 1 ) ;
+			std::string const pos2 = ( separator_pos == std::string::npos ) ? "" : spec.substr( separator_pos + 1 ) ;
+			if(
+				separator_pos == std::string::npos
+				|| colon_pos == 0
+				|| !( pos1.empty() || is_position( pos1 ))
+				|| !( pos2.empty() || is_position( pos2 ))
+				|| ( !pos1.empty() && !pos2.empty() && std::stoull( pos2 ) < std::stoull( pos1 ))
+			) {
+				throw std::invalid_argument( "Malformed range \"" + spec + "\", expected <chr>:<pos1>-<pos2>." ) ;
+			}
+			return IndexQuery::GenomicRange(
+				spec.substr( 0, colon_pos ),
+				pos1.empty() ? 0 : uint32_t( std::stoull( pos1 )),
+				pos2.empty() ? std::numeric_limits< uint32_t >::max() : uint32_t( std::stoull( pos2 ))
+			) ;
+		}
+
+		IndexQuery::VariantPosition parse_position( std::string const& spec ) {
+			std::vector< std::string > pieces ;
+			for( std::size_t begin = 0; begin <= spec.size(); ) {
+				std::size_t const end = std::min( spec.find( ':', begin ), spec.size() ) ;
+				pieces.push_back( spec.substr( begin, end - begin )) ;
+				begin = end + 1 ;
+			}
+			if(
+				( pieces.size() != 2 && pieces.size() != 4 )
+				|| pieces[0].empty()
+				|| !is_position( pieces[1] )
+				|| ( pieces.size() == 4 && ( pieces[2].empty() || pieces[3].empty() ))
+			) {
+				throw std::invalid_argument( "Malformed position \"" + spec + "\", expected <chr>:<pos> or <chr>:<pos>:<allele1>:<allele2>." ) ;
+			}
+			uint32_t const position = uint32_t( std::stoull( pieces[1] )) ;
+			if( pieces.size() == 2 ) {
+				return IndexQuery::VariantPosition( pieces[0], position ) ;
+			} else {
+				return IndexQuery::VariantPosition( pieces[0], position, pieces[2], pieces[3] ) ;
+			}
+		}
+	}
+}
@@ -0,0 +1,108 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include "genfile/bgen.hpp"
+#include "genfile/VariantBatch.hpp"
+#include "genfile/variant_filter.hpp"
+
+namespace genfile {
+	namespace bgen {
+		void VariantStatsSetter::initialise( std::size_t number_of_samples, std::size_t number_of_alleles ) {
+			*m_result = VariantStats() ;
+			m_number_of_samples = number_of_samples ;
+			m_biallelic = ( number_of_alleles == 2 ) ;
+			m_number_of_missing_samples = 0 ;
+			m_total_ploidy = 0 ;
+			m_total_dosage = 0.0 ;
+			m_total_variance = 0.0 ;
+		}
+
+		void VariantStatsSetter::set_number_of_entries(
+			std::size_t ploidy,
+			std::size_t number_of_entries,
+			genfile::OrderType order_type,
+			genfile::ValueType
+		) {
+			m_ploidy = ploidy ;
+			m_number_of_entries = number_of_entries ;
+			m_phased = ( order_type == genfile::ePerPhasedHaplotypePerAllele ) ;
+			m_dosage = 0.0 ;
+			m_second_moment = 0.0 ;
+		}
+
+		void VariantStatsSetter::set_value( uint32_t entry_i, double value ) {
+			// Unphased entries are ordered by count of the second allele;
+			// phased entries alternate between first and second allele on each haplotype.
+			if( m_phased ) {
+				if( entry_i % 2 ) {
+					m_dosage += value ;
+					// Haplotypes are independent, so their variances add.
+					m_second_moment += value * ( 1.0 - value ) ;
+				}
+			} else {
+				m_dosage += entry_i * value ;
+				m_second_moment += entry_i * entry_i * value ;
+			}
+			if( entry_i + 1 == m_number_of_entries ) {
+				m_total_ploidy += m_ploidy ;
+				m_total_dosage += m_dosage ;
+				m_total_variance += m_phased ? m_second_moment : ( m_second_moment - m_dosage * m_dosage ) ;
+			}
+		}
+
+		void VariantStatsSetter::set_value( uint32_t entry_i, genfile::MissingValue ) {
+			if( entry_i + 1 == m_number_of_entries ) {
+				++m_number_of_missing_samples ;
+			}
+		}
+
+		void VariantStatsSetter::finalise() {
+			if( !m_biallelic ) {
+				return ;
+			}
+			m_result->missing_rate = ( m_number_of_samples == 0 ) ? 0.0 : double( m_number_of_missing_samples ) / m_number_of_samples ;
+			if( m_total_ploidy > 0 ) {
+				double const theta = m_total_dosage / m_total_ploidy ;
+				double const expected_variance = m_total_ploidy * theta * ( 1.0 - theta ) ;
+				m_result->allele_frequency = theta ;
+				m_result->info = ( expected_variance > 0.0 ) ? ( 1.0 - m_total_variance / expected_variance ) : 1.0 ;
+			}
+		}
+
+		bool VariantFilter::passes( VariantStats const& stats ) const {
+			double const maf = std::min( stats.allele_frequency, 1.0 - stats.allele_frequency ) ;
+			return ( !min_maf || maf >= *min_maf )
+				&& ( !min_info || stats.info >= *min_info )
+				&& ( !max_missing_rate || stats.missing_rate <= *max_missing_rate ) ;
+		}
+
+		FilteredVariantBatch filter_variant_batch(
+			VariantBatch&& batch,
+			Context const& context,
+			VariantFilter const& filter
+		) {
+			FilteredVariantBatch result ;
+			result.batch = std::move( batch ) ;
+			result.included.assign( result.batch.size(), 1 ) ;
+			if( filter.needs_stats() ) {
+				std::vector< byte_t > buffer1, buffer2 ;
+				VariantStats stats ;
+				VariantStatsSetter setter( &stats ) ;
+				for( std::size_t i = 0; i < result.batch.size(); ++i ) {
+					std::pair< byte_t const*, byte_t const* > const block = result.batch.genotype_data_block( i ) ;
+					buffer1.assign( block.first, block.second ) ;
+					uncompress_probability_data( context, buffer1, &buffer2 ) ;
+					parse_probability_data( buffer2.data(), buffer2.data() + buffer2.size(), context, setter ) ;
+					result.included[i] = filter.passes( stats ) ;
+				}
+			}
+			return result ;
+		}
+	}
+}
@@ -0,0 +1,222 @@
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <cassert>
+#include <fmt/format.h>
+#include "genfile/bgen.hpp"
+#include "genfile/VariantBatch.hpp"
+#include "genfile/ThreadPool.hpp"
+#include "genfile/variant_list.hpp"
+
+namespace genfile {
+	namespace bgen {
+		namespace {
+			ListFieldSpec const list_field_specs[] = {
+				{ "alternate_ids", "snpid", eAlternateIds, 4 },
+				{ "rsid", "rsid", eRsid, 4 },
+				{ "chromosome", "chrom", eChromosome, 4 },
+				{ "position", "pos", ePosition, 2 },
+				{ "number_of_alleles", "number_of_alleles", eNumberOfAlleles, 1 },
+				{ "first_allele", "first_allele", eFirstAllele, 4 },
+				{ "alternative_alleles", "alternative_alleles", eAlternativeAlleles, 4 },
+				{ "file_start_position", "offset", eFileStartPosition, 3 },
+				{ "size_in_bytes", "size", eSizeInBytes, 3 }
+			} ;
+
+			void append_string_field( VariantBatch const& batch, std::size_t i, ListField field, std::string* out ) {
+				switch( field ) {
+					case eAlternateIds: out->append( batch.SNPID(i) ) ; break ;
+					case eRsid: out->append( batch.rsid(i) ) ; break ;
+					case eChromosome: out->append( batch.chromosome(i) ) ; break ;
+					case eFirstAllele: out->append( batch.allele( i, 0 )) ; break ;
+					case eAlternativeAlleles:
+						for( std::size_t j = 1; j < batch.number_of_stored_alleles(i); ++j ) {
+							if( j > 1 ) {
+								out->push_back( ',' ) ;
+							}
+							out->append( batch.allele( i, j )) ;
+						}
+						break ;
+					default:
+						assert(0) ;
+				}
+			}
+
+			template< typename IntegerType >
+			void append_little_endian_integer( IntegerType const value, std::string* out ) {
+				byte_t buffer[ sizeof( IntegerType ) ] ;
+				write_little_endian_integer( buffer, buffer + sizeof( IntegerType ), value ) ;
+				out->append( reinterpret_cast< char const* >( buffer ), sizeof( IntegerType )) ;
+			}
+		}
+
+		std::vector< ListFieldSpec > parse_list_fields( std::string const& spec, bool from_index ) {
+			std::vector< ListFieldSpec > result ;
+			std::size_t begin = 0 ;
+			while( begin <= spec.size() ) {
+				std::size_t end = std::min( spec.find( ',', begin ), spec.size() ) ;
+				std::string const name = spec.substr( begin, end - begin ) ;
+				auto where = std::find_if(
+					std::begin( list_field_specs ), std::end( list_field_specs ),
+					[&name]( ListFieldSpec const& field ) { return name == field.name || name == field.short_name ; }
+				) ;
+				if( where == std::end( list_field_specs )) {
+					throw std::invalid_argument( "Unrecognised field \"" + name + "\" in -list-fields." ) ;
+				}
+				if( from_index && ( where->field == eAlternateIds || where->field == eAlternativeAlleles )) {
+					throw std::invalid_argument(
+						"Field \"" + std::string( where->name ) + "\" is not recorded in the index and cannot be used with -list-from-index."
+					) ;
+				}
+				result.push_back( *where ) ;
+				begin = end + 1 ;
+			}
+			return result ;
+		}
+
+		std::vector< ListFieldSpec > default_list_fields( bool from_index ) {
+			return parse_list_fields(
+				from_index
+				? "rsid,chromosome,position,number_of_alleles,first_allele,file_start_position,size_in_bytes"
+				: "alternate_ids,rsid,chromosome,position,number_of_alleles,first_allele,alternative_alleles",
+				from_index
+			) ;
+		}
+
+		ListFormat parse_list_format( std::string const& name ) {
+			if( name == "text" ) {
+				return eTextList ;
+			} else if( name == "columnar" ) {
+				return eColumnarList ;
+			}
+			throw std::invalid_argument( "Unrecognised -list-format \"" + name + "\", expected \"text\" or \"columnar\"." ) ;
+		}
+
+		std::string format_list_text_header( std::vector< ListFieldSpec > const& fields ) {
+			std::string result ;
+			for( std::size_t k = 0; k < fields.size(); ++k ) {
+				if( k > 0 ) {
+					result.push_back( '\t' ) ;
+				}
+				result.append( fields[k].name ) ;
+			}
+			result.push_back( '\n' ) ;
+			return result ;
+		}
+
+		std::string format_list_text( VariantBatch const& batch, std::vector< ListFieldSpec > const& fields ) {
+			std::string result ;
+			result.reserve( batch.size() * 16 * fields.size() ) ;
+			auto out = std::back_inserter( result ) ;
+			for( std::size_t i = 0; i < batch.size(); ++i ) {
+				for( std::size_t k = 0; k < fields.size(); ++k ) {
+					if( k > 0 ) {
+						result.push_back( '\t' ) ;
+					}
+					switch( fields[k].field ) {
+						case ePosition: fmt::format_to( out, "{}", batch.position[i] ) ; break ;
+						case eNumberOfAlleles: fmt::format_to( out, "{}", batch.number_of_alleles[i] ) ; break ;
+						case eFileStartPosition: fmt::format_to( out, "{}", batch.file_offset[i] ) ; break ;
+						case eSizeInBytes: fmt::format_to( out, "{}", batch.file_size[i] ) ; break ;
+						case eAlternateIds:
+						case eRsid: {
+							std::size_t const size = result.size() ;
+							append_string_field( batch, i, fields[k].field, &result ) ;
+							if( result.size() == size ) {
+								result.push_back( '.' ) ;
+							}
+							break ;
+						}
+						default:
+							append_string_field( batch, i, fields[k].field, &result ) ;
+					}
+				}
+				result.push_back( '\n' ) ;
+			}
+			return result ;
+		}
+
+		std::string format_list_columnar_header( std::vector< ListFieldSpec > const& fields ) {
+			std::string result = "BGXLIST1" ;
+			append_little_endian_integer( uint32_t( fields.size() ), &result ) ;
+			for( ListFieldSpec const& field: fields ) {
+				std::string const name = field.name ;
+				append_little_endian_integer( field.type, &result ) ;
+				append_little_endian_integer( uint32_t( name.size() ), &result ) ;
+				result.append( name ) ;
+			}
+			return result ;
+		}
+
+		std::string format_list_columnar( VariantBatch const& batch, std::vector< ListFieldSpec > const& fields ) {
+			std::size_t const N = batch.size() ;
+			std::string result, data ;
+			append_little_endian_integer( uint32_t( N ), &result ) ;
+			for( ListFieldSpec const& field: fields ) {
+				switch( field.field ) {
+					case ePosition:
+						for( std::size_t i = 0; i < N; ++i ) { append_little_endian_integer( batch.position[i], &result ) ; }
+						break ;
+					case eNumberOfAlleles:
+						for( std::size_t i = 0; i < N; ++i ) { append_little_endian_integer( batch.number_of_alleles[i], &result ) ; }
+						break ;
+					case eFileStartPosition:
+						for( std::size_t i = 0; i < N; ++i ) { append_little_endian_integer( batch.file_offset[i], &result ) ; }
+						break ;
+					case eSizeInBytes:
+						for( std::size_t i = 0; i < N; ++i ) { append_little_endian_integer( batch.file_size[i], &result ) ; }
+						break ;
+					default:
+						data.clear() ;
+						for( std::size_t i = 0; i < N; ++i ) {
+							std::size_t const size = data.size() ;
+							append_string_field( batch, i, field.field, &data ) ;
+							append_little_endian_integer( uint32_t( data.size() - size ), &result ) ;
+						}
+						result.append( data ) ;
+				}
+			}
+			return result ;
+		}
+
+		std::string format_list_columnar_end() {
+			std::string result ;
+			append_little_endian_integer( uint32_t( 0 ), &result ) ;
+			return result ;
+		}
+
+		std::size_t write_variant_list(
+			std::function< void( IndexQuery::BatchCallback ) > const& read_batches,
+			std::vector< ListFieldSpec > const& fields,
+			ListFormat format,
+			ThreadPool& pool,
+			std::ostream& out
+		) {
+			OrderedTaskQueue< std::string > queue(
+				pool, 2 * pool.number_of_threads(),
+				[&out]( std::string const& formatted ) { out.write( formatted.data(), formatted.size() ) ; }
+			) ;
+			std::size_t count = 0 ;
+			read_batches(
+				[&]( VariantBatch& batch ) {
+					count += batch.size() ;
+					queue.submit(
+						[batch = std::move( batch ), &fields, format]() {
+							return ( format == eColumnarList ) ? format_list_columnar( batch, fields ) : format_list_text( batch, fields ) ;
+						}
+					) ;
+				}
+			) ;
+			queue.finish() ;
+			return count ;
+		}
+	}
+}
@@ -0,0 +1,266 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <cassert>
+#include <fmt/format.h>
+#include "genfile/bgen.hpp"
+#include "genfile/vcf.hpp"
+
+namespace genfile {
+	namespace bgen {
+		namespace {
+			// Move to the next genotype in the order used by bgen for unphased data, i.e. colex order of
+			// allele counts.  counts[0] is determined by the other counts, which are incremented like digits
+			// with counts[1] the least significant.
+			void next_unphased_genotype( std::vector< uint32_t >* counts ) {
+				for( std::size_t j = 1; j < counts->size(); ++j ) {
+					if( (*counts)[0] > 0 ) {
+						++(*counts)[j] ;
+						--(*counts)[0] ;
+						return ;
+					}
+					(*counts)[0] += (*counts)[j] ;
+					(*counts)[j] = 0 ;
+				}
+			}
+
+			// Return the smallest value v for which v / max_value exceeds the threshhold,
+			// using the same floating-point comparison as VCFProbWriter.
+			uint64_t compute_min_called_value( uint64_t const max_value, double const threshhold ) {
+				uint64_t v = std::min( uint64_t( threshhold * max_value ), max_value ) ;
+				while( v > 0 && ( v / double( max_value )) > threshhold ) {
+					--v ;
+				}
+				while( v <= max_value && !(( v / double( max_value )) > threshhold )) {
+					++v ;
+				}
+				return v ;
+			}
+
+			void write_vcf_gt( uint64_t const x, uint64_t const y, VcfGTTable const& table, char* out ) {
+				uint64_t const max_value = uint64_t( 0xFFFFFFFFFFFFFFFF ) >> ( 64 - table.bits ) ;
+				uint64_t const t = table.min_called_value ;
+				if( table.phased ) {
+					out[0] = ( x >= t ) ? '0' : ( max_value - x >= t ) ? '1' : '.' ;
+					out[1] = '|' ;
+					out[2] = ( y >= t ) ? '0' : ( max_value - y >= t ) ? '1' : '.' ;
+				} else {
+					char const* gt = ( x >= t ) ? "0/0" : ( y >= t ) ? "0/1" : ( max_value - x - y >= t ) ? "1/1" : "./." ;
+					std::copy( gt, gt + 3, out ) ;
+				}
+			}
+		}
+
+		VCFProbWriter::VCFProbWriter( double threshhold, bool write_probabilities ):
+			m_threshhold( threshhold ),
+			m_write_probabilities( write_probabilities ),
+			m_selected( 0 ),
+			m_phased( false )
+		{}
+
+		void VCFProbWriter::set_selected_samples( std::vector< bool > const* selected ) {
+			m_selected = selected ;
+		}
+
+		void VCFProbWriter::initialise( std::size_t number_of_samples, std::size_t number_of_alleles ) {
+			assert( m_selected == 0 || m_selected->size() == number_of_samples ) ;
+			m_number_of_alleles = number_of_alleles ;
+			m_buffer.clear() ;
+			m_entries.assign( number_of_samples, std::make_pair( 0, 0 )) ;
+			m_phased = false ;
+		}
+
+		bool VCFProbWriter::set_sample( std::size_t i ) {
+			m_sample = i ;
+			return m_selected == 0 || (*m_selected)[i] ;
+		}
+
+		void VCFProbWriter::set_number_of_entries(
+			std::size_t ploidy,
+			std::size_t number_of_entries,
+			OrderType order_type,
+			ValueType value_type
+		) {
+			assert( value_type == eProbability ) ;
+			m_ploidy = ploidy ;
+			m_values.resize( number_of_entries ) ;
+			m_missing = false ;
+			m_phased = ( order_type == ePerPhasedHaplotypePerAllele ) ;
+			// Samples with no values (i.e. phased samples of ploidy zero) get no calls to set_value().
+			if( number_of_entries == 0 ) {
+				write_entry() ;
+			}
+		}
+
+		void VCFProbWriter::set_value( uint32_t entry_i, double value ) {
+			m_values[ entry_i ] = value ;
+			if( entry_i + 1 == m_values.size() ) {
+				write_entry() ;
+			}
+		}
+
+		void VCFProbWriter::set_value( uint32_t entry_i, MissingValue value ) {
+			m_missing = true ;
+			if( entry_i + 1 == m_values.size() ) {
+				write_entry() ;
+			}
+		}
+
+		std::string_view VCFProbWriter::entry( std::size_t i ) const {
+			return std::string_view( m_buffer ).substr( m_entries[i].first, m_entries[i].second - m_entries[i].first ) ;
+		}
+
+		void VCFProbWriter::write( std::ostream& out ) const {
+			for( std::size_t i = 0; i < m_entries.size(); ++i ) {
+				std::string_view const value = entry( i ) ;
+				out.put( '\t' ) ;
+				out.write( value.data(), value.size() ) ;
+			}
+			out.put( '\n' ) ;
+		}
+
+		void VCFProbWriter::write_entry() {
+			std::size_t const begin = m_buffer.size() ;
+			char const separator = m_phased ? '|' : '/' ;
+			if( m_ploidy == 0 ) {
+				m_buffer += '.' ;
+			} else if( m_missing ) {
+				for( std::size_t i = 0; i < m_ploidy; ++i ) {
+					m_buffer += ( i > 0 ) ? std::string( 1, separator ) + "." : "." ;
+				}
+			} else if( m_phased ) {
+				for( std::size_t i = 0; i < m_ploidy; ++i ) {
+					std::size_t j = 0 ;
+					while( j < m_number_of_alleles && !( m_values[ i * m_number_of_alleles + j ] > m_threshhold )) {
+						++j ;
+					}
+					m_buffer += ( i > 0 ) ? "|" : "" ;
+					m_buffer += ( j < m_number_of_alleles ) ? std::to_string( j ) : "." ;
+				}
+			} else {
+				write_unphased_call() ;
+			}
+			if( m_write_probabilities ) {
+				for( std::size_t i = 0; i < m_values.size(); ++i ) {
+					m_buffer += ( i > 0 ) ? ',' : ':' ;
+					if( m_missing ) {
+						m_buffer += '.' ;
+					} else {
+						fmt::format_to( std::back_inserter( m_buffer ), "{:.6g}", m_values[i] ) ;
+					}
+				}
+			}
+			m_entries[ m_sample ] = std::make_pair( begin, m_buffer.size() ) ;
+		}
+
+		void VCFProbWriter::write_unphased_call() {
+			std::size_t const called = std::find_if(
+				m_values.begin(), m_values.end(), [this]( double value ) { return value > m_threshhold ; }
+			) - m_values.begin() ;
+			if( called == m_values.size() ) {
+				for( std::size_t i = 0; i < m_ploidy; ++i ) {
+					m_buffer += ( i > 0 ) ? "/." : "." ;
+				}
+				return ;
+			}
+			m_counts.assign( m_number_of_alleles, 0 ) ;
+			m_counts[0] = m_ploidy ;
+			for( std::size_t i = 0; i < called; ++i ) {
+				next_unphased_genotype( &m_counts ) ;
+			}
+			bool first = true ;
+			for( std::size_t allele = 0; allele < m_number_of_alleles; ++allele ) {
+				for( uint32_t count = 0; count < m_counts[ allele ]; ++count ) {
+					m_buffer += first ? "" : "/" ;
+					m_buffer += std::to_string( allele ) ;
+					first = false ;
+				}
+			}
+		}
+
+		VcfGTTable compute_vcf_gt_table( int const bits, bool const phased, double const threshhold ) {
+			assert( bits > 0 && bits <= 32 ) ;
+			VcfGTTable result ;
+			result.bits = bits ;
+			result.phased = phased ;
+			result.min_called_value = compute_min_called_value( uint64_t( 0xFFFFFFFFFFFFFFFF ) >> ( 64 - bits ), threshhold ) ;
+			if( bits <= 8 ) {
+				uint32_t const max_value = ( 1 << bits ) - 1 ;
+				// Entries for invalid pairs (x+y > max_value for unphased data) are never used.
+				result.table.assign( 3 << ( 2 * bits ), '.' ) ;
+				for( uint32_t x = 0; x <= max_value; ++x ) {
+					for( uint32_t y = 0; y <= ( phased ? max_value : ( max_value - x )); ++y ) {
+						write_vcf_gt( x, y, result, &result.table[0] + 3 * (( y << bits ) | x ) ) ;
+					}
+				}
+			}
+			return result ;
+		}
+
+		void write_vcf_gt_fields(
+			v12::GenotypeDataBlock const& pack,
+			VcfGTTable const& table,
+			std::vector< char >* buffer
+		) {
+			assert( pack.bits == table.bits && pack.phased == table.phased ) ;
+			int const bits = pack.bits ;
+			// Values are read below without further checks, so the block must hold all of them.
+			if( uint64_t( pack.end - pack.buffer ) < ( 2 * uint64_t( bits ) * pack.numberOfSamples + 7 ) / 8 ) {
+				throw BGenError() ;
+			}
+			buffer->resize( pack.numberOfSamples * 4 + 1 ) ;
+			char* out = &(*buffer)[0] ;
+			char const* const missing = pack.phased ? "\t.|." : "\t./." ;
+			uint64_t const mask = uint64_t( 0xFFFFFFFFFFFFFFFF ) >> ( 64 - bits ) ;
+			// Values are read sequentially, little-endian, through a 64-bit accumulator.
+			byte_t const* p = pack.buffer ;
+			uint64_t data = 0 ;
+			int size = 0 ;
+			for( std::size_t i = 0; i < pack.numberOfSamples; ++i, out += 4 ) {
+				while( size < 2 * bits && size <= 56 ) {
+					data |= uint64_t( *p++ ) << size ;
+					size += 8 ;
+				}
+				uint64_t x, y ;
+				if( size >= 2 * bits ) {
+					x = data & mask ;
+					y = ( data >> bits ) & mask ;
+					data = ( 2 * bits == 64 ) ? 0 : ( data >> ( 2 * bits )) ;
+					size -= 2 * bits ;
+				} else {
+					// More than 28 bits per value; consume the two values separately.
+					x = data & mask ;
+					data >>= bits ;
+					size -= bits ;
+					while( size < bits ) {
+						data |= uint64_t( *p++ ) << size ;
+						size += 8 ;
+					}
+					y = data & mask ;
+					data >>= bits ;
+					size -= bits ;
+				}
+				if( pack.ploidy[i] & 0x80 ) {
+					std::copy( missing, missing + 4, out ) ;
+				} else if( bits <= 8 ) {
+					out[0] = '\t' ;
+					char const* gt = &table.table[0] + 3 * (( y << bits ) | x ) ;
+					std::copy( gt, gt + 3, out + 1 ) ;
+				} else {
+					out[0] = '\t' ;
+					write_vcf_gt( x, y, table, out + 1 ) ;
+				}
+			}
+			*out = '\n' ;
+		}
+	}
+}
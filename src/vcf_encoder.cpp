@@ -0,0 +1,355 @@
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <charconv>
+#include <stdexcept>
+#include <stdint.h>
+#include <fmt/format.h>
+#include "genfile/bgen.hpp"
+#include "genfile/Buffer.hpp"
+#include "genfile/vcf_encoder.hpp"
+
+namespace genfile {
+	namespace vcf {
+		namespace {
+			void split( Slice const& slice, char delimiter, std::vector< Slice >* result ) {
+				result->clear() ;
+				char const* p = slice.first ;
+				while( true ) {
+					char const* q = std::find( p, slice.second, delimiter ) ;
+					result->push_back( Slice( p, q )) ;
+					if( q == slice.second ) {
+						break ;
+					}
+					p = q + 1 ;
+				}
+			}
+
+			// Return the ith colon-separated subfield of the given sample column, or an empty slice if not present.
+			Slice get_subfield( Slice const& column, std::size_t i ) {
+				char const* p = column.first ;
+				for( std::size_t j = 0; j < i; ++j ) {
+					p = std::find( p, column.second, ':' ) ;
+					if( p == column.second ) {
+						return Slice( p, p ) ;
+					}
+					++p ;
+				}
+				return Slice( p, std::find( p, column.second, ':' )) ;
+			}
+
+			bool is_missing( Slice const& slice ) {
+				return slice.first == slice.second || ( slice.second - slice.first == 1 && *slice.first == '.' ) ;
+			}
+
+			std::size_t number_of_genotypes( uint32_t ploidy, std::size_t number_of_alleles ) {
+				return bgen::impl::number_of_unphased_genotypes( ploidy, uint32_t( number_of_alleles )) ;
+			}
+		}
+
+		double parse_double( Slice const& slice ) {
+			double result = 0 ;
+			std::from_chars_result r = std::from_chars( slice.first, slice.second, result ) ;
+			if( r.ec != std::errc() || r.ptr != slice.second ) {
+				throw std::invalid_argument( "could not parse \"" + to_string( slice ) + "\" as a number" ) ;
+			}
+			// from_chars() accepts "nan" and "inf", which would otherwise be encoded as missing or invalid data.
+			if( !std::isfinite( result )) {
+				throw std::invalid_argument( "value \"" + to_string( slice ) + "\" is not a finite number" ) ;
+			}
+			return result ;
+		}
+
+		bool parse_GT( Slice const& slice, std::vector< uint32_t >* calls, bool* phased ) {
+			calls->clear() ;
+			*phased = true ;
+			bool missing = false ;
+			char const* p = slice.first ;
+			while( p < slice.second ) {
+				char const* q = p ;
+				while( q < slice.second && *q != '/' && *q != '|' ) {
+					++q ;
+				}
+				if( q - p == 1 && *p == '.' ) {
+					missing = true ;
+					calls->push_back( 0 ) ;
+				} else {
+					uint32_t allele = 0 ;
+					std::from_chars_result r = std::from_chars( p, q, allele ) ;
+					if( r.ec != std::errc() || r.ptr != q ) {
+						throw std::invalid_argument( "could not parse genotype call \"" + to_string( slice ) + "\"" ) ;
+					}
+					calls->push_back( allele ) ;
+				}
+				if( q < slice.second && *q == '/' ) {
+					*phased = false ;
+				}
+				p = q + 1 ;
+			}
+			return !missing && !calls->empty() ;
+		}
+
+		std::size_t genotype_index( std::vector< uint32_t > const& sorted_calls ) {
+			std::size_t result = 0 ;
+			for( std::size_t i = 0; i < sorted_calls.size(); ++i ) {
+				result += bgen::impl::n_choose_k< std::size_t >( sorted_calls[i] + i, i + 1 ) ;
+			}
+			return result ;
+		}
+
+		uint32_t ploidy_from_number_of_genotypes( std::size_t n, std::size_t number_of_alleles ) {
+			for( uint32_t ploidy = 1; ploidy < 64; ++ploidy ) {
+				std::size_t const count = number_of_genotypes( ploidy, number_of_alleles ) ;
+				if( count == n ) {
+					return ploidy ;
+				} else if( count > n ) {
+					break ;
+				}
+			}
+			return 0 ;
+		}
+
+		double const VcfEncoder::max_rounding_error_per_probability = 0.005 ;
+
+		VcfEncoder::VcfEncoder( bgen::Context const& context, std::string const& field, int number_of_bits ):
+			m_context( context ),
+			m_field( field ),
+			m_field_type( field == "GP" ? eGP : ( field == "DS" ? eDS : eGT )),
+			m_number_of_bits( number_of_bits )
+		{
+			if( field != "GP" && field != "DS" && field != "GT" ) {
+				throw std::invalid_argument( "field=\"" + field + "\"" ) ;
+			}
+		}
+
+		EncodedChunk VcfEncoder::encode( std::string const& text, std::size_t first_line_number ) const {
+			EncodedChunk result ;
+			Workspace workspace ;
+			char const* p = text.data() ;
+			char const* const end = text.data() + text.size() ;
+			for( std::size_t line_number = first_line_number; p < end; ++line_number ) {
+				char const* line_end = std::find( p, end, '\n' ) ;
+				char const* next = line_end + ( line_end < end ? 1 : 0 ) ;
+				if( line_end > p && *(line_end-1) == '\r' ) {
+					--line_end ;
+				}
+				if( line_end > p ) {
+					try {
+						result.variants.push_back( EncodedVariant() ) ;
+						if( !encode_record( Slice( p, line_end ), &workspace, &result.variants.back() )) {
+							result.variants.pop_back() ;
+							++result.number_skipped ;
+						}
+					} catch( std::invalid_argument const& e ) {
+						throw std::invalid_argument( fmt::format( "line {}: {}", line_number, e.what() )) ;
+					} catch( bgen::BGenError const& e ) {
+						throw std::invalid_argument( fmt::format( "line {}: invalid genotype data", line_number )) ;
+					}
+				}
+				p = next ;
+			}
+			return result ;
+		}
+
+		bool VcfEncoder::encode_record( Slice const& line, Workspace* workspace, EncodedVariant* result ) const {
+			std::vector< Slice >& columns = workspace->columns ;
+			split( line, '\t', &columns ) ;
+			std::size_t const N = m_context.number_of_samples ;
+			if( columns.size() != N + 9 && !( N == 0 && columns.size() == 8 )) {
+				throw std::invalid_argument( fmt::format( "expected {} columns, found {}", N + 9, columns.size() )) ;
+			}
+			if( is_missing( columns[4] )) {
+				// No alternate allele; bgen variants must have at least two alleles.
+				return false ;
+			}
+			result->chromosome = to_string( columns[0] ) ;
+			{
+				std::from_chars_result r = std::from_chars( columns[1].first, columns[1].second, result->position ) ;
+				if( r.ec != std::errc() || r.ptr != columns[1].second ) {
+					throw std::invalid_argument( "could not parse position \"" + to_string( columns[1] ) + "\"" ) ;
+				}
+			}
+			result->id = to_string( columns[2] ) ;
+			if( result->id == "." ) {
+				result->id.clear() ;
+			}
+			result->alleles.clear() ;
+			result->alleles.push_back( to_string( columns[3] )) ;
+			{
+				char const* p = columns[4].first ;
+				while( true ) {
+					char const* q = std::find( p, columns[4].second, ',' ) ;
+					result->alleles.push_back( std::string( p, q )) ;
+					if( q == columns[4].second ) {
+						break ;
+					}
+					p = q + 1 ;
+				}
+			}
+			std::size_t const K = result->alleles.size() ;
+			if( m_field_type == eDS && K != 2 ) {
+				// DS holds one value per alternate allele, which does not determine genotype probabilities.
+				return false ;
+			}
+			if( K > std::numeric_limits< uint16_t >::max() ) {
+				throw std::invalid_argument( "too many alleles" ) ;
+			}
+
+			// Locate the field of interest, and GT (to determine ploidy and phasing).
+			std::size_t field_index = std::numeric_limits< std::size_t >::max() ;
+			std::size_t GT_index = std::numeric_limits< std::size_t >::max() ;
+			if( N > 0 ) {
+				std::vector< Slice > format ;
+				split( columns[8], ':', &format ) ;
+				for( std::size_t i = 0; i < format.size(); ++i ) {
+					if( to_string( format[i] ) == m_field ) {
+						field_index = i ;
+					}
+					if( to_string( format[i] ) == "GT" ) {
+						GT_index = i ;
+					}
+				}
+				if( field_index == std::numeric_limits< std::size_t >::max() ) {
+					throw std::invalid_argument( "FORMAT field " + m_field + " is not present" ) ;
+				}
+			}
+
+			// First pass: find values, ploidy, and whether all calls are phased.
+			std::vector< SampleData >& samples = workspace->samples ;
+			samples.resize( N ) ;
+			bool phased = ( m_field_type == eGT ) ;
+			uint32_t max_ploidy = 0 ;
+			for( std::size_t i = 0; i < N; ++i ) {
+				Slice const& column = columns[i+9] ;
+				SampleData& sample = samples[i] ;
+				sample.value = get_subfield( column, field_index ) ;
+				sample.missing = is_missing( sample.value ) ;
+				sample.ploidy = 2 ;
+				if( GT_index != std::numeric_limits< std::size_t >::max() ) {
+					Slice const GT = get_subfield( column, GT_index ) ;
+					if( GT.first != GT.second ) {
+						bool sample_phased = false ;
+						bool const called = parse_GT( GT, &workspace->calls, &sample_phased ) ;
+						sample.ploidy = workspace->calls.size() ;
+						if( m_field_type == eGT ) {
+							sample.missing = !called ;
+							if( called && sample.ploidy > 1 ) {
+								phased = phased && sample_phased ;
+							}
+						}
+					}
+				}
+				if( m_field_type == eGP && !sample.missing ) {
+					// The number of GP values determines the ploidy.
+					std::size_t const n = std::count( sample.value.first, sample.value.second, ',' ) + 1 ;
+					sample.ploidy = ploidy_from_number_of_genotypes( n, K ) ;
+					if( sample.ploidy == 0 ) {
+						throw std::invalid_argument( fmt::format( "sample {} has {} GP values, which is not valid for {} alleles", i+1, n, K )) ;
+					}
+				}
+				max_ploidy = std::max( max_ploidy, sample.ploidy ) ;
+			}
+			if( max_ploidy > 63 ) {
+				throw std::invalid_argument( "ploidy is too large" ) ;
+			}
+			if( !phased && number_of_genotypes( max_ploidy, K ) > 100 ) {
+				throw std::invalid_argument( "too many genotypes for unphased data" ) ;
+			}
+
+			// Second pass: encode.
+			bgen::BasicGenotypeDataBlockWriter< Buffer > writer(
+				&workspace->buffer1, &workspace->buffer2,
+				m_context, m_number_of_bits
+			) ;
+			writer.initialise( N, K, std::max( max_ploidy, uint32_t( 1 ) )) ;
+			std::vector< double >& values = workspace->values ;
+			std::vector< Slice > parts ;
+			for( std::size_t i = 0; i < N; ++i ) {
+				SampleData const& sample = samples[i] ;
+				writer.set_sample( i ) ;
+				uint32_t const ploidy = sample.ploidy ;
+				OrderType const order_type = phased ? ePerPhasedHaplotypePerAllele : ePerUnorderedGenotype ;
+				std::size_t const number_of_entries = phased ? ( ploidy * K ) : number_of_genotypes( ploidy, K ) ;
+				values.assign( number_of_entries, 0.0 ) ;
+				bool missing = sample.missing || ploidy == 0 ;
+				if( !missing ) {
+					switch( m_field_type ) {
+						case eGP: {
+							split( sample.value, ',', &parts ) ;
+							if( parts.size() != number_of_entries ) {
+								throw std::invalid_argument(
+									fmt::format( "sample {} has {} GP values, expected {}", i+1, parts.size(), number_of_entries )
+								) ;
+							}
+							double sum = 0.0 ;
+							for( std::size_t j = 0; j < parts.size(); ++j ) {
+								values[j] = parse_double( parts[j] ) ;
+								if( values[j] < 0.0 ) {
+									throw std::invalid_argument( fmt::format( "sample {} has a negative GP value", i+1 )) ;
+								}
+								sum += values[j] ;
+							}
+							if( sum == 0.0 ) {
+								missing = true ;
+							} else if( std::abs( sum - 1.0 ) > max_rounding_error_per_probability * parts.size() ) {
+								throw std::invalid_argument(
+									fmt::format( "sample {} has GP values summing to {}, which is not 1 up to rounding error", i+1, sum )
+								) ;
+							} else {
+								for( std::size_t j = 0; j < parts.size(); ++j ) {
+									values[j] /= sum ;
+								}
+							}
+							break ;
+						}
+						case eDS: {
+							// Spread the dosage across the two nearest genotypes.
+							double const dosage = std::min( std::max( parse_double( sample.value ), 0.0 ), double( ploidy )) ;
+							std::size_t const g = std::min( std::size_t( dosage ), std::size_t( ploidy - 1 )) ;
+							values[g+1] = dosage - g ;
+							values[g] = 1.0 - values[g+1] ;
+							break ;
+						}
+						case eGT: {
+							bool sample_phased ;
+							parse_GT( sample.value, &workspace->calls, &sample_phased ) ;
+							std::vector< uint32_t >& calls = workspace->calls ;
+							for( std::size_t j = 0; j < calls.size(); ++j ) {
+								if( calls[j] >= K ) {
+									throw std::invalid_argument( fmt::format( "sample {} has allele {} but there are only {} alleles", i+1, calls[j], K )) ;
+								}
+							}
+							if( phased ) {
+								for( std::size_t j = 0; j < calls.size(); ++j ) {
+									values[j*K + calls[j]] = 1.0 ;
+								}
+							} else {
+								std::sort( calls.begin(), calls.end() ) ;
+								values[ genotype_index( calls ) ] = 1.0 ;
+							}
+							break ;
+						}
+					}
+				}
+				writer.set_number_of_entries( ploidy, number_of_entries, order_type, eProbability ) ;
+				for( std::size_t j = 0; j < number_of_entries; ++j ) {
+					if( missing ) {
+						writer.set_value( j, MissingValue() ) ;
+					} else {
+						writer.set_value( j, values[j] ) ;
+					}
+				}
+			}
+			writer.finalise() ;
+			result->data.assign( writer.repr().first, writer.repr().second ) ;
+			return true ;
+		}
+	}
+}
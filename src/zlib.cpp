@@ -9,10 +9,11 @@
 #include "genfile/zlib.hpp"
 
 namespace genfile {
+	template< typename Allocator >
 	void zlib_compress(
 		uint8_t const* buffer,
 		uint8_t const* const end,
-		std::vector< uint8_t >* dest,
+		std::vector< uint8_t, Allocator >* dest,
 		std::size_t const offset,
 		int const compressionLevel
 	) {
@@ -32,10 +33,11 @@ namespace genfile {
 		dest->resize( compressed_size + offset ) ;
 	}
 
+	template< typename Allocator >
 	void zstd_compress(
 		uint8_t const* buffer,
 		uint8_t const* const end,
-		std::vector< uint8_t >* dest,
+		std::vector< uint8_t, Allocator >* dest,
 		std::size_t const offset,
 		int const compressionLevel
 	) {
@@ -54,4 +56,11 @@ namespace genfile {
 		assert( !ZSTD_isError( compressed_size )) ;
 		dest->resize( compressed_size + offset ) ;
 	}
+
+	template void zlib_compress( byte_t const*, byte_t const* const, std::vector< byte_t >*, std::size_t const, int const ) ;
+	template void zlib_compress( byte_t const*, byte_t const* const, Buffer*, std::size_t const, int const ) ;
+	template void zlib_compress( byte_t const*, byte_t const* const, HugePageBuffer*, std::size_t const, int const ) ;
+	template void zstd_compress( byte_t const*, byte_t const* const, std::vector< byte_t >*, std::size_t const, int const ) ;
+	template void zstd_compress( byte_t const*, byte_t const* const, Buffer*, std::size_t const, int const ) ;
+	template void zstd_compress( byte_t const*, byte_t const* const, HugePageBuffer*, std::size_t const, int const ) ;
 }
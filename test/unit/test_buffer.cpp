@@ -0,0 +1,80 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <sstream>
+#include "stdint.h"
+#include "catch2/catch.hpp"
+#include "genfile/bgen.hpp"
+#include "genfile/Buffer.hpp"
+#include "genfile/types.hpp"
+#include "test_files.hpp"
+
+TEST_CASE( "Test that aligned buffers and the buffer pool can be used to encode and decode data", "[bgen][buffer]" ) {
+	genfile::bgen::Context context ;
+	context.number_of_samples = 1000 ;
+	std::vector< double > dosages, expected_dosages ;
+	DosageSetter setter( &dosages ), expected_setter( &expected_dosages ) ;
+
+	for( uint32_t compression: { genfile::bgen::e_NoCompression, genfile::bgen::e_ZlibCompression, genfile::bgen::e_ZstdCompression } ) {
+		context.flags = genfile::bgen::e_Layout2 | compression ;
+		genfile::BufferPool pool( 2 ) ;
+		for( std::size_t variant = 0; variant < 10; ++variant ) {
+			// Encode into aligned buffers, and check the result matches encoding into vectors.
+			std::vector< genfile::byte_t > const expected = encode_variant( context, variant ) ;
+			genfile::Buffer buffer1 = pool.acquire(), buffer2 = pool.acquire() ;
+			REQUIRE( buffer1.empty() ) ;
+			genfile::bgen::BasicGenotypeDataBlockWriter< genfile::Buffer > writer( &buffer1, &buffer2, context, 8 ) ;
+			writer.initialise( context.number_of_samples, 2, 2 ) ;
+			for( std::size_t i = 0; i < context.number_of_samples; ++i ) {
+				writer.set_sample( i ) ;
+				writer.set_number_of_entries( 2, 3, genfile::ePerUnorderedGenotype, genfile::eProbability ) ;
+				for( std::size_t g = 0; g < 3; ++g ) {
+					if( ( i + variant ) % 5 == 4 ) {
+						writer.set_value( g, genfile::MissingValue() ) ;
+					} else {
+						writer.set_value( g, ( ( i + variant ) % 3 == g ) ? 1.0 : 0.0 ) ;
+					}
+				}
+			}
+			writer.finalise() ;
+			REQUIRE( std::equal( writer.repr().first, writer.repr().second, expected.begin(), expected.end() )) ;
+
+			// Read the block back, reusing the same buffers, and compare with decoding using vectors.
+			std::istringstream stream( std::string( writer.repr().first, writer.repr().second )) ;
+			genfile::bgen::read_and_parse_genotype_data_block( stream, context, setter, &buffer1, &buffer2 ) ;
+			REQUIRE( reinterpret_cast< std::uintptr_t >( buffer2.data() ) % 64 == 0 ) ;
+
+			std::vector< genfile::byte_t > raw, uncompressed ;
+			std::istringstream expected_stream( std::string( expected.begin(), expected.end() )) ;
+			genfile::bgen::read_genotype_data_block( expected_stream, context, &raw ) ;
+			genfile::bgen::uncompress_probability_data( context, raw, &uncompressed ) ;
+			genfile::bgen::parse_probability_data( &uncompressed[0], &uncompressed[0] + uncompressed.size(), context, expected_setter ) ;
+			REQUIRE( dosages == expected_dosages ) ;
+
+			pool.release( std::move( buffer1 )) ;
+			pool.release( std::move( buffer2 )) ;
+			REQUIRE( pool.size() == 2 ) ;
+		}
+		// Released buffers keep their storage, and the pool holds at most the given number.
+		genfile::Buffer buffer = pool.acquire() ;
+		REQUIRE( buffer.empty() ) ;
+		REQUIRE( buffer.capacity() > 0 ) ;
+		pool.release( genfile::Buffer( 100 )) ;
+		pool.release( genfile::Buffer( 100 )) ;
+		REQUIRE( pool.size() == 2 ) ;
+	}
+
+	// Large buffers may be backed by huge pages, and are aligned to them.
+	genfile::HugePageBuffer large( 3 * genfile::impl::huge_page_size, 7 ) ;
+	REQUIRE( reinterpret_cast< std::uintptr_t >( large.data() ) % genfile::impl::huge_page_size == 0 ) ;
+	genfile::HugePageBuffer compressed, uncompressed( large.size() ) ;
+	genfile::zstd_compress( &large[0], &large[0] + large.size(), &compressed, 0, 1 ) ;
+	genfile::zstd_uncompress( &compressed[0], &compressed[0] + compressed.size(), &uncompressed ) ;
+	REQUIRE( uncompressed == large ) ;
+}
@@ -0,0 +1,112 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include "stdint.h"
+#include "catch2/catch.hpp"
+#include "genfile/bgen_c.h"
+#include "test_files.hpp"
+
+TEST_CASE( "Test that the C API selects variants and decodes them into caller buffers", "[bgen][capi]" ) {
+	std::string const filename = temp_filename( "genfile_test_capi.bgen" ) ;
+	std::size_t const number_of_samples = 7 ;
+	std::vector< std::string > const AG = { "A", "G" } ;
+	write_test_file(
+		filename, number_of_samples,
+		{ { "01", 1000, AG, 0 }, { "01", 1002, AG, 1 }, { "01", 1004, AG, 2 }, { "01", 1006, AG, 3 }, { "02", 1000, AG, 4 } }
+	) ;
+
+	bgen_file* file = 0 ;
+	REQUIRE( bgen_open( filename.c_str(), ( filename + ".bgi" ).c_str(), &file ) == BGEN_OK ) ;
+	REQUIRE( bgen_number_of_samples( file ) == number_of_samples ) ;
+	REQUIRE( bgen_number_of_variants( file ) == 5 ) ;
+	REQUIRE( bgen_layout( file ) == 2 ) ;
+	REQUIRE( bgen_sample_id( file, number_of_samples ) == 0 ) ;
+	REQUIRE( bgen_number_of_selected_variants( file ) == 0 ) ;
+
+	REQUIRE( bgen_select_range( file, "01", 1002, 1006 ) == BGEN_OK ) ;
+	REQUIRE( bgen_number_of_selected_variants( file ) == 3 ) ;
+	char const* data = 0 ;
+	std::size_t size = 0 ;
+	for( std::size_t v = 0; v < 3; ++v ) {
+		REQUIRE( bgen_selected_positions( file )[v] == 1002 + 2*v ) ;
+		REQUIRE( bgen_selected_numbers_of_alleles( file )[v] == 2 ) ;
+		REQUIRE( bgen_selected_string( file, v, BGEN_FIELD_RSID, &data, &size ) == BGEN_OK ) ;
+		REQUIRE( std::string( data, size ) == "rs" + std::to_string( v + 1 )) ;
+		REQUIRE( bgen_selected_allele( file, v, 1, &data, &size ) == BGEN_OK ) ;
+		REQUIRE( std::string( data, size ) == "G" ) ;
+	}
+
+	// Decode a subset of samples, in a different order, using several threads.
+	std::vector< std::size_t > const samples = { 4, 1, 6 } ;
+	REQUIRE( bgen_set_threads( file, 2 ) == BGEN_OK ) ;
+	REQUIRE( bgen_select_samples( file, &samples[0], samples.size() ) == BGEN_OK ) ;
+	REQUIRE( bgen_number_of_selected_samples( file ) == 3 ) ;
+	std::vector< float > dosages( 2 * samples.size() ) ;
+	REQUIRE( bgen_read_dosages_float( file, 1, 2, &dosages[0] ) == BGEN_OK ) ;
+	for( std::size_t v = 0; v < 2; ++v ) {
+		for( std::size_t j = 0; j < samples.size(); ++j ) {
+			double const expected = expected_dosage( samples[j], v + 2 ) ;
+			if( expected < 0 ) {
+				REQUIRE( std::isnan( dosages[ v * samples.size() + j ] )) ;
+			} else {
+				REQUIRE( dosages[ v * samples.size() + j ] == Approx( expected )) ;
+			}
+		}
+	}
+
+	std::vector< double > probabilities( 3 * samples.size() * 4 ) ;
+	std::vector< uint8_t > ploidy( 3 * samples.size() ) ;
+	std::vector< uint8_t > phased( 3, 2 ) ;
+	REQUIRE( bgen_read_probabilities( file, 0, 3, 4, &probabilities[0], &ploidy[0], &phased[0] ) == BGEN_OK ) ;
+	for( std::size_t v = 0; v < 3; ++v ) {
+		REQUIRE( phased[v] == 0 ) ;
+		for( std::size_t j = 0; j < samples.size(); ++j ) {
+			double const* values = &probabilities[ ( v * samples.size() + j ) * 4 ] ;
+			double const expected = expected_dosage( samples[j], v + 1 ) ;
+			REQUIRE( ploidy[ v * samples.size() + j ] == 2 ) ;
+			REQUIRE( std::isnan( values[3] )) ;
+			for( std::size_t g = 0; g < 3; ++g ) {
+				if( expected < 0 ) {
+					REQUIRE( std::isnan( values[g] )) ;
+				} else {
+					REQUIRE( values[g] == Approx( ( expected == g ) ? 1.0 : 0.0 )) ;
+				}
+			}
+		}
+	}
+	REQUIRE( bgen_read_probabilities( file, 0, 3, 2, &probabilities[0], 0, 0 ) == BGEN_ERROR_BUFFER_TOO_SMALL ) ;
+	REQUIRE( bgen_read_dosages_float( file, 2, 2, &dosages[0] ) == BGEN_ERROR_INVALID_ARGUMENT ) ;
+	REQUIRE( std::string( bgen_error_message() ).size() > 0 ) ;
+
+	// All variants and samples, in file order.
+	REQUIRE( bgen_select_samples( file, 0, 0 ) == BGEN_OK ) ;
+	REQUIRE( bgen_select_all( file ) == BGEN_OK ) ;
+	REQUIRE( bgen_number_of_selected_variants( file ) == 5 ) ;
+	std::vector< double > all_dosages( 5 * number_of_samples ) ;
+	REQUIRE( bgen_read_dosages( file, 0, 5, &all_dosages[0] ) == BGEN_OK ) ;
+	for( std::size_t v = 0; v < 5; ++v ) {
+		for( std::size_t i = 0; i < number_of_samples; ++i ) {
+			double const expected = expected_dosage( i, v ) ;
+			REQUIRE( ( expected < 0 ? std::isnan( all_dosages[ v * number_of_samples + i ] ) : all_dosages[ v * number_of_samples + i ] == Approx( expected )) ) ;
+		}
+	}
+	bgen_close( file ) ;
+
+	// Without an index, only bgen_select_all() can be used.
+	REQUIRE( bgen_open( filename.c_str(), 0, &file ) == BGEN_OK ) ;
+	REQUIRE( bgen_select_range( file, "01", 1002, 1006 ) == BGEN_ERROR_INDEX ) ;
+	REQUIRE( bgen_select_all( file ) == BGEN_OK ) ;
+	REQUIRE( bgen_number_of_selected_variants( file ) == 5 ) ;
+	REQUIRE( bgen_selected_string( file, 4, BGEN_FIELD_CHROMOSOME, &data, &size ) == BGEN_OK ) ;
+	REQUIRE( std::string( data, size ) == "02" ) ;
+	bgen_close( file ) ;
+
+	REQUIRE( bgen_open( ( filename + ".missing" ).c_str(), 0, &file ) == BGEN_ERROR_IO ) ;
+	remove_test_file( filename ) ;
+}
@@ -0,0 +1,108 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <optional>
+#include "stdint.h"
+#include "catch2/catch.hpp"
+#include "genfile/bgen.hpp"
+#include "genfile/check.hpp"
+#include "genfile/ForwardOnlyStreamBuf.hpp"
+#include "test_files.hpp"
+
+namespace {
+	// Check the header and variants of a file with the given contents as check-bgen does, and return the first
+	// problem found, if any.  Variants successfully read are stored in the given vector.  If streaming is true,
+	// the contents are read forwards through a small buffer, without their size, as for a pipe.
+	std::optional< genfile::bgen::FileProblem > check_file( std::string const& contents, std::vector< genfile::bgen::CheckedVariant >* variants, bool streaming = false ) {
+		std::istringstream source( contents ) ;
+		genfile::ForwardOnlyStreamBuf::UniquePtr streambuf = genfile::ForwardOnlyStreamBuf::create( source, 7 ) ;
+		std::istream stream( streaming ? static_cast< std::streambuf* >( streambuf.get() ) : source.rdbuf() ) ;
+		int64_t const file_size = streaming ? genfile::bgen::unknown_file_size : int64_t( contents.size() ) ;
+		genfile::bgen::Context context ;
+		uint32_t offset = 0 ;
+		std::optional< genfile::bgen::FileProblem > problem = genfile::bgen::check_header( stream, file_size, &context, &offset ) ;
+		if( problem ) {
+			return problem ;
+		}
+		if( streaming ) {
+			stream.ignore( int64_t( offset ) + 4 - int64_t( stream.tellg() )) ;
+		} else {
+			stream.seekg( offset + 4 ) ;
+		}
+		for( std::size_t i = 0; i < context.number_of_variants; ++i ) {
+			genfile::bgen::CheckedVariant variant ;
+			variant.index = i ;
+			problem = genfile::bgen::read_checked_variant( stream, context, file_size, &variant ) ;
+			if( problem ) {
+				return problem ;
+			}
+			variants->push_back( std::move( variant )) ;
+		}
+		return problem ;
+	}
+}
+
+TEST_CASE( "Test that truncated files are reported as problems by the checks", "[bgen][check]" ) {
+	std::string const filename = temp_filename( "genfile_test_check.bgen" ) ;
+	for( uint32_t flags: { genfile::bgen::e_Layout2 | genfile::bgen::e_ZlibCompression, genfile::bgen::e_Layout2 | genfile::bgen::e_NoCompression, genfile::bgen::e_Layout1 | genfile::bgen::e_ZlibCompression } ) {
+		TestFileOptions options ;
+		options.flags = flags ;
+		options.sample_ids = { "a", "b", "c", "d", "e" } ;
+		options.write_index = false ;
+		write_test_file( filename, 5, consecutive_variants( 4 ), options ) ;
+		std::string contents ;
+		{
+			std::ifstream file( filename.c_str(), std::ios::binary ) ;
+			contents.assign( std::istreambuf_iterator< char >( file ), std::istreambuf_iterator< char >() ) ;
+		}
+
+		std::vector< genfile::bgen::CheckedVariant > variants ;
+		REQUIRE( !check_file( contents, &variants )) ;
+		REQUIRE( variants.size() == 4 ) ;
+		REQUIRE( variants.back().offset + variants.back().size == int64_t( contents.size() )) ;
+
+		// Streamed files give the same variants.
+		std::vector< genfile::bgen::CheckedVariant > streamed_variants ;
+		REQUIRE( !check_file( contents, &streamed_variants, true )) ;
+		REQUIRE( streamed_variants.size() == variants.size() ) ;
+		for( std::size_t i = 0; i < variants.size(); ++i ) {
+			REQUIRE( streamed_variants[i].offset == variants[i].offset ) ;
+			REQUIRE( streamed_variants[i].size == variants[i].size ) ;
+			REQUIRE( streamed_variants[i].data == variants[i].data ) ;
+		}
+
+		// Every cut point gives a problem rather than an exception.
+		for( std::size_t cut = 0; cut < contents.size(); ++cut ) {
+			std::vector< genfile::bgen::CheckedVariant > truncated_variants ;
+			std::optional< genfile::bgen::FileProblem > problem ;
+			REQUIRE_NOTHROW( problem = check_file( contents.substr( 0, cut ), &truncated_variants )) ;
+			REQUIRE( problem ) ;
+			truncated_variants.clear() ;
+			REQUIRE_NOTHROW( problem = check_file( contents.substr( 0, cut ), &truncated_variants, true )) ;
+			REQUIRE( problem ) ;
+		}
+
+		// Cuts through the length field that precedes each genotype data block are reported as truncating the block.
+		for( genfile::bgen::CheckedVariant const& variant: variants ) {
+			int64_t const length_field = variant.offset + variant.size - int64_t( variant.data.size() ) - 4 ;
+			for( int64_t cut = length_field; cut < length_field + 4; ++cut ) {
+				for( bool const streaming: { false, true } ) {
+					std::vector< genfile::bgen::CheckedVariant > truncated_variants ;
+					std::optional< genfile::bgen::FileProblem > const problem = check_file( contents.substr( 0, cut ), &truncated_variants, streaming ) ;
+					REQUIRE( problem ) ;
+					REQUIRE( problem->where == genfile::bgen::describe( variant )) ;
+					REQUIRE( problem->message == "genotype data block extends beyond the end of the file" ) ;
+					REQUIRE( truncated_variants.size() == variant.index ) ;
+				}
+			}
+		}
+	}
+	remove_test_file( filename ) ;
+}
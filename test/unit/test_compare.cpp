@@ -0,0 +1,348 @@
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include "stdint.h"
+#include "catch2/catch.hpp"
+#include "genfile/bgen.hpp"
+#include "genfile/View.hpp"
+#include "genfile/ViewMerger.hpp"
+#include "genfile/compare.hpp"
+#include "genfile/types.hpp"
+#include "test_files.hpp"
+
+namespace {
+	typedef std::vector< std::vector< double > > Probabilities ;
+
+	genfile::bgen::Context make_context( std::size_t number_of_samples, uint32_t flags ) {
+		genfile::bgen::Context context ;
+		context.number_of_samples = number_of_samples ;
+		context.flags = flags ;
+		return context ;
+	}
+
+	// Encode unphased diploid biallelic data with the given probabilities for each sample (empty if missing),
+	// as a genotype data block without its length field, as in a VariantPair.
+	std::vector< genfile::byte_t > encode_block(
+		genfile::bgen::Context const& context,
+		Probabilities const& probabilities,
+		int number_of_bits = 16
+	) {
+		std::vector< genfile::byte_t > buffer1, buffer2 ;
+		genfile::bgen::GenotypeDataBlockWriter writer( &buffer1, &buffer2, context, number_of_bits ) ;
+		writer.initialise( context.number_of_samples, 2, 2 ) ;
+		for( std::size_t i = 0; i < probabilities.size(); ++i ) {
+			writer.set_sample( i ) ;
+			writer.set_number_of_entries( 2, 3, genfile::ePerUnorderedGenotype, genfile::eProbability ) ;
+			for( std::size_t g = 0; g < 3; ++g ) {
+				if( probabilities[i].empty() ) {
+					writer.set_value( g, genfile::MissingValue() ) ;
+				} else {
+					writer.set_value( g, probabilities[i][g] ) ;
+				}
+			}
+		}
+		writer.finalise() ;
+		return std::vector< genfile::byte_t >( writer.repr().first + 4, writer.repr().second ) ;
+	}
+
+	genfile::bgen::VariantPair variant_pair( std::vector< genfile::byte_t > const& data1, std::vector< genfile::byte_t > const& data2 ) {
+		genfile::bgen::VariantPair result ;
+		result.rsid = "rs1" ;
+		result.chromosome = "01" ;
+		result.position = 1000 ;
+		result.alleles = { "A", "G" } ;
+		result.data[0] = data1 ;
+		result.data[1] = data2 ;
+		return result ;
+	}
+
+	Probabilities const genotypes = {
+		{ 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 }, { 0.9, 0.1, 0 }, { 0, 0.2, 0.8 }, { 1, 0, 0 }
+	} ;
+
+	uint32_t const zlib_flags = genfile::bgen::e_Layout2 | genfile::bgen::e_ZlibCompression ;
+	uint32_t const zstd_flags = genfile::bgen::e_Layout2 | genfile::bgen::e_ZstdCompression ;
+
+	// Pair the variants of two files and compare them, returning the results in order.
+	std::vector< genfile::bgen::VariantResult > compare_files(
+		std::string const& filename1,
+		std::string const& filename2,
+		std::size_t chunk_size,
+		genfile::bgen::PairingSummary* summary,
+		std::vector< std::vector< genfile::bgen::VariantPair > >* chunks
+	) {
+		genfile::bgen::ViewMerger merger ;
+		merger.add_source( genfile::bgen::View::create( filename1 )) ;
+		merger.add_source( genfile::bgen::View::create( filename2 )) ;
+		genfile::bgen::Comparer const comparer( merger.source(0).context(), merger.source(1).context() ) ;
+		std::vector< genfile::bgen::VariantResult > result ;
+		*summary = genfile::bgen::pair_variants(
+			merger, chunk_size,
+			[&]( std::vector< genfile::bgen::VariantPair >&& chunk ) {
+				std::vector< genfile::bgen::VariantResult > const results = comparer.compare( chunk, 0 ) ;
+				result.insert( result.end(), results.begin(), results.end() ) ;
+				chunks->push_back( std::move( chunk )) ;
+			}
+		) ;
+		return result ;
+	}
+}
+
+TEST_CASE( "Test that CorrelationSums computes squared correlations", "[compare-bgen]" ) {
+	genfile::bgen::CorrelationSums sums ;
+	REQUIRE( std::isnan( sums.r2() )) ;
+	sums.add( 0, 1 ) ;
+	sums.add( 1, 3 ) ;
+	sums.add( 2, 5 ) ;
+	REQUIRE( sums.r2() == Approx( 1 )) ;
+
+	genfile::bgen::CorrelationSums other ;
+	other.add( 1, 0 ) ;
+	sums.add( other ) ;
+	REQUIRE( sums.n == 4 ) ;
+	// x = 0, 1, 2, 1 and y = 1, 3, 5, 0 have covariance 4/4, and variances 2/4 and 14.75/4.
+	REQUIRE( sums.r2() == Approx( 16 / ( 2 * 14.75 ))) ;
+
+	// A constant variable has no correlation.
+	genfile::bgen::CorrelationSums constant ;
+	constant.add( 1, 0 ) ;
+	constant.add( 1, 1 ) ;
+	REQUIRE( std::isnan( constant.r2() )) ;
+}
+
+TEST_CASE( "Test that have_same_calls compares most likely genotypes and haplotypes", "[compare-bgen]" ) {
+	double const a[] = { 0.8, 0.1, 0.1 } ;
+	double const b[] = { 0.5, 0.3, 0.2 } ;
+	double const c[] = { 0.3, 0.5, 0.2 } ;
+	REQUIRE( genfile::bgen::have_same_calls( a, b, 3, 3 )) ;
+	REQUIRE( !genfile::bgen::have_same_calls( a, c, 3, 3 )) ;
+
+	// Phased data is compared haplotype by haplotype.
+	double const x[] = { 0.9, 0.1, 0.2, 0.8 } ;
+	double const y[] = { 0.6, 0.4, 0.4, 0.6 } ;
+	double const z[] = { 0.6, 0.4, 0.6, 0.4 } ;
+	REQUIRE( genfile::bgen::have_same_calls( x, y, 4, 2 )) ;
+	REQUIRE( !genfile::bgen::have_same_calls( x, z, 4, 2 )) ;
+	// ...so the same values grouped as one genotype can agree.
+	REQUIRE( genfile::bgen::have_same_calls( x, z, 4, 4 )) ;
+}
+
+TEST_CASE( "Test that Comparer reports identical genotype data", "[compare-bgen]" ) {
+	std::size_t const N = genotypes.size() ;
+	genfile::bgen::Context const context = make_context( N, zlib_flags ) ;
+	std::vector< genfile::byte_t > const block = encode_block( context, genotypes ) ;
+	genfile::bgen::Comparer const comparer( context, context ) ;
+
+	for( bool const per_sample: { false, true } ) {
+		genfile::bgen::SampleAccumulator samples( N ) ;
+		std::vector< genfile::bgen::VariantResult > const results = comparer.compare(
+			{ variant_pair( block, block ), variant_pair( block, block ) },
+			per_sample ? &samples : 0
+		) ;
+		REQUIRE( results.size() == 2 ) ;
+		for( genfile::bgen::VariantResult const& result: results ) {
+			REQUIRE( result.identical ) ;
+			REQUIRE( result.rsid == "rs1" ) ;
+			REQUIRE( result.position == 1000 ) ;
+			REQUIRE( result.alleles == std::vector< std::string >{ "A", "G" } ) ;
+			REQUIRE( result.compared == 0 ) ;
+			REQUIRE( std::isnan( result.r2 )) ;
+		}
+		// Per-sample totals count identical data as concordant.
+		for( std::size_t i = 0; i < N; ++i ) {
+			REQUIRE( samples.compared[i] == ( per_sample ? 2 : 0 )) ;
+			REQUIRE( samples.concordant[i] == samples.compared[i] ) ;
+			REQUIRE( samples.missing_in_one[i] == 0 ) ;
+			REQUIRE( samples.max_difference[i] == 0 ) ;
+			REQUIRE( samples.dosage[i].n == samples.compared[i] ) ;
+		}
+	}
+}
+
+TEST_CASE( "Test that Comparer reports a perturbed sample", "[compare-bgen]" ) {
+	std::size_t const N = genotypes.size() ;
+	genfile::bgen::Context const context = make_context( N, zlib_flags ) ;
+	Probabilities perturbed = genotypes ;
+	perturbed[2] = { 0, 0.75, 0.25 } ;
+	genfile::bgen::Comparer const comparer( context, context ) ;
+	genfile::bgen::SampleAccumulator samples( N ) ;
+	std::vector< genfile::bgen::VariantResult > const results = comparer.compare(
+		{ variant_pair( encode_block( context, genotypes ), encode_block( context, perturbed )) },
+		&samples
+	) ;
+	REQUIRE( results.size() == 1 ) ;
+	genfile::bgen::VariantResult const& result = results[0] ;
+	REQUIRE( !result.identical ) ;
+	REQUIRE( result.compared == N ) ;
+	REQUIRE( result.missing_in_one == 0 ) ;
+	REQUIRE( result.concordant == N - 1 ) ;
+	REQUIRE( result.max_difference == Approx( 0.75 ).margin( 1e-4 )) ;
+	REQUIRE( result.r2 < 1 ) ;
+	REQUIRE( result.r2 > 0.5 ) ;
+	for( std::size_t i = 0; i < N; ++i ) {
+		REQUIRE( samples.compared[i] == 1 ) ;
+		REQUIRE( samples.concordant[i] == ( i == 2 ? 0 : 1 )) ;
+		if( i == 2 ) {
+			REQUIRE( samples.max_difference[i] == Approx( 0.75 ).margin( 1e-4 )) ;
+		} else {
+			REQUIRE( samples.max_difference[i] < 1e-4 ) ;
+		}
+	}
+}
+
+TEST_CASE( "Test that Comparer reports samples missing in only one file", "[compare-bgen]" ) {
+	std::size_t const N = genotypes.size() ;
+	genfile::bgen::Context const context = make_context( N, zlib_flags ) ;
+	Probabilities x = genotypes, y = genotypes ;
+	// Sample 1 is missing in the second file only, and sample 4 in both.
+	y[1].clear() ;
+	x[4].clear() ;
+	y[4].clear() ;
+	genfile::bgen::Comparer const comparer( context, context ) ;
+	genfile::bgen::SampleAccumulator samples( N ) ;
+	std::vector< genfile::bgen::VariantResult > const results = comparer.compare(
+		{ variant_pair( encode_block( context, x ), encode_block( context, y )) },
+		&samples
+	) ;
+	REQUIRE( results.size() == 1 ) ;
+	REQUIRE( !results[0].identical ) ;
+	REQUIRE( results[0].compared == N - 2 ) ;
+	REQUIRE( results[0].missing_in_one == 1 ) ;
+	REQUIRE( results[0].concordant == N - 2 ) ;
+	REQUIRE( results[0].r2 == Approx( 1 )) ;
+	for( std::size_t i = 0; i < N; ++i ) {
+		REQUIRE( samples.missing_in_one[i] == ( i == 1 ? 1 : 0 )) ;
+		REQUIRE( samples.compared[i] == (( i == 1 || i == 4 ) ? 0 : 1 )) ;
+	}
+}
+
+TEST_CASE( "Test that Comparer does not report differently encoded data as identical", "[compare-bgen]" ) {
+	std::size_t const N = genotypes.size() ;
+	genfile::bgen::Context const zlib_context = make_context( N, zlib_flags ) ;
+	genfile::bgen::Context const zstd_context = make_context( N, zstd_flags ) ;
+
+	SECTION( "different compression" ) {
+		genfile::bgen::Comparer const comparer( zlib_context, zstd_context ) ;
+		std::vector< genfile::bgen::VariantResult > const results = comparer.compare(
+			{ variant_pair( encode_block( zlib_context, genotypes ), encode_block( zstd_context, genotypes )) }, 0
+		) ;
+		REQUIRE( !results[0].identical ) ;
+		REQUIRE( results[0].compared == N ) ;
+		REQUIRE( results[0].concordant == N ) ;
+		REQUIRE( results[0].max_difference == 0 ) ;
+		REQUIRE( results[0].r2 == Approx( 1 )) ;
+	}
+
+	SECTION( "different numbers of bits" ) {
+		genfile::bgen::Comparer const comparer( zlib_context, zlib_context ) ;
+		std::vector< genfile::bgen::VariantResult > const results = comparer.compare(
+			{ variant_pair( encode_block( zlib_context, genotypes, 16 ), encode_block( zlib_context, genotypes, 8 )) }, 0
+		) ;
+		REQUIRE( !results[0].identical ) ;
+		REQUIRE( results[0].compared == N ) ;
+		REQUIRE( results[0].concordant == N ) ;
+		REQUIRE( results[0].max_difference < 0.01 ) ;
+		REQUIRE( results[0].r2 == Approx( 1 ).margin( 1e-3 )) ;
+	}
+
+}
+
+TEST_CASE( "Test that pair_variants pairs variants with the same chromosome, position and alleles", "[compare-bgen]" ) {
+	std::size_t const N = 7 ;
+	std::vector< std::string > const AG = { "A", "G" }, AT = { "A", "T" } ;
+	std::string const filename1 = temp_filename( "genfile_test_compare_1.bgen" ) ;
+	std::string const filename2 = temp_filename( "genfile_test_compare_2.bgen" ) ;
+
+	SECTION( "identical files" ) {
+		std::vector< TestVariant > const variants = consecutive_variants( 10 ) ;
+		write_test_file( filename1, N, variants ) ;
+		write_test_file( filename2, N, variants ) ;
+		for( std::size_t const chunk_size: { 1, 3, 64 } ) {
+			genfile::bgen::PairingSummary summary ;
+			std::vector< std::vector< genfile::bgen::VariantPair > > chunks ;
+			std::vector< genfile::bgen::VariantResult > const results = compare_files( filename1, filename2, chunk_size, &summary, &chunks ) ;
+			REQUIRE( summary.number_of_pairs == variants.size() ) ;
+			REQUIRE( summary.only_in[0] == 0 ) ;
+			REQUIRE( summary.only_in[1] == 0 ) ;
+			REQUIRE( chunks.size() == ( variants.size() + chunk_size - 1 ) / chunk_size ) ;
+			for( std::size_t c = 0; c < chunks.size(); ++c ) {
+				REQUIRE( chunks[c].size() == std::min( chunk_size, variants.size() - c * chunk_size )) ;
+			}
+			REQUIRE( results.size() == variants.size() ) ;
+			for( std::size_t v = 0; v < results.size(); ++v ) {
+				REQUIRE( results[v].rsid == "rs" + std::to_string( variants[v].id )) ;
+				REQUIRE( results[v].position == variants[v].position ) ;
+				REQUIRE( results[v].identical ) ;
+			}
+		}
+	}
+
+	SECTION( "differently encoded files" ) {
+		std::vector< TestVariant > const variants = consecutive_variants( 5 ) ;
+		TestFileOptions options ;
+		options.flags = zstd_flags ;
+		write_test_file( filename1, N, variants ) ;
+		write_test_file( filename2, N, variants, options ) ;
+		genfile::bgen::PairingSummary summary ;
+		std::vector< std::vector< genfile::bgen::VariantPair > > chunks ;
+		std::vector< genfile::bgen::VariantResult > const results = compare_files( filename1, filename2, 64, &summary, &chunks ) ;
+		REQUIRE( summary.number_of_pairs == variants.size() ) ;
+		for( std::size_t v = 0; v < results.size(); ++v ) {
+			REQUIRE( !results[v].identical ) ;
+			REQUIRE( results[v].missing_in_one == 0 ) ;
+			REQUIRE( results[v].concordant == results[v].compared ) ;
+			REQUIRE( results[v].max_difference == 0 ) ;
+		}
+	}
+
+	SECTION( "duplicate keys and variants in only one file" ) {
+		// 01:1001 A/G appears twice in the first file and three times in the second; duplicates
+		// are paired in file order.  01:1002 is only in the first file, and 01:1003 and 01:1004 A/T
+		// only in the second.
+		write_test_file( filename1, N, {
+			{ "01", 1000, AG, 0 }, { "01", 1001, AG, 1 }, { "01", 1001, AG, 2 },
+			{ "01", 1002, AG, 3 }, { "01", 1004, AG, 5 }
+		} ) ;
+		write_test_file( filename2, N, {
+			{ "01", 1000, AG, 0 }, { "01", 1001, AG, 1 }, { "01", 1001, AG, 2 }, { "01", 1001, AG, 4 },
+			{ "01", 1003, AG, 6 }, { "01", 1004, AG, 5 }, { "01", 1004, AT, 7 }
+		} ) ;
+		for( std::size_t const chunk_size: { 1, 2, 64 } ) {
+			genfile::bgen::PairingSummary summary ;
+			std::vector< std::vector< genfile::bgen::VariantPair > > chunks ;
+			std::vector< genfile::bgen::VariantResult > const results = compare_files( filename1, filename2, chunk_size, &summary, &chunks ) ;
+			REQUIRE( summary.number_of_pairs == 4 ) ;
+			REQUIRE( summary.only_in[0] == 1 ) ;
+			REQUIRE( summary.only_in[1] == 3 ) ;
+			std::vector< std::string > const expected_rsids = { "rs0", "rs1", "rs2", "rs5" } ;
+			REQUIRE( results.size() == expected_rsids.size() ) ;
+			for( std::size_t v = 0; v < results.size(); ++v ) {
+				REQUIRE( results[v].rsid == expected_rsids[v] ) ;
+				REQUIRE( results[v].alleles == AG ) ;
+				REQUIRE( results[v].identical ) ;
+			}
+		}
+	}
+
+	SECTION( "duplicate keys with different data" ) {
+		// The second copy of 01:1001 differs, so it is paired with different data.
+		write_test_file( filename1, N, { { "01", 1001, AG, 1 }, { "01", 1001, AG, 2 } } ) ;
+		write_test_file( filename2, N, { { "01", 1001, AG, 1 }, { "01", 1001, AG, 3 } } ) ;
+		genfile::bgen::PairingSummary summary ;
+		std::vector< std::vector< genfile::bgen::VariantPair > > chunks ;
+		std::vector< genfile::bgen::VariantResult > const results = compare_files( filename1, filename2, 64, &summary, &chunks ) ;
+		REQUIRE( summary.number_of_pairs == 2 ) ;
+		REQUIRE( results[0].identical ) ;
+		REQUIRE( !results[1].identical ) ;
+		REQUIRE( results[1].rsid == "rs2" ) ;
+		REQUIRE( results[1].concordant < results[1].compared ) ;
+	}
+
+	remove_test_file( filename1 ) ;
+	remove_test_file( filename2 ) ;
+}
@@ -0,0 +1,481 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <random>
+#include <map>
+#include "stdint.h"
+#include "catch2/catch.hpp"
+#include "genfile/bgen.hpp"
+#include "genfile/dosage.hpp"
+#include "genfile/parallel_decode.hpp"
+#include "genfile/ThreadPool.hpp"
+#include "genfile/types.hpp"
+
+namespace {
+	// Computes dosages through the generic setter API, for comparison with the bulk decoders.
+	struct ReferenceDosageSetter {
+		ReferenceDosageSetter( std::vector< double >* result ): m_result( result ) {}
+		void initialise( std::size_t n, std::size_t k ) { m_result->assign( n, 0.0 ) ; }
+		bool set_sample( std::size_t i ) { m_sample_i = i ; return true ; }
+		void set_number_of_entries( std::size_t ploidy, std::size_t n, genfile::OrderType order_type, genfile::ValueType ) {
+			m_phased = ( order_type == genfile::ePerPhasedHaplotypePerAllele ) ;
+		}
+		void set_value( uint32_t i, double value ) {
+			(*m_result)[ m_sample_i ] += ( m_phased ? ( i % 2 ) : i ) * value ;
+		}
+		void set_value( uint32_t, genfile::MissingValue ) {
+			(*m_result)[ m_sample_i ] = -1 ;
+		}
+		std::vector< double >* m_result ;
+		std::size_t m_sample_i ;
+		bool m_phased ;
+	} ;
+
+	struct Sample {
+		uint32_t ploidy ;
+		bool missing ;
+		std::vector< double > probs ;
+	} ;
+
+	// Write a biallelic variant with the given samples using the v12 writer,
+	// returning the uncompressed genotype data block.
+	std::vector< genfile::byte_t > write_block( std::vector< Sample > const& samples, int bits, bool phased ) {
+		std::vector< genfile::byte_t > buffer( 100 + samples.size() * 40 ) ;
+		genfile::bgen::v12::ProbabilityDataWriter writer( bits, 0.01 ) ;
+		writer.initialise( samples.size(), 2, &buffer[0], &buffer[0] + buffer.size() ) ;
+		for( std::size_t i = 0; i < samples.size(); ++i ) {
+			writer.set_sample( i ) ;
+			writer.set_number_of_entries(
+				samples[i].ploidy, samples[i].probs.size(),
+				phased ? genfile::ePerPhasedHaplotypePerAllele : genfile::ePerUnorderedGenotype,
+				genfile::eProbability
+			) ;
+			for( std::size_t k = 0; k < samples[i].probs.size(); ++k ) {
+				if( samples[i].missing ) {
+					writer.set_value( k, genfile::MissingValue() ) ;
+				} else {
+					writer.set_value( k, samples[i].probs[k] ) ;
+				}
+			}
+		}
+		writer.finalise() ;
+		return std::vector< genfile::byte_t >( writer.repr().first, writer.repr().second ) ;
+	}
+
+	std::vector< Sample > simulate_samples( std::size_t n, std::vector< uint32_t > const& ploidies, bool phased, std::mt19937& rng ) {
+		std::uniform_real_distribution< double > uniform( 0.0, 1.0 ) ;
+		std::vector< Sample > result( n ) ;
+		for( std::size_t i = 0; i < n; ++i ) {
+			Sample& sample = result[i] ;
+			sample.ploidy = ploidies[ i % ploidies.size() ] ;
+			sample.missing = ( i % 7 == 3 ) ;
+			if( phased ) {
+				for( uint32_t h = 0; h < sample.ploidy; ++h ) {
+					double const p = uniform( rng ) ;
+					sample.probs.push_back( p ) ;
+					sample.probs.push_back( 1.0 - p ) ;
+				}
+			} else {
+				double sum = 0.0 ;
+				for( uint32_t g = 0; g <= sample.ploidy; ++g ) {
+					sample.probs.push_back( uniform( rng ) ) ;
+					sum += sample.probs.back() ;
+				}
+				for( uint32_t g = 0; g <= sample.ploidy; ++g ) {
+					sample.probs[g] /= sum ;
+				}
+			}
+		}
+		return result ;
+	}
+
+	template< typename T >
+	std::vector< double > decode_as_double( genfile::bgen::Context const& context, std::vector< genfile::byte_t > const& block ) {
+		std::vector< T > values( context.number_of_samples ) ;
+		genfile::bgen::parse_dosage_data( &block[0], &block[0] + block.size(), context, &values[0] ) ;
+		std::vector< double > result( values.size() ) ;
+		for( std::size_t i = 0; i < values.size(); ++i ) {
+			double const value = double( values[i] ) ;
+			result[i] = ( value != value ) ? -1 : value ;
+		}
+		return result ;
+	}
+
+	void check_decoders( std::vector< Sample > const& samples, int bits, bool phased ) {
+		genfile::bgen::Context context ;
+		context.flags = genfile::bgen::e_Layout2 ;
+		context.number_of_samples = samples.size() ;
+		std::vector< genfile::byte_t > const block = write_block( samples, bits, phased ) ;
+
+		std::vector< double > expected ;
+		ReferenceDosageSetter setter( &expected ) ;
+		genfile::bgen::parse_probability_data( &block[0], &block[0] + block.size(), context, setter ) ;
+
+		std::vector< double > const doubles = decode_as_double< double >( context, block ) ;
+		std::vector< double > const floats = decode_as_double< float >( context, block ) ;
+		std::vector< double > const halfs = decode_as_double< genfile::float16_t >( context, block ) ;
+		std::vector< double > const bfloats = decode_as_double< genfile::bfloat16_t >( context, block ) ;
+
+		std::vector< uint8_t > bytes( samples.size() ) ;
+		genfile::bgen::parse_dosage_data( &block[0], &block[0] + block.size(), context, &bytes[0] ) ;
+
+		for( std::size_t i = 0; i < samples.size(); ++i ) {
+			if( expected[i] == -1 ) {
+				REQUIRE( doubles[i] == -1 ) ;
+				REQUIRE( floats[i] == -1 ) ;
+				REQUIRE( halfs[i] == -1 ) ;
+				REQUIRE( bfloats[i] == -1 ) ;
+				REQUIRE( int( bytes[i] ) == 255 ) ;
+			} else {
+				REQUIRE( doubles[i] == Approx( expected[i] ).margin( 1E-12 ) ) ;
+				REQUIRE( floats[i] == Approx( expected[i] ).margin( 1E-6 ) ) ;
+				REQUIRE( halfs[i] == Approx( expected[i] ).margin( 1E-3 ) ) ;
+				REQUIRE( bfloats[i] == Approx( expected[i] ).margin( 1E-2 ) ) ;
+				REQUIRE( int( bytes[i] ) == int( std::min( std::floor( expected[i] * 127 + 0.5 ), 254.0 ) ) ) ;
+			}
+		}
+	}
+}
+
+TEST_CASE( "16-bit floating point conversions", "[dosage]" ) {
+	std::cerr << "test_float16\n" ;
+	REQUIRE( genfile::float16_t::from_float( 0.0f ).bits == 0x0000 ) ;
+	REQUIRE( genfile::float16_t::from_float( 1.0f ).bits == 0x3C00 ) ;
+	REQUIRE( genfile::float16_t::from_float( 2.0f ).bits == 0x4000 ) ;
+	REQUIRE( genfile::float16_t::from_float( 0.5f ).bits == 0x3800 ) ;
+	REQUIRE( genfile::float16_t::from_float( -2.0f ).bits == 0xC000 ) ;
+	REQUIRE( genfile::float16_t::from_float( 1.0f / 3.0f ).bits == 0x3555 ) ;
+	REQUIRE( genfile::float16_t::from_float( 65504.0f ).bits == 0x7BFF ) ;
+	REQUIRE( genfile::float16_t::from_float( 1E6f ).bits == 0x7C00 ) ;
+	REQUIRE( genfile::float16_t::from_float( std::pow( 2.0f, -24.0f )).bits == 0x0001 ) ;
+	REQUIRE( genfile::float16_t::from_float( std::nanf( "" )).bits == 0x7E00 ) ;
+	REQUIRE( genfile::bfloat16_t::from_float( 1.0f ).bits == 0x3F80 ) ;
+	REQUIRE( genfile::bfloat16_t::from_float( 2.0f ).bits == 0x4000 ) ;
+
+	// Every finite half value must round-trip through float.
+	for( uint32_t bits = 0; bits < 65536; ++bits ) {
+		genfile::float16_t const value = genfile::float16_t::from_bits( bits ) ;
+		if(( bits & 0x7C00 ) != 0x7C00 ) {
+			REQUIRE( genfile::float16_t::from_float( value.to_float() ).bits == bits ) ;
+		}
+	}
+	for( uint32_t bits = 0; bits < 65536; ++bits ) {
+		genfile::bfloat16_t const value = genfile::bfloat16_t::from_bits( bits ) ;
+		if(( bits & 0x7F80 ) != 0x7F80 ) {
+			REQUIRE( genfile::bfloat16_t::from_float( value.to_float() ).bits == bits ) ;
+		}
+	}
+}
+
+TEST_CASE( "Bulk dosage decoding of diploid data", "[dosage][biallelic]" ) {
+	std::cerr << "test_dosage_diploid\n" ;
+	std::mt19937 rng( 1234 ) ;
+	for( int bits = 1; bits <= 32; ++bits ) {
+		for( int phased = 0; phased < 2; ++phased ) {
+			std::vector< Sample > const samples = simulate_samples( 101, std::vector< uint32_t >( 1, 2 ), phased, rng ) ;
+			check_decoders( samples, bits, phased ) ;
+		}
+	}
+}
+
+TEST_CASE( "Bulk dosage decoding of mixed-ploidy data", "[dosage][biallelic]" ) {
+	std::cerr << "test_dosage_mixed_ploidy\n" ;
+	std::mt19937 rng( 5678 ) ;
+	for( int bits = 1; bits <= 32; ++bits ) {
+		for( int phased = 0; phased < 2; ++phased ) {
+			// The v12 writer cannot represent phased data for zero-ploid samples.
+			std::vector< uint32_t > const ploidies = phased ? std::vector< uint32_t >{ 1, 2, 2, 3, 1, 4 } : std::vector< uint32_t >{ 1, 2, 0, 2, 3, 1, 4 } ;
+			std::vector< Sample > const samples = simulate_samples( 57, ploidies, phased, rng ) ;
+			check_decoders( samples, bits, phased ) ;
+		}
+	}
+}
+
+TEST_CASE( "8-bit dosages are exact", "[dosage][biallelic]" ) {
+	std::cerr << "test_dosage_uint8_exact\n" ;
+	genfile::bgen::Context context ;
+	context.flags = genfile::bgen::e_Layout2 ;
+	context.number_of_samples = 1 ;
+	// Every representable 8-bit diploid genotype should decode to round( 127 * dosage ).
+	std::vector< genfile::byte_t > block = write_block( std::vector< Sample >( 1, Sample{ 2, false, { 1.0, 0.0, 0.0 } } ), 8, false ) ;
+	for( uint32_t p0 = 0; p0 < 256; ++p0 ) {
+		for( uint32_t p1 = 0; p0 + p1 < 256; ++p1 ) {
+			block[11] = p0 ;
+			block[12] = p1 ;
+			uint8_t value ;
+			genfile::bgen::parse_dosage_data( &block[0], &block[0] + block.size(), context, &value ) ;
+			uint32_t const numerator = p1 + 2 * ( 255 - p0 - p1 ) ;
+			REQUIRE( int( value ) == int( std::floor( 127.0 * numerator / 255.0 + 0.5 ) ) ) ;
+		}
+	}
+}
+
+TEST_CASE( "compute_dosages() options", "[dosage][biallelic]" ) {
+	std::cerr << "test_compute_dosages_options\n" ;
+	std::mt19937 rng( 91011 ) ;
+	for( int bits = 1; bits <= 16; ++bits ) {
+		for( int phased = 0; phased < 2; ++phased ) {
+			for( int diploid = 0; diploid < 2; ++diploid ) {
+				std::vector< uint32_t > const ploidies = diploid ? std::vector< uint32_t >{ 2 } : std::vector< uint32_t >{ 1, 2, 3, 2 } ;
+				// Use enough samples to exercise vectorised code, with a remainder.
+				std::vector< Sample > const samples = simulate_samples( 67, ploidies, phased, rng ) ;
+				std::vector< genfile::byte_t > const block = write_block( samples, bits, phased ) ;
+				genfile::bgen::Context context ;
+				context.flags = genfile::bgen::e_Layout2 ;
+				context.number_of_samples = samples.size() ;
+				genfile::bgen::v12::GenotypeDataBlock const pack( context, &block[0], &block[0] + block.size() ) ;
+
+				genfile::bgen::DosageOptions options ;
+				std::vector< float > second( samples.size() ), first( samples.size() ), scalar( samples.size() ), imputed( samples.size() ) ;
+				std::size_t const number_non_missing = genfile::bgen::v12::compute_dosages( pack, &second[0], options ) ;
+				options.vectorise = false ;
+				genfile::bgen::v12::compute_dosages( pack, &scalar[0], options ) ;
+				options.allele = 0 ;
+				genfile::bgen::v12::compute_dosages( pack, &first[0], options ) ;
+				options.allele = 1 ;
+				options.mean_impute = true ;
+				genfile::bgen::v12::compute_dosages( pack, &imputed[0], options ) ;
+
+				double sum = 0.0 ;
+				std::size_t count = 0 ;
+				for( std::size_t i = 0; i < samples.size(); ++i ) {
+					if( !samples[i].missing ) {
+						sum += second[i] ;
+						++count ;
+					}
+				}
+				REQUIRE( number_non_missing == count ) ;
+				for( std::size_t i = 0; i < samples.size(); ++i ) {
+					if( samples[i].missing ) {
+						REQUIRE( second[i] != second[i] ) ;
+						REQUIRE( scalar[i] != scalar[i] ) ;
+						REQUIRE( first[i] != first[i] ) ;
+						REQUIRE( imputed[i] == Approx( sum / count ) ) ;
+					} else {
+						REQUIRE( scalar[i] == second[i] ) ;
+						REQUIRE( first[i] == Approx( samples[i].ploidy - second[i] ).margin( 1E-6 ) ) ;
+						REQUIRE( imputed[i] == second[i] ) ;
+					}
+				}
+			}
+		}
+	}
+	genfile::bgen::DosageOptions options ;
+	options.allele = 2 ;
+	genfile::bgen::Context context ;
+	context.flags = genfile::bgen::e_Layout2 ;
+	context.number_of_samples = 1 ;
+	std::vector< genfile::byte_t > const block = write_block( std::vector< Sample >( 1, Sample{ 2, false, { 1.0, 0.0, 0.0 } } ), 8, false ) ;
+	double value ;
+	REQUIRE_THROWS_AS(
+		genfile::bgen::v12::compute_dosages( genfile::bgen::v12::GenotypeDataBlock( context, &block[0], &block[0] + block.size() ), &value, options ),
+		std::invalid_argument
+	) ;
+}
+
+namespace {
+	// Write a variant with the given number of alleles and samples using the v12 writer,
+	// returning the uncompressed genotype data block.
+	std::vector< genfile::byte_t > write_multiallelic_block( uint32_t number_of_alleles, std::vector< Sample > const& samples, bool phased ) {
+		std::vector< genfile::byte_t > buffer( 100 + samples.size() * 100 ) ;
+		genfile::bgen::v12::ProbabilityDataWriter writer( 16 ) ;
+		writer.initialise( samples.size(), number_of_alleles, &buffer[0], &buffer[0] + buffer.size() ) ;
+		for( std::size_t i = 0; i < samples.size(); ++i ) {
+			writer.set_sample( i ) ;
+			writer.set_number_of_entries(
+				samples[i].ploidy, samples[i].probs.size(),
+				phased ? genfile::ePerPhasedHaplotypePerAllele : genfile::ePerUnorderedGenotype,
+				genfile::eProbability
+			) ;
+			for( std::size_t k = 0; k < samples[i].probs.size(); ++k ) {
+				if( samples[i].missing ) {
+					writer.set_value( k, genfile::MissingValue() ) ;
+				} else {
+					writer.set_value( k, samples[i].probs[k] ) ;
+				}
+			}
+		}
+		writer.finalise() ;
+		return std::vector< genfile::byte_t >( writer.repr().first, writer.repr().second ) ;
+	}
+
+	std::vector< double > compute_multiallelic_dosages(
+		std::vector< genfile::byte_t > const& block,
+		std::size_t number_of_samples,
+		uint32_t allele,
+		bool mean_impute = false
+	) {
+		genfile::bgen::Context context ;
+		context.flags = genfile::bgen::e_Layout2 ;
+		context.number_of_samples = number_of_samples ;
+		genfile::bgen::DosageOptions options ;
+		options.allele = allele ;
+		options.mean_impute = mean_impute ;
+		std::vector< double > result( number_of_samples ) ;
+		genfile::bgen::v12::compute_dosages(
+			genfile::bgen::v12::GenotypeDataBlock( context, &block[0], &block[0] + block.size() ),
+			&result[0], options
+		) ;
+		return result ;
+	}
+}
+
+TEST_CASE( "compute_dosages() computes the expected count of any allele of a multiallelic variant", "[dosage][multiallelic]" ) {
+	std::cerr << "test_dosage_multiallelic\n" ;
+	// Probabilities are stored to 16 bits.
+	double const tolerance = 1E-4 ;
+
+	SECTION( "Unphased diploid genotypes are ordered AA, AB, BB, AC, BC, CC" ) {
+		std::vector< Sample > samples ;
+		for( std::size_t g = 0; g < 6; ++g ) {
+			std::vector< double > probs( 6, 0.0 ) ;
+			probs[g] = 1.0 ;
+			samples.push_back( Sample{ 2, false, probs } ) ;
+		}
+		samples.push_back( Sample{ 2, false, { 0.25, 0, 0.25, 0.5, 0, 0 } } ) ;
+		samples.push_back( Sample{ 2, true, std::vector< double >( 6, 0.0 ) } ) ;
+		std::vector< genfile::byte_t > const block = write_multiallelic_block( 3, samples, false ) ;
+		std::vector< std::vector< double > > const expected = {
+			{ 2, 1, 0, 1, 0, 0, 1.0, -1 },
+			{ 0, 1, 2, 0, 1, 0, 0.5, -1 },
+			{ 0, 0, 0, 1, 1, 2, 0.5, -1 }
+		} ;
+		for( uint32_t allele = 0; allele < 3; ++allele ) {
+			std::vector< double > const result = compute_multiallelic_dosages( block, samples.size(), allele ) ;
+			for( std::size_t i = 0; i < samples.size(); ++i ) {
+				if( expected[allele][i] == -1 ) {
+					REQUIRE( result[i] != result[i] ) ;
+				} else {
+					REQUIRE( result[i] == Approx( expected[allele][i] ).margin( tolerance ) ) ;
+				}
+			}
+		}
+		// Missing samples are imputed with the mean.
+		std::vector< double > const imputed = compute_multiallelic_dosages( block, samples.size(), 2, true ) ;
+		REQUIRE( imputed.back() == Approx( 4.5 / 7 ).margin( tolerance ) ) ;
+	}
+
+	SECTION( "Genotypes of mixed ploidy" ) {
+		// Triploid genotypes are ordered AAA, AAB, ABB, BBB, AAC, ABC, BBC, ACC, BCC, CCC.
+		std::vector< Sample > samples ;
+		for( std::size_t g = 0; g < 10; ++g ) {
+			std::vector< double > probs( 10, 0.0 ) ;
+			probs[g] = 1.0 ;
+			samples.push_back( Sample{ 3, false, probs } ) ;
+		}
+		samples.push_back( Sample{ 1, false, { 0.25, 0.25, 0.5 } } ) ;
+		std::vector< genfile::byte_t > const block = write_multiallelic_block( 3, samples, false ) ;
+		std::vector< std::vector< double > > const expected = {
+			{ 3, 2, 1, 0, 2, 1, 0, 1, 0, 0, 0.25 },
+			{ 0, 1, 2, 3, 0, 1, 2, 0, 1, 0, 0.25 },
+			{ 0, 0, 0, 0, 1, 1, 1, 2, 2, 3, 0.5 }
+		} ;
+		for( uint32_t allele = 0; allele < 3; ++allele ) {
+			std::vector< double > const result = compute_multiallelic_dosages( block, samples.size(), allele ) ;
+			for( std::size_t i = 0; i < samples.size(); ++i ) {
+				REQUIRE( result[i] == Approx( expected[allele][i] ).margin( tolerance ) ) ;
+			}
+		}
+	}
+
+	SECTION( "Phased haplotypes" ) {
+		std::vector< Sample > const samples = {
+			Sample{ 2, false, { 1, 0, 0, 0, 0, 0, 0, 1 } },
+			Sample{ 2, false, { 0.25, 0.25, 0.5, 0, 0.5, 0, 0.25, 0.25 } }
+		} ;
+		std::vector< genfile::byte_t > const block = write_multiallelic_block( 4, samples, true ) ;
+		std::vector< std::vector< double > > const expected = {
+			{ 1, 0.75 }, { 0, 0.25 }, { 0, 0.75 }, { 1, 0.25 }
+		} ;
+		for( uint32_t allele = 0; allele < 4; ++allele ) {
+			std::vector< double > const result = compute_multiallelic_dosages( block, samples.size(), allele ) ;
+			for( std::size_t i = 0; i < samples.size(); ++i ) {
+				REQUIRE( result[i] == Approx( expected[allele][i] ).margin( tolerance ) ) ;
+			}
+		}
+	}
+
+	SECTION( "The allele must be less than the number of alleles" ) {
+		std::vector< Sample > const samples = { Sample{ 2, false, { 1, 0, 0, 0, 0, 0 } } } ;
+		std::vector< genfile::byte_t > const block = write_multiallelic_block( 3, samples, false ) ;
+		REQUIRE_THROWS_AS( compute_multiallelic_dosages( block, samples.size(), 3 ), std::invalid_argument ) ;
+	}
+}
+
+TEST_CASE( "Decoding a variant in sample ranges on a thread pool gives the same results", "[dosage][parallel]" ) {
+	std::cerr << "test_parallel_decode\n" ;
+	std::mt19937 rng( 121314 ) ;
+	genfile::ThreadPool pool( 4 ) ;
+	for( int bits = 1; bits <= 16; ++bits ) {
+		for( int phased = 0; phased < 2; ++phased ) {
+			for( int diploid = 0; diploid < 2; ++diploid ) {
+				std::vector< uint32_t > const ploidies = diploid ? std::vector< uint32_t >{ 2 } : std::vector< uint32_t >{ 1, 2, 3, 2, 2 } ;
+				std::vector< Sample > const samples = simulate_samples( 1001, ploidies, phased, rng ) ;
+				std::vector< genfile::byte_t > const block = write_block( samples, bits, phased ) ;
+				genfile::bgen::Context context ;
+				context.flags = genfile::bgen::e_Layout2 ;
+				context.number_of_samples = samples.size() ;
+				genfile::bgen::v12::GenotypeDataBlock const pack( context, &block[0], &block[0] + block.size() ) ;
+
+				std::vector< genfile::bgen::v12::SampleRange > const ranges = genfile::bgen::v12::split_by_samples( pack, 7 ) ;
+				REQUIRE( ranges.size() > 1 ) ;
+				REQUIRE( ranges.size() <= 7 ) ;
+				REQUIRE( ranges.front().begin == 0 ) ;
+				REQUIRE( ranges.back().end == samples.size() ) ;
+				for( std::size_t i = 1; i < ranges.size(); ++i ) {
+					REQUIRE( ranges[i].begin == ranges[i-1].end ) ;
+					REQUIRE( ranges[i].byte_offset > ranges[i-1].byte_offset ) ;
+				}
+
+				// Use small ranges so that several are decoded in parallel.
+				std::size_t const min_samples_per_range = 100 ;
+				genfile::bgen::DosageOptions options ;
+				std::vector< double > expected( samples.size() ), result( samples.size() ) ;
+				REQUIRE(
+					genfile::bgen::v12::compute_dosages( pack, &result[0], options, pool, min_samples_per_range )
+					== genfile::bgen::v12::compute_dosages( pack, &expected[0], options )
+				) ;
+				options.mean_impute = true ;
+				std::vector< double > expected_imputed( samples.size() ), imputed( samples.size() ) ;
+				genfile::bgen::v12::compute_dosages( pack, &expected_imputed[0], options ) ;
+				genfile::bgen::v12::compute_dosages( pack, &imputed[0], options, pool, min_samples_per_range ) ;
+
+				std::map< uint32_t, std::vector< double > > parts ;
+				genfile::bgen::v12::parse_probability_data(
+					pack,
+					[&parts]( genfile::bgen::v12::SampleRange const& range ) {
+						return ReferenceDosageSetter( &parts[ range.begin ] ) ;
+					},
+					pool,
+					min_samples_per_range
+				) ;
+				REQUIRE( parts.size() > 1 ) ;
+				std::vector< double > probabilities ;
+				for( auto const& part: parts ) {
+					REQUIRE( part.first == probabilities.size() ) ;
+					probabilities.insert( probabilities.end(), part.second.begin(), part.second.end() ) ;
+				}
+				std::vector< double > reference ;
+				ReferenceDosageSetter setter( &reference ) ;
+				genfile::bgen::v12::parse_probability_data( pack, setter ) ;
+				REQUIRE( probabilities == reference ) ;
+
+				for( std::size_t i = 0; i < samples.size(); ++i ) {
+					if( samples[i].missing ) {
+						REQUIRE( result[i] != result[i] ) ;
+						REQUIRE( imputed[i] == Approx( expected_imputed[i] ) ) ;
+					} else {
+						REQUIRE( result[i] == expected[i] ) ;
+						REQUIRE( imputed[i] == expected[i] ) ;
+					}
+				}
+			}
+		}
+	}
+}
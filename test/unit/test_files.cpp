@@ -0,0 +1,97 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <vector>
+#include <string>
+#include <filesystem>
+#include "genfile/bgen.hpp"
+#include "genfile/Writer.hpp"
+#include "genfile/IndexWriter.hpp"
+#include "genfile/hash.hpp"
+#include "test_files.hpp"
+
+std::vector< genfile::byte_t > encode_variant( genfile::bgen::Context const& context, std::size_t variant, int number_of_bits ) {
+	std::vector< genfile::byte_t > buffer1, buffer2 ;
+	genfile::bgen::GenotypeDataBlockWriter writer( &buffer1, &buffer2, context, number_of_bits ) ;
+	writer.initialise( context.number_of_samples, 2, 2 ) ;
+	for( std::size_t i = 0; i < context.number_of_samples; ++i ) {
+		writer.set_sample( i ) ;
+		writer.set_number_of_entries( 2, 3, genfile::ePerUnorderedGenotype, genfile::eProbability ) ;
+		for( std::size_t g = 0; g < 3; ++g ) {
+			if( ( i + variant ) % 5 == 4 ) {
+				writer.set_value( g, genfile::MissingValue() ) ;
+			} else {
+				writer.set_value( g, ( ( i + variant ) % 3 == g ) ? 1.0 : 0.0 ) ;
+			}
+		}
+	}
+	writer.finalise() ;
+	return std::vector< genfile::byte_t >( writer.repr().first, writer.repr().second ) ;
+}
+
+double expected_dosage( std::size_t sample, std::size_t variant ) {
+	return ( ( sample + variant ) % 5 == 4 ) ? -1.0 : double( ( sample + variant ) % 3 ) ;
+}
+
+std::vector< TestVariant > consecutive_variants( std::size_t number_of_variants, std::string const& chromosome, uint32_t first_position ) {
+	std::vector< TestVariant > result ;
+	for( std::size_t variant = 0; variant < number_of_variants; ++variant ) {
+		result.push_back( TestVariant{ chromosome, uint32_t( first_position + variant ), { "A", "G" }, variant } ) ;
+	}
+	return result ;
+}
+
+genfile::bgen::Writer::FileMetadata write_test_file(
+	std::string const& filename,
+	std::size_t number_of_samples,
+	std::vector< TestVariant > const& variants,
+	TestFileOptions const& options
+) {
+	remove_test_file( filename ) ;
+	genfile::bgen::Context context ;
+	context.number_of_samples = number_of_samples ;
+	context.flags = options.flags ;
+	genfile::bgen::Writer writer( filename, context, options.sample_ids ) ;
+	genfile::bgen::IndexWriter::UniquePtr index_writer ;
+	if( options.write_index ) {
+		index_writer = genfile::bgen::IndexWriter::create( filename + ".bgi", false, options.with_hashes ) ;
+	}
+	// Blocks passed to the writer start with their length, except for uncompressed layout 1 data.
+	std::size_t const length_field_size = (
+		( context.flags & genfile::bgen::e_Layout ) == genfile::bgen::e_Layout2
+		|| ( context.flags & genfile::bgen::e_CompressedSNPBlocks ) != genfile::bgen::e_NoCompression
+	) ? 4 : 0 ;
+	for( TestVariant const& v: variants ) {
+		std::vector< genfile::byte_t > const data = encode_variant( writer.context(), v.id ) ;
+		std::string const rsid = "rs" + std::to_string( v.id ) ;
+		genfile::bgen::IndexQuery::FileRange const range = writer.write_variant(
+			"SNP" + std::to_string( v.id ), rsid, v.chromosome, v.position, v.alleles,
+			&data[0], &data[0] + data.size()
+		) ;
+		if( index_writer.get() ) {
+			std::optional< uint64_t > content_hash ;
+			if( options.with_hashes ) {
+				content_hash = genfile::bgen::content_hash( &data[0] + length_field_size, &data[0] + data.size() ) ;
+			}
+			index_writer->add_variant( v.chromosome, v.position, rsid, v.alleles, range, content_hash ) ;
+		}
+	}
+	genfile::bgen::Writer::FileMetadata const metadata = writer.finalise() ;
+	if( index_writer.get() ) {
+		index_writer->finalise( metadata ) ;
+	}
+	return metadata ;
+}
+
+std::string temp_filename( std::string const& name ) {
+	return ( std::filesystem::temp_directory_path() / name ).string() ;
+}
+
+void remove_test_file( std::string const& filename ) {
+	std::filesystem::remove( filename ) ;
+	std::filesystem::remove( filename + ".bgi" ) ;
+	std::filesystem::remove( filename + ".bgi.tmp" ) ;
+}
@@ -0,0 +1,87 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BGEN_TEST_FILES_HPP
+#define BGEN_TEST_FILES_HPP
+
+#include <vector>
+#include <string>
+#include "stdint.h"
+#include "genfile/bgen.hpp"
+#include "genfile/Writer.hpp"
+#include "genfile/MissingValue.hpp"
+#include "genfile/types.hpp"
+
+// Helpers for tests that write bgen files and read them back.
+
+// Encode a biallelic diploid variant in which sample i has genotype (i+variant) % 3,
+// or is missing if (i+variant) % 5 == 4.  The result is a genotype data block as passed
+// to Writer::write_variant(), i.e. including its leading length field, if any.
+std::vector< genfile::byte_t > encode_variant( genfile::bgen::Context const& context, std::size_t variant, int number_of_bits = 8 ) ;
+
+// Return the dosage of sample i in a variant encoded by encode_variant(), or -1 if it is missing.
+double expected_dosage( std::size_t sample, std::size_t variant ) ;
+
+// A setter that computes dosages, or -1 for missing samples.
+struct DosageSetter {
+	DosageSetter( std::vector< double >* result ): m_result( result ) {}
+	void initialise( std::size_t n, std::size_t ) { m_result->assign( n, 0.0 ) ; }
+	bool set_sample( std::size_t i ) { m_sample_i = i ; return true ; }
+	void set_number_of_entries( std::size_t, std::size_t, genfile::OrderType, genfile::ValueType ) {}
+	void set_value( uint32_t g, double value ) { (*m_result)[ m_sample_i ] += g * value ; }
+	void set_value( uint32_t, genfile::MissingValue ) { (*m_result)[ m_sample_i ] = -1 ; }
+	std::vector< double >* m_result ;
+	std::size_t m_sample_i ;
+} ;
+
+// A variant written by write_test_file(), with SNPID "SNP<id>", rsid "rs<id>" and the
+// genotypes encoded by encode_variant() for the id.
+struct TestVariant {
+	std::string chromosome ;
+	uint32_t position ;
+	std::vector< std::string > alleles ;
+	std::size_t id ;
+} ;
+
+// Return variants with ids 0, ..., number_of_variants-1 and alleles A and G, at consecutive positions.
+std::vector< TestVariant > consecutive_variants(
+	std::size_t number_of_variants,
+	std::string const& chromosome = "01",
+	uint32_t first_position = 1000
+) ;
+
+struct TestFileOptions {
+	TestFileOptions():
+		flags( genfile::bgen::e_Layout2 | genfile::bgen::e_ZlibCompression ),
+		write_index( true ),
+		with_hashes( false )
+	{}
+
+	// Flags of the file's context, i.e. its layout and compression.
+	uint32_t flags ;
+	// Sample identifiers to store, if any.
+	std::vector< std::string > sample_ids ;
+	// Whether to write an index, with ".bgi" appended to the filename.
+	bool write_index ;
+	// Whether the index records content hashes.
+	bool with_hashes ;
+} ;
+
+// Write the given variants, and (by default) an index, to the given file, replacing any existing file.
+genfile::bgen::Writer::FileMetadata write_test_file(
+	std::string const& filename,
+	std::size_t number_of_samples,
+	std::vector< TestVariant > const& variants,
+	TestFileOptions const& options = TestFileOptions()
+) ;
+
+// Return the path of a file with the given name in the temporary directory.
+std::string temp_filename( std::string const& name ) ;
+
+// Remove a bgen file and its index, if they exist.
+void remove_test_file( std::string const& filename ) ;
+
+#endif
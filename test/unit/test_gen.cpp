@@ -0,0 +1,54 @@
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include "catch2/catch.hpp"
+#include "genfile/gen.hpp"
+
+namespace {
+	double parse( std::string const& value ) {
+		return genfile::gen::parse_probability( genfile::gen::Slice( value.data(), value.data() + value.size() )) ;
+	}
+
+	std::vector< std::string > split( std::string const& line ) {
+		std::vector< genfile::gen::Slice > fields ;
+		genfile::gen::split_whitespace( genfile::gen::Slice( line.data(), line.data() + line.size() ), &fields ) ;
+		std::vector< std::string > result ;
+		for( genfile::gen::Slice const& field: fields ) {
+			result.push_back( genfile::gen::to_string( field )) ;
+		}
+		return result ;
+	}
+}
+
+TEST_CASE( "Test that GEN probabilities are parsed", "[gen]" ) {
+	REQUIRE( parse( "0" ) == 0.0 ) ;
+	REQUIRE( parse( "1" ) == 1.0 ) ;
+	REQUIRE( parse( "0.8745" ) == 0.8745 ) ;
+	REQUIRE( parse( "0.5" ) == 0.5 ) ;
+	REQUIRE( parse( "1." ) == 1.0 ) ;
+	REQUIRE( parse( "0.123456789012345" ) == Approx( 0.123456789012345 ).epsilon( 1e-15 )) ;
+	// Values outside the fast path are parsed by std::from_chars().
+	REQUIRE( parse( "1e-3" ) == 0.001 ) ;
+	REQUIRE( parse( ".25" ) == 0.25 ) ;
+	REQUIRE( parse( "0.12345678901234567" ) == Approx( 0.12345678901234567 )) ;
+	REQUIRE( parse( "12345678901" ) == 12345678901.0 ) ;
+
+	for( std::string const value: { "", "-0.5", "0.5x", "abc", "0.5\r", "nan", "NaN", "inf", "-inf", "infinity", "1e400" } ) {
+		CAPTURE( value ) ;
+		REQUIRE_THROWS_AS( parse( value ), std::invalid_argument ) ;
+	}
+}
+
+TEST_CASE( "Test that GEN lines are split into fields", "[gen]" ) {
+	REQUIRE( split( "" ).empty() ) ;
+	REQUIRE( split( " \t " ).empty() ) ;
+	REQUIRE( split( "01 SNP1 rs1 1000 A G 1 0 0" ) == std::vector< std::string >({ "01", "SNP1", "rs1", "1000", "A", "G", "1", "0", "0" })) ;
+	REQUIRE( split( "  a\t\tb  c " ) == std::vector< std::string >({ "a", "b", "c" })) ;
+	// Lines with Windows line endings give the same fields.
+	REQUIRE( split( "SNP1 rs1 1000 A G 0 0.5 0.5\r" ) == std::vector< std::string >({ "SNP1", "rs1", "1000", "A", "G", "0", "0.5", "0.5" })) ;
+}
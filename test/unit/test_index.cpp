@@ -0,0 +1,309 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include "stdint.h"
+#include "catch2/catch.hpp"
+#include "genfile/bgen.hpp"
+#include "genfile/Writer.hpp"
+#include "genfile/IndexWriter.hpp"
+#include "genfile/IndexQuery.hpp"
+#include "genfile/query_spec.hpp"
+#include "genfile/View.hpp"
+#include "genfile/hash.hpp"
+#include "genfile/types.hpp"
+#include "db/Connection.hpp"
+#include "db/SQLStatement.hpp"
+#include "test_files.hpp"
+
+TEST_CASE( "Test that IndexQuery::include_positions() selects variants by position and alleles", "[bgen][index]" ) {
+	std::string const filename = temp_filename( "genfile_test_include_positions.bgen" ) ;
+	std::string const index_filename = filename + ".bgi" ;
+
+	// Variant i is at position 1000 + (i/2) on chromosome "01", so pairs of variants share positions
+	// and are distinguished by their second allele.
+	std::vector< TestVariant > variants ;
+	for( std::size_t variant = 0; variant < 20; ++variant ) {
+		variants.push_back( { "01", uint32_t( 1000 + variant/2 ), { "A", ( variant % 2 ) ? "C" : "G" }, variant } ) ;
+	}
+	write_test_file( filename, 3, variants ) ;
+
+	typedef genfile::bgen::IndexQuery::VariantPosition VariantPosition ;
+	auto get_rsids = [&]( genfile::bgen::IndexQuery::UniquePtr query ) {
+		query->initialise() ;
+		genfile::bgen::View view( filename ) ;
+		view.set_query( std::move( query )) ;
+		std::vector< std::string > result ;
+		std::string SNPID, rsid, chromosome ;
+		uint32_t position ;
+		std::vector< std::string > alleles ;
+		while( view.read_variant( &SNPID, &rsid, &chromosome, &position, &alleles )) {
+			result.push_back( rsid ) ;
+			view.ignore_genotype_data_block() ;
+		}
+		std::sort( result.begin(), result.end() ) ;
+		return result ;
+	} ;
+
+	{
+		genfile::bgen::IndexQuery::UniquePtr query = genfile::bgen::IndexQuery::create( index_filename ) ;
+		query->include_positions( {
+			VariantPosition( "01", 1001 ),
+			VariantPosition( "01", 1003, "A", "C" ),
+			VariantPosition( "01", 1005, "A", "T" ),
+			// Matches both with and without alleles, and duplicated.
+			VariantPosition( "01", 1007 ),
+			VariantPosition( "01", 1007, "A", "G" ),
+			VariantPosition( "01", 1007, "A", "G" ),
+			VariantPosition( "02", 1009 ),
+			VariantPosition( "01", 2000 )
+		} ) ;
+		REQUIRE( get_rsids( std::move( query )) == std::vector< std::string >{ "rs14", "rs15", "rs2", "rs3", "rs7" } ) ;
+	}
+
+	// Positions combine with other inclusions and with exclusions.
+	{
+		genfile::bgen::IndexQuery::UniquePtr query = genfile::bgen::IndexQuery::create( index_filename ) ;
+		query->include_positions( { VariantPosition( "01", 1001 ), VariantPosition( "01", 1002 ) } ) ;
+		query->include_rsids( { "rs19" } ) ;
+		query->exclude_rsids( { "rs4" } ) ;
+		REQUIRE( get_rsids( std::move( query )) == std::vector< std::string >{ "rs19", "rs2", "rs3", "rs5" } ) ;
+	}
+
+	REQUIRE_THROWS_AS( VariantPosition( "01", 1000, "", "G" ), std::invalid_argument ) ;
+	remove_test_file( filename ) ;
+}
+
+TEST_CASE( "Test that CatalogIndexQuery locates variants across several files", "[bgen][index]" ) {
+	std::string const catalog_filename = temp_filename( "genfile_test_catalog.bgc" ) ;
+	std::filesystem::remove( catalog_filename ) ;
+	std::filesystem::remove( catalog_filename + ".tmp" ) ;
+
+	// File f holds variants 10*f, ..., 10*f+9 on chromosome "0<f+1>", at positions 1000 + variant.
+	std::size_t const number_of_files = 3 ;
+	genfile::bgen::Context context ;
+	context.number_of_samples = 4 ;
+	context.flags = TestFileOptions().flags ;
+	std::vector< std::string > filenames ;
+	{
+		genfile::bgen::CatalogWriter catalog_writer( catalog_filename ) ;
+		for( std::size_t f = 0; f < number_of_files; ++f ) {
+			filenames.push_back( temp_filename( "genfile_test_catalog_" + std::to_string( f ) + ".bgen" )) ;
+			std::string const chromosome = "0" + std::to_string( f + 1 ) ;
+			std::vector< TestVariant > variants ;
+			for( std::size_t variant = 10*f; variant < 10*(f+1); ++variant ) {
+				variants.push_back( { chromosome, uint32_t( 1000 + variant ), { "A", "G" }, variant } ) ;
+			}
+			genfile::bgen::Writer::FileMetadata const metadata = write_test_file(
+				filenames.back(), context.number_of_samples, variants
+			) ;
+			REQUIRE( catalog_writer.add_file( filenames.back(), filenames.back() + ".bgi", metadata ) == 10 ) ;
+		}
+		REQUIRE_THROWS_AS(
+			catalog_writer.add_file( filenames[0], filenames[1] + ".bgi", genfile::bgen::View( filenames[0] ).file_metadata() ),
+			std::invalid_argument
+		) ;
+		catalog_writer.finalise() ;
+	}
+
+	genfile::bgen::CatalogIndexQuery query( catalog_filename ) ;
+	REQUIRE( query.number_of_files() == number_of_files ) ;
+	for( std::size_t f = 0; f < number_of_files; ++f ) {
+		REQUIRE( std::filesystem::equivalent( query.filename( f ), filenames[f] )) ;
+		REQUIRE( query.file_metadata( f ).first_bytes == genfile::bgen::View( filenames[f] ).file_metadata().first_bytes ) ;
+	}
+	// Select variants from the last and first files; these are reported grouped by file.
+	query.include_rsids( { "rs3", "rs25", "rs1", "rs22" } ) ;
+	query.include_range( genfile::bgen::IndexQuery::GenomicRange( "01", 1008, 1020 )) ;
+	query.initialise() ;
+	REQUIRE( query.number_of_variants() == 6 ) ;
+
+	// Copy the selected variants into a new file, and check they read back correctly.
+	std::string const output_filename = temp_filename( "genfile_test_catalog_output.bgen" ) ;
+	{
+		genfile::bgen::Writer writer( output_filename, context ) ;
+		std::vector< genfile::byte_t > buffer ;
+		std::vector< std::size_t > expected_files = { 0, 0, 0, 0, 2, 2 } ;
+		for( std::size_t i = 0; i < query.number_of_variants(); ++i ) {
+			REQUIRE( query.locate_file( i ) == expected_files[i] ) ;
+			genfile::bgen::IndexQuery::FileRange const range = query.locate_variant( i ) ;
+			std::ifstream stream( query.filename( query.locate_file( i )), std::ios::binary ) ;
+			buffer.resize( range.second ) ;
+			stream.seekg( range.first ) ;
+			stream.read( reinterpret_cast< char* >( buffer.data() ), range.second ) ;
+			REQUIRE( stream ) ;
+			writer.write_encoded_variant( buffer.data(), buffer.data() + buffer.size() ) ;
+		}
+		writer.finalise() ;
+	}
+	{
+		genfile::bgen::View view( output_filename ) ;
+		REQUIRE( view.number_of_variants() == 6 ) ;
+		std::string SNPID, rsid, chromosome ;
+		uint32_t position ;
+		std::vector< std::string > alleles ;
+		std::vector< double > dosages ;
+		DosageSetter setter( &dosages ) ;
+		for( std::size_t const variant: { 1, 3, 8, 9, 22, 25 } ) {
+			REQUIRE( view.read_variant( &SNPID, &rsid, &chromosome, &position, &alleles )) ;
+			REQUIRE( rsid == "rs" + std::to_string( variant )) ;
+			REQUIRE( position == 1000 + variant ) ;
+			view.read_genotype_data_block( setter ) ;
+			for( std::size_t i = 0; i < context.number_of_samples; ++i ) {
+				REQUIRE( dosages[i] == Approx( expected_dosage( i, variant ))) ;
+			}
+		}
+		REQUIRE( !view.read_variant( &SNPID, &rsid, &chromosome, &position, &alleles )) ;
+	}
+
+	REQUIRE_THROWS_AS( genfile::bgen::CatalogIndexQuery( filenames[0] + ".bgi" ), std::invalid_argument ) ;
+	std::filesystem::remove( output_filename ) ;
+	std::filesystem::remove( catalog_filename ) ;
+	for( std::size_t f = 0; f < number_of_files; ++f ) {
+		remove_test_file( filenames[f] ) ;
+	}
+}
+
+TEST_CASE( "Test that content hashes of genotype data blocks can be recorded in the index", "[bgen][hash]" ) {
+	// Reference values of XXH64 with seed 0.
+	std::string const text = "Nobody inspects the spammish repetition" ;
+	genfile::byte_t const* const data = reinterpret_cast< genfile::byte_t const* >( text.data() ) ;
+	REQUIRE( genfile::xxh64( data, data ) == 0xEF46DB3751D8E999ULL ) ;
+	genfile::byte_t const a = 'a' ;
+	REQUIRE( genfile::xxh64( &a, &a + 1 ) == 0xD24EC4F1A98C6E5BULL ) ;
+	REQUIRE( genfile::xxh64( data, data + text.size() ) == 0xFBCEA83C8A378BF1ULL ) ;
+
+	std::string const filename = temp_filename( "genfile_test_hashes.bgen" ) ;
+	std::string const index_filename = filename + ".bgi" ;
+	// The genotypes encoded for a variant id repeat with period 15, so variant k below has
+	// the same data as variants k +/- 4.
+	std::vector< TestVariant > variants ;
+	for( std::size_t const id: { 0, 1, 2, 3, 15, 16, 17, 18, 30, 31, 32, 33 } ) {
+		variants.push_back( { "01", uint32_t( 1000 + variants.size() ), { "A", "G" }, id } ) ;
+	}
+	std::size_t const number_of_variants = variants.size() ;
+	TestFileOptions options ;
+	options.flags = genfile::bgen::e_Layout2 | genfile::bgen::e_ZstdCompression ;
+	options.with_hashes = true ;
+	write_test_file( filename, 7, variants, options ) ;
+
+	genfile::bgen::View view( filename ) ;
+	db::Connection::UniquePtr connection = db::Connection::create( index_filename, "r" ) ;
+	db::Connection::StatementPtr stmt = connection->get_statement( "SELECT content_hash FROM Variant ORDER BY file_start_position" ) ;
+	std::vector< uint64_t > hashes ;
+	std::string SNPID, rsid, chromosome ;
+	uint32_t position ;
+	std::vector< std::string > alleles ;
+	std::vector< genfile::byte_t > block ;
+	while( view.read_variant( &SNPID, &rsid, &chromosome, &position, &alleles )) {
+		view.read_raw_genotype_data_block( &block ) ;
+		REQUIRE( stmt->step() ) ;
+		hashes.push_back( uint64_t( stmt->get< int64_t >( 0 ))) ;
+		REQUIRE( hashes.back() == genfile::bgen::content_hash( &block[0], &block[0] + block.size() )) ;
+	}
+	REQUIRE( !stmt->step() ) ;
+	REQUIRE( hashes.size() == number_of_variants ) ;
+	for( std::size_t i = 0; i < number_of_variants; ++i ) {
+		for( std::size_t j = 0; j < number_of_variants; ++j ) {
+			REQUIRE( ( hashes[i] == hashes[j] ) == ( i % 4 == j % 4 )) ;
+		}
+	}
+
+	// A hash must be given if, and only if, the index records hashes.
+	genfile::bgen::IndexQuery::FileRange const range( 100, 50 ) ;
+	{
+		genfile::bgen::IndexWriter writer( index_filename + ".hashes", false, true ) ;
+		REQUIRE_THROWS_AS( writer.add_variant( "01", 1000, "rs1", { "A", "G" }, range ), std::invalid_argument ) ;
+		REQUIRE_NOTHROW( writer.add_variant( "01", 1000, "rs1", { "A", "G" }, range, uint64_t( 1 ) )) ;
+	}
+	{
+		genfile::bgen::IndexWriter writer( index_filename + ".nohashes" ) ;
+		REQUIRE_THROWS_AS( writer.add_variant( "01", 1000, "rs1", { "A", "G" }, range, uint64_t( 1 ) ), std::invalid_argument ) ;
+		REQUIRE_NOTHROW( writer.add_variant( "01", 1000, "rs1", { "A", "G" }, range )) ;
+	}
+	remove_test_file( filename ) ;
+}
+
+TEST_CASE( "Test that file metadata without first bytes can be recorded in indexes and catalogs", "[bgen][index]" ) {
+	// E.g. metadata of files written to a stream that could not be read back.
+	std::string const filename = temp_filename( "genfile_test_empty_metadata.bgen" ) ;
+	std::string const catalog_filename = temp_filename( "genfile_test_empty_metadata.bgc" ) ;
+	genfile::bgen::IndexWriter::FileMetadata metadata ;
+	metadata.filename = filename ;
+	metadata.size = 1234 ;
+	metadata.last_write_time = 0 ;
+	{
+		genfile::bgen::IndexWriter writer( filename + ".bgi" ) ;
+		writer.add_variant( "01", 1000, "rs1", { "A", "G" }, genfile::bgen::IndexQuery::FileRange( 100, 50 )) ;
+		writer.finalise( metadata ) ;
+	}
+	{
+		genfile::bgen::SqliteIndexQuery const query( filename + ".bgi" ) ;
+		REQUIRE( query.file_metadata() ) ;
+		REQUIRE( query.file_metadata()->size == 1234 ) ;
+		REQUIRE( query.file_metadata()->first_bytes.empty() ) ;
+	}
+	{
+		genfile::bgen::CatalogWriter writer( catalog_filename ) ;
+		REQUIRE( writer.add_file( filename, filename + ".bgi", metadata ) == 1 ) ;
+		writer.finalise() ;
+	}
+	{
+		genfile::bgen::CatalogIndexQuery const query( catalog_filename ) ;
+		REQUIRE( query.number_of_files() == 1 ) ;
+		REQUIRE( query.file_metadata( 0 ).size == 1234 ) ;
+		REQUIRE( query.file_metadata( 0 ).first_bytes.empty() ) ;
+	}
+	std::filesystem::remove( catalog_filename ) ;
+	remove_test_file( filename ) ;
+}
+
+TEST_CASE( "Test that ranges, positions and lists of identifiers are parsed", "[bgen][index]" ) {
+	using genfile::bgen::parse_range ;
+	using genfile::bgen::parse_position ;
+	{
+		genfile::bgen::IndexQuery::GenomicRange const range = parse_range( "chr1:100-200" ) ;
+		REQUIRE( range.chromosome() == "chr1" ) ;
+		REQUIRE( range.start() == 100 ) ;
+		REQUIRE( range.end() == 200 ) ;
+	}
+	REQUIRE( parse_range( "01:-200" ).start() == 0 ) ;
+	REQUIRE( parse_range( "01:-200" ).end() == 200 ) ;
+	REQUIRE( parse_range( "01:100-" ).end() == 4294967295u ) ;
+	REQUIRE( parse_range( "01:-" ).end() == 4294967295u ) ;
+	REQUIRE( parse_range( "01:4294967295-4294967295" ).start() == 4294967295u ) ;
+	// Chromosome names may contain dashes.
+	REQUIRE( parse_range( "HLA-A:5-6" ).chromosome() == "HLA-A" ) ;
+	for( std::string const spec: { "", "01", "01:100", ":100-200", "01:a-200", "01:100-2x", "01:+1-2", "01:200-100", "01:4294967296-", "01:1-2-3" } ) {
+		CAPTURE( spec ) ;
+		REQUIRE_THROWS_AS( parse_range( spec ), std::invalid_argument ) ;
+	}
+
+	REQUIRE( parse_position( "01:1000" ) == genfile::bgen::IndexQuery::VariantPosition( "01", 1000 )) ;
+	REQUIRE( parse_position( "01:1000:A:GT" ) == genfile::bgen::IndexQuery::VariantPosition( "01", 1000, "A", "GT" )) ;
+	REQUIRE( !parse_position( "01:1000" ).has_alleles() ) ;
+	for( std::string const spec: { "", "01", ":1000", "01:", "01:10a", "01:-5", "01:1000:A", "01:1000:A:", "01:1000::G", "01:1:A:G:T", "01:4294967296" } ) {
+		CAPTURE( spec ) ;
+		REQUIRE_THROWS_AS( parse_position( spec ), std::invalid_argument ) ;
+	}
+
+	// Arguments naming files are replaced by the identifiers in the file.
+	std::string const filename = temp_filename( "genfile_test_ids.txt" ) ;
+	{
+		std::ofstream out( filename ) ;
+		out << "rs3 rs1\n\trs2\n\nrs1\n" ;
+	}
+	REQUIRE(
+		genfile::bgen::collect_unique_ids( { "rs5", filename, "rs2" } )
+		== std::vector< std::string >({ "rs1", "rs2", "rs3", "rs5" })
+	) ;
+	REQUIRE( genfile::bgen::collect_unique_ids( {} ).empty() ) ;
+	std::filesystem::remove( filename ) ;
+}
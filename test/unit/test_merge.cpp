@@ -0,0 +1,89 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <vector>
+#include <string>
+#include "stdint.h"
+#include "catch2/catch.hpp"
+#include "genfile/bgen.hpp"
+#include "genfile/Writer.hpp"
+#include "genfile/View.hpp"
+#include "genfile/merge.hpp"
+#include "genfile/types.hpp"
+#include "test_files.hpp"
+
+TEST_CASE( "Test that merge_samples() combines blocks with different samples", "[bgen][merge]" ) {
+	std::string const filename = temp_filename( "genfile_test_merge.bgen" ) ;
+	std::size_t const number_of_variants = 10 ;
+	// Each pair gives the number of bits in the two input blocks, and the number of bits in the output.
+	// The first two cases are copied bitwise (including one which is not byte-aligned); the last is re-encoded.
+	std::vector< std::vector< int > > const bits = { { 8, 8, 8 }, { 3, 3, 3 }, { 3, 8, 8 } } ;
+
+	for( uint32_t compression = 0; compression < 3; ++compression ) {
+		for( std::vector< int > const& b: bits ) {
+			// Block A holds samples 0-2 and block B samples 3-7; encoding B at variant+3 makes
+			// the genotype of every sample j in the merged data depend on (j+variant) as usual.
+			genfile::bgen::Context contextA, contextB, context ;
+			contextA.number_of_samples = 3 ;
+			contextB.number_of_samples = 5 ;
+			context.number_of_samples = 8 ;
+			contextA.flags = contextB.flags = context.flags = genfile::bgen::e_Layout2 | compression ;
+			{
+				genfile::bgen::Writer writer( filename, context ) ;
+				std::vector< genfile::byte_t > bufferA, bufferB, merged, result ;
+				for( std::size_t variant = 0; variant < number_of_variants; ++variant ) {
+					std::vector< genfile::byte_t > const dataA = encode_variant( contextA, variant, b[0] ) ;
+					std::vector< genfile::byte_t > const dataB = encode_variant( contextB, variant + 3, b[1] ) ;
+					// Skip the leading four-byte block size.
+					genfile::bgen::uncompress_probability_data( contextA, std::vector< genfile::byte_t >( dataA.begin() + 4, dataA.end() ), &bufferA ) ;
+					genfile::bgen::uncompress_probability_data( contextB, std::vector< genfile::byte_t >( dataB.begin() + 4, dataB.end() ), &bufferB ) ;
+					genfile::bgen::v12::GenotypeDataBlock const blockA( contextA, bufferA.data(), bufferA.data() + bufferA.size() ) ;
+					genfile::bgen::v12::GenotypeDataBlock const blockB( contextB, bufferB.data(), bufferB.data() + bufferB.size() ) ;
+					genfile::bgen::v12::merge_samples( { &blockA, &blockB }, b[2], &merged ) ;
+					std::pair< genfile::byte_t const*, genfile::byte_t const* > const data = genfile::bgen::compress_probability_data(
+						context, merged.data(), merged.data() + merged.size(), &result
+					) ;
+					writer.write_variant(
+						"SNP" + std::to_string( variant ), "rs" + std::to_string( variant ), "01", 1000 + variant, { "A", "G" },
+						data.first, data.second
+					) ;
+				}
+				writer.finalise() ;
+			}
+
+			genfile::bgen::View view( filename ) ;
+			REQUIRE( view.number_of_variants() == number_of_variants ) ;
+			std::string SNPID, rsid, chromosome ;
+			uint32_t position ;
+			std::vector< std::string > alleles ;
+			std::vector< double > dosages ;
+			DosageSetter setter( &dosages ) ;
+			for( std::size_t variant = 0; variant < number_of_variants; ++variant ) {
+				REQUIRE( view.read_variant( &SNPID, &rsid, &chromosome, &position, &alleles )) ;
+				view.read_genotype_data_block( setter ) ;
+				REQUIRE( dosages.size() == context.number_of_samples ) ;
+				for( std::size_t i = 0; i < context.number_of_samples; ++i ) {
+					REQUIRE( dosages[i] == Approx( expected_dosage( i, variant ))) ;
+				}
+			}
+		}
+	}
+
+	// Blocks with different numbers of alleles cannot be merged.
+	{
+		genfile::bgen::Context context ;
+		context.number_of_samples = 2 ;
+		context.flags = genfile::bgen::e_Layout2 ;
+		std::vector< genfile::byte_t > data = encode_variant( context, 0 ) ;
+		std::vector< genfile::byte_t > buffer( data.begin() + 4, data.end() ), buffer2 = buffer, merged ;
+		// Set the number of alleles of the second block to 3.
+		buffer2[4] = 3 ;
+		genfile::bgen::v12::GenotypeDataBlock const block( context, buffer.data(), buffer.data() + buffer.size() ) ;
+		genfile::bgen::v12::GenotypeDataBlock const block2( context, buffer2.data(), buffer2.data() + buffer2.size() ) ;
+		REQUIRE_THROWS_AS( genfile::bgen::v12::merge_samples( { &block, &block2 }, 8, &merged ), std::invalid_argument ) ;
+	}
+	remove_test_file( filename ) ;
+}
@@ -0,0 +1,159 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include "stdint.h"
+#include "catch2/catch.hpp"
+#include "genfile/bgen.hpp"
+#include "genfile/View.hpp"
+#include "genfile/Buffer.hpp"
+#include "genfile/SampleOrder.hpp"
+#include "genfile/types.hpp"
+#include "test_files.hpp"
+
+TEST_CASE( "Test that samples can be put in a new order when reading and by reorder_samples()", "[bgen][order]" ) {
+	std::size_t const number_of_samples = 11 ;
+	std::size_t const absent = genfile::bgen::SampleOrder::absent ;
+	genfile::bgen::SampleOrder const order( number_of_samples, { 10, absent, 3, 0, 7, 1, absent, 4 } ) ;
+	REQUIRE( order.size() == 8 ) ;
+	REQUIRE( order.number_of_absent_samples() == 2 ) ;
+	REQUIRE( order.output_index( 7 ) == 4 ) ;
+	REQUIRE( order.output_index( 2 ) == absent ) ;
+	REQUIRE_THROWS_AS( genfile::bgen::SampleOrder( number_of_samples, { 1, 2, 1 } ), std::invalid_argument ) ;
+	REQUIRE_THROWS_AS( genfile::bgen::SampleOrder( number_of_samples, { 11 } ), std::invalid_argument ) ;
+
+	std::vector< std::string > sample_ids ;
+	for( std::size_t i = 0; i < number_of_samples; ++i ) {
+		sample_ids.push_back( "sample_" + std::to_string( i )) ;
+	}
+	{
+		genfile::bgen::SampleOrder const matched = genfile::bgen::SampleOrder::match( sample_ids, { "sample_5", "other", "sample_0" } ) ;
+		REQUIRE( matched.size() == 3 ) ;
+		REQUIRE( matched[0] == 5 ) ;
+		REQUIRE( matched[1] == absent ) ;
+		REQUIRE( matched[2] == 0 ) ;
+		REQUIRE_THROWS_AS( genfile::bgen::SampleOrder::match( sample_ids, { "sample_5", "sample_5" } ), std::invalid_argument ) ;
+	}
+
+	SECTION( "reorder_samples() copies data exactly" ) {
+		for( uint32_t layout = 1; layout <= 2; ++layout ) {
+			genfile::bgen::Context context ;
+			context.number_of_samples = number_of_samples ;
+			context.flags = ( layout == 1 ) ? genfile::bgen::e_Layout1 : genfile::bgen::e_Layout2 ;
+			genfile::bgen::Context output_context = context ;
+			output_context.number_of_samples = order.size() ;
+			// Missing data is stored as zero probabilities in layout 1.
+			double const missing = ( layout == 1 ) ? 0.0 : -1.0 ;
+			for( int bits = 1; bits <= (( layout == 1 ) ? 1 : 16 ); ++bits ) {
+				// Blocks written in layout 2 start with their length, which is not part of the probability data.
+				std::vector< genfile::byte_t > const encoded = encode_variant( context, 3, bits ) ;
+				std::vector< genfile::byte_t > const block( encoded.begin() + (( layout == 1 ) ? 0 : 4 ), encoded.end() ) ;
+				genfile::Buffer uncompressed, reordered ;
+				genfile::bgen::uncompress_probability_data( context, block, &uncompressed ) ;
+				genfile::bgen::reorder_samples( context, &uncompressed[0], &uncompressed[0] + uncompressed.size(), order, &reordered ) ;
+
+				std::vector< double > expected, result ;
+				DosageSetter expected_setter( &expected ), setter( &result ) ;
+				genfile::bgen::parse_probability_data( &uncompressed[0], &uncompressed[0] + uncompressed.size(), context, expected_setter ) ;
+				genfile::bgen::parse_probability_data( &reordered[0], &reordered[0] + reordered.size(), output_context, setter ) ;
+				REQUIRE( result.size() == order.size() ) ;
+				for( std::size_t j = 0; j < order.size(); ++j ) {
+					REQUIRE( result[j] == (( order[j] == absent ) ? missing : expected[ order[j] ] )) ;
+				}
+			}
+		}
+
+		// Samples of mixed ploidy, and phased data, have data that is not byte-aligned.
+		for( int phased = 0; phased < 2; ++phased ) {
+			genfile::bgen::Context context ;
+			context.number_of_samples = number_of_samples ;
+			context.flags = genfile::bgen::e_Layout2 ;
+			genfile::bgen::Context output_context = context ;
+			output_context.number_of_samples = order.size() ;
+			std::vector< genfile::byte_t > buffer1, buffer2 ;
+			genfile::bgen::GenotypeDataBlockWriter writer( &buffer1, &buffer2, context, 5 ) ;
+			writer.initialise( number_of_samples, 2, 3 ) ;
+			for( std::size_t i = 0; i < number_of_samples; ++i ) {
+				uint32_t const ploidy = 1 + ( i % 3 ) ;
+				uint32_t const number_of_entries = phased ? ( 2 * ploidy ) : ( ploidy + 1 ) ;
+				writer.set_sample( i ) ;
+				writer.set_number_of_entries( ploidy, number_of_entries, phased ? genfile::ePerPhasedHaplotypePerAllele : genfile::ePerUnorderedGenotype, genfile::eProbability ) ;
+				for( uint32_t k = 0; k < number_of_entries; ++k ) {
+					if( i == 4 ) {
+						writer.set_value( k, genfile::MissingValue() ) ;
+					} else if( phased ) {
+						writer.set_value( k, ( ( k / 2 + i ) % 2 == k % 2 ) ? 1.0 : 0.0 ) ;
+					} else {
+						writer.set_value( k, ( i % number_of_entries == k ) ? 1.0 : 0.0 ) ;
+					}
+				}
+			}
+			writer.finalise() ;
+			std::vector< genfile::byte_t > const block( writer.repr().first + 4, writer.repr().second ) ;
+			genfile::Buffer uncompressed, reordered ;
+			genfile::bgen::uncompress_probability_data( context, block, &uncompressed ) ;
+			genfile::bgen::reorder_samples( context, &uncompressed[0], &uncompressed[0] + uncompressed.size(), order, &reordered ) ;
+			genfile::bgen::v12::GenotypeDataBlock const pack( output_context, &reordered[0], &reordered[0] + reordered.size() ) ;
+			REQUIRE( pack.ploidyExtent[0] == 1 ) ;
+			REQUIRE( pack.ploidyExtent[1] == 3 ) ;
+
+			std::vector< double > expected, result ;
+			DosageSetter expected_setter( &expected ), setter( &result ) ;
+			genfile::bgen::parse_probability_data( &uncompressed[0], &uncompressed[0] + uncompressed.size(), context, expected_setter ) ;
+			genfile::bgen::parse_probability_data( &reordered[0], &reordered[0] + reordered.size(), output_context, setter ) ;
+			for( std::size_t j = 0; j < order.size(); ++j ) {
+				REQUIRE( result[j] == (( order[j] == absent ) ? -1.0 : expected[ order[j] ] )) ;
+			}
+		}
+	}
+
+	SECTION( "View reports samples in the sample order" ) {
+		std::string const filename = temp_filename( "genfile_test_sample_order.bgen" ) ;
+		std::size_t const number_of_variants = 4 ;
+		TestFileOptions options ;
+		options.flags = genfile::bgen::e_Layout2 | genfile::bgen::e_ZstdCompression ;
+		options.sample_ids = sample_ids ;
+		options.write_index = false ;
+		write_test_file( filename, number_of_samples, consecutive_variants( number_of_variants ), options ) ;
+
+		genfile::bgen::View view( filename ) ;
+		REQUIRE_THROWS_AS( view.set_sample_order( genfile::bgen::SampleOrder( 3, { 0, 1 } )), std::invalid_argument ) ;
+		view.set_sample_order( order ) ;
+		REQUIRE( view.sample_order()->size() == order.size() ) ;
+		std::string SNPID, rsid, chromosome ;
+		uint32_t position ;
+		std::vector< std::string > alleles ;
+		for( std::size_t variant = 0; variant < number_of_variants; ++variant ) {
+			REQUIRE( view.read_variant( &SNPID, &rsid, &chromosome, &position, &alleles )) ;
+			std::vector< double > dosages ;
+			std::vector< float > float_dosages ;
+			if( variant % 2 == 0 ) {
+				DosageSetter setter( &dosages ) ;
+				view.read_genotype_data_block( setter ) ;
+			} else {
+				view.read_dosage_data_block( &float_dosages ) ;
+				REQUIRE( float_dosages.size() == order.size() ) ;
+			}
+			for( std::size_t j = 0; j < order.size(); ++j ) {
+				std::size_t const i = order[j] ;
+				double const expected = ( i == absent ) ? -1.0 : expected_dosage( i, variant ) ;
+				if( variant % 2 == 0 ) {
+					// The setter receives no data for absent samples.
+					REQUIRE( dosages[j] == Approx(( i == absent ) ? 0.0 : expected )) ;
+				} else if( expected == -1.0 ) {
+					REQUIRE( float_dosages[j] != float_dosages[j] ) ;
+				} else {
+					REQUIRE( float_dosages[j] == Approx( expected )) ;
+				}
+			}
+		}
+		view.clear_sample_order() ;
+		REQUIRE( view.sample_order() == 0 ) ;
+		remove_test_file( filename ) ;
+	}
+}
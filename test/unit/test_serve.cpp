@@ -0,0 +1,204 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <optional>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "catch2/catch.hpp"
+#include "serve/http.hpp"
+#include "serve/VariantCache.hpp"
+
+namespace {
+	// Send the request over a socket pair and read it back with read_request().
+	// The sending end is closed first, so that incomplete requests are seen as such.
+	bool read_request_from_string(
+		std::string const& data,
+		serve::HttpRequest* request,
+		std::size_t max_header_size = 1024,
+		std::size_t max_body_size = 1024
+	) {
+		int sockets[2] ;
+		REQUIRE( ::socketpair( AF_UNIX, SOCK_STREAM, 0, sockets ) == 0 ) ;
+		REQUIRE( ::write( sockets[0], data.data(), data.size() ) == ssize_t( data.size() )) ;
+		::close( sockets[0] ) ;
+		try {
+			bool const result = serve::read_request( sockets[1], request, max_header_size, max_body_size ) ;
+			::close( sockets[1] ) ;
+			return result ;
+		} catch( ... ) {
+			::close( sockets[1] ) ;
+			throw ;
+		}
+	}
+
+	int error_status( std::string const& data, std::size_t max_header_size = 1024, std::size_t max_body_size = 1024 ) {
+		serve::HttpRequest request ;
+		try {
+			read_request_from_string( data, &request, max_header_size, max_body_size ) ;
+		} catch( serve::HttpError const& e ) {
+			return e.status() ;
+		}
+		return 0 ;
+	}
+
+	serve::VariantCache::Value make_variant( std::size_t data_size ) {
+		std::shared_ptr< serve::CachedVariant > result( new serve::CachedVariant ) ;
+		result->rsid = "rs1" ;
+		result->chromosome = "01" ;
+		result->position = 1000 ;
+		result->alleles = { "A", "G" } ;
+		result->data.resize( data_size ) ;
+		return result ;
+	}
+}
+
+TEST_CASE( "Test that URL components are decoded", "[serve]" ) {
+	REQUIRE( serve::url_decode( "" ) == "" ) ;
+	REQUIRE( serve::url_decode( "rs1" ) == "rs1" ) ;
+	REQUIRE( serve::url_decode( "a+b" ) == "a b" ) ;
+	REQUIRE( serve::url_decode( "01%3A1000-2000%2c02" ) == "01:1000-2000,02" ) ;
+	REQUIRE( serve::url_decode( "%41%42" ) == "AB" ) ;
+	// Malformed escapes are left as they are.
+	REQUIRE( serve::url_decode( "%" ) == "%" ) ;
+	REQUIRE( serve::url_decode( "%4" ) == "%4" ) ;
+	REQUIRE( serve::url_decode( "%zz" ) == "%zz" ) ;
+	REQUIRE( serve::url_decode( "100%" ) == "100%" ) ;
+}
+
+TEST_CASE( "Test that form-encoded parameters are parsed", "[serve]" ) {
+	std::map< std::string, std::string > parameters ;
+	serve::parse_parameters( "", &parameters ) ;
+	REQUIRE( parameters.empty() ) ;
+
+	serve::parse_parameters( "file=a.bgen&range=01%3A1-100&flag&samples=S1%2CS2&empty=", &parameters ) ;
+	REQUIRE( parameters == std::map< std::string, std::string >{
+		{ "file", "a.bgen" }, { "range", "01:1-100" }, { "flag", "" }, { "samples", "S1,S2" }, { "empty", "" }
+	}) ;
+
+	// Later values replace earlier ones.
+	serve::parse_parameters( "file=b.bgen&x=1=2", &parameters ) ;
+	REQUIRE( parameters[ "file" ] == "b.bgen" ) ;
+	REQUIRE( parameters[ "x" ] == "1=2" ) ;
+
+	REQUIRE( serve::split( "", ',' ).empty() ) ;
+	REQUIRE( serve::split( "a,,b,", ',' ) == std::vector< std::string >{ "a", "", "b", "" } ) ;
+}
+
+TEST_CASE( "Test that HTTP requests are read", "[serve]" ) {
+	serve::HttpRequest request ;
+
+	SECTION( "GET request" ) {
+		REQUIRE( read_request_from_string( "GET /variants?file=0&range=01%3A1-2 HTTP/1.1\r\nHost: localhost\r\n\r\n", &request )) ;
+		REQUIRE( request.method == "GET" ) ;
+		REQUIRE( request.path == "/variants" ) ;
+		REQUIRE( request.get( "file" ) == std::optional< std::string >( "0" )) ;
+		REQUIRE( request.get( "range" ) == std::optional< std::string >( "01:1-2" )) ;
+		REQUIRE( !request.get( "samples" )) ;
+	}
+
+	SECTION( "POST request" ) {
+		std::string const body = "samples=S1%2CS2&format=vcf" ;
+		REQUIRE( read_request_from_string(
+			"POST /variants?file=0 HTTP/1.1\r\ncontent-LENGTH: " + std::to_string( body.size() ) + "\r\n\r\n" + body,
+			&request
+		)) ;
+		REQUIRE( request.method == "POST" ) ;
+		REQUIRE( request.parameters == std::map< std::string, std::string >{
+			{ "file", "0" }, { "samples", "S1,S2" }, { "format", "vcf" }
+		}) ;
+	}
+
+	SECTION( "Body of a GET request is ignored" ) {
+		REQUIRE( read_request_from_string( "GET /files HTTP/1.1\r\nContent-Length: 5\r\n\r\nx=123", &request )) ;
+		REQUIRE( request.path == "/files" ) ;
+		REQUIRE( request.parameters.empty() ) ;
+	}
+
+	SECTION( "Connection closed before a request" ) {
+		REQUIRE( !read_request_from_string( "", &request )) ;
+	}
+
+	SECTION( "Malformed requests" ) {
+		REQUIRE( error_status( "GET /files HTTP/1.1\r\nHost: local" ) == 400 ) ;
+		REQUIRE( error_status( "GET /files\r\n\r\n" ) == 400 ) ;
+		REQUIRE( error_status( "\r\n\r\n" ) == 400 ) ;
+		REQUIRE( error_status( "POST /variants HTTP/1.1\r\nContent-Length: ten\r\n\r\n" ) == 400 ) ;
+		REQUIRE( error_status( "POST /variants HTTP/1.1\r\nContent-Length: 10x\r\n\r\n0123456789" ) == 400 ) ;
+		REQUIRE( error_status( "POST /variants HTTP/1.1\r\nContent-Length: -1\r\n\r\n" ) == 400 ) ;
+		// The body is shorter than the Content-Length.
+		REQUIRE( error_status( "POST /variants HTTP/1.1\r\nContent-Length: 10\r\n\r\nsamples=" ) == 400 ) ;
+	}
+
+	SECTION( "Size limits" ) {
+		std::string const request_line = "GET /files HTTP/1.1\r\n" ;
+		std::string const padding = "X-Padding: " + std::string( 1000, 'x' ) + "\r\n" ;
+		REQUIRE( error_status( request_line + padding + "\r\n", 2048 ) == 0 ) ;
+		REQUIRE( error_status( request_line + padding + "\r\n", 1024 ) == 400 ) ;
+		// Headers are rejected once the limit is exceeded, even if they never end.
+		REQUIRE( error_status( request_line + padding + padding, 1024 ) == 400 ) ;
+
+		std::string const body( 100, 'x' ) ;
+		REQUIRE( error_status( "POST / HTTP/1.1\r\nContent-Length: 100\r\n\r\n" + body, 1024, 100 ) == 0 ) ;
+		REQUIRE( error_status( "POST / HTTP/1.1\r\nContent-Length: 101\r\n\r\n" + body + "x", 1024, 100 ) == 413 ) ;
+		// Lengths are rejected without waiting for the body.
+		REQUIRE( error_status( "POST / HTTP/1.1\r\nContent-Length: 1000000000\r\n\r\n" ) == 413 ) ;
+		REQUIRE( error_status( "POST / HTTP/1.1\r\nContent-Length: 100000000000000000000000\r\n\r\n" ) == 413 ) ;
+	}
+}
+
+TEST_CASE( "Test that the variant cache evicts least recently used variants", "[serve]" ) {
+	serve::VariantCache::Value const v1 = make_variant( 100 ), v2 = make_variant( 200 ), v3 = make_variant( 300 ) ;
+	std::size_t const size = v1->memory_used() + v2->memory_used() + v3->memory_used() ;
+	REQUIRE( v2->memory_used() == v1->memory_used() + 100 ) ;
+	serve::VariantCache cache( size ) ;
+	serve::VariantCache::Key const k1( 0, 100 ), k2( 0, 200 ), k3( 1, 100 ), k4( 1, 200 ) ;
+
+	REQUIRE( !cache.find( k1 )) ;
+	cache.insert( k1, v1 ) ;
+	cache.insert( k2, v2 ) ;
+	cache.insert( k3, v3 ) ;
+	REQUIRE( cache.number_of_entries() == 3 ) ;
+	REQUIRE( cache.size() == size ) ;
+	REQUIRE( cache.find( k1 ) == v1 ) ;
+	REQUIRE( cache.find( k3 ) == v3 ) ;
+
+	// Inserting a duplicate key leaves the cache unchanged.
+	cache.insert( k1, v3 ) ;
+	REQUIRE( cache.find( k1 ) == v1 ) ;
+	REQUIRE( cache.size() == size ) ;
+
+	// k2 is least recently used, and is evicted to make room; k3 and k1 remain.
+	cache.insert( k4, make_variant( 150 )) ;
+	REQUIRE( !cache.find( k2 )) ;
+	REQUIRE( cache.find( k3 ) == v3 ) ;
+	REQUIRE( cache.find( k1 ) == v1 ) ;
+	REQUIRE( cache.find( k4 )->data.size() == 150 ) ;
+	REQUIRE( cache.number_of_entries() == 3 ) ;
+	REQUIRE( cache.size() == size - 50 ) ;
+
+	// Eviction continues until the new entry fits; k3 is now least recently used, then k1.
+	serve::VariantCache::Value const large = make_variant( 500 ) ;
+	cache.insert( k2, large ) ;
+	REQUIRE( !cache.find( k3 )) ;
+	REQUIRE( !cache.find( k1 )) ;
+	REQUIRE( cache.find( k2 ) == large ) ;
+	REQUIRE( cache.number_of_entries() == 2 ) ;
+	REQUIRE( cache.size() == large->memory_used() + cache.find( k4 )->memory_used() ) ;
+	REQUIRE( cache.summarise_as_json() ==
+		"{\"entries\": 2, \"bytes\": " + std::to_string( cache.size() ) + ", \"capacity_bytes\": " + std::to_string( size )
+		+ ", \"hits\": 8, \"misses\": 4}"
+	) ;
+
+	// Variants larger than the whole cache are not inserted, and evict nothing.
+	cache.insert( k1, make_variant( size )) ;
+	REQUIRE( !cache.find( k1 )) ;
+	REQUIRE( cache.number_of_entries() == 2 ) ;
+}
@@ -0,0 +1,320 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <filesystem>
+#include <chrono>
+#include <stdexcept>
+#include <cmath>
+#include "stdint.h"
+#include "catch2/catch.hpp"
+#include "genfile/bgen.hpp"
+#include "genfile/View.hpp"
+#include "genfile/DosageSidecar.hpp"
+#include "genfile/TransposedSidecar.hpp"
+#include "genfile/ThreadPool.hpp"
+#include "genfile/types.hpp"
+#include "test_files.hpp"
+
+namespace {
+	// Write a sidecar for all variants of the view, as cache-bgen does, returning the dosages written.
+	template< typename T >
+	std::vector< std::vector< T > > write_sidecar( genfile::bgen::View& view, std::string const& filename, genfile::bgen::DosageSidecar::ValueType type ) {
+		genfile::bgen::DosageSidecarWriter writer( filename, view.file_metadata(), view.number_of_samples(), type ) ;
+		std::string SNPID, rsid, chromosome ;
+		uint32_t position ;
+		std::vector< std::string > alleles ;
+		std::vector< std::vector< T > > result ;
+		std::streampos file_pos = view.current_file_position() ;
+		while( view.read_variant( &SNPID, &rsid, &chromosome, &position, &alleles )) {
+			result.push_back( std::vector< T >() ) ;
+			view.read_dosage_data_block( &result.back() ) ;
+			writer.write_row( file_pos, result.back().data() ) ;
+			file_pos = view.current_file_position() ;
+		}
+		writer.finalise() ;
+		return result ;
+	}
+
+	template< typename T >
+	std::vector< std::vector< T > > read_dosages( genfile::bgen::View& view ) {
+		std::string SNPID, rsid, chromosome ;
+		uint32_t position ;
+		std::vector< std::string > alleles ;
+		std::vector< std::vector< T > > result ;
+		while( view.read_variant( &SNPID, &rsid, &chromosome, &position, &alleles )) {
+			result.push_back( std::vector< T >() ) ;
+			view.read_dosage_data_block( &result.back() ) ;
+		}
+		return result ;
+	}
+}
+
+TEST_CASE( "Test that dosage sidecar rows can be written and read back", "[bgen][sidecar]" ) {
+	std::string const filename = temp_filename( "genfile_test_sidecar_rows.dosage" ) ;
+	genfile::bgen::DosageSidecar::FileMetadata metadata ;
+	metadata.size = 12345 ;
+	metadata.last_write_time = 678 ;
+	metadata.first_bytes = { 'b', 'g', 'e', 'n' } ;
+	// Sample counts are chosen to give rows shorter than, equal to and longer than the row alignment.
+	for( std::size_t const number_of_samples: { 1, 32, 64, 100 } ) {
+		std::vector< int64_t > const positions = { 20, 35, 100, 1000, 1001 } ;
+		std::vector< std::vector< uint8_t > > rows8 ;
+		std::vector< std::vector< genfile::float16_t > > rows16 ;
+		for( std::size_t i = 0; i < positions.size(); ++i ) {
+			rows8.push_back( std::vector< uint8_t >() ) ;
+			rows16.push_back( std::vector< genfile::float16_t >() ) ;
+			for( std::size_t j = 0; j < number_of_samples; ++j ) {
+				rows8.back().push_back( uint8_t( i * 31 + j )) ;
+				rows16.back().push_back( genfile::float16_t::from_bits( uint16_t( i * 1000 + j ))) ;
+			}
+		}
+
+		std::filesystem::remove( filename ) ;
+		{
+			genfile::bgen::DosageSidecarWriter writer( filename, metadata, number_of_samples, genfile::bgen::DosageSidecar::eUInt8 ) ;
+			for( std::size_t i = 0; i < positions.size(); ++i ) {
+				writer.write_row( positions[i], rows8[i].data() ) ;
+			}
+			// Readers do not see the sidecar until it is finalised.
+			REQUIRE( !std::filesystem::exists( filename )) ;
+			writer.finalise() ;
+		}
+		{
+			genfile::bgen::DosageSidecar::UniquePtr sidecar = genfile::bgen::DosageSidecar::open( filename ) ;
+			REQUIRE( sidecar->value_type() == genfile::bgen::DosageSidecar::eUInt8 ) ;
+			REQUIRE( sidecar->stores< uint8_t >() ) ;
+			REQUIRE( !sidecar->stores< genfile::float16_t >() ) ;
+			REQUIRE( sidecar->number_of_samples() == number_of_samples ) ;
+			REQUIRE( sidecar->number_of_variants() == positions.size() ) ;
+			REQUIRE( sidecar->matches( metadata )) ;
+			for( std::size_t i = 0; i < positions.size(); ++i ) {
+				REQUIRE( sidecar->find_variant( positions[i] ) == i ) ;
+				// Rows are aligned for direct access.
+				REQUIRE( reinterpret_cast< uintptr_t >( sidecar->row< uint8_t >( i )) % 64 == 0 ) ;
+				REQUIRE( std::vector< uint8_t >( sidecar->row< uint8_t >( i ), sidecar->row< uint8_t >( i ) + number_of_samples ) == rows8[i] ) ;
+			}
+			REQUIRE( sidecar->find_variant( 0 ) == genfile::bgen::DosageSidecar::npos ) ;
+			REQUIRE( sidecar->find_variant( 36 ) == genfile::bgen::DosageSidecar::npos ) ;
+			REQUIRE( sidecar->find_variant( 2000 ) == genfile::bgen::DosageSidecar::npos ) ;
+		}
+
+		{
+			genfile::bgen::DosageSidecarWriter writer( filename, metadata, number_of_samples, genfile::bgen::DosageSidecar::eFloat16 ) ;
+			for( std::size_t i = 0; i < positions.size(); ++i ) {
+				writer.write_row( positions[i], rows16[i].data() ) ;
+			}
+			writer.finalise() ;
+		}
+		{
+			genfile::bgen::DosageSidecar::UniquePtr sidecar = genfile::bgen::DosageSidecar::open( filename ) ;
+			REQUIRE( sidecar->stores< genfile::float16_t >() ) ;
+			for( std::size_t i = 0; i < positions.size(); ++i ) {
+				genfile::float16_t const* row = sidecar->row< genfile::float16_t >( i ) ;
+				for( std::size_t j = 0; j < number_of_samples; ++j ) {
+					REQUIRE( row[j].bits == rows16[i][j].bits ) ;
+				}
+			}
+		}
+	}
+
+	// Writers that are not finalised leave no files behind.
+	{
+		std::filesystem::remove( filename ) ;
+		genfile::bgen::DosageSidecarWriter writer( filename, metadata, 10, genfile::bgen::DosageSidecar::eUInt8 ) ;
+		std::vector< uint8_t > const row( 10, 1 ) ;
+		writer.write_row( 0, row.data() ) ;
+	}
+	REQUIRE( !std::filesystem::exists( filename )) ;
+	REQUIRE( !std::filesystem::exists( filename + ".tmp" )) ;
+
+	// Files that are not sidecars are rejected.
+	{
+		std::ofstream out( filename, std::ios::binary ) ;
+		out << std::string( 200, 'x' ) ;
+	}
+	REQUIRE_THROWS_AS( genfile::bgen::DosageSidecar::open( filename ), std::invalid_argument ) ;
+	std::filesystem::remove( filename ) ;
+	REQUIRE_THROWS_AS( genfile::bgen::DosageSidecar::open( filename ), std::invalid_argument ) ;
+}
+
+TEST_CASE( "Test that View reads dosages from a current sidecar and rejects stale ones", "[bgen][sidecar]" ) {
+	std::string const filename = temp_filename( "genfile_test_sidecar.bgen" ) ;
+	std::string const sidecar_filename = genfile::bgen::DosageSidecar::default_filename( filename ) ;
+	std::size_t const number_of_samples = 37 ;
+	std::filesystem::remove( sidecar_filename ) ;
+	write_test_file( filename, number_of_samples, consecutive_variants( 10 )) ;
+
+	std::vector< std::vector< uint8_t > > expected ;
+	{
+		genfile::bgen::View::UniquePtr view = genfile::bgen::View::create( filename ) ;
+		REQUIRE( view->dosage_sidecar() == 0 ) ;
+		expected = write_sidecar< uint8_t >( *view, sidecar_filename, genfile::bgen::DosageSidecar::eUInt8 ) ;
+		REQUIRE( expected.size() == 10 ) ;
+	}
+
+	// The sidecar holds the same values as are decoded from the file.
+	{
+		genfile::bgen::DosageSidecar::UniquePtr sidecar = genfile::bgen::DosageSidecar::open( sidecar_filename ) ;
+		for( std::size_t i = 0; i < expected.size(); ++i ) {
+			REQUIRE( std::vector< uint8_t >( sidecar->row< uint8_t >( i ), sidecar->row< uint8_t >( i ) + number_of_samples ) == expected[i] ) ;
+		}
+	}
+
+	// A current sidecar is picked up by default and gives the same results.
+	{
+		genfile::bgen::View::UniquePtr view = genfile::bgen::View::create( filename ) ;
+		REQUIRE( view->dosage_sidecar() != 0 ) ;
+		REQUIRE( read_dosages< uint8_t >( *view ) == expected ) ;
+		// Other types are decoded from the file.
+		view = genfile::bgen::View::create( filename ) ;
+		std::vector< std::vector< float > > const dosages = read_dosages< float >( *view ) ;
+		REQUIRE( dosages.size() == expected.size() ) ;
+	}
+
+	// A sidecar is stale once the bgen file's modification time changes...
+	std::filesystem::last_write_time( filename, std::filesystem::last_write_time( filename ) + std::chrono::hours( 1 )) ;
+	{
+		genfile::bgen::View::UniquePtr view = genfile::bgen::View::create( filename ) ;
+		REQUIRE( view->dosage_sidecar() == 0 ) ;
+		REQUIRE_THROWS_AS( view->use_dosage_sidecar( sidecar_filename ), std::invalid_argument ) ;
+		REQUIRE( view->dosage_sidecar() == 0 ) ;
+	}
+
+	// ...or the file is rewritten with different contents.
+	{
+		genfile::bgen::View::UniquePtr view = genfile::bgen::View::create( filename ) ;
+		write_sidecar< uint8_t >( *view, sidecar_filename, genfile::bgen::DosageSidecar::eUInt8 ) ;
+	}
+	{
+		genfile::bgen::View::UniquePtr view = genfile::bgen::View::create( filename ) ;
+		REQUIRE( view->dosage_sidecar() != 0 ) ;
+		view->clear_dosage_sidecar() ;
+		REQUIRE( view->dosage_sidecar() == 0 ) ;
+	}
+	write_test_file( filename, number_of_samples, consecutive_variants( 11 )) ;
+	{
+		genfile::bgen::View::UniquePtr view = genfile::bgen::View::create( filename ) ;
+		REQUIRE( view->dosage_sidecar() == 0 ) ;
+		REQUIRE_THROWS_AS( view->use_dosage_sidecar( sidecar_filename ), std::invalid_argument ) ;
+		REQUIRE( read_dosages< uint8_t >( *view ).size() == 11 ) ;
+	}
+
+	// Sidecars with matching metadata but a different number of samples are rejected.
+	{
+		genfile::bgen::View::UniquePtr view = genfile::bgen::View::create( filename ) ;
+		genfile::bgen::DosageSidecarWriter writer( sidecar_filename, view->file_metadata(), number_of_samples + 1, genfile::bgen::DosageSidecar::eUInt8 ) ;
+		writer.finalise() ;
+		REQUIRE_THROWS_AS( view->use_dosage_sidecar( sidecar_filename ), std::invalid_argument ) ;
+	}
+
+	std::filesystem::remove( sidecar_filename ) ;
+	remove_test_file( filename ) ;
+}
+
+TEST_CASE( "Test that transposed sidecars give each sample's genotypes across a range", "[bgen][sidecar]" ) {
+	std::string const filename = temp_filename( "genfile_test_transposed.bgen" ) ;
+	std::string const sidecar_filename = genfile::bgen::TransposedSidecar::default_filename( filename ) ;
+	std::size_t const number_of_samples = 150 ;
+	std::vector< TestVariant > variants = consecutive_variants( 30, "01", 1000 ) ;
+	for( TestVariant variant: consecutive_variants( 10, "02", 500 )) {
+		variant.id += 30 ;
+		variants.push_back( variant ) ;
+	}
+	// A triallelic variant, which is not stored.
+	variants.push_back( TestVariant{ "02", 600, { "A", "C", "G" }, 40 } ) ;
+	write_test_file( filename, number_of_samples, variants ) ;
+
+	// Small tiles, so that ranges span several variant blocks and samples lie in several chunks.
+	genfile::ThreadPool pool( 3 ) ;
+	genfile::bgen::TransposedSidecar::BuildOptions options ;
+	options.sample_chunk_size = 16 ;
+	options.variant_block_size = 7 ;
+	std::vector< int64_t > file_positions ;
+	{
+		genfile::bgen::View::UniquePtr view = genfile::bgen::View::create( filename ) ;
+		genfile::bgen::TransposedSidecar::build( *view, sidecar_filename, pool, options ) ;
+		view = genfile::bgen::View::create( filename ) ;
+		std::string SNPID, rsid, chromosome ;
+		uint32_t position ;
+		std::vector< std::string > alleles ;
+		for( std::streampos file_position = view->current_file_position(); view->read_variant( &SNPID, &rsid, &chromosome, &position, &alleles ); file_position = view->current_file_position() ) {
+			file_positions.push_back( file_position ) ;
+			view->ignore_genotype_data_block() ;
+		}
+	}
+	REQUIRE( !std::filesystem::exists( sidecar_filename + ".tmp" )) ;
+	REQUIRE( !std::filesystem::exists( sidecar_filename + ".tmp.tiles" )) ;
+
+	genfile::bgen::TransposedSidecar::UniquePtr sidecar = genfile::bgen::TransposedSidecar::open( sidecar_filename ) ;
+	REQUIRE( sidecar->number_of_samples() == number_of_samples ) ;
+	REQUIRE( sidecar->number_of_variants() == 40 ) ;
+	{
+		genfile::bgen::View::UniquePtr view = genfile::bgen::View::create( filename ) ;
+		REQUIRE( sidecar->matches( view->file_metadata() )) ;
+	}
+
+	struct Range {
+		std::string chromosome ;
+		uint32_t start ;
+		uint32_t end ;
+		// Index of the first variant in the range, and number of variants.
+		std::size_t first ;
+		std::size_t count ;
+	} ;
+	std::vector< Range > const ranges = {
+		{ "01", 0, 5000, 0, 30 },
+		{ "01", 1003, 1020, 3, 18 },
+		{ "01", 1006, 1006, 6, 1 },
+		{ "02", 505, 700, 35, 5 },
+		{ "02", 1000, 1100, 0, 0 },
+		{ "03", 0, 5000, 0, 0 }
+	} ;
+	genfile::bgen::TransposedSidecar::SampleGenotypes genotypes ;
+	for( std::size_t sample: { std::size_t( 0 ), std::size_t( 15 ), std::size_t( 16 ), std::size_t( 77 ), number_of_samples - 1 } ) {
+		for( Range const& range: ranges ) {
+			sidecar->get_sample_genotypes( sample, genfile::bgen::IndexQuery::GenomicRange( range.chromosome, range.start, range.end ), &genotypes ) ;
+			REQUIRE( genotypes.size() == range.count ) ;
+			for( std::size_t i = 0; i < genotypes.size(); ++i ) {
+				std::size_t const variant = range.first + i ;
+				REQUIRE( genotypes.variant_indices[i] == variant ) ;
+				REQUIRE( genotypes.file_positions[i] == uint64_t( file_positions[ variant ] )) ;
+				REQUIRE( genotypes.positions[i] == variants[ variant ].position ) ;
+				REQUIRE( ( genotypes.ploidy[i] & 0x3F ) == 2 ) ;
+				REQUIRE( genotypes.phased[i] == 0 ) ;
+				double const expected = expected_dosage( sample, variants[ variant ].id ) ;
+				if( expected == -1 ) {
+					REQUIRE( genotypes.is_missing( i )) ;
+					REQUIRE( std::isnan( genotypes.dosage( i ))) ;
+				} else {
+					REQUIRE( !genotypes.is_missing( i )) ;
+					REQUIRE( genotypes.dosage( i ) == expected ) ;
+				}
+			}
+		}
+	}
+	sidecar.reset() ;
+
+	// Temporary files are removed if the build fails, here because a genotype data block is corrupt.
+	// This is found when decoding on the pool, so the error is also propagated from parallel_for().
+	{
+		std::fstream file( filename, std::ios::binary | std::ios::in | std::ios::out ) ;
+		file.seekp( file_positions[ 21 ] - 10 ) ;
+		file.write( std::string( 10, char( 0xFF )).data(), 10 ) ;
+	}
+	{
+		genfile::bgen::View::UniquePtr view = genfile::bgen::View::create( filename ) ;
+		std::filesystem::remove( sidecar_filename ) ;
+		REQUIRE_THROWS( genfile::bgen::TransposedSidecar::build( *view, sidecar_filename, pool, options )) ;
+	}
+	REQUIRE( !std::filesystem::exists( sidecar_filename )) ;
+	REQUIRE( !std::filesystem::exists( sidecar_filename + ".tmp" )) ;
+	REQUIRE( !std::filesystem::exists( sidecar_filename + ".tmp.tiles" )) ;
+
+	remove_test_file( filename ) ;
+}
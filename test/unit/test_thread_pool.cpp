@@ -0,0 +1,65 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <stdexcept>
+#include "catch2/catch.hpp"
+#include "genfile/ThreadPool.hpp"
+
+TEST_CASE( "Test that ThreadPool::parallel_for() visits every index", "[thread]" ) {
+	for( std::size_t number_of_threads: { 1, 2, 5 } ) {
+		genfile::ThreadPool pool( number_of_threads ) ;
+		REQUIRE( pool.number_of_threads() == number_of_threads ) ;
+		for( std::size_t n: { 0, 1, 3, 100, 1001 } ) {
+			std::vector< int > visits( n + 10, 0 ) ;
+			pool.parallel_for( 10, n + 10, [&visits]( std::size_t i ) { ++visits[i] ; } ) ;
+			for( std::size_t i = 0; i < visits.size(); ++i ) {
+				REQUIRE( visits[i] == (( i < 10 ) ? 0 : 1 )) ;
+			}
+		}
+	}
+}
+
+TEST_CASE( "Test that ThreadPool::parallel_for() rethrows the first exception after all work completes", "[thread]" ) {
+	genfile::ThreadPool pool( 4 ) ;
+	std::size_t const n = 1000 ;
+	std::vector< std::size_t > const throwing = { 731, 250, 999 } ;
+	std::size_t const chunk_size = 63 ;
+	std::atomic< std::size_t > count( 0 ) ;
+	std::size_t count_when_thrown = 0 ;
+	try {
+		pool.parallel_for(
+			0, n,
+			[&]( std::size_t i ) {
+				++count ;
+				for( std::size_t j: throwing ) {
+					if( i == j ) {
+						throw std::invalid_argument( std::to_string( i )) ;
+					}
+				}
+			}
+		) ;
+		FAIL( "parallel_for() did not throw" ) ;
+	} catch( std::invalid_argument const& e ) {
+		count_when_thrown = count ;
+		REQUIRE( std::string( e.what() ) == "250" ) ;
+	}
+	// Work is divided into 16 chunks of 63 indices.  Calls later in a chunk that threw are skipped,
+	// but all other calls have been made by the time the exception is seen.
+	REQUIRE( count_when_thrown >= n - throwing.size() * ( chunk_size - 1 )) ;
+	REQUIRE( count == count_when_thrown ) ;
+
+	// The pool can still be used.
+	std::atomic< std::size_t > total( 0 ) ;
+	pool.parallel_for( 0, 100, [&total]( std::size_t i ) { total += i ; } ) ;
+	REQUIRE( total == 4950 ) ;
+
+	// Exceptions from tasks submitted directly are rethrown by future::get().
+	std::future< int > result = pool.submit( []() -> int { throw std::runtime_error( "task" ) ; } ) ;
+	REQUIRE_THROWS_AS( result.get(), std::runtime_error ) ;
+}
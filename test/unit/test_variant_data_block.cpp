@@ -513,3 +513,74 @@ TEST_CASE( "Test truncated data", "[bgen]" ) {
 	}
 }
 
+
+namespace {
+	// Records values for samples i where include(i) is true.
+	struct RecordingSetter {
+		RecordingSetter( std::function< bool( std::size_t ) > include ): m_include( include ) {}
+		void initialise( std::size_t n, std::size_t k ) { m_values.assign( n, std::vector< double >() ) ; }
+		bool set_sample( std::size_t i ) { m_sample_i = i ; return m_include( i ) ; }
+		void set_number_of_entries( std::size_t, std::size_t n, genfile::OrderType, genfile::ValueType ) {
+			m_values[ m_sample_i ].reserve( n ) ;
+		}
+		void set_value( uint32_t, double value ) { m_values[ m_sample_i ].push_back( value ) ; }
+		void set_value( uint32_t, genfile::MissingValue ) { m_values[ m_sample_i ].push_back( -1 ) ; }
+		std::function< bool( std::size_t ) > m_include ;
+		std::vector< std::vector< double > > m_values ;
+		std::size_t m_sample_i ;
+	} ;
+}
+
+TEST_CASE( "Test mixed ploidy data with skipped samples", "[bgen][multiallelic]" ) {
+	std::cerr << "test_mixed_ploidy_skipped_samples\n" ;
+	std::vector< uint32_t > const ploidies{ 1, 2, 2, 2, 1, 3, 3, 4, 2, 1, 1, 1 } ;
+	std::size_t const N = 37 ;
+	genfile::bgen::Context context ;
+	context.number_of_samples = N ;
+	context.flags = genfile::bgen::e_Layout2 ;
+	std::vector< genfile::byte_t > buffer( 100000 ) ;
+	for( uint16_t K = 2; K < 6; ++K ) {
+		for( int phased = 0; phased < 2; ++phased ) {
+			for( int bits: { 1, 3, 8, 13, 16 } ) {
+				genfile::bgen::v12::ProbabilityDataWriter writer( bits ) ;
+				writer.initialise( N, K, &buffer[0], &buffer[0] + buffer.size() ) ;
+				std::vector< std::vector< double > > expected( N ) ;
+				for( std::size_t i = 0; i < N; ++i ) {
+					uint32_t const ploidy = ploidies[ i % ploidies.size() ] ;
+					uint32_t const count = phased ? ploidy * K : genfile::bgen::impl::n_choose_k< uint32_t >( ploidy + K - 1, K - 1 ) ;
+					std::size_t const group = phased ? K : count ;
+					bool const missing = ( i % 5 == 2 ) ;
+					writer.set_sample( i ) ;
+					writer.set_number_of_entries( ploidy, count, phased ? genfile::ePerPhasedHaplotypePerAllele : genfile::ePerUnorderedGenotype, genfile::eProbability ) ;
+					for( std::size_t k = 0; k < count; ++k ) {
+						// Put all probability on one value per group.
+						double const value = ( k % group == ( i + k / group ) % group ) ? 1.0 : 0.0 ;
+						if( missing ) {
+							writer.set_value( k, genfile::MissingValue() ) ;
+						} else {
+							writer.set_value( k, value ) ;
+						}
+						expected[i].push_back( missing ? -1 : value ) ;
+					}
+				}
+				writer.finalise() ;
+
+				RecordingSetter all( []( std::size_t ) { return true ; } ) ;
+				RecordingSetter even( []( std::size_t i ) { return i % 2 == 0 ; } ) ;
+				genfile::bgen::parse_probability_data( writer.repr().first, writer.repr().second, context, all ) ;
+				genfile::bgen::parse_probability_data( writer.repr().first, writer.repr().second, context, even ) ;
+				for( std::size_t i = 0; i < N; ++i ) {
+					REQUIRE( all.m_values[i].size() == expected[i].size() ) ;
+					for( std::size_t k = 0; k < expected[i].size(); ++k ) {
+						REQUIRE( all.m_values[i][k] == Approx( expected[i][k] ).margin( 1E-9 ) ) ;
+					}
+					if( i % 2 == 0 ) {
+						REQUIRE( even.m_values[i] == all.m_values[i] ) ;
+					} else {
+						REQUIRE( even.m_values[i].empty() ) ;
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,215 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include "stdint.h"
+#include "catch2/catch.hpp"
+#include "genfile/bgen.hpp"
+#include "genfile/View.hpp"
+#include "genfile/VariantBatch.hpp"
+#include "genfile/variant_filter.hpp"
+#include "genfile/types.hpp"
+#include "test_files.hpp"
+
+namespace {
+	// Encode diploid data with the given probabilities for each sample (empty if missing),
+	// and compute its statistics.
+	genfile::bgen::VariantStats compute_stats(
+		std::vector< std::vector< double > > const& probabilities,
+		std::size_t number_of_alleles = 2,
+		bool phased = false
+	) {
+		genfile::bgen::Context context ;
+		context.number_of_samples = probabilities.size() ;
+		context.flags = genfile::bgen::e_Layout2 | genfile::bgen::e_ZlibCompression ;
+		std::size_t const number_of_entries = phased
+			? ( 2 * number_of_alleles )
+			: ( number_of_alleles * ( number_of_alleles + 1 ) / 2 ) ;
+
+		std::vector< genfile::byte_t > buffer1, buffer2 ;
+		genfile::bgen::GenotypeDataBlockWriter writer( &buffer1, &buffer2, context, 16 ) ;
+		writer.initialise( context.number_of_samples, number_of_alleles, 2 ) ;
+		for( std::size_t i = 0; i < probabilities.size(); ++i ) {
+			writer.set_sample( i ) ;
+			writer.set_number_of_entries(
+				2, number_of_entries,
+				phased ? genfile::ePerPhasedHaplotypePerAllele : genfile::ePerUnorderedGenotype,
+				genfile::eProbability
+			) ;
+			for( std::size_t g = 0; g < number_of_entries; ++g ) {
+				if( probabilities[i].empty() ) {
+					writer.set_value( g, genfile::MissingValue() ) ;
+				} else {
+					writer.set_value( g, probabilities[i][g] ) ;
+				}
+			}
+		}
+		writer.finalise() ;
+
+		// Skip the length field, as read_genotype_data_block() does.
+		std::vector< genfile::byte_t > block( writer.repr().first + 4, writer.repr().second ), data ;
+		genfile::bgen::uncompress_probability_data( context, block, &data ) ;
+		genfile::bgen::VariantStats result ;
+		genfile::bgen::VariantStatsSetter setter( &result ) ;
+		genfile::bgen::parse_probability_data( data.data(), data.data() + data.size(), context, setter ) ;
+		return result ;
+	}
+}
+
+TEST_CASE( "Test that VariantStatsSetter computes allele frequency, info and missing rate", "[bgen][filter]" ) {
+	// Probabilities are stored to 16 bits.
+	double const tolerance = 1E-4 ;
+	std::vector< double > const AA{ 1, 0, 0 }, AG{ 0, 1, 0 }, GG{ 0, 0, 1 }, uncertain{ 0.25, 0.5, 0.25 }, missing ;
+
+	SECTION( "Certain genotypes have info 1" ) {
+		genfile::bgen::VariantStats const stats = compute_stats( { AA, AG, GG, missing } ) ;
+		REQUIRE( stats.allele_frequency == Approx( 0.5 ).margin( tolerance )) ;
+		REQUIRE( stats.info == Approx( 1.0 ).margin( tolerance )) ;
+		REQUIRE( stats.missing_rate == Approx( 0.25 ).margin( tolerance )) ;
+	}
+
+	SECTION( "Uninformative genotypes have info 0" ) {
+		genfile::bgen::VariantStats const stats = compute_stats( { uncertain, uncertain, uncertain, uncertain } ) ;
+		REQUIRE( stats.allele_frequency == Approx( 0.5 ).margin( tolerance )) ;
+		REQUIRE( stats.info == Approx( 0.0 ).margin( tolerance )) ;
+		REQUIRE( stats.missing_rate == 0.0 ) ;
+	}
+
+	SECTION( "Partially informative genotypes" ) {
+		// Total variance is 0.5, and the expected variance under HWE is 8 * 0.25 * 0.75.
+		genfile::bgen::VariantStats const stats = compute_stats( { AA, AG, uncertain, AA } ) ;
+		REQUIRE( stats.allele_frequency == Approx( 0.25 ).margin( tolerance )) ;
+		REQUIRE( stats.info == Approx( 1.0 - 0.5 / ( 8 * 0.25 * 0.75 )).margin( tolerance )) ;
+		REQUIRE( stats.missing_rate == 0.0 ) ;
+	}
+
+	SECTION( "Phased haplotypes" ) {
+		// Each sample has one certain and one uninformative haplotype.
+		std::vector< double > const haplotypes{ 1, 0, 0.5, 0.5 } ;
+		genfile::bgen::VariantStats const stats = compute_stats( { haplotypes, haplotypes }, 2, true ) ;
+		REQUIRE( stats.allele_frequency == Approx( 0.25 ).margin( tolerance )) ;
+		REQUIRE( stats.info == Approx( 1.0 - 0.5 / 0.75 ).margin( tolerance )) ;
+		REQUIRE( stats.missing_rate == 0.0 ) ;
+	}
+
+	SECTION( "Monomorphic variants have info 1" ) {
+		genfile::bgen::VariantStats const stats = compute_stats( { AA, AA, AA } ) ;
+		REQUIRE( stats.allele_frequency == 0.0 ) ;
+		REQUIRE( stats.info == 1.0 ) ;
+	}
+
+	SECTION( "Statistics are NaN if all samples are missing" ) {
+		genfile::bgen::VariantStats const stats = compute_stats( { missing, missing } ) ;
+		REQUIRE( std::isnan( stats.allele_frequency )) ;
+		REQUIRE( std::isnan( stats.info )) ;
+		REQUIRE( stats.missing_rate == 1.0 ) ;
+	}
+
+	SECTION( "Statistics are NaN for multiallelic variants" ) {
+		genfile::bgen::VariantStats const stats = compute_stats( { { 1, 0, 0, 0, 0, 0 }, { 0, 0, 0, 0, 0, 1 } }, 3 ) ;
+		REQUIRE( std::isnan( stats.allele_frequency )) ;
+		REQUIRE( std::isnan( stats.info )) ;
+		REQUIRE( std::isnan( stats.missing_rate )) ;
+	}
+}
+
+TEST_CASE( "Test that VariantFilter applies minimum MAF, minimum info and maximum missing rate thresholds", "[bgen][filter]" ) {
+	genfile::bgen::VariantStats stats ;
+	stats.allele_frequency = 0.75 ;
+	stats.info = 0.5 ;
+	stats.missing_rate = 0.125 ;
+
+	genfile::bgen::VariantFilter filter ;
+	REQUIRE( !filter.needs_stats() ) ;
+	REQUIRE( filter.passes( stats )) ;
+	REQUIRE( filter.passes( genfile::bgen::VariantStats() )) ;
+
+	// MAF is computed from the frequency of either allele.
+	filter.min_maf = 0.25 ;
+	REQUIRE( filter.needs_stats() ) ;
+	REQUIRE( filter.passes( stats )) ;
+	filter.min_maf = 0.26 ;
+	REQUIRE( !filter.passes( stats )) ;
+	filter.min_maf.reset() ;
+
+	filter.min_info = 0.5 ;
+	REQUIRE( filter.passes( stats )) ;
+	filter.min_info = 0.51 ;
+	REQUIRE( !filter.passes( stats )) ;
+	filter.min_info.reset() ;
+
+	filter.max_missing_rate = 0.125 ;
+	REQUIRE( filter.passes( stats )) ;
+	filter.max_missing_rate = 0.12 ;
+	REQUIRE( !filter.passes( stats )) ;
+
+	// NaN statistics fail any threshold that uses them.
+	filter.max_missing_rate = 1.0 ;
+	REQUIRE( !filter.passes( genfile::bgen::VariantStats() )) ;
+	filter.max_missing_rate.reset() ;
+	filter.min_maf = 0.0 ;
+	REQUIRE( !filter.passes( genfile::bgen::VariantStats() )) ;
+	filter.min_maf.reset() ;
+	filter.min_info = 0.0 ;
+	REQUIRE( !filter.passes( genfile::bgen::VariantStats() )) ;
+}
+
+TEST_CASE( "Test that filter_variant_batch() flags variants passing the filter", "[bgen][filter]" ) {
+	std::string const filename = temp_filename( "genfile_test_variant_filter.bgen" ) ;
+	std::size_t const number_of_samples = 11 ;
+	std::size_t const number_of_variants = 20 ;
+	TestFileOptions options ;
+	options.write_index = false ;
+	write_test_file( filename, number_of_samples, consecutive_variants( number_of_variants ), options ) ;
+
+	// Compute the expected minor allele frequencies from the encoded dosages.
+	std::vector< double > expected_maf ;
+	for( std::size_t v = 0; v < number_of_variants; ++v ) {
+		double total_dosage = 0.0 ;
+		std::size_t total_ploidy = 0 ;
+		for( std::size_t i = 0; i < number_of_samples; ++i ) {
+			double const dosage = expected_dosage( i, v ) ;
+			if( dosage != -1 ) {
+				total_dosage += dosage ;
+				total_ploidy += 2 ;
+			}
+		}
+		double const frequency = total_dosage / total_ploidy ;
+		expected_maf.push_back( std::min( frequency, 1.0 - frequency )) ;
+	}
+	double const threshold = 0.45 ;
+	REQUIRE( std::count_if( expected_maf.begin(), expected_maf.end(), [threshold]( double maf ) { return maf >= threshold ; } ) > 0 ) ;
+	REQUIRE( std::count_if( expected_maf.begin(), expected_maf.end(), [threshold]( double maf ) { return maf < threshold ; } ) > 0 ) ;
+
+	genfile::bgen::View view( filename ) ;
+	genfile::bgen::VariantFilter filter ;
+	filter.min_maf = threshold ;
+	std::size_t v = 0 ;
+	genfile::bgen::VariantBatch batch ;
+	while( view.read_variant_batch( 7, &batch, true ) > 0 ) {
+		genfile::bgen::FilteredVariantBatch const result = genfile::bgen::filter_variant_batch(
+			std::move( batch ), view.context(), filter
+		) ;
+		REQUIRE( result.included.size() == result.batch.size() ) ;
+		for( std::size_t i = 0; i < result.batch.size(); ++i, ++v ) {
+			REQUIRE( result.batch.position[i] == 1000 + v ) ;
+			REQUIRE( bool( result.included[i] ) == ( expected_maf[v] >= threshold )) ;
+		}
+	}
+	REQUIRE( v == number_of_variants ) ;
+
+	// Without thresholds all variants are included, and genotype data is not needed.
+	genfile::bgen::View view2( filename ) ;
+	REQUIRE( view2.read_variant_batch( number_of_variants, &batch, false ) == number_of_variants ) ;
+	genfile::bgen::FilteredVariantBatch const result = genfile::bgen::filter_variant_batch(
+		std::move( batch ), view2.context(), genfile::bgen::VariantFilter()
+	) ;
+	REQUIRE( result.included == std::vector< char >( number_of_variants, 1 )) ;
+	remove_test_file( filename ) ;
+}
@@ -0,0 +1,341 @@
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <stdexcept>
+#include "stdint.h"
+#include "catch2/catch.hpp"
+#include "genfile/bgen.hpp"
+#include "genfile/View.hpp"
+#include "genfile/IndexQuery.hpp"
+#include "genfile/VariantBatch.hpp"
+#include "genfile/ThreadPool.hpp"
+#include "genfile/variant_list.hpp"
+#include "test_files.hpp"
+
+namespace {
+	typedef std::vector< std::vector< std::string > > Table ;
+
+	std::vector< std::string > field_names( std::vector< genfile::bgen::ListFieldSpec > const& fields ) {
+		std::vector< std::string > result ;
+		for( genfile::bgen::ListFieldSpec const& field: fields ) {
+			result.push_back( field.name ) ;
+		}
+		return result ;
+	}
+
+	std::vector< std::string > split( std::string const& line, char delimiter ) {
+		std::vector< std::string > result ;
+		std::size_t begin = 0 ;
+		while( true ) {
+			std::size_t const end = line.find( delimiter, begin ) ;
+			result.push_back( line.substr( begin, end - begin )) ;
+			if( end == std::string::npos ) {
+				break ;
+			}
+			begin = end + 1 ;
+		}
+		return result ;
+	}
+
+	// Parse text output into rows of fields.
+	Table parse_text( std::string const& text ) {
+		Table result ;
+		std::istringstream stream( text ) ;
+		std::string line ;
+		while( std::getline( stream, line )) {
+			result.push_back( split( line, '\t' )) ;
+		}
+		return result ;
+	}
+
+	// Reads columnar output, converting all values to strings.
+	struct ColumnarReader {
+		ColumnarReader( std::string const& data ): m_data( data ), m_pos( 0 ) {}
+
+		template< typename IntegerType >
+		IntegerType read_integer() {
+			REQUIRE( m_pos + sizeof( IntegerType ) <= m_data.size() ) ;
+			IntegerType result ;
+			genfile::byte_t const* buffer = reinterpret_cast< genfile::byte_t const* >( m_data.data() + m_pos ) ;
+			genfile::bgen::read_little_endian_integer( buffer, buffer + sizeof( IntegerType ), &result ) ;
+			m_pos += sizeof( IntegerType ) ;
+			return result ;
+		}
+
+		std::string read_string( std::size_t size ) {
+			REQUIRE( m_pos + size <= m_data.size() ) ;
+			std::string const result = m_data.substr( m_pos, size ) ;
+			m_pos += size ;
+			return result ;
+		}
+
+		// Read the header, returning the column names and setting types.
+		std::vector< std::string > read_header( std::vector< uint8_t >* types ) {
+			REQUIRE( read_string( 8 ) == "BGXLIST1" ) ;
+			uint32_t const number_of_columns = read_integer< uint32_t >() ;
+			std::vector< std::string > names ;
+			types->clear() ;
+			for( uint32_t k = 0; k < number_of_columns; ++k ) {
+				types->push_back( read_integer< uint8_t >() ) ;
+				names.push_back( read_string( read_integer< uint32_t >() )) ;
+			}
+			return names ;
+		}
+
+		// Read a block, appending its rows to result, and return the number of variants in it.
+		uint32_t read_block( std::vector< uint8_t > const& types, Table* result ) {
+			uint32_t const N = read_integer< uint32_t >() ;
+			std::size_t const first_row = result->size() ;
+			result->resize( first_row + N, std::vector< std::string >( types.size() )) ;
+			for( std::size_t k = 0; k < types.size(); ++k ) {
+				std::vector< uint32_t > sizes ;
+				for( uint32_t i = 0; i < N; ++i ) {
+					std::string& value = (*result)[ first_row + i ][k] ;
+					switch( types[k] ) {
+						case 1: value = std::to_string( read_integer< uint16_t >() ) ; break ;
+						case 2: value = std::to_string( read_integer< uint32_t >() ) ; break ;
+						case 3: value = std::to_string( read_integer< int64_t >() ) ; break ;
+						case 4: sizes.push_back( read_integer< uint32_t >() ) ; break ;
+						default: FAIL( "unexpected column type" ) ;
+					}
+				}
+				for( uint32_t i = 0; i < sizes.size(); ++i ) {
+					(*result)[ first_row + i ][k] = read_string( sizes[i] ) ;
+				}
+			}
+			return N ;
+		}
+
+		bool at_end() const { return m_pos == m_data.size() ; }
+
+	private:
+		std::string const& m_data ;
+		std::size_t m_pos ;
+	} ;
+
+	// Parse complete columnar output, checking its column names.
+	Table parse_columnar( std::string const& data, std::vector< std::string > const& expected_names ) {
+		ColumnarReader reader( data ) ;
+		std::vector< uint8_t > types ;
+		REQUIRE( reader.read_header( &types ) == expected_names ) ;
+		Table result ;
+		while( reader.read_block( types, &result ) > 0 ) {}
+		REQUIRE( reader.at_end() ) ;
+		return result ;
+	}
+
+	// Add a variant with the given alleles to the batch.
+	void add_variant(
+		genfile::bgen::VariantBatch* batch,
+		std::string const& SNPID, std::string const& rsid, std::string const& chromosome, uint32_t position,
+		std::vector< std::string > const& alleles, int64_t offset, int64_t size
+	) {
+		batch->add_variant( SNPID, rsid, chromosome, position, alleles.size() ) ;
+		for( std::string const& allele: alleles ) {
+			batch->add_allele( allele ) ;
+		}
+		batch->file_offset.push_back( offset ) ;
+		batch->file_size.push_back( size ) ;
+	}
+
+	// Return the list output for the given file (formatted sequentially, in batches of the given size)
+	// and fields, including header and end.
+	std::string list_sequentially(
+		std::string const& filename,
+		std::vector< genfile::bgen::ListFieldSpec > const& fields,
+		genfile::bgen::ListFormat format,
+		std::size_t batch_size
+	) {
+		bool const columnar = ( format == genfile::bgen::eColumnarList ) ;
+		std::string result = columnar ? genfile::bgen::format_list_columnar_header( fields ) : genfile::bgen::format_list_text_header( fields ) ;
+		genfile::bgen::View view( filename ) ;
+		genfile::bgen::VariantBatch batch ;
+		while( view.read_variant_batch( batch_size, &batch ) > 0 ) {
+			result += columnar ? genfile::bgen::format_list_columnar( batch, fields ) : genfile::bgen::format_list_text( batch, fields ) ;
+		}
+		if( columnar ) {
+			result += genfile::bgen::format_list_columnar_end() ;
+		}
+		return result ;
+	}
+
+	// As list_sequentially(), but using write_variant_list() with batches read from the file or its index.
+	std::string list_on_pool(
+		std::string const& filename,
+		std::vector< genfile::bgen::ListFieldSpec > const& fields,
+		genfile::bgen::ListFormat format,
+		std::size_t batch_size,
+		genfile::ThreadPool& pool,
+		bool from_index = false
+	) {
+		bool const columnar = ( format == genfile::bgen::eColumnarList ) ;
+		std::ostringstream out ;
+		out << ( columnar ? genfile::bgen::format_list_columnar_header( fields ) : genfile::bgen::format_list_text_header( fields )) ;
+		genfile::bgen::View view( filename ) ;
+		genfile::bgen::IndexQuery::UniquePtr query = genfile::bgen::IndexQuery::create( filename + ".bgi" ) ;
+		query->initialise() ;
+		std::size_t const count = genfile::bgen::write_variant_list(
+			[&]( genfile::bgen::IndexQuery::BatchCallback callback ) {
+				if( from_index ) {
+					query->read_variant_batches( batch_size, callback ) ;
+				} else {
+					genfile::bgen::VariantBatch batch ;
+					while( view.read_variant_batch( batch_size, &batch ) > 0 ) {
+						callback( batch ) ;
+					}
+				}
+			},
+			fields, format, pool, out
+		) ;
+		REQUIRE( count == view.number_of_variants() ) ;
+		if( columnar ) {
+			out << genfile::bgen::format_list_columnar_end() ;
+		}
+		return out.str() ;
+	}
+}
+
+TEST_CASE( "Test that list fields are parsed by full and short names", "[bgenix][list]" ) {
+	std::vector< std::string > const all_fields = {
+		"alternate_ids", "rsid", "chromosome", "position", "number_of_alleles",
+		"first_allele", "alternative_alleles", "file_start_position", "size_in_bytes"
+	} ;
+	REQUIRE( field_names( genfile::bgen::parse_list_fields(
+		"alternate_ids,rsid,chromosome,position,number_of_alleles,first_allele,alternative_alleles,file_start_position,size_in_bytes"
+	)) == all_fields ) ;
+	REQUIRE( field_names( genfile::bgen::parse_list_fields(
+		"snpid,rsid,chrom,pos,number_of_alleles,first_allele,alternative_alleles,offset,size"
+	)) == all_fields ) ;
+	// Fields are output in the order given, and may be repeated.
+	REQUIRE( field_names( genfile::bgen::parse_list_fields( "pos,chromosome,pos" )) == std::vector< std::string >{ "position", "chromosome", "position" } ) ;
+
+	REQUIRE_THROWS_AS( genfile::bgen::parse_list_fields( "" ), std::invalid_argument ) ;
+	REQUIRE_THROWS_AS( genfile::bgen::parse_list_fields( "rsid," ), std::invalid_argument ) ;
+	REQUIRE_THROWS_AS( genfile::bgen::parse_list_fields( "rsid,Position" ), std::invalid_argument ) ;
+	REQUIRE_THROWS_AS( genfile::bgen::parse_list_fields( "rsid position" ), std::invalid_argument ) ;
+
+	REQUIRE( field_names( genfile::bgen::default_list_fields() ) == std::vector< std::string >( all_fields.begin(), all_fields.begin() + 7 )) ;
+
+	REQUIRE( genfile::bgen::parse_list_format( "text" ) == genfile::bgen::eTextList ) ;
+	REQUIRE( genfile::bgen::parse_list_format( "columnar" ) == genfile::bgen::eColumnarList ) ;
+	REQUIRE_THROWS_AS( genfile::bgen::parse_list_format( "csv" ), std::invalid_argument ) ;
+}
+
+TEST_CASE( "Test that fields not recorded in the index cannot be listed from the index", "[bgenix][list]" ) {
+	REQUIRE_THROWS_AS( genfile::bgen::parse_list_fields( "alternate_ids", true ), std::invalid_argument ) ;
+	REQUIRE_THROWS_AS( genfile::bgen::parse_list_fields( "rsid,snpid", true ), std::invalid_argument ) ;
+	REQUIRE_THROWS_AS( genfile::bgen::parse_list_fields( "alternative_alleles,pos", true ), std::invalid_argument ) ;
+	REQUIRE( genfile::bgen::parse_list_fields( "rsid,chrom,pos,number_of_alleles,first_allele,offset,size", true ).size() == 7 ) ;
+	REQUIRE( field_names( genfile::bgen::default_list_fields( true )) == std::vector< std::string >{
+		"rsid", "chromosome", "position", "number_of_alleles", "first_allele", "file_start_position", "size_in_bytes"
+	} ) ;
+}
+
+TEST_CASE( "Test that text and columnar lists hold the batch data", "[bgenix][list]" ) {
+	genfile::bgen::VariantBatch batch ;
+	add_variant( &batch, "SNP1", "rs1", "01", 1000, { "A", "G" }, 100, 50 ) ;
+	// Empty identifiers, and a multiallelic variant.
+	add_variant( &batch, "", "", "X", 4000000000u, { "AT", "A", "ATT" }, 150, 5000000000 ) ;
+	// A variant without stored alternative alleles, as read from an index.
+	add_variant( &batch, "SNP3", "rs3", "01", 0, { "C" }, 5000000150, 1 ) ;
+	batch.number_of_alleles.back() = 65535 ;
+
+	std::vector< genfile::bgen::ListFieldSpec > const fields = genfile::bgen::parse_list_fields(
+		"snpid,rsid,chrom,pos,number_of_alleles,first_allele,alternative_alleles,offset,size"
+	) ;
+	Table const expected = {
+		{ "SNP1", "rs1", "01", "1000", "2", "A", "G", "100", "50" },
+		{ "", "", "X", "4000000000", "3", "AT", "A,ATT", "150", "5000000000" },
+		{ "SNP3", "rs3", "01", "0", "65535", "C", "", "5000000150", "1" }
+	} ;
+
+	SECTION( "text" ) {
+		REQUIRE( genfile::bgen::format_list_text_header( fields ) == "alternate_ids\trsid\tchromosome\tposition\tnumber_of_alleles"
+			"\tfirst_allele\talternative_alleles\tfile_start_position\tsize_in_bytes\n" ) ;
+		// Empty identifiers are output as ".".
+		Table expected_text = expected ;
+		expected_text[1][0] = expected_text[1][1] = "." ;
+		REQUIRE( parse_text( genfile::bgen::format_list_text( batch, fields )) == expected_text ) ;
+	}
+
+	SECTION( "columnar" ) {
+		std::string const data = genfile::bgen::format_list_columnar_header( fields )
+			+ genfile::bgen::format_list_columnar( batch, fields )
+			+ genfile::bgen::format_list_columnar_end() ;
+		ColumnarReader reader( data ) ;
+		std::vector< uint8_t > types ;
+		REQUIRE( reader.read_header( &types ) == field_names( fields )) ;
+		REQUIRE( types == std::vector< uint8_t >{ 4, 4, 4, 2, 1, 4, 4, 3, 3 } ) ;
+		Table result ;
+		REQUIRE( reader.read_block( types, &result ) == 3 ) ;
+		REQUIRE( result == expected ) ;
+		REQUIRE( reader.read_block( types, &result ) == 0 ) ;
+		REQUIRE( reader.at_end() ) ;
+	}
+
+	SECTION( "columnar layout" ) {
+		std::vector< genfile::bgen::ListFieldSpec > const two_fields = genfile::bgen::parse_list_fields( "pos,rsid" ) ;
+		std::string const header( "BGXLIST1\x02\0\0\0" "\x02\x08\0\0\0position" "\x04\x04\0\0\0rsid", 8 + 4 + 13 + 9 ) ;
+		REQUIRE( genfile::bgen::format_list_columnar_header( two_fields ) == header ) ;
+		// Count, then positions, then rsid lengths and data.
+		std::string const block(
+			"\x03\0\0\0"
+			"\xE8\x03\0\0" "\0\x28\x6B\xEE" "\0\0\0\0"
+			"\x03\0\0\0" "\0\0\0\0" "\x03\0\0\0"
+			"rs1rs3",
+			4 + 12 + 12 + 6
+		) ;
+		REQUIRE( genfile::bgen::format_list_columnar( batch, two_fields ) == block ) ;
+		REQUIRE( genfile::bgen::format_list_columnar_end() == std::string( 4, '\0' )) ;
+		// An empty batch gives an empty block, which looks like the end.
+		REQUIRE( genfile::bgen::format_list_columnar( genfile::bgen::VariantBatch(), two_fields ) == std::string( 4, '\0' )) ;
+	}
+}
+
+TEST_CASE( "Test that lists formatted on a thread pool match those formatted sequentially", "[bgenix][list]" ) {
+	std::string const filename = temp_filename( "genfile_test_variant_list.bgen" ) ;
+	std::vector< TestVariant > variants = consecutive_variants( 250 ) ;
+	for( std::size_t i = 0; i < variants.size(); i += 3 ) {
+		variants[i].alleles[1] = "TT" ;
+	}
+	write_test_file( filename, 5, variants ) ;
+
+	genfile::ThreadPool pool( 4 ) ;
+	std::vector< genfile::bgen::ListFieldSpec > const fields = genfile::bgen::parse_list_fields(
+		"snpid,rsid,chrom,pos,number_of_alleles,first_allele,alternative_alleles,offset,size"
+	) ;
+	for( std::size_t batch_size: { 1, 7, 100, 1000 } ) {
+		std::string const text = list_sequentially( filename, fields, genfile::bgen::eTextList, batch_size ) ;
+		REQUIRE( list_on_pool( filename, fields, genfile::bgen::eTextList, batch_size, pool ) == text ) ;
+		std::string const columnar = list_sequentially( filename, fields, genfile::bgen::eColumnarList, batch_size ) ;
+		REQUIRE( list_on_pool( filename, fields, genfile::bgen::eColumnarList, batch_size, pool ) == columnar ) ;
+
+		// Both formats hold the same data.
+		Table const rows = parse_text( text ) ;
+		REQUIRE( rows.size() == variants.size() + 1 ) ;
+		REQUIRE( rows[0] == field_names( fields )) ;
+		REQUIRE( Table( rows.begin() + 1, rows.end() ) == parse_columnar( columnar, field_names( fields ))) ;
+		for( std::size_t i = 0; i < variants.size(); ++i ) {
+			REQUIRE( rows[i+1][1] == "rs" + std::to_string( variants[i].id )) ;
+			REQUIRE( rows[i+1][3] == std::to_string( variants[i].position )) ;
+			REQUIRE( rows[i+1][6] == (( i % 3 ) ? "G" : "TT" )) ;
+		}
+	}
+
+	// Fields available in the index are listed identically from the index.
+	std::vector< genfile::bgen::ListFieldSpec > const index_fields = genfile::bgen::default_list_fields( true ) ;
+	REQUIRE(
+		list_on_pool( filename, index_fields, genfile::bgen::eTextList, 7, pool, true )
+		== list_sequentially( filename, index_fields, genfile::bgen::eTextList, 7 )
+	) ;
+	REQUIRE(
+		list_on_pool( filename, index_fields, genfile::bgen::eColumnarList, 7, pool, true )
+		== list_sequentially( filename, index_fields, genfile::bgen::eColumnarList, 7 )
+	) ;
+	remove_test_file( filename ) ;
+}
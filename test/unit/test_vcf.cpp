@@ -0,0 +1,152 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <random>
+#include "stdint.h"
+#include "catch2/catch.hpp"
+#include "genfile/bgen.hpp"
+#include "genfile/vcf.hpp"
+#include "genfile/types.hpp"
+
+namespace {
+	struct Sample {
+		uint32_t ploidy ;
+		bool missing ;
+		std::vector< double > probs ;
+	} ;
+
+	// Write a biallelic variant with the given samples, returning the uncompressed genotype data block.
+	std::vector< genfile::byte_t > write_block( std::vector< Sample > const& samples, int bits, bool phased ) {
+		std::vector< genfile::byte_t > buffer( 100 + samples.size() * 40 ) ;
+		genfile::bgen::v12::ProbabilityDataWriter writer( bits, 0.01 ) ;
+		writer.initialise( samples.size(), 2, &buffer[0], &buffer[0] + buffer.size() ) ;
+		for( std::size_t i = 0; i < samples.size(); ++i ) {
+			writer.set_sample( i ) ;
+			writer.set_number_of_entries(
+				samples[i].ploidy, samples[i].probs.size(),
+				phased ? genfile::ePerPhasedHaplotypePerAllele : genfile::ePerUnorderedGenotype,
+				genfile::eProbability
+			) ;
+			for( std::size_t k = 0; k < samples[i].probs.size(); ++k ) {
+				if( samples[i].missing ) {
+					writer.set_value( k, genfile::MissingValue() ) ;
+				} else {
+					writer.set_value( k, samples[i].probs[k] ) ;
+				}
+			}
+		}
+		writer.finalise() ;
+		return std::vector< genfile::byte_t >( writer.repr().first, writer.repr().second ) ;
+	}
+
+	// Simulate diploid samples whose probabilities are exactly representable with the given number of bits,
+	// so that values on either side of the threshhold are encoded as given.
+	std::vector< Sample > simulate_diploid_samples( std::size_t n, int bits, bool phased, std::mt19937& rng ) {
+		uint64_t const max_value = uint64_t( 0xFFFFFFFFFFFFFFFF ) >> ( 64 - bits ) ;
+		std::vector< Sample > result( n ) ;
+		for( std::size_t i = 0; i < n; ++i ) {
+			Sample& sample = result[i] ;
+			sample.ploidy = 2 ;
+			sample.missing = ( i % 7 == 3 ) ;
+			uint64_t const x = std::uniform_int_distribution< uint64_t >( 0, max_value )( rng ) ;
+			uint64_t const y = std::uniform_int_distribution< uint64_t >( 0, phased ? max_value : ( max_value - x ))( rng ) ;
+			if( phased ) {
+				sample.probs = { x / double( max_value ), ( max_value - x ) / double( max_value ), y / double( max_value ), ( max_value - y ) / double( max_value ) } ;
+			} else {
+				sample.probs = { x / double( max_value ), y / double( max_value ), ( max_value - x - y ) / double( max_value ) } ;
+			}
+		}
+		return result ;
+	}
+}
+
+TEST_CASE( "Test that GT fields formatted from packed data match those of VCFProbWriter", "[bgen][vcf]" ) {
+	std::mt19937 rng( 1234 ) ;
+	std::size_t const number_of_samples = 101 ;
+	genfile::bgen::Context context ;
+	context.flags = genfile::bgen::e_Layout2 ;
+	context.number_of_samples = number_of_samples ;
+	std::vector< char > buffer ;
+	for( bool const phased: { false, true } ) {
+		for( int const bits: { 1, 2, 3, 5, 8, 10, 16, 24, 31, 32 } ) {
+			for( double const threshhold: { 0.5, 0.9 } ) {
+				std::vector< genfile::byte_t > const block = write_block( simulate_diploid_samples( number_of_samples, bits, phased, rng ), bits, phased ) ;
+				genfile::bgen::v12::GenotypeDataBlock pack( context, &block[0], &block[0] + block.size() ) ;
+				genfile::bgen::VcfGTTable const table = genfile::bgen::compute_vcf_gt_table( bits, phased, threshhold ) ;
+				genfile::bgen::write_vcf_gt_fields( pack, table, &buffer ) ;
+
+				genfile::bgen::VCFProbWriter writer( threshhold, false ) ;
+				genfile::bgen::parse_probability_data( &block[0], &block[0] + block.size(), context, writer ) ;
+				REQUIRE( writer.phased() == phased ) ;
+				std::ostringstream expected ;
+				writer.write( expected ) ;
+				REQUIRE( std::string( buffer.begin(), buffer.end() ) == expected.str() ) ;
+
+				// Blocks too short to hold the data are rejected.
+				pack.end = pack.buffer + ( 2 * bits * number_of_samples + 7 ) / 8 - 1 ;
+				REQUIRE_THROWS_AS( genfile::bgen::write_vcf_gt_fields( pack, table, &buffer ), genfile::bgen::BGenError ) ;
+			}
+		}
+	}
+}
+
+TEST_CASE( "Test that VCFProbWriter formats GT and GP fields", "[bgen][vcf]" ) {
+	genfile::bgen::Context context ;
+	context.flags = genfile::bgen::e_Layout2 ;
+
+	SECTION( "unphased data" ) {
+		std::vector< Sample > const samples = {
+			{ 2, false, { 0.1, 0.85, 0.05 } },
+			{ 2, true, { 0, 0, 0 } },
+			{ 2, false, { 0.3, 0.3, 0.4 } },
+			{ 0, false, { 1 } },
+			{ 3, false, { 0, 0, 0.25, 0.75 } }
+		} ;
+		context.number_of_samples = samples.size() ;
+		std::vector< genfile::byte_t > const block = write_block( samples, 32, false ) ;
+		genfile::bgen::VCFProbWriter writer( 0.7 ) ;
+		genfile::bgen::parse_probability_data( &block[0], &block[0] + block.size(), context, writer ) ;
+		REQUIRE( !writer.phased() ) ;
+		REQUIRE( writer.number_of_samples() == samples.size() ) ;
+		std::ostringstream out ;
+		writer.write( out ) ;
+		REQUIRE( out.str() == "\t0/1:0.1,0.85,0.05\t./.:.,.,.\t./.:0.3,0.3,0.4\t.:1\t1/1/1:0,0,0.25,0.75\n" ) ;
+
+		// Only selected samples are formatted.
+		std::vector< bool > const selected = { false, true, false, true, true } ;
+		genfile::bgen::VCFProbWriter gt_writer( 0.7, false ) ;
+		gt_writer.set_selected_samples( &selected ) ;
+		genfile::bgen::parse_probability_data( &block[0], &block[0] + block.size(), context, gt_writer ) ;
+		REQUIRE( gt_writer.entry( 0 ) == "" ) ;
+		REQUIRE( gt_writer.entry( 1 ) == "./." ) ;
+		REQUIRE( gt_writer.entry( 3 ) == "." ) ;
+		REQUIRE( gt_writer.entry( 4 ) == "1/1/1" ) ;
+	}
+
+	SECTION( "phased data" ) {
+		// Samples of ploidy zero have no values, but still get an entry.  The block is written by hand
+		// because the writer does not accept phased samples with no values.
+		std::vector< genfile::byte_t > const block = {
+			3, 0, 0, 0,		// number of samples
+			2, 0,			// number of alleles
+			0, 2,			// minimum and maximum ploidy
+			2, 0, 0x82,		// ploidy of each sample; the last is missing
+			1, 8,			// phased, 8 bits
+			255, 0,			// P(allele 0) on each haplotype of sample 0
+			0, 0			// sample 2
+		} ;
+		context.number_of_samples = 3 ;
+		genfile::bgen::VCFProbWriter writer( 0.7 ) ;
+		genfile::bgen::parse_probability_data( &block[0], &block[0] + block.size(), context, writer ) ;
+		REQUIRE( writer.phased() ) ;
+		std::ostringstream out ;
+		writer.write( out ) ;
+		REQUIRE( out.str() == "\t0|1:1,0,0,1\t.\t.|.:.,.,.,.\n" ) ;
+	}
+}
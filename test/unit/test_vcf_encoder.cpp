@@ -0,0 +1,290 @@
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include "stdint.h"
+#include "catch2/catch.hpp"
+#include "genfile/bgen.hpp"
+#include "genfile/vcf_encoder.hpp"
+#include "genfile/types.hpp"
+
+namespace {
+	genfile::vcf::Slice slice( std::string const& value ) {
+		return genfile::vcf::Slice( value.data(), value.data() + value.size() ) ;
+	}
+
+	// Decoded data for one sample.  values is empty if the sample is missing.
+	struct DecodedSample {
+		uint32_t ploidy ;
+		bool phased ;
+		std::vector< double > values ;
+	} ;
+
+	struct DecodingSetter {
+		DecodingSetter( std::vector< DecodedSample >* result ): m_result( result ) {}
+		void initialise( std::size_t n, std::size_t ) { m_result->assign( n, DecodedSample() ) ; }
+		bool set_sample( std::size_t i ) { m_sample = &(*m_result)[i] ; return true ; }
+		void set_number_of_entries( std::size_t ploidy, std::size_t n, genfile::OrderType order_type, genfile::ValueType ) {
+			m_sample->ploidy = ploidy ;
+			m_sample->phased = ( order_type == genfile::ePerPhasedHaplotypePerAllele ) ;
+			m_sample->values.clear() ;
+		}
+		void set_value( uint32_t, double value ) { m_sample->values.push_back( value ) ; }
+		void set_value( uint32_t, genfile::MissingValue ) {}
+		std::vector< DecodedSample >* m_result ;
+		DecodedSample* m_sample ;
+	} ;
+
+	genfile::bgen::Context make_context( std::size_t number_of_samples ) {
+		genfile::bgen::Context context ;
+		context.number_of_samples = number_of_samples ;
+		context.flags = genfile::bgen::e_Layout2 | genfile::bgen::e_ZlibCompression ;
+		return context ;
+	}
+
+	std::vector< DecodedSample > decode( genfile::bgen::Context const& context, genfile::vcf::EncodedVariant const& variant ) {
+		// Skip the length field, as read_genotype_data_block() does.
+		std::vector< genfile::byte_t > block( variant.data.begin() + 4, variant.data.end() ), data ;
+		genfile::bgen::uncompress_probability_data( context, block, &data ) ;
+		std::vector< DecodedSample > result ;
+		DecodingSetter setter( &result ) ;
+		genfile::bgen::parse_probability_data( data.data(), data.data() + data.size(), context, setter ) ;
+		return result ;
+	}
+
+	// Encode a single record with the given FORMAT and sample columns, and decode its genotype data.
+	std::vector< DecodedSample > encode(
+		std::string const& field,
+		std::string const& alt,
+		std::string const& format,
+		std::vector< std::string > const& samples
+	) {
+		genfile::bgen::Context const context = make_context( samples.size() ) ;
+		genfile::vcf::VcfEncoder const encoder( context, field, 16 ) ;
+		std::string line = "1\t1000\trs1\tA\t" + alt + "\t.\t.\t.\t" + format ;
+		for( std::string const& sample: samples ) {
+			line += "\t" + sample ;
+		}
+		genfile::vcf::EncodedChunk const chunk = encoder.encode( line + "\n", 1 ) ;
+		REQUIRE( chunk.variants.size() == 1 ) ;
+		REQUIRE( chunk.number_skipped == 0 ) ;
+		return decode( context, chunk.variants[0] ) ;
+	}
+
+	// Probabilities are stored to 16 bits.
+	double const tolerance = 1E-4 ;
+
+	void check_values( DecodedSample const& sample, uint32_t ploidy, bool phased, std::vector< double > const& expected ) {
+		REQUIRE( sample.ploidy == ploidy ) ;
+		REQUIRE( sample.phased == phased ) ;
+		REQUIRE( sample.values.size() == expected.size() ) ;
+		for( std::size_t i = 0; i < expected.size(); ++i ) {
+			REQUIRE( sample.values[i] == Approx( expected[i] ).margin( tolerance )) ;
+		}
+	}
+}
+
+TEST_CASE( "Test that VCF numbers are parsed and non-finite values rejected", "[vcf2bgen]" ) {
+	REQUIRE( genfile::vcf::parse_double( slice( "0.5" )) == 0.5 ) ;
+	REQUIRE( genfile::vcf::parse_double( slice( "1e-3" )) == 0.001 ) ;
+	REQUIRE( genfile::vcf::parse_double( slice( "-2" )) == -2.0 ) ;
+	REQUIRE_THROWS_AS( genfile::vcf::parse_double( slice( "" )), std::invalid_argument ) ;
+	REQUIRE_THROWS_AS( genfile::vcf::parse_double( slice( "0.5x" )), std::invalid_argument ) ;
+	REQUIRE_THROWS_AS( genfile::vcf::parse_double( slice( "nan" )), std::invalid_argument ) ;
+	REQUIRE_THROWS_AS( genfile::vcf::parse_double( slice( "inf" )), std::invalid_argument ) ;
+	REQUIRE_THROWS_AS( genfile::vcf::parse_double( slice( "-inf" )), std::invalid_argument ) ;
+}
+
+TEST_CASE( "Test that GT calls are parsed", "[vcf2bgen]" ) {
+	std::vector< uint32_t > calls ;
+	bool phased = false ;
+	REQUIRE( genfile::vcf::parse_GT( slice( "0/1" ), &calls, &phased )) ;
+	REQUIRE( calls == std::vector< uint32_t >{ 0, 1 } ) ;
+	REQUIRE( !phased ) ;
+	REQUIRE( genfile::vcf::parse_GT( slice( "2|10" ), &calls, &phased )) ;
+	REQUIRE( calls == std::vector< uint32_t >{ 2, 10 } ) ;
+	REQUIRE( phased ) ;
+	REQUIRE( genfile::vcf::parse_GT( slice( "1" ), &calls, &phased )) ;
+	REQUIRE( calls == std::vector< uint32_t >{ 1 } ) ;
+	REQUIRE( phased ) ;
+	// Calls are unphased if any separator is '/'.
+	REQUIRE( genfile::vcf::parse_GT( slice( "0|1/1" ), &calls, &phased )) ;
+	REQUIRE( calls == std::vector< uint32_t >{ 0, 1, 1 } ) ;
+	REQUIRE( !phased ) ;
+	// Missing alleles give a missing call, but still determine ploidy.
+	REQUIRE( !genfile::vcf::parse_GT( slice( "./." ), &calls, &phased )) ;
+	REQUIRE( calls.size() == 2 ) ;
+	REQUIRE( !genfile::vcf::parse_GT( slice( "0|." ), &calls, &phased )) ;
+	REQUIRE( calls.size() == 2 ) ;
+	REQUIRE_THROWS_AS( genfile::vcf::parse_GT( slice( "0/a" ), &calls, &phased ), std::invalid_argument ) ;
+	REQUIRE_THROWS_AS( genfile::vcf::parse_GT( slice( "0//1" ), &calls, &phased ), std::invalid_argument ) ;
+}
+
+TEST_CASE( "Test that genotype indices follow the colex order of the bgen spec", "[vcf2bgen]" ) {
+	// Diploid triallelic genotypes are ordered AA, AB, BB, AC, BC, CC.
+	std::vector< std::vector< uint32_t > > const diploid = { { 0, 0 }, { 0, 1 }, { 1, 1 }, { 0, 2 }, { 1, 2 }, { 2, 2 } } ;
+	for( std::size_t i = 0; i < diploid.size(); ++i ) {
+		REQUIRE( genfile::vcf::genotype_index( diploid[i] ) == i ) ;
+	}
+	// Triploid genotypes are ordered AAA, AAB, ABB, BBB, AAC, ABC, BBC, ACC, BCC, CCC.
+	std::vector< std::vector< uint32_t > > const triploid = {
+		{ 0, 0, 0 }, { 0, 0, 1 }, { 0, 1, 1 }, { 1, 1, 1 }, { 0, 0, 2 },
+		{ 0, 1, 2 }, { 1, 1, 2 }, { 0, 2, 2 }, { 1, 2, 2 }, { 2, 2, 2 }
+	} ;
+	for( std::size_t i = 0; i < triploid.size(); ++i ) {
+		REQUIRE( genfile::vcf::genotype_index( triploid[i] ) == i ) ;
+	}
+	REQUIRE( genfile::vcf::genotype_index( { 3 } ) == 3 ) ;
+}
+
+TEST_CASE( "Test that ploidy is determined by the number of genotypes", "[vcf2bgen]" ) {
+	REQUIRE( genfile::vcf::ploidy_from_number_of_genotypes( 2, 2 ) == 1 ) ;
+	REQUIRE( genfile::vcf::ploidy_from_number_of_genotypes( 3, 2 ) == 2 ) ;
+	REQUIRE( genfile::vcf::ploidy_from_number_of_genotypes( 4, 2 ) == 3 ) ;
+	REQUIRE( genfile::vcf::ploidy_from_number_of_genotypes( 3, 3 ) == 1 ) ;
+	REQUIRE( genfile::vcf::ploidy_from_number_of_genotypes( 6, 3 ) == 2 ) ;
+	REQUIRE( genfile::vcf::ploidy_from_number_of_genotypes( 10, 3 ) == 3 ) ;
+	REQUIRE( genfile::vcf::ploidy_from_number_of_genotypes( 1, 2 ) == 0 ) ;
+	REQUIRE( genfile::vcf::ploidy_from_number_of_genotypes( 5, 3 ) == 0 ) ;
+	REQUIRE( genfile::vcf::ploidy_from_number_of_genotypes( 7, 3 ) == 0 ) ;
+}
+
+TEST_CASE( "Test that VcfEncoder encodes GP fields", "[vcf2bgen]" ) {
+	SECTION( "Biallelic" ) {
+		std::vector< DecodedSample > const result = encode(
+			"GP", "G", "GT:GP",
+			{ "0/0:1,0,0", "0/1:0.25,0.5,0.25", "./.:.", "0/1:0,0,0", "1:0.2,0.8" }
+		) ;
+		REQUIRE( result.size() == 5 ) ;
+		check_values( result[0], 2, false, { 1, 0, 0 } ) ;
+		check_values( result[1], 2, false, { 0.25, 0.5, 0.25 } ) ;
+		// Samples with missing or all-zero GP values are missing.
+		REQUIRE( result[2].values.empty() ) ;
+		REQUIRE( result[3].values.empty() ) ;
+		// Ploidy is taken from the number of GP values.
+		check_values( result[4], 1, false, { 0.2, 0.8 } ) ;
+	}
+
+	SECTION( "Multiallelic" ) {
+		std::vector< DecodedSample > const result = encode(
+			"GP", "G,T", "GP",
+			{ "0,0,0,1,0,0", "0.5,0,0,0,0,0.5", "0.25,0.25,0.5", "0,0,0,0,0,0,0,0,0,1" }
+		) ;
+		check_values( result[0], 2, false, { 0, 0, 0, 1, 0, 0 } ) ;
+		check_values( result[1], 2, false, { 0.5, 0, 0, 0, 0, 0.5 } ) ;
+		check_values( result[2], 1, false, { 0.25, 0.25, 0.5 } ) ;
+		check_values( result[3], 3, false, { 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 } ) ;
+	}
+
+	SECTION( "Rounded values are rescaled" ) {
+		std::vector< DecodedSample > const result = encode( "GP", "G", "GP", { "0.333,0.333,0.333", "0.01,0.98,0.02" } ) ;
+		check_values( result[0], 2, false, { 1.0/3.0, 1.0/3.0, 1.0/3.0 } ) ;
+		check_values( result[1], 2, false, { 0.01/1.01, 0.98/1.01, 0.02/1.01 } ) ;
+	}
+
+	SECTION( "Invalid values" ) {
+		REQUIRE_THROWS_AS( encode( "GP", "G", "GP", { "0.2,0.2" } ), std::invalid_argument ) ;
+		REQUIRE_THROWS_AS( encode( "GP", "G", "GP", { "0.5,0.5,0.5" } ), std::invalid_argument ) ;
+		REQUIRE_THROWS_AS( encode( "GP", "G", "GP", { "nan,0,0" } ), std::invalid_argument ) ;
+		REQUIRE_THROWS_AS( encode( "GP", "G", "GP", { "inf,0,0" } ), std::invalid_argument ) ;
+		REQUIRE_THROWS_AS( encode( "GP", "G", "GP", { "-0.5,1,0.5" } ), std::invalid_argument ) ;
+		REQUIRE_THROWS_AS( encode( "GP", "G", "GP", { "1" } ), std::invalid_argument ) ;
+		REQUIRE_THROWS_AS( encode( "GP", "G,T", "GP", { "1,0,0,0,0" } ), std::invalid_argument ) ;
+	}
+
+	SECTION( "Ploidy is taken from the number of GP values in preference to GT" ) {
+		std::vector< DecodedSample > const result = encode( "GP", "G", "GT:GP", { "0/1:0.75,0.25", "1:0,1,0" } ) ;
+		check_values( result[0], 1, false, { 0.75, 0.25 } ) ;
+		check_values( result[1], 2, false, { 0, 1, 0 } ) ;
+	}
+}
+
+TEST_CASE( "Test that VcfEncoder encodes DS fields", "[vcf2bgen]" ) {
+	std::vector< DecodedSample > const result = encode(
+		"DS", "G", "GT:DS",
+		{ "0/0:0", "0/1:0.5", "1/1:1.75", "./.:.", "1:0.25", "0/1:3" }
+	) ;
+	check_values( result[0], 2, false, { 1, 0, 0 } ) ;
+	check_values( result[1], 2, false, { 0.5, 0.5, 0 } ) ;
+	check_values( result[2], 2, false, { 0, 0.25, 0.75 } ) ;
+	REQUIRE( result[3].values.empty() ) ;
+	check_values( result[4], 1, false, { 0.75, 0.25 } ) ;
+	// Dosages are clamped to the ploidy.
+	check_values( result[5], 2, false, { 0, 0, 1 } ) ;
+
+	REQUIRE_THROWS_AS( encode( "DS", "G", "DS", { "nan" } ), std::invalid_argument ) ;
+	REQUIRE_THROWS_AS( encode( "DS", "G", "DS", { "inf" } ), std::invalid_argument ) ;
+}
+
+TEST_CASE( "Test that VcfEncoder encodes GT fields", "[vcf2bgen]" ) {
+	SECTION( "Phased" ) {
+		std::vector< DecodedSample > const result = encode( "GT", "G,T", "GT", { "0|1", "2|0", ".|.", "1" } ) ;
+		check_values( result[0], 2, true, { 1, 0, 0, 0, 1, 0 } ) ;
+		check_values( result[1], 2, true, { 0, 0, 1, 1, 0, 0 } ) ;
+		REQUIRE( result[2].values.empty() ) ;
+		// Haploid calls do not affect phasing.
+		check_values( result[3], 1, true, { 0, 1, 0 } ) ;
+	}
+
+	SECTION( "Mixed phasing falls back to unphased" ) {
+		std::vector< DecodedSample > const result = encode( "GT", "G,T", "GT", { "0|1", "2/0", "./.", "1|1|2" } ) ;
+		check_values( result[0], 2, false, { 0, 1, 0, 0, 0, 0 } ) ;
+		check_values( result[1], 2, false, { 0, 0, 0, 1, 0, 0 } ) ;
+		REQUIRE( result[2].values.empty() ) ;
+		REQUIRE( result[2].ploidy == 2 ) ;
+		check_values( result[3], 3, false, { 0, 0, 0, 0, 0, 0, 1, 0, 0, 0 } ) ;
+	}
+
+	SECTION( "Alleles must be in range" ) {
+		REQUIRE_THROWS_AS( encode( "GT", "G", "GT", { "0/2" } ), std::invalid_argument ) ;
+		REQUIRE_THROWS_AS( encode( "GT", "G", "GT", { "0|2" } ), std::invalid_argument ) ;
+	}
+}
+
+TEST_CASE( "Test that VcfEncoder reports invalid records and skips unrepresentable ones", "[vcf2bgen]" ) {
+	genfile::bgen::Context const context = make_context( 2 ) ;
+	REQUIRE_THROWS_AS( genfile::vcf::VcfEncoder( context, "GL", 8 ), std::invalid_argument ) ;
+	genfile::vcf::VcfEncoder const encoder( context, "GT", 8 ) ;
+
+	// Records without an alternate allele are skipped, as are multiallelic records for DS.
+	genfile::vcf::EncodedChunk chunk = encoder.encode(
+		"1\t1000\trs1\tA\t.\t.\t.\t.\tGT\t0/0\t0/0\n"
+		"1\t1001\t.\tA\tG\t.\t.\t.\tGT\t0/1\t1/1\r\n"
+		"\n"
+		"2\t1002\trs3\tA\tG,T\t.\t.\t.\tGT\t0/2\t1/1",
+		10
+	) ;
+	REQUIRE( chunk.number_skipped == 1 ) ;
+	REQUIRE( chunk.variants.size() == 2 ) ;
+	REQUIRE( chunk.variants[0].chromosome == "1" ) ;
+	REQUIRE( chunk.variants[0].position == 1001 ) ;
+	REQUIRE( chunk.variants[0].id == "" ) ;
+	REQUIRE( chunk.variants[0].alleles == std::vector< std::string >{ "A", "G" } ) ;
+	REQUIRE( chunk.variants[1].id == "rs3" ) ;
+	REQUIRE( chunk.variants[1].alleles == std::vector< std::string >{ "A", "G", "T" } ) ;
+
+	chunk = genfile::vcf::VcfEncoder( context, "DS", 8 ).encode( "1\t1000\trs1\tA\tG,T\t.\t.\t.\tDS\t0,1\t1,0\n", 1 ) ;
+	REQUIRE( chunk.number_skipped == 1 ) ;
+	REQUIRE( chunk.variants.empty() ) ;
+
+	// Errors give the line number.
+	std::string const valid = "1\t1000\trs1\tA\tG\t.\t.\t.\tGT\t0/0\t0/1\n" ;
+	std::vector< std::string > const invalid = {
+		"1\t1000\trs1\tA\tG\t.\t.\t.\tGT\t0/0\n",
+		"1\tx\trs1\tA\tG\t.\t.\t.\tGT\t0/0\t0/1\n",
+		"1\t1000\trs1\tA\tG\t.\t.\t.\tGP\t0,0,1\t0,1,0\n",
+		"1\t1000\trs1\tA\tG\t.\t.\t.\tGT\t0/0\t0/x\n"
+	} ;
+	for( std::string const& line: invalid ) {
+		try {
+			encoder.encode( valid + line, 41 ) ;
+			FAIL( "expected an exception" ) ;
+		} catch( std::invalid_argument const& e ) {
+			REQUIRE( std::string( e.what() ).compare( 0, 8, "line 42:" ) == 0 ) ;
+		}
+	}
+}
@@ -0,0 +1,327 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include "stdint.h"
+#include "catch2/catch.hpp"
+#include "genfile/bgen.hpp"
+#include "genfile/IndexQuery.hpp"
+#include "genfile/View.hpp"
+#include "genfile/ViewMerger.hpp"
+#include "genfile/ThreadPool.hpp"
+#include "genfile/types.hpp"
+#include "test_files.hpp"
+
+TEST_CASE( "Test that read_variant_batch() matches read_variant()", "[bgen][view]" ) {
+	std::string const filename = temp_filename( "genfile_test_variant_batch.bgen" ) ;
+	std::string const index_filename = filename + ".bgi" ;
+	std::size_t const number_of_samples = 5 ;
+	std::size_t const number_of_variants = 23 ;
+
+	std::vector< TestVariant > variants ;
+	for( std::size_t variant = 0; variant < number_of_variants; ++variant ) {
+		std::string const chromosome = ( variant < 10 ) ? "01" : ( variant % 2 ) ? "02" : "X" ;
+		variants.push_back( { chromosome, uint32_t( 1000 + variant ), { "A", std::string( variant + 1, 'T' ) }, variant } ) ;
+	}
+	write_test_file( filename, number_of_samples, variants ) ;
+	genfile::bgen::Context context ;
+	context.number_of_samples = number_of_samples ;
+	context.flags = TestFileOptions().flags ;
+
+	std::string SNPID, rsid, chromosome ;
+	uint32_t position ;
+	std::vector< std::string > alleles ;
+	std::vector< double > expected_dosages, dosages ;
+	DosageSetter expected_setter( &expected_dosages ), setter( &dosages ) ;
+
+	for( int include_genotype_data = 0; include_genotype_data < 2; ++include_genotype_data ) {
+		genfile::bgen::View view( filename ) ;
+		genfile::bgen::View batch_view( filename ) ;
+		genfile::bgen::VariantBatch batch ;
+		std::vector< genfile::byte_t > uncompressed ;
+		std::size_t count = 0 ;
+		while( batch_view.read_variant_batch( 7, &batch, include_genotype_data ) > 0 ) {
+			REQUIRE( batch.size() <= 7 ) ;
+			for( std::size_t i = 0; i < batch.size(); ++i, ++count ) {
+				int64_t const file_offset = view.current_file_position() ;
+				REQUIRE( view.read_variant( &SNPID, &rsid, &chromosome, &position, &alleles )) ;
+				REQUIRE( batch.SNPID(i) == SNPID ) ;
+				REQUIRE( batch.rsid(i) == rsid ) ;
+				REQUIRE( batch.chromosome(i) == chromosome ) ;
+				REQUIRE( batch.position[i] == position ) ;
+				REQUIRE( batch.number_of_alleles[i] == alleles.size() ) ;
+				for( std::size_t j = 0; j < alleles.size(); ++j ) {
+					REQUIRE( batch.allele( i, j ) == alleles[j] ) ;
+				}
+				view.read_genotype_data_block( expected_setter ) ;
+				REQUIRE( batch.file_offset[i] == file_offset ) ;
+				REQUIRE( batch.file_size[i] == int64_t( view.current_file_position() ) - file_offset ) ;
+				if( include_genotype_data ) {
+					std::pair< genfile::byte_t const*, genfile::byte_t const* > const block = batch.genotype_data_block( i ) ;
+					genfile::bgen::uncompress_probability_data(
+						context, std::vector< genfile::byte_t >( block.first, block.second ), &uncompressed
+					) ;
+					genfile::bgen::parse_probability_data( &uncompressed[0], &uncompressed[0] + uncompressed.size(), context, setter ) ;
+					REQUIRE( dosages == expected_dosages ) ;
+				}
+			}
+		}
+		REQUIRE( count == number_of_variants ) ;
+		REQUIRE( batch.chromosomes == std::vector< std::string >{ "01", "X", "02" } ) ;
+		REQUIRE( !view.read_variant( &SNPID, &rsid, &chromosome, &position, &alleles )) ;
+	}
+
+	// Batches follow the index query, if there is one.
+	{
+		genfile::bgen::View view( filename ) ;
+		genfile::bgen::IndexQuery::UniquePtr query = genfile::bgen::IndexQuery::create( index_filename ) ;
+		query->include_range( genfile::bgen::IndexQuery::GenomicRange( "02", 1000, 2000 )) ;
+		query->initialise() ;
+		view.set_query( std::move( query )) ;
+		genfile::bgen::VariantBatch batch ;
+		REQUIRE( view.read_variant_batch( 100, &batch ) == 6 ) ;
+		for( std::size_t i = 0; i < batch.size(); ++i ) {
+			REQUIRE( batch.chromosome(i) == "02" ) ;
+			REQUIRE( batch.position[i] == 1011 + 2*i ) ;
+		}
+		REQUIRE( view.read_variant_batch( 100, &batch ) == 0 ) ;
+		REQUIRE( batch.size() == 0 ) ;
+	}
+
+	// The index reports the same data, apart from SNPIDs.
+	{
+		genfile::bgen::View view( filename ) ;
+		genfile::bgen::VariantBatch expected ;
+		view.read_variant_batch( number_of_variants, &expected ) ;
+		genfile::bgen::IndexQuery::UniquePtr query = genfile::bgen::IndexQuery::create( index_filename ) ;
+		query->initialise() ;
+		std::size_t count = 0 ;
+		query->read_variant_batches(
+			4,
+			[&]( genfile::bgen::VariantBatch& batch ) {
+				REQUIRE( batch.size() <= 4 ) ;
+				for( std::size_t i = 0; i < batch.size(); ++i, ++count ) {
+					// Variants are reported in index order, i.e. sorted by chromosome and position.
+					std::pair< int64_t, int64_t > const range = query->locate_variant( count ) ;
+					REQUIRE( batch.file_offset[i] == range.first ) ;
+					REQUIRE( batch.file_size[i] == range.second ) ;
+					std::size_t const j = std::find( expected.file_offset.begin(), expected.file_offset.end(), range.first ) - expected.file_offset.begin() ;
+					REQUIRE( j < expected.size() ) ;
+					REQUIRE( batch.SNPID(i) == "" ) ;
+					REQUIRE( batch.rsid(i) == expected.rsid(j) ) ;
+					REQUIRE( batch.chromosome(i) == expected.chromosome(j) ) ;
+					REQUIRE( batch.position[i] == expected.position[j] ) ;
+					REQUIRE( batch.number_of_alleles[i] == 2 ) ;
+					REQUIRE( batch.number_of_stored_alleles(i) == 2 ) ;
+					REQUIRE( batch.allele( i, 0 ) == expected.allele( j, 0 )) ;
+					REQUIRE( batch.allele( i, 1 ) == expected.allele( j, 1 )) ;
+				}
+			}
+		) ;
+		REQUIRE( count == number_of_variants ) ;
+	}
+	remove_test_file( filename ) ;
+}
+
+TEST_CASE( "Test that ViewMerger reports variants from several files in position order", "[bgen][view]" ) {
+	std::size_t const number_of_samples = 6 ;
+	std::vector< std::string > const AG = { "A", "G" }, AT = { "A", "T" } ;
+	std::vector< std::vector< TestVariant > > const variants = {
+		{ { "01", 1000, AG, 0 }, { "01", 1002, AG, 1 }, { "01", 1004, AG, 2 }, { "01", 1006, AG, 3 }, { "02", 1000, AG, 4 } },
+		// The index sorts by rsid before alleles, so variant 11 (A/T) is read before variant 12 (A/G).
+		{ { "01", 1001, AG, 10 }, { "01", 1002, AT, 11 }, { "01", 1002, AG, 12 }, { "01", 1005, AG, 13 } },
+		{ { "02", 999, AG, 20 }, { "02", 1000, AG, 21 }, { "03", 5, AG, 22 } }
+	} ;
+	std::vector< std::string > filenames ;
+	for( std::size_t f = 0; f < variants.size(); ++f ) {
+		filenames.push_back( temp_filename( "genfile_test_merger_" + std::to_string( f ) + ".bgen" )) ;
+		write_test_file( filenames.back(), number_of_samples, variants[f] ) ;
+	}
+
+	auto create_merger = [&]( genfile::ThreadPool* pool, std::size_t batch_size ) {
+		genfile::bgen::ViewMerger::UniquePtr merger( new genfile::bgen::ViewMerger( pool, batch_size )) ;
+		for( std::size_t f = 0; f < filenames.size(); ++f ) {
+			genfile::bgen::View::UniquePtr view = genfile::bgen::View::create( filenames[f] ) ;
+			genfile::bgen::IndexQuery::UniquePtr query = genfile::bgen::IndexQuery::create( filenames[f] + ".bgi" ) ;
+			query->initialise() ;
+			view->set_query( std::move( query )) ;
+			merger->add_source( std::move( view )) ;
+		}
+		return merger ;
+	} ;
+
+	// Expected variant ids, and their sources, with and without preferring the last source.
+	std::vector< std::size_t > const all_ids = { 0, 10, 1, 12, 11, 2, 13, 3, 20, 4, 21, 22 } ;
+	std::vector< std::size_t > const preferred_ids = { 0, 10, 1, 11, 2, 13, 3, 20, 21, 22 } ;
+
+	genfile::ThreadPool pool( 2 ) ;
+	for( genfile::ThreadPool* p: { static_cast< genfile::ThreadPool* >( 0 ), &pool } ) {
+		for( std::size_t const batch_size: { 1, 2, 256 } ) {
+			for( bool const prefer: { false, true } ) {
+				genfile::bgen::ViewMerger::UniquePtr merger = create_merger( p, batch_size ) ;
+				REQUIRE( merger->number_of_sources() == 3 ) ;
+				REQUIRE( merger->number_of_samples() == number_of_samples ) ;
+				if( prefer ) {
+					merger->prefer_source( 2 ) ;
+				}
+				std::vector< std::size_t > const& expected_ids = prefer ? preferred_ids : all_ids ;
+				std::string SNPID, rsid, chromosome ;
+				uint32_t position ;
+				std::vector< std::string > alleles ;
+				std::vector< double > dosages ;
+				DosageSetter setter( &dosages ) ;
+				for( std::size_t const id: expected_ids ) {
+					REQUIRE( merger->read_variant( &SNPID, &rsid, &chromosome, &position, &alleles )) ;
+					REQUIRE( SNPID == "SNP" + std::to_string( id )) ;
+					std::size_t const source = id / 10 ;
+					TestVariant const& expected = *std::find_if(
+						variants[source].begin(), variants[source].end(),
+						[id]( TestVariant const& v ) { return v.id == id ; }
+					) ;
+					REQUIRE( merger->current_source() == source ) ;
+					REQUIRE( chromosome == expected.chromosome ) ;
+					REQUIRE( position == expected.position ) ;
+					REQUIRE( alleles == expected.alleles ) ;
+					// Genotype data need not be read for every variant.
+					if( id % 2 == 0 ) {
+						merger->read_genotype_data_block( setter ) ;
+						for( std::size_t i = 0; i < number_of_samples; ++i ) {
+							REQUIRE( dosages[i] == Approx( expected_dosage( i, id ))) ;
+						}
+					}
+				}
+				REQUIRE( !merger->read_variant( &SNPID, &rsid, &chromosome, &position, &alleles )) ;
+			}
+		}
+	}
+
+	// Sources must have the same samples, and be sorted.
+	{
+		genfile::bgen::ViewMerger merger ;
+		merger.add_source( genfile::bgen::View::create( filenames[0] )) ;
+		write_test_file( filenames[1], number_of_samples + 1, variants[1] ) ;
+		REQUIRE_THROWS_AS( merger.add_source( genfile::bgen::View::create( filenames[1] )), std::invalid_argument ) ;
+		REQUIRE_THROWS_AS( merger.prefer_source( 1 ), std::invalid_argument ) ;
+	}
+	{
+		genfile::bgen::ViewMerger merger( 0, 2 ) ;
+		write_test_file( filenames[1], number_of_samples, { { "01", 1001, AG, 10 }, { "01", 1003, AG, 11 }, { "01", 1002, AG, 12 } } ) ;
+		merger.add_source( genfile::bgen::View::create( filenames[0] )) ;
+		merger.add_source( genfile::bgen::View::create( filenames[1] )) ;
+		std::string SNPID, rsid, chromosome ;
+		uint32_t position ;
+		std::vector< std::string > alleles ;
+		REQUIRE_THROWS_AS(
+			[&]() { while( merger.read_variant( &SNPID, &rsid, &chromosome, &position, &alleles )) {} }(),
+			std::invalid_argument
+		) ;
+	}
+
+	for( std::size_t f = 0; f < filenames.size(); ++f ) {
+		remove_test_file( filenames[f] ) ;
+	}
+}
+
+TEST_CASE( "Test that a streaming View reads the same data as a View of the file", "[bgen][view]" ) {
+	std::string const filename = temp_filename( "genfile_test_streaming.bgen" ) ;
+	std::size_t const number_of_samples = 11 ;
+	std::vector< TestVariant > const variants = consecutive_variants( 20 ) ;
+	write_test_file( filename, number_of_samples, variants ) ;
+	std::string contents ;
+	{
+		std::ifstream file( filename.c_str(), std::ios::binary ) ;
+		contents.assign( std::istreambuf_iterator< char >( file ), std::istreambuf_iterator< char >() ) ;
+	}
+
+	// Compare a view against one reading the file directly, alternating between
+	// read_variant_batch() and read_variant() to exercise both paths.
+	auto compare = [&]( genfile::bgen::View& view ) {
+		REQUIRE( view.is_streaming() ) ;
+		REQUIRE( view.file_metadata().size == -1 ) ;
+		REQUIRE( view.file_metadata().first_bytes.empty() ) ;
+		REQUIRE( view.number_of_samples() == number_of_samples ) ;
+		REQUIRE( view.number_of_variants() == variants.size() ) ;
+		REQUIRE_THROWS_AS(
+			view.set_query( genfile::bgen::IndexQuery::create( filename + ".bgi" )),
+			std::invalid_argument
+		) ;
+
+		genfile::bgen::View expected( filename ) ;
+		genfile::bgen::VariantBatch batch, expected_batch ;
+		std::string SNPID, rsid, chromosome ;
+		uint32_t position ;
+		std::vector< std::string > alleles ;
+		std::vector< double > dosages, expected_dosages ;
+		DosageSetter setter( &dosages ), expected_setter( &expected_dosages ) ;
+		std::size_t count = 0 ;
+		while( true ) {
+			std::size_t const n = view.read_variant_batch( 3, &batch, true ) ;
+			REQUIRE( expected.read_variant_batch( 3, &expected_batch, true ) == n ) ;
+			if( n == 0 ) {
+				break ;
+			}
+			count += n ;
+			REQUIRE( batch.position == expected_batch.position ) ;
+			REQUIRE( batch.file_offset == expected_batch.file_offset ) ;
+			REQUIRE( batch.file_size == expected_batch.file_size ) ;
+			for( std::size_t i = 0; i < n; ++i ) {
+				std::pair< genfile::byte_t const*, genfile::byte_t const* > const block = batch.genotype_data_block( i ) ;
+				std::pair< genfile::byte_t const*, genfile::byte_t const* > const expected_block = expected_batch.genotype_data_block( i ) ;
+				REQUIRE( std::equal( block.first, block.second, expected_block.first, expected_block.second )) ;
+			}
+
+			REQUIRE( view.current_file_position() == expected.current_file_position() ) ;
+			if( view.read_variant( &SNPID, &rsid, &chromosome, &position, &alleles )) {
+				REQUIRE( expected.read_variant( &SNPID, &rsid, &chromosome, &position, &alleles )) ;
+				view.read_genotype_data_block( setter ) ;
+				expected.read_genotype_data_block( expected_setter ) ;
+				REQUIRE( dosages == expected_dosages ) ;
+				REQUIRE( view.current_file_position() == expected.current_file_position() ) ;
+				++count ;
+			}
+		}
+		REQUIRE( count == variants.size() ) ;
+	} ;
+
+	SECTION( "reading from a std::istream" ) {
+		// A small buffer makes reads straddle buffer refills.
+		genfile::bgen::View::UniquePtr view = genfile::bgen::View::create_streaming(
+			std::unique_ptr< std::istream >( new std::istringstream( contents )), "(string)", 7
+		) ;
+		compare( *view ) ;
+	}
+
+	SECTION( "reading from a pipe" ) {
+		int fds[2] ;
+		REQUIRE( ::pipe( fds ) == 0 ) ;
+		std::thread writer(
+			[&]() {
+				for( std::size_t i = 0; i < contents.size(); ) {
+					ssize_t const n = ::write( fds[1], contents.data() + i, std::min< std::size_t >( contents.size() - i, 100 )) ;
+					if( n <= 0 ) {
+						break ;
+					}
+					i += n ;
+				}
+				::close( fds[1] ) ;
+			}
+		) ;
+		{
+			genfile::bgen::View::UniquePtr view = genfile::bgen::View::create_streaming( fds[0], "(pipe)" ) ;
+			compare( *view ) ;
+		}
+		writer.join() ;
+		::close( fds[0] ) ;
+	}
+
+	remove_test_file( filename ) ;
+}
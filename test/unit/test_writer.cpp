@@ -0,0 +1,134 @@
+
+//          Copyright Gavin Band 2008 - 2012.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include "stdint.h"
+#include "catch2/catch.hpp"
+#include "genfile/bgen.hpp"
+#include "genfile/Writer.hpp"
+#include "genfile/IndexQuery.hpp"
+#include "genfile/View.hpp"
+#include "genfile/types.hpp"
+#include "test_files.hpp"
+
+TEST_CASE( "Test that files and indexes written by Writer and IndexWriter can be read back", "[bgen][writer]" ) {
+	std::string const filename = temp_filename( "genfile_test_writer.bgen" ) ;
+	std::size_t const number_of_samples = 11 ;
+	std::size_t const number_of_variants = 25 ;
+
+	TestFileOptions options ;
+	for( std::size_t i = 0; i < number_of_samples; ++i ) {
+		options.sample_ids.push_back( "sample_" + std::to_string( i )) ;
+	}
+
+	for( uint32_t compression = 0; compression < 3; ++compression ) {
+		options.flags = genfile::bgen::e_Layout2 | compression ;
+		genfile::bgen::Writer::FileMetadata const metadata = write_test_file(
+			filename, number_of_samples, consecutive_variants( number_of_variants ), options
+		) ;
+
+		genfile::bgen::View view( filename ) ;
+		REQUIRE( view.number_of_samples() == number_of_samples ) ;
+		REQUIRE( view.number_of_variants() == number_of_variants ) ;
+		REQUIRE( view.file_metadata().size == metadata.size ) ;
+		REQUIRE( view.file_metadata().first_bytes == metadata.first_bytes ) ;
+		{
+			std::size_t i = 0 ;
+			view.get_sample_ids( [&]( std::string const& id ) { REQUIRE( id == options.sample_ids[i++] ) ; } ) ;
+		}
+
+		// Read back a range through the index.
+		genfile::bgen::IndexQuery::UniquePtr query = genfile::bgen::IndexQuery::create( filename + ".bgi" ) ;
+		query->include_range( genfile::bgen::IndexQuery::GenomicRange( "01", 1010, 1014 )) ;
+		query->initialise() ;
+		REQUIRE( query->number_of_variants() == 5 ) ;
+		view.set_query( std::move( query )) ;
+
+		std::string SNPID, rsid, chromosome ;
+		uint32_t position ;
+		std::vector< std::string > alleles ;
+		std::vector< double > dosages ;
+		DosageSetter setter( &dosages ) ;
+		for( std::size_t variant = 10; variant < 15; ++variant ) {
+			REQUIRE( view.read_variant( &SNPID, &rsid, &chromosome, &position, &alleles )) ;
+			REQUIRE( position == 1000 + variant ) ;
+			REQUIRE( rsid == "rs" + std::to_string( variant )) ;
+			view.read_genotype_data_block( setter ) ;
+			for( std::size_t i = 0; i < number_of_samples; ++i ) {
+				REQUIRE( dosages[i] == Approx( expected_dosage( i, variant ))) ;
+			}
+		}
+		REQUIRE( !view.read_variant( &SNPID, &rsid, &chromosome, &position, &alleles )) ;
+	}
+	remove_test_file( filename ) ;
+}
+
+TEST_CASE( "Test that Writer writes to a stream without needing to seek", "[bgen][writer]" ) {
+	std::size_t const number_of_samples = 6 ;
+	std::size_t const number_of_variants = 30 ;
+	std::vector< std::string > const sample_ids = { "a", "b", "c", "d", "e", "f" } ;
+	std::vector< std::string > const alleles = { "A", "C" } ;
+
+	for( uint32_t declared: { uint32_t( number_of_variants ), uint32_t( genfile::bgen::e_UnknownNumberOfVariants ) } ) {
+		genfile::bgen::Context context ;
+		context.number_of_samples = number_of_samples ;
+		context.number_of_variants = declared ;
+		context.flags = genfile::bgen::e_Layout2 | genfile::bgen::e_ZstdCompression ;
+		std::ostringstream out ;
+		{
+			genfile::bgen::Writer writer( out, "(string)", context, sample_ids ) ;
+			for( std::size_t variant = 0; variant < number_of_variants; ++variant ) {
+				std::vector< genfile::byte_t > const data = encode_variant( writer.context(), variant ) ;
+				genfile::bgen::IndexQuery::FileRange const range = writer.write_variant(
+					"SNP" + std::to_string( variant ), "rs" + std::to_string( variant ), "01", 1000 + variant, alleles,
+					&data[0], &data[0] + data.size()
+				) ;
+				REQUIRE( range.first + range.second == int64_t( out.tellp() )) ;
+			}
+			genfile::bgen::Writer::FileMetadata const metadata = writer.finalise() ;
+			std::string const written = out.str() ;
+			REQUIRE( metadata.size == int64_t( written.size() )) ;
+			// The stream cannot be read back, so the first bytes are those written.
+			REQUIRE( written.size() > 1000 ) ;
+			REQUIRE( metadata.first_bytes == std::vector< genfile::byte_t >( written.begin(), written.begin() + 1000 )) ;
+		}
+
+		genfile::bgen::View::UniquePtr view = genfile::bgen::View::create_streaming(
+			std::unique_ptr< std::istream >( new std::istringstream( out.str() ))
+		) ;
+		REQUIRE( view->number_of_variants() == declared ) ;
+		std::string SNPID, rsid, chromosome ;
+		uint32_t position ;
+		std::vector< std::string > read_alleles ;
+		std::vector< double > dosages ;
+		DosageSetter setter( &dosages ) ;
+		std::size_t count = 0 ;
+		while( view->read_variant( &SNPID, &rsid, &chromosome, &position, &read_alleles )) {
+			REQUIRE( rsid == "rs" + std::to_string( count )) ;
+			view->read_genotype_data_block( setter ) ;
+			for( std::size_t i = 0; i < number_of_samples; ++i ) {
+				REQUIRE( dosages[i] == expected_dosage( i, count )) ;
+			}
+			++count ;
+		}
+		REQUIRE( count == number_of_variants ) ;
+	}
+
+	// A declared number of variants that is not met is reported.
+	{
+		genfile::bgen::Context context ;
+		context.number_of_samples = number_of_samples ;
+		context.number_of_variants = number_of_variants ;
+		context.flags = genfile::bgen::e_Layout2 | genfile::bgen::e_ZlibCompression ;
+		std::ostringstream out ;
+		genfile::bgen::Writer writer( out, "(string)", context ) ;
+		std::vector< genfile::byte_t > const data = encode_variant( writer.context(), 0 ) ;
+		writer.write_variant( "SNP0", "rs0", "01", 1000, alleles, &data[0], &data[0] + data.size() ) ;
+		REQUIRE_THROWS_AS( writer.finalise(), std::invalid_argument ) ;
+	}
+}